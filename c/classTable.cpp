@@ -0,0 +1,464 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "classTable.h"
+#include "tensorNet.h"
+
+#include "filesystem.h"
+#include "logging.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+#define CLASS_TABLE_MAGIC    "CLSTABLE"
+#define CLASS_TABLE_VERSION  1
+
+
+// fileStat
+static bool fileStat( const std::string& path, uint64_t& size, uint64_t& time )
+{
+	struct stat st;
+
+	if( stat(path.c_str(), &st) != 0 )
+		return false;
+
+	size = st.st_size;
+	time = uint64_t(st.st_mtim.tv_sec) * 1000000000ULL + st.st_mtim.tv_nsec;
+
+	return true;
+}
+
+
+// hashString (FNV-1a)
+static uint32_t hashString( const std::string& str )
+{
+	uint32_t hash = 2166136261u;
+
+	for( size_t n=0; n < str.length(); n++ )
+		hash = (hash ^ (uint8_t)str[n]) * 16777619u;
+
+	return hash;
+}
+
+
+// constructor
+classTable::classTable()
+{
+	mHeader  = NULL;
+	mEntries = NULL;
+	mPool    = NULL;
+
+	mMapped     = NULL;
+	mMappedSize = 0;
+}
+
+
+// destructor
+classTable::~classTable()
+{
+	if( mMapped != NULL )
+		munmap(mMapped, mMappedSize);
+}
+
+
+// Load
+classTable* classTable::Load( const char* labels, const char* colors, int expectedClasses, float defaultAlpha )
+{
+	// the key that the cached table has to match
+	Header key;
+	memset(&key, 0, sizeof(Header));
+
+	key.expectedClasses = expectedClasses;
+	key.defaultAlpha    = defaultAlpha;
+
+	std::string labelsPath;
+	std::string colorsPath;
+
+	if( labels != NULL )
+		labelsPath = locateFile(labels);
+
+	if( colors != NULL )
+		colorsPath = locateFile(colors);
+
+	key.colorsHash = hashString(colorsPath);
+
+	// tables are only cached for files that exist (so that the errors for missing files are still logged)
+	const bool cacheable = labelsPath.length() > 0 && fileStat(labelsPath, key.labelsSize, key.labelsTime) &&
+					   (colors == NULL || (colorsPath.length() > 0 && fileStat(colorsPath, key.colorsSize, key.colorsTime)));
+
+	const std::string cachePath = cacheable ? labelsPath + CLASS_TABLE_EXTENSION : "";
+
+	if( cacheable )
+	{
+		classTable* table = map(cachePath, key);
+
+		if( table != NULL )
+		{
+			LogVerbose(LOG_TRT "loaded %u classes from %s\n", table->GetNumClasses(), cachePath.c_str());
+			return table;
+		}
+	}
+
+	// compile the table from the text files
+	std::vector<std::string> descriptions;
+	std::vector<std::string> synsets;
+
+	if( !tensorNet::LoadClassLabels(labels, descriptions, synsets, expectedClasses) )
+		return NULL;
+
+	std::vector<float4> classColors(descriptions.size());
+
+	if( classColors.size() > 0 && !tensorNet::LoadClassColors(colors, classColors.data(), classColors.size(), defaultAlpha) )
+		return NULL;
+
+	classTable* table = build(descriptions, synsets, classColors.data(), key);
+
+	if( !table )
+		return NULL;
+
+	if( cacheable && table->save(cachePath) )
+		LogVerbose(LOG_TRT "saved %u classes to %s\n", table->GetNumClasses(), cachePath.c_str());
+
+	return table;
+}
+
+
+// Create
+classTable* classTable::Create( const std::vector<std::string>& descriptions, const std::vector<std::string>& synsets, const float4* colors )
+{
+	if( synsets.size() != descriptions.size() || (!colors && descriptions.size() > 0) )
+	{
+		LogError(LOG_TRT "classTable::Create() had invalid/mismatched parameters\n");
+		return NULL;
+	}
+
+	Header key;
+	memset(&key, 0, sizeof(Header));
+
+	return build(descriptions, synsets, colors, key);
+}
+
+
+// build
+classTable* classTable::build( const std::vector<std::string>& descriptions, const std::vector<std::string>& synsets, const float4* colors, const Header& key )
+{
+	const uint32_t numClasses = descriptions.size();
+
+	// the pool has the description, synset and label prefix of each class
+	size_t poolSize = 0;
+
+	for( uint32_t n=0; n < numClasses; n++ )
+		poolSize += descriptions[n].length() * 2 + synsets[n].length() + 4;
+
+	const size_t entriesSize = sizeof(Entry) * numClasses;
+
+	if( poolSize > UINT32_MAX )
+	{
+		LogError(LOG_TRT "classTable -- the class labels are too large (%zu bytes)\n", poolSize);
+		return NULL;
+	}
+
+	classTable* table = new classTable();
+	table->mData.resize(sizeof(Header) + entriesSize + poolSize);
+
+	char* data = table->mData.data();
+
+	Header* header = (Header*)data;
+	Entry* entries = (Entry*)(data + sizeof(Header));
+	char* pool = data + sizeof(Header) + entriesSize;
+
+	*header = key;
+
+	memcpy(header->magic, CLASS_TABLE_MAGIC, sizeof(header->magic));
+	header->version    = CLASS_TABLE_VERSION;
+	header->numClasses = numClasses;
+	header->poolSize   = poolSize;
+
+	uint32_t offset = 0;
+
+	for( uint32_t n=0; n < numClasses; n++ )
+	{
+		const std::string& desc = descriptions[n];
+		Entry& entry = entries[n];
+
+		entry.desc = offset;
+		entry.descLength = desc.length();
+		memcpy(pool + offset, desc.c_str(), desc.length() + 1);
+		offset += desc.length() + 1;
+
+		entry.synset = offset;
+		memcpy(pool + offset, synsets[n].c_str(), synsets[n].length() + 1);
+		offset += synsets[n].length() + 1;
+
+		entry.label = offset;
+		entry.labelLength = desc.length() + 1;
+		memcpy(pool + offset, desc.c_str(), desc.length());
+		pool[offset + desc.length()] = ' ';
+		pool[offset + desc.length() + 1] = 0;
+		offset += desc.length() + 2;
+
+		entry.color[0] = colors[n].x;
+		entry.color[1] = colors[n].y;
+		entry.color[2] = colors[n].z;
+		entry.color[3] = colors[n].w;
+	}
+
+	if( !table->init(data, table->mData.size()) )
+	{
+		delete table;
+		return NULL;
+	}
+
+	return table;
+}
+
+
+// map
+classTable* classTable::map( const std::string& path, const Header& key )
+{
+	const int fd = open(path.c_str(), O_RDONLY);
+
+	if( fd < 0 )
+		return NULL;
+
+	struct stat st;
+
+	if( fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(Header) )
+	{
+		close(fd);
+		return NULL;
+	}
+
+	void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if( data == MAP_FAILED )
+		return NULL;
+
+	classTable* table = new classTable();
+
+	table->mMapped = data;
+	table->mMappedSize = st.st_size;
+
+	const Header* header = (const Header*)data;
+
+	// the table is stale if the text files or the parameters changed
+	if( !table->init((const char*)data, st.st_size) ||
+	    header->expectedClasses != key.expectedClasses || memcmp(&header->defaultAlpha, &key.defaultAlpha, sizeof(float)) != 0 ||
+	    header->colorsHash != key.colorsHash || header->colorsSize != key.colorsSize || header->colorsTime != key.colorsTime ||
+	    header->labelsSize != key.labelsSize || header->labelsTime != key.labelsTime )
+	{
+		LogVerbose(LOG_TRT "classTable -- %s is out of date, rebuilding it\n", path.c_str());
+		delete table;
+		return NULL;
+	}
+
+	table->mCachePath = path;
+	return table;
+}
+
+
+// init
+bool classTable::init( const char* data, size_t size )
+{
+	const Header* header = (const Header*)data;
+
+	if( size < sizeof(Header) || memcmp(header->magic, CLASS_TABLE_MAGIC, sizeof(header->magic)) != 0 || header->version != CLASS_TABLE_VERSION )
+		return false;
+
+	if( size != sizeof(Header) + sizeof(Entry) * (size_t)header->numClasses + header->poolSize )
+		return false;
+
+	const Entry* entries = (const Entry*)(data + sizeof(Header));
+	const char* pool = data + sizeof(Header) + sizeof(Entry) * header->numClasses;
+
+	// make sure that all of the strings are inside the pool and terminated
+	const uint32_t poolSize = header->poolSize;
+
+	for( uint32_t n=0; n < header->numClasses; n++ )
+	{
+		const Entry& entry = entries[n];
+
+		if( entry.desc >= poolSize || entry.descLength >= poolSize - entry.desc || pool[entry.desc + entry.descLength] != 0 )
+			return false;
+
+		if( entry.label >= poolSize || entry.labelLength >= poolSize - entry.label || pool[entry.label + entry.labelLength] != 0 )
+			return false;
+
+		if( entry.synset >= poolSize || memchr(pool + entry.synset, 0, poolSize - entry.synset) == NULL )
+			return false;
+	}
+
+	mHeader  = header;
+	mEntries = entries;
+	mPool    = pool;
+
+	return true;
+}
+
+
+// save
+bool classTable::save( const std::string& path ) const
+{
+	const size_t size = sizeof(Header) + sizeof(Entry) * mHeader->numClasses + mHeader->poolSize;
+
+	// write to a temporary file first, so that processes loading the table never see it partially written
+	char tmpPath[1024];
+	snprintf(tmpPath, sizeof(tmpPath), "%s.%i.tmp", path.c_str(), (int)getpid());
+
+	FILE* file = fopen(tmpPath, "wb");
+
+	if( !file )
+	{
+		LogVerbose(LOG_TRT "classTable -- failed to open %s for writing (the class table won't be cached)\n", tmpPath);
+		return false;
+	}
+
+	const bool written = (fwrite(mHeader, 1, size, file) == size) && (fflush(file) == 0) && (fsync(fileno(file)) == 0);
+
+	fclose(file);
+
+	if( !written || rename(tmpPath, path.c_str()) != 0 )
+	{
+		LogVerbose(LOG_TRT "classTable -- failed to write %s\n", path.c_str());
+		unlink(tmpPath);
+		return false;
+	}
+
+	const_cast<classTable*>(this)->mCachePath = path;
+	return true;
+}
+
+
+// FormatLabel
+size_t classTable::FormatLabel( char* buffer, size_t size, uint32_t classID, int trackID, float confidence, uint32_t flags ) const
+{
+	if( !buffer || size == 0 )
+		return 0;
+
+	char* str = buffer;
+	char* end = buffer + size - 1;	// leave room for the terminator
+
+	if( flags & LABEL_CLASS )
+	{
+		const char* label = CLASS_TABLE_INVALID " ";
+		size_t length = sizeof(CLASS_TABLE_INVALID);
+
+		if( classID < mHeader->numClasses )
+		{
+			label  = mPool + mEntries[classID].label;
+			length = mEntries[classID].labelLength;
+		}
+
+		if( length > size_t(end - str) )
+			length = end - str;
+
+		memcpy(str, label, length);
+		str += length;
+	}
+
+	if( (flags & LABEL_TRACK) && trackID >= 0 )
+	{
+		char digits[16];
+		int numDigits = 0;
+		uint32_t value = trackID;
+
+		do
+		{
+			digits[numDigits++] = '0' + value % 10;
+			value /= 10;
+		}
+		while( value > 0 );
+
+		while( numDigits > 0 && str < end )
+			*str++ = digits[--numDigits];
+
+		if( str < end )
+			*str++ = ' ';
+	}
+
+	if( flags & LABEL_CONFIDENCE )
+		str += FormatPercent(str, end - str + 1, confidence * 100.0f);
+
+	*str = 0;
+	return str - buffer;
+}
+
+
+// FormatPercent
+size_t classTable::FormatPercent( char* buffer, size_t size, float percent )
+{
+	if( !buffer || size == 0 )
+		return 0;
+
+	char str[64];	// enough for FLT_MAX
+	size_t length = 0;
+
+	if( isfinite(percent) && fabsf(percent) < 1e9f )
+	{
+		// a float times 10 is exact as a double, so rint() rounds it the same way as printf
+		const uint64_t tenths = (uint64_t)rint(fabs((double)percent) * 10.0);
+
+		char digits[24];
+		int numDigits = 0;
+		uint64_t value = tenths / 10;
+
+		do
+		{
+			digits[numDigits++] = '0' + value % 10;
+			value /= 10;
+		}
+		while( value > 0 );
+
+		if( signbit(percent) )
+			str[length++] = '-';
+
+		while( numDigits > 0 )
+			str[length++] = digits[--numDigits];
+
+		str[length++] = '.';
+		str[length++] = '0' + tenths % 10;
+		str[length++] = '%';
+	}
+	else
+	{
+		const int count = snprintf(str, sizeof(str), "%.1f%%", percent);
+		length = (count > 0) ? std::min<size_t>(count, sizeof(str) - 1) : 0;
+	}
+
+	if( length > size - 1 )
+		length = size - 1;
+
+	memcpy(buffer, str, length);
+	buffer[length] = 0;
+
+	return length;
+}
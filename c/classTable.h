@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __CLASS_TABLE_H__
+#define __CLASS_TABLE_H__
+
+
+#include "cudaUtility.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+/**
+ * File extension of the binary class tables that are cached next to the class labels.
+ * @ingroup tensorNet
+ */
+#define CLASS_TABLE_EXTENSION ".classtable"
+
+/**
+ * Description that is returned for class indices that are out of range.
+ * @ingroup tensorNet
+ */
+#define CLASS_TABLE_INVALID "Invalid"
+
+
+/**
+ * Immutable table of the class labels, synsets and colors of a network.
+ *
+ * The table is compiled once from the class label and color text files (with
+ * tensorNet::LoadClassLabels() and tensorNet::LoadClassColors(), so the defaults
+ * that those fill in are the same), into one contiguous block:  a header, an entry
+ * for each class, and a pool with the strings of all of the classes.  Along with
+ * the description, each entry has the label prefix that the overlays start with
+ * (the description followed by a space), so those don't need to be formatted
+ * again for every detection.
+ *
+ * The block is saved next to the class labels, as `<labels>.classtable`, and the
+ * next time that the same labels and colors are loaded it's mmap'd from there
+ * instead of parsing the text files.  The file is rebuilt when the size or the
+ * modification time of either text file changes.
+ *
+ * @ingroup tensorNet
+ */
+class classTable
+{
+public:
+	/**
+	 * Label formatting flags (can be OR'd together).
+	 */
+	enum LabelFlags
+	{
+		LABEL_CLASS      = (1 << 0),	/**< Start with the class description */
+		LABEL_TRACK      = (1 << 1),	/**< Add the track ID (if it isn't negative) */
+		LABEL_CONFIDENCE = (1 << 2)	/**< Add the confidence as a percentage */
+	};
+
+	/**
+	 * Load the table of class labels and colors, from the cached binary table if it's
+	 * up-to-date, or otherwise from the text files (and then update the cache).
+	 *
+	 * @param labels path to the class labels (or NULL to generate them).
+	 * @param colors path to the class colors (or NULL to generate them).
+	 * @param expectedClasses the number of classes the network has, or -1 if it should
+	 *                        be taken from the labels.  If fewer labels or colors than
+	 *                        this are loaded, the rest of them are generated.
+	 * @param defaultAlpha the alpha value of colors that don't specify one.
+	 *
+	 * @returns the table, or NULL if no labels were loaded and expectedClasses was -1.
+	 */
+	static classTable* Load( const char* labels, const char* colors, int expectedClasses=-1, float defaultAlpha=255.0f );
+
+	/**
+	 * Compile a table from class descriptions, synsets and colors that are already loaded.
+	 * The synsets and colors arrays should have the same number of elements as the descriptions.
+	 */
+	static classTable* Create( const std::vector<std::string>& descriptions, const std::vector<std::string>& synsets, const float4* colors );
+
+	/**
+	 * Destructor
+	 */
+	~classTable();
+
+	/**
+	 * Return the number of classes in the table.
+	 */
+	inline uint32_t GetNumClasses() const						{ return mHeader->numClasses; }
+
+	/**
+	 * Return the description of a class, or "Invalid" if the index is out of range.
+	 */
+	inline const char* GetDesc( uint32_t index ) const				{ return (index < mHeader->numClasses) ? mPool + mEntries[index].desc : CLASS_TABLE_INVALID; }
+
+	/**
+	 * Return the synset of a class, or "Invalid" if the index is out of range.
+	 */
+	inline const char* GetSynset( uint32_t index ) const			{ return (index < mHeader->numClasses) ? mPool + mEntries[index].synset : CLASS_TABLE_INVALID; }
+
+	/**
+	 * Return the color of a class.  The index should be in range.
+	 */
+	inline float4 GetColor( uint32_t index ) const					{ const float* c = mEntries[index].color; return make_float4(c[0], c[1], c[2], c[3]); }
+
+	/**
+	 * Return the label prefix of a class (the description followed by a space).
+	 */
+	inline const char* GetLabel( uint32_t index ) const				{ return (index < mHeader->numClasses) ? mPool + mEntries[index].label : CLASS_TABLE_INVALID " "; }
+
+	/**
+	 * Return the path of the binary table that was loaded or saved (or an empty string).
+	 */
+	inline const char* GetCachePath() const						{ return mCachePath.c_str(); }
+
+	/**
+	 * Return true if the table was mapped from the binary cache.
+	 */
+	inline bool IsCached() const								{ return mMapped != NULL; }
+
+	/**
+	 * Format the overlay label of a detection into a buffer, without printf.
+	 * The output is the same as `"%s "` for the class description, `"%i "` for the track ID
+	 * and `"%.1f%%"` for the confidence, but the class prefix is copied from the table.
+	 *
+	 * @param buffer the output string, which is always NUL-terminated (and truncated if it doesn't fit).
+	 * @param size the size of the buffer (in bytes).
+	 * @param classID index of the class (out of range classes are labelled as "Invalid").
+	 * @param trackID the track ID, which is only added with LABEL_TRACK if it isn't negative.
+	 * @param confidence the confidence (0-1), which is scaled to a percentage.
+	 * @param flags the parts of the label to include (@see LabelFlags)
+	 *
+	 * @returns the length of the string.
+	 */
+	size_t FormatLabel( char* buffer, size_t size, uint32_t classID, int trackID, float confidence, uint32_t flags ) const;
+
+	/**
+	 * Format a confidence percentage with one decimal and a percent sign, like `"%.1f%%"`.
+	 * @returns the length of the string (not including the NUL terminator).
+	 */
+	static size_t FormatPercent( char* buffer, size_t size, float percent );
+
+protected:
+
+	struct Header
+	{
+		char     magic[8];
+		uint32_t version;
+		uint32_t numClasses;
+		uint32_t poolSize;
+		int32_t  expectedClasses;
+		float    defaultAlpha;
+		uint32_t colorsHash;		// hash of the path of the colors file
+		uint64_t labelsSize;		// size and modification time (in ns) of the text files
+		uint64_t labelsTime;
+		uint64_t colorsSize;
+		uint64_t colorsTime;
+	};
+
+	struct Entry
+	{
+		uint32_t desc;			// offsets of the strings in the pool
+		uint32_t synset;
+		uint32_t label;
+		uint32_t descLength;
+		uint32_t labelLength;
+		float    color[4];
+	};
+
+	classTable();
+
+	bool init( const char* data, size_t size );
+
+	static classTable* build( const std::vector<std::string>& descriptions, const std::vector<std::string>& synsets, const float4* colors, const Header& key );
+	static classTable* map( const std::string& path, const Header& key );
+
+	bool save( const std::string& path ) const;
+
+	const Header* mHeader;
+	const Entry*  mEntries;
+	const char*   mPool;
+
+	void*  mMapped;		// the mmap'd cache file (if it was loaded from the cache)
+	size_t mMappedSize;
+
+	std::vector<char> mData;	// the table (if it was compiled from the text files)
+	std::string mCachePath;
+};
+
+
+#endif
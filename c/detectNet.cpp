@@ -55,6 +55,7 @@ detectNet::detectNet( float meanPixel ) : tensorNet()
 
 	mNumClasses  = 0;
 	mClassColors = NULL;
+	mClassTable  = NULL;
 	
 	mDetectionSets = NULL;
 	mDetectionSet  = 0;
@@ -73,6 +74,7 @@ detectNet::~detectNet()
 	
 	CUDA_FREE_HOST(mDetectionSets);
 	CUDA_FREE_HOST(mClassColors);
+	SAFE_DELETE(mClassTable);
 }
 
 
@@ -138,8 +140,7 @@ bool detectNet::init( const char* prototxt, const char* model, const char* class
 		return false;
 
 	// load class descriptions
-	loadClassInfo(class_labels);
-	loadClassColors(class_colors);
+	loadClassInfo(class_labels, class_colors);
 
 	// set the specified threshold
 	SetConfidenceThreshold(threshold);
@@ -234,8 +235,7 @@ detectNet* detectNet::Create( const char* model, const char* class_labels, float
 		return NULL;
 
 	// load class descriptions
-	net->loadClassInfo(class_labels);
-	net->loadClassColors(NULL);
+	net->loadClassInfo(class_labels, NULL);
 
 	// set the specified threshold
 	net->SetConfidenceThreshold(threshold);
@@ -439,27 +439,40 @@ bool detectNet::allocDetections()
 
 
 // loadClassInfo
-bool detectNet::loadClassInfo( const char* filename )
+bool detectNet::loadClassInfo( const char* labels, const char* colors )
 {
-	if( !LoadClassLabels(filename, mClassDesc, mClassSynset, mNumClasses) )
-		return false;
+	SAFE_DELETE(mClassTable);
+	CUDA_FREE_HOST(mClassColors);
 
-	if( IsModelType(MODEL_UFF) )
-		mNumClasses = mClassDesc.size();
+	// load the labels and colors from the cached class table (or compile it from the text files)
+	mClassTable = classTable::Load(labels, colors, mNumClasses, DETECTNET_DEFAULT_ALPHA);
 
-	LogInfo(LOG_TRT "detectNet -- number of object classes:  %u\n", mNumClasses);
-	
-	if( filename != NULL )
-		mClassPath = locateFile(filename);	
+	const bool loaded = (mClassTable != NULL);
+
+	if( loaded )
+	{
+		if( IsModelType(MODEL_UFF) )
+			mNumClasses = mClassTable->GetNumClasses();
+
+		LogInfo(LOG_TRT "detectNet -- number of object classes:  %u\n", mNumClasses);
 	
-	return true;
-}
+		if( labels != NULL )
+			mClassPath = locateFile(labels);	
+	}
+	else
+	{
+		// an empty table, where all of the classes are invalid
+		mClassTable = classTable::Create(std::vector<std::string>(), std::vector<std::string>(), NULL);
+	}
 
+	// the colors are copied to shared memory, where the overlay kernels can access them
+	if( mNumClasses == 0 || !cudaAllocMapped((void**)&mClassColors, mNumClasses * sizeof(float4)) )
+		return false;
 
-// loadClassColors
-bool detectNet::loadClassColors( const char* filename )
-{
-	return LoadClassColors(filename, &mClassColors, mNumClasses, DETECTNET_DEFAULT_ALPHA);
+	for( uint32_t n=0; n < mNumClasses; n++ )
+		mClassColors[n] = (n < mClassTable->GetNumClasses()) ? mClassTable->GetColor(n) : GenerateColor(n, DETECTNET_DEFAULT_ALPHA);
+
+	return loaded;
 }
 
 
@@ -614,6 +627,8 @@ int detectNet::postProcess( void* input, uint32_t width, uint32_t height, imageF
 	// parse the bounding boxes
 	int numDetections = 0;
 
+	mClusterGrid.Reset(width, height);
+
 	if( IsModelType(MODEL_UFF) )	
 		numDetections = postProcessSSD_UFF(detections, width, height);
 	else if( IsModelType(MODEL_ONNX) )
@@ -806,16 +821,7 @@ int detectNet::postProcessDetectNet( Detection* detections, uint32_t width, uint
 			#endif		
 
 				// merge with list, checking for overlaps
-				bool detectionMerged = false;
-
-				for( uint32_t n=0; n < numDetections; n++ )
-				{
-					if( detections[n].ClassID == z && detections[n].Expand(x1, y1, x2, y2) )
-					{
-						detectionMerged = true;
-						break;
-					}
-				}
+				const bool detectionMerged = mClusterGrid.Expand(detections, numDetections, z, x1, y1, x2, y2);
 
 				// create new entry if the detection wasn't merged with another detection
 				if( !detectionMerged )
@@ -829,6 +835,7 @@ int detectNet::postProcessDetectNet( Detection* detections, uint32_t width, uint
 					detections[numDetections].Right  = x2;
 					detections[numDetections].Bottom = y2;
 				
+					mClusterGrid.Insert(numDetections, x1, y1, x2, y2);
 					numDetections++;
 				}
 			}
@@ -977,66 +984,16 @@ int detectNet::postProcessDetectNet_v2( Detection* detections, uint32_t width, u
 // clusterDetections
 int detectNet::clusterDetections( Detection* detections, int n )
 {
-	if( n == 0 )
-		return 1;
-
-	// test each detection to see if it intersects
-	for( int m=0; m < n; m++ )
-	{
-		if( detections[n].Intersects(detections[m], mClusteringThreshold) )	// TODO NMS or different threshold for same classes?
-		{
-			// if the intersecting detections have different classes, pick the one with highest confidence
-			// otherwise if they have the same object class, expand the detection bounding box
-		#ifdef CLUSTER_INTERCLASS
-			if( detections[n].ClassID != detections[m].ClassID )
-			{
-				if( detections[n].Confidence > detections[m].Confidence )
-				{
-					detections[m] = detections[n];
-
-					detections[m].TrackID = -1; //m;
-					detections[m].ClassID = detections[n].ClassID;
-					detections[m].Confidence = detections[n].Confidence;	
-				}
-				
-				return 0; // merged detection
-			}
-			else
-		#else
-			if( detections[n].ClassID == detections[m].ClassID )
-		#endif
-			{
-				detections[m].Expand(detections[n]);
-				detections[m].Confidence = fmaxf(detections[n].Confidence, detections[m].Confidence);
-
-				return 0; // merged detection
-			}
-		}
-	}
-
-	return 1;	// new detection
+	// only the detections near this one are tested (in the same order as before)
+	return mClusterGrid.Cluster(detections, n, mClusteringThreshold);	// TODO NMS or different threshold for same classes?
 }
 
 
 // sortDetections (by area)
 void detectNet::sortDetections( Detection* detections, int numDetections )
 {
-	if( numDetections < 2 )
-		return;
-
-	// order by area (descending) or confidence (ascending)
-	for( int i=0; i < numDetections-1; i++ )
-	{
-		for( int j=0; j < numDetections-i-1; j++ )
-		{
-			if( detections[j].Area() < detections[j+1].Area() ) //if( detections[j].Confidence > detections[j+1].Confidence )
-			{
-				const Detection det = detections[j];
-				detections[j] = detections[j+1];
-				detections[j+1] = det;
-			}
-		}
-	}
+	// order by area (descending), keeping detections of equal area in order
+	detectionGrid::SortByArea(detections, numDetections);
 
 	// renumber the instance ID's
 	//for( int i=0; i < numDetections; i++ )
@@ -1119,23 +1076,17 @@ bool detectNet::Overlay( void* input, void* output, uint32_t width, uint32_t hei
 	#ifdef BATCH_TEXT
 		std::vector<std::pair<std::string, int2>> labels;
 	#endif 
+		// the class prefixes of the labels are pre-rendered in the class table
+		const uint32_t labelFlags = ((flags & OVERLAY_LABEL) ? classTable::LABEL_CLASS : 0) |
+							   ((flags & OVERLAY_TRACKING) ? classTable::LABEL_TRACK : 0) |
+							   ((flags & OVERLAY_CONFIDENCE) ? classTable::LABEL_CONFIDENCE : 0);
+
 		for( uint32_t n=0; n < numDetections; n++ )
 		{
-			const char* className  = GetClassDesc(detections[n].ClassID);
-			const float confidence = detections[n].Confidence * 100.0f;
-			const int2  position   = make_int2(detections[n].Left+5, detections[n].Top+3);
+			const int2 position = make_int2(detections[n].Left+5, detections[n].Top+3);
 			
 			char buffer[256];
-			char* str = buffer;
-			
-			if( flags & OVERLAY_LABEL )
-				str += sprintf(str, "%s ", className);
-			
-			if( flags & OVERLAY_TRACKING && detections[n].TrackID >= 0 )
-				str += sprintf(str, "%i ", detections[n].TrackID);
-			
-			if( flags & OVERLAY_CONFIDENCE )
-				str += sprintf(str, "%.1f%%", confidence);
+			mClassTable->FormatLabel(buffer, sizeof(buffer), detections[n].ClassID, detections[n].TrackID, detections[n].Confidence, labelFlags);
 
 		#ifdef BATCH_TEXT
 			labels.push_back(std::pair<std::string, int2>(buffer, position));
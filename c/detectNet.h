@@ -25,6 +25,8 @@
 
 
 #include "tensorNet.h"
+#include "classTable.h"
+#include "detectionGrid.h"
 
 
 /**
@@ -460,14 +462,14 @@ public:
 	inline const char* GetClassLabel( uint32_t index ) const		{ return GetClassDesc(index); }
 	
 	/**
-	 * Retrieve the description of a particular class.
+	 * Retrieve the description of a particular class (or "Invalid" if the index is out of range).
 	 */
-	inline const char* GetClassDesc( uint32_t index )	const		{ if(index >= mClassDesc.size()) { printf("invalid class %u\n", index); return "Invalid"; } return mClassDesc[index].c_str(); }
+	inline const char* GetClassDesc( uint32_t index )	const		{ return mClassTable->GetDesc(index); }
 	
 	/**
 	 * Retrieve the class synset category of a particular class.
 	 */
-	inline const char* GetClassSynset( uint32_t index ) const		{ return mClassSynset[index].c_str(); }
+	inline const char* GetClassSynset( uint32_t index ) const		{ return mClassTable->GetSynset(index); }
 	
 	/**
  	 * Retrieve the path to the file containing the class descriptions.
@@ -516,8 +518,7 @@ protected:
 
 	bool allocDetections();
 
-	bool loadClassInfo( const char* filename );
-	bool loadClassColors( const char* filename );
+	bool loadClassInfo( const char* labels, const char* colors );
 	
 	bool init( const char* prototxt_path, const char* model_path, const char* class_labels, const char* class_colors,
 			 float threshold, const char* input, const char* coverage, const char* bboxes, uint32_t maxBatchSize, 
@@ -536,6 +537,7 @@ protected:
 	void sortDetections( Detection* detections, int numDetections );
 
 	objectTracker* mTracker;
+	detectionGrid  mClusterGrid;	// spatial index of the detections being clustered
 	
 	float mConfidenceThreshold;	 // TODO change this to per-class
 	float mClusteringThreshold;	 // TODO change this to per-class
@@ -546,8 +548,7 @@ protected:
 	
 	float4* mClassColors;
 	
-	std::vector<std::string> mClassDesc;
-	std::vector<std::string> mClassSynset;
+	classTable* mClassTable;
 
 	std::string mClassPath;
 	uint32_t	  mNumClasses;
@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "detectionCascade.h"
+#include "logging.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <algorithm>
+#include <string>
+
+
+// Options constructor
+detectionCascade::Options::Options()
+{
+	refreshFrames = 15;
+	padding       = 0.0f;
+	minSize       = 16;
+}
+
+
+// constructor
+detectionCascade::detectionCascade( imageNet* classifier, const Options& options, bool ownsClassifier ) : mOptions(options)
+{
+	mClassifier     = classifier;
+	mOwnsClassifier = ownsClassifier;
+	mFrame          = 0;
+	mClassified     = 0;
+	mReused         = 0;
+
+	for( size_t n=0; n < options.classes.size(); n++ )
+	{
+		if( options.classes[n] >= mSelected.size() )
+			mSelected.resize(options.classes[n] + 1, false);
+
+		mSelected[options.classes[n]] = true;
+	}
+}
+
+
+// destructor
+detectionCascade::~detectionCascade()
+{
+	if( mOwnsClassifier )
+		SAFE_DELETE(mClassifier);
+}
+
+
+// Create
+detectionCascade* detectionCascade::Create( imageNet* classifier, const Options& options )
+{
+	if( !classifier )
+	{
+		LogError("detectionCascade -- classifier was NULL\n");
+		return NULL;
+	}
+
+	if( options.padding < 0.0f || !isfinite(options.padding) )
+	{
+		LogError("detectionCascade -- invalid padding (%g)\n", options.padding);
+		return NULL;
+	}
+
+	LogVerbose("detectionCascade -- batch size %u, %zu selected classes, refresh every %u frames\n",
+			 classifier->GetMaxBatchSize(), options.classes.size(), options.refreshFrames);
+
+	return new detectionCascade(classifier, options, false);
+}
+
+
+// parse the list of classes to classify (as class IDs or labels of the detector)
+static bool parseClasses( const char* str, const yoloNet* detector, std::vector<uint32_t>& classes )
+{
+	const std::string list = str;
+	size_t start = 0;
+
+	while( start <= list.size() )
+	{
+		size_t end = list.find(',', start);
+
+		if( end == std::string::npos )
+			end = list.size();
+
+		const std::string token = list.substr(start, end - start);
+		start = end + 1;
+
+		if( token.size() == 0 )
+			continue;
+
+		char* tokenEnd = NULL;
+		const unsigned long classID = strtoul(token.c_str(), &tokenEnd, 10);
+
+		if( tokenEnd != token.c_str() && *tokenEnd == '\0' )
+		{
+			classes.push_back(classID);
+			continue;
+		}
+
+		bool found = false;
+
+		if( detector != NULL )
+		{
+			for( uint32_t n=0; n < detector->GetNumClasses(); n++ )
+			{
+				if( strcasecmp(detector->GetClassDesc(n), token.c_str()) == 0 )
+				{
+					classes.push_back(n);
+					found = true;
+				}
+			}
+		}
+
+		if( !found )
+		{
+			LogError("detectionCascade -- '%s' from --cascade-classes isn't a class of the detector\n", token.c_str());
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+// Create
+detectionCascade* detectionCascade::Create( const commandLine& cmdLine, const yoloNet* detector )
+{
+	const char* model = cmdLine.GetString("cascade-model");
+
+	if( !model )
+		return NULL;
+
+	Options options;
+
+	options.refreshFrames = cmdLine.GetUnsignedInt("cascade-refresh", options.refreshFrames);
+	options.padding       = cmdLine.GetFloat("cascade-padding", options.padding);
+	options.minSize       = cmdLine.GetUnsignedInt("cascade-min-size", options.minSize);
+
+	const char* classes = cmdLine.GetString("cascade-classes");
+
+	if( classes != NULL && !parseClasses(classes, detector, options.classes) )
+		return NULL;
+
+	imageNet* classifier = imageNet::Create(NULL, model, NULL, cmdLine.GetString("cascade-labels"),
+									cmdLine.GetString("cascade-input-blob", DETECTION_CASCADE_DEFAULT_INPUT),
+									cmdLine.GetString("cascade-output-blob", DETECTION_CASCADE_DEFAULT_OUTPUT),
+									cmdLine.GetUnsignedInt("cascade-batch", 8));
+
+	if( !classifier )
+	{
+		LogError("detectionCascade -- failed to load classifier '%s'\n", model);
+		return NULL;
+	}
+
+	classifier->SetThreshold(cmdLine.GetFloat("cascade-threshold", 0.01f));
+
+	detectionCascade* cascade = Create(classifier, options);
+
+	if( !cascade )
+	{
+		delete classifier;
+		return NULL;
+	}
+
+	cascade->mOwnsClassifier = true;
+	return cascade;
+}
+
+
+// Process
+int detectionCascade::Process( void* image, uint32_t width, uint32_t height, imageFormat format, const yoloNet::Detection* detections, int numDetections )
+{
+	if( numDetections < 0 || (numDetections > 0 && !detections) )
+	{
+		LogError("detectionCascade::Process() -- invalid detections (%i)\n", numDetections);
+		return -1;
+	}
+
+	mFrame++;
+
+	const Result unclassified = { -1, 0.0f, -1 };
+	mResults.assign(numDetections, unclassified);
+
+	mROIs.clear();
+	mPending.clear();
+
+	const float minSize = (float)mOptions.minSize;
+
+	for( int n=0; n < numDetections; n++ )
+	{
+		const yoloNet::Detection& det = detections[n];
+
+		if( !IsSelected(det.ClassID) )
+			continue;
+
+		if( !isfinite(det.Left) || !isfinite(det.Top) || !isfinite(det.Right) || !isfinite(det.Bottom) )
+			continue;
+
+		const float w = det.Width();
+		const float h = det.Height();
+
+		if( w < minSize || h < minSize )
+			continue;
+
+		// reuse the result of a tracked object while it's still fresh
+		if( det.TrackID >= 0 )
+		{
+			std::map<int, Track>::iterator track = mTracks.find(det.TrackID);
+
+			if( track != mTracks.end() && track->second.detectClass == det.ClassID
+			    && mFrame - track->second.classified < mOptions.refreshFrames )
+			{
+				mResults[n] = track->second.result;
+				mResults[n].Age = mFrame - track->second.classified;
+				track->second.seen = mFrame;
+				mReused++;
+				continue;
+			}
+		}
+
+		const float padX = w * mOptions.padding;
+		const float padY = h * mOptions.padding;
+
+		// the ROI is clipped to the image by imageNet::ClassifyBatch()
+		const int4 roi = make_int4(std::max(floorf(det.Left - padX), -1.0f),
+							  std::max(floorf(det.Top - padY), -1.0f),
+							  std::min(ceilf(det.Right + padX), (float)width + 1.0f),
+							  std::min(ceilf(det.Bottom + padY), (float)height + 1.0f));
+
+		mROIs.push_back(roi);
+		mPending.push_back(n);
+	}
+
+	const uint32_t numROIs = mROIs.size();
+
+	if( numROIs > 0 )
+	{
+		mClasses.resize(numROIs);
+		mConfidence.resize(numROIs);
+
+		if( mClassifier->ClassifyBatch(image, width, height, format, mROIs.data(), numROIs, mClasses.data(), mConfidence.data()) < 0 )
+		{
+			LogError("detectionCascade::Process() -- failed to classify %u objects\n", numROIs);
+			return -1;
+		}
+
+		for( uint32_t i=0; i < numROIs; i++ )
+		{
+			const int n = mPending[i];
+
+			Result& result = mResults[n];
+
+			result.ClassID    = mClasses[i];
+			result.Confidence = mConfidence[i];
+			result.Age        = 0;
+
+			const int trackID = detections[n].TrackID;
+
+			if( trackID < 0 )
+				continue;
+
+			Track& track = mTracks[trackID];
+
+			track.result      = result;
+			track.detectClass = detections[n].ClassID;
+			track.classified  = mFrame;
+			track.seen        = mFrame;
+		}
+
+		mClassified += numROIs;
+	}
+
+	// forget the objects that haven't been seen for a while
+	for( std::map<int, Track>::iterator track = mTracks.begin(); track != mTracks.end(); )
+	{
+		if( mFrame - track->second.seen > mOptions.refreshFrames )
+			mTracks.erase(track++);
+		else
+			++track;
+	}
+
+	return numROIs;
+}
+
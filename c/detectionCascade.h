@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __DETECTION_CASCADE_H__
+#define __DETECTION_CASCADE_H__
+
+
+#include "yoloNet.h"
+#include "imageNet.h"
+#include "commandLine.h"
+
+#include <map>
+#include <vector>
+
+
+/**
+ * Default name of the input layer of the classifier that detectionCascade loads (from an ONNX model).
+ * @ingroup detectionCascade
+ */
+#define DETECTION_CASCADE_DEFAULT_INPUT   "input_0"
+
+/**
+ * Default name of the output layer of the classifier that detectionCascade loads (from an ONNX model).
+ * @ingroup detectionCascade
+ */
+#define DETECTION_CASCADE_DEFAULT_OUTPUT  "output_0"
+
+/**
+ * Standard command-line options able to be passed to detectionCascade::Create()
+ * @ingroup detectionCascade
+ */
+#define DETECTION_CASCADE_USAGE_STRING  "detectionCascade arguments: \n" 	\
+		  "  --cascade-model=MODEL          classification model to run on the detected objects\n"	\
+		  "                                 (enables the cascade)\n"								\
+		  "  --cascade-labels=LABELS        path to the class labels of the classification model\n"	\
+		  "  --cascade-input-blob=INPUT     name of the input layer (default is '" DETECTION_CASCADE_DEFAULT_INPUT "')\n"		\
+		  "  --cascade-output-blob=OUTPUT   name of the output layer (default is '" DETECTION_CASCADE_DEFAULT_OUTPUT "')\n"	\
+		  "  --cascade-batch=N              maximum batch size of the classifier, for models without\n"	\
+		  "                                 a fixed batch size (default: 8)\n"						\
+		  "  --cascade-classes=CLASSES      detection classes to classify, as labels or class IDs\n"	\
+		  "                                 (e.g. --cascade-classes=person,2, default: all of them)\n"	\
+		  "  --cascade-threshold=CONF       minimum confidence of the classifier (default: 0.01)\n"	\
+		  "  --cascade-refresh=FRAMES       number of frames that the result of a tracked object is\n"	\
+		  "                                 reused for before it's classified again (default: 15)\n"	\
+		  "  --cascade-padding=FRACTION     fraction of their size that the bounding boxes are\n"		\
+		  "                                 expanded by on each side (default: 0)\n"				\
+		  "  --cascade-min-size=PIXELS      minimum width and height of the objects that are\n"		\
+		  "                                 classified (default: 16)\n\n"
+
+
+/**
+ * Secondary classification stage that runs an imageNet classifier on the objects found by a detector.
+ *
+ * Each frame, the bounding boxes of the detections of the selected classes are gathered and
+ * passed to imageNet::ClassifyBatch(), which crops and resizes all of them into the batch tensor
+ * with one kernel, and classifies the batch with one inference (instead of a crop, resize and
+ * Classify() for each object).  The results are kept in an array parallel to the detections:
+ *
+ *    numDetections = net->Detect(image, width, height, &detections, yoloNet::OVERLAY_NONE);
+ *    cascade->Process(image, width, height, detections, numDetections);
+ *
+ *    for( int n=0; n < numDetections; n++ )
+ *    {
+ *        const detectionCascade::Result& result = cascade->GetResult(n);
+ *
+ *        if( result.ClassID >= 0 )
+ *            printf("%s is %s\n", net->GetClassDesc(detections[n].ClassID), cascade->GetClassDesc(n));
+ *    }
+ *
+ * Tracked objects (the ones with a track ID from objectTracker) are only classified again once
+ * their result is `refreshFrames` old, or if the detector changed their class.  Until then the
+ * result from the last time they were classified is reused.  The overlay should be drawn after
+ * Process(), so that it isn't in the crops that get classified.
+ *
+ * @ingroup detectionCascade
+ */
+class detectionCascade
+{
+public:
+	/**
+	 * Cascade settings.
+	 */
+	struct Options
+	{
+		std::vector<uint32_t> classes;	/**< detection classes to classify (or empty for all of them) */
+		uint32_t refreshFrames;		/**< number of frames that the result of a tracked object is reused for */
+		float    padding;			/**< fraction of their size that the bounding boxes are expanded by */
+		uint32_t minSize;			/**< minimum width and height of the objects that are classified (in pixels) */
+
+		Options();
+	};
+
+	/**
+	 * Result of the classifier for a detection.
+	 */
+	struct Result
+	{
+		int   ClassID;		/**< Class of the classifier (or -1 if the object wasn't classified, or no class met the threshold) */
+		float Confidence;	/**< Confidence of the class */
+		int   Age;			/**< Number of frames since the object was classified (or -1 if it wasn't classified) */
+	};
+
+	/**
+	 * Create a new cascade with a classifier that was already loaded (which it doesn't take ownership of).
+	 */
+	static detectionCascade* Create( imageNet* classifier, const Options& options=Options() );
+
+	/**
+	 * Create a new cascade by parsing the command line, which loads the classifier from `--cascade-model`.
+	 * @param detector the detector, whose class labels can be used in `--cascade-classes`.
+	 * @returns NULL if `--cascade-model` wasn't specified, or there was an error.
+	 */
+	static detectionCascade* Create( const commandLine& cmdLine, const yoloNet* detector=NULL );
+
+	/**
+	 * Destroy the cascade (and the classifier, if it was loaded from the command line).
+	 */
+	~detectionCascade();
+
+	/**
+	 * Classify the detected objects in the image, with batched inference.
+	 * @returns the number of objects that were classified in this frame (the others are either not
+	 *          selected, or had a result that was reused), or -1 if there was an error.
+	 */
+	template<typename T> int Process( T* image, uint32_t width, uint32_t height, const yoloNet::Detection* detections, int numDetections )		{ return Process((void*)image, width, height, imageFormatFromType<T>(), detections, numDetections); }
+
+	/**
+	 * Classify the detected objects in the image, with batched inference.
+	 * @returns the number of objects that were classified in this frame (the others are either not
+	 *          selected, or had a result that was reused), or -1 if there was an error.
+	 */
+	int Process( void* image, uint32_t width, uint32_t height, imageFormat format, const yoloNet::Detection* detections, int numDetections );
+
+	/**
+	 * Get the results of the detections from the last call to Process().
+	 */
+	inline const Result* GetResults() const				{ return mResults.data(); }
+
+	/**
+	 * Get the result of a detection from the last call to Process().
+	 */
+	inline const Result& GetResult( int n ) const			{ return mResults[n]; }
+
+	/**
+	 * Get the description of the class of a detection's result (or NULL if it doesn't have one).
+	 */
+	inline const char* GetClassDesc( int n ) const			{ return (mResults[n].ClassID >= 0) ? mClassifier->GetClassDesc(mResults[n].ClassID) : NULL; }
+
+	/**
+	 * Return true if detections of the class are classified.
+	 */
+	inline bool IsSelected( uint32_t classID ) const		{ return mOptions.classes.size() == 0 || (classID < mSelected.size() && mSelected[classID]); }
+
+	/**
+	 * Get the classifier.
+	 */
+	inline imageNet* GetClassifier() const					{ return mClassifier; }
+
+	/**
+	 * Get the fraction of the selected objects whose results were reused (since the cascade was created).
+	 */
+	inline float GetReuseRatio() const					{ return (mClassified + mReused) > 0 ? float(mReused) / float(mClassified + mReused) : 0.0f; }
+
+	/**
+	 * Get the settings of the cascade.
+	 */
+	inline const Options& GetOptions() const			{ return mOptions; }
+
+	/**
+	 * Usage string for command line arguments to Create()
+	 */
+	static inline const char* Usage() 				{ return DETECTION_CASCADE_USAGE_STRING; }
+
+protected:
+	detectionCascade( imageNet* classifier, const Options& options, bool ownsClassifier );
+
+	struct Track
+	{
+		Result   result;
+		uint32_t detectClass;	// class of the detector when the object was classified
+		uint64_t classified;	// frame that the object was classified on
+		uint64_t seen;			// frame that the object was last detected on
+	};
+
+	imageNet* mClassifier;
+	bool      mOwnsClassifier;
+
+	Options mOptions;
+
+	std::vector<bool>   mSelected;		// lookup table of the selected classes
+	std::vector<Result> mResults;		// results of the detections from the last frame
+
+	std::vector<int4>  mROIs;			// bounding boxes of the objects to classify
+	std::vector<int>   mPending;		// index of the detection of each ROI
+	std::vector<int>   mClasses;
+	std::vector<float> mConfidence;
+
+	std::map<int, Track> mTracks;		// last results of tracked objects, by track ID
+
+	uint64_t mFrame;
+	uint64_t mClassified;
+	uint64_t mReused;
+};
+
+
+#endif
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "detectionGrid.h"
+
+
+// constructor
+detectionGrid::detectionGrid( uint32_t cells )
+{
+	mCells   = std::max<uint32_t>(cells, 1);
+	mMaxSpan = mCells / 4;	// larger boxes would make every search cover most of the grid
+	mScaleX  = 0.0f;
+	mScaleY  = 0.0f;
+	mSpanX   = 0;
+	mSpanY   = 0;
+	mCount   = 0;
+
+	mGrid.resize(mCells * mCells);
+}
+
+
+// Reset
+void detectionGrid::Reset( float width, float height )
+{
+	// with an unknown size, everything lands in the same cell
+	mScaleX = (width > 0.0f) ? mCells / width : 0.0f;
+	mScaleY = (height > 0.0f) ? mCells / height : 0.0f;
+
+	Clear();
+}
+
+
+// Clear
+void detectionGrid::Clear()
+{
+	for( int n=0; n < mCount; n++ )
+	{
+		if( mDetectionCells[n] >= 0 )
+			mGrid[mDetectionCells[n]].clear();
+	}
+
+	mDetectionCells.clear();
+	mLarge.clear();
+
+	mSpanX = 0;
+	mSpanY = 0;
+	mCount = 0;
+}
+
+
+// cellX
+inline int detectionGrid::cellX( float x ) const
+{
+	// the cell is monotonic in x, so boxes that overlap always have overlapping cells
+	const float cell = floorf(x * mScaleX);
+
+	if( !(cell > 0.0f) )
+		return 0;
+
+	if( cell >= mCells - 1 )
+		return mCells - 1;
+
+	return (int)cell;
+}
+
+
+// cellY
+inline int detectionGrid::cellY( float y ) const
+{
+	const float cell = floorf(y * mScaleY);
+
+	if( !(cell > 0.0f) )
+		return 0;
+
+	if( cell >= mCells - 1 )
+		return mCells - 1;
+
+	return (int)cell;
+}
+
+
+// cellRange
+bool detectionGrid::cellRange( float left, float top, float right, float bottom, CellRange& range ) const
+{
+	if( isnan(left) || isnan(top) || isnan(right) || isnan(bottom) )
+		return false;
+
+	// an inverted box can still overlap the boxes that contain it
+	range.x1 = cellX(fminf(left, right));
+	range.x2 = cellX(fmaxf(left, right));
+	range.y1 = cellY(fminf(top, bottom));
+	range.y2 = cellY(fmaxf(top, bottom));
+
+	return true;
+}
+
+
+// Insert
+void detectionGrid::Insert( int index, float left, float top, float right, float bottom )
+{
+	if( index >= mCount )
+	{
+		mCount = index + 1;
+		mDetectionCells.resize(mCount, -1);
+	}
+
+	mDetectionCells[index] = -1;
+	Update(index, left, top, right, bottom);
+}
+
+
+// Update
+void detectionGrid::Update( int index, float left, float top, float right, float bottom )
+{
+	const int previous = mDetectionCells[index];
+
+	if( previous == LARGE )
+		return;	// large detections stay in the list
+
+	CellRange range;
+	int cell = LARGE;
+
+	if( cellRange(left, top, right, bottom, range) && range.x2 - range.x1 <= mMaxSpan && range.y2 - range.y1 <= mMaxSpan )
+	{
+		cell = range.y1 * mCells + range.x1;
+
+		// the box may have grown without its corner moving to another cell
+		mSpanX = std::max(mSpanX, range.x2 - range.x1);
+		mSpanY = std::max(mSpanY, range.y2 - range.y1);
+	}
+
+	if( cell == previous )
+		return;
+
+	// move it out of the cell its top-left corner used to be in
+	if( previous >= 0 )
+	{
+		std::vector<int>& entries = mGrid[previous];
+		entries.erase(std::find(entries.begin(), entries.end(), index));
+	}
+
+	mDetectionCells[index] = cell;
+
+	if( cell == LARGE )
+	{
+		mLarge.push_back(index);
+		return;
+	}
+
+	mGrid[cell].push_back(index);
+}
@@ -0,0 +1,303 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __DETECTION_GRID_H__
+#define __DETECTION_GRID_H__
+
+
+#include <stdint.h>
+#include <limits.h>
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+
+/**
+ * Default number of cells that detectionGrid divides each dimension of the image into.
+ * @ingroup detectNet
+ */
+#define DETECTION_GRID_DEFAULT_CELLS  16
+
+
+/**
+ * Uniform grid of the bounding boxes of detections, used to cluster the raw detections
+ * of a network without comparing each of them against every detection before it.
+ *
+ * Each detection is kept in the cell that the top-left corner of its bounding box is in.
+ * A box can only overlap the detections in the cells above and to the left of it, going
+ * back as far as the widest and tallest of the detections.  Those are a superset of the
+ * detections it can be merged with, and the first of them (in the order they were added)
+ * that matches is returned - so the results are exactly the same as searching all of the
+ * detections in order.
+ *
+ * Boxes extending outside of the image are binned into the cells along the border.
+ * Boxes covering more than a quarter of the grid, and boxes with NaN coordinates (which
+ * overlap anything), are kept in a list that's always searched.
+ *
+ * @ingroup detectNet
+ */
+class detectionGrid
+{
+public:
+	/**
+	 * Constructor
+	 */
+	detectionGrid( uint32_t cells=DETECTION_GRID_DEFAULT_CELLS );
+
+	/**
+	 * Remove all of the detections, and set the size of the image that the grid covers.
+	 */
+	void Reset( float width, float height );
+
+	/**
+	 * Remove all of the detections (while keeping the size of the image).
+	 */
+	void Clear();
+
+	/**
+	 * Add the bounding box of detection `index` (which should be the next index).
+	 */
+	void Insert( int index, float left, float top, float right, float bottom );
+
+	/**
+	 * Update the bounding box of a detection that was already added (i.e. after it was expanded).
+	 */
+	void Update( int index, float left, float top, float right, float bottom );
+
+	/**
+	 * Find the first detection that overlaps the bounding box and is accepted by `match(index)`.
+	 * Detections that don't overlap the box may be passed to `match()` too, so it should
+	 * check the overlap itself, and it shouldn't have side effects (it's called out of order).
+	 * @returns the index of the detection, or -1 if there isn't one.
+	 */
+	template<typename Match> int Find( float left, float top, float right, float bottom, Match match ) const;
+
+	/**
+	 * Cluster detection `n` with the detections before it, like detectNet::clusterDetections().
+	 * If it intersects one of them by more than the threshold (and they have the same class,
+	 * unless CLUSTER_INTERCLASS is defined), that detection is merged with it and 0 is returned.
+	 * Otherwise it's added to the grid as a new detection and 1 is returned.
+	 */
+	template<typename T> int Cluster( T* detections, int n, float threshold );
+
+	/**
+	 * Merge a box of the given class into the first detection before `n` of the same class
+	 * that it overlaps, expanding that detection's bounding box.
+	 * @returns true if the box was merged, or false if it doesn't overlap any of them
+	 *          (in which case it should be added as detection `n` with Insert())
+	 */
+	template<typename T> bool Expand( T* detections, int n, uint32_t classID, float left, float top, float right, float bottom );
+
+	/**
+	 * Sort the detections by their area (in descending order), keeping the order of
+	 * detections with the same area.  This is the order that detectNet returns them in.
+	 */
+	template<typename T> static void SortByArea( T* detections, int numDetections );
+
+protected:
+
+	struct CellRange
+	{
+		int x1;
+		int y1;
+		int x2;
+		int y2;
+	};
+
+	bool cellRange( float left, float top, float right, float bottom, CellRange& range ) const;
+
+	int cellX( float x ) const;
+	int cellY( float y ) const;
+
+	static const int LARGE = -2;
+
+	uint32_t mCells;
+	int      mMaxSpan;		// widest box (in cells) that's kept in the grid
+
+	float mScaleX;		// cells per pixel
+	float mScaleY;
+
+	int mSpanX;			// widest box in the grid (in cells)
+	int mSpanY;			// tallest box in the grid (in cells)
+	int mCount;
+
+	std::vector<std::vector<int>> mGrid;	// detections in each cell
+	std::vector<int> mDetectionCells;		// cell that each detection is in (or LARGE)
+	std::vector<int> mLarge;				// detections that are always searched
+};
+
+
+// Find
+template<typename Match>
+int detectionGrid::Find( float left, float top, float right, float bottom, Match match ) const
+{
+	CellRange range;
+
+	if( !cellRange(left, top, right, bottom, range) )
+	{
+		for( int n=0; n < mCount; n++ )
+		{
+			if( match(n) )
+				return n;
+		}
+
+		return -1;
+	}
+
+	int first = INT_MAX;
+
+	for( int y=std::max(range.y1 - mSpanY, 0); y <= range.y2; y++ )
+	{
+		for( int x=std::max(range.x1 - mSpanX, 0); x <= range.x2; x++ )
+		{
+			const std::vector<int>& cell = mGrid[y * mCells + x];
+
+			for( size_t n=0; n < cell.size(); n++ )
+			{
+				if( cell[n] < first && match(cell[n]) )
+					first = cell[n];
+			}
+		}
+	}
+
+	for( size_t n=0; n < mLarge.size(); n++ )
+	{
+		if( mLarge[n] < first && match(mLarge[n]) )
+			first = mLarge[n];
+	}
+
+	return (first != INT_MAX) ? first : -1;
+}
+
+
+// Cluster
+template<typename T>
+int detectionGrid::Cluster( T* detections, int n, float threshold )
+{
+	T& det = detections[n];
+
+	if( n == 0 )
+	{
+		Clear();
+		Insert(0, det.Left, det.Top, det.Right, det.Bottom);
+		return 1;
+	}
+
+	// if the intersecting detections have different classes, pick the one with highest confidence
+	// otherwise if they have the same object class, expand the detection bounding box
+	auto match = [detections, &det, threshold]( int m )
+	{
+	#ifdef CLUSTER_INTERCLASS
+		return det.Intersects(detections[m], threshold);
+	#else
+		return det.ClassID == detections[m].ClassID && det.Intersects(detections[m], threshold);
+	#endif
+	};
+
+	// with a negative threshold, boxes that don't overlap still intersect
+	const int m = (threshold >= 0.0f) ? Find(det.Left, det.Top, det.Right, det.Bottom, match)
+							    : Find(NAN, NAN, NAN, NAN, match);
+
+	if( m < 0 )
+	{
+		Insert(n, det.Left, det.Top, det.Right, det.Bottom);
+		return 1;	// new detection
+	}
+
+#ifdef CLUSTER_INTERCLASS
+	if( det.ClassID != detections[m].ClassID )
+	{
+		if( det.Confidence > detections[m].Confidence )
+		{
+			detections[m] = det;
+			detections[m].TrackID = -1;
+			Update(m, det.Left, det.Top, det.Right, det.Bottom);
+		}
+
+		return 0; // merged detection
+	}
+#endif
+
+	detections[m].Expand(det);
+	detections[m].Confidence = fmaxf(det.Confidence, detections[m].Confidence);
+	Update(m, detections[m].Left, detections[m].Top, detections[m].Right, detections[m].Bottom);
+
+	return 0; // merged detection
+}
+
+
+// Expand
+template<typename T>
+bool detectionGrid::Expand( T* detections, int n, uint32_t classID, float left, float top, float right, float bottom )
+{
+	if( n == 0 )
+	{
+		Clear();
+		return false;
+	}
+
+	const int m = Find(left, top, right, bottom, [detections, classID, left, top, right, bottom]( int m )
+	{
+		return detections[m].ClassID == classID && detections[m].Overlaps(left, top, right, bottom);
+	});
+
+	if( m < 0 )
+		return false;
+
+	detections[m].Expand(left, top, right, bottom);
+	Update(m, detections[m].Left, detections[m].Top, detections[m].Right, detections[m].Bottom);
+
+	return true;
+}
+
+
+// SortByArea
+template<typename T>
+void detectionGrid::SortByArea( T* detections, int numDetections )
+{
+	if( numDetections < 2 )
+		return;
+
+	// NaN areas can't be ordered, so those are sorted the same (quadratic) way they used to be
+	for( int n=0; n < numDetections; n++ )
+	{
+		if( isnan(detections[n].Area()) )
+		{
+			for( int i=0; i < numDetections-1; i++ )
+			{
+				for( int j=0; j < numDetections-i-1; j++ )
+				{
+					if( detections[j].Area() < detections[j+1].Area() )
+						std::swap(detections[j], detections[j+1]);
+				}
+			}
+
+			return;
+		}
+	}
+
+	std::stable_sort(detections, detections + numDetections, [](const T& a, const T& b) { return a.Area() > b.Area(); });
+}
+
+
+#endif
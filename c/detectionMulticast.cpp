@@ -0,0 +1,611 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "detectionMulticast.h"
+
+#include "IPv4.h"
+#include "Endian.h"
+#include "cudaUtility.h"
+#include "logging.h"
+#include "timespec.h"
+
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <string>
+#include <algorithm>
+
+
+using namespace detectionMulticast;
+
+
+// largest UDP payload that can be received
+#define MAX_PACKET_SIZE  65507
+
+// largest frame record that will be reassembled
+#define MAX_FRAME_SIZE  (16 * 1024 * 1024)
+
+// number of datagrams read from the socket per system call
+#define RECEIVE_BATCH  32
+
+// number of partially-received frames being reassembled at once
+#define REASSEMBLY_SLOTS  4
+
+
+// ParseAddress
+bool detectionMulticast::ParseAddress( const char* str, uint32_t* groupIP, uint16_t* port )
+{
+	if( !groupIP || !port )
+		return false;
+
+	std::string group = DETECTION_MULTICAST_DEFAULT_GROUP;
+	*port = DETECTION_MULTICAST_DEFAULT_PORT;
+
+	if( str != NULL && str[0] != '\0' )
+	{
+		const char* colon = strrchr(str, ':');
+
+		if( colon != NULL )
+		{
+			if( colon > str )
+				group = std::string(str, colon - str);
+
+			const int p = atoi(colon + 1);
+
+			if( p <= 0 || p > 65535 )
+			{
+				LogError(LOG_DETMCAST "invalid port in '%s'\n", str);
+				return false;
+			}
+
+			*port = p;
+		}
+		else
+		{
+			group = str;
+		}
+	}
+
+	if( !IPv4AddressFromStr(group.c_str(), groupIP) )
+	{
+		LogError(LOG_DETMCAST "invalid IPv4 address '%s'\n", group.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+
+// isMulticast
+static inline bool isMulticast( uint32_t ip )
+{
+	return (ntohl(ip) & 0xF0000000) == 0xE0000000;	// 224.0.0.0/4
+}
+
+
+//-----------------------------------------------------------------------------
+// detectionMulticastPublisher
+//-----------------------------------------------------------------------------
+
+// constructor
+detectionMulticastPublisher::detectionMulticastPublisher()
+{
+	mSocket      = NULL;
+	mGroupIP     = 0;
+	mPort        = 0;
+	mMTU         = DETECTION_MULTICAST_DEFAULT_MTU;
+	mSource      = 0;
+	mSequence    = 0;
+	mFramesSent  = 0;
+	mPacketsSent = 0;
+	mBytesSent   = 0;
+}
+
+
+// destructor
+detectionMulticastPublisher::~detectionMulticastPublisher()
+{
+	SAFE_DELETE(mSocket);
+}
+
+
+// Create
+detectionMulticastPublisher* detectionMulticastPublisher::Create( const char* group, uint16_t port, uint8_t ttl, const char* interfaceIP, uint32_t mtu )
+{
+	if( mtu <= sizeof(PacketHeader) + 8 || mtu > MAX_PACKET_SIZE )
+	{
+		LogError(LOG_DETMCAST "invalid MTU (%u bytes)\n", mtu);
+		return NULL;
+	}
+
+	uint32_t groupIP = 0;
+	uint32_t interfaceAddr = IP_ANY;
+
+	if( !group || !IPv4AddressFromStr(group, &groupIP) )
+	{
+		LogError(LOG_DETMCAST "invalid group address '%s'\n", group);
+		return NULL;
+	}
+
+	if( interfaceIP != NULL && !IPv4AddressFromStr(interfaceIP, &interfaceAddr) )
+	{
+		LogError(LOG_DETMCAST "invalid interface address '%s'\n", interfaceIP);
+		return NULL;
+	}
+
+	detectionMulticastPublisher* pub = new detectionMulticastPublisher();
+
+	pub->mGroupIP = groupIP;
+	pub->mPort    = port;
+	pub->mMTU     = mtu;
+	pub->mSocket  = Socket::Create(SOCKET_UDP);
+
+	if( !pub->mSocket || !pub->mSocket->Bind() )
+	{
+		LogError(LOG_DETMCAST "failed to create UDP socket\n");
+		delete pub;
+		return NULL;
+	}
+
+	// set the socket options up-front, instead of on the send path
+	if( isMulticast(groupIP) )
+	{
+		if( !pub->mSocket->SetMulticastOptions(ttl, true, interfaceAddr) )
+		{
+			delete pub;
+			return NULL;
+		}
+	}
+	else if( groupIP == netswap32(IP_BROADCAST) )
+	{
+		if( !pub->mSocket->EnableBroadcast() )
+		{
+			delete pub;
+			return NULL;
+		}
+	}
+
+	// random ID so subscribers can tell when the publisher restarts
+	srand(time(NULL) ^ getpid());
+	pub->mSource = ((uint32_t)rand() << 16) ^ (uint32_t)rand() ^ (uint32_t)time(NULL);
+
+	LogVerbose(LOG_DETMCAST "publishing detections to %s:%hu (MTU %u, TTL %u)\n", 
+			 IPv4AddressToStr(groupIP).c_str(), port, mtu, (uint32_t)ttl);
+
+	return pub;
+}
+
+
+// Create
+detectionMulticastPublisher* detectionMulticastPublisher::Create( const commandLine& cmdLine )
+{
+	if( !cmdLine.GetFlag("multicast") )
+		return NULL;
+
+	uint32_t groupIP = 0;
+	uint16_t port = 0;
+
+	if( !ParseAddress(cmdLine.GetString("multicast"), &groupIP, &port) )
+		return NULL;
+
+	return Create(IPv4AddressToStr(groupIP).c_str(), port,
+			    cmdLine.GetUnsignedInt("multicast-ttl", 1),
+			    cmdLine.GetString("multicast-interface"),
+			    cmdLine.GetUnsignedInt("multicast-mtu", DETECTION_MULTICAST_DEFAULT_MTU));
+}
+
+
+// Publish
+bool detectionMulticastPublisher::Publish( uint64_t timestamp, uint64_t frame, const yoloNet::Detection* detections, uint32_t numDetections )
+{
+	if( numDetections > 0 && !detections )
+		return false;
+
+	const uint32_t recordSize = detectionStream::RecordSize(numDetections);
+
+	if( recordSize > MAX_FRAME_SIZE )
+	{
+		LogError(LOG_DETMCAST "frame with %u detections is too large to send\n", numDetections);
+		return false;
+	}
+
+	// pack the record into an aligned buffer
+	if( mRecord.size() * sizeof(uint64_t) < recordSize )
+		mRecord.resize(recordSize / sizeof(uint64_t));
+
+	detectionStream::PackRecord(mRecord.data(), timestamp, frame, detections, numDetections);
+
+	// split it into datagrams
+	const uint32_t maxPayload = mMTU - sizeof(PacketHeader);
+	const uint32_t numFragments = (recordSize + maxPayload - 1) / maxPayload;
+
+	if( numFragments > 0xFFFF )
+	{
+		LogError(LOG_DETMCAST "frame with %u detections needs too many fragments (increase the MTU)\n", numDetections);
+		return false;
+	}
+
+	if( mPackets.size() < numFragments * mMTU )
+		mPackets.resize(numFragments * mMTU);
+
+	if( mMessages.size() < numFragments )
+		mMessages.resize(numFragments);
+
+	const uint8_t* record = (const uint8_t*)mRecord.data();
+	size_t bytes = 0;
+
+	for( uint32_t n=0; n < numFragments; n++ )
+	{
+		const uint32_t offset = n * maxPayload;
+		const uint32_t payload = (recordSize - offset < maxPayload) ? (recordSize - offset) : maxPayload;
+
+		uint8_t* packet = mPackets.data() + n * mMTU;
+		PacketHeader* header = (PacketHeader*)packet;
+
+		memcpy(header->magic, "DMC1", 4);
+
+		header->source       = mSource;
+		header->sequence     = mSequence;
+		header->fragment     = n;
+		header->numFragments = numFragments;
+		header->frameSize    = recordSize;
+		header->offset       = offset;
+
+		memcpy(packet + sizeof(PacketHeader), record + offset, payload);
+
+		mMessages[n].buffer     = packet;
+		mMessages[n].size       = sizeof(PacketHeader) + payload;
+		mMessages[n].remoteIP   = mGroupIP;
+		mMessages[n].remotePort = mPort;
+
+		bytes += mMessages[n].size;
+	}
+
+	mSequence++;
+
+	// send all the fragments with one syscall
+	const size_t sent = mSocket->SendBatch(mMessages.data(), numFragments);
+
+	mPacketsSent += sent;
+
+	if( sent != numFragments )
+		return false;
+
+	mFramesSent++;
+	mBytesSent += bytes;
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// detectionMulticastSubscriber
+//-----------------------------------------------------------------------------
+
+// constructor
+detectionMulticastSubscriber::detectionMulticastSubscriber()
+{
+	mSocket       = NULL;
+	mSource       = 0;
+	mNextSequence = 0;
+	mHasSource    = false;
+	mTimeout      = 0;
+
+	memset(&mStats, 0, sizeof(Stats));
+
+	mSlots.resize(REASSEMBLY_SLOTS);
+	resetSlots();
+}
+
+
+// destructor
+detectionMulticastSubscriber::~detectionMulticastSubscriber()
+{
+	SAFE_DELETE(mSocket);
+}
+
+
+// Create
+detectionMulticastSubscriber* detectionMulticastSubscriber::Create( const char* group, uint16_t port, const char* interfaceIP )
+{
+	uint32_t groupIP = IP_ANY;
+	uint32_t interfaceAddr = IP_ANY;
+
+	if( group != NULL && !IPv4AddressFromStr(group, &groupIP) )
+	{
+		LogError(LOG_DETMCAST "invalid group address '%s'\n", group);
+		return NULL;
+	}
+
+	if( interfaceIP != NULL && !IPv4AddressFromStr(interfaceIP, &interfaceAddr) )
+	{
+		LogError(LOG_DETMCAST "invalid interface address '%s'\n", interfaceIP);
+		return NULL;
+	}
+
+	detectionMulticastSubscriber* sub = new detectionMulticastSubscriber();
+
+	sub->mSocket = Socket::Create(SOCKET_UDP);
+
+	if( !sub->mSocket )
+	{
+		LogError(LOG_DETMCAST "failed to create UDP socket\n");
+		delete sub;
+		return NULL;
+	}
+
+	// allow multiple subscribers on the same host
+	sub->mSocket->EnableReuseAddress();
+	sub->mSocket->SetBufferSize(4 * 1024 * 1024);
+
+	if( !sub->mSocket->Bind(port) )
+	{
+		LogError(LOG_DETMCAST "failed to bind UDP socket to port %hu\n", port);
+		delete sub;
+		return NULL;
+	}
+
+	if( isMulticast(groupIP) && !sub->mSocket->JoinMulticastGroup(groupIP, interfaceAddr) )
+	{
+		delete sub;
+		return NULL;
+	}
+
+	// allocate the batch of receive buffers
+	sub->mPackets.resize(RECEIVE_BATCH * MAX_PACKET_SIZE);
+	sub->mMessages.resize(RECEIVE_BATCH);
+
+	for( uint32_t n=0; n < RECEIVE_BATCH; n++ )
+	{
+		sub->mMessages[n].buffer = sub->mPackets.data() + n * MAX_PACKET_SIZE;
+		sub->mMessages[n].size   = MAX_PACKET_SIZE;
+	}
+
+	LogVerbose(LOG_DETMCAST "subscribed to detections from %s:%hu\n", IPv4AddressToStr(groupIP).c_str(), port);
+	return sub;
+}
+
+
+// Receive
+bool detectionMulticastSubscriber::Receive( detectionStreamReader::Record* record, uint64_t timeout )
+{
+	if( !record )
+		return false;
+
+	const double deadline = timeDouble() + timeout;
+
+	while( mCompleted.size() == 0 )
+	{
+		const double remaining = deadline - timeDouble();
+
+		if( remaining <= 0.0 )
+			return false;
+
+		// only update the socket timeout when it changes by more than a millisecond
+		const uint64_t wait = (remaining < 1.0) ? 1 : (uint64_t)remaining;
+
+		if( wait != mTimeout )
+		{
+			if( !mSocket->SetRecieveTimeout(wait * 1000) )
+				return false;
+
+			mTimeout = wait;
+		}
+
+		const int numPackets = mSocket->RecieveBatch(mMessages.data(), mMessages.size());
+
+		if( numPackets < 0 )
+			return false;
+
+		for( int n=0; n < numPackets; n++ )
+			processPacket((const uint8_t*)mMessages[n].buffer, mMessages[n].received);
+	}
+
+	// recycle the previous frame's buffer for reassembly
+	if( mCurrent.capacity() > 0 && mFreeBuffers.size() < REASSEMBLY_SLOTS )
+	{
+		mFreeBuffers.push_back(std::vector<uint64_t>());
+		mFreeBuffers.back().swap(mCurrent);
+	}
+
+	// hand out the oldest completed frame
+	mCurrent.swap(mCompleted.front());
+	mCompleted.pop_front();
+
+	return record->Parse(mCurrent.data(), mCurrent.size() * sizeof(uint64_t));
+}
+
+
+// processPacket
+void detectionMulticastSubscriber::processPacket( const uint8_t* packet, size_t size )
+{
+	mStats.packetsReceived++;
+	mStats.bytesReceived += size;
+
+	// validate the header
+	if( size < sizeof(PacketHeader) )
+	{
+		mStats.packetsDropped++;
+		return;
+	}
+
+	const PacketHeader* header = (const PacketHeader*)packet;
+	const uint32_t payload = size - sizeof(PacketHeader);
+
+	if( memcmp(header->magic, "DMC1", 4) != 0 || header->numFragments == 0 || header->fragment >= header->numFragments ||
+	    header->frameSize > MAX_FRAME_SIZE || (header->frameSize % sizeof(uint64_t)) != 0 || 
+	    header->offset > header->frameSize || payload > header->frameSize - header->offset )
+	{
+		mStats.packetsDropped++;
+		return;
+	}
+
+	// the publisher restarted (or a different one started sending)
+	if( !mHasSource || header->source != mSource )
+	{
+		if( mHasSource )
+		{
+			LogVerbose(LOG_DETMCAST "publisher restarted, resetting the sequence\n");
+			mStats.sourceChanges++;
+		}
+
+		resetSlots();
+
+		mSource = header->source;
+		mNextSequence = header->sequence;
+		mHasSource = true;
+	}
+
+	// drop fragments of frames that are older than the last one delivered
+	if( (int32_t)(header->sequence - mNextSequence) < 0 )
+	{
+		mStats.packetsDropped++;
+		return;
+	}
+
+	// find the frame's slot, or claim the oldest one
+	Slot* slot = NULL;
+	Slot* oldest = NULL;
+
+	for( size_t n=0; n < mSlots.size(); n++ )
+	{
+		Slot& s = mSlots[n];
+
+		if( s.active && s.sequence == header->sequence )
+		{
+			slot = &s;
+			break;
+		}
+
+		if( !oldest || !s.active || (oldest->active && (int32_t)(s.sequence - oldest->sequence) < 0) )
+			oldest = &s;
+	}
+
+	if( !slot )
+	{
+		// the rest of a frame that was already given up on as incomplete
+		if( std::find(mIncomplete.begin(), mIncomplete.end(), header->sequence) != mIncomplete.end() )
+		{
+			mStats.packetsDropped++;
+			return;
+		}
+
+		slot = oldest;
+
+		if( slot->active )
+		{
+			mStats.framesIncomplete++;
+			mIncomplete.push_back(slot->sequence);
+		}
+
+		slot->active       = true;
+		slot->sequence     = header->sequence;
+		slot->numFragments = header->numFragments;
+		slot->numReceived  = 0;
+
+		if( mFreeBuffers.size() > 0 && slot->data.capacity() == 0 )
+		{
+			slot->data.swap(mFreeBuffers.back());
+			mFreeBuffers.pop_back();
+		}
+
+		slot->data.resize(header->frameSize / sizeof(uint64_t));
+		slot->received.assign(header->numFragments, false);
+	}
+	else if( header->numFragments != slot->numFragments || header->frameSize != slot->data.size() * sizeof(uint64_t) )
+	{
+		mStats.packetsDropped++;
+		return;
+	}
+
+	if( slot->received[header->fragment] )
+	{
+		mStats.packetsDropped++;	// duplicate
+		return;
+	}
+
+	memcpy((uint8_t*)slot->data.data() + header->offset, packet + sizeof(PacketHeader), payload);
+
+	slot->received[header->fragment] = true;
+	slot->numReceived++;
+
+	if( slot->numReceived == slot->numFragments )
+		completeFrame(*slot);
+}
+
+
+// completeFrame
+void detectionMulticastSubscriber::completeFrame( Slot& slot )
+{
+	mCompleted.push_back(std::vector<uint64_t>());
+	mCompleted.back().swap(slot.data);
+
+	slot.active = false;
+
+	// older frames still being reassembled can no longer be delivered in order
+	for( size_t n=0; n < mSlots.size(); n++ )
+	{
+		Slot& s = mSlots[n];
+
+		if( s.active && (int32_t)(s.sequence - slot.sequence) < 0 )
+		{
+			mStats.framesIncomplete++;
+			mIncomplete.push_back(s.sequence);
+			s.active = false;
+		}
+	}
+
+	// any frames skipped in the sequence were lost, except the ones already counted as incomplete
+	uint32_t lost = slot.sequence - mNextSequence;
+
+	for( size_t n=0; n < mIncomplete.size(); )
+	{
+		if( (int32_t)(mIncomplete[n] - slot.sequence) < 0 )
+		{
+			lost--;
+			mIncomplete[n] = mIncomplete.back();
+			mIncomplete.pop_back();
+		}
+		else
+		{
+			n++;
+		}
+	}
+
+	mStats.framesLost += lost;
+	mStats.framesReceived++;
+
+	mNextSequence = slot.sequence + 1;
+}
+
+
+// resetSlots
+void detectionMulticastSubscriber::resetSlots()
+{
+	for( size_t n=0; n < mSlots.size(); n++ )
+		mSlots[n].active = false;
+
+	mIncomplete.clear();
+}
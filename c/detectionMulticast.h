@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __DETECTION_MULTICAST_H__
+#define __DETECTION_MULTICAST_H__
+
+
+#include "detectionStream.h"
+#include "Socket.h"
+
+#include <deque>
+#include <vector>
+
+
+/**
+ * Detection multicast logging prefix
+ * @ingroup detectionMulticast
+ */
+#define LOG_DETMCAST "[multicast] "
+
+/**
+ * Default multicast group (from the administratively-scoped 239.255.0.0/16 range)
+ * @ingroup detectionMulticast
+ */
+#define DETECTION_MULTICAST_DEFAULT_GROUP  "239.255.41.1"
+
+/**
+ * Default UDP port that detections are multicast to.
+ * @ingroup detectionMulticast
+ */
+#define DETECTION_MULTICAST_DEFAULT_PORT  41570
+
+/**
+ * Default maximum size (in bytes) of each datagram, chosen to fit in a 1500-byte
+ * ethernet MTU after the IP and UDP headers.  Larger frames are fragmented.
+ * @ingroup detectionMulticast
+ */
+#define DETECTION_MULTICAST_DEFAULT_MTU  1472
+
+/**
+ * Standard command-line options able to be passed to detectionMulticastPublisher::Create()
+ * @ingroup detectionMulticast
+ */
+#define DETECTION_MULTICAST_USAGE_STRING  "detectionMulticast arguments: \n" 	\
+		  "  --multicast[=GROUP[:PORT]]  multicast the detections over UDP (default group\n"	\
+		  "                              " DETECTION_MULTICAST_DEFAULT_GROUP " and port 41570)\n"	\
+		  "  --multicast-ttl=N           number of network hops the packets can take (default: 1)\n"	\
+		  "  --multicast-interface=IP    address of the network interface to send from\n"		\
+		  "  --multicast-mtu=BYTES       maximum datagram size, larger frames are fragmented\n"	\
+		  "                              (default: 1472)\n\n"
+
+
+/**
+ * Lightweight UDP multicast of per-frame detection results, for consumers on the
+ * local network (loggers, dashboards, actuators) that can tolerate occasional loss.
+ *
+ * Each frame is encoded as a detectionStream record (see detectionStream::PackRecord()),
+ * and split into one or more datagrams that start with a PacketHeader.  All of a frame's
+ * datagrams are sent with one system call (see Socket::SendBatch()).  The subscriber
+ * reassembles the fragments, and uses the sequence numbers to report lost frames.
+ *
+ * The fields are stored in little-endian byte order.
+ * @ingroup detectionMulticast
+ */
+namespace detectionMulticast
+{
+	/**
+	 * Header at the start of each datagram.
+	 */
+	struct PacketHeader
+	{
+		char     magic[4];		/**< "DMC1" */
+		uint32_t source;		/**< random ID of the publisher (changes when it restarts) */
+		uint32_t sequence;		/**< frame sequence number (incremented for each frame) */
+		uint16_t fragment;		/**< index of this fragment */
+		uint16_t numFragments;	/**< number of fragments in the frame */
+		uint32_t frameSize;		/**< size of the frame's record (in bytes) */
+		uint32_t offset;		/**< offset of this fragment in the record (in bytes) */
+	};
+
+	/**
+	 * Parse a "GROUP[:PORT]" string (either part can be omitted to use the defaults)
+	 * @param groupIP output of the group address (in network byte order)
+	 * @param port output of the port (in host byte order)
+	 */
+	bool ParseAddress( const char* str, uint32_t* groupIP, uint16_t* port );
+}
+
+
+/**
+ * Sends the detections from each frame to a UDP multicast group.
+ * @see detectionMulticast for the packet format.
+ * @ingroup detectionMulticast
+ */
+class detectionMulticastPublisher
+{
+public:
+	/**
+	 * Create a new publisher.
+	 * @param group the multicast group address (or a unicast/broadcast address)
+	 * @param port the UDP port to send to
+	 * @param ttl the number of network hops the packets can take (1 keeps them on the local subnet)
+	 * @param interfaceIP address of the local network interface to send from (or NULL for the default)
+	 * @param mtu the maximum size of each datagram (in bytes)
+	 */
+	static detectionMulticastPublisher* Create( const char* group=DETECTION_MULTICAST_DEFAULT_GROUP, 
+									    uint16_t port=DETECTION_MULTICAST_DEFAULT_PORT, uint8_t ttl=1,
+									    const char* interfaceIP=NULL, uint32_t mtu=DETECTION_MULTICAST_DEFAULT_MTU );
+
+	/**
+	 * Create a new publisher by parsing the command line.
+	 * @returns NULL if `--multicast` wasn't specified, or there was an error.
+	 */
+	static detectionMulticastPublisher* Create( const commandLine& cmdLine );
+
+	/**
+	 * Destructor
+	 */
+	~detectionMulticastPublisher();
+
+	/**
+	 * Send the detections from a frame.
+	 * @param timestamp the timestamp of the frame (in nanoseconds), see videoSource::GetLastTimestamp()
+	 * @param frame the frame index, see videoSource::GetFrameCount()
+	 */
+	bool Publish( uint64_t timestamp, uint64_t frame, const yoloNet::Detection* detections, uint32_t numDetections );
+
+	/**
+	 * Get the number of frames sent.
+	 */
+	inline uint64_t GetFramesSent() const			{ return mFramesSent; }
+
+	/**
+	 * Get the number of datagrams sent.
+	 */
+	inline uint64_t GetPacketsSent() const			{ return mPacketsSent; }
+
+	/**
+	 * Get the number of bytes sent (including the packet headers)
+	 */
+	inline uint64_t GetBytesSent() const			{ return mBytesSent; }
+
+	/**
+	 * Get the underlying socket.
+	 */
+	inline Socket* GetSocket() const				{ return mSocket; }
+
+	/**
+	 * Usage string for command line arguments to Create()
+	 */
+	static inline const char* Usage() 				{ return DETECTION_MULTICAST_USAGE_STRING; }
+
+protected:
+	detectionMulticastPublisher();
+
+	Socket*  mSocket;
+	uint32_t mGroupIP;
+	uint16_t mPort;
+	uint32_t mMTU;
+
+	uint32_t mSource;
+	uint32_t mSequence;
+
+	std::vector<uint64_t> mRecord;	// 8-byte aligned record buffer
+	std::vector<uint8_t>  mPackets;
+	std::vector<SocketMessage> mMessages;
+
+	uint64_t mFramesSent;
+	uint64_t mPacketsSent;
+	uint64_t mBytesSent;
+};
+
+
+/**
+ * Receives detections from a detectionMulticastPublisher and reassembles the fragmented frames.
+ *
+ * Frames are delivered in order - if a newer frame completes before an older one,
+ * the older frame is dropped and counted as lost.  Packets are read from the socket
+ * in batches (see Socket::RecieveBatch()).
+ *
+ * @ingroup detectionMulticast
+ */
+class detectionMulticastSubscriber
+{
+public:
+	/**
+	 * Reception and loss statistics.
+	 */
+	struct Stats
+	{
+		uint64_t framesReceived;	/**< number of complete frames received */
+		uint64_t framesLost;		/**< number of frames missing from the sequence that weren't received at all */
+		uint64_t framesIncomplete;	/**< number of frames that were partially received (not included in framesLost) */
+		uint64_t packetsReceived;	/**< number of datagrams received */
+		uint64_t packetsDropped;	/**< number of datagrams that were invalid, duplicated, or arrived too late */
+		uint64_t bytesReceived;		/**< number of bytes received (including the packet headers) */
+		uint32_t sourceChanges;		/**< number of times the publisher restarted */
+	};
+
+	/**
+	 * Create a new subscriber.
+	 * @param group the multicast group address (or NULL/IP_ANY to receive unicast/broadcast packets)
+	 * @param port the UDP port to receive on
+	 * @param interfaceIP address of the local network interface to join the group on (or NULL for the default)
+	 */
+	static detectionMulticastSubscriber* Create( const char* group=DETECTION_MULTICAST_DEFAULT_GROUP, 
+									     uint16_t port=DETECTION_MULTICAST_DEFAULT_PORT,
+									     const char* interfaceIP=NULL );
+
+	/**
+	 * Destructor
+	 */
+	~detectionMulticastSubscriber();
+
+	/**
+	 * Wait for the next complete frame.
+	 * @param record output of the frame's detections, which remains valid until the next call to Receive()
+	 * @param timeout the maximum time to wait (in milliseconds)
+	 * @returns true if a frame was received, or false on timeout.
+	 */
+	bool Receive( detectionStreamReader::Record* record, uint64_t timeout=1000 );
+
+	/**
+	 * Get the reception and loss statistics.
+	 */
+	inline const Stats& GetStats() const			{ return mStats; }
+
+	/**
+	 * Get the underlying socket.
+	 */
+	inline Socket* GetSocket() const				{ return mSocket; }
+
+protected:
+	detectionMulticastSubscriber();
+
+	struct Slot
+	{
+		bool active;
+		uint32_t sequence;
+		uint32_t numFragments;
+		uint32_t numReceived;
+		std::vector<uint64_t> data;
+		std::vector<bool> received;
+	};
+
+	void processPacket( const uint8_t* packet, size_t size );
+	void completeFrame( Slot& slot );
+	void resetSlots();
+
+	Socket* mSocket;
+	Stats   mStats;
+
+	uint32_t mSource;
+	uint32_t mNextSequence;
+	bool     mHasSource;
+
+	uint64_t mTimeout;	// current SO_RCVTIMEO (in milliseconds)
+
+	std::vector<Slot> mSlots;
+	std::vector<uint8_t> mPackets;
+	std::vector<SocketMessage> mMessages;
+
+	std::deque< std::vector<uint64_t> > mCompleted;
+	std::vector< std::vector<uint64_t> > mFreeBuffers;
+	std::vector<uint32_t> mIncomplete;	// sequences counted as incomplete that haven't been skipped over yet
+	std::vector<uint64_t> mCurrent;
+};
+
+#endif
@@ -0,0 +1,627 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "detectionPublisher.h"
+
+#include "json.hpp"
+#include "logging.h"
+#include "timespec.h"
+
+#include <gio/gio.h>
+#include <algorithm>
+
+
+// how often (in milliseconds) to retry sending to peers whose sockets are full
+#define FLUSH_RETRY_INTERVAL 5
+
+
+// constructor
+detectionPublisher::detectionPublisher( const char* path, yoloNet* net, uint32_t queueSize )
+{
+	mServer      = NULL;
+	mNet         = net;
+	mPath        = path;
+	mQueueSize   = (queueSize > 0) ? queueSize : 1;
+	mBinaryPeers = 0;
+	mFlushSource = 0;
+	mClosing     = false;
+
+	mNumPeers.store(0);
+}
+
+
+// destructor
+detectionPublisher::~detectionPublisher()
+{
+	mMutex.Lock();
+
+	mClosing = true;
+
+	if( mFlushSource != 0 )
+	{
+		removeFlush(mFlushSource);
+		mFlushSource = 0;
+	}
+
+	mMutex.Unlock();
+
+	if( mServer != NULL )
+	{
+		// the peers are owned by the server's event loop, so they're disconnected from it
+		// (which also waits for a flush that was already dispatched and waiting on mMutex)
+		EventLoop* loop = mServer->GetEventLoop();
+
+		if( loop != NULL )
+			loop->Invoke(onTeardown, this, true);
+		else
+			teardown();
+
+		mServer->Release();
+		mServer = NULL;
+	}
+	else
+	{
+		teardown();
+	}
+}
+
+
+// Create
+detectionPublisher* detectionPublisher::Create( uint16_t port, const char* path, yoloNet* net, uint32_t queueSize )
+{
+	if( !path )
+		path = DETECTION_PUBLISHER_DEFAULT_PATH;
+
+	detectionPublisher* publisher = new detectionPublisher(path, net, queueSize);
+
+	publisher->mServer = WebRTCServer::Create(port);
+
+	if( !publisher->mServer )
+	{
+		LogError(LOG_WEBRTC "detectionPublisher -- failed to create WebRTC server on port %hu\n", port);
+		delete publisher;
+		return NULL;
+	}
+
+	publisher->mServer->AddRoute(path, onWebsocket, publisher, WEBRTC_SEND|WEBRTC_PUBLIC|WEBRTC_MULTI_CLIENT);
+
+	LogInfo(LOG_WEBRTC "detectionPublisher -- publishing detections on websocket route %s\n", path);
+	return publisher;
+}
+
+
+// Create
+detectionPublisher* detectionPublisher::Create( const commandLine& cmdLine, yoloNet* net, uint16_t port )
+{
+	if( !cmdLine.GetFlag("publish-detections") )
+		return NULL;
+
+	const char* path = cmdLine.GetString("publish-detections");
+
+	if( !path || path[0] != '/' )
+		path = DETECTION_PUBLISHER_DEFAULT_PATH;
+
+	return Create(cmdLine.GetUnsignedInt("publish-port", port), path, net,
+			    cmdLine.GetUnsignedInt("publish-queue", DETECTION_PUBLISHER_DEFAULT_QUEUE));
+}
+
+
+// normalize a coordinate to 0-65535
+static inline uint16_t normalizeCoord( float value, float size )
+{
+	const float normalized = value / size * 65535.0f + 0.5f;
+
+	if( normalized <= 0.0f )
+		return 0;
+	else if( normalized >= 65535.0f )
+		return 65535;
+
+	return (uint16_t)normalized;
+}
+
+
+// Publish
+bool detectionPublisher::Publish( uint64_t timestamp, uint64_t frame, uint32_t width, uint32_t height,
+						    const yoloNet::Detection* detections, uint32_t numDetections )
+{
+	if( numDetections > 0 && !detections )
+		return false;
+
+	if( mNumPeers.load() == 0 )
+		return true;	// nobody to send to
+
+	mMutex.Lock();
+	const bool needBinary = (mBinaryPeers > 0);
+	const bool needText = (mBinaryPeers < mPeers.size());
+	mMutex.Unlock();
+
+	// encode the message once per format, then share it between the peers
+	GBytes* binaryMsg = NULL;
+	GBytes* textMsg = NULL;
+
+	if( needBinary )
+	{
+		const size_t size = sizeof(BinaryHeader) + numDetections * sizeof(BinaryDetection);
+		uint8_t* data = (uint8_t*)g_malloc(size);
+
+		BinaryHeader* header = (BinaryHeader*)data;
+		BinaryDetection* packed = (BinaryDetection*)(data + sizeof(BinaryHeader));
+
+		memcpy(header->magic, "DET1", 4);
+
+		header->numDetections = numDetections;
+		header->timestamp     = timestamp;
+		header->frame         = frame;
+		header->width         = width;
+		header->height        = height;
+		header->reserved      = 0;
+
+		const float w = (width > 0) ? width : 1.0f;
+		const float h = (height > 0) ? height : 1.0f;
+
+		for( uint32_t n=0; n < numDetections; n++ )
+		{
+			packed[n].classID    = detections[n].ClassID;
+			packed[n].confidence = normalizeCoord(detections[n].Confidence, 1.0f);
+			packed[n].trackID    = detections[n].TrackID;
+			packed[n].left       = normalizeCoord(detections[n].Left, w);
+			packed[n].top        = normalizeCoord(detections[n].Top, h);
+			packed[n].right      = normalizeCoord(detections[n].Right, w);
+			packed[n].bottom     = normalizeCoord(detections[n].Bottom, h);
+		}
+
+		binaryMsg = g_bytes_new_take(data, size);
+	}
+
+	if( needText )
+	{
+		nlohmann::json json;
+
+		json["type"]       = "detections";
+		json["timestamp"]  = timestamp;
+		json["frame"]      = frame;
+		json["width"]      = width;
+		json["height"]     = height;
+		json["detections"] = nlohmann::json::array();
+
+		for( uint32_t n=0; n < numDetections; n++ )
+		{
+			nlohmann::json detection;
+
+			detection["class"]      = detections[n].ClassID;
+			detection["confidence"] = detections[n].Confidence;
+			detection["track_id"]   = detections[n].TrackID;
+			detection["left"]       = detections[n].Left;
+			detection["top"]        = detections[n].Top;
+			detection["right"]      = detections[n].Right;
+			detection["bottom"]     = detections[n].Bottom;
+
+			json["detections"].push_back(detection);
+		}
+
+		const std::string str = json.dump();
+		textMsg = g_bytes_new(str.c_str(), str.length() + 1);	// include the NULL-terminator for send_text()
+	}
+
+	// queue the message for each peer, dropping their oldest frames if they've fallen behind
+	mMutex.Lock();
+
+	for( size_t n=0; n < mPeers.size(); n++ )
+	{
+		Peer* peer = mPeers[n];
+		GBytes* msg = peer->binary ? binaryMsg : textMsg;
+
+		if( !msg )
+			continue;	// the peer changed encodings since the check above
+
+		peer->queue.push_back(g_bytes_ref(msg));
+
+		while( peer->queue.size() > mQueueSize )
+		{
+			g_bytes_unref(peer->queue.front());
+			peer->queue.pop_front();
+			peer->framesDropped++;
+		}
+	}
+
+	// send them from the server's event loop
+	if( mFlushSource == 0 && !mClosing )
+		mFlushSource = scheduleFlush(0);
+
+	mMutex.Unlock();
+
+	if( binaryMsg != NULL )
+		g_bytes_unref(binaryMsg);
+
+	if( textMsg != NULL )
+		g_bytes_unref(textMsg);
+
+	return true;
+}
+
+
+// isWritable
+static bool isWritable( SoupWebsocketConnection* connection )
+{
+	if( soup_websocket_connection_get_state(connection) != SOUP_WEBSOCKET_STATE_OPEN )
+		return false;
+
+	GIOStream* stream = soup_websocket_connection_get_io_stream(connection);
+
+	if( !stream )
+		return false;
+
+	GOutputStream* output = g_io_stream_get_output_stream(stream);
+
+	// if the socket is full, libsoup would queue the message internally (without bound)
+	if( G_IS_POLLABLE_OUTPUT_STREAM(output) && g_pollable_output_stream_can_poll(G_POLLABLE_OUTPUT_STREAM(output)) )
+		return g_pollable_output_stream_is_writable(G_POLLABLE_OUTPUT_STREAM(output));
+
+	return true;
+}
+
+
+// onFlush
+gboolean detectionPublisher::onFlush( void* user_data )
+{
+	detectionPublisher* publisher = (detectionPublisher*)user_data;
+
+	if( !publisher )
+		return G_SOURCE_REMOVE;
+
+	publisher->flush();
+	return G_SOURCE_REMOVE;
+}
+
+
+// flush (called from the server thread)
+void detectionPublisher::flush()
+{
+	mMutex.Lock();
+
+	mFlushSource = 0;
+
+	if( mClosing )
+	{
+		mMutex.Unlock();
+		return;
+	}
+
+	bool pending = false;
+
+	const double now = timeDouble();
+
+	for( size_t n=0; n < mPeers.size(); n++ )
+	{
+		Peer* peer = mPeers[n];
+		SoupWebsocketConnection* connection = peer->peer->connection;
+
+		while( peer->queue.size() > 0 )
+		{
+			if( !isWritable(connection) )
+			{
+				pending = true;
+				break;
+			}
+
+			GBytes* msg = peer->queue.front();
+			peer->queue.pop_front();
+
+			gsize size = 0;
+			const void* data = g_bytes_get_data(msg, &size);
+
+			if( peer->binary )
+			{
+				soup_websocket_connection_send_binary(connection, data, size);
+			}
+			else
+			{
+				soup_websocket_connection_send_text(connection, (const char*)data);
+				size--;	// NULL-terminator
+			}
+
+			g_bytes_unref(msg);
+
+			peer->framesSent++;
+			peer->bytesSent += size;
+		}
+
+		// update the send rates about once per second
+		const double elapsed = (now - peer->rateTime) * 0.001;
+
+		if( elapsed >= 1.0 )
+		{
+			peer->framesPerSec = (peer->framesSent - peer->rateFrames) / elapsed;
+			peer->bytesPerSec = (peer->bytesSent - peer->rateBytes) / elapsed;
+
+			peer->rateTime = now;
+			peer->rateFrames = peer->framesSent;
+			peer->rateBytes = peer->bytesSent;
+		}
+	}
+
+	// retry the peers that couldn't keep up
+	if( pending )
+		mFlushSource = scheduleFlush(FLUSH_RETRY_INTERVAL);
+
+	mMutex.Unlock();
+}
+
+
+// scheduleFlush
+uint32_t detectionPublisher::scheduleFlush( uint32_t delay )
+{
+	EventLoop* loop = mServer->GetEventLoop();
+
+	if( loop != NULL )
+		return (delay > 0) ? loop->AddTimeout(delay, onFlush, this) : loop->AddIdle(onFlush, this);
+
+	// the server is processing requests from the default context
+	return (delay > 0) ? g_timeout_add(delay, onFlush, this) : g_idle_add(onFlush, this);
+}
+
+
+// removeFlush
+void detectionPublisher::removeFlush( uint32_t source )
+{
+	EventLoop* loop = mServer->GetEventLoop();
+
+	if( loop != NULL )
+		loop->RemoveSource(source);
+	else
+		g_source_remove(source);
+}
+
+
+// onTeardown
+gboolean detectionPublisher::onTeardown( void* user_data )
+{
+	detectionPublisher* publisher = (detectionPublisher*)user_data;
+
+	if( publisher != NULL )
+		publisher->teardown();
+
+	return G_SOURCE_REMOVE;
+}
+
+
+// teardown (called from the server thread, or the thread calling WebRTCServer::ProcessRequests() if it isn't threaded)
+void detectionPublisher::teardown()
+{
+	if( mServer != NULL )
+		mServer->AddRoute(mPath.c_str(), (WebRTCServer::WebsocketListener)NULL);	// disconnects the peers
+
+	mMutex.Lock();
+
+	for( size_t n=0; n < mPeers.size(); n++ )
+		freePeer(mPeers[n]);
+
+	mPeers.clear();
+	mBinaryPeers = 0;
+	mNumPeers.store(0);
+
+	mMutex.Unlock();
+}
+
+
+// onWebsocket (called from the server thread)
+void detectionPublisher::onWebsocket( WebRTCPeer* peer, const char* message, size_t message_size, void* user_data )
+{
+	detectionPublisher* publisher = (detectionPublisher*)user_data;
+
+	if( !publisher || !peer )
+		return;
+
+	// peer disconnected
+	if( peer->flags & WEBRTC_PEER_CLOSED )
+	{
+		publisher->mMutex.Lock();
+
+		Peer* state = publisher->findPeer(peer);
+
+		if( state != NULL )
+		{
+			if( state->binary )
+				publisher->mBinaryPeers--;
+
+			publisher->mPeers.erase(std::find(publisher->mPeers.begin(), publisher->mPeers.end(), state));
+			publisher->freePeer(state);
+			publisher->mNumPeers.store(publisher->mPeers.size());
+		}
+
+		publisher->mMutex.Unlock();
+		return;
+	}
+
+	// new peer
+	if( !message )
+	{
+		if( !(peer->flags & WEBRTC_PEER_CONNECTING) )
+			return;
+
+		Peer* state = new Peer();
+
+		state->peer          = peer;
+		state->binary        = false;
+		state->framesSent    = 0;
+		state->framesDropped = 0;
+		state->bytesSent     = 0;
+		state->rateTime      = timeDouble();
+		state->rateFrames    = 0;
+		state->rateBytes     = 0;
+		state->framesPerSec  = 0.0f;
+		state->bytesPerSec   = 0.0f;
+
+		publisher->sendLabels(peer);
+
+		publisher->mMutex.Lock();
+		publisher->mPeers.push_back(state);
+		publisher->mNumPeers.store(publisher->mPeers.size());
+		publisher->mMutex.Unlock();
+
+		return;
+	}
+
+	// requests from the peer
+	const nlohmann::json json = nlohmann::json::parse(message, message + message_size, nullptr, false);
+
+	if( json.is_discarded() || !json.is_object() )
+	{
+		LogWarning(LOG_WEBRTC "detectionPublisher -- invalid message from %s (peer_id=%u)\n", peer->ip_address.c_str(), peer->ID);
+		return;
+	}
+
+	if( json.contains("encoding") && json["encoding"].is_string() )
+	{
+		const bool binary = (json["encoding"].get<std::string>() == "binary");
+
+		publisher->mMutex.Lock();
+
+		Peer* state = publisher->findPeer(peer);
+
+		if( state != NULL && state->binary != binary )
+		{
+			// the queued frames are in the other encoding
+			for( size_t n=0; n < state->queue.size(); n++ )
+				g_bytes_unref(state->queue[n]);
+
+			state->queue.clear();
+			state->binary = binary;
+
+			if( binary )
+				publisher->mBinaryPeers++;
+			else
+				publisher->mBinaryPeers--;
+		}
+
+		publisher->mMutex.Unlock();
+
+		LogVerbose(LOG_WEBRTC "detectionPublisher -- %s (peer_id=%u) switched to %s encoding\n", peer->ip_address.c_str(), peer->ID, binary ? "binary" : "json");
+	}
+
+	if( json.contains("type") && json["type"] == "stats" )
+		publisher->sendStats(peer);
+}
+
+
+// sendLabels
+void detectionPublisher::sendLabels( WebRTCPeer* peer )
+{
+	nlohmann::json json;
+
+	json["type"] = "labels";
+	json["labels"] = nlohmann::json::array();
+
+	if( mNet != NULL )
+	{
+		const uint32_t numClasses = mNet->GetNumClasses();
+
+		for( uint32_t n=0; n < numClasses; n++ )
+			json["labels"].push_back(mNet->GetClassDesc(n));
+	}
+
+	soup_websocket_connection_send_text(peer->connection, json.dump().c_str());
+}
+
+
+// sendStats
+void detectionPublisher::sendStats( WebRTCPeer* peer )
+{
+	const std::vector<PeerStats> stats = GetStats();
+
+	nlohmann::json json;
+
+	json["type"] = "stats";
+	json["peers"] = nlohmann::json::array();
+
+	for( size_t n=0; n < stats.size(); n++ )
+	{
+		nlohmann::json entry;
+
+		entry["peer_id"]        = stats[n].ID;
+		entry["address"]        = stats[n].address;
+		entry["encoding"]       = stats[n].binary ? "binary" : "json";
+		entry["queued"]         = stats[n].queued;
+		entry["frames_sent"]    = stats[n].framesSent;
+		entry["frames_dropped"] = stats[n].framesDropped;
+		entry["bytes_sent"]     = stats[n].bytesSent;
+		entry["frames_per_sec"] = stats[n].framesPerSec;
+		entry["bytes_per_sec"]  = stats[n].bytesPerSec;
+
+		json["peers"].push_back(entry);
+	}
+
+	soup_websocket_connection_send_text(peer->connection, json.dump().c_str());
+}
+
+
+// GetStats
+std::vector<detectionPublisher::PeerStats> detectionPublisher::GetStats() const
+{
+	std::vector<PeerStats> stats;
+
+	mMutex.Lock();
+
+	for( size_t n=0; n < mPeers.size(); n++ )
+	{
+		const Peer* peer = mPeers[n];
+		PeerStats entry;
+
+		entry.ID            = peer->peer->ID;
+		entry.address       = peer->peer->ip_address;
+		entry.binary        = peer->binary;
+		entry.queued        = peer->queue.size();
+		entry.framesSent    = peer->framesSent;
+		entry.framesDropped = peer->framesDropped;
+		entry.bytesSent     = peer->bytesSent;
+		entry.framesPerSec  = peer->framesPerSec;
+		entry.bytesPerSec   = peer->bytesPerSec;
+
+		stats.push_back(entry);
+	}
+
+	mMutex.Unlock();
+	return stats;
+}
+
+
+// findPeer
+detectionPublisher::Peer* detectionPublisher::findPeer( WebRTCPeer* peer ) const
+{
+	for( size_t n=0; n < mPeers.size(); n++ )
+	{
+		if( mPeers[n]->peer == peer )
+			return mPeers[n];
+	}
+
+	return NULL;
+}
+
+
+// freePeer
+void detectionPublisher::freePeer( Peer* peer )
+{
+	for( size_t n=0; n < peer->queue.size(); n++ )
+		g_bytes_unref(peer->queue[n]);
+
+	delete peer;
+}
@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __DETECTION_PUBLISHER_H__
+#define __DETECTION_PUBLISHER_H__
+
+
+#include "yoloNet.h"
+#include "WebRTCServer.h"
+#include "Mutex.h"
+
+#include <atomic>
+#include <deque>
+#include <string>
+#include <vector>
+
+
+/**
+ * Default websocket route that detections are published on.
+ * @ingroup detectionPublisher
+ */
+#define DETECTION_PUBLISHER_DEFAULT_PATH  "/detections"
+
+/**
+ * Default number of frames that can be queued for each peer before the oldest are dropped.
+ * @ingroup detectionPublisher
+ */
+#define DETECTION_PUBLISHER_DEFAULT_QUEUE  4
+
+
+/**
+ * Standard command-line options able to be passed to detectionPublisher::Create()
+ * @ingroup detectionPublisher
+ */
+#define DETECTION_PUBLISHER_USAGE_STRING  "detectionPublisher arguments: \n" 	\
+		  "  --publish-detections[=PATH]  stream the detections to websocket clients on PATH\n"	\
+		  "                               of the WebRTC server (default: /detections)\n"			\
+		  "  --publish-port=PORT          port of the WebRTC server (default: the webrtc:// output\n"	\
+		  "                               port, or 41567)\n"									\
+		  "  --publish-queue=N            frames queued per client before dropping (default: 4)\n\n"
+
+
+/**
+ * Publishes the detections from each frame to websocket clients, using
+ * the same WebRTCServer (and port) that serves the WebRTC video streams.
+ * Clients can then draw the bounding boxes themselves over the video.
+ *
+ * When a client connects, it's sent the class labels as JSON:
+ *
+ *    {"type": "labels", "labels": ["person", "car", ...]}
+ *
+ * By default the detections are sent as JSON text messages (with the bounding boxes in pixels):
+ *
+ *    {"type": "detections", "timestamp": 123, "frame": 5, "width": 1280, "height": 720,
+ *     "detections": [{"class": 0, "confidence": 0.9, "track_id": -1, "left": 10, "top": 20, "right": 30, "bottom": 40}]}
+ *
+ * Clients can switch to the compact binary encoding by sending `{"encoding": "binary"}`.
+ * Each binary message is a BinaryHeader followed by `numDetections` BinaryDetection
+ * structs (little-endian, with the bounding boxes normalized to 0-65535).
+ * Clients can also send `{"type": "stats"}` to get the per-peer throughput metrics.
+ *
+ * Publish() never blocks on the network - the messages are queued for each peer and sent
+ * from the server's GLib event loop when that peer's socket is writable.  If a peer falls
+ * behind, its oldest queued frames are dropped so it always receives the latest detections.
+ *
+ * @ingroup detectionPublisher
+ */
+class detectionPublisher
+{
+public:
+	/**
+	 * Header of the binary messages.
+	 */
+	struct BinaryHeader
+	{
+		char     magic[4];		/**< "DET1" */
+		uint32_t numDetections;	/**< number of BinaryDetection structs that follow */
+		uint64_t timestamp;		/**< frame timestamp (in nanoseconds) */
+		uint64_t frame;		/**< frame index */
+		uint16_t width;		/**< image width (in pixels) */
+		uint16_t height;		/**< image height (in pixels) */
+		uint32_t reserved;
+	};
+
+	/**
+	 * Detection in the binary messages.
+	 */
+	struct BinaryDetection
+	{
+		uint16_t classID;		/**< class index */
+		uint16_t confidence;	/**< confidence, scaled to 0-65535 */
+		int32_t  trackID;		/**< tracking ID (or -1 if untracked) */
+		uint16_t left;			/**< left coordinate, normalized by the image width to 0-65535 */
+		uint16_t top;			/**< top coordinate, normalized by the image height to 0-65535 */
+		uint16_t right;		/**< right coordinate, normalized by the image width to 0-65535 */
+		uint16_t bottom;		/**< bottom coordinate, normalized by the image height to 0-65535 */
+	};
+
+	/**
+	 * Throughput metrics of a connected peer.
+	 */
+	struct PeerStats
+	{
+		uint32_t    ID;			/**< WebRTCPeer::ID */
+		std::string address;	/**< IP address of the peer */
+		bool        binary;		/**< true if the peer is using the binary encoding */
+		uint32_t    queued;		/**< number of frames currently queued */
+		uint64_t    framesSent;	/**< number of frames sent */
+		uint64_t    framesDropped;	/**< number of frames dropped because the peer fell behind */
+		uint64_t    bytesSent;	/**< number of bytes sent */
+		float       framesPerSec;	/**< recent send rate (in frames per second) */
+		float       bytesPerSec;	/**< recent send rate (in bytes per second) */
+	};
+
+	/**
+	 * Create a new publisher on a websocket route of the WebRTC server running on this port.
+	 * @param port the port of the WebRTC server (it will be created if it's not already running)
+	 * @param path the websocket route to publish on
+	 * @param net if provided, the class labels will be sent to clients when they connect
+	 * @param queueSize the maximum number of frames queued for each peer
+	 */
+	static detectionPublisher* Create( uint16_t port=WEBRTC_DEFAULT_PORT, const char* path=DETECTION_PUBLISHER_DEFAULT_PATH,
+							     yoloNet* net=NULL, uint32_t queueSize=DETECTION_PUBLISHER_DEFAULT_QUEUE );
+
+	/**
+	 * Create a new publisher by parsing the command line.
+	 * @param port the default port of the WebRTC server, if `--publish-port` isn't specified.
+	 * @returns NULL if `--publish-detections` wasn't specified, or there was an error.
+	 */
+	static detectionPublisher* Create( const commandLine& cmdLine, yoloNet* net=NULL, uint16_t port=WEBRTC_DEFAULT_PORT );
+
+	/**
+	 * Destroy the publisher and disconnect its peers.
+	 */
+	~detectionPublisher();
+
+	/**
+	 * Queue the detections from a frame to be sent to all of the connected peers.
+	 * This can be called from any thread and doesn't block on the network.
+	 * @param timestamp the timestamp of the frame (in nanoseconds), see videoSource::GetLastTimestamp()
+	 * @param frame the frame index, see videoSource::GetFrameCount()
+	 */
+	bool Publish( uint64_t timestamp, uint64_t frame, uint32_t width, uint32_t height,
+			    const yoloNet::Detection* detections, uint32_t numDetections );
+
+	/**
+	 * Get the throughput metrics of the connected peers.
+	 */
+	std::vector<PeerStats> GetStats() const;
+
+	/**
+	 * Get the number of connected peers.
+	 */
+	inline uint32_t GetNumPeers() const				{ return mNumPeers.load(); }
+
+	/**
+	 * Get the websocket route being published on.
+	 */
+	inline const char* GetPath() const				{ return mPath.c_str(); }
+
+	/**
+	 * Usage string for command line arguments to Create()
+	 */
+	static inline const char* Usage() 				{ return DETECTION_PUBLISHER_USAGE_STRING; }
+
+protected:
+	detectionPublisher( const char* path, yoloNet* net, uint32_t queueSize );
+
+	struct Peer
+	{
+		WebRTCPeer* peer;
+		bool binary;
+
+		std::deque<GBytes*> queue;
+
+		uint64_t framesSent;
+		uint64_t framesDropped;
+		uint64_t bytesSent;
+
+		// for computing the recent rates
+		double   rateTime;
+		uint64_t rateFrames;
+		uint64_t rateBytes;
+		float    framesPerSec;
+		float    bytesPerSec;
+	};
+
+	static void onWebsocket( WebRTCPeer* peer, const char* message, size_t message_size, void* user_data );
+	static gboolean onFlush( void* user_data );
+	static gboolean onTeardown( void* user_data );
+
+	void flush();
+	uint32_t scheduleFlush( uint32_t delay );
+	void removeFlush( uint32_t source );
+	void teardown();
+	void sendLabels( WebRTCPeer* peer );
+	void sendStats( WebRTCPeer* peer );
+
+	Peer* findPeer( WebRTCPeer* peer ) const;
+	void  freePeer( Peer* peer );
+
+	WebRTCServer* mServer;
+	yoloNet* mNet;
+
+	std::string mPath;
+	std::vector<Peer*> mPeers;	// protected by mMutex
+	mutable Mutex mMutex;
+
+	uint32_t mQueueSize;
+	uint32_t mBinaryPeers;		// number of peers using the binary encoding
+	uint32_t mFlushSource;		// GSource ID of the pending flush (on the server's event loop)
+	bool     mClosing;		// set by the destructor, so a flush that's already running doesn't reschedule
+
+	std::atomic<uint32_t> mNumPeers;
+};
+
+#endif
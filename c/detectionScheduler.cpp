@@ -0,0 +1,398 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "detectionScheduler.h"
+#include "logging.h"
+
+#include <math.h>
+#include <time.h>
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+
+// monotonic time in seconds
+static inline double currentTime()
+{
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 0.000000001;
+}
+
+
+// Options constructor
+detectionScheduler::Options::Options()
+{
+	minRate      = 1.0f;
+	maxRate      = 0.0f;
+	activityHigh = 0.01f;
+	activityLow  = 0.002f;
+	holdTime     = 2.0f;
+	pixelLevel   = 16;
+	thumbWidth   = 128;
+}
+
+
+// constructor
+detectionScheduler::detectionScheduler( const Options& options ) : mOptions(options)
+{
+	mThumbWidth   = 0;
+	mThumbHeight  = 0;
+	mLastTime     = -1.0;
+	mPreviousTime = -1.0;
+	mDetectTime   = -1.0;
+	mStaticTime   = -1.0;
+	mFrameTime    = -1.0;
+	mWidth        = 0;
+	mHeight       = 0;
+	mActivity     = 0.0f;
+	mFrameRate    = 0.0f;
+	mRate         = options.maxRate;
+	mActive       = true;
+	mFrames       = 0;
+	mDetected     = 0;
+}
+
+
+// destructor
+detectionScheduler::~detectionScheduler()
+{
+
+}
+
+
+// Create
+detectionScheduler* detectionScheduler::Create( const Options& options )
+{
+	if( options.minRate <= 0.0f || options.maxRate < 0.0f || (options.maxRate > 0.0f && options.maxRate < options.minRate) )
+	{
+		LogError("detectionScheduler -- invalid rates (min=%g Hz, max=%g Hz)\n", options.minRate, options.maxRate);
+		return NULL;
+	}
+
+	if( options.activityLow > options.activityHigh )
+	{
+		LogError("detectionScheduler -- activityLow (%g) must be less than activityHigh (%g)\n", options.activityLow, options.activityHigh);
+		return NULL;
+	}
+
+	if( options.thumbWidth < 8 )
+	{
+		LogError("detectionScheduler -- thumbnail width must be at least 8 pixels (was %u)\n", options.thumbWidth);
+		return NULL;
+	}
+
+	LogVerbose("detectionScheduler -- detection rate %g-%g Hz, activity %g-%g, hold %gs\n", options.minRate, options.maxRate,
+			 options.activityLow, options.activityHigh, options.holdTime);
+
+	return new detectionScheduler(options);
+}
+
+
+// Create
+detectionScheduler* detectionScheduler::Create( const commandLine& cmdLine )
+{
+	if( !cmdLine.GetFlag("adaptive-rate") )
+		return NULL;
+
+	Options options;
+
+	options.minRate      = cmdLine.GetFloat("detect-min-rate", options.minRate);
+	options.maxRate      = cmdLine.GetFloat("detect-max-rate", options.maxRate);
+	options.activityHigh = cmdLine.GetFloat("activity-high", options.activityHigh);
+	options.activityLow  = cmdLine.GetFloat("activity-low", options.activityLow);
+	options.holdTime     = cmdLine.GetFloat("activity-hold", options.holdTime);
+	options.pixelLevel   = std::min(cmdLine.GetUnsignedInt("activity-pixel", options.pixelLevel), 255U);
+	options.thumbWidth   = cmdLine.GetUnsignedInt("activity-size", options.thumbWidth);
+
+	return Create(options);
+}
+
+
+// luma of a pixel (the weights are symmetric in R/B, so BGR works the same)
+template<typename T> static inline uint32_t pixelLuma( const T* px, uint32_t channels )
+{
+	if( channels < 3 )
+		return px[0];
+
+	return ((uint32_t)px[0] + 2 * (uint32_t)px[1] + (uint32_t)px[2]) >> 2;
+}
+
+
+// luma of a float pixel (0-255)
+template<> inline uint32_t pixelLuma<float>( const float* px, uint32_t channels )
+{
+	const float luma = (channels < 3) ? px[0] : (px[0] + 2.0f * px[1] + px[2]) * 0.25f;
+	return (luma > 0.0f) ? (uint32_t)luma : 0;
+}
+
+
+// downscale an image to a luma thumbnail, averaging 4 samples spread over each block
+template<typename T> static void downscaleLuma( const T* image, uint32_t width, uint32_t height, uint32_t channels,
+								        uint8_t* thumb, uint32_t thumbWidth, uint32_t thumbHeight )
+{
+	for( uint32_t ty=0; ty < thumbHeight; ty++ )
+	{
+		const uint32_t y0 = (ty * height) / thumbHeight;
+		const uint32_t y1 = ((ty + 1) * height) / thumbHeight;
+
+		const T* row0 = image + (size_t)(y0 + (y1 - y0) / 4) * width * channels;
+		const T* row1 = image + (size_t)(y0 + (y1 - y0) * 3 / 4) * width * channels;
+
+		for( uint32_t tx=0; tx < thumbWidth; tx++ )
+		{
+			const uint32_t x0 = (tx * width) / thumbWidth;
+			const uint32_t x1 = ((tx + 1) * width) / thumbWidth;
+
+			const size_t c0 = (x0 + (x1 - x0) / 4) * channels;
+			const size_t c1 = (x0 + (x1 - x0) * 3 / 4) * channels;
+
+			const uint32_t sum = pixelLuma(row0 + c0, channels) + pixelLuma(row0 + c1, channels)
+						    + pixelLuma(row1 + c0, channels) + pixelLuma(row1 + c1, channels);
+
+			thumb[ty * thumbWidth + tx] = std::min(sum >> 2, 255U);
+		}
+	}
+}
+
+
+// count the number of bytes that differ by more than the level
+static size_t countChanged( const uint8_t* a, const uint8_t* b, size_t size, uint8_t level )
+{
+	size_t count = 0;
+	size_t n = 0;
+
+#if defined(__SSE2__)
+	const __m128i threshold = _mm_set1_epi8((char)level);
+	const __m128i zero = _mm_setzero_si128();
+
+	for( ; n + 16 <= size; n += 16 )
+	{
+		const __m128i va = _mm_loadu_si128((const __m128i*)(a + n));
+		const __m128i vb = _mm_loadu_si128((const __m128i*)(b + n));
+
+		const __m128i diff = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+		const __m128i same = _mm_cmpeq_epi8(_mm_subs_epu8(diff, threshold), zero);
+
+		count += __builtin_popcount(~_mm_movemask_epi8(same) & 0xFFFF);
+	}
+#elif defined(__aarch64__)
+	const uint8x16_t threshold = vdupq_n_u8(level);
+
+	for( ; n + 16 <= size; n += 16 )
+	{
+		const uint8x16_t changed = vcgtq_u8(vabdq_u8(vld1q_u8(a + n), vld1q_u8(b + n)), threshold);
+		count += vaddvq_u8(vshrq_n_u8(changed, 7));
+	}
+#endif
+
+	for( ; n < size; n++ )
+	{
+		if( abs((int)a[n] - (int)b[n]) > level )
+			count++;
+	}
+
+	return count;
+}
+
+
+// downscale
+bool detectionScheduler::downscale( void* image, uint32_t width, uint32_t height, imageFormat format )
+{
+	if( !image || width == 0 || height == 0 )
+		return false;
+
+	if( !imageFormatIsRGB(format) && !imageFormatIsBGR(format) && !imageFormatIsGray(format) )
+		return false;
+
+	const uint32_t thumbWidth = std::min(mOptions.thumbWidth, width);
+	const uint32_t thumbHeight = std::max(std::min((uint32_t)(thumbWidth * height / width), height), 1U);
+
+	if( thumbWidth != mThumbWidth || thumbHeight != mThumbHeight )
+	{
+		mThumb.resize(thumbWidth * thumbHeight);
+		mReference.clear();	// the resolution changed
+
+		mThumbWidth = thumbWidth;
+		mThumbHeight = thumbHeight;
+	}
+
+	const uint32_t channels = imageFormatChannels(format);
+
+	if( imageFormatBaseType(format) == IMAGE_FLOAT )
+		downscaleLuma((const float*)image, width, height, channels, mThumb.data(), mThumbWidth, mThumbHeight);
+	else
+		downscaleLuma((const uint8_t*)image, width, height, channels, mThumb.data(), mThumbWidth, mThumbHeight);
+
+	return true;
+}
+
+
+// Process
+bool detectionScheduler::Process( void* image, uint32_t width, uint32_t height, imageFormat format )
+{
+	const double time = currentTime();
+
+	if( mFrameTime > 0.0 && time > mFrameTime )
+	{
+		const float rate = 1.0 / (time - mFrameTime);
+		mFrameRate = (mFrameRate > 0.0f) ? mFrameRate * 0.9f + rate * 0.1f : rate;
+	}
+
+	mFrameTime = time;
+	mWidth = width;
+	mHeight = height;
+	mFrames++;
+
+	// measure the activity since the last detection
+	if( !downscale(image, width, height, format) )
+		mActivity = 1.0f;	// unsupported format, so always run detection
+	else if( mReference.size() != mThumb.size() )
+		mActivity = 1.0f;
+	else
+		mActivity = float(countChanged(mThumb.data(), mReference.data(), mThumb.size(), mOptions.pixelLevel)) / float(mThumb.size());
+
+	// switch between active/static with hysteresis
+	if( mActivity >= mOptions.activityHigh )
+	{
+		if( !mActive )
+			LogVerbose("detectionScheduler -- scene active (activity %.4f)\n", mActivity);
+
+		mActive = true;
+		mStaticTime = -1.0;
+	}
+	else if( mActivity < mOptions.activityLow )
+	{
+		if( mStaticTime < 0.0 )
+			mStaticTime = time;
+
+		if( mActive && time - mStaticTime >= mOptions.holdTime )
+		{
+			LogVerbose("detectionScheduler -- scene static (activity %.4f)\n", mActivity);
+			mActive = false;
+		}
+	}
+	else
+	{
+		mStaticTime = -1.0;
+	}
+
+	if( mActive )
+		mRate = mOptions.maxRate;
+
+	// decide if detection should run on this frame
+	const double elapsed = time - mDetectTime;
+	bool detect = false;
+
+	if( mDetectTime < 0.0 || elapsed >= 1.0 / mOptions.minRate )
+		detect = true;		// the minimum rate bounds the latency
+	else if( mRate <= 0.0f )
+		detect = mActive;	// every active frame
+	else
+		detect = (elapsed >= 1.0 / mRate);
+
+	if( !detect )
+		return false;
+
+	mReference.swap(mThumb);
+	mThumb.resize(mReference.size());
+
+	mDetectTime = time;
+	mDetected++;
+
+	return true;
+}
+
+
+// Update
+void detectionScheduler::Update( const yoloNet::Detection* detections, int numDetections )
+{
+	mPrevious.swap(mLast);
+	mPreviousTime = mLastTime;
+
+	if( detections != NULL && numDetections > 0 )
+		mLast.assign(detections, detections + numDetections);
+	else
+		mLast.clear();
+
+	mLastTime = mFrameTime;
+
+	// slow down after each detection once the scene is static
+	if( !mActive )
+	{
+		const float rate = (mRate > 0.0f) ? mRate : mFrameRate;
+		mRate = std::max(rate * 0.5f, mOptions.minRate);
+	}
+}
+
+
+// Predict
+int detectionScheduler::Predict( yoloNet::Detection** detections )
+{
+	mPredicted = mLast;
+
+	const double interval = mLastTime - mPreviousTime;
+	const double elapsed = std::min(mFrameTime - mLastTime, 1.0 / mOptions.minRate);
+
+	if( mPreviousTime >= 0.0 && interval > 0.0 && elapsed > 0.0 )
+	{
+		// move tracked objects along their velocity from the last two detections
+		for( size_t n=0; n < mPredicted.size(); n++ )
+		{
+			yoloNet::Detection& det = mPredicted[n];
+
+			if( det.TrackID < 0 )
+				continue;
+
+			for( size_t m=0; m < mPrevious.size(); m++ )
+			{
+				if( mPrevious[m].TrackID != det.TrackID )
+					continue;
+
+				const float scale = elapsed / interval;
+
+				float dx = (det.Left + det.Right - mPrevious[m].Left - mPrevious[m].Right) * 0.5f * scale;
+				float dy = (det.Top + det.Bottom - mPrevious[m].Top - mPrevious[m].Bottom) * 0.5f * scale;
+
+				// keep the box inside of the image
+				dx = std::min(std::max(dx, -det.Left), mWidth - det.Right);
+				dy = std::min(std::max(dy, -det.Top), mHeight - det.Bottom);
+
+				det.Left += dx;
+				det.Right += dx;
+				det.Top += dy;
+				det.Bottom += dy;
+				break;
+			}
+		}
+	}
+
+	if( detections != NULL )
+		*detections = mPredicted.size() > 0 ? mPredicted.data() : NULL;
+
+	return mPredicted.size();
+}
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __DETECTION_SCHEDULER_H__
+#define __DETECTION_SCHEDULER_H__
+
+
+#include "yoloNet.h"
+#include "commandLine.h"
+
+#include <vector>
+
+
+/**
+ * Standard command-line options able to be passed to detectionScheduler::Create()
+ * @ingroup detectionScheduler
+ */
+#define DETECTION_SCHEDULER_USAGE_STRING  "detectionScheduler arguments: \n" 	\
+		  "  --adaptive-rate              skip inference on frames where the scene hasn't changed\n"	\
+		  "  --detect-min-rate=HZ         minimum detection rate on static scenes (default: 1)\n"	\
+		  "  --detect-max-rate=HZ         maximum detection rate on active scenes (default: 0,\n"	\
+		  "                               which runs detection on every active frame)\n"			\
+		  "  --activity-high=FRACTION     fraction of changed pixels that switches to the maximum\n"	\
+		  "                               rate (default: 0.01)\n"								\
+		  "  --activity-low=FRACTION      fraction of changed pixels below which the scene is\n"	\
+		  "                               considered static (default: 0.002)\n"					\
+		  "  --activity-hold=SECONDS      time the scene must stay static before the rate starts\n"	\
+		  "                               to drop (default: 2.0)\n"								\
+		  "  --activity-pixel=LEVEL       luma difference counted as a changed pixel (default: 16)\n"	\
+		  "  --activity-size=WIDTH        width of the downscaled frames that are compared\n"		\
+		  "                               (default: 128)\n\n"
+
+
+/**
+ * Adaptive scheduler that decides which frames to run detection on, based on scene activity.
+ *
+ * Each frame is downscaled on the CPU to a small luma thumbnail, which is compared
+ * (with SSE2 or NEON) against the thumbnail of the frame that detection last ran on.
+ * The fraction of pixels that changed by more than the `pixel` level is the activity.
+ *
+ * When the activity rises above `activityHigh`, detection runs right away and then at
+ * up to `maxRate`.  Once it stays below `activityLow` for `holdTime` seconds, the rate
+ * is halved after each detection until it reaches `minRate` - which also bounds the
+ * reaction latency to slow changes.  Activity between the two thresholds keeps the
+ * current state, so noise around a single threshold doesn't make the rate oscillate.
+ *
+ * On frames that are skipped, Predict() returns the last detections - extrapolated
+ * by their velocity if they have track IDs from a tracker - so the overlay and the
+ * downstream consumers still get results for every frame:
+ *
+ *    if( scheduler->Process(image, width, height) )
+ *    {
+ *        numDetections = net->Detect(image, width, height, &detections, overlay);
+ *        scheduler->Update(detections, numDetections);
+ *    }
+ *    else
+ *    {
+ *        numDetections = scheduler->Predict(&detections);
+ *        net->Overlay(image, image, width, height, detections, numDetections, overlay);
+ *    }
+ *
+ * The image needs to be accessible from the CPU (like the mapped memory from videoSource).
+ *
+ * @ingroup detectionScheduler
+ */
+class detectionScheduler
+{
+public:
+	/**
+	 * Scheduler settings.
+	 */
+	struct Options
+	{
+		float    minRate;		/**< minimum detection rate on static scenes (in Hz) */
+		float    maxRate;		/**< maximum detection rate on active scenes (in Hz, or 0 for every frame) */
+		float    activityHigh;	/**< fraction of changed pixels that switches to the maximum rate */
+		float    activityLow;	/**< fraction of changed pixels below which the scene is static */
+		float    holdTime;		/**< seconds the scene must stay static before the rate drops */
+		uint8_t  pixelLevel;	/**< luma difference (0-255) counted as a changed pixel */
+		uint32_t thumbWidth;	/**< width of the downscaled frames that are compared */
+
+		Options();
+	};
+
+	/**
+	 * Create a new scheduler.
+	 */
+	static detectionScheduler* Create( const Options& options=Options() );
+
+	/**
+	 * Create a new scheduler by parsing the command line.
+	 * @returns NULL if `--adaptive-rate` wasn't specified, or there was an error.
+	 */
+	static detectionScheduler* Create( const commandLine& cmdLine );
+
+	/**
+	 * Destroy the scheduler.
+	 */
+	~detectionScheduler();
+
+	/**
+	 * Measure the activity of the frame, and decide if detection should run on it.
+	 * @returns true if detection should run on this frame (then call Update() with the results),
+	 *          or false if it should be skipped (then call Predict() instead).
+	 */
+	template<typename T> bool Process( T* image, uint32_t width, uint32_t height )		{ return Process((void*)image, width, height, imageFormatFromType<T>()); }
+
+	/**
+	 * Measure the activity of the frame, and decide if detection should run on it.
+	 * @returns true if detection should run on this frame (then call Update() with the results),
+	 *          or false if it should be skipped (then call Predict() instead).
+	 */
+	bool Process( void* image, uint32_t width, uint32_t height, imageFormat format );
+
+	/**
+	 * Store the results of detection on the frame that Process() last returned true for.
+	 */
+	void Update( const yoloNet::Detection* detections, int numDetections );
+
+	/**
+	 * Get the detections for a skipped frame.  These are the last detections, moved along
+	 * their velocities if they're being tracked.  The returned pointer remains valid until
+	 * the next call to Update() or Predict().
+	 * @returns the number of detections
+	 */
+	int Predict( yoloNet::Detection** detections );
+
+	/**
+	 * Get the activity of the last frame (the fraction of pixels that changed since the last detection)
+	 */
+	inline float GetActivity() const					{ return mActivity; }
+
+	/**
+	 * Get the current detection rate that the scheduler is targeting (in Hz, or 0 for every frame)
+	 */
+	inline float GetRate() const						{ return mRate; }
+
+	/**
+	 * Return true if the scene is currently considered active.
+	 */
+	inline bool IsActive() const						{ return mActive; }
+
+	/**
+	 * Get the fraction of frames that detection ran on (since the scheduler was created).
+	 */
+	inline float GetDetectRatio() const				{ return mFrames > 0 ? float(mDetected) / float(mFrames) : 0.0f; }
+
+	/**
+	 * Get the settings of the scheduler.
+	 */
+	inline const Options& GetOptions() const			{ return mOptions; }
+
+	/**
+	 * Usage string for command line arguments to Create()
+	 */
+	static inline const char* Usage() 				{ return DETECTION_SCHEDULER_USAGE_STRING; }
+
+protected:
+	detectionScheduler( const Options& options );
+
+	bool downscale( void* image, uint32_t width, uint32_t height, imageFormat format );
+
+	Options mOptions;
+
+	std::vector<uint8_t> mThumb;		// downscaled luma of the current frame
+	std::vector<uint8_t> mReference;	// downscaled luma of the last frame that detection ran on
+
+	uint32_t mThumbWidth;
+	uint32_t mThumbHeight;
+
+	std::vector<yoloNet::Detection> mLast;		// results of the last detection
+	std::vector<yoloNet::Detection> mPrevious;	// results of the detection before that
+	std::vector<yoloNet::Detection> mPredicted;
+
+	double mLastTime;		// time of the frame with the last detections (in seconds)
+	double mPreviousTime;	// time of the frame with the detections before that
+	double mDetectTime;		// time that Process() last returned true
+	double mStaticTime;		// time that the activity dropped below activityLow (or -1)
+	double mFrameTime;		// time of the current frame
+
+	uint32_t mWidth;
+	uint32_t mHeight;
+
+	float mActivity;
+	float mFrameRate;		// average camera frame rate
+	float mRate;
+	bool  mActive;
+
+	uint64_t mFrames;
+	uint64_t mDetected;
+};
+
+#endif
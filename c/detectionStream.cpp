@@ -0,0 +1,945 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "detectionStream.h"
+#include "csvReader.h"
+#include "csvWriter.h"
+#include "logging.h"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+using namespace detectionStream;
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "detectionStream only supports little-endian hosts"
+#endif
+
+static const char FILE_MAGIC[4]    = { 'D', 'T', 'S', 'T' };
+static const char CHUNK_MAGIC[4]   = { 'C', 'H', 'N', 'K' };
+static const char TRAILER_MAGIC[4] = { 'D', 'T', 'I', 'X' };
+
+#define ALIGN_UP(x) (((x) + ALIGN - 1) & ~(uint64_t)(ALIGN - 1))
+
+
+// constructor
+detectionStreamWriter::detectionStreamWriter()
+{
+	mFile          = -1;
+	mBuffer        = NULL;
+	mBufferSize    = 0;
+	mChunkSize     = 0;
+	mChunkUsed     = sizeof(ChunkHeader);
+	mFlushInterval = 0;
+	mOffset        = 0;
+	mNumRecords    = 0;
+	mLastTimestamp = 0;
+	mOutOfOrder    = false;
+
+	memset(&mChunk, 0, sizeof(mChunk));
+}
+
+
+// destructor
+detectionStreamWriter::~detectionStreamWriter()
+{
+	Close();
+}
+
+
+// Open
+detectionStreamWriter* detectionStreamWriter::Open( const char* filename, size_t chunkSize, uint64_t flushInterval )
+{
+	if( !filename )
+		return NULL;
+
+	detectionStreamWriter* writer = new detectionStreamWriter();
+
+	writer->mFilename      = filename;
+	writer->mChunkSize     = ALIGN_UP(std::max(chunkSize, (size_t)ALIGN));
+	writer->mBufferSize    = writer->mChunkSize;
+	writer->mFlushInterval = flushInterval;
+
+	if( posix_memalign((void**)&writer->mBuffer, ALIGN, writer->mBufferSize) != 0 )
+	{
+		LogError(LOG_DETSTREAM "failed to allocate %zu byte chunk buffer\n", writer->mBufferSize);
+		delete writer;
+		return NULL;
+	}
+
+	writer->mFile = open(filename, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+
+	if( writer->mFile < 0 )
+	{
+		LogError(LOG_DETSTREAM "failed to open '%s' for writing (%s)\n", filename, strerror(errno));
+		delete writer;
+		return NULL;
+	}
+
+	// write the file header, padded so the first chunk is aligned
+	timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+
+	FileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+
+	header.versionMajor = DETECTION_STREAM_VERSION_MAJOR;
+	header.versionMinor = DETECTION_STREAM_VERSION_MINOR;
+	header.headerSize   = sizeof(FileHeader);
+	header.chunkAlign   = ALIGN;
+	header.created      = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+
+	memset(writer->mBuffer, 0, ALIGN);
+	memcpy(writer->mBuffer, &header, sizeof(header));
+
+	if( !writer->writeAligned(writer->mBuffer, ALIGN) )
+	{
+		delete writer;
+		return NULL;
+	}
+
+	writer->mOffset = ALIGN;
+
+	LogVerbose(LOG_DETSTREAM "opened '%s' for writing (chunk size %zu bytes)\n", filename, writer->mChunkSize);
+	return writer;
+}
+
+
+// PackRecord
+uint32_t detectionStream::PackRecord( void* output, uint64_t timestamp, uint64_t frame, const yoloNet::Detection* detections, uint32_t numDetections )
+{
+	const uint32_t recordSize = RecordSize(numDetections);
+
+	uint8_t* ptr = (uint8_t*)output;
+	RecordHeader* record = (RecordHeader*)ptr;
+
+	record->size          = recordSize;
+	record->numDetections = numDetections;
+	record->timestamp     = timestamp;
+	record->frame         = frame;
+
+	uint32_t* classID    = (uint32_t*)(ptr + sizeof(RecordHeader));
+	float* confidence    = (float*)(classID + numDetections);
+	float* left          = confidence + numDetections;
+	float* top           = left + numDetections;
+	float* right         = top + numDetections;
+	float* bottom        = right + numDetections;
+	int32_t* trackID     = (int32_t*)(bottom + numDetections);
+	int32_t* trackStatus = trackID + numDetections;
+	int32_t* trackFrames = trackStatus + numDetections;
+	int32_t* trackLost   = trackFrames + numDetections;
+
+	for( uint32_t n=0; n < numDetections; n++ )
+	{
+		classID[n]     = detections[n].ClassID;
+		confidence[n]  = detections[n].Confidence;
+		left[n]        = detections[n].Left;
+		top[n]         = detections[n].Top;
+		right[n]       = detections[n].Right;
+		bottom[n]      = detections[n].Bottom;
+		trackID[n]     = detections[n].TrackID;
+		trackStatus[n] = detections[n].TrackStatus;
+		trackFrames[n] = detections[n].TrackFrames;
+		trackLost[n]   = detections[n].TrackLost;
+	}
+
+	// zero the padding
+	uint8_t* end = (uint8_t*)(trackLost + numDetections);
+	memset(end, 0, (ptr + recordSize) - end);
+
+	return recordSize;
+}
+
+
+// Write
+bool detectionStreamWriter::Write( uint64_t timestamp, uint64_t frame, const yoloNet::Detection* detections, uint32_t numDetections )
+{
+	if( mFile < 0 )
+		return false;
+
+	if( numDetections > 0 && !detections )
+		return false;
+
+	const uint32_t recordSize = RecordSize(numDetections);
+
+	// write out the current chunk if this record doesn't fit or it's been buffered too long
+	if( mChunk.numRecords > 0 )
+	{
+		if( mChunkUsed + recordSize > mChunkSize || timestamp - mChunk.firstTimestamp >= mFlushInterval )
+		{
+			if( !writeChunk() )
+				return false;
+		}
+	}
+
+	// grow the buffer for frames with more detections than fit in a chunk
+	const size_t required = ALIGN_UP(sizeof(ChunkHeader) + recordSize);
+
+	if( required > mBufferSize )
+	{
+		uint8_t* buffer = NULL;
+
+		if( posix_memalign((void**)&buffer, ALIGN, required) != 0 )
+		{
+			LogError(LOG_DETSTREAM "failed to allocate %zu byte chunk buffer\n", required);
+			return false;
+		}
+
+		free(mBuffer);
+
+		mBuffer = buffer;
+		mBufferSize = required;
+	}
+
+	if( mNumRecords > 0 && timestamp < mLastTimestamp && !mOutOfOrder )
+	{
+		LogWarning(LOG_DETSTREAM "timestamps are out of order in '%s', seeking by time may be inaccurate\n", mFilename.c_str());
+		mOutOfOrder = true;
+	}
+
+	// pack the detections as structure-of-arrays
+	PackRecord(mBuffer + mChunkUsed, timestamp, frame, detections, numDetections);
+
+	// update the chunk header
+	if( mChunk.numRecords == 0 )
+	{
+		mChunk.firstTimestamp = timestamp;
+		mChunk.firstFrame = frame;
+	}
+
+	mChunk.lastTimestamp = timestamp;
+	mChunk.lastFrame = frame;
+	mChunk.numRecords++;
+
+	mChunkUsed += recordSize;
+	mLastTimestamp = timestamp;
+	mNumRecords++;
+
+	return true;
+}
+
+
+// writeChunk
+bool detectionStreamWriter::writeChunk()
+{
+	if( mChunk.numRecords == 0 )
+		return true;
+
+	const size_t chunkSize = ALIGN_UP(mChunkUsed);
+
+	memcpy(mChunk.magic, CHUNK_MAGIC, sizeof(CHUNK_MAGIC));
+
+	mChunk.chunkSize   = chunkSize;
+	mChunk.payloadSize = mChunkUsed - sizeof(ChunkHeader);
+
+	memcpy(mBuffer, &mChunk, sizeof(ChunkHeader));
+	memset(mBuffer + mChunkUsed, 0, chunkSize - mChunkUsed);
+
+	if( !writeAligned(mBuffer, chunkSize) )
+		return false;
+
+	IndexEntry entry;
+
+	entry.offset         = mOffset;
+	entry.firstTimestamp = mChunk.firstTimestamp;
+	entry.lastTimestamp  = mChunk.lastTimestamp;
+	entry.firstFrame     = mChunk.firstFrame;
+	entry.lastFrame      = mChunk.lastFrame;
+	entry.numRecords     = mChunk.numRecords;
+
+	mIndex.push_back(entry);
+
+	mOffset += chunkSize;
+	mChunkUsed = sizeof(ChunkHeader);
+
+	memset(&mChunk, 0, sizeof(mChunk));
+	return true;
+}
+
+
+// writeAligned
+bool detectionStreamWriter::writeAligned( const void* data, size_t size )
+{
+	const uint8_t* ptr = (const uint8_t*)data;
+
+	while( size > 0 )
+	{
+		const ssize_t written = write(mFile, ptr, size);
+
+		if( written < 0 )
+		{
+			if( errno == EINTR )
+				continue;
+
+			LogError(LOG_DETSTREAM "failed to write to '%s' (%s)\n", mFilename.c_str(), strerror(errno));
+			return false;
+		}
+
+		ptr += written;
+		size -= written;
+	}
+
+	return true;
+}
+
+
+// ImportCSV
+int64_t detectionStreamWriter::ImportCSV( const char* filename )
+{
+	csvReader csv(filename, ", ");
+	csvRow row;
+
+	if( !csv.Next(row) )
+	{
+		LogError(LOG_DETSTREAM "failed to read the CSV header from '%s'\n", filename);
+		return -1;
+	}
+
+	// find the columns from the header
+	enum { TIMESTAMP, FRAME, CLASS, CONFIDENCE, LEFT, TOP, RIGHT, BOTTOM, TRACK_ID, TRACK_STATUS, TRACK_FRAMES, TRACK_LOST, NUM_COLUMNS };
+	static const char* names[] = { "timestamp", "frame", "class", "confidence", "left", "top", "right", "bottom", "track_id", "track_status", "track_frames", "track_lost" };
+
+	int columns[NUM_COLUMNS];
+	size_t maxColumn = 0;
+
+	for( int c=0; c < NUM_COLUMNS; c++ )
+	{
+		columns[c] = -1;
+
+		for( size_t n=0; n < row.size(); n++ )
+		{
+			if( row[n] == names[c] )
+			{
+				columns[c] = n;
+				maxColumn = std::max(maxColumn, n);
+				break;
+			}
+		}
+
+		if( columns[c] < 0 && c <= BOTTOM )
+		{
+			LogError(LOG_DETSTREAM "'%s' is missing the '%s' column\n", filename, names[c]);
+			return -1;
+		}
+	}
+
+	// group the lines from each frame into records
+	std::vector<yoloNet::Detection> detections;
+	
+	uint64_t timestamp = 0;
+	uint64_t frame = 0;
+	int64_t records = 0;
+
+	while( true )
+	{
+		const bool valid = csv.Next(row);
+
+		uint64_t rowTimestamp = 0;
+		uint64_t rowFrame = 0;
+
+		if( valid )
+		{
+			if( row.size() <= maxColumn || !row[columns[TIMESTAMP]].toUInt64(&rowTimestamp) || !row[columns[FRAME]].toUInt64(&rowFrame) )
+			{
+				LogError(LOG_DETSTREAM "invalid line %llu in '%s'\n", (unsigned long long)row.line(), filename);
+				return -1;
+			}
+		}
+
+		if( detections.size() > 0 && (!valid || rowTimestamp != timestamp || rowFrame != frame) )
+		{
+			if( !Write(timestamp, frame, detections.data(), detections.size()) )
+				return -1;
+
+			detections.clear();
+			records++;
+		}
+
+		if( !valid )
+			break;
+
+		yoloNet::Detection det;
+		det.Reset();
+
+		det.ClassID = row[columns[CLASS]].toInt();
+		det.Confidence = row[columns[CONFIDENCE]].toFloat();
+		det.Left = row[columns[LEFT]].toFloat();
+		det.Top = row[columns[TOP]].toFloat();
+		det.Right = row[columns[RIGHT]].toFloat();
+		det.Bottom = row[columns[BOTTOM]].toFloat();
+
+		if( columns[TRACK_ID] >= 0 )
+			det.TrackID = row[columns[TRACK_ID]].toInt();
+
+		if( columns[TRACK_STATUS] >= 0 )
+			det.TrackStatus = row[columns[TRACK_STATUS]].toInt();
+
+		if( columns[TRACK_FRAMES] >= 0 )
+			det.TrackFrames = row[columns[TRACK_FRAMES]].toInt();
+
+		if( columns[TRACK_LOST] >= 0 )
+			det.TrackLost = row[columns[TRACK_LOST]].toInt();
+
+		detections.push_back(det);
+
+		timestamp = rowTimestamp;
+		frame = rowFrame;
+	}
+
+	LogVerbose(LOG_DETSTREAM "imported %lld records from '%s'\n", (long long)records, filename);
+	return records;
+}
+
+
+// Flush
+bool detectionStreamWriter::Flush( bool sync )
+{
+	if( mFile < 0 )
+		return false;
+
+	if( !writeChunk() )
+		return false;
+
+	if( sync && fdatasync(mFile) != 0 )
+	{
+		LogError(LOG_DETSTREAM "failed to sync '%s' (%s)\n", mFilename.c_str(), strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
+
+// Close
+bool detectionStreamWriter::Close()
+{
+	bool result = true;
+
+	if( mFile >= 0 )
+	{
+		result = writeChunk();
+
+		// append the chunk index and the trailer
+		if( result )
+		{
+			Trailer trailer;
+			memcpy(trailer.magic, TRAILER_MAGIC, sizeof(TRAILER_MAGIC));
+
+			trailer.numChunks   = mIndex.size();
+			trailer.indexOffset = mOffset;
+
+			result = writeAligned(mIndex.data(), mIndex.size() * sizeof(IndexEntry))
+				  && writeAligned(&trailer, sizeof(Trailer));
+		}
+
+		close(mFile);
+		mFile = -1;
+
+		LogVerbose(LOG_DETSTREAM "closed '%s' (%llu records, %zu chunks)\n", mFilename.c_str(), (unsigned long long)mNumRecords, mIndex.size());
+	}
+
+	if( mBuffer != NULL )
+	{
+		free(mBuffer);
+		mBuffer = NULL;
+	}
+
+	return result;
+}
+
+
+//-----------------------------------------------------------------------------------
+
+
+// constructor
+detectionStreamReader::detectionStreamReader()
+{
+	mData       = NULL;
+	mSize       = 0;
+	mNumRecords = 0;
+	mComplete   = false;
+}
+
+
+// destructor
+detectionStreamReader::~detectionStreamReader()
+{
+	if( mData != NULL )
+		munmap((void*)mData, mSize);
+}
+
+
+// Open
+detectionStreamReader* detectionStreamReader::Open( const char* filename )
+{
+	if( !filename )
+		return NULL;
+
+	detectionStreamReader* reader = new detectionStreamReader();
+
+	if( !reader->init(filename) )
+	{
+		delete reader;
+		return NULL;
+	}
+
+	return reader;
+}
+
+
+// init
+bool detectionStreamReader::init( const char* filename )
+{
+	mFilename = filename;
+
+	const int fd = open(filename, O_RDONLY);
+
+	if( fd < 0 )
+	{
+		LogError(LOG_DETSTREAM "failed to open '%s' (%s)\n", filename, strerror(errno));
+		return false;
+	}
+
+	struct stat st;
+
+	if( fstat(fd, &st) != 0 || st.st_size < (off_t)ALIGN )
+	{
+		LogError(LOG_DETSTREAM "'%s' is not a detection stream (file too small)\n", filename);
+		close(fd);
+		return false;
+	}
+
+	mSize = st.st_size;
+	void* data = mmap(NULL, mSize, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if( data == MAP_FAILED )
+	{
+		LogError(LOG_DETSTREAM "failed to mmap '%s' (%s)\n", filename, strerror(errno));
+		return false;
+	}
+
+	mData = (const uint8_t*)data;
+
+	// check the header
+	const FileHeader* header = (const FileHeader*)mData;
+
+	if( memcmp(header->magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 )
+	{
+		LogError(LOG_DETSTREAM "'%s' is not a detection stream (invalid magic)\n", filename);
+		return false;
+	}
+
+	if( header->versionMajor != DETECTION_STREAM_VERSION_MAJOR || header->chunkAlign != ALIGN )
+	{
+		LogError(LOG_DETSTREAM "'%s' has unsupported version %u.%u (expected %u.x)\n", filename,
+			    (uint32_t)header->versionMajor, (uint32_t)header->versionMinor, DETECTION_STREAM_VERSION_MAJOR);
+		return false;
+	}
+
+	mComplete = loadIndex();
+
+	if( !mComplete )
+	{
+		LogWarning(LOG_DETSTREAM "'%s' wasn't closed cleanly, rebuilding the index\n", filename);
+		rebuildIndex();
+	}
+
+	for( size_t n=0; n < mIndex.size(); n++ )
+		mNumRecords += mIndex[n].numRecords;
+
+	LogVerbose(LOG_DETSTREAM "opened '%s' (%llu records, %zu chunks)\n", filename, (unsigned long long)mNumRecords, mIndex.size());
+	return true;
+}
+
+
+// loadIndex
+bool detectionStreamReader::loadIndex()
+{
+	if( mSize < ALIGN + sizeof(Trailer) )
+		return false;
+
+	const Trailer* trailer = (const Trailer*)(mData + mSize - sizeof(Trailer));
+
+	if( memcmp(trailer->magic, TRAILER_MAGIC, sizeof(TRAILER_MAGIC)) != 0 )
+		return false;
+
+	if( trailer->indexOffset + trailer->numChunks * sizeof(IndexEntry) + sizeof(Trailer) != mSize )
+		return false;
+
+	const IndexEntry* entries = (const IndexEntry*)(mData + trailer->indexOffset);
+
+	for( uint32_t n=0; n < trailer->numChunks; n++ )
+	{
+		// make sure the chunks are inside the file
+		const ChunkHeader* chunk = (const ChunkHeader*)(mData + entries[n].offset);
+
+		if( entries[n].offset + sizeof(ChunkHeader) > trailer->indexOffset
+		 || entries[n].offset + chunk->chunkSize > trailer->indexOffset
+		 || sizeof(ChunkHeader) + chunk->payloadSize > chunk->chunkSize
+		 || memcmp(chunk->magic, CHUNK_MAGIC, sizeof(CHUNK_MAGIC)) != 0 )
+		{
+			mIndex.clear();
+			return false;
+		}
+
+		mIndex.push_back(entries[n]);
+	}
+
+	return true;
+}
+
+
+// rebuildIndex
+bool detectionStreamReader::rebuildIndex()
+{
+	mIndex.clear();
+
+	uint64_t offset = ALIGN;
+
+	while( offset + sizeof(ChunkHeader) <= mSize )
+	{
+		const ChunkHeader* chunk = (const ChunkHeader*)(mData + offset);
+
+		// stop at the first incomplete chunk (the end of the data that made it to disk)
+		if( memcmp(chunk->magic, CHUNK_MAGIC, sizeof(CHUNK_MAGIC)) != 0
+		 || chunk->chunkSize == 0 || chunk->chunkSize % ALIGN != 0
+		 || offset + chunk->chunkSize > mSize
+		 || sizeof(ChunkHeader) + chunk->payloadSize > chunk->chunkSize )
+			break;
+
+		IndexEntry entry;
+
+		entry.offset         = offset;
+		entry.firstTimestamp = chunk->firstTimestamp;
+		entry.lastTimestamp  = chunk->lastTimestamp;
+		entry.firstFrame     = chunk->firstFrame;
+		entry.lastFrame      = chunk->lastFrame;
+		entry.numRecords     = chunk->numRecords;
+
+		mIndex.push_back(entry);
+		offset += chunk->chunkSize;
+	}
+
+	return true;
+}
+
+
+// begin
+detectionStreamReader::iterator detectionStreamReader::begin() const
+{
+	iterator it;
+
+	it.mReader = this;
+	it.mChunk  = 0;
+	it.mOffset = 0;
+
+	// skip empty chunks
+	while( it.mChunk < mIndex.size() && mIndex[it.mChunk].numRecords == 0 )
+		it.mChunk++;
+
+	it.load();
+	return it;
+}
+
+
+// end
+detectionStreamReader::iterator detectionStreamReader::end() const
+{
+	iterator it;
+
+	it.mReader = this;
+	it.mChunk  = mIndex.size();
+	it.mOffset = 0;
+
+	memset(&it.mRecord, 0, sizeof(Record));
+	return it;
+}
+
+
+// operator ++
+detectionStreamReader::iterator& detectionStreamReader::iterator::operator ++ ()
+{
+	const std::vector<IndexEntry>& index = mReader->mIndex;
+
+	if( mChunk >= index.size() )
+		return *this;
+
+	const ChunkHeader* chunk = (const ChunkHeader*)(mReader->mData + index[mChunk].offset);
+	const RecordHeader* record = (const RecordHeader*)((const uint8_t*)chunk + sizeof(ChunkHeader) + mOffset);
+
+	const uint64_t remaining = (mOffset < chunk->payloadSize) ? chunk->payloadSize - mOffset : 0;
+
+	// move to the next chunk after the last record (a record size that's corrupt or runs past the payload also ends the chunk)
+	if( remaining < sizeof(RecordHeader) || record->size < sizeof(RecordHeader) || record->size > remaining
+	 || mOffset + record->size + sizeof(RecordHeader) > chunk->payloadSize )
+	{
+		mOffset = 0;
+
+		do { mChunk++; } while( mChunk < index.size() && index[mChunk].numRecords == 0 );
+	}
+	else
+	{
+		mOffset += record->size;
+	}
+
+	load();
+	return *this;
+}
+
+
+// load
+void detectionStreamReader::iterator::load()
+{
+	if( mChunk >= mReader->mIndex.size() )
+	{
+		memset(&mRecord, 0, sizeof(Record));
+		return;
+	}
+
+	const ChunkHeader* chunk = (const ChunkHeader*)(mReader->mData + mReader->mIndex[mChunk].offset);
+	const uint8_t* ptr = (const uint8_t*)chunk + sizeof(ChunkHeader) + mOffset;
+
+	// the payload size was validated when the index was loaded, but the record sizes weren't,
+	// so the record is bounded by the rest of the payload instead of the size it claims
+	if( mOffset + sizeof(RecordHeader) > chunk->payloadSize )
+	{
+		memset(&mRecord, 0, sizeof(Record));
+		return;
+	}
+
+	const RecordHeader* record = (const RecordHeader*)ptr;
+
+	if( !mRecord.Parse(ptr, chunk->payloadSize - mOffset) )
+	{
+		mRecord.timestamp = record->timestamp;
+		mRecord.frame = record->frame;
+		mRecord.numDetections = 0;
+	}
+}
+
+
+// Parse
+bool detectionStreamReader::Record::Parse( const void* data, size_t size )
+{
+	if( !data || size < sizeof(RecordHeader) )
+		return false;
+
+	const uint8_t* ptr = (const uint8_t*)data;
+	const RecordHeader* record = (const RecordHeader*)ptr;
+
+	// RecordSize() wraps for a corrupt number of detections, so that's bounded first
+	if( record->size > size || record->numDetections > (record->size - sizeof(RecordHeader)) / (10 * sizeof(uint32_t))
+	 || RecordSize(record->numDetections) > record->size )
+		return false;
+
+	const uint32_t n = record->numDetections;
+
+	timestamp     = record->timestamp;
+	frame         = record->frame;
+	numDetections = n;
+
+	classID     = (const uint32_t*)(ptr + sizeof(RecordHeader));
+	confidence  = (const float*)(classID + n);
+	left        = confidence + n;
+	top         = left + n;
+	right       = top + n;
+	bottom      = right + n;
+	trackID     = (const int32_t*)(bottom + n);
+	trackStatus = trackID + n;
+	trackFrames = trackStatus + n;
+	trackLost   = trackFrames + n;
+
+	return true;
+}
+
+
+// GetDetection
+void detectionStreamReader::Record::GetDetection( uint32_t index, yoloNet::Detection* detection ) const
+{
+	if( !detection || index >= numDetections )
+		return;
+
+	detection->ClassID     = classID[index];
+	detection->Confidence  = confidence[index];
+	detection->Left        = left[index];
+	detection->Top         = top[index];
+	detection->Right       = right[index];
+	detection->Bottom      = bottom[index];
+	detection->TrackID     = trackID[index];
+	detection->TrackStatus = trackStatus[index];
+	detection->TrackFrames = trackFrames[index];
+	detection->TrackLost   = trackLost[index];
+}
+
+
+// Seek
+detectionStreamReader::iterator detectionStreamReader::Seek( uint64_t timestamp ) const
+{
+	// find the first chunk that ends at or after the timestamp
+	std::vector<IndexEntry>::const_iterator chunk = std::lower_bound(mIndex.begin(), mIndex.end(), timestamp,
+		[](const IndexEntry& entry, uint64_t t) { return entry.lastTimestamp < t; });
+
+	if( chunk == mIndex.end() )
+		return end();
+
+	iterator it;
+
+	it.mReader = this;
+	it.mChunk  = chunk - mIndex.begin();
+	it.mOffset = 0;
+
+	it.load();
+
+	// find the record inside the chunk
+	const iterator last = end();
+
+	while( it != last && it->timestamp < timestamp )
+		++it;
+
+	return it;
+}
+
+
+// Query
+size_t detectionStreamReader::Query( uint64_t start, uint64_t end, std::vector<Record>& records ) const
+{
+	const size_t count = records.size();
+	const iterator last = this->end();
+
+	for( iterator it = Seek(start); it != last && it->timestamp < end; ++it )
+		records.push_back(*it);
+
+	return records.size() - count;
+}
+
+
+// ExportCSV
+bool detectionStreamReader::ExportCSV( const char* filename, yoloNet* net ) const
+{
+	csvWriter csv(filename);
+
+	if( !csv.IsOpen() )
+		return false;
+
+	csv.WriteLine("timestamp", "frame", "class", "label", "confidence", "left", "top", "right", "bottom", "track_id", "track_status", "track_frames", "track_lost");
+
+	const iterator last = end();
+
+	for( iterator it = begin(); it != last; ++it )
+	{
+		for( uint32_t n=0; n < it->numDetections; n++ )
+		{
+			csv.WriteLine(it->timestamp, it->frame, it->classID[n], (net != NULL) ? net->GetClassDesc(it->classID[n]) : "",
+					    it->confidence[n], it->left[n], it->top[n], it->right[n], it->bottom[n],
+					    it->trackID[n], it->trackStatus[n], it->trackFrames[n], it->trackLost[n]);
+		}
+	}
+
+	LogVerbose(LOG_DETSTREAM "exported %llu records to '%s'\n", (unsigned long long)mNumRecords, filename);
+	return true;
+}
+
+
+// jsonString
+static void jsonString( FILE* file, const char* str )
+{
+	fputc('"', file);
+
+	for( const char* c = str; *c != '\0'; c++ )
+	{
+		if( *c == '"' || *c == '\\' )
+			fputc('\\', file);
+
+		if( (unsigned char)*c >= 0x20 )
+			fputc(*c, file);
+	}
+
+	fputc('"', file);
+}
+
+
+// ExportJSON
+bool detectionStreamReader::ExportJSON( const char* filename, yoloNet* net ) const
+{
+	FILE* file = fopen(filename, "w");
+
+	if( !file )
+	{
+		LogError(LOG_DETSTREAM "failed to open '%s' for writing\n", filename);
+		return false;
+	}
+
+	fprintf(file, "[");
+
+	const iterator last = end();
+	bool first = true;
+
+	for( iterator it = begin(); it != last; ++it )
+	{
+		fprintf(file, "%s\n  {\"timestamp\": %llu, \"frame\": %llu, \"detections\": [", first ? "" : ",",
+			   (unsigned long long)it->timestamp, (unsigned long long)it->frame);
+
+		for( uint32_t n=0; n < it->numDetections; n++ )
+		{
+			fprintf(file, "%s\n    {\"class\": %u, ", (n > 0) ? "," : "", it->classID[n]);
+
+			if( net != NULL )
+			{
+				fprintf(file, "\"label\": ");
+				jsonString(file, net->GetClassDesc(it->classID[n]));
+				fprintf(file, ", ");
+			}
+
+			fprintf(file, "\"confidence\": %g, \"left\": %g, \"top\": %g, \"right\": %g, \"bottom\": %g, "
+					    "\"track_id\": %i, \"track_status\": %i, \"track_frames\": %i, \"track_lost\": %i}",
+					    it->confidence[n], it->left[n], it->top[n], it->right[n], it->bottom[n],
+					    it->trackID[n], it->trackStatus[n], it->trackFrames[n], it->trackLost[n]);
+		}
+
+		fprintf(file, "%s]}", (it->numDetections > 0) ? "\n  " : "");
+		first = false;
+	}
+
+	fprintf(file, "\n]\n");
+
+	const bool result = (ferror(file) == 0);
+	fclose(file);
+
+	if( !result )
+	{
+		LogError(LOG_DETSTREAM "failed to write '%s'\n", filename);
+		return false;
+	}
+
+	LogVerbose(LOG_DETSTREAM "exported %llu records to '%s'\n", (unsigned long long)mNumRecords, filename);
+	return true;
+}
@@ -0,0 +1,423 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __DETECTION_STREAM_H__
+#define __DETECTION_STREAM_H__
+
+
+#include "yoloNet.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+/**
+ * Detection stream logging prefix
+ * @ingroup detectionStream
+ */
+#define LOG_DETSTREAM "[detstream] "
+
+/**
+ * Current version of the detection stream file format.
+ * Readers accept files with the same major version.
+ * @ingroup detectionStream
+ */
+#define DETECTION_STREAM_VERSION_MAJOR  1
+#define DETECTION_STREAM_VERSION_MINOR  0
+
+/**
+ * Default size (in bytes) of the chunks that the writer batches records into.
+ * @ingroup detectionStream
+ */
+#define DETECTION_STREAM_DEFAULT_CHUNK  (256 * 1024)
+
+/**
+ * Default maximum time (in nanoseconds) that records are buffered by the writer
+ * before the chunk is written to disk, even if it isn't full yet.
+ * @ingroup detectionStream
+ */
+#define DETECTION_STREAM_DEFAULT_FLUSH  (5ULL * 1000 * 1000 * 1000)
+
+
+/**
+ * Append-only binary container for per-frame detection results.
+ *
+ * The file starts with a header, followed by chunks of frame records.  Each chunk
+ * is padded to a multiple of detectionStream::ALIGN bytes and has a header with
+ * its time and frame range.  Each record holds the frame's timestamp (in nanoseconds,
+ * from videoSource::GetLastTimestamp()), the frame index, and the detections stored as
+ * structure-of-arrays (all the class IDs, then all the confidences, etc).
+ *
+ * When the writer is closed, it appends an index of the chunks and a trailer that points to it,
+ * which the reader uses to seek by time in O(log n).  If the file wasn't closed cleanly
+ * (for example, the recorder lost power) the reader rebuilds the index by walking the chunk headers.
+ *
+ * The fields are stored in little-endian byte order.
+ * @ingroup detectionStream
+ */
+namespace detectionStream
+{
+	/**
+	 * Alignment (in bytes) of the chunks in the file, and of the writer's disk writes.
+	 */
+	static const uint32_t ALIGN = 4096;
+
+	/**
+	 * File header (at offset 0, padded to ALIGN bytes).
+	 */
+	struct FileHeader
+	{
+		char     magic[4];		/**< "DTST" */
+		uint16_t versionMajor;	/**< DETECTION_STREAM_VERSION_MAJOR */
+		uint16_t versionMinor;	/**< DETECTION_STREAM_VERSION_MINOR */
+		uint32_t headerSize;	/**< sizeof(FileHeader) */
+		uint32_t chunkAlign;	/**< ALIGN */
+		uint64_t created;		/**< wall-clock time the file was created (nanoseconds since the epoch) */
+	};
+
+	/**
+	 * Chunk header (at the start of each chunk).
+	 */
+	struct ChunkHeader
+	{
+		char     magic[4];		/**< "CHNK" */
+		uint32_t numRecords;	/**< number of frame records in the chunk */
+		uint64_t chunkSize;		/**< size of the chunk including this header and the padding */
+		uint64_t payloadSize;	/**< size of the records (not including this header or the padding) */
+		uint64_t firstTimestamp;	/**< timestamp of the first record */
+		uint64_t lastTimestamp;	/**< timestamp of the last record */
+		uint64_t firstFrame;	/**< frame index of the first record */
+		uint64_t lastFrame;		/**< frame index of the last record */
+	};
+
+	/**
+	 * Frame record header, followed by the detection arrays (each numDetections long):
+	 * ClassID (uint32), Confidence, Left, Top, Right, Bottom (float),
+	 * TrackID, TrackStatus, TrackFrames, TrackLost (int32).
+	 * Records are padded to 8 bytes.
+	 */
+	struct RecordHeader
+	{
+		uint32_t size;			/**< size of the record including this header and the padding */
+		uint32_t numDetections;	/**< number of detections in the frame */
+		uint64_t timestamp;		/**< frame timestamp (in nanoseconds) */
+		uint64_t frame;		/**< frame index */
+	};
+
+	/**
+	 * Chunk index entry (stored in the index at the end of the file).
+	 */
+	struct IndexEntry
+	{
+		uint64_t offset;		/**< file offset of the chunk */
+		uint64_t firstTimestamp;
+		uint64_t lastTimestamp;
+		uint64_t firstFrame;
+		uint64_t lastFrame;
+		uint64_t numRecords;
+	};
+
+	/**
+	 * File trailer (the last bytes of a cleanly-closed file).
+	 */
+	struct Trailer
+	{
+		char     magic[4];		/**< "DTIX" */
+		uint32_t numChunks;		/**< number of entries in the index */
+		uint64_t indexOffset;	/**< file offset of the index */
+	};
+
+	/**
+	 * Size of a frame record with the given number of detections.
+	 */
+	inline uint32_t RecordSize( uint32_t numDetections )	{ return (sizeof(RecordHeader) + numDetections * 10 * sizeof(uint32_t) + 7) & ~7u; }
+
+	/**
+	 * Pack the detections for a frame into a record (including the header and padding).
+	 * @param output buffer that is at least RecordSize(numDetections) bytes and 8-byte aligned.
+	 * @returns the size of the record (in bytes)
+	 */
+	uint32_t PackRecord( void* output, uint64_t timestamp, uint64_t frame, const yoloNet::Detection* detections, uint32_t numDetections );
+}
+
+
+/**
+ * Writes detections to a detection stream file.
+ *
+ * Records are batched into chunks in memory, and each chunk is written to disk with
+ * one aligned write once it reaches the chunk size, or when the records in it are older
+ * than the flush interval.  Timestamps should be monotonically non-decreasing so the
+ * file can be searched by time.
+ *
+ * @see detectionStream for the file format.
+ * @ingroup detectionStream
+ */
+class detectionStreamWriter
+{
+public:
+	/**
+	 * Create a new detection stream file (any existing file is overwritten).
+	 * @param filename path of the file to create.
+	 * @param chunkSize the size of the chunks that records are batched into (rounded up to detectionStream::ALIGN)
+	 * @param flushInterval the maximum time span (in nanoseconds) of the records in a chunk before it is written.
+	 */
+	static detectionStreamWriter* Open( const char* filename, size_t chunkSize=DETECTION_STREAM_DEFAULT_CHUNK,
+								 uint64_t flushInterval=DETECTION_STREAM_DEFAULT_FLUSH );
+
+	/**
+	 * Destructor (closes the file)
+	 */
+	~detectionStreamWriter();
+
+	/**
+	 * Append the detections for a frame.
+	 * @param timestamp the timestamp of the frame (in nanoseconds), see videoSource::GetLastTimestamp()
+	 * @param frame the frame index, see videoSource::GetFrameCount()
+	 * @param detections array of detections (can be NULL if numDetections is 0)
+	 * @param numDetections the number of detections in the array
+	 */
+	bool Write( uint64_t timestamp, uint64_t frame, const yoloNet::Detection* detections, uint32_t numDetections );
+
+	/**
+	 * Append the detections from a CSV file that was written by detectionStreamReader::ExportCSV().
+	 * Consecutive lines from the same frame are grouped into one record.  The columns are
+	 * found by their names in the header, so they can be in any order (and the label is ignored).
+	 * Frames without detections aren't in the CSV, so they won't be in the stream either.
+	 * @returns the number of records written, or -1 on error.
+	 */
+	int64_t ImportCSV( const char* filename );
+
+	/**
+	 * Write the current chunk to disk (even if it isn't full).
+	 * @param sync if true, also wait for the data to reach the storage device (fdatasync)
+	 */
+	bool Flush( bool sync=false );
+
+	/**
+	 * Flush the remaining records, write the index, and close the file.
+	 */
+	bool Close();
+
+	/**
+	 * Get the filename.
+	 */
+	inline const char* GetFilename() const		{ return mFilename.c_str(); }
+
+	/**
+	 * Get the number of records written.
+	 */
+	inline uint64_t GetNumRecords() const		{ return mNumRecords; }
+
+	/**
+	 * Get the number of bytes written to disk.
+	 */
+	inline uint64_t GetBytesWritten() const		{ return mOffset; }
+
+protected:
+	detectionStreamWriter();
+
+	bool writeChunk();
+	bool writeAligned( const void* data, size_t size );
+
+	int mFile;
+	std::string mFilename;
+
+	uint8_t* mBuffer;		// aligned chunk buffer
+	size_t   mBufferSize;
+	size_t   mChunkSize;
+	size_t   mChunkUsed;
+
+	uint64_t mFlushInterval;
+	uint64_t mOffset;
+	uint64_t mNumRecords;
+	uint64_t mLastTimestamp;
+	bool     mOutOfOrder;
+
+	detectionStream::ChunkHeader mChunk;
+	std::vector<detectionStream::IndexEntry> mIndex;
+};
+
+
+/**
+ * Memory-mapped reader for detection stream files.
+ *
+ * Records are accessed in-place from the mapped file, so iterating over them
+ * doesn't copy the detection arrays.  Use Seek() or Query() to find records by time.
+ *
+ * @see detectionStream for the file format.
+ * @ingroup detectionStream
+ */
+class detectionStreamReader
+{
+public:
+	/**
+	 * A frame record that points into the mapped file.
+	 */
+	struct Record
+	{
+		uint64_t timestamp;		/**< frame timestamp (in nanoseconds) */
+		uint64_t frame;		/**< frame index */
+		uint32_t numDetections;	/**< number of detections */
+
+		const uint32_t* classID;	/**< ClassID array */
+		const float* confidence;	/**< Confidence array */
+		const float* left;		/**< Left array */
+		const float* top;		/**< Top array */
+		const float* right;		/**< Right array */
+		const float* bottom;	/**< Bottom array */
+		const int32_t* trackID;	/**< TrackID array */
+		const int32_t* trackStatus;	/**< TrackStatus array */
+		const int32_t* trackFrames;	/**< TrackFrames array */
+		const int32_t* trackLost;	/**< TrackLost array */
+
+		/**
+		 * Unpack one of the detections into a yoloNet::Detection.
+		 */
+		void GetDetection( uint32_t index, yoloNet::Detection* detection ) const;
+
+		/**
+		 * Point the record at a packed record in memory (see detectionStream::PackRecord())
+		 * The arrays aren't copied, so the memory needs to remain valid while the record is used.
+		 * @param size the number of bytes available at data
+		 * @returns false if the record is truncated or corrupt.
+		 */
+		bool Parse( const void* data, size_t size );
+	};
+
+	/**
+	 * Forward iterator over the records.
+	 */
+	class iterator
+	{
+	public:
+		inline const Record& operator * () const			{ return mRecord; }
+		inline const Record* operator -> () const			{ return &mRecord; }
+		inline bool operator == ( const iterator& it ) const	{ return mChunk == it.mChunk && mOffset == it.mOffset; }
+		inline bool operator != ( const iterator& it ) const	{ return !(*this == it); }
+		iterator& operator ++ ();
+
+	protected:
+		friend class detectionStreamReader;
+
+		void load();
+
+		const detectionStreamReader* mReader;
+		size_t   mChunk;
+		uint64_t mOffset;	// offset of the record within the chunk's payload
+		Record   mRecord;
+	};
+
+	/**
+	 * Open a detection stream file.
+	 */
+	static detectionStreamReader* Open( const char* filename );
+
+	/**
+	 * Destructor (unmaps the file)
+	 */
+	~detectionStreamReader();
+
+	/**
+	 * Iterator to the first record.
+	 */
+	iterator begin() const;
+
+	/**
+	 * Iterator past the last record.
+	 */
+	iterator end() const;
+
+	/**
+	 * Find the first record with a timestamp greater or equal to the given timestamp.
+	 * This does a binary search over the chunk index, then a linear search in the chunk.
+	 * @returns iterator to the record, or end() if all the records are older.
+	 */
+	iterator Seek( uint64_t timestamp ) const;
+
+	/**
+	 * Get the records with timestamps in the range `[start, end)`.
+	 * @returns the number of records that were found.
+	 */
+	size_t Query( uint64_t start, uint64_t end, std::vector<Record>& records ) const;
+
+	/**
+	 * Export the records to a CSV file, with one line per detection.
+	 * @param net if provided, the class descriptions will be included.
+	 */
+	bool ExportCSV( const char* filename, yoloNet* net=NULL ) const;
+
+	/**
+	 * Export the records to a JSON file, as an array of frame objects.
+	 * @param net if provided, the class descriptions will be included.
+	 */
+	bool ExportJSON( const char* filename, yoloNet* net=NULL ) const;
+
+	/**
+	 * Get the number of chunks.
+	 */
+	inline size_t GetNumChunks() const			{ return mIndex.size(); }
+
+	/**
+	 * Get the number of records.
+	 */
+	inline uint64_t GetNumRecords() const		{ return mNumRecords; }
+
+	/**
+	 * Get the timestamp of the first record.
+	 */
+	inline uint64_t GetFirstTimestamp() const	{ return mIndex.size() > 0 ? mIndex.front().firstTimestamp : 0; }
+
+	/**
+	 * Get the timestamp of the last record.
+	 */
+	inline uint64_t GetLastTimestamp() const	{ return mIndex.size() > 0 ? mIndex.back().lastTimestamp : 0; }
+
+	/**
+	 * Return true if the file was closed cleanly (the index was loaded from the file
+	 * instead of being rebuilt from the chunk headers).
+	 */
+	inline bool IsComplete() const			{ return mComplete; }
+
+	/**
+	 * Get the filename.
+	 */
+	inline const char* GetFilename() const		{ return mFilename.c_str(); }
+
+protected:
+	detectionStreamReader();
+
+	bool init( const char* filename );
+	bool loadIndex();
+	bool rebuildIndex();
+
+	const uint8_t* mData;
+	size_t mSize;
+
+	std::string mFilename;
+	std::vector<detectionStream::IndexEntry> mIndex;
+
+	uint64_t mNumRecords;
+	bool mComplete;
+};
+
+#endif
@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "engineSwapper.h"
+#include "logging.h"
+
+#include <map>
+#include <string.h>
+#include <strings.h>
+
+
+static int gBackgroundBuild = -1;	// -1 if not set, in which case the environment variable is checked
+
+static Mutex gFallbackMutex;
+static std::map<std::string, std::string> gFallbackModels;
+
+
+// SetBackgroundEngineBuild
+void SetBackgroundEngineBuild( bool enabled )
+{
+	gBackgroundBuild = enabled ? 1 : 0;
+}
+
+
+// GetBackgroundEngineBuild
+bool GetBackgroundEngineBuild()
+{
+	if( gBackgroundBuild >= 0 )
+		return gBackgroundBuild;
+
+	const char* env = getenv(ENGINE_BUILD_BACKGROUND_ENV);
+
+	if( !env )
+		return false;
+
+	return strcmp(env, "1") == 0 || strcasecmp(env, "true") == 0 || strcasecmp(env, "on") == 0;
+}
+
+
+// SetFallbackModel
+void SetFallbackModel( const char* model, const char* fallback )
+{
+	if( !model )
+		return;
+
+	gFallbackMutex.Lock();
+
+	if( fallback != NULL && strlen(fallback) > 0 )
+		gFallbackModels[model] = fallback;
+	else
+		gFallbackModels.erase(model);
+
+	gFallbackMutex.Unlock();
+}
+
+
+// GetFallbackModel
+std::string GetFallbackModel( const char* model )
+{
+	if( !model )
+		return "";
+
+	std::string fallback;
+
+	gFallbackMutex.Lock();
+
+	const std::map<std::string, std::string>::const_iterator iter = gFallbackModels.find(model);
+
+	if( iter != gFallbackModels.end() )
+		fallback = iter->second;
+
+	gFallbackMutex.Unlock();
+
+	return fallback;
+}
+
+
+// constructor
+engineSwapper::engineSwapper() : mBuilt(false)
+{
+	mStatus = IDLE;
+	mEngine = NULL;
+}
+
+
+// destructor
+engineSwapper::~engineSwapper()
+{
+	if( IsBuilding() )
+		LogInfo("[TRT]    waiting for the engine being built in the background to finish\n");
+
+	mThread.Stop(true);
+
+	if( mEngine != NULL && mRelease )
+		mRelease(mEngine);
+}
+
+
+// Start
+bool engineSwapper::Start( const BuildFunction& build, const ReleaseFunction& release )
+{
+	if( GetStatus() != IDLE || !build )
+		return false;
+
+	mBuild   = build;
+	mRelease = release;
+	mStatus  = BUILDING;
+
+	if( !mThread.Start(buildThread, this) )
+	{
+		LogError("[TRT]    failed to start thread for building the engine in the background\n");
+		mStatus = FAILED;
+		mBuilt.Wake();
+		return false;
+	}
+
+	return true;
+}
+
+
+// buildThread
+void* engineSwapper::buildThread( void* param )
+{
+	engineSwapper* swapper = (engineSwapper*)param;
+
+	void* engine = swapper->mBuild();
+
+	swapper->mMutex.Lock();
+	swapper->mEngine = engine;
+	swapper->mStatus = (engine != NULL) ? READY : FAILED;
+	swapper->mMutex.Unlock();
+
+	swapper->mBuilt.Wake();
+	return NULL;
+}
+
+
+// Swap
+bool engineSwapper::Swap( const SwapFunction& swap )
+{
+	// this is called every frame, so only lock when there's an engine
+	if( GetStatus() != READY )
+		return false;
+
+	mMutex.Lock();
+	void* engine = mEngine;
+	mEngine = NULL;
+	mMutex.Unlock();
+
+	if( !engine )
+		return false;
+
+	if( swap && swap(engine) )
+	{
+		mStatus = SWAPPED;
+		return true;
+	}
+
+	if( mRelease )
+		mRelease(engine);
+
+	mStatus = FAILED;
+	return false;
+}
+
+
+// Wait
+bool engineSwapper::Wait( uint64_t timeout )
+{
+	if( GetStatus() == IDLE )
+		return false;
+
+	return mBuilt.Wait(timeout);
+}
+
+
+// StatusToStr
+const char* engineSwapper::StatusToStr( Status status )
+{
+	switch(status)
+	{
+		case IDLE:	return "idle";
+		case BUILDING: return "building";
+		case READY:	return "ready";
+		case SWAPPED:	return "swapped";
+		case FAILED:	return "failed";
+	}
+
+	return "unknown";
+}
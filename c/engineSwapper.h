@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __ENGINE_SWAPPER_H__
+#define __ENGINE_SWAPPER_H__
+
+
+#include "Thread.h"
+#include "Event.h"
+#include "Mutex.h"
+
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <string>
+
+
+/**
+ * Environment variable that enables building TensorRT engines in the background (when set to 1),
+ * while the network runs a fallback engine.  @see SetBackgroundEngineBuild()
+ * @ingroup tensorNet
+ */
+#define ENGINE_BUILD_BACKGROUND_ENV  "JETSON_BACKGROUND_BUILD"
+
+
+/**
+ * Enable or disable building TensorRT engines in the background.
+ *
+ * When enabled and a network's engine cache is missing or out of date, tensorNet::LoadNetwork()
+ * looks for a fallback engine instead of blocking until the engine is built.  The fallback is either
+ * an engine that was already built for the same model (with a different precision or batch size),
+ * or the engine of the backup model set with SetFallbackModel().  The network runs the fallback
+ * while the engine is built on another thread, and switches to it between frames once it's done.
+ * If there isn't a fallback, the engine is built before LoadNetwork() returns like usual.
+ *
+ * By default this is disabled, unless $JETSON_BACKGROUND_BUILD is set to 1.
+ * @ingroup tensorNet
+ */
+void SetBackgroundEngineBuild( bool enabled );
+
+/**
+ * Return true if TensorRT engines are built in the background.  @see SetBackgroundEngineBuild()
+ * @ingroup tensorNet
+ */
+bool GetBackgroundEngineBuild();
+
+/**
+ * Set a smaller backup model that's run while the engine for a model is built in the background.
+ * The backup model should already have an engine built, and have the same input and output layers
+ * (with the same dimensions) as the model, so that it can be swapped for it.
+ * If `fallback` is NULL or empty, the backup model is removed.
+ * @ingroup tensorNet
+ */
+void SetFallbackModel( const char* model, const char* fallback );
+
+/**
+ * Get the backup model set for a model with SetFallbackModel(), or an empty string if there isn't one.
+ * @ingroup tensorNet
+ */
+std::string GetFallbackModel( const char* model );
+
+
+/**
+ * Builds an engine on a background thread, and swaps it for the one that's running between frames.
+ *
+ * This is the part of background engine builds that doesn't depend on TensorRT, so that it can
+ * be tested with a stub builder.  The engine is an opaque pointer that's created by the build
+ * function on the background thread.  The thread that runs the network calls Swap() before each
+ * frame, which is cheap until the build completes - then it calls the swap function once with the
+ * new engine, on that thread, so the engine never changes in the middle of a frame.
+ *
+ * If the build fails or the engine can't be swapped in, the network keeps running the old engine.
+ * An engine that was built but never swapped in is freed with the release function.
+ *
+ * @ingroup tensorNet
+ */
+class engineSwapper
+{
+public:
+	/**
+	 * Status of the background build.
+	 */
+	enum Status
+	{
+		IDLE = 0,	/**< No build has been started */
+		BUILDING,	/**< The engine is being built */
+		READY,		/**< The engine was built, and will be swapped in by the next call to Swap() */
+		SWAPPED,		/**< The engine was swapped in */
+		FAILED		/**< The engine couldn't be built or swapped in */
+	};
+
+	/**
+	 * Function that builds the engine (on the background thread), and returns it or NULL on error.
+	 */
+	typedef std::function<void* ()> BuildFunction;
+
+	/**
+	 * Function that switches to the new engine (on the thread calling Swap()), and returns true if it did.
+	 */
+	typedef std::function<bool (void* engine)> SwapFunction;
+
+	/**
+	 * Function that frees an engine that wasn't swapped in.
+	 */
+	typedef std::function<void (void* engine)> ReleaseFunction;
+
+	/**
+	 * Constructor
+	 */
+	engineSwapper();
+
+	/**
+	 * Destructor.  If the engine is still being built, this waits for the build to finish.
+	 */
+	~engineSwapper();
+
+	/**
+	 * Start building an engine on a background thread.
+	 * @returns false if a build was already started, or the thread couldn't be started.
+	 */
+	bool Start( const BuildFunction& build, const ReleaseFunction& release );
+
+	/**
+	 * Swap in the engine if its build completed, by calling `swap` with it.
+	 * This should be called between frames, and doesn't block while the engine is being built.
+	 * @returns true if the new engine was swapped in during this call, otherwise false.
+	 */
+	bool Swap( const SwapFunction& swap );
+
+	/**
+	 * Wait for the build to finish (the engine still has to be swapped in with Swap()).
+	 * @param timeout the timeout in milliseconds, or UINT64_MAX to wait forever.
+	 * @returns true if the build finished, or false if it timed out or a build was never started.
+	 */
+	bool Wait( uint64_t timeout=UINT64_MAX );
+
+	/**
+	 * Get the status of the build.
+	 */
+	inline Status GetStatus() const				{ return (Status)mStatus.load(); }
+
+	/**
+	 * Return true if the engine is being built.
+	 */
+	inline bool IsBuilding() const				{ return GetStatus() == BUILDING; }
+
+	/**
+	 * Convert a status to a string.
+	 */
+	static const char* StatusToStr( Status status );
+
+protected:
+
+	static void* buildThread( void* param );
+
+	BuildFunction   mBuild;
+	ReleaseFunction mRelease;
+
+	Thread mThread;
+	Event  mBuilt;
+	Mutex  mMutex;
+
+	std::atomic<int> mStatus;
+	void* mEngine;		// built engine that hasn't been swapped in yet
+};
+
+
+#endif
@@ -0,0 +1,449 @@
+/*
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "featureMatcher.h"
+
+#include "Thread.h"
+#include "logging.h"
+
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+
+// constructor
+featureMatcher::featureMatcher( uint32_t numThreads )
+{
+	mNumThreads    = numThreads;
+	mMutualNearest = false;
+}
+
+
+// the maximums skip NaN's, which are never the nearest neighbor
+static inline float maxValue( float value, float max )
+{
+	return value > max ? value : max;
+}
+
+
+// maxRow (updates the maximum of each column, and returns the maximum of the row)
+static inline float maxRow( const float* row, float* colMax, uint32_t count )
+{
+	float max = -INFINITY;
+	uint32_t n = 0;
+
+#if defined(__SSE2__)
+	// _mm_max_ps() returns the second operand if either is NaN
+	__m128 max4 = _mm_set1_ps(-INFINITY);
+
+	for( ; n + 4 <= count; n += 4 )
+	{
+		const __m128 value = _mm_loadu_ps(row + n);
+		max4 = _mm_max_ps(value, max4);
+		_mm_storeu_ps(colMax + n, _mm_max_ps(value, _mm_loadu_ps(colMax + n)));
+	}
+
+	max4 = _mm_max_ps(max4, _mm_shuffle_ps(max4, max4, _MM_SHUFFLE(1,0,3,2)));
+	max4 = _mm_max_ps(max4, _mm_shuffle_ps(max4, max4, _MM_SHUFFLE(2,3,0,1)));
+	max  = _mm_cvtss_f32(max4);
+#elif defined(__aarch64__)
+	// vmaxnmq_f32() returns the operand that isn't NaN
+	float32x4_t max4 = vdupq_n_f32(-INFINITY);
+
+	for( ; n + 4 <= count; n += 4 )
+	{
+		const float32x4_t value = vld1q_f32(row + n);
+		max4 = vmaxnmq_f32(value, max4);
+		vst1q_f32(colMax + n, vmaxnmq_f32(value, vld1q_f32(colMax + n)));
+	}
+
+	max = vmaxnmvq_f32(max4);
+#endif
+
+	for( ; n < count; n++ )
+	{
+		max = maxValue(row[n], max);
+		colMax[n] = maxValue(row[n], colMax[n]);
+	}
+
+	return max;
+}
+
+
+// findMaximums
+void* featureMatcher::findMaximums( void* user_param )
+{
+	Job* job = (Job*)user_param;
+	float* rowMax = job->matcher->mRowMax.data();
+
+	// go over the rows one block of columns at a time, so the column maximums stay in cache
+	for( uint32_t block=0; block < job->cols; block += FEATURE_MATCHER_BLOCK_SIZE )
+	{
+		const uint32_t blockSize = std::min<uint32_t>(job->cols - block, FEATURE_MATCHER_BLOCK_SIZE);
+		float* colMax = job->colMax + block;
+
+		std::fill(colMax, colMax + blockSize, -INFINITY);
+
+		for( uint32_t row=job->rowBegin; row < job->rowEnd; row++ )
+		{
+			const float max = maxRow(job->confidence + size_t(row) * job->cols + block, colMax, blockSize);
+			rowMax[row] = (block == 0) ? max : maxValue(max, rowMax[row]);
+		}
+	}
+
+	return NULL;
+}
+
+
+// addMatches (from a mask of the 4 columns starting at col)
+static inline void addMatches( std::vector<featureMatcher::Match>& matches, uint32_t mask, uint32_t row, uint32_t col, const float* conf )
+{
+	for( uint32_t n=0; n < 4; n++ )
+	{
+		if( mask & (1 << n) )
+		{
+			const featureMatcher::Match match = { row, col + n, conf[col + n] };
+			matches.push_back(match);
+		}
+	}
+}
+
+
+#if defined(__SSE2__)
+// a match isn't below the threshold (NaN's aren't either, like the scalar comparison)
+static inline __m128 acceptMatches( const float* conf, const float* colMax, __m128 threshold, __m128 rowMax, bool mutual )
+{
+	const __m128 value = _mm_loadu_ps(conf);
+	const __m128 accept = _mm_cmpnlt_ps(value, threshold);
+
+	if( !mutual )
+		return accept;
+
+	return _mm_and_ps(accept, _mm_and_ps(_mm_cmpeq_ps(value, rowMax), _mm_cmpeq_ps(value, _mm_loadu_ps(colMax))));
+}
+#elif defined(__aarch64__)
+// a match isn't below the threshold (NaN's aren't either, like the scalar comparison)
+static inline uint32x4_t acceptMatches( const float* conf, const float* colMax, float32x4_t threshold, float32x4_t rowMax, bool mutual )
+{
+	const float32x4_t value = vld1q_f32(conf);
+	const uint32x4_t accept = vmvnq_u32(vcltq_f32(value, threshold));
+
+	if( !mutual )
+		return accept;
+
+	return vandq_u32(accept, vandq_u32(vceqq_f32(value, rowMax), vceqq_f32(value, vld1q_f32(colMax))));
+}
+
+static inline uint32_t maskMatches( uint32x4_t accept )
+{
+	const uint32x4_t bits = { 1, 2, 4, 8 };
+	return vaddvq_u32(vandq_u32(accept, bits));
+}
+#endif
+
+
+// findMatches
+void* featureMatcher::findMatches( void* user_param )
+{
+	Job* job = (Job*)user_param;
+
+	const bool mutual = job->matcher->mMutualNearest;
+	const float* rowMax = job->matcher->mRowMax.data();
+	const float* colMax = job->matcher->mColMax.data();
+	const float threshold = job->threshold;
+	const uint32_t cols = job->cols;
+
+	std::vector<Match>& matches = job->matches;
+
+	for( uint32_t row=job->rowBegin; row < job->rowEnd; row++ )
+	{
+		const float* conf = job->confidence + size_t(row) * cols;
+
+		// a mutual nearest neighbor is the maximum of its row
+		if( mutual && rowMax[row] < threshold )
+			continue;
+
+		uint32_t col = 0;
+
+	#if defined(__SSE2__) || defined(__aarch64__)
+	#if defined(__SSE2__)
+		const __m128 threshold4 = _mm_set1_ps(threshold);
+		const __m128 rowMax4 = _mm_set1_ps(mutual ? rowMax[row] : 0.0f);
+	#else
+		const float32x4_t threshold4 = vdupq_n_f32(threshold);
+		const float32x4_t rowMax4 = vdupq_n_f32(mutual ? rowMax[row] : 0.0f);
+	#endif
+
+		// most of the matrix is below the threshold, so it's checked 16 columns at a time
+		for( ; col + 16 <= cols; col += 16 )
+		{
+		#if defined(__SSE2__)
+			const __m128 accept[] = { acceptMatches(conf + col, colMax + col, threshold4, rowMax4, mutual),
+								 acceptMatches(conf + col + 4, colMax + col + 4, threshold4, rowMax4, mutual),
+								 acceptMatches(conf + col + 8, colMax + col + 8, threshold4, rowMax4, mutual),
+								 acceptMatches(conf + col + 12, colMax + col + 12, threshold4, rowMax4, mutual) };
+
+			if( !_mm_movemask_ps(_mm_or_ps(_mm_or_ps(accept[0], accept[1]), _mm_or_ps(accept[2], accept[3]))) )
+				continue;
+
+			for( uint32_t n=0; n < 4; n++ )
+				addMatches(matches, _mm_movemask_ps(accept[n]), row, col + n * 4, conf);
+		#else
+			const uint32x4_t accept[] = { acceptMatches(conf + col, colMax + col, threshold4, rowMax4, mutual),
+								     acceptMatches(conf + col + 4, colMax + col + 4, threshold4, rowMax4, mutual),
+								     acceptMatches(conf + col + 8, colMax + col + 8, threshold4, rowMax4, mutual),
+								     acceptMatches(conf + col + 12, colMax + col + 12, threshold4, rowMax4, mutual) };
+
+			if( vmaxvq_u32(vorrq_u32(vorrq_u32(accept[0], accept[1]), vorrq_u32(accept[2], accept[3]))) == 0 )
+				continue;
+
+			for( uint32_t n=0; n < 4; n++ )
+				addMatches(matches, maskMatches(accept[n]), row, col + n * 4, conf);
+		#endif
+
+			if( matches.size() >= job->maxMatches )
+				return NULL;
+		}
+
+		for( ; col + 4 <= cols; col += 4 )
+		{
+		#if defined(__SSE2__)
+			addMatches(matches, _mm_movemask_ps(acceptMatches(conf + col, colMax + col, threshold4, rowMax4, mutual)), row, col, conf);
+		#else
+			addMatches(matches, maskMatches(acceptMatches(conf + col, colMax + col, threshold4, rowMax4, mutual)), row, col, conf);
+		#endif
+
+			if( matches.size() >= job->maxMatches )
+				return NULL;
+		}
+	#endif
+
+		for( ; col < cols; col++ )
+		{
+			const float value = conf[col];
+
+			if( value < threshold )
+				continue;
+
+			if( mutual && (value != rowMax[row] || value != colMax[col]) )
+				continue;
+
+			const Match match = { row, col, value };
+			matches.push_back(match);
+
+			if( matches.size() >= job->maxMatches )
+				return NULL;
+		}
+	}
+
+	return NULL;
+}
+
+
+// sortMatches
+void featureMatcher::sortMatches( std::vector<Match>& matches, uint32_t maxMatches )
+{
+	const size_t numMatches = matches.size();
+
+	// NaN's can't be ordered, so those are inserted the same way featureNet always has
+	for( size_t n=0; n < numMatches; n++ )
+	{
+		if( !isnan(matches[n].Confidence) )
+			continue;
+
+		std::vector<Match> sorted;
+		sorted.reserve(numMatches);
+
+		for( size_t m=0; m < numMatches; m++ )
+		{
+			size_t i = 0;
+
+			while( i < sorted.size() && !(matches[m].Confidence > sorted[i].Confidence) )
+				i++;
+
+			sorted.insert(sorted.begin() + i, matches[m]);
+		}
+
+		matches.swap(sorted);
+		return;
+	}
+
+	// matches with the same confidence stay in the order they were found (row-major)
+	auto compare = []( const Match& a, const Match& b )
+	{
+		if( a.Confidence != b.Confidence )
+			return a.Confidence > b.Confidence;
+
+		if( a.IndexA != b.IndexA )
+			return a.IndexA < b.IndexA;
+
+		return a.IndexB < b.IndexB;
+	};
+
+	if( maxMatches < numMatches )
+		std::partial_sort(matches.begin(), matches.begin() + maxMatches, matches.end(), compare);
+	else
+		std::sort(matches.begin(), matches.end(), compare);
+}
+
+
+// numThreads
+uint32_t featureMatcher::numThreads( uint32_t rows, uint32_t cols ) const
+{
+	uint32_t numThreads = mNumThreads;
+
+	// pick the number of threads so that each gets a reasonable amount of work
+	if( numThreads == 0 )
+	{
+		const size_t minElementsPerThread = 256 * 1024;
+		const long numCPU = sysconf(_SC_NPROCESSORS_ONLN);
+
+		numThreads = (size_t(rows) * cols) / minElementsPerThread;
+
+		if( numCPU > 0 && numThreads > (uint32_t)numCPU )
+			numThreads = numCPU;
+
+		if( numThreads > 8 )
+			numThreads = 8;
+	}
+
+	if( numThreads > rows )
+		numThreads = rows;
+
+	if( numThreads < 1 )
+		numThreads = 1;
+
+	return numThreads;
+}
+
+
+// runJobs
+void featureMatcher::runJobs( void* (*entry)(void*) )
+{
+	std::vector<Thread*> threads;
+
+	// the calling thread runs the first job
+	for( size_t n=1; n < mJobs.size(); n++ )
+	{
+		Thread* thread = new Thread();
+
+		if( !thread->Start(entry, &mJobs[n]) )
+		{
+			LogWarning("featureMatcher -- failed to start worker thread, matching on the calling thread\n");
+			delete thread;
+			entry(&mJobs[n]);
+			continue;
+		}
+
+		threads.push_back(thread);
+	}
+
+	entry(&mJobs[0]);
+
+	for( size_t n=0; n < threads.size(); n++ )
+	{
+		threads[n]->Stop(true);
+		delete threads[n];
+	}
+}
+
+
+// Process
+int featureMatcher::Process( const float* confidence, uint32_t rows, uint32_t cols,
+					    Match* matches, uint32_t maxMatches, float threshold, bool sorted )
+{
+	if( !confidence || !matches )
+	{
+		LogError("featureMatcher::Process() called with NULL / invalid parameters\n");
+		return -1;
+	}
+
+	if( rows == 0 || cols == 0 || maxMatches == 0 )
+		return 0;
+
+	const uint32_t numJobs = numThreads(rows, cols);
+	const uint32_t rowsPerJob = (rows + numJobs - 1) / numJobs;
+
+	mJobs.resize(numJobs);
+
+	for( uint32_t n=0; n < numJobs; n++ )
+	{
+		Job& job = mJobs[n];
+
+		job.matcher    = this;
+		job.confidence = confidence;
+		job.cols       = cols;
+		job.rowBegin   = std::min(n * rowsPerJob, rows);
+		job.rowEnd     = std::min(job.rowBegin + rowsPerJob, rows);
+		job.threshold  = threshold;
+		job.colMax     = NULL;
+
+		// when sorted, any of the matches could be in the top ones
+		job.maxMatches = sorted ? UINT32_MAX : maxMatches;
+		job.matches.clear();
+	}
+
+	// find the maximum of each row and column for the mutual nearest neighbors
+	if( mMutualNearest )
+	{
+		mRowMax.resize(rows);
+		mColMaxJobs.resize(size_t(numJobs) * cols);
+
+		for( uint32_t n=0; n < numJobs; n++ )
+			mJobs[n].colMax = mColMaxJobs.data() + size_t(n) * cols;
+
+		runJobs(findMaximums);
+
+		mColMax.assign(mColMaxJobs.begin(), mColMaxJobs.begin() + cols);
+
+		for( uint32_t n=1; n < numJobs; n++ )
+		{
+			for( uint32_t col=0; col < cols; col++ )
+				mColMax[col] = maxValue(mJobs[n].colMax[col], mColMax[col]);
+		}
+	}
+
+	runJobs(findMatches);
+
+	// the jobs are in row order, so the matches are too
+	mMatches.clear();
+
+	for( uint32_t n=0; n < numJobs; n++ )
+		mMatches.insert(mMatches.end(), mJobs[n].matches.begin(), mJobs[n].matches.end());
+
+	if( sorted )
+		sortMatches(mMatches, maxMatches);
+
+	const uint32_t numMatches = std::min<size_t>(mMatches.size(), maxMatches);
+	memcpy(matches, mMatches.data(), sizeof(Match) * numMatches);
+
+	return numMatches;
+}
+
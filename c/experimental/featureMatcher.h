@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __FEATURE_MATCHER_H__
+#define __FEATURE_MATCHER_H__
+
+
+#include <stdint.h>
+#include <vector>
+
+
+/**
+ * Number of columns of the confidence matrix that featureMatcher processes at a time,
+ * so that the running maximum of each column stays in the L1 cache.
+ * @ingroup featureNet
+ */
+#define FEATURE_MATCHER_BLOCK_SIZE 2048
+
+
+/**
+ * Matches features from the confidence matrix that a feature matching network outputs,
+ * on the CPU.  This is the stage after the network in featureNet, and doesn't depend on
+ * CUDA or TensorRT, so it can also be used on confidence matrices that were saved to disk.
+ *
+ * Element (a,b) of the matrix is the confidence that feature `a` from the first image
+ * matches feature `b` from the second image.  The matches are the elements that aren't
+ * below the threshold - and if mutual nearest neighbors are enabled, that are also the
+ * largest in both their row and column.  They're optionally sorted by confidence, in
+ * descending order (matches with the same confidence stay in row-major order).
+ *
+ * The matrix is scanned with SSE2 or NEON when available, and the rows can be split
+ * between multiple threads.  The results are the same regardless of either.
+ *
+ * @ingroup featureNet
+ */
+class featureMatcher
+{
+public:
+	/**
+	 * A match between a feature from each image.
+	 */
+	struct Match
+	{
+		uint32_t IndexA;	/**< Index of the feature in the first image (the row of the matrix) */
+		uint32_t IndexB;	/**< Index of the feature in the second image (the column of the matrix) */
+		float    Confidence;	/**< Confidence of the match */
+	};
+
+	/**
+	 * Constructor
+	 * @param numThreads the number of threads to split the matrix between.  If 0, this is
+	 *                   picked from the size of the matrix and the number of CPU cores.
+	 */
+	featureMatcher( uint32_t numThreads=1 );
+
+	/**
+	 * Find the matches in a confidence matrix.
+	 *
+	 * @param confidence the rows x cols confidence matrix (in CPU memory, row-major).
+	 * @param rows the number of features from the first image.
+	 * @param cols the number of features from the second image.
+	 * @param matches output array of the matches, which should be at least maxMatches long.
+	 * @param maxMatches the maximum number of matches to output.  When sorted, these are
+	 *                   the ones with the highest confidence, otherwise the first ones found.
+	 * @param threshold confidence threshold, below which matches are ignored.
+	 * @param sorted if true, the matches are sorted by confidence value in descending order.
+	 *
+	 * @returns The number of matches, or -1 if there was an error.
+	 */
+	int Process( const float* confidence, uint32_t rows, uint32_t cols,
+			   Match* matches, uint32_t maxMatches, float threshold, bool sorted=true );
+
+	/**
+	 * Get the number of threads (0 if it's picked from the size of the matrix).
+	 */
+	inline uint32_t GetThreads() const						{ return mNumThreads; }
+
+	/**
+	 * Set the number of threads (0 to pick it from the size of the matrix).
+	 */
+	inline void SetThreads( uint32_t numThreads )				{ mNumThreads = numThreads; }
+
+	/**
+	 * Return true if only mutual nearest neighbors are matched (the default is false).
+	 */
+	inline bool IsMutualNearest() const						{ return mMutualNearest; }
+
+	/**
+	 * Enable or disable only matching mutual nearest neighbors, which are the features
+	 * that have the highest confidence in each other out of all of the features.
+	 */
+	inline void SetMutualNearest( bool mutual )				{ mMutualNearest = mutual; }
+
+protected:
+
+	struct Job
+	{
+		featureMatcher* matcher;
+
+		const float* confidence;
+		uint32_t cols;
+		uint32_t rowBegin;
+		uint32_t rowEnd;
+		uint32_t maxMatches;
+
+		float threshold;
+		float* colMax;		// maximum of each column over this job's rows
+
+		std::vector<Match> matches;
+	};
+
+	uint32_t numThreads( uint32_t rows, uint32_t cols ) const;
+
+	void runJobs( void* (*entry)(void*) );
+
+	static void* findMaximums( void* job );
+	static void* findMatches( void* job );
+
+	static void sortMatches( std::vector<Match>& matches, uint32_t maxMatches );
+
+	uint32_t mNumThreads;
+	bool     mMutualNearest;
+
+	std::vector<Job>   mJobs;
+	std::vector<float> mRowMax;		// maximum of each row
+	std::vector<float> mColMax;		// maximum of each column (after the jobs are combined)
+	std::vector<float> mColMaxJobs;	// maximum of each column from each job
+	std::vector<Match> mMatches;
+};
+
+
+#endif
+
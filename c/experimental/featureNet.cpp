@@ -300,6 +300,65 @@ bool featureNet::preProcess( void* image, uint32_t width, uint32_t height, image
 }
 
 
+// postProcess
+int featureNet::postProcess( uint32_t width_A, uint32_t height_A, uint32_t width_B, uint32_t height_B,
+					    float2* features_A, float2* features_B, float* confidence, 
+					    float threshold, bool sorted )
+{
+	const uint32_t cellWidth = mInputWidth / mCellResolution;
+	const uint32_t cellHeight = mInputHeight / mCellResolution;
+	
+	const float scale = float(mInputHeight) / float(cellHeight);
+	
+#ifdef RESCALE_FEATURES
+	// this rescales the keypoints to their original image size
+	// which throws off the homography due to that additional scaling,
+	// because the images were rescaled to the same size before processed with DNN
+	const float2 scale_A = make_float2(scale * (float(width_A) / float(mInputWidth)),
+								scale * (float(height_A) / float(mInputHeight)));
+								
+	const float2 scale_B = make_float2(scale * (float(width_B) / float(mInputWidth)),
+								scale * (float(height_B) / float(mInputHeight)));
+#else
+	const float2 scale_A = make_float2(scale, scale);
+	const float2 scale_B = make_float2(scale, scale);
+#endif
+	
+	// threshold (and sort) the confidence matrix
+	mMatches.resize(mMaxFeatures);
+	
+	const int numMatches = mMatcher.Process(mOutputs[0].CPU, mMaxFeatures, mMaxFeatures, mMatches.data(), mMaxFeatures, threshold, sorted);
+	
+	if( numMatches < 0 )
+		return -1;
+	
+	// convert the cell indices to keypoint coordinates
+	for( int n=0; n < numMatches; n++ )
+	{
+		const uint32_t cx = mMatches[n].IndexA;
+		const uint32_t cy = mMatches[n].IndexB;
+		
+		features_A[n] = make_float2((cx % cellWidth) * scale_A.x, int(cx / cellWidth) * scale_A.y); // OG code uses scale.y for both?
+		features_B[n] = make_float2((cy % cellWidth) * scale_B.x, int(cy / cellWidth) * scale_B.y);
+		confidence[n] = mMatches[n].Confidence;
+		
+	#ifdef DEBUG_FEATURES
+		printf("match %i   %u %u  conf=%f  (%f, %f) -> (%f, %f)\n", n, cx, cy, confidence[n], features_A[n].x, features_A[n].y, features_B[n].x, features_B[n].y);
+	#endif
+	}
+
+#ifdef DEBUG_FEATURES
+	printf("cell width = %u\n", cellWidth);
+	printf("cell height = %u\n", cellHeight);
+	printf("scale = %f\n", scale);
+	printf("scale_A = (%f, %f)\n", scale_A.x, scale_A.y);
+	printf("scale_B = (%f, %f)\n", scale_B.x, scale_B.y);
+#endif
+
+	return numMatches;
+}
+
+
 // Match
 int featureNet::Match( void* image_A, uint32_t width_A, uint32_t height_A, imageFormat format_A, 
 				   void* image_B, uint32_t width_B, uint32_t height_B, imageFormat format_B, 
@@ -333,88 +392,8 @@ int featureNet::Match( void* image_A, uint32_t width_A, uint32_t height_A, image
 	PROFILER_END(PROFILER_NETWORK);
 	PROFILER_BEGIN(PROFILER_POSTPROCESS);
 	
-	const uint32_t cellWidth = mInputWidth / mCellResolution;
-	const uint32_t cellHeight = mInputHeight / mCellResolution;
-	
-	const float scale = float(mInputHeight) / float(cellHeight);
-	
-#ifdef RESCALE_FEATURES
-	// this rescales the keypoints to their original image size
-	// which throws off the homography due to that additional scaling,
-	// because the images were rescaled to the same size before processed with DNN
-	const float2 scale_A = make_float2(scale * (float(width_A) / float(mInputWidth)),
-								scale * (float(height_A) / float(mInputHeight)));
-								
-	const float2 scale_B = make_float2(scale * (float(width_B) / float(mInputWidth)),
-								scale * (float(height_B) / float(mInputHeight)));
-#else
-	const float2 scale_A = make_float2(scale, scale);
-	const float2 scale_B = make_float2(scale, scale);
-#endif
-	
-	// threshold the confidence matrix
-	uint32_t numMatches = 0;
-	
-	for( uint32_t cx=0; cx < mMaxFeatures; cx++ )
-	{
-		for( uint32_t cy=0; cy < mMaxFeatures; cy++ )
-		{
-			const float conf = mOutputs[0].CPU[cx * mMaxFeatures + cy];
+	const int numMatches = postProcess(width_A, height_A, width_B, height_B, features_A, features_B, confidence, threshold, sorted);
 
-			if( conf < threshold )
-				continue;
-			
-			const float2 keyA = make_float2((cx % cellWidth) * scale_A.x, int(cx / cellWidth) * scale_A.y); // OG code uses scale.y for both?
-			const float2 keyB = make_float2((cy % cellWidth) * scale_B.x, int(cy / cellWidth) * scale_B.y);
-			
-		#ifdef DEBUG_FEATURES
-			printf("match %u   %i %i  conf=%f  (%f, %f) -> (%f, %f)  (conf=%f)\n", numMatches, cx, cy, conf, keyA.x, keyA.y, keyB.x, keyB.y);
-		#endif
-		
-			if( !sorted || numMatches == 0 )
-			{
-				features_A[numMatches] = keyA;
-				features_B[numMatches] = keyB;
-				confidence[numMatches] = conf;
-			}
-			else
-			{
-				for( uint32_t n=0; n < numMatches; n++ )
-				{
-					if( conf > confidence[n] )
-					{
-						// TODO:  replace these memmoves with a linked/indexed list
-						memmove(features_A + n + 1, features_A + n, sizeof(float2) * (numMatches - n));
-						memmove(features_B + n + 1, features_B + n, sizeof(float2) * (numMatches - n));
-						memmove(confidence + n + 1, confidence + n, sizeof(float) * (numMatches - n));
-						
-						features_A[n] = keyA;
-						features_B[n] = keyB;
-						confidence[n] = conf;
-						
-						break;
-					}
-					else if( n == (numMatches - 1) )
-					{
-						features_A[n+1] = keyA;
-						features_B[n+1] = keyB;
-						confidence[n+1] = conf;
-					}
-				}
-			}
-			
-			numMatches += 1;
-		}
-	}
-
-#ifdef DEBUG_FEATURES
-	printf("cell width = %u\n", cellWidth);
-	printf("cell height = %u\n", cellHeight);
-	printf("scale = %f\n", scale);
-	printf("scale_A = (%f, %f)\n", scale_A.x, scale_A.y);
-	printf("scale_B = (%f, %f)\n", scale_B.x, scale_B.y);
-#endif
-	
 	PROFILER_END(PROFILER_POSTPROCESS);
 	return numMatches;
 }
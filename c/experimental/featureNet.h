@@ -25,6 +25,7 @@
 
 
 #include "tensorNet.h"
+#include "featureMatcher.h"
 
 
 /**
@@ -319,6 +320,12 @@ public:
 	 */
 	inline uint32_t GetMaxFeatures() const						{ return mMaxFeatures; } 
 	
+	/**
+	 * Retrieve the CPU matcher that finds the matches in the confidence matrix output by the network
+	 * (it can be used to set the number of threads, or to only match mutual nearest neighbors)
+	 */
+	inline featureMatcher& GetMatcher()						{ return mMatcher; }
+	
 	/**
 	 * Retrieve the network type (alexnet or googlenet)
 	 */
@@ -334,7 +341,9 @@ protected:
 	
 	bool init( const char* model_path, const char* input_0, const char* input_1, const char* output, uint32_t maxBatchSize, precisionType precision, deviceType device, bool allowGPUFallback );
 	bool preProcess( void* image, uint32_t width, uint32_t height, imageFormat format, uint32_t binding );
-	int  postProcess();
+	int  postProcess( uint32_t width_A, uint32_t height_A, uint32_t width_B, uint32_t height_B,
+				   float2* features_A, float2* features_B, float* confidence, 
+				   float threshold, bool sorted );
 	
 	void* mResizedImg;
 	
@@ -345,6 +354,9 @@ protected:
 	float2* mOutputFeatures[2];
 	float*  mOutputConfidence;
 	
+	featureMatcher mMatcher;
+	std::vector<featureMatcher::Match> mMatches;
+	
 	static const int mCellResolution = 16;  // for LoFTR
 	
 	cudaFont* mFont;
@@ -43,6 +43,8 @@ imageNet::imageNet() : tensorNet()
 	
 	mSmoothingBuffer = NULL;
 	mSmoothingFactor = 0;
+
+	mBatchROIs = NULL;
 }
 
 
@@ -50,6 +52,7 @@ imageNet::imageNet() : tensorNet()
 imageNet::~imageNet()
 {
 	CUDA_FREE_HOST(mSmoothingBuffer);
+	CUDA_FREE_HOST(mBatchROIs);
 }
 
 	
@@ -293,6 +296,45 @@ bool imageNet::preProcess( void* image, uint32_t width, uint32_t height, imageFo
 	return true;
 }
 
+
+// preProcess
+bool imageNet::preProcess( void* image, uint32_t width, uint32_t height, imageFormat format, const int4* rois, uint32_t numROIs )
+{
+	PROFILER_BEGIN(PROFILER_PREPROCESS);
+
+	// the same normalization as above, done by the one kernel that crops the batch
+	float2 range  = make_float2(0.0f, 1.0f);
+	float3 mean   = make_float3(0.485f, 0.456f, 0.406f);
+	float3 stdDev = make_float3(0.229f, 0.224f, 0.225f);
+	bool   isBGR  = false;
+
+	if( mModelFile == "Inception-v4.caffemodel" )
+	{
+		range  = make_float2(-1.0f, 1.0f);
+		mean   = make_float3(0.0f, 0.0f, 0.0f);
+		stdDev = make_float3(1.0f, 1.0f, 1.0f);
+	}
+	else if( !IsModelType(MODEL_ONNX) )
+	{
+		range  = make_float2(0.0f, 255.0f);
+		mean   = make_float3(104.0069879317889f, 116.66876761696767f, 122.6789143406786f);
+		stdDev = make_float3(1.0f, 1.0f, 1.0f);
+		isBGR  = true;
+	}
+
+	const cudaError_t result = isBGR ? cudaTensorNormMeanBGR(image, format, width, height, rois, numROIs, mInputs[0].CUDA, GetInputWidth(), GetInputHeight(), range, mean, stdDev, GetStream())
+							   : cudaTensorNormMeanRGB(image, format, width, height, rois, numROIs, mInputs[0].CUDA, GetInputWidth(), GetInputHeight(), range, mean, stdDev, GetStream());
+
+	if( CUDA_FAILED(result) )
+	{
+		LogError(LOG_TRT "imageNet::PreProcess() -- failed to crop the batch of %u regions\n", numROIs);
+		return false;
+	}
+
+	PROFILER_END(PROFILER_PREPROCESS);
+	return true;
+}
+
 	
 // Classify
 int imageNet::Classify( void* image, uint32_t width, uint32_t height, imageFormat format, float* confidence )
@@ -391,6 +433,116 @@ int imageNet::Classify( void* image, uint32_t width, uint32_t height, imageForma
 }
 
 
+// ClassifyBatch
+int imageNet::ClassifyBatch( void* image, uint32_t width, uint32_t height, imageFormat format, const int4* rois, uint32_t numROIs, int* classes, float* confidence )
+{
+	if( !image || width == 0 || height == 0 || (numROIs > 0 && (!rois || !classes)) )
+	{
+		LogError(LOG_TRT "imageNet::ClassifyBatch(0x%p, %u, %u) -> invalid parameters\n", image, width, height);
+		return -2;
+	}
+
+	if( !imageFormatIsRGB(format) )
+	{
+		LogError(LOG_TRT "imageNet::ClassifyBatch() -- unsupported image format (%s)\n", imageFormatToStr(format));
+		return -2;
+	}
+
+	const uint32_t maxBatchSize = GetMaxBatchSize();
+
+	if( maxBatchSize > mBatchIndex.size() )
+	{
+		// the regions are read by the kernel that crops them, so they're kept in mapped memory
+		CUDA_FREE_HOST(mBatchROIs);
+
+		if( !cudaAllocMapped((void**)&mBatchROIs, maxBatchSize * sizeof(int4)) )
+			return -2;
+
+		mBatchIndex.resize(maxBatchSize);
+	}
+
+	// the outputs of each tensor in the batch
+	const size_t outputStride = mOutputs[0].size / (maxBatchSize * sizeof(float));
+
+	int numClassified = 0;
+	uint32_t n = 0;
+
+	while( n < numROIs )
+	{
+		// gather the next batch of regions that are inside the image
+		uint32_t batchSize = 0;
+
+		for( ; n < numROIs && batchSize < maxBatchSize; n++ )
+		{
+			const int4 roi = make_int4(std::max(rois[n].x, 0), std::max(rois[n].y, 0),
+								  std::min(rois[n].z, (int)width), std::min(rois[n].w, (int)height));
+
+			classes[n] = -1;
+
+			if( confidence != NULL )
+				confidence[n] = 0.0f;
+
+			if( roi.z <= roi.x || roi.w <= roi.y )
+				continue;
+
+			mBatchROIs[batchSize] = roi;
+			mBatchIndex[batchSize] = n;
+			batchSize++;
+		}
+
+		if( batchSize == 0 )
+			continue;
+
+		if( !preProcess(image, width, height, format, mBatchROIs, batchSize) )
+		{
+			LogError(LOG_TRT "imageNet::ClassifyBatch() -- image pre-processing failed\n");
+			return -2;
+		}
+
+		PROFILER_BEGIN(PROFILER_NETWORK);
+
+		if( !ProcessNetwork(true, batchSize) )
+			return -2;
+
+		PROFILER_END(PROFILER_NETWORK);
+		PROFILER_BEGIN(PROFILER_POSTPROCESS);
+
+		// determine the maximum class of each region
+		for( uint32_t b=0; b < batchSize; b++ )
+		{
+			const float* outputs = mOutputs[0].CPU + b * outputStride;
+
+			int classIndex = -1;
+			float classMax = 0.0f;
+
+			for( uint32_t c=0; c < mNumClasses; c++ )
+			{
+				const float conf = outputs[c];
+
+				if( conf < mThreshold )
+					continue;
+
+				if( conf > classMax )
+				{
+					classIndex = c;
+					classMax   = conf;
+				}
+			}
+
+			classes[mBatchIndex[b]] = classIndex;
+
+			if( confidence != NULL )
+				confidence[mBatchIndex[b]] = classMax;
+		}
+
+		PROFILER_END(PROFILER_POSTPROCESS);
+		numClassified += batchSize;
+	}
+
+	return numClassified;
+}
+
+
 // applySmoothing
 float* imageNet::applySmoothing()
 {
@@ -225,6 +225,45 @@ public:
 	 */
 	int Classify( void* image, uint32_t width, uint32_t height, imageFormat format, Classifications& classifications, int topK=1 );
 
+	/**
+	 * Classify a batch of regions of interest in the image (like the bounding boxes of detected objects).
+	 * All of the regions are cropped, resized and normalized into the input tensor with one kernel, and
+	 * then classified with one batched inference - in chunks of up to GetMaxBatchSize() regions.
+	 * The confidences aren't smoothed, because the regions are different objects.
+	 *
+	 * @param image input image in CUDA device memory.
+	 * @param width width of the input image in pixels.
+	 * @param height height of the input image in pixels.
+	 * @param rois the regions as (left, top, right, bottom) in pixels, which are clipped to the image.
+	 * @param numROIs the number of regions.
+	 * @param classes output array with the ID of the class with the highest confidence for each region,
+	 *                or -1 if no classes met the threshold (or the region is outside of the image).
+	 * @param confidence optional output array filled with the confidence value of each region's class.
+	 *
+	 * @returns the number of regions that were classified, or -2 if a runtime error occurred.
+	 */
+	template<typename T> int ClassifyBatch( T* image, uint32_t width, uint32_t height, const int4* rois, uint32_t numROIs, int* classes, float* confidence=NULL )		{ return ClassifyBatch((void*)image, width, height, imageFormatFromType<T>(), rois, numROIs, classes, confidence); }
+
+	/**
+	 * Classify a batch of regions of interest in the image (like the bounding boxes of detected objects).
+	 * All of the regions are cropped, resized and normalized into the input tensor with one kernel, and
+	 * then classified with one batched inference - in chunks of up to GetMaxBatchSize() regions.
+	 * The confidences aren't smoothed, because the regions are different objects.
+	 *
+	 * @param image input image in CUDA device memory.
+	 * @param width width of the input image in pixels.
+	 * @param height height of the input image in pixels.
+	 * @param format format of the image (rgb8, rgba8, rgb32f, rgba32f are supported)
+	 * @param rois the regions as (left, top, right, bottom) in pixels, which are clipped to the image.
+	 * @param numROIs the number of regions.
+	 * @param classes output array with the ID of the class with the highest confidence for each region,
+	 *                or -1 if no classes met the threshold (or the region is outside of the image).
+	 * @param confidence optional output array filled with the confidence value of each region's class.
+	 *
+	 * @returns the number of regions that were classified, or -2 if a runtime error occurred.
+	 */
+	int ClassifyBatch( void* image, uint32_t width, uint32_t height, imageFormat format, const int4* rois, uint32_t numROIs, int* classes, float* confidence=NULL );
+
 	/**
 	 * Retrieve the number of image recognition classes (typically 1000)
 	 */
@@ -296,6 +335,7 @@ protected:
 	bool loadClassInfo( const char* filename, int expectedClasses=-1 );
 	
 	bool preProcess( void* image, uint32_t width, uint32_t height, imageFormat format );
+	bool preProcess( void* image, uint32_t width, uint32_t height, imageFormat format, const int4* rois, uint32_t numROIs );
 	
 	float* applySmoothing();
 	
@@ -310,6 +350,9 @@ protected:
 	float* mSmoothingBuffer;
 	float  mSmoothingFactor;
 	
+	int4* mBatchROIs;					// regions of the current batch (in mapped memory)
+	std::vector<uint32_t> mBatchIndex;	// index of the region that each tensor of the batch is from
+	
 	float mThreshold;
 };
 
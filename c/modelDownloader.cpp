@@ -24,11 +24,27 @@
 #include "tensorNet.h"
 
 #include "filesystem.h"
+#include "timespec.h"
 #include "logging.h"
 
+#include <curl/curl.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <deque>
 #include <fstream>
+#include <mutex>
 #include <sstream>
 
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
 
 nlohmann::json gModelManifest;
 bool gManifestLoaded = false;
@@ -142,80 +158,1182 @@ bool FindModel( const char* type, const char* name )
 }
 
 
-// DownloadModel
-bool DownloadModel( nlohmann::json& model, uint32_t retries )
+/*
+ * download settings
+ */
+static std::string gModelMirror;
+static std::string gModelCache;
+static bool gModelMirrorSet = false;
+
+
+// SetModelMirror
+void SetModelMirror( const char* url )
 {
-	const std::string dir = JSON_STR(model["dir"]);
-	const std::string url = JSON_STR(model["url"]);
-	const std::string tar = JSON_STR(model["tar"]);
-	const std::string cmd = JSON_STR(model["cmd"]);
-	
-	if( locateFile("networks/" + dir).length() > 0 )
-		return true;
+	gModelMirror = (url != NULL) ? url : "";
+	gModelMirrorSet = true;
+
+	// strip trailing slashes, the archive's filename gets appended
+	while( gModelMirror.length() > 0 && gModelMirror[gModelMirror.length()-1] == '/' )
+		gModelMirror.erase(gModelMirror.length()-1);
+}
+
+
+// GetModelMirror
+const char* GetModelMirror()
+{
+	if( !gModelMirrorSet )
+		SetModelMirror(getenv(MODEL_DOWNLOADER_MIRROR_ENV));
+
+	return (gModelMirror.length() > 0) ? gModelMirror.c_str() : NULL;
+}
+
+
+// SetModelCache
+void SetModelCache( const char* path )
+{
+	gModelCache = (path != NULL) ? path : "";
+}
+
+
+// GetModelCache
+std::string GetModelCache()
+{
+	if( gModelCache.length() > 0 )
+		return gModelCache;
+
+	const char* env = getenv(MODEL_DOWNLOADER_CACHE_ENV);
+
+	if( env != NULL && strlen(env) > 0 )
+		return env;
+
+	const std::string networks = locateFile("networks");
+
+	if( networks.length() == 0 )
+		return "";
+
+	return pathJoin(networks, ".cache");
+}
+
+
+/*
+ * SHA-256 (FIPS 180-4) used to verify the archives and address the cache
+ */
+struct modelHash
+{
+	modelHash()	{ Reset(); }
+
+	void Reset()
+	{
+		static const uint32_t init[] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+								   0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+
+		memcpy(state, init, sizeof(state));
+		length = 0;
+		used = 0;
+	}
 
-	if( url.length() > 0 )
+	void Update( const void* data, size_t size )
 	{
-		for( uint32_t retry=0; retry < retries; retry++ )
+		const uint8_t* bytes = (const uint8_t*)data;
+		length += size;
+
+		if( used > 0 )
 		{
-			std::ostringstream cmd;
-			
-			cmd << "cd " << locateFile("networks") << " ; ";
-			cmd << "wget ";
-			
-			if( retry > 0 )
-				cmd << "--verbose ";
-			else
-				cmd << "--quiet ";
-			
-			cmd << "--show-progress --progress=bar:force:noscroll --no-check-certificate ";
-			cmd << url;
+			const size_t n = std::min(size, (size_t)(64 - used));
 
-			if( tar.length() > 0 )
-			{
-				cmd << " -O " << tar << " ; ";
-				cmd << "tar -xzvf " << tar << " ; ";
-				cmd << "rm " << tar;
-			}
-			else
-			{
-				cmd << " ; ";
-			}
-			
-			const std::string cmd_str = cmd.str();
-			
-			LogVerbose(LOG_TRT "downloading model %s...\n", tar.c_str());
-			LogVerbose("%s\n", cmd_str.c_str());
-			
-			const int result = system(cmd_str.c_str());
-			
-			if( result == 0 )
-			{
-				LogSuccess(LOG_TRT "downloaded model %s\n", tar.c_str());
-				return true;
-			}
-			
-			LogError(LOG_TRT "model download failed on retry %u with error %i\n", retry, result);
+			memcpy(block + used, bytes, n);
+			used += n; bytes += n; size -= n;
+
+			if( used < 64 )
+				return;
+
+			transform(block);
+			used = 0;
+		}
+
+		while( size >= 64 )
+		{
+			transform(bytes);
+			bytes += 64; size -= 64;
 		}
+
+		memcpy(block, bytes, size);
+		used = size;
 	}
-	
-	if( cmd.length() > 0 )
+
+	std::string Final()
 	{
-		LogVerbose(LOG_TRT "running model command:  %s\n", cmd.c_str());
+		const uint64_t bits = length * 8;
+		const uint8_t pad = 0x80;
+		const uint8_t zero = 0;
 
-		const int result = system(cmd.c_str());
-			
-		if( result == 0 )
+		Update(&pad, 1);
+
+		while( used != 56 )
+			Update(&zero, 1);
+
+		uint8_t size[8];
+
+		for( int n=0; n < 8; n++ )
+			size[n] = (uint8_t)(bits >> (56 - n * 8));
+
+		Update(size, 8);
+
+		char str[65];
+
+		for( int n=0; n < 8; n++ )
+			sprintf(str + n * 8, "%08x", state[n]);
+
+		Reset();
+		return str;
+	}
+
+private:
+	static inline uint32_t rotr( uint32_t x, int n )	{ return (x >> n) | (x << (32 - n)); }
+
+	void transform( const uint8_t* data )
+	{
+		static const uint32_t K[] = {
+			0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+			0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+			0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+			0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+			0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+			0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+			0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+			0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2 };
+
+		uint32_t w[64];
+
+		for( int n=0; n < 16; n++ )
+			w[n] = (data[n*4] << 24) | (data[n*4+1] << 16) | (data[n*4+2] << 8) | data[n*4+3];
+
+		for( int n=16; n < 64; n++ )
 		{
-			LogSuccess(LOG_TRT "downloaded model to %s\n", dir.c_str());
-			return true;
+			const uint32_t s0 = rotr(w[n-15], 7) ^ rotr(w[n-15], 18) ^ (w[n-15] >> 3);
+			const uint32_t s1 = rotr(w[n-2], 17) ^ rotr(w[n-2], 19) ^ (w[n-2] >> 10);
+
+			w[n] = w[n-16] + s0 + w[n-7] + s1;
 		}
+
+		uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+		uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+		for( int n=0; n < 64; n++ )
+		{
+			const uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[n] + w[n];
+			const uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+
+			h = g; g = f; f = e; e = d + t1;
+			d = c; c = b; b = a; a = t1 + t2;
+		}
+
+		state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+		state[4] += e; state[5] += f; state[6] += g; state[7] += h;
 	}
-	
-	LogError(LOG_TRT "failed to download model after %u retries\n", retries);
-	LogInfo(LOG_TRT "if this error keeps occuring, see here for a mirror to download the models from:\n");
-	LogInfo(LOG_TRT "   https://github.com/dusty-nv/jetson-inference/releases\n");
-	
-	return false;
+
+	uint32_t state[8];
+	uint64_t length;
+	uint8_t  block[64];
+	size_t   used;
+};
+
+
+// hashString
+static std::string hashString( const std::string& str )
+{
+	modelHash hash;
+	hash.Update(str.c_str(), str.length());
+	return hash.Final();
+}
+
+
+// hashFile (hashes the first 'size' bytes of an open file)
+static bool hashFile( int fd, uint64_t size, modelHash& hash )
+{
+	std::vector<uint8_t> buffer(1024 * 1024);
+	uint64_t offset = 0;
+
+	while( offset < size )
+	{
+		const ssize_t bytes = pread(fd, buffer.data(), std::min((uint64_t)buffer.size(), size - offset), offset);
+
+		if( bytes <= 0 )
+			return false;
+
+		hash.Update(buffer.data(), bytes);
+		offset += bytes;
+	}
+
+	return true;
+}
+
+
+// hashFile
+static std::string hashFile( const std::string& path )
+{
+	const int fd = open(path.c_str(), O_RDONLY);
+
+	if( fd < 0 )
+		return "";
+
+	struct stat info;
+	modelHash hash;
+
+	const bool result = (fstat(fd, &info) == 0) && hashFile(fd, info.st_size, hash);
+
+	close(fd);
+	return result ? hash.Final() : "";
+}
+
+
+/*
+ * filesystem helpers
+ */
+static bool makeDirs( const std::string& path )
+{
+	for( size_t n=1; n <= path.length(); n++ )
+	{
+		if( n < path.length() && path[n] != '/' )
+			continue;
+
+		const std::string dir = path.substr(0, n);
+
+		if( mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST )
+		{
+			LogError(LOG_TRT "failed to create directory '%s' (%s)\n", dir.c_str(), strerror(errno));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+static int removeEntry( const char* path, const struct stat*, int, struct FTW* )
+{
+	return remove(path);
+}
+
+
+static bool removeDirs( const std::string& path )
+{
+	return nftw(path.c_str(), removeEntry, 16, FTW_DEPTH | FTW_PHYS) == 0;
+}
+
+
+static bool writeFileAtomic( const std::string& path, const void* data, size_t size )
+{
+	const std::string tmp = path + ".tmp" + std::to_string(getpid());
+	FILE* file = fopen(tmp.c_str(), "wb");
+
+	if( !file )
+		return false;
+
+	const bool written = (fwrite(data, 1, size, file) == size);
+
+	if( fclose(file) != 0 || !written || rename(tmp.c_str(), path.c_str()) != 0 )
+	{
+		unlink(tmp.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+
+static bool copyFileAtomic( const std::string& src, const std::string& dst )
+{
+	void* data = NULL;
+	const size_t size = loadFile(src, &data);
+
+	if( size == 0 && fileSize(src) != 0 )
+		return false;
+
+	const bool result = writeFileAtomic(dst, data, size);
+	free(data);
+	return result;
+}
+
+
+/*
+ * tar.gz extraction (plain tar files are passed through by zlib)
+ */
+static uint64_t parseTarNumber( const char* field, size_t size )
+{
+	uint64_t value = 0;
+
+	if( (uint8_t)field[0] & 0x80 )	// GNU base-256 encoding
+	{
+		for( size_t n=1; n < size; n++ )
+			value = (value << 8) | (uint8_t)field[n];
+
+		return value;
+	}
+
+	for( size_t n=0; n < size && field[n] != 0; n++ )
+	{
+		if( field[n] >= '0' && field[n] <= '7' )
+			value = (value << 3) | (field[n] - '0');
+	}
+
+	return value;
+}
+
+
+static std::string parseTarString( const char* field, size_t size )
+{
+	return std::string(field, strnlen(field, size));
+}
+
+
+// reject absolute paths and parent references, so nothing is written outside of the staging directory
+static bool sanitizeTarPath( std::string& path )
+{
+	while( path.compare(0, 2, "./") == 0 )
+		path.erase(0, 2);
+
+	while( path.length() > 0 && path[path.length()-1] == '/' )
+		path.erase(path.length()-1);
+
+	if( path.length() == 0 || path == "." || path[0] == '/' )
+		return false;
+
+	std::istringstream components(path);
+	std::string component;
+
+	while( std::getline(components, component, '/') )
+	{
+		if( component == ".." )
+			return false;
+	}
+
+	return true;
+}
+
+
+static bool readTarData( gzFile gz, uint64_t size, std::string* str, int fd=-1 )
+{
+	char buffer[64 * 1024];
+	uint64_t remaining = (size + 511) & ~uint64_t(511);	// data is padded to 512-byte blocks
+
+	while( remaining > 0 )
+	{
+		const unsigned int request = std::min((uint64_t)sizeof(buffer), remaining);
+
+		if( gzread(gz, buffer, request) != (int)request )
+			return false;
+
+		const size_t valid = std::min((uint64_t)request, size);
+
+		if( str != NULL )
+			str->append(buffer, valid);
+
+		if( fd >= 0 && valid > 0 && write(fd, buffer, valid) != (ssize_t)valid )
+			return false;
+
+		size -= valid;
+		remaining -= request;
+	}
+
+	return true;
+}
+
+
+static bool extractArchive( const std::string& archive, const std::string& dst )
+{
+	gzFile gz = gzopen(archive.c_str(), "rb");
+
+	if( !gz )
+	{
+		LogError(LOG_TRT "failed to open archive '%s'\n", archive.c_str());
+		return false;
+	}
+
+	gzbuffer(gz, 256 * 1024);
+
+	std::string longName;
+	std::string longLink;
+
+	bool result = true;
+	char header[512];
+
+	while( result )
+	{
+		const int bytes = gzread(gz, header, sizeof(header));
+
+		if( bytes == 0 || (bytes == sizeof(header) && header[0] == 0) )
+			break;	// end of archive
+
+		if( bytes != sizeof(header) )
+		{
+			LogError(LOG_TRT "archive '%s' is truncated\n", archive.c_str());
+			result = false;
+			break;
+		}
+
+		// verify the header checksum (computed with the checksum field as spaces)
+		uint64_t checksum = 0;
+
+		for( size_t n=0; n < sizeof(header); n++ )
+			checksum += (n >= 148 && n < 156) ? ' ' : (uint8_t)header[n];
+
+		if( checksum != parseTarNumber(header + 148, 8) )
+		{
+			LogError(LOG_TRT "archive '%s' has an invalid header\n", archive.c_str());
+			result = false;
+			break;
+		}
+
+		const uint64_t size = parseTarNumber(header + 124, 12);
+		const char type = header[156];
+
+		std::string name = parseTarString(header, 100);
+		std::string link = parseTarString(header + 157, 100);
+
+		if( memcmp(header + 257, "ustar", 5) == 0 && header[345] != 0 )
+			name = parseTarString(header + 345, 155) + "/" + name;
+
+		if( longName.length() > 0 )
+			name.swap(longName);
+
+		if( longLink.length() > 0 )
+			link.swap(longLink);
+
+		longName.clear();
+		longLink.clear();
+
+		if( type == 'L' || type == 'K' )	// GNU long name/link
+		{
+			std::string& str = (type == 'L') ? longName : longLink;
+			result = readTarData(gz, size, &str);
+			str = str.c_str();	// strip the null terminator
+			continue;
+		}
+		else if( type == 'x' )	// pax extended header
+		{
+			std::string records;
+			result = readTarData(gz, size, &records);
+
+			size_t pos = 0;
+
+			while( result && pos < records.length() )
+			{
+				const size_t length = strtoul(records.c_str() + pos, NULL, 10);
+				const size_t space = records.find(' ', pos);
+
+				if( length == 0 || space == std::string::npos || pos + length > records.length() )
+					break;
+
+				const std::string record = records.substr(space + 1, pos + length - space - 2);
+
+				if( record.compare(0, 5, "path=") == 0 )
+					longName = record.substr(5);
+				else if( record.compare(0, 9, "linkpath=") == 0 )
+					longLink = record.substr(9);
+
+				pos += length;
+			}
+
+			continue;
+		}
+
+		if( !sanitizeTarPath(name) )
+		{
+			result = readTarData(gz, size, NULL);
+			continue;
+		}
+
+		const std::string path = pathJoin(dst, name);
+
+		if( type == '5' )
+		{
+			result = makeDirs(path);
+		}
+		else if( type == '0' || type == '\0' || type == '7' )
+		{
+			result = makeDirs(pathDir(path));
+
+			const uint32_t mode = parseTarNumber(header + 100, 8) & 0777;
+			const int fd = result ? open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, mode != 0 ? mode : 0644) : -1;
+
+			if( fd < 0 )
+			{
+				LogError(LOG_TRT "failed to create '%s' (%s)\n", path.c_str(), strerror(errno));
+				result = false;
+				break;
+			}
+
+			result = readTarData(gz, size, NULL, fd);
+
+			if( close(fd) != 0 )
+				result = false;
+		}
+		else if( type == '2' && link.length() > 0 && link[0] != '/' && link.find("..") == std::string::npos )
+		{
+			result = makeDirs(pathDir(path)) && symlink(link.c_str(), path.c_str()) == 0;
+		}
+		else if( type == '1' && sanitizeTarPath(link) )
+		{
+			result = makeDirs(pathDir(path)) && ::link(pathJoin(dst, link).c_str(), path.c_str()) == 0;
+		}
+		else
+		{
+			LogVerbose(LOG_TRT "skipping '%s' in archive '%s'\n", name.c_str(), archive.c_str());
+			result = readTarData(gz, size, NULL);
+		}
+	}
+
+	gzclose(gz);
+
+	if( !result )
+		LogError(LOG_TRT "failed to extract archive '%s'\n", archive.c_str());
+
+	return result;
+}
+
+
+/*
+ * state of each model being downloaded
+ */
+struct modelTransfer
+{
+	std::string dir;		// directory the model gets installed to (under networks/)
+	std::string tar;		// filename of the archive (or of the model, if it isn't an archive)
+	std::string cmd;		// fallback command from the manifest
+	std::string sha256;		// expected hash of the archive (optional)
+	std::string key;		// hash of the original URL, for looking up the archive in the cache
+	std::string partPath;	// partial download in the cache
+
+	std::vector<std::string> urls;	// the mirror first (if set), then the original URL
+
+	uint32_t attempts;
+	uint32_t maxAttempts;
+
+	CURL*     curl;
+	FILE*     file;		// partial download (holds an exclusive lock while open)
+	modelHash hash;		// running hash of the partial download
+	uint64_t  offset;		// size of the partial download when the request was made
+	bool      checkedResponse;
+
+	bool done;
+	bool installed;
+};
+
+
+static bool isArchive( const std::string& filename )
+{
+	const char* extensions[] = { ".tar.gz", ".tgz", ".tar" };
+
+	for( size_t n=0; n < sizeof(extensions) / sizeof(extensions[0]); n++ )
+	{
+		const size_t length = strlen(extensions[n]);
+
+		if( filename.length() > length && strcasecmp(filename.c_str() + filename.length() - length, extensions[n]) == 0 )
+			return true;
+	}
+
+	return false;
+}
+
+
+static bool isInstalled( const std::string& dir )
+{
+	return dir.length() > 0 && locateFile("networks/" + dir).length() > 0;
+}
+
+
+// installModel
+static bool installModel( modelTransfer* t, const std::string& archive )
+{
+	if( isInstalled(t->dir) )
+		return true;
+
+	const std::string networks = locateFile("networks");
+
+	if( networks.length() == 0 )
+	{
+		LogError(LOG_TRT "couldn't find the networks directory to install %s into\n", t->tar.c_str());
+		return false;
+	}
+
+	if( !isArchive(t->tar) )
+	{
+		if( !copyFileAtomic(archive, pathJoin(networks, t->tar)) )
+		{
+			LogError(LOG_TRT "failed to install %s to %s\n", t->tar.c_str(), networks.c_str());
+			return false;
+		}
+
+		return true;
+	}
+
+	// extract into a staging directory, and then move the top-level entries into place
+	// with rename() so that other processes never see a partially-extracted model
+	const std::string staging = pathJoin(networks, ".install-" + hashString(t->tar).substr(0, 16) + "-" + std::to_string(getpid()));
+
+	removeDirs(staging);
+
+	if( !makeDirs(staging) )
+		return false;
+
+	bool result = extractArchive(archive, staging);
+
+	DIR* dir = result ? opendir(staging.c_str()) : NULL;
+
+	if( dir != NULL )
+	{
+		struct dirent* entry = NULL;
+
+		while( (entry = readdir(dir)) != NULL )
+		{
+			if( strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0 )
+				continue;
+
+			const std::string src = pathJoin(staging, entry->d_name);
+			const std::string dst = pathJoin(networks, entry->d_name);
+
+			if( rename(src.c_str(), dst.c_str()) != 0 )
+			{
+				if( errno == EEXIST || errno == ENOTEMPTY )
+				{
+					LogVerbose(LOG_TRT "%s was already installed\n", dst.c_str());
+					continue;
+				}
+
+				LogError(LOG_TRT "failed to install %s (%s)\n", dst.c_str(), strerror(errno));
+				result = false;
+			}
+		}
+
+		closedir(dir);
+	}
+
+	removeDirs(staging);
+
+	if( result && t->dir.length() > 0 && !isInstalled(t->dir) )
+		LogWarning(LOG_TRT "archive %s didn't contain networks/%s\n", t->tar.c_str(), t->dir.c_str());
+
+	return result;
+}
+
+
+// findCachedModel
+static std::string findCachedModel( modelTransfer* t )
+{
+	const std::string cache = GetModelCache();
+	std::string hash = t->sha256;
+
+	if( hash.length() == 0 )
+	{
+		// the manifest doesn't have the hash, so look it up from the URL
+		const std::string index = pathJoin(cache, "urls/" + t->key);
+
+		if( !fileExists(index, FILE_REGULAR) )
+			return "";
+
+		hash = readFile(index);
+
+		if( hash.length() != 64 )
+			return "";
+	}
+
+	const std::string path = pathJoin(cache, "sha256/" + hash);
+
+	if( !fileExists(path, FILE_REGULAR) )
+		return "";
+
+	if( hashFile(path) != hash )
+	{
+		LogWarning(LOG_TRT "cached archive %s failed verification, downloading it again\n", t->tar.c_str());
+		unlink(path.c_str());
+		return "";
+	}
+
+	return path;
+}
+
+
+// installCachedModel
+static bool installCachedModel( modelTransfer* t, const std::string& archive )
+{
+	t->installed = installModel(t, archive);
+
+	if( !t->installed )
+	{
+		// the archive may be corrupt (if there wasn't a hash to verify it with), so download it again
+		unlink(archive.c_str());
+		unlink(pathJoin(GetModelCache(), "urls/" + t->key).c_str());
+	}
+
+	return t->installed;
+}
+
+
+// onDownloadData
+static size_t onDownloadData( char* data, size_t size, size_t count, void* user_data )
+{
+	modelTransfer* t = (modelTransfer*)user_data;
+	const size_t bytes = size * count;
+
+	if( !t->checkedResponse )
+	{
+		long code = 0;
+		curl_easy_getinfo(t->curl, CURLINFO_RESPONSE_CODE, &code);
+
+		if( code >= 400 )
+			return 0;	// don't write error pages into the archive
+
+		t->checkedResponse = true;
+	}
+
+	if( fwrite(data, 1, bytes, t->file) != bytes )
+		return 0;
+
+	t->hash.Update(data, bytes);
+	return bytes;
+}
+
+
+// closeTransfer
+static void closeTransfer( modelTransfer* t )
+{
+	if( t->file != NULL )
+	{
+		fclose(t->file);
+		t->file = NULL;
+	}
+}
+
+
+// beginTransfer
+static bool beginTransfer( modelTransfer* t )
+{
+	const std::string cache = GetModelCache();
+
+	if( !makeDirs(pathJoin(cache, "partial")) || !makeDirs(pathJoin(cache, "sha256")) || !makeDirs(pathJoin(cache, "urls")) )
+		return false;
+
+	// lock the partial download, in case another process is downloading the same model
+	while( true )
+	{
+		const int fd = open(t->partPath.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+
+		if( fd < 0 )
+		{
+			LogError(LOG_TRT "failed to open '%s' (%s)\n", t->partPath.c_str(), strerror(errno));
+			return false;
+		}
+
+		if( flock(fd, LOCK_EX | LOCK_NB) != 0 )
+		{
+			LogInfo(LOG_TRT "waiting for another process to download %s\n", t->tar.c_str());
+			flock(fd, LOCK_EX);
+		}
+
+		// if the other process finished, it moved the file into the cache
+		struct stat locked;
+		struct stat current;
+
+		if( fstat(fd, &locked) == 0 && stat(t->partPath.c_str(), &current) == 0 && locked.st_ino == current.st_ino )
+		{
+			t->file = fdopen(fd, "ab");
+			t->offset = locked.st_size;
+			break;
+		}
+
+		close(fd);
+
+		const std::string archive = findCachedModel(t);
+
+		if( archive.length() > 0 && installCachedModel(t, archive) )
+		{
+			t->done = true;
+			return false;
+		}
+	}
+
+	if( !t->file )
+		return false;
+
+	// hash what was already downloaded before resuming
+	t->hash.Reset();
+
+	if( t->offset > 0 && !hashFile(fileno(t->file), t->offset, t->hash) )
+	{
+		t->hash.Reset();
+		t->offset = 0;
+
+		if( ftruncate(fileno(t->file), 0) != 0 )
+		{
+			closeTransfer(t);
+			return false;
+		}
+	}
+
+	const std::string& url = t->urls[t->attempts % t->urls.size()];
+
+	if( !t->curl )
+		t->curl = curl_easy_init();
+	else
+		curl_easy_reset(t->curl);
+
+	if( !t->curl )
+	{
+		closeTransfer(t);
+		return false;
+	}
+
+	curl_easy_setopt(t->curl, CURLOPT_URL, url.c_str());
+	curl_easy_setopt(t->curl, CURLOPT_PRIVATE, t);
+	curl_easy_setopt(t->curl, CURLOPT_WRITEFUNCTION, onDownloadData);
+	curl_easy_setopt(t->curl, CURLOPT_WRITEDATA, t);
+	curl_easy_setopt(t->curl, CURLOPT_FOLLOWLOCATION, 1L);
+	curl_easy_setopt(t->curl, CURLOPT_USERAGENT, "jetson-inference");
+	curl_easy_setopt(t->curl, CURLOPT_CONNECTTIMEOUT, 15L);
+	curl_easy_setopt(t->curl, CURLOPT_LOW_SPEED_LIMIT, 1024L);	// abort stalled transfers after 30 seconds,
+	curl_easy_setopt(t->curl, CURLOPT_LOW_SPEED_TIME, 30L);		// they get resumed on the next attempt
+	curl_easy_setopt(t->curl, CURLOPT_SSL_VERIFYPEER, 0L);		// same as wget --no-check-certificate (the
+	curl_easy_setopt(t->curl, CURLOPT_SSL_VERIFYHOST, 0L);		// clock is often unset), the hash is checked instead
+
+	if( t->offset > 0 )
+		curl_easy_setopt(t->curl, CURLOPT_RESUME_FROM_LARGE, (curl_off_t)t->offset);
+
+	t->checkedResponse = false;
+
+	if( t->offset > 0 )
+	{
+		LogInfo(LOG_TRT "resuming download of %s at %.1f MB from %s\n", t->tar.c_str(), t->offset / (1024.0 * 1024.0), url.c_str());
+	}
+	else
+	{
+		LogInfo(LOG_TRT "downloading %s from %s\n", t->tar.c_str(), url.c_str());
+	}
+
+	return true;
+}
+
+
+// endTransfer
+static bool endTransfer( modelTransfer* t, CURLcode result )
+{
+	long code = 0;
+	curl_easy_getinfo(t->curl, CURLINFO_RESPONSE_CODE, &code);
+
+	const bool complete = (result == CURLE_OK && (code == 200 || code == 206 || code == 0))
+					  || (code == 416 && t->offset > 0);	// the partial download was already complete
+
+	if( result == CURLE_RANGE_ERROR )
+	{
+		// the server doesn't support resuming, so start over (without using up an attempt)
+		LogVerbose(LOG_TRT "server doesn't support resuming %s, restarting the download\n", t->tar.c_str());
+
+		if( ftruncate(fileno(t->file), 0) == 0 )
+			t->maxAttempts++;
+
+		closeTransfer(t);
+		return false;
+	}
+
+	if( fflush(t->file) != 0 || !complete )
+	{
+		if( code >= 400 )
+		{
+			LogError(LOG_TRT "failed to download %s (HTTP error %li)\n", t->tar.c_str(), code);
+		}
+		else
+		{
+			LogError(LOG_TRT "failed to download %s (%s)\n", t->tar.c_str(), curl_easy_strerror(result));
+		}
+
+		closeTransfer(t);
+
+		if( code >= 400 && code != 416 )
+			unlink(t->partPath.c_str());	// don't resume on top of the wrong file
+
+		return false;
+	}
+
+	// verify the archive and move it into the cache
+	const std::string hash = t->hash.Final();
+
+	if( t->sha256.length() > 0 && strcasecmp(t->sha256.c_str(), hash.c_str()) != 0 )
+	{
+		LogError(LOG_TRT "downloaded %s failed verification\n", t->tar.c_str());
+		LogError(LOG_TRT "   expected sha256 %s\n", t->sha256.c_str());
+		LogError(LOG_TRT "   received sha256 %s\n", hash.c_str());
+
+		unlink(t->partPath.c_str());
+		closeTransfer(t);
+		return false;
+	}
+
+	const std::string cache = GetModelCache();
+	const std::string archive = pathJoin(cache, "sha256/" + hash);
+
+	const bool cached = (rename(t->partPath.c_str(), archive.c_str()) == 0)
+				    && writeFileAtomic(pathJoin(cache, "urls/" + t->key), hash.c_str(), hash.length());
+
+	closeTransfer(t);
+
+	if( !cached )
+	{
+		LogError(LOG_TRT "failed to move %s into the cache at %s\n", t->tar.c_str(), cache.c_str());
+		return false;
+	}
+
+	LogSuccess(LOG_TRT "downloaded model %s (sha256 %s)\n", t->tar.c_str(), hash.c_str());
+
+	t->done = installCachedModel(t, archive);
+	return t->done;
+}
+
+
+// retryTransfer
+static bool retryTransfer( modelTransfer* t )
+{
+	t->attempts++;
+
+	if( t->attempts < t->maxAttempts )
+		return true;
+
+	t->done = true;
+	return false;
+}
+
+
+// runModelCommand
+static bool runModelCommand( const std::string& cmd, const std::string& dir )
+{
+	LogVerbose(LOG_TRT "running model command:  %s\n", cmd.c_str());
+
+	const int result = system(cmd.c_str());
+
+	if( result != 0 )
+		return false;
+
+	LogSuccess(LOG_TRT "downloaded model to %s\n", dir.c_str());
+	return true;
+}
+
+
+// DownloadModels
+bool DownloadModels( std::vector<nlohmann::json>& models, uint32_t retries, uint32_t maxJobs )
+{
+	static std::once_flag curlInit;
+	std::call_once(curlInit, []() { curl_global_init(CURL_GLOBAL_DEFAULT); });
+
+	const char* mirror = GetModelMirror();
+	const std::string cache = GetModelCache();
+
+	bool result = true;
+
+	std::vector<modelTransfer*> transfers;
+	std::deque<modelTransfer*> queue;
+
+	// check which models still need to be downloaded
+	for( size_t n=0; n < models.size(); n++ )
+	{
+		nlohmann::json& model = models[n];
+
+		const std::string dir = JSON_STR(model["dir"]);
+		const std::string url = JSON_STR(model["url"]);
+		const std::string cmd = JSON_STR(model["cmd"]);
+
+		if( isInstalled(dir) )
+			continue;
+
+		if( url.length() == 0 || cache.length() == 0 )
+		{
+			if( cmd.length() == 0 || !runModelCommand(cmd, dir) )
+				result = false;
+
+			continue;
+		}
+
+		modelTransfer* t = new modelTransfer();
+
+		t->dir    = dir;
+		t->cmd    = cmd;
+		t->tar    = JSON_STR_DEFAULT(model["tar"], pathFilename(url.substr(0, url.find('?'))));
+		t->sha256 = JSON_STR(model["sha256"]);
+		t->key    = hashString(url);
+
+		t->partPath = pathJoin(cache, "partial/" + t->key);
+
+		if( mirror != NULL )
+			t->urls.push_back(std::string(mirror) + "/" + t->tar);
+
+		t->urls.push_back(url);
+
+		t->attempts    = 0;
+		t->maxAttempts = std::max(retries, 1U) * t->urls.size();
+		t->curl        = NULL;
+		t->file        = NULL;
+		t->offset      = 0;
+		t->done        = false;
+		t->installed   = false;
+
+		transfers.push_back(t);
+
+		const std::string archive = findCachedModel(t);
+
+		if( archive.length() > 0 )
+		{
+			LogVerbose(LOG_TRT "found %s in the cache\n", t->tar.c_str());
+
+			if( installCachedModel(t, archive) )
+			{
+				t->done = true;
+				continue;
+			}
+		}
+
+		queue.push_back(t);
+	}
+
+	// download the archives concurrently
+	CURLM* multi = (queue.size() > 0) ? curl_multi_init() : NULL;
+
+	uint32_t active = 0;
+	double lastProgress = timeDouble();
+
+	while( multi != NULL && (queue.size() > 0 || active > 0) )
+	{
+		while( active < std::max(maxJobs, 1U) && queue.size() > 0 )
+		{
+			modelTransfer* t = queue.front();
+			queue.pop_front();
+
+			if( beginTransfer(t) )
+			{
+				curl_multi_add_handle(multi, t->curl);
+				active++;
+			}
+			else if( !t->done && retryTransfer(t) )
+			{
+				queue.push_back(t);
+			}
+		}
+
+		int running = 0;
+		curl_multi_perform(multi, &running);
+
+		CURLMsg* msg = NULL;
+		int pending = 0;
+
+		while( (msg = curl_multi_info_read(multi, &pending)) != NULL )
+		{
+			if( msg->msg != CURLMSG_DONE )
+				continue;
+
+			CURL* curl = msg->easy_handle;
+			const CURLcode code = msg->data.result;
+
+			modelTransfer* t = NULL;
+			curl_easy_getinfo(curl, CURLINFO_PRIVATE, (char**)&t);
+			curl_multi_remove_handle(multi, curl);
+			active--;
+
+			if( !endTransfer(t, code) && retryTransfer(t) )
+				queue.push_back(t);
+		}
+
+		if( active > 0 )
+			curl_multi_wait(multi, NULL, 0, 500, NULL);
+
+		// periodically log the overall progress
+		const double time = timeDouble();
+
+		if( active > 0 && time - lastProgress > 5000.0 )
+		{
+			double received = 0;
+			double total = 0;
+
+			for( size_t n=0; n < transfers.size(); n++ )
+			{
+				modelTransfer* t = transfers[n];
+
+				if( t->done || !t->file || !t->curl )
+					continue;
+
+				curl_off_t bytes = 0;
+				curl_off_t length = 0;
+
+				curl_easy_getinfo(t->curl, CURLINFO_SIZE_DOWNLOAD_T, &bytes);
+				curl_easy_getinfo(t->curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length);
+
+				received += t->offset + bytes;
+				total += t->offset + std::max(length, bytes);
+			}
+
+			LogInfo(LOG_TRT "downloading %u models:  %.1f / %.1f MB\n", active, received / (1024.0 * 1024.0), total / (1024.0 * 1024.0));
+			lastProgress = time;
+		}
+	}
+
+	if( multi != NULL )
+		curl_multi_cleanup(multi);
+
+	// fall back to the model's command if it couldn't be downloaded
+	for( size_t n=0; n < transfers.size(); n++ )
+	{
+		modelTransfer* t = transfers[n];
+
+		if( !t->installed && (t->cmd.length() == 0 || !runModelCommand(t->cmd, t->dir)) )
+		{
+			LogError(LOG_TRT "failed to download model %s after %u attempts\n", t->tar.c_str(), t->attempts);
+			result = false;
+		}
+
+		closeTransfer(t);
+
+		if( t->curl != NULL )
+			curl_easy_cleanup(t->curl);
+
+		delete t;
+	}
+
+	if( !result )
+	{
+		LogInfo(LOG_TRT "if this error keeps occuring, see here for a mirror to download the models from:\n");
+		LogInfo(LOG_TRT "   https://github.com/dusty-nv/jetson-inference/releases\n");
+		LogInfo(LOG_TRT "and set $%s to the URL of the directory containing the archives\n", MODEL_DOWNLOADER_MIRROR_ENV);
+	}
+
+	return result;
+}
+
+
+// DownloadModels
+bool DownloadModels( const char* type, const std::vector<std::string>& names, uint32_t retries, uint32_t maxJobs )
+{
+	std::vector<nlohmann::json> models;
+	bool result = true;
+
+	for( size_t n=0; n < names.size(); n++ )
+	{
+		nlohmann::json model;
+
+		if( !FindModel(type, names[n].c_str(), model) )
+		{
+			LogError(LOG_TRT "couldn't find built-in %s model '%s'\n", type, names[n].c_str());
+			result = false;
+			continue;
+		}
+
+		models.push_back(model);
+	}
+
+	return DownloadModels(models, retries, maxJobs) && result;
+}
+
+
+// DownloadModel
+bool DownloadModel( nlohmann::json& model, uint32_t retries )
+{
+	std::vector<nlohmann::json> models(1, model);
+	return DownloadModels(models, retries, 1);
 }
 
 
@@ -26,9 +26,39 @@
 
 #include "json.hpp"
 
+#include <string>
+#include <vector>
+
+
+/**
+ * Default maximum number of models that DownloadModels() fetches at the same time.
+ * @ingroup modelDownloader
+ */
+#define MODEL_DOWNLOADER_DEFAULT_JOBS  4
+
+/**
+ * Environment variable that overrides the base URL the models are downloaded from.
+ * The archive's filename is appended to it, so a flat directory served over HTTP
+ * (or a `file://` path) containing the archives can replace the internet.
+ * @ingroup modelDownloader
+ */
+#define MODEL_DOWNLOADER_MIRROR_ENV  "JETSON_MODEL_MIRROR"
+
+/**
+ * Environment variable that overrides the location of the download cache (by default `networks/.cache`)
+ * @ingroup modelDownloader
+ */
+#define MODEL_DOWNLOADER_CACHE_ENV   "JETSON_MODEL_CACHE"
+
 
 /**
  * Download a pre-trained model given its JSON config.
+ *
+ * The archive is downloaded in-process into the content-addressed cache (resuming
+ * any partial download left from before), verified against the `sha256` of the
+ * model's config if it has one, and then extracted and atomically moved into the
+ * networks directory.  Models that are already installed aren't downloaded again.
+ *
  * @ingroup modelDownloader
  */
 bool DownloadModel( nlohmann::json& model, uint32_t retries=2 );
@@ -41,6 +71,54 @@ bool DownloadModel( nlohmann::json& model, uint32_t retries=2 );
 bool DownloadModel( const char* type, const char* name, nlohmann::json& model, uint32_t retries=2 );
 
 
+/**
+ * Download multiple pre-trained models concurrently, given their JSON configs.
+ * Each model is handled like DownloadModel(), while up to `maxJobs` archives are transferred at once.
+ * @returns true if all of the models were installed, otherwise false.
+ * @ingroup modelDownloader
+ */
+bool DownloadModels( std::vector<nlohmann::json>& models, uint32_t retries=2, uint32_t maxJobs=MODEL_DOWNLOADER_DEFAULT_JOBS );
+
+
+/**
+ * Download multiple pre-trained models of the same type concurrently (e.g. `DETECTNET_MODEL_TYPE`)
+ * @returns true if all of the models were found and installed, otherwise false.
+ * @ingroup modelDownloader
+ */
+bool DownloadModels( const char* type, const std::vector<std::string>& names, uint32_t retries=2, uint32_t maxJobs=MODEL_DOWNLOADER_DEFAULT_JOBS );
+
+
+/**
+ * Set the base URL of a mirror to download the models from, instead of their original URLs.
+ * The original URLs are still tried if the mirror fails.  Pass NULL to disable the mirror.
+ * By default, the mirror is set from the `$JETSON_MODEL_MIRROR` environment variable.
+ * @ingroup modelDownloader
+ */
+void SetModelMirror( const char* url );
+
+
+/**
+ * Get the base URL of the mirror that the models are downloaded from (or NULL if there isn't one).
+ * @ingroup modelDownloader
+ */
+const char* GetModelMirror();
+
+
+/**
+ * Set the directory that downloaded archives are cached in.
+ * By default this is `$JETSON_MODEL_CACHE`, or `.cache` under the networks directory.
+ * @ingroup modelDownloader
+ */
+void SetModelCache( const char* path );
+
+
+/**
+ * Get the directory that downloaded archives are cached in.
+ * @ingroup modelDownloader
+ */
+std::string GetModelCache();
+
+
 /**
  * Check if a model can be found in the model manifest.
  * @ingroup modelDownloader
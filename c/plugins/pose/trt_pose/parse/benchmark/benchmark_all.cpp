@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "../find_peaks.hpp"
+#include "../refine_peaks.hpp"
+#include "../paf_score_graph.hpp"
+#include "../munkres.hpp"
+#include "../connect_parts.hpp"
+#include "../parallel.hpp"
+
+using namespace trt_pose::parse;
+
+// COCO keypoints + neck (18 parts, 21 links), from tasks/human_pose/human_pose.json
+const int C = 18;
+const int K = 21;
+
+const int skeleton[K][2] = {
+  {16, 14}, {14, 12}, {17, 15}, {15, 13}, {12, 13}, {6, 8}, {7, 9},
+  {8, 10}, {9, 11}, {2, 3}, {1, 2}, {1, 3}, {2, 4}, {3, 5}, {4, 6},
+  {5, 7}, {18, 1}, {18, 6}, {18, 7}, {18, 12}, {18, 13}
+};
+
+// same defaults as ParseObjects (parse_objects.py)
+const int M = 100;
+const int P = 100;
+const float cmap_threshold = 0.1f;
+const float link_threshold = 0.1f;
+const int cmap_window = 5;
+const int refine_window = 5;
+const int num_integral_samples = 7;
+
+const int N = 1;
+const int iterations = 200;
+
+struct Scene
+{
+  Scene(int H, int W) : H(H), W(W), cmap(C * H * W, 0.f), paf(2 * K * H * W, 0.f) {}
+
+  int H;
+  int W;
+  std::vector<float> cmap; // CxHxW
+  std::vector<float> paf;  // 2KxHxW
+};
+
+float uniform(float min, float max)
+{
+  return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+
+// gaussian blob for each part, with the part affinity fields along each link
+Scene generate_scene(int H, int W, int people)
+{
+  Scene scene(H, W);
+
+  const float sigma = 1.0f;
+  const float paf_width = 1.0f;
+
+  for (int p = 0; p < people; p++)
+  {
+    // a rough skeleton at a random spot in the image
+    const float size = H / 4.0f;
+    const float ci = uniform(size, H - size);
+    const float cj = uniform(size * 0.5f, W - size * 0.5f);
+
+    float parts[C][2];
+
+    for (int c = 0; c < C; c++)
+    {
+      parts[c][0] = ci + uniform(-size, size);
+      parts[c][1] = cj + uniform(-size * 0.5f, size * 0.5f);
+
+      float *cmap_c = &scene.cmap[c * H * W];
+
+      for (int i = 0; i < H; i++)
+      {
+        for (int j = 0; j < W; j++)
+        {
+          const float di = i - parts[c][0];
+          const float dj = j - parts[c][1];
+          const float val = expf(-(di * di + dj * dj) / (2 * sigma * sigma));
+
+          if (val > cmap_c[i * W + j])
+            cmap_c[i * W + j] = val;
+        }
+      }
+    }
+
+    for (int k = 0; k < K; k++)
+    {
+      const float *a = parts[skeleton[k][0] - 1];
+      const float *b = parts[skeleton[k][1] - 1];
+
+      const float di = b[0] - a[0];
+      const float dj = b[1] - a[1];
+      const float len = sqrtf(di * di + dj * dj);
+
+      if (len < 1e-3f)
+        continue;
+
+      float *paf_i = &scene.paf[(2 * k) * H * W];
+      float *paf_j = &scene.paf[(2 * k + 1) * H * W];
+
+      for (int i = 0; i < H; i++)
+      {
+        for (int j = 0; j < W; j++)
+        {
+          // distance along and from the link
+          const float along = ((i - a[0]) * di + (j - a[1]) * dj) / len;
+          const float from = fabsf((i - a[0]) * dj - (j - a[1]) * di) / len;
+
+          if (along >= 0 && along <= len && from <= paf_width)
+          {
+            paf_i[i * W + j] = di / len;
+            paf_j[i * W + j] = dj / len;
+          }
+        }
+      }
+    }
+  }
+
+  return scene;
+}
+
+double now_ms()
+{
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// average time of each stage of the parse, in milliseconds
+void benchmark_parse(const Scene &scene, double times[6], int *num_objects)
+{
+  const int H = scene.H;
+  const int W = scene.W;
+
+  int topology[K * 4];
+
+  for (int k = 0; k < K; k++)
+  {
+    topology[k * 4 + 0] = 2 * k;
+    topology[k * 4 + 1] = 2 * k + 1;
+    topology[k * 4 + 2] = skeleton[k][0] - 1;
+    topology[k * 4 + 3] = skeleton[k][1] - 1;
+  }
+
+  std::vector<int> counts(N * C);
+  std::vector<int> peaks(N * C * M * 2);
+  std::vector<float> refined_peaks(N * C * M * 2);
+  std::vector<float> score_graph(N * K * M * M);
+  std::vector<int> connections(N * K * 2 * M);
+  std::vector<int> object_counts(N);
+  std::vector<int> objects(N * P * C);
+
+  std::vector<char> assignment_workspace(assignment_out_workspace(M));
+  std::vector<char> connect_workspace(connect_parts_out_workspace(C, M));
+
+  for (int n = 0; n < 6; n++)
+    times[n] = 0;
+
+  for (int iter = 0; iter < iterations; iter++)
+  {
+    const double t0 = now_ms();
+
+    find_peaks_out_nchw(counts.data(), peaks.data(), scene.cmap.data(), N, C, H,
+                        W, M, cmap_threshold, cmap_window);
+
+    const double t1 = now_ms();
+
+    refine_peaks_out_nchw(refined_peaks.data(), counts.data(), peaks.data(),
+                          scene.cmap.data(), N, C, H, W, M, refine_window);
+
+    const double t2 = now_ms();
+
+    paf_score_graph_out_nkhw(score_graph.data(), topology, scene.paf.data(),
+                             counts.data(), refined_peaks.data(), N, K, C, H, W,
+                             M, num_integral_samples);
+
+    const double t3 = now_ms();
+
+    std::fill(connections.begin(), connections.end(), -1);
+
+    assignment_out_nk(connections.data(), score_graph.data(), topology,
+                      counts.data(), N, C, K, M, link_threshold,
+                      assignment_workspace.data());
+
+    const double t4 = now_ms();
+
+    connect_parts_out_batch(object_counts.data(), objects.data(),
+                            connections.data(), topology, counts.data(), N, K,
+                            C, M, P, connect_workspace.data());
+
+    const double t5 = now_ms();
+
+    times[0] += t1 - t0;
+    times[1] += t2 - t1;
+    times[2] += t3 - t2;
+    times[3] += t4 - t3;
+    times[4] += t5 - t4;
+    times[5] += t5 - t0;
+  }
+
+  for (int n = 0; n < 6; n++)
+    times[n] /= iterations;
+
+  *num_objects = object_counts[0];
+}
+
+int main()
+{
+  const int sizes[] = { 56, 96 };
+  const int people[] = { 1, 4, 8 };
+
+  set_num_threads(0);
+  const int num_threads = get_num_threads();
+
+  printf("trt_pose parse benchmark (%d iterations, 1 thread vs %d threads)\n\n",
+         iterations, num_threads);
+  printf("%-7s %-6s %-8s %10s %10s %10s %10s %10s %10s\n", "size", "people",
+         "threads", "peaks", "refine", "paf", "munkres", "connect", "total");
+
+  for (int s = 0; s < 2; s++)
+  {
+    for (int p = 0; p < 3; p++)
+    {
+      srand(1234);
+      const Scene scene = generate_scene(sizes[s], sizes[s], people[p]);
+
+      const int threads[] = { 1, num_threads };
+
+      for (int t = 0; t < 2; t++)
+      {
+        double times[6];
+        int num_objects = 0;
+
+        set_num_threads(threads[t]);
+        benchmark_parse(scene, times, &num_objects);
+
+        printf("%3dx%-3d %-6d %-8d %8.3fms %8.3fms %8.3fms %8.3fms %8.3fms %8.3fms  (%d objects)\n",
+               sizes[s], sizes[s], people[p], threads[t], times[0], times[1],
+               times[2], times[3], times[4], times[5], num_objects);
+      }
+    }
+  }
+
+  return 0;
+}
@@ -1,5 +1,7 @@
 #include "connect_parts.hpp"
+#include "parallel.hpp"
 #include <queue>
+#include <vector>
 
 namespace trt_pose {
 namespace parse {
@@ -17,7 +19,7 @@ void connect_parts_out(int *object_counts,     // 1
                        void *workspace) {
 
   // initialize objects
-  for (int i = 0; i < C * M; i++) {
+  for (int i = 0; i < P * C; i++) {
     objects[i] = -1;
   }
 
@@ -94,11 +96,16 @@ void connect_parts_out_batch(int *object_counts,     // N
                              const int *counts,      // NxC
                              const int N, const int K, const int C, const int M,
                              const int P, void *workspace) {
-  for (int n = 0; n < N; n++) {
+  // the images are connected in parallel, so each thread uses a workspace of
+  // its own instead of the shared one that's passed in (kept for compatibility)
+  parallel_for(N, [&](int n) {
+    static thread_local std::vector<int> visited;
+    visited.resize(C * M);
+
     connect_parts_out(&object_counts[n], &objects[n * P * C],
                       &connections[n * K * 2 * M], topology, &counts[n * C], K,
-                      C, M, P, workspace);
-  }
+                      C, M, P, visited.data());
+  });
 }
 
 } // namespace parse
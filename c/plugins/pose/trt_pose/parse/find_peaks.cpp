@@ -1,4 +1,14 @@
 #include "find_peaks.hpp"
+#include "parallel.hpp"
+
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
@@ -6,40 +16,215 @@
 namespace trt_pose {
 namespace parse {
 
+// A pixel is a peak if nothing in the window around it is larger, which is the
+// same as the maximum of the window not being larger.  The window maximum is
+// separable, so it's found with a pass over the rows followed by one over the
+// columns, instead of scanning the whole window for every pixel.  Most of a
+// confidence map is below the threshold, so only the rows near a pixel that
+// isn't are looked at.
+//
+// The maximums skip NaN's (they're never larger than anything), so that the
+// peaks are exactly the same as comparing every pixel of the window.
+
+// larger of a window value and the running maximum (skipping NaN's)
+inline float window_max(const float value, const float max) {
+  return value > max ? value : max;
+}
+
+#if defined(__SSE2__)
+// _mm_max_ps() returns the second operand if either is NaN
+inline __m128 window_max(const __m128 value, const __m128 max) {
+  return _mm_max_ps(value, max);
+}
+#elif defined(__aarch64__)
+// vmaxnmq_f32() returns the operand that isn't NaN
+inline float32x4_t window_max(const float32x4_t value, const float32x4_t max) {
+  return vmaxnmq_f32(value, max);
+}
+#endif
+
+// maximum of the window around a pixel of a row (clipped to the row)
+inline float clipped_row_max(const float *row, const int j, const int W,
+                             const int win) {
+  float max = -INFINITY;
+  for (int jj = MAX(j - win, 0); jj < MIN(j + win + 1, W); jj++) {
+    max = window_max(row[jj], max);
+  }
+  return max;
+}
+
+// maximum of the window around each pixel of a row
+static void row_max(float *out, const float *row, const int W, const int win) {
+  int j = 0;
+
+  // left border
+  for (; j < win && j < W; j++) {
+    out[j] = clipped_row_max(row, j, W, win);
+  }
+
+  // interior, where the window is never clipped
+#if defined(__SSE2__)
+  for (; j + win + 4 <= W; j += 4) {
+    __m128 max = _mm_set1_ps(-INFINITY);
+    for (int jj = j - win; jj <= j + win; jj++) {
+      max = window_max(_mm_loadu_ps(row + jj), max);
+    }
+    _mm_storeu_ps(out + j, max);
+  }
+#elif defined(__aarch64__)
+  for (; j + win + 4 <= W; j += 4) {
+    float32x4_t max = vdupq_n_f32(-INFINITY);
+    for (int jj = j - win; jj <= j + win; jj++) {
+      max = window_max(vld1q_f32(row + jj), max);
+    }
+    vst1q_f32(out + j, max);
+  }
+#endif
+
+  // right border (and what's left over from the vectors)
+  for (; j < W; j++) {
+    out[j] = clipped_row_max(row, j, W, win);
+  }
+}
+
 void find_peaks_out_hw(int *counts,        // 1
                        int *peaks,         // Mx2
                        const float *input, // HxW
                        const int H, const int W, const int M,
                        const float threshold, const int window_size) {
-  int win = window_size / 2;
+  int win = MAX(window_size / 2, 0); // an empty window is the same as 1x1
   int count = 0;
 
+  if (M <= 0 || H <= 0 || W <= 0) {
+    *counts = 0;
+    return;
+  }
+
+  static thread_local std::vector<float> row_max_buffer;
+  static thread_local std::vector<char> row_flags;
+  row_max_buffer.resize(H * W);
+  row_flags.assign(H, 0);
+  float *row_max_map = row_max_buffer.data();
+
+  // rows with a pixel that isn't below the threshold
+  const char CANDIDATE = 1;
+  const char NEEDED = 2;
+
+  for (int i = 0; i < H; i++) {
+    const float *row = &input[i * W];
+    int j = 0;
+
+    while (j < W && row[j] < threshold) {
+      j++;
+    }
+
+    if (j < W) {
+      row_flags[i] |= CANDIDATE;
+
+      for (int ii = MAX(i - win, 0); ii < MIN(i + win + 1, H); ii++) {
+        row_flags[ii] |= NEEDED;
+      }
+    }
+  }
+
+  // maximum over the window of each row that a candidate's window covers
+  for (int i = 0; i < H; i++) {
+    if (row_flags[i] & NEEDED) {
+      row_max(&row_max_map[i * W], &input[i * W], W, win);
+    }
+  }
+
+  // maximum over the columns of those, compared against each candidate
   for (int i = 0; i < H && count < M; i++) {
-    for (int j = 0; j < W && count < M; j++) {
-      float val = input[i * W + j];
+    if (!(row_flags[i] & CANDIDATE)) {
+      continue;
+    }
+
+    const float *row = &input[i * W];
+    const float *ii_min = &row_max_map[MAX(i - win, 0) * W];
+    const float *ii_max = &row_max_map[MIN(i + win + 1, H) * W];
+    int j = 0;
+
+#if defined(__SSE2__)
+    const __m128 threshold4 = _mm_set1_ps(threshold);
+
+    for (; j + 4 <= W && count < M; j += 4) {
+      // a peak isn't below the threshold
+      const __m128 val = _mm_loadu_ps(row + j);
+      const __m128 above = _mm_cmpnlt_ps(val, threshold4);
+
+      if (!_mm_movemask_ps(above)) {
+        continue;
+      }
+
+      // and nothing in its window is larger
+      __m128 max = _mm_set1_ps(-INFINITY);
+      for (const float *ii = ii_min; ii < ii_max; ii += W) {
+        max = window_max(_mm_loadu_ps(ii + j), max);
+      }
+
+      const int mask =
+          _mm_movemask_ps(_mm_and_ps(above, _mm_cmpngt_ps(max, val)));
+
+      for (int n = 0; n < 4 && count < M; n++) {
+        if (mask & (1 << n)) {
+          peaks[count * 2] = i;
+          peaks[count * 2 + 1] = j + n;
+          count++;
+        }
+      }
+    }
+#elif defined(__aarch64__)
+    const float32x4_t threshold4 = vdupq_n_f32(threshold);
+
+    for (; j + 4 <= W && count < M; j += 4) {
+      // a peak isn't below the threshold
+      const float32x4_t val = vld1q_f32(row + j);
+      uint32x4_t below = vcltq_f32(val, threshold4);
+
+      if (vminvq_u32(below) != 0) {
+        continue;
+      }
+
+      // and nothing in its window is larger
+      float32x4_t max = vdupq_n_f32(-INFINITY);
+      for (const float *ii = ii_min; ii < ii_max; ii += W) {
+        max = window_max(vld1q_f32(ii + j), max);
+      }
+
+      below = vorrq_u32(below, vcgtq_f32(max, val));
+
+      if (vminvq_u32(below) != 0) {
+        continue;
+      }
+
+      uint32_t mask[4];
+      vst1q_u32(mask, below);
+
+      for (int n = 0; n < 4 && count < M; n++) {
+        if (!mask[n]) {
+          peaks[count * 2] = i;
+          peaks[count * 2 + 1] = j + n;
+          count++;
+        }
+      }
+    }
+#endif
+
+    for (; j < W && count < M; j++) {
+      float val = row[j];
 
       // skip if below threshold
       if (val < threshold)
         continue;
 
-      // compute window bounds
-      int ii_min = MAX(i - win, 0);
-      int jj_min = MAX(j - win, 0);
-      int ii_max = MIN(i + win + 1, H);
-      int jj_max = MIN(j + win + 1, W);
-
-      // search for larger value in window
-      bool is_peak = true;
-      for (int ii = ii_min; ii < ii_max; ii++) {
-        for (int jj = jj_min; jj < jj_max; jj++) {
-          if (input[ii * W + jj] > val) {
-            is_peak = false;
-          }
-        }
+      float max = -INFINITY;
+      for (const float *ii = ii_min; ii < ii_max; ii += W) {
+        max = window_max(ii[j], max);
       }
 
       // add peak
-      if (is_peak) {
+      if (!(max > val)) {
         peaks[count * 2] = i;
         peaks[count * 2 + 1] = j;
         count++;
@@ -55,13 +240,8 @@ void find_peaks_out_chw(int *counts,        // C
                         const float *input, // CxHxW
                         const int C, const int H, const int W, const int M,
                         const float threshold, const int window_size) {
-  for (int c = 0; c < C; c++) {
-    int *counts_c = &counts[c];
-    int *peaks_c = &peaks[c * M * 2];
-    const float *input_c = &input[c * H * W];
-    find_peaks_out_hw(counts_c, peaks_c, input_c, H, W, M, threshold,
+  find_peaks_out_nchw(counts, peaks, input, 1, C, H, W, M, threshold,
                       window_size);
-  }
 }
 
 void find_peaks_out_nchw(int *counts,        // C
@@ -70,13 +250,14 @@ void find_peaks_out_nchw(int *counts,        // C
                          const int N, const int C, const int H, const int W,
                          const int M, const float threshold,
                          const int window_size) {
-  for (int n = 0; n < N; n++) {
-    int *counts_n = &counts[n * C];
-    int *peaks_n = &peaks[n * C * M * 2];
-    const float *input_n = &input[n * C * H * W];
-    find_peaks_out_chw(counts_n, peaks_n, input_n, C, H, W, M, threshold,
-                       window_size);
-  }
+  // the channels of every image are independent
+  parallel_for(N * C, [&](int nc) {
+    int *counts_nc = &counts[nc];
+    int *peaks_nc = &peaks[nc * M * 2];
+    const float *input_nc = &input[nc * H * W];
+    find_peaks_out_hw(counts_nc, peaks_nc, input_nc, H, W, M, threshold,
+                      window_size);
+  });
 }
 
 } // namespace parse
@@ -1,7 +1,10 @@
 #include "munkres.hpp"
+#include "parallel.hpp"
 #include "utils/CoverTable.hpp"
 #include "utils/PairGraph.hpp"
 
+#include <vector>
+
 namespace trt_pose {
 namespace parse {
 
@@ -235,15 +238,8 @@ void assignment_out_k(int *connections,         // Kx2xM
                       const int *counts,        // C
                       const int K, const int M, const float score_threshold,
                       void *workspace) {
-  for (int k = 0; k < K; k++) {
-    const int *tk = &topology[k * 4];
-    const int cmap_idx_a = tk[2];
-    const int cmap_idx_b = tk[3];
-    const int count_a = counts[cmap_idx_a];
-    const int count_b = counts[cmap_idx_b];
-    assignment_out(&connections[k * 2 * M], &score_graph[k * M * M], count_a,
-                   count_b, M, score_threshold, workspace);
-  }
+  assignment_out_nk(connections, score_graph, topology, counts, 1, 0, K, M,
+                    score_threshold, workspace);
 }
 
 void assignment_out_nk(int *connections,         // NxKx2xM
@@ -252,11 +248,24 @@ void assignment_out_nk(int *connections,         // NxKx2xM
                        const int *counts,        // NxC
                        const int N, const int C, const int K, const int M,
                        const float score_threshold, void *workspace) {
-  for (int n = 0; n < N; n++) {
-    assignment_out_k(&connections[n * K * 2 * M], &score_graph[n * K * M * M],
-                     topology, &counts[n * C], K, M, score_threshold,
-                     workspace);
-  }
+  // the linkages of every image are independent.  they're assigned in
+  // parallel, so each thread uses a workspace of its own instead of the
+  // shared one that's passed in (which is kept for compatibility).
+  parallel_for(N * K, [&](int nk) {
+    const int n = nk / K;
+    const int k = nk % K;
+
+    static thread_local std::vector<float> cost_graph;
+    cost_graph.resize(M * M);
+
+    const int *tk = &topology[k * 4];
+    const int cmap_idx_a = tk[2];
+    const int cmap_idx_b = tk[3];
+    const int count_a = counts[n * C + cmap_idx_a];
+    const int count_b = counts[n * C + cmap_idx_b];
+    assignment_out(&connections[nk * 2 * M], &score_graph[nk * M * M], count_a,
+                   count_b, M, score_threshold, cost_graph.data());
+  });
 }
 
 } // namespace parse
@@ -1,4 +1,5 @@
 #include "paf_score_graph.hpp"
+#include "parallel.hpp"
 #include <cmath>
 
 #define EPS 1e-5
@@ -81,24 +82,8 @@ void paf_score_graph_out_khw(float *score_graph,  // KxMxM
                              const float *peaks,  // CxMx2
                              const int K, const int C, const int H, const int W,
                              const int M, const int num_integral_samples) {
-  for (int k = 0; k < K; k++) {
-    float *score_graph_k = &score_graph[k * M * M];
-    const int *tk = &topology[k * 4];
-    const int paf_i_idx = tk[0];
-    const int paf_j_idx = tk[1];
-    const int cmap_a_idx = tk[2];
-    const int cmap_b_idx = tk[3];
-    const float *paf_i = &paf[paf_i_idx * H * W];
-    const float *paf_j = &paf[paf_j_idx * H * W];
-
-    const int counts_a = counts[cmap_a_idx];
-    const int counts_b = counts[cmap_b_idx];
-    const float *peaks_a = &peaks[cmap_a_idx * M * 2];
-    const float *peaks_b = &peaks[cmap_b_idx * M * 2];
-
-    paf_score_graph_out_hw(score_graph_k, paf_i, paf_j, counts_a, counts_b,
-                           peaks_a, peaks_b, H, W, M, num_integral_samples);
-  }
+  paf_score_graph_out_nkhw(score_graph, topology, paf, counts, peaks, 1, K, C,
+                           H, W, M, num_integral_samples);
 }
 
 void paf_score_graph_out_nkhw(float *score_graph,  // NxKxMxM
@@ -109,12 +94,31 @@ void paf_score_graph_out_nkhw(float *score_graph,  // NxKxMxM
                               const int N, const int K, const int C,
                               const int H, const int W, const int M,
                               const int num_integral_samples) {
-  for (int n = 0; n < N; n++) {
-    paf_score_graph_out_khw(&score_graph[n * K * M * M], topology,
-                            &paf[n * 2 * K * H * W], &counts[n * C],
-                            &peaks[n * C * M * 2], K, C, H, W, M,
-                            num_integral_samples);
-  }
+  // the linkages of every image are independent
+  parallel_for(N * K, [&](int nk) {
+    const int n = nk / K;
+    const int k = nk % K;
+
+    float *score_graph_k = &score_graph[nk * M * M];
+    const int *tk = &topology[k * 4];
+    const int paf_i_idx = tk[0];
+    const int paf_j_idx = tk[1];
+    const int cmap_a_idx = tk[2];
+    const int cmap_b_idx = tk[3];
+    const float *paf_n = &paf[n * 2 * K * H * W];
+    const float *paf_i = &paf_n[paf_i_idx * H * W];
+    const float *paf_j = &paf_n[paf_j_idx * H * W];
+
+    const int *counts_n = &counts[n * C];
+    const int counts_a = counts_n[cmap_a_idx];
+    const int counts_b = counts_n[cmap_b_idx];
+    const float *peaks_n = &peaks[n * C * M * 2];
+    const float *peaks_a = &peaks_n[cmap_a_idx * M * 2];
+    const float *peaks_b = &peaks_n[cmap_b_idx * M * 2];
+
+    paf_score_graph_out_hw(score_graph_k, paf_i, paf_j, counts_a, counts_b,
+                           peaks_a, peaks_b, H, W, M, num_integral_samples);
+  });
 }
 
 } // namespace parse
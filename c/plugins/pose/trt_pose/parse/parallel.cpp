@@ -0,0 +1,39 @@
+#include "parallel.hpp"
+#include "utils/ThreadPool.hpp"
+
+namespace trt_pose {
+namespace parse {
+
+using namespace utils;
+
+static std::unique_ptr<ThreadPool> thread_pool;
+static std::mutex thread_pool_mutex;
+
+static ThreadPool &get_thread_pool() {
+  std::lock_guard<std::mutex> lock(thread_pool_mutex);
+
+  if (!thread_pool) {
+    const int num_cores = (int)std::thread::hardware_concurrency();
+    thread_pool.reset(new ThreadPool(num_cores > 1 ? num_cores - 1 : 0));
+  }
+
+  return *thread_pool;
+}
+
+void set_num_threads(const int num_threads) {
+  std::lock_guard<std::mutex> lock(thread_pool_mutex);
+  thread_pool.reset();
+
+  if (num_threads > 0) {
+    thread_pool.reset(new ThreadPool(num_threads - 1));
+  }
+}
+
+int get_num_threads() { return get_thread_pool().numWorkers() + 1; }
+
+void parallel_for(const int count, const std::function<void(int)> &fn) {
+  get_thread_pool().run(count, fn);
+}
+
+} // namespace parse
+} // namespace trt_pose
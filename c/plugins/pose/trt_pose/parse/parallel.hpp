@@ -0,0 +1,19 @@
+#pragma once
+
+#include <functional>
+
+namespace trt_pose {
+namespace parse {
+
+// sets the number of threads the parse functions run on, including the
+// calling thread (1 runs serially, 0 uses one thread per CPU core).
+// it shouldn't be changed while other threads are parsing.
+void set_num_threads(const int num_threads);
+
+int get_num_threads();
+
+// runs fn(0) ... fn(count - 1) in parallel, and returns once they've completed
+void parallel_for(const int count, const std::function<void(int)> &fn);
+
+} // namespace parse
+} // namespace trt_pose
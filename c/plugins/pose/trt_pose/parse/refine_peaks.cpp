@@ -1,4 +1,5 @@
 #include "refine_peaks.hpp"
+#include "parallel.hpp"
 
 namespace trt_pose {
 namespace parse {
@@ -58,11 +59,8 @@ void refine_peaks_out_chw(float *refined_peaks, // CxMx2
                           const int *peaks,     // CxMx2
                           const float *cmap, const int C, const int H,
                           const int W, const int M, const int window_size) {
-  for (int c = 0; c < C; c++) {
-    refine_peaks_out_hw(&refined_peaks[c * M * 2], &counts[c],
-                        &peaks[c * M * 2], &cmap[c * H * W], H, W, M,
+  refine_peaks_out_nchw(refined_peaks, counts, peaks, cmap, 1, C, H, W, M,
                         window_size);
-  }
 }
 
 void refine_peaks_out_nchw(float *refined_peaks, // NxCxMx2
@@ -71,11 +69,12 @@ void refine_peaks_out_nchw(float *refined_peaks, // NxCxMx2
                            const float *cmap, const int N, const int C,
                            const int H, const int W, const int M,
                            const int window_size) {
-  for (int n = 0; n < N; n++) {
-    refine_peaks_out_chw(&refined_peaks[n * C * M * 2], &counts[n * C],
-                         &peaks[n * C * M * 2], &cmap[n * C * H * W], C, H, W,
-                         M, window_size);
-  }
+  // the channels of every image are independent
+  parallel_for(N * C, [&](int nc) {
+    refine_peaks_out_hw(&refined_peaks[nc * M * 2], &counts[nc],
+                        &peaks[nc * M * 2], &cmap[nc * H * W], H, W, M,
+                        window_size);
+  });
 }
 
 } // namespace parse
@@ -1,8 +1,15 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <stdexcept>
+#include <vector>
 #include "paf_score_graph.hpp"
 #include "find_peaks.hpp"
 #include "refine_peaks.hpp"
 #include "munkres.hpp"
+#include "connect_parts.hpp"
+#include "parallel.hpp"
 
 #define ABS(x) ((x) > 0 ? (x) : (-x))
 
@@ -41,6 +48,96 @@ void test_find_peaks_out_hw()
   }
 }
 
+// scans the whole window of every pixel, to check the separable version against
+void reference_find_peaks_out_hw(int *counts, int *peaks, const float *input,
+                                 const int H, const int W, const int M,
+                                 const float threshold, const int window_size)
+{
+  int win = window_size / 2;
+  int count = 0;
+
+  for (int i = 0; i < H && count < M; i++) {
+    for (int j = 0; j < W && count < M; j++) {
+      float val = input[i * W + j];
+
+      if (val < threshold)
+        continue;
+
+      bool is_peak = true;
+      for (int ii = std::max(i - win, 0); ii < std::min(i + win + 1, H); ii++) {
+        for (int jj = std::max(j - win, 0); jj < std::min(j + win + 1, W); jj++) {
+          if (input[ii * W + jj] > val) {
+            is_peak = false;
+          }
+        }
+      }
+
+      if (is_peak) {
+        peaks[count * 2] = i;
+        peaks[count * 2 + 1] = j;
+        count++;
+      }
+    }
+  }
+
+  *counts = count;
+}
+
+void test_find_peaks_out_nchw_reference()
+{
+  const int N = 2;
+  const int C = 3;
+  const int sizes[][2] = { {1, 1}, {1, 9}, {7, 1}, {4, 4}, {5, 13}, {56, 56}, {96, 96} };
+  const int window_sizes[] = { 1, 3, 5, 7 };
+  const int max_counts[] = { 3, 100 };
+  const int num_threads[] = { 1, 4 };
+  const float threshold = 0.5;
+
+  srand(0);
+
+  for (auto size : sizes) {
+    const int H = size[0];
+    const int W = size[1];
+
+    // coarse random values, so there's plenty of plateaus, with a few NaN's
+    std::vector<float> input(N * C * H * W);
+    for (size_t n = 0; n < input.size(); n++) {
+      input[n] = (rand() % 8) / 7.0f;
+      if (rand() % 50 == 0) {
+        input[n] = NAN;
+      }
+    }
+
+    for (int window_size : window_sizes) {
+      for (int M : max_counts) {
+        std::vector<int> counts_true(N * C);
+        std::vector<int> peaks_true(N * C * M * 2, 0);
+
+        for (int nc = 0; nc < N * C; nc++) {
+          reference_find_peaks_out_hw(&counts_true[nc], &peaks_true[nc * M * 2],
+                                      &input[nc * H * W], H, W, M, threshold,
+                                      window_size);
+        }
+
+        for (int threads : num_threads) {
+          std::vector<int> counts(N * C);
+          std::vector<int> peaks(N * C * M * 2, 0);
+
+          set_num_threads(threads);
+          find_peaks_out_nchw(counts.data(), peaks.data(), input.data(), N, C,
+                              H, W, M, threshold, window_size);
+
+          if (counts != counts_true || peaks != peaks_true) {
+            throw std::runtime_error("Peaks should match the full window search.");
+          }
+        }
+      }
+    }
+  }
+
+  set_num_threads(0);
+}
+
 void test_refined_peaks_out_hw()
 {
   const int H = 4;
@@ -159,12 +256,94 @@ void test_assignment_out()
   free(workspace);
 }
 
+// runs the whole parse of random maps
+void parse_objects(std::vector<int> &object_counts, std::vector<int> &objects,
+                   std::vector<float> &refined_peaks,
+                   const std::vector<float> &cmap, const std::vector<float> &paf,
+                   const int *topology, const int N, const int C, const int K,
+                   const int H, const int W, const int M, const int P)
+{
+  std::vector<int> counts(N * C);
+  std::vector<int> peaks(N * C * M * 2);
+  std::vector<float> score_graph(N * K * M * M);
+  std::vector<int> connections(N * K * 2 * M, -1);
+  std::vector<char> assignment_workspace(assignment_out_workspace(M));
+  std::vector<char> connect_workspace(connect_parts_out_workspace(C, M));
+
+  object_counts.assign(N, 0);
+  objects.assign(N * P * C, 0);
+  refined_peaks.assign(N * C * M * 2, 0);
+
+  find_peaks_out_nchw(counts.data(), peaks.data(), cmap.data(), N, C, H, W, M, 0.3, 3);
+  refine_peaks_out_nchw(refined_peaks.data(), counts.data(), peaks.data(), cmap.data(), N, C, H, W, M, 3);
+  paf_score_graph_out_nkhw(score_graph.data(), topology, paf.data(), counts.data(), refined_peaks.data(), N, K, C, H, W, M, 7);
+  assignment_out_nk(connections.data(), score_graph.data(), topology, counts.data(), N, C, K, M, 0.1, assignment_workspace.data());
+  connect_parts_out_batch(object_counts.data(), objects.data(), connections.data(), topology, counts.data(), N, K, C, M, P, connect_workspace.data());
+}
+
+void test_parse_threads()
+{
+  const int N = 4;
+  const int C = 5;
+  const int K = 4;
+  const int H = 24;
+  const int W = 20;
+  const int M = 16;
+  const int P = 8;
+
+  // chain of parts
+  const int topology[K * 4] = {
+    0, 1, 0, 1,
+    2, 3, 1, 2,
+    4, 5, 2, 3,
+    6, 7, 3, 4
+  };
+
+  srand(1);
+
+  std::vector<float> cmap(N * C * H * W);
+  std::vector<float> paf(N * 2 * K * H * W);
+
+  for (size_t n = 0; n < cmap.size(); n++) {
+    cmap[n] = rand() / (float)RAND_MAX;
+  }
+  for (size_t n = 0; n < paf.size(); n++) {
+    paf[n] = 2.0f * rand() / (float)RAND_MAX - 1.0f;
+  }
+
+  std::vector<int> object_counts_true, objects_true;
+  std::vector<float> refined_peaks_true;
+
+  set_num_threads(1);
+  parse_objects(object_counts_true, objects_true, refined_peaks_true, cmap, paf,
+                topology, N, C, K, H, W, M, P);
+
+  std::vector<int> object_counts, objects;
+  std::vector<float> refined_peaks;
+
+  set_num_threads(4);
+  parse_objects(object_counts, objects, refined_peaks, cmap, paf, topology, N,
+                C, K, H, W, M, P);
+
+  set_num_threads(0);
+
+  if (object_counts != object_counts_true || objects != objects_true) {
+    throw std::runtime_error("Objects should be the same when run in parallel.");
+  }
+  if (std::memcmp(refined_peaks.data(), refined_peaks_true.data(),
+                  refined_peaks.size() * sizeof(float)) != 0) {
+    throw std::runtime_error("Refined peaks should be the same when run in parallel.");
+  }
+}
+
 
 int main()
 {
   test_find_peaks_out_hw();
+  test_find_peaks_out_nchw_reference();
   test_refined_peaks_out_hw();
   test_paf_score_graph_hw();
   test_assignment_out();
+  test_parse_threads();
   return 0;
 }
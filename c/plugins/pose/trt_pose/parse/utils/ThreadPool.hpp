@@ -0,0 +1,227 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace trt_pose {
+namespace parse {
+namespace utils {
+
+/**
+ * Work-stealing thread pool that runs the iterations of parallel loops.
+ *
+ * Each worker has its own queue that it takes tasks from the front of, and
+ * when that runs out it steals from the back of the other queues.  The thread
+ * that calls run() works on the loop too, so a pool with 0 workers runs the
+ * loop serially, and nested loops can't deadlock.
+ */
+class ThreadPool
+{
+public:
+
+  ThreadPool(int num_workers) : stop(false), pending(0)
+  {
+    for (int i = 0; i < num_workers; i++)
+    {
+      queues.push_back(std::unique_ptr<Queue>(new Queue()));
+    }
+    for (int i = 0; i < num_workers; i++)
+    {
+      threads.push_back(std::thread(&ThreadPool::worker, this, i));
+    }
+  }
+
+  ~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stop = true;
+    }
+    wake.notify_all();
+
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+      threads[i].join();
+    }
+  }
+
+  inline int numWorkers() const
+  {
+    return (int)threads.size();
+  }
+
+  /**
+   * Runs fn(0) ... fn(count - 1) and returns when all of them have completed
+   */
+  void run(int count, const std::function<void(int)> &fn)
+  {
+    const int num_workers = numWorkers();
+
+    if (num_workers == 0 || count <= 1)
+    {
+      for (int i = 0; i < count; i++)
+      {
+        fn(i);
+      }
+      return;
+    }
+
+    Job job(fn, count);
+
+    // give each worker a contiguous block of the iterations
+    for (int w = 0; w < num_workers; w++)
+    {
+      const int begin = (int)((long)count * w / num_workers);
+      const int end = (int)((long)count * (w + 1) / num_workers);
+
+      if (begin == end)
+      {
+        continue;
+      }
+
+      Queue &queue = *queues[w];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+
+      for (int i = begin; i < end; i++)
+      {
+        queue.tasks.push_back(Task(&job, i));
+      }
+    }
+
+    pending += count;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+    }
+    wake.notify_all();
+
+    // help out until there's nothing left to take, then wait for the rest
+    Task task;
+
+    while (job.remaining > 0 && steal(-1, task))
+    {
+      execute(task);
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&job] { return job.remaining == 0; });
+  }
+
+private:
+
+  struct Job
+  {
+    Job(const std::function<void(int)> &fn, int count) : fn(fn), remaining(count) {}
+
+    const std::function<void(int)> &fn;
+    std::atomic<int> remaining;
+  };
+
+  struct Task
+  {
+    Task() : job(NULL), index(0) {}
+    Task(Job *job, int index) : job(job), index(index) {}
+
+    Job *job;
+    int index;
+  };
+
+  struct Queue
+  {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  bool pop(int w, Task &task)
+  {
+    Queue &queue = *queues[w];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+
+    if (queue.tasks.empty())
+    {
+      return false;
+    }
+
+    task = queue.tasks.front();
+    queue.tasks.pop_front();
+    pending--;
+    return true;
+  }
+
+  bool steal(int thief, Task &task)
+  {
+    const int num_queues = (int)queues.size();
+
+    for (int n = 1; n <= num_queues; n++)
+    {
+      Queue &queue = *queues[(thief + n + num_queues) % num_queues];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+
+      if (!queue.tasks.empty())
+      {
+        task = queue.tasks.back();
+        queue.tasks.pop_back();
+        pending--;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  void execute(Task &task)
+  {
+    Job *job = task.job;
+    job->fn(task.index);
+
+    if (--job->remaining == 0)
+    {
+      // the job lives on the stack of the thread waiting for it,
+      // so it mustn't be touched once the count reaches zero
+      std::lock_guard<std::mutex> lock(mutex);
+      done.notify_all();
+    }
+  }
+
+  void worker(int w)
+  {
+    Task task;
+
+    while (true)
+    {
+      if (pop(w, task) || steal(w, task))
+      {
+        execute(task);
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [this] { return stop || pending > 0; });
+
+      if (stop)
+      {
+        return;
+      }
+    }
+  }
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> threads;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+
+  bool stop;
+  std::atomic<int> pending;
+};
+
+} // namespace utils
+} // namespace parse
+} // namespace trt_pose
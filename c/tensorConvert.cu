@@ -256,3 +256,82 @@ cudaError_t cudaTensorNormMeanBGR( void* input, imageFormat format, size_t input
 }
 
 
+// gpuTensorNormMeanROI
+template<typename T, bool isBGR>
+__global__ void gpuTensorNormMeanROI( T* input, int iWidth, const int4* rois, float* output, int oWidth, int oHeight, float multiplier, float min_value, const float3 mean, const float3 stdDev )
+{
+	const int x = blockIdx.x * blockDim.x + threadIdx.x;
+	const int y = blockIdx.y * blockDim.y + threadIdx.y;
+
+	if( x >= oWidth || y >= oHeight )
+		return;
+
+	// each ROI is a slice of the grid, and a tensor of the batch
+	const int4 roi = rois[blockIdx.z];
+
+	const float2 scale = make_float2( float(roi.z - roi.x) / float(oWidth),
+							    float(roi.w - roi.y) / float(oHeight) );
+
+	const int n  = oWidth * oHeight;
+	const int m  = y * oWidth + x;
+	const int dx = roi.x + int((float)x * scale.x);
+	const int dy = roi.y + int((float)y * scale.y);
+
+	const T px = input[ dy * iWidth + dx ];
+
+	const float3 rgb = isBGR ? make_float3(px.z, px.y, px.x)
+						: make_float3(px.x, px.y, px.z);
+	
+	float* tensor = output + blockIdx.z * n * 3;
+
+	tensor[n * 0 + m] = ((rgb.x * multiplier + min_value) - mean.x) / stdDev.x;
+	tensor[n * 1 + m] = ((rgb.y * multiplier + min_value) - mean.y) / stdDev.y;
+	tensor[n * 2 + m] = ((rgb.z * multiplier + min_value) - mean.z) / stdDev.z;
+}
+
+template<bool isBGR>
+cudaError_t launchTensorNormMeanROI( void* input, imageFormat format, size_t inputWidth, size_t inputHeight,
+							  const int4* rois, uint32_t numROIs, float* output, size_t outputWidth, size_t outputHeight, 
+							  const float2& range, const float3& mean, const float3& stdDev, cudaStream_t stream )
+{
+	if( !input || !output || !rois )
+		return cudaErrorInvalidDevicePointer;
+
+	if( inputWidth == 0 || outputWidth == 0 || inputHeight == 0 || outputHeight == 0 || numROIs == 0 || numROIs > 65535 )
+		return cudaErrorInvalidValue;
+
+	const float multiplier = (range.y - range.x) / 255.0f;
+	
+	// launch kernel
+	const dim3 blockDim(8, 8);
+	const dim3 gridDim(iDivUp(outputWidth,blockDim.x), iDivUp(outputHeight,blockDim.y), numROIs);
+
+	if( format == IMAGE_RGB8 )
+		gpuTensorNormMeanROI<uchar3, isBGR><<<gridDim, blockDim, 0, stream>>>((uchar3*)input, inputWidth, rois, output, outputWidth, outputHeight, multiplier, range.x, mean, stdDev);
+	else if( format == IMAGE_RGBA8 )
+		gpuTensorNormMeanROI<uchar4, isBGR><<<gridDim, blockDim, 0, stream>>>((uchar4*)input, inputWidth, rois, output, outputWidth, outputHeight, multiplier, range.x, mean, stdDev);
+	else if( format == IMAGE_RGB32F )
+		gpuTensorNormMeanROI<float3, isBGR><<<gridDim, blockDim, 0, stream>>>((float3*)input, inputWidth, rois, output, outputWidth, outputHeight, multiplier, range.x, mean, stdDev);
+	else if( format == IMAGE_RGBA32F )
+		gpuTensorNormMeanROI<float4, isBGR><<<gridDim, blockDim, 0, stream>>>((float4*)input, inputWidth, rois, output, outputWidth, outputHeight, multiplier, range.x, mean, stdDev);
+	else
+		return cudaErrorInvalidValue;
+
+	return CUDA(cudaGetLastError());
+}
+
+// cudaTensorNormMeanRGB
+cudaError_t cudaTensorNormMeanRGB( void* input, imageFormat format, size_t inputWidth, size_t inputHeight,
+						     const int4* rois, uint32_t numROIs, float* output, size_t outputWidth, size_t outputHeight, 
+						     const float2& range, const float3& mean, const float3& stdDev, cudaStream_t stream )
+{
+	return launchTensorNormMeanROI<false>(input, format, inputWidth, inputHeight, rois, numROIs, output, outputWidth, outputHeight, range, mean, stdDev, stream);
+}
+
+// cudaTensorNormMeanBGR
+cudaError_t cudaTensorNormMeanBGR( void* input, imageFormat format, size_t inputWidth, size_t inputHeight,
+						     const int4* rois, uint32_t numROIs, float* output, size_t outputWidth, size_t outputHeight, 
+						     const float2& range, const float3& mean, const float3& stdDev, cudaStream_t stream )
+{
+	return launchTensorNormMeanROI<true>(input, format, inputWidth, inputHeight, rois, numROIs, output, outputWidth, outputHeight, range, mean, stdDev, stream);
+}
@@ -46,6 +46,14 @@ cudaError_t cudaTensorNormBGR( void* input, imageFormat format, size_t inputWidt
 cudaError_t cudaTensorNormMeanRGB( void* input, imageFormat format, size_t inputWidth, size_t inputHeight, float* output, size_t outputWidth, size_t outputHeight, const float2& range, const float3& mean, const float3& stdDev, cudaStream_t stream, size_t channelStride=0 );
 cudaError_t cudaTensorNormMeanBGR( void* input, imageFormat format, size_t inputWidth, size_t inputHeight, float* output, size_t outputWidth, size_t outputHeight, const float2& range, const float3& mean, const float3& stdDev, cudaStream_t stream, size_t channelStride=0 );
 
+/*
+ * Crop a batch of regions of interest (left, top, right, bottom) from the same image, downsample them and
+ * apply pixel normalization, mean pixel subtraction and standard deviation, into consecutive NCHW tensors.
+ * The ROI's should be inside the image, and accessible from the GPU (i.e. in mapped memory).
+ */
+cudaError_t cudaTensorNormMeanRGB( void* input, imageFormat format, size_t inputWidth, size_t inputHeight, const int4* rois, uint32_t numROIs, float* output, size_t outputWidth, size_t outputHeight, const float2& range, const float3& mean, const float3& stdDev, cudaStream_t stream );
+cudaError_t cudaTensorNormMeanBGR( void* input, imageFormat format, size_t inputWidth, size_t inputHeight, const int4* rois, uint32_t numROIs, float* output, size_t outputWidth, size_t outputHeight, const float2& range, const float3& mean, const float3& stdDev, cudaStream_t stream );
+
 
 #endif
 
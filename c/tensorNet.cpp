@@ -21,6 +21,8 @@
  */
  
 #include "tensorNet.h"
+#include "timingCache.h"
+#include "engineSwapper.h"
 #include "randInt8Calibrator.h"
 #include "cudaMappedMemory.h"
 #include "cudaResize.h"
@@ -36,10 +38,14 @@
 #include "NvInferPlugin.h"
 #endif
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <map>
 
+#include <glob.h>
+#include <unistd.h>
+
 #include <valgrind/valgrind.h>
 #include <valgrind/memcheck.h>
 
@@ -366,6 +372,7 @@ tensorNet::tensorNet()
 	mContext  = NULL;
 	mStream   = NULL;
 	mBindings	= NULL;
+	mSwapper  = NULL;
 
 	mMaxBatchSize   = 0;	
 	mEnableDebug    = false;
@@ -375,6 +382,7 @@ tensorNet::tensorNet()
 	mPrecision 	   = TYPE_FASTEST;
 	mDevice    	   = DEVICE_GPU;
 	mAllowGPUFallback = false;
+	mFallbackEngine   = false;
 
 	mProfilerQueriesUsed = 0;
 	mProfilerQueriesDone = 0;
@@ -394,6 +402,58 @@ tensorNet::tensorNet()
 // Destructor
 tensorNet::~tensorNet()
 {
+	// this waits for an engine that's being built in the background
+	if( mSwapper != NULL )
+	{
+		delete mSwapper;
+		mSwapper = NULL;
+	}
+
+	ReleaseEngine();
+}
+
+
+// engineBindings
+static int engineBindings( nvinfer1::ICudaEngine* engine )
+{
+#if NV_TENSORRT_MAJOR >= 10
+	return engine->getNbIOTensors();
+#else
+	return engine->getNbBindings();
+#endif
+}
+
+
+// freeUnusedBindings
+static void freeUnusedBindings( nvinfer1::ICudaEngine* engine, void** bindings, const std::vector<void*>& layers )
+{
+	const int numBindings = engineBindings(engine);
+
+	for( int n=0; n < numBindings; n++ )
+	{
+		if( std::find(layers.begin(), layers.end(), bindings[n]) == layers.end() )
+			CUDA_FREE(bindings[n]);
+	}
+}
+
+
+// ReleaseEngine
+void tensorNet::ReleaseEngine()
+{
+	// free the bindings that aren't input or output layers
+	if( mBindings != NULL && mEngine != NULL )
+	{
+		std::vector<void*> layers;
+
+		for( size_t n=0; n < mInputs.size(); n++ )
+			layers.push_back(mInputs[n].CUDA);
+
+		for( size_t n=0; n < mOutputs.size(); n++ )
+			layers.push_back(mOutputs[n].CUDA);
+
+		freeUnusedBindings(mEngine, mBindings, layers);
+	}
+
 	if( mContext != NULL )
 	{
 		TRT_DESTROY(mContext);
@@ -430,7 +490,11 @@ tensorNet::~tensorNet()
 	#endif
 	}
 	
+	mInputs.clear();
+	mOutputs.clear();
+
 	free(mBindings);
+	mBindings = NULL;
 }
 
 
@@ -776,25 +840,14 @@ bool tensorNet::ProfileModel(const std::string& deployFile,			   // name for caf
 		return false;
 	}
 	
-	// attempt to load the timing cache
-	const nvinfer1::ITimingCache* timingCache = NULL;
+	// attempt to load the timing cache (which is kept for each GPU and version of TensorRT)
+	nvinfer1::ITimingCache* timingCache = NULL;
 	
-	char timingCachePath[PATH_MAX];
-	sprintf(timingCachePath, "/usr/local/bin/networks/tensorrt.%i.timingcache", NV_TENSORRT_VERSION);
+	const std::string timingCachePath = GetTimingCachePath();
+	std::vector<char> timingCacheData;
 
-	if( fileExists(timingCachePath) )
-	{
-		LogInfo(LOG_TRT "loading timing cache from %s\n", timingCachePath);
-		
-		void* timingCacheBuffer = NULL;
-		const size_t timingCacheSize = loadFile(timingCachePath, &timingCacheBuffer);
-		
-		if( timingCacheSize > 0 )
-		{
-			timingCache = builderConfig->createTimingCache(timingCacheBuffer, timingCacheSize);
-			free(timingCacheBuffer);
-		}
-	}
+	if( LoadTimingCache(timingCachePath, timingCacheData) )
+		timingCache = builderConfig->createTimingCache(timingCacheData.data(), timingCacheData.size());
 	
 	if( !timingCache )
 	{
@@ -841,34 +894,32 @@ bool tensorNet::ProfileModel(const std::string& deployFile,			   // name for caf
 #if NV_TENSORRT_MAJOR >= 8
 	if( timingCache != NULL )
 	{
-		// save the updated timing cache
-		nvinfer1::IHostMemory* timingCacheMem = timingCache->serialize();
-		
-		if( timingCacheMem != NULL )
+		// merge the updated timing cache with any timings that other builds saved in the meantime
+		SaveTimingCache(timingCachePath, [builderConfig, timingCache](const std::vector<char>& current, std::vector<char>& merged)
 		{
-			const char* timingCacheBuffer = (char*)timingCacheMem->data();
-			const size_t timingCacheSize = timingCacheMem->size();
-		
-			LogVerbose(LOG_TRT "saving timing cache to %s (%zu bytes)\n", timingCachePath, timingCacheSize);
-			
-			// write the cache file
-			FILE* timingCacheFile = NULL;
-			timingCacheFile = fopen(timingCachePath, "wb");
-
-			if( timingCacheFile != NULL )
-			{
-				if( fwrite(timingCacheBuffer,	1, timingCacheSize, timingCacheFile) != timingCacheSize )
-					LogWarning(LOG_TRT "failed to write %zu bytes to timing cache file %s\n", timingCacheSize, timingCachePath);
-			
-				fclose(timingCacheFile);
-			}
-			else
+			if( current.size() > 0 )
 			{
-				LogWarning(LOG_TRT "failed to open timing cache file for writing %s\n", timingCachePath);
+				nvinfer1::ITimingCache* currentCache = builderConfig->createTimingCache(current.data(), current.size());
+				
+				if( currentCache != NULL )
+				{
+					if( !timingCache->combine(*currentCache, true) )
+						LogWarning(LOG_TRT "failed to combine timing caches\n");
+				
+					delete currentCache;
+				}
 			}
 			
+			nvinfer1::IHostMemory* timingCacheMem = timingCache->serialize();
+		
+			if( !timingCacheMem )
+				return false;
+			
+			merged.assign((const char*)timingCacheMem->data(), (const char*)timingCacheMem->data() + timingCacheMem->size());
 			TRT_DESTROY(timingCacheMem);
-		}
+			
+			return true;
+		});
 	
 		delete timingCache;
 	}
@@ -923,6 +974,64 @@ bool tensorNet::ProfileModel(const std::string& deployFile,			   // name for caf
 }
 
 
+// BuildEngine
+bool tensorNet::BuildEngine( const std::string& prototxt_path, const std::string& model_path,
+					    const std::vector<std::string>& input_blobs, const std::vector<Dims3>& input_dims,
+					    const std::vector<std::string>& output_blobs, uint32_t maxBatchSize, 
+					    precisionType precision, deviceType device, bool allowGPUFallback,
+					    nvinfer1::IInt8Calibrator* calibrator, const std::string& cache_path,
+					    char** engineStream, size_t* engineSize )
+{
+	// parse the model and profile the engine
+	if( !ProfileModel(prototxt_path, model_path, input_blobs, input_dims,
+				   output_blobs, maxBatchSize, precision, device, 
+				   allowGPUFallback, calibrator, engineStream, engineSize) )
+	{
+		return false;
+	}
+
+	LogVerbose(LOG_TRT "network profiling complete, saving engine cache to %s\n", cache_path.c_str());
+	
+	// write the cache file (to a temporary file first, so that it's never loaded half-written)
+	const std::string tmp_path = cache_path + ".tmp" + std::to_string(getpid());
+	FILE* cacheFile = fopen(tmp_path.c_str(), "wb");
+
+	if( cacheFile != NULL )
+	{
+		const bool written = (fwrite(*engineStream, 1, *engineSize, cacheFile) == *engineSize);
+
+		if( fclose(cacheFile) != 0 || !written || rename(tmp_path.c_str(), cache_path.c_str()) != 0 )
+		{
+			LogError(LOG_TRT "failed to write %zu bytes to engine cache file %s\n", *engineSize, cache_path.c_str());
+			unlink(tmp_path.c_str());
+		}
+		else
+		{
+			LogSuccess(LOG_TRT "device %s, completed saving engine cache to %s\n", deviceTypeToStr(device), cache_path.c_str());
+		}
+	}
+	else
+	{
+		LogError(LOG_TRT "failed to open engine cache file for writing %s\n", cache_path.c_str());
+	}
+
+	// write the checksum file
+	LogVerbose(LOG_TRT "saving model checksum to %s\n", mChecksumPath.c_str());
+	
+	char cmd[PATH_MAX * 2 + 256];
+	snprintf(cmd, sizeof(cmd), "%s %s | awk '{print $1}' > %s", CHECKSUM_TYPE, model_path.c_str(), mChecksumPath.c_str());
+
+	LogVerbose(LOG_TRT "%s\n", cmd);
+
+	const int result = system(cmd);
+	
+	if( result != 0 )
+		LogError(LOG_TRT "failed to save model checksum to %s\n", mChecksumPath.c_str());
+
+	return true;
+}
+
+
 // ConfigureBuilder
 #if NV_TENSORRT_MAJOR >= 8
 bool tensorNet::ConfigureBuilder( nvinfer1::IBuilder* builder, nvinfer1::IBuilderConfig* config,  
@@ -1278,47 +1387,71 @@ bool tensorNet::LoadNetwork( const char* prototxt_path_, const char* model_path_
 			return 0;
 		}
 
-		// parse the model and profile the engine
-		if( !ProfileModel(prototxt_path, model_path, input_blobs, input_dims,
-					   output_blobs, maxBatchSize, precision, device, 
-					   allowGPUFallback, calibrator, &engineStream, &engineSize) )
+	#if NV_TENSORRT_MAJOR >= 8
+		// run a fallback engine while the engine gets built in the background
+		if( GetBackgroundEngineBuild() && LoadFallbackEngine(model_path_, model_path, input_blobs, output_blobs, maxBatchSize, device, stream) )
 		{
-			LogError(LOG_TRT "device %s, failed to load %s\n", deviceTypeToStr(device), model_path_);
-			return 0;
-		}
-	
-		LogVerbose(LOG_TRT "network profiling complete, saving engine cache to %s\n", cache_path);
-		
-		// write the cache file
-		FILE* cacheFile = NULL;
-		cacheFile = fopen(cache_path, "wb");
+			const std::string cachePath = cache_path;
+			
+			int cudaDevice = 0;
+			CUDA(cudaGetDevice(&cudaDevice));
+			
+			LogInfo(LOG_TRT "device %s, building CUDA engine for %s in the background\n", deviceTypeToStr(device), model_path.c_str());
 
-		if( cacheFile != NULL )
-		{
-			if( fwrite(engineStream,	1, engineSize, cacheFile) != engineSize )
-				LogError(LOG_TRT "failed to write %zu bytes to engine cache file %s\n", engineSize, cache_path);
-		
-			fclose(cacheFile);
+			mSwapper = new engineSwapper();
+			
+			mSwapper->Start([=]() -> void*
+			{
+				CUDA(cudaSetDevice(cudaDevice));
+				
+				char* plan = NULL;
+				size_t planSize = 0;
+				
+				if( !BuildEngine(prototxt_path, model_path, input_blobs, input_dims, output_blobs, maxBatchSize, 
+							  precision, device, allowGPUFallback, calibrator, cachePath, &plan, &planSize) )
+				{
+					LogError(LOG_TRT "device %s, failed to build %s in the background (continuing with the fallback engine)\n", deviceTypeToStr(device), model_path.c_str());
+					return NULL;
+				}
+				
+				engineInstance* instance = new engineInstance();
+				
+				instance->precision = precision;
+				instance->engine = DeserializeEngine(plan, planSize, NULL, device, &instance->infer);
+				instance->context = (instance->engine != NULL) ? CreateContext(instance->engine, device) : NULL;
+				
+				free(plan);
+				
+				if( !instance->context )
+				{
+					ReleaseInstance(instance);
+					return NULL;
+				}
+				
+				return instance;
+			},
+			[](void* instance) { ReleaseInstance((engineInstance*)instance); });
+			
+			mPrototxtPath     = prototxt_path;
+			mModelPath        = model_path;
+			mModelFile        = pathFilename(mModelPath);
+			mAllowGPUFallback = allowGPUFallback;
+
+			if( mean_path != NULL )
+				mMeanPath = mean_path;
+			
+			return true;
 		}
-		else
+	#endif
+	
+		// parse the model and profile the engine
+		if( !BuildEngine(prototxt_path, model_path, input_blobs, input_dims,
+					  output_blobs, maxBatchSize, precision, device, 
+					  allowGPUFallback, calibrator, cache_path, &engineStream, &engineSize) )
 		{
-			LogError(LOG_TRT "failed to open engine cache file for writing %s\n", cache_path);
+			LogError(LOG_TRT "device %s, failed to load %s\n", deviceTypeToStr(device), model_path_);
+			return 0;
 		}
-
-		LogSuccess(LOG_TRT "device %s, completed saving engine cache to %s\n", deviceTypeToStr(device), cache_path);
-		
-		// write the checksum file
-		LogVerbose(LOG_TRT "saving model checksum to %s\n", mChecksumPath.c_str());
-		
-		char cmd[PATH_MAX * 2 + 256];
-		snprintf(cmd, sizeof(cmd), "%s %s | awk '{print $1}' > %s", CHECKSUM_TYPE, model_path.c_str(), mChecksumPath.c_str());
-	
-		LogVerbose(LOG_TRT "%s\n", cmd);
-	
-		const int result = system(cmd);
-		
-		if( result != 0 )
-			LogError(LOG_TRT "failed to save model checksum to %s\n", mChecksumPath.c_str());
 	}
 	else
 	{
@@ -1357,22 +1490,18 @@ bool tensorNet::LoadNetwork( const char* prototxt_path_, const char* model_path_
 }
 
 
-// LoadEngine
-bool tensorNet::LoadEngine( char* engine_stream, size_t engine_size,
-			  		   const std::vector<std::string>& input_blobs, 
-			  		   const std::vector<std::string>& output_blobs,
-			  		   nvinfer1::IPluginFactory* pluginFactory,
-					   deviceType device, cudaStream_t stream )
+// DeserializeEngine
+nvinfer1::ICudaEngine* tensorNet::DeserializeEngine( char* engine_stream, size_t engine_size,
+										  nvinfer1::IPluginFactory* pluginFactory,
+										  deviceType device, nvinfer1::IRuntime** runtime )
 {
-	/*
-	 * create runtime inference engine execution context
-	 */
+	// create the runtime
 	nvinfer1::IRuntime* infer = CREATE_INFER_RUNTIME(gLogger);
 	
 	if( !infer )
 	{
 		LogError(LOG_TRT "device %s, failed to create TensorRT runtime\n", deviceTypeToStr(device));
-		return false;
+		return NULL;
 	}
 
 #if NV_TENSORRT_MAJOR >= 5 
@@ -1402,9 +1531,52 @@ bool tensorNet::LoadEngine( char* engine_stream, size_t engine_size,
 	if( !engine )
 	{
 		LogError(LOG_TRT "device %s, failed to create CUDA engine\n", deviceTypeToStr(device));
-		return false;
+		TRT_DESTROY(infer);
+		return NULL;
+	}
+
+	*runtime = infer;
+	return engine;
+}
+
+
+// CreateContext
+nvinfer1::IExecutionContext* tensorNet::CreateContext( nvinfer1::ICudaEngine* engine, deviceType device )
+{
+	nvinfer1::IExecutionContext* context = engine->createExecutionContext();
+	
+	if( !context )
+	{
+		LogError(LOG_TRT "device %s, failed to create execution context\n", deviceTypeToStr(device));
+		return NULL;
+	}
+
+	if( mEnableDebug )
+	{
+		LogVerbose(LOG_TRT "device %s, enabling context debug sync.\n", deviceTypeToStr(device));
+		context->setDebugSync(true);
 	}
 
+	if( mEnableProfiler )
+		context->setProfiler(&gProfiler);
+
+	return context;
+}
+
+
+// LoadEngine
+bool tensorNet::LoadEngine( char* engine_stream, size_t engine_size,
+			  		   const std::vector<std::string>& input_blobs, 
+			  		   const std::vector<std::string>& output_blobs,
+			  		   nvinfer1::IPluginFactory* pluginFactory,
+					   deviceType device, cudaStream_t stream )
+{
+	nvinfer1::IRuntime* infer = NULL;
+	nvinfer1::ICudaEngine* engine = DeserializeEngine(engine_stream, engine_size, pluginFactory, device, &infer);
+
+	if( !engine )
+		return false;
+
 	if( !LoadEngine(engine, input_blobs, output_blobs, device, stream) )
 	{
 		LogError(LOG_TRT "device %s, failed to create resources for CUDA engine\n", deviceTypeToStr(device));
@@ -1433,6 +1605,28 @@ static int trtTensorIndex( nvinfer1::ICudaEngine* engine, const char* name )
 }         
 #endif
 
+#if NV_TENSORRT_MAJOR >= 7
+// batch size of an EXPLICIT_BATCH (ONNX) engine, from the first dimension of an input layer
+// (or 0 if the layer doesn't have a fixed batch dimension)
+static uint32_t explicitBatchSize( nvinfer1::ICudaEngine* engine, const char* input )
+{
+#if NV_TENSORRT_MAJOR >= 10
+	const nvinfer1::Dims dims = engine->getTensorShape(input);
+#else
+	const int index = engine->getBindingIndex(input);
+
+	if( index < 0 )
+		return 0;
+
+	const nvinfer1::Dims dims = engine->getBindingDimensions(index);
+#endif
+	if( dims.nbDims != 4 || dims.d[0] < 1 )
+		return 0;
+
+	return dims.d[0];
+}
+#endif
+
 
 // LoadEngine
 bool tensorNet::LoadEngine( nvinfer1::ICudaEngine* engine,
@@ -1443,22 +1637,10 @@ bool tensorNet::LoadEngine( nvinfer1::ICudaEngine* engine,
 	if( !engine )
 		return NULL;
 
-	nvinfer1::IExecutionContext* context = engine->createExecutionContext();
+	nvinfer1::IExecutionContext* context = CreateContext(engine, device);
 	
 	if( !context )
-	{
-		LogError(LOG_TRT "device %s, failed to create execution context\n", deviceTypeToStr(device));
-		return 0;
-	}
-
-	if( mEnableDebug )
-	{
-		LogVerbose(LOG_TRT "device %s, enabling context debug sync.\n", deviceTypeToStr(device));
-		context->setDebugSync(true);
-	}
-
-	if( mEnableProfiler )
-		context->setProfiler(&gProfiler);
+		return false;
 
 #if NV_TENSORRT_MAJOR < 10
 	mMaxBatchSize = engine->getMaxBatchSize();
@@ -1466,6 +1648,13 @@ bool tensorNet::LoadEngine( nvinfer1::ICudaEngine* engine,
     mMaxBatchSize = 1;
 #endif
 
+#if NV_TENSORRT_MAJOR >= 7
+	// engines of ONNX models (EXPLICIT_BATCH) have the batch size as the first dimension of the inputs,
+	// so the buffers are allocated for the whole batch (a dynamic batch size of -1 stays at 1)
+	if( mModelType == MODEL_ONNX && input_blobs.size() > 0 )
+		mMaxBatchSize = std::max(mMaxBatchSize, explicitBatchSize(engine, input_blobs[0].c_str()));
+#endif
+
 	LogInfo(LOG_TRT "\n");
 	LogInfo(LOG_TRT "CUDA engine context initialized on device %s:\n", deviceTypeToStr(device));
 	LogInfo(LOG_TRT "   -- layers       %i\n", engine->getNbLayers());
@@ -1885,6 +2074,288 @@ bool tensorNet::ValidateEngine( const char* model_path, const char* cache_path,
 }
 
 
+// IsBuildingEngine
+bool tensorNet::IsBuildingEngine() const
+{
+	return (mSwapper != NULL) && mSwapper->IsBuilding();
+}
+
+
+// WaitForEngine
+bool tensorNet::WaitForEngine( uint64_t timeout )
+{
+	if( !mSwapper )
+		return false;
+
+	return mSwapper->Wait(timeout);
+}
+
+
+#if NV_TENSORRT_MAJOR >= 8
+// findCachedEngines
+static void findCachedEngines( const std::string& model_path, uint32_t maxBatchSize, deviceType device, std::vector<std::string>& engines )
+{
+	// engines are cached as <model>.<batch>.<fallback>.<tensorrt>.<device>.<precision>.engine
+	char pattern[PATH_MAX];
+	snprintf(pattern, sizeof(pattern), "%s.*.*.%i.%s.*.engine", model_path.c_str(), NV_TENSORRT_VERSION, deviceTypeToStr(device));
+
+	glob_t list;
+
+	if( glob(pattern, 0, NULL, &list) != 0 )
+		return;
+
+	// prefer the engines with the same batch size
+	const std::string batchPrefix = model_path + "." + std::to_string(maxBatchSize) + ".";
+	std::vector<std::string> others;
+
+	for( size_t n=0; n < list.gl_pathc; n++ )
+	{
+		const std::string path = list.gl_pathv[n];
+
+		if( path.compare(0, batchPrefix.length(), batchPrefix) == 0 )
+			engines.push_back(path);
+		else
+			others.push_back(path);
+	}
+
+	globfree(&list);
+	engines.insert(engines.end(), others.begin(), others.end());
+}
+
+
+// LoadFallbackEngine
+bool tensorNet::LoadFallbackEngine( const char* model, const std::string& model_path,
+							 const std::vector<std::string>& input_blobs, 
+							 const std::vector<std::string>& output_blobs,
+							 uint32_t maxBatchSize, deviceType device, cudaStream_t stream )
+{
+	std::vector<std::string> engines;
+	std::vector<std::string> models;	// the model each engine was built from (to validate its checksum)
+
+	// engines that were built for the same model with a different precision or batch size
+	findCachedEngines(model_path, maxBatchSize, device, engines);
+	models.resize(engines.size(), model_path);
+
+	// engines of the backup model
+	std::string fallback = GetFallbackModel(model);
+
+	if( fallback.length() == 0 )
+		fallback = GetFallbackModel(model_path.c_str());
+
+	if( fallback.length() > 0 )
+	{
+		const std::string fallback_path = locateFile(fallback);
+
+		if( fallback_path.length() == 0 )
+		{
+			LogWarning(LOG_TRT "couldn't find backup model %s\n", fallback.c_str());
+		}
+		else if( modelTypeFromPath(fallback_path.c_str()) == MODEL_ENGINE )
+		{
+			engines.push_back(fallback_path);
+			models.push_back("");
+		}
+		else
+		{
+			findCachedEngines(fallback_path, maxBatchSize, device, engines);
+			models.resize(engines.size(), fallback_path);
+		}
+	}
+
+	for( size_t n=0; n < engines.size(); n++ )
+	{
+		// check that the engine was built from the current version of its model
+		if( models[n].length() > 0 && !ValidateEngine(models[n].c_str(), engines[n].c_str(), (models[n] + "." CHECKSUM_TYPE).c_str()) )
+			continue;
+
+		LogInfo(LOG_TRT "device %s, loading fallback engine %s\n", deviceTypeToStr(device), engines[n].c_str());
+
+		if( !LoadEngine(engines[n].c_str(), input_blobs, output_blobs, NULL, device, stream) )
+		{
+			LogWarning(LOG_TRT "device %s, failed to load fallback engine %s\n", deviceTypeToStr(device), engines[n].c_str());
+			ReleaseEngine();
+			continue;
+		}
+
+		// the precision is the last part of the cached engine's filename
+		const precisionType precision = precisionTypeFromStr(fileExtension(fileRemoveExtension(engines[n])).c_str());
+
+		if( precision != TYPE_DISABLED )
+			mPrecision = precision;
+
+		mFallbackEngine = true;
+		return true;
+	}
+
+	LogVerbose(LOG_TRT "couldn't find a fallback engine for %s\n", model_path.c_str());
+	return false;
+}
+
+
+// SwapEngine
+bool tensorNet::SwapEngine( engineInstance* instance )
+{
+	nvinfer1::ICudaEngine* engine = instance->engine;
+
+#if NV_TENSORRT_MAJOR < 10
+	uint32_t maxBatchSize = engine->getMaxBatchSize();
+#else
+	uint32_t maxBatchSize = 1;
+#endif
+
+#if NV_TENSORRT_MAJOR >= 7
+	if( mModelType == MODEL_ONNX && mInputs.size() > 0 )
+		maxBatchSize = std::max(maxBatchSize, explicitBatchSize(engine, mInputs[0].name.c_str()));
+#endif
+
+	const int numBindings = engineBindings(engine);
+	void** bindings = (void**)malloc(numBindings * sizeof(void*));
+
+	if( !bindings )
+		return false;
+
+	memset(bindings, 0, numBindings * sizeof(void*));
+
+	// the layers keep their buffers, so they need to have the same dimensions in the new engine
+	const size_t numLayers = mInputs.size() + mOutputs.size();
+	std::vector<uint32_t> layerBindings(numLayers);
+	std::vector<void*> layerBuffers(numLayers);
+
+	for( size_t n=0; n < numLayers; n++ )
+	{
+		const bool input = (n < mInputs.size());
+		const layerInfo& layer = input ? mInputs[n] : mOutputs[n - mInputs.size()];
+
+	#if NV_TENSORRT_MAJOR >= 10
+		const int index = trtTensorIndex(engine, layer.name.c_str());
+	#else
+		const int index = engine->getBindingIndex(layer.name.c_str());
+	#endif
+
+		if( index < 0 )
+		{
+			LogError(LOG_TRT "couldn't swap in the new engine, it doesn't have layer %s\n", layer.name.c_str());
+			free(bindings);
+			return false;
+		}
+
+	#if NV_TENSORRT_MAJOR >= 10
+		nvinfer1::Dims dims = engine->getTensorShape(layer.name.c_str());
+
+		if( input && mModelType == MODEL_ONNX )
+			dims = shiftDims(dims);
+	#else
+		nvinfer1::Dims dims = validateDims(engine->getBindingDimensions(index));
+
+		if( mModelType == MODEL_ONNX )
+			dims = shiftDims(dims);
+	#endif
+
+		bool sameDims = (dims.nbDims == layer.dims.nbDims);
+
+		for( int i=0; i < dims.nbDims && sameDims; i++ )
+			sameDims = (dims.d[i] == layer.dims.d[i]);
+
+		if( !sameDims || maxBatchSize * sizeDims(dims) * sizeof(float) > layer.size )
+		{
+			LogError(LOG_TRT "couldn't swap in the new engine, layer %s has different dimensions\n", layer.name.c_str());
+			free(bindings);
+			return false;
+		}
+
+		bindings[index] = layer.CUDA;
+		layerBindings[n] = index;
+		layerBuffers[n] = layer.CUDA;
+	}
+
+	// allocate the bindings that aren't input or output layers
+	for( int n=0; n < numBindings; n++ )
+	{
+		if( bindings[n] != NULL )
+			continue;
+
+	#if NV_TENSORRT_MAJOR >= 10
+		const size_t bindingSize = sizeDims(validateDims(engine->getTensorShape(engine->getIOTensorName(n)))) * maxBatchSize * sizeof(float);
+	#else
+		const size_t bindingSize = sizeDims(validateDims(engine->getBindingDimensions(n))) * maxBatchSize * sizeof(float);
+	#endif
+
+		if( CUDA_FAILED(cudaMalloc(&bindings[n], bindingSize)) )
+		{
+			LogError(LOG_TRT "failed to allocate %zu bytes for unused binding %i\n", bindingSize, n);
+			freeUnusedBindings(engine, bindings, layerBuffers);
+			free(bindings);
+			return false;
+		}
+	}
+
+#if NV_TENSORRT_MAJOR >= 10
+	for( size_t n=0; n < mOutputs.size(); n++ )
+		instance->context->setTensorAddress(mOutputs[n].name.c_str(), mOutputs[n].CUDA);
+#endif
+
+	// the old engine may still be running
+	if( mStream != NULL )
+		CUDA(cudaStreamSynchronize(mStream));
+	else
+		CUDA(cudaDeviceSynchronize());
+
+	if( mBindings != NULL && mEngine != NULL )
+		freeUnusedBindings(mEngine, mBindings, layerBuffers);
+
+	if( mContext != NULL )
+		TRT_DESTROY(mContext);
+
+	if( mEngine != NULL )
+		TRT_DESTROY(mEngine);
+
+	if( mInfer != NULL )
+		TRT_DESTROY(mInfer);
+
+	free(mBindings);
+
+	for( size_t n=0; n < mInputs.size(); n++ )
+		mInputs[n].binding = layerBindings[n];
+
+	for( size_t n=0; n < mOutputs.size(); n++ )
+		mOutputs[n].binding = layerBindings[mInputs.size() + n];
+
+	mInfer    = instance->infer;
+	mEngine   = instance->engine;
+	mContext  = instance->context;
+	mBindings = bindings;
+
+	mMaxBatchSize   = maxBatchSize;
+	mPrecision      = instance->precision;
+	mFallbackEngine = false;
+
+	delete instance;
+
+	LogSuccess(LOG_TRT "device %s, switched to the engine that was built for %s (%s)\n", deviceTypeToStr(mDevice), mModelPath.c_str(), precisionTypeToStr(mPrecision));
+	return true;
+}
+
+
+// ReleaseInstance
+void tensorNet::ReleaseInstance( engineInstance* instance )
+{
+	if( !instance )
+		return;
+
+	if( instance->context != NULL )
+		TRT_DESTROY(instance->context);
+
+	if( instance->engine != NULL )
+		TRT_DESTROY(instance->engine);
+
+	if( instance->infer != NULL )
+		TRT_DESTROY(instance->infer);
+
+	delete instance;
+}
+#endif
+
+
 // CreateStream
 cudaStream_t tensorNet::CreateStream( bool nonBlocking )
 {
@@ -1914,8 +2385,21 @@ void tensorNet::SetStream( cudaStream_t stream )
 
 
 // ProcessNetwork
-bool tensorNet::ProcessNetwork( bool sync )
+bool tensorNet::ProcessNetwork( bool sync, uint32_t batchSize )
 {
+#if NV_TENSORRT_MAJOR >= 8
+	// switch to the engine that was built in the background, once it's ready
+	// (before checking the batch size, because the new engine's maximum can be smaller)
+	if( mSwapper != NULL && mSwapper->GetStatus() == engineSwapper::READY )
+		mSwapper->Swap([this](void* instance) { return SwapEngine((engineInstance*)instance); });
+#endif
+
+	if( batchSize == 0 || batchSize > mMaxBatchSize )
+	{
+		LogError(LOG_TRT "tensorNet::ProcessNetwork() -- invalid batch size %u (the maximum is %u)\n", batchSize, mMaxBatchSize);
+		return false;
+	}
+
 	if( TENSORRT_VERSION_CHECK(8,4,1) && mModelType == MODEL_ONNX )
 	{
 	#if TENSORRT_VERSION_CHECK(8,4,1)
@@ -1953,7 +2437,7 @@ bool tensorNet::ProcessNetwork( bool sync )
 	{
 		if( sync )
 		{
-			if( !mContext->execute(1, mBindings) )
+			if( !mContext->execute(batchSize, mBindings) )
 			{
 				LogError(LOG_TRT "failed to execute TensorRT context on device %s\n", deviceTypeToStr(mDevice));
 				return false;
@@ -1961,7 +2445,7 @@ bool tensorNet::ProcessNetwork( bool sync )
 		}
 		else
 		{
-			if( !mContext->enqueue(1, mBindings, mStream, NULL) )
+			if( !mContext->enqueue(batchSize, mBindings, mStream, NULL) )
 			{
 				LogError(LOG_TRT "failed to enqueue TensorRT context on device %s\n", deviceTypeToStr(mDevice));
 				return false;
@@ -26,6 +26,9 @@
 // forward declaration of IInt8Calibrator
 namespace nvinfer1 { class IInt8Calibrator; }
 
+// forward declaration of engineSwapper
+class engineSwapper;
+
 // includes
 #include <NvInfer.h>
 
@@ -422,6 +425,25 @@ public:
 	 */
 	inline bool IsPrecision( precisionType type ) const		{ return (mPrecision == type); }
 
+	/**
+	 * Check if a fallback engine is being used, because the network's engine is being built
+	 * in the background (or that build failed).  @see SetBackgroundEngineBuild()
+	 */
+	inline bool IsFallbackEngine() const					{ return mFallbackEngine; }
+
+	/**
+	 * Check if the network's engine is being built in the background.
+	 */
+	bool IsBuildingEngine() const;
+
+	/**
+	 * Wait for the engine that's being built in the background to finish.
+	 * It gets swapped in the next time that the network is processed.
+	 * @param timeout the timeout in milliseconds, or UINT64_MAX to wait forever.
+	 * @returns true if the build finished, or false if it timed out or there isn't one.
+	 */
+	bool WaitForEngine( uint64_t timeout=UINT64_MAX );
+
 	/**
 	 * Resolve a desired precision to a specific one that's available.
 	 */
@@ -487,6 +509,12 @@ public:
 	 */
 	inline bool IsModelType( modelType type ) const			{ return (mModelType == type); }
 
+	/**
+	 * Retrieve the maximum number of images that the network can process at once.
+	 * The input and output layers have room for this many (consecutive) tensors.
+	 */
+	inline uint32_t GetMaxBatchSize() const					{ return mMaxBatchSize; }
+
 	/**
 	 * Retrieve the number of input layers to the network.
 	 */
@@ -616,8 +644,10 @@ protected:
 	 *             and the thread/function will block until processing is complete. 
 	 *             if false, the function will return immediately after the processing
 	 *             has been enqueued to the CUDA stream indicated by GetStream().
+	 * @param batchSize the number of images in the input tensors, up to GetMaxBatchSize().
+	 *                  Engines of ONNX models always process their whole (fixed) batch.
 	 */
-	bool ProcessNetwork( bool sync=true );
+	bool ProcessNetwork( bool sync=true, uint32_t batchSize=1 );
 	  
 	/**
 	 * Create and output an optimized network model
@@ -655,6 +685,68 @@ protected:
 	 */
 	bool ValidateEngine( const char* model_path, const char* cache_path, const char* checksum_path );
 
+	/**
+	 * Profile the model with ProfileModel(), and save the engine and the model's checksum to the cache.
+	 */
+	bool BuildEngine( const std::string& deployFile, const std::string& modelFile,
+				   const std::vector<std::string>& inputs, const std::vector<Dims3>& inputDims,
+				   const std::vector<std::string>& outputs, uint32_t maxBatchSize, 
+				   precisionType precision, deviceType device, bool allowGPUFallback,
+				   nvinfer1::IInt8Calibrator* calibrator, const std::string& cachePath,
+				   char** engineStream, size_t* engineSize );
+
+	/**
+	 * Deserialize an engine from memory, with a new runtime.
+	 */
+	nvinfer1::ICudaEngine* DeserializeEngine( char* engine_stream, size_t engine_size,
+									  nvinfer1::IPluginFactory* pluginFactory,
+									  deviceType device, nvinfer1::IRuntime** runtime );
+
+	/**
+	 * Create an execution context for an engine.
+	 */
+	nvinfer1::IExecutionContext* CreateContext( nvinfer1::ICudaEngine* engine, deviceType device );
+
+	/**
+	 * Free the engine and the buffers of its layers.
+	 */
+	void ReleaseEngine();
+
+#if NV_TENSORRT_MAJOR >= 8
+	/**
+	 * Engine that was built in the background, before it's swapped in.
+	 */
+	struct engineInstance
+	{
+		nvinfer1::IRuntime* infer;
+		nvinfer1::ICudaEngine* engine;
+		nvinfer1::IExecutionContext* context;
+		precisionType precision;
+	};
+
+	/**
+	 * Load an engine to run while the model's engine is built in the background -
+	 * either one that was built with a different precision or batch size, or the
+	 * engine of the backup model from SetFallbackModel().
+	 */
+	bool LoadFallbackEngine( const char* model, const std::string& modelPath,
+						const std::vector<std::string>& inputs, 
+						const std::vector<std::string>& outputs,
+						uint32_t maxBatchSize, deviceType device, cudaStream_t stream );
+
+	/**
+	 * Switch to an engine that was built in the background (between frames).
+	 * The engine should have the same input and output layers as the current one,
+	 * which keep their buffers.  Returns false if it doesn't.
+	 */
+	bool SwapEngine( engineInstance* instance );
+
+	/**
+	 * Free an engine that was built in the background, but not swapped in.
+	 */
+	static void ReleaseInstance( engineInstance* instance );
+#endif
+
 	/**
 	 * Logger class for GIE info/warning/errors
 	 */
@@ -809,8 +901,11 @@ protected:
 	bool	    mEnableProfiler;
 	bool     mEnableDebug;
 	bool	    mAllowGPUFallback;
+	bool     mFallbackEngine;
 	void**   mBindings;
 
+	engineSwapper* mSwapper;
+
 	struct layerInfo
 	{
 		std::string name;
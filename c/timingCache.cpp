@@ -0,0 +1,433 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+
+#include "timingCache.h"
+#include "tensorNet.h"
+
+#include "filesystem.h"
+#include "logging.h"
+
+#include <algorithm>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+
+static std::string gTimingCacheDir;
+static uint64_t    gTimingCacheMaxSize = TIMING_CACHE_DEFAULT_MAX_SIZE;
+
+#define TIMING_CACHE_EXT ".timingcache"
+#define TIMING_CACHE_LOCK_EXT TIMING_CACHE_EXT ".lock"
+
+// lock held by the process that's evicting caches from the directory
+#define TIMING_CACHE_EVICT_LOCK ".evict.lock"
+
+
+// SetTimingCacheDir
+void SetTimingCacheDir( const char* path )
+{
+	gTimingCacheDir = (path != NULL) ? path : "";
+}
+
+
+// GetTimingCacheDir
+std::string GetTimingCacheDir()
+{
+	if( gTimingCacheDir.length() > 0 )
+		return gTimingCacheDir;
+
+	const char* env = getenv(TIMING_CACHE_DIR_ENV);
+
+	if( env != NULL && strlen(env) > 0 )
+		return env;
+
+	const std::string networks = locateFile("networks");
+
+	if( networks.length() == 0 )
+		return "";
+
+	return pathJoin(networks, ".timingcache");
+}
+
+
+// SetTimingCacheMaxSize
+void SetTimingCacheMaxSize( uint64_t bytes )
+{
+	gTimingCacheMaxSize = bytes;
+}
+
+
+// GetTimingCacheMaxSize
+uint64_t GetTimingCacheMaxSize()
+{
+	return gTimingCacheMaxSize;
+}
+
+
+// GetTimingCachePath
+std::string GetTimingCachePath( int device )
+{
+	const std::string dir = GetTimingCacheDir();
+
+	if( dir.length() == 0 )
+	{
+		LogWarning(LOG_TRT "couldn't find the timing cache directory (set it with $%s)\n", TIMING_CACHE_DIR_ENV);
+		return "";
+	}
+
+	if( device < 0 && CUDA_FAILED(cudaGetDevice(&device)) )
+		return "";
+
+	cudaDeviceProp props;
+
+	if( CUDA_FAILED(cudaGetDeviceProperties(&props, device)) )
+		return "";
+
+	char name[128];
+	int length = snprintf(name, sizeof(name), "tensorrt-%i.%i.%i-sm%i%i", NV_TENSORRT_MAJOR, NV_TENSORRT_MINOR, NV_TENSORRT_PATCH, props.major, props.minor);
+
+#if CUDART_VERSION >= 10000
+	// the UUID tells apart different GPUs with the same compute capability
+	length += snprintf(name + length, sizeof(name) - length, "-");
+
+	for( int n=0; n < 16; n++ )
+		length += snprintf(name + length, sizeof(name) - length, "%02x", (uint8_t)props.uuid.bytes[n]);
+#endif
+
+	return pathJoin(dir, std::string(name) + TIMING_CACHE_EXT);
+}
+
+
+// readCache
+static bool readCache( const std::string& path, std::vector<char>& data )
+{
+	FILE* file = fopen(path.c_str(), "rb");
+
+	if( !file )
+		return false;
+
+	struct stat info;
+
+	if( fstat(fileno(file), &info) != 0 )
+	{
+		fclose(file);
+		return false;
+	}
+
+	data.resize(info.st_size);
+
+	const bool read = (fread(data.data(), 1, data.size(), file) == data.size());
+	fclose(file);
+
+	if( !read )
+		data.clear();
+
+	return read;
+}
+
+
+// LoadTimingCache
+bool LoadTimingCache( const std::string& path, std::vector<char>& data )
+{
+	data.clear();
+
+	if( path.length() == 0 )
+		return false;
+
+	if( !readCache(path, data) )
+	{
+		// fall back to the cache from before they were kept for each GPU
+		char legacyPath[PATH_MAX];
+		sprintf(legacyPath, "/usr/local/bin/networks/tensorrt.%i.timingcache", NV_TENSORRT_VERSION);
+
+		if( !readCache(legacyPath, data) )
+			return false;
+
+		LogVerbose(LOG_TRT "loading timing cache from %s\n", legacyPath);
+		return data.size() > 0;
+	}
+
+	// mark the cache as recently used (for the LRU bound on their size)
+	utimensat(AT_FDCWD, path.c_str(), NULL, 0);
+
+	LogInfo(LOG_TRT "loading timing cache from %s\n", path.c_str());
+	return data.size() > 0;
+}
+
+
+// makeDirs
+static bool makeDirs( const std::string& path )
+{
+	for( size_t n=1; n <= path.length(); n++ )
+	{
+		if( n < path.length() && path[n] != '/' )
+			continue;
+
+		const std::string dir = path.substr(0, n);
+
+		if( mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST )
+		{
+			LogError(LOG_TRT "failed to create directory '%s' (%s)\n", dir.c_str(), strerror(errno));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+// writeCache
+static bool writeCache( const std::string& path, const std::vector<char>& data )
+{
+	// write a temporary file that replaces the cache all at once, so readers never see a partial one
+	const std::string tmp = path + ".tmp" + std::to_string(getpid());
+	FILE* file = fopen(tmp.c_str(), "wb");
+
+	if( !file )
+		return false;
+
+	const bool written = (fwrite(data.data(), 1, data.size(), file) == data.size()) && fflush(file) == 0 && fsync(fileno(file)) == 0;
+
+	if( fclose(file) != 0 || !written || rename(tmp.c_str(), path.c_str()) != 0 )
+	{
+		unlink(tmp.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+
+// lockFile
+static int lockFile( const std::string& path, bool wait )
+{
+	while( true )
+	{
+		const int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+
+		if( fd < 0 )
+		{
+			LogWarning(LOG_TRT "failed to open timing cache lock %s (%s)\n", path.c_str(), strerror(errno));
+			return -1;
+		}
+
+		if( flock(fd, LOCK_EX | LOCK_NB) != 0 )
+		{
+			if( !wait )
+			{
+				close(fd);
+				return -1;
+			}
+
+			LogVerbose(LOG_TRT "waiting for another process to release %s\n", path.c_str());
+
+			while( flock(fd, LOCK_EX) != 0 && errno == EINTR );
+		}
+
+		// evictCaches() may have removed the lock file while this was waiting on it,
+		// in which case the lock has to be taken again on the new file
+		struct stat locked;
+		struct stat current;
+
+		if( fstat(fd, &locked) == 0 && stat(path.c_str(), &current) == 0 &&
+		    locked.st_dev == current.st_dev && locked.st_ino == current.st_ino )
+			return fd;
+
+		close(fd);
+	}
+}
+
+
+// removeCache
+static bool removeCache( const std::string& path )
+{
+	// skip caches that another process is saving
+	const std::string lockPath = path + ".lock";
+	const int lock = lockFile(lockPath, false);
+
+	if( lock < 0 )
+		return false;
+
+	const bool removed = (unlink(path.c_str()) == 0 || errno == ENOENT);
+
+	if( removed )
+		unlink(lockPath.c_str());
+
+	close(lock);
+	return removed;
+}
+
+
+// evictCaches
+static void evictCaches( const std::string& dir, const std::string& keep, uint64_t maxSize )
+{
+	struct cacheFile
+	{
+		std::string path;
+		uint64_t size;
+		struct timespec mtime;
+	};
+
+	DIR* d = opendir(dir.c_str());
+
+	if( !d )
+		return;
+
+	std::vector<cacheFile> files;
+	uint64_t totalSize = 0;
+
+	std::vector<std::string> locks;
+
+	while( struct dirent* entry = readdir(d) )
+	{
+		const size_t length = strlen(entry->d_name);
+		const size_t extLength = strlen(TIMING_CACHE_EXT);
+		const size_t lockExtLength = strlen(TIMING_CACHE_LOCK_EXT);
+
+		if( length > lockExtLength && strcmp(entry->d_name + length - lockExtLength, TIMING_CACHE_LOCK_EXT) == 0 )
+		{
+			locks.push_back(std::string(entry->d_name, length - strlen(".lock")));
+			continue;
+		}
+
+		if( length <= extLength || strcmp(entry->d_name + length - extLength, TIMING_CACHE_EXT) != 0 )
+			continue;
+
+		cacheFile file;
+		file.path = pathJoin(dir, entry->d_name);
+
+		struct stat info;
+
+		if( stat(file.path.c_str(), &info) != 0 || !S_ISREG(info.st_mode) )
+			continue;
+
+		file.size = info.st_size;
+		file.mtime = info.st_mtim;
+
+		totalSize += file.size;
+		files.push_back(file);
+	}
+
+	closedir(d);
+
+	// remove the locks that were left behind by caches that no longer exist
+	for( size_t n=0; n < locks.size(); n++ )
+	{
+		const std::string path = pathJoin(dir, locks[n]);
+
+		if( path == keep || access(path.c_str(), F_OK) == 0 )
+			continue;
+
+		if( removeCache(path) )
+			LogVerbose(LOG_TRT "removed orphaned timing cache lock %s.lock\n", path.c_str());
+	}
+
+	if( maxSize == 0 || totalSize <= maxSize )
+		return;
+
+	// delete the least-recently used caches first
+	std::sort(files.begin(), files.end(), [](const cacheFile& a, const cacheFile& b)
+	{
+		if( a.mtime.tv_sec != b.mtime.tv_sec )
+			return a.mtime.tv_sec < b.mtime.tv_sec;
+
+		return a.mtime.tv_nsec < b.mtime.tv_nsec;
+	});
+
+	for( size_t n=0; n < files.size() && totalSize > maxSize; n++ )
+	{
+		if( files[n].path == keep )
+			continue;
+
+		if( !removeCache(files[n].path) )
+			continue;
+
+		LogVerbose(LOG_TRT "removed least-recently used timing cache %s (%llu bytes)\n", files[n].path.c_str(), (unsigned long long)files[n].size);
+		totalSize -= files[n].size;
+	}
+}
+
+
+// SaveTimingCache
+bool SaveTimingCache( const std::string& path, const TimingCacheMerge& merge )
+{
+	if( path.length() == 0 )
+		return false;
+
+	const std::string dir = path.substr(0, path.find_last_of('/') + 1);
+
+	if( dir.length() > 0 && !makeDirs(dir) )
+		return false;
+
+	// lock the cache while it's merged, so that builds in other processes don't overwrite it
+	const int lock = lockFile(path + ".lock", true);
+
+	if( lock < 0 )
+		return false;
+
+	std::vector<char> current;
+	std::vector<char> merged;
+
+	readCache(path, current);
+
+	bool result = merge(current, merged);
+
+	if( !result )
+	{
+		LogWarning(LOG_TRT "failed to merge timing cache %s\n", path.c_str());
+	}
+	else if( merged.size() == 0 || merged == current )
+	{
+		LogVerbose(LOG_TRT "timing cache %s is already up to date\n", path.c_str());
+	}
+	else if( !writeCache(path, merged) )
+	{
+		LogWarning(LOG_TRT "failed to write timing cache %s (%s)\n", path.c_str(), strerror(errno));
+		result = false;
+	}
+	else
+	{
+		LogVerbose(LOG_TRT "saved timing cache to %s (%zu bytes)\n", path.c_str(), merged.size());
+	}
+
+	flock(lock, LOCK_UN);
+	close(lock);
+
+	// the lock on the cache only covers that GPU, so eviction takes a lock on the whole directory
+	// (if another process is already evicting, it's left to that one)
+	const std::string evictDir = (dir.length() > 0) ? dir : ".";
+	const int evictLock = lockFile(pathJoin(evictDir, TIMING_CACHE_EVICT_LOCK), false);
+
+	if( evictLock >= 0 )
+	{
+		evictCaches(evictDir, path, gTimingCacheMaxSize);
+		close(evictLock);
+	}
+
+	return result;
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#ifndef __TIMING_CACHE_H__
+#define __TIMING_CACHE_H__
+
+
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+
+/**
+ * Environment variable that overrides the directory the TensorRT timing caches are stored in
+ * (by default `networks/.timingcache`)
+ * @ingroup tensorNet
+ */
+#define TIMING_CACHE_DIR_ENV  "JETSON_TIMING_CACHE"
+
+/**
+ * Default limit on the total size of the timing caches, after which the least-recently used ones are deleted.
+ * @ingroup tensorNet
+ */
+#define TIMING_CACHE_DEFAULT_MAX_SIZE  (64 * 1024 * 1024)
+
+
+/**
+ * Function that merges the timing cache from a build with the one currently on disk
+ * (which is empty if there isn't one yet), and serializes the result into `merged`.
+ * @ingroup tensorNet
+ */
+typedef std::function<bool (const std::vector<char>& current, std::vector<char>& merged)> TimingCacheMerge;
+
+
+/**
+ * Set the directory that the TensorRT timing caches are stored in.
+ * If NULL or empty, it reverts to $JETSON_TIMING_CACHE or the default (`networks/.timingcache`)
+ * @ingroup tensorNet
+ */
+void SetTimingCacheDir( const char* path );
+
+/**
+ * Get the directory that the TensorRT timing caches are stored in.
+ * @ingroup tensorNet
+ */
+std::string GetTimingCacheDir();
+
+/**
+ * Set the limit on the total size (in bytes) of the timing caches in the directory.
+ * When it's exceeded, the least-recently used caches are deleted.  0 disables the limit.
+ * @ingroup tensorNet
+ */
+void SetTimingCacheMaxSize( uint64_t bytes );
+
+/**
+ * Get the limit on the total size (in bytes) of the timing caches.
+ * @ingroup tensorNet
+ */
+uint64_t GetTimingCacheMaxSize();
+
+/**
+ * Get the path of the timing cache for a CUDA device (or the current device if -1).
+ * The timings are only valid for the same GPU and version of TensorRT, so the filename
+ * contains the TensorRT version, compute capability, and UUID of the GPU, for example
+ * `networks/.timingcache/tensorrt-8.5.2-sm87-<uuid>.timingcache`
+ * @returns the path, or an empty string if the device couldn't be queried.
+ * @ingroup tensorNet
+ */
+std::string GetTimingCachePath( int device=-1 );
+
+/**
+ * Load a timing cache, and mark it as recently used.
+ * Caches are only ever replaced atomically, so this always reads a complete one.
+ * @returns true if the cache was loaded, or false if it doesn't exist or couldn't be read.
+ * @ingroup tensorNet
+ */
+bool LoadTimingCache( const std::string& path, std::vector<char>& data );
+
+/**
+ * Save a timing cache, merging it with the one currently on disk.
+ *
+ * The cache file is locked while `merge` combines the two, so builds that run at the same time
+ * (in other threads or processes) add their timings to the cache instead of replacing each other's.
+ * The result is written to a temporary file that's atomically renamed over the cache, and then
+ * the least-recently used caches in the directory are deleted if they exceed GetTimingCacheMaxSize().
+ * Eviction is done by one process at a time (under a lock on the directory), and skips the caches
+ * that other processes are saving.  It also removes the lock files of caches that no longer exist.
+ * If the merged cache is the same as the one on disk, it isn't rewritten.
+ *
+ * @ingroup tensorNet
+ */
+bool SaveTimingCache( const std::string& path, const TimingCacheMerge& merge );
+
+
+#endif
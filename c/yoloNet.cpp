@@ -24,6 +24,7 @@
 
 #include "yoloNet.h"
 #include "objectTracker.h"
+#include "detectionGrid.h"
 #include "tensorConvert.h"
 #include "modelDownloader.h"
 
@@ -50,6 +51,7 @@ yoloNet::yoloNet( float meanPixel ) : tensorNet()
 
 	mNumClasses  = 0;
 	mClassColors = NULL;
+	mClassTable  = NULL;
 	
 	mDetectionSets = NULL;
 	mDetectionSet  = 0;
@@ -68,6 +70,7 @@ yoloNet::~yoloNet()
 	
 	CUDA_FREE_HOST(mDetectionSets);
 	CUDA_FREE_HOST(mClassColors);
+	SAFE_DELETE(mClassTable);
 }
 
 // init
@@ -119,8 +122,7 @@ bool yoloNet::init( const char* prototxt, const char* model, const char* class_l
 		return false;
 
 	// load class descriptions
-	loadClassInfo(class_labels);
-	loadClassColors(class_colors);
+	loadClassInfo(class_labels, class_colors);
 
 	// set the specified threshold
 	SetConfidenceThreshold(threshold);
@@ -166,27 +168,40 @@ bool yoloNet::allocDetections()
 }
 
 // loadClassInfo
-bool yoloNet::loadClassInfo( const char* filename )
+bool yoloNet::loadClassInfo( const char* labels, const char* colors )
 {
-	if( !LoadClassLabels(filename, mClassDesc, mClassSynset, mNumClasses) )
-		return false;
+	SAFE_DELETE(mClassTable);
+	CUDA_FREE_HOST(mClassColors);
 
-	if( IsModelType(MODEL_UFF) )
-		mNumClasses = mClassDesc.size();
+	// load the labels and colors from the cached class table (or compile it from the text files)
+	mClassTable = classTable::Load(labels, colors, mNumClasses, YOLONET_DEFAULT_ALPHA);
 
-	LogInfo(LOG_TRT "yoloNet -- number of object classes:  %u\n", mNumClasses);
-	
-	if( filename != NULL )
-		mClassPath = locateFile(filename);	
+	const bool loaded = (mClassTable != NULL);
+
+	if( loaded )
+	{
+		if( IsModelType(MODEL_UFF) )
+			mNumClasses = mClassTable->GetNumClasses();
+
+		LogInfo(LOG_TRT "yoloNet -- number of object classes:  %u\n", mNumClasses);
 	
-	return true;
-}
+		if( labels != NULL )
+			mClassPath = locateFile(labels);	
+	}
+	else
+	{
+		// an empty table, where all of the classes are invalid
+		mClassTable = classTable::Create(std::vector<std::string>(), std::vector<std::string>(), NULL);
+	}
 
+	// the colors are copied to shared memory, where the overlay kernels can access them
+	if( mNumClasses == 0 || !cudaAllocMapped((void**)&mClassColors, mNumClasses * sizeof(float4)) )
+		return false;
 
-// loadClassColors
-bool yoloNet::loadClassColors( const char* filename )
-{
-	return LoadClassColors(filename, &mClassColors, mNumClasses, YOLONET_DEFAULT_ALPHA);
+	for( uint32_t n=0; n < mNumClasses; n++ )
+		mClassColors[n] = (n < mClassTable->GetNumClasses()) ? mClassTable->GetColor(n) : GenerateColor(n, YOLONET_DEFAULT_ALPHA);
+
+	return loaded;
 }
 
 int yoloNet::Detect( void* input, uint32_t width, uint32_t height, imageFormat format, Detection** detections, uint32_t overlay )
@@ -396,22 +411,8 @@ int yoloNet::postProcess( Detection* detections )
 // sortDetections (by area)
 void yoloNet::sortDetections( Detection* detections, int numDetections )
 {
-	if( numDetections < 2 )
-		return;
-
-	// order by area (descending) or confidence (ascending)
-	for( int i=0; i < numDetections-1; i++ )
-	{
-		for( int j=0; j < numDetections-i-1; j++ )
-		{
-			if( detections[j].Area() < detections[j+1].Area() ) //if( detections[j].Confidence > detections[j+1].Confidence )
-			{
-				const Detection det = detections[j];
-				detections[j] = detections[j+1];
-				detections[j+1] = det;
-			}
-		}
-	}
+	// order by area (descending), keeping detections of equal area in order
+	detectionGrid::SortByArea(detections, numDetections);
 
 	// renumber the instance ID's
 	//for( int i=0; i < numDetections; i++ )
@@ -504,23 +505,17 @@ bool yoloNet::Overlay( void* input, void* output, uint32_t width, uint32_t heigh
 	#ifdef BATCH_TEXT
 		std::vector<std::pair<std::string, int2>> labels;
 	#endif 
+		// the class prefixes of the labels are pre-rendered in the class table
+		const uint32_t labelFlags = ((flags & OVERLAY_LABEL) ? classTable::LABEL_CLASS : 0) |
+							   ((flags & OVERLAY_TRACKING) ? classTable::LABEL_TRACK : 0) |
+							   ((flags & OVERLAY_CONFIDENCE) ? classTable::LABEL_CONFIDENCE : 0);
+
 		for( uint32_t n=0; n < numDetections; n++ )
 		{
-			const char* className  = GetClassDesc(detections[n].ClassID);
-			const float confidence = detections[n].Confidence * 100.0f;
-			const int2  position   = make_int2(detections[n].Left+5, detections[n].Top+3);
+			const int2 position = make_int2(detections[n].Left+5, detections[n].Top+3);
 			
 			char buffer[256];
-			char* str = buffer;
-			
-			if( flags & OVERLAY_LABEL )
-				str += sprintf(str, "%s ", className);
-			
-			if( flags & OVERLAY_TRACKING && detections[n].TrackID >= 0 )
-				str += sprintf(str, "%i ", detections[n].TrackID);
-			
-			if( flags & OVERLAY_CONFIDENCE )
-				str += sprintf(str, "%.1f%%", confidence);
+			mClassTable->FormatLabel(buffer, sizeof(buffer), detections[n].ClassID, detections[n].TrackID, detections[n].Confidence, labelFlags);
 
 		#ifdef BATCH_TEXT
 			labels.push_back(std::pair<std::string, int2>(buffer, position));
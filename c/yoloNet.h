@@ -25,6 +25,7 @@
 
 
 #include "tensorNet.h"
+#include "classTable.h"
 #include "opencv2/opencv.hpp"
 #include <string>
 #include <unordered_set>
@@ -312,12 +313,23 @@ public:
 	 * Retrieve the maximum number of simultaneous detections the network supports.
 	 * Knowing this is useful for allocating the buffers to store the output detection results.
 	 */
-	inline uint32_t GetMaxDetections() const					{ return mMaxDetections; } 
+	inline uint32_t GetMaxDetections() const					{ return mMaxDetections; }
 
 	/**
-	 * Retrieve the description of a particular class.
+	 * Retrieve the number of detection sets in the ringbuffer that Detect() returns its results in.
+	 * The results returned from Detect() stay valid until this many more calls to Detect() have been made.
 	 */
-	inline const char* GetClassDesc( uint32_t index )	const		{ if(index >= mClassDesc.size()) { printf("invalid class %u\n", index); return "Invalid"; } return mClassDesc[index].c_str(); }
+	static inline uint32_t GetNumDetectionSets()					{ return mNumDetectionSets; }
+
+	/**
+	 * Retrieve the number of object classes supported in the detector
+	 */
+	inline uint32_t GetNumClasses() const						{ return mNumClasses; }
+
+	/**
+	 * Retrieve the description of a particular class (or "Invalid" if the index is out of range).
+	 */
+	inline const char* GetClassDesc( uint32_t index )	const		{ return mClassTable->GetDesc(index); }
 
     /**
 	 * Set the minimum threshold for detection.
@@ -330,8 +342,7 @@ protected:
 
 	bool allocDetections();
 
-	bool loadClassInfo( const char* filename );
-	bool loadClassColors( const char* filename );
+	bool loadClassInfo( const char* labels, const char* colors );
 	
 	bool init( const char* prototxt_path, const char* model_path, 
              const char* class_labels, const char* class_colors,
@@ -361,8 +372,7 @@ protected:
 	
 	float4* mClassColors;
 	
-	std::vector<std::string> mClassDesc;
-	std::vector<std::string> mClassSynset;
+	classTable* mClassTable;
 
 	std::string mClassPath;
 	uint32_t	  mNumClasses;
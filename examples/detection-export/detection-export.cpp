@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "detectionStream.h"
+#include "commandLine.h"
+#include "logging.h"
+
+#include <string.h>
+#include <strings.h>
+
+
+int usage()
+{
+	printf("usage: detection-export [--help] [--info] input [output]\n\n");
+	printf("Convert a detection stream recorded with `yolonet --record` to CSV or JSON.\n");
+	printf("The output format is selected by the extension of the output file.\n");
+	printf("If the input is a .csv file, it's converted back into a detection stream.\n\n");
+	printf("positional arguments:\n");
+	printf("    input           path to the detection stream file (or .csv file)\n");
+	printf("    output          path to the .csv or .json file to write (or the detection stream)\n\n");
+	printf("optional arguments:\n");
+	printf("  --help            show this help message and exit\n");
+	printf("  --info            print the time range and number of records, and exit\n\n");
+	printf("%s", Log::Usage());
+
+	return 0;
+}
+
+
+int main( int argc, char** argv )
+{
+	/*
+	 * parse command line
+	 */
+	commandLine cmdLine(argc, argv);
+
+	if( cmdLine.GetFlag("help") )
+		return usage();
+
+	const char* inputPath = cmdLine.GetPosition(0);
+	const char* outputPath = cmdLine.GetPosition(1);
+
+	if( !inputPath || (!outputPath && !cmdLine.GetFlag("info")) )
+		return usage();
+
+
+	/*
+	 * convert CSV back into a detection stream
+	 */
+	const char* inputExt = strrchr(inputPath, '.');
+
+	if( inputExt != NULL && strcasecmp(inputExt, ".csv") == 0 && outputPath != NULL )
+	{
+		detectionStreamWriter* writer = detectionStreamWriter::Open(outputPath);
+
+		if( !writer )
+		{
+			LogError("detection-export:  failed to create '%s'\n", outputPath);
+			return 1;
+		}
+
+		const int64_t records = writer->ImportCSV(inputPath);
+		const bool result = writer->Close() && records >= 0;
+
+		if( result )
+			LogInfo("detection-export:  converted %lld records from '%s' to '%s'\n", (long long)records, inputPath, outputPath);
+
+		delete writer;
+		return result ? 0 : 1;
+	}
+
+
+	/*
+	 * open the detection stream
+	 */
+	detectionStreamReader* reader = detectionStreamReader::Open(inputPath);
+
+	if( !reader )
+	{
+		LogError("detection-export:  failed to open '%s'\n", inputPath);
+		return 1;
+	}
+
+	if( cmdLine.GetFlag("info") )
+	{
+		LogInfo("detection-export:  '%s'\n", inputPath);
+		LogInfo("   -- records     %llu\n", (unsigned long long)reader->GetNumRecords());
+		LogInfo("   -- chunks      %zu\n", reader->GetNumChunks());
+		LogInfo("   -- timestamps  %llu - %llu\n", (unsigned long long)reader->GetFirstTimestamp(), (unsigned long long)reader->GetLastTimestamp());
+		LogInfo("   -- complete    %s\n", reader->IsComplete() ? "true" : "false");
+
+		delete reader;
+		return 0;
+	}
+
+
+	/*
+	 * convert to the output format
+	 */
+	const char* ext = strrchr(outputPath, '.');
+	bool result = false;
+
+	if( ext != NULL && strcasecmp(ext, ".json") == 0 )
+		result = reader->ExportJSON(outputPath);
+	else if( ext != NULL && strcasecmp(ext, ".csv") == 0 )
+		result = reader->ExportCSV(outputPath);
+	else
+		LogError("detection-export:  unsupported output format '%s' (expected .csv or .json)\n", outputPath);
+
+	delete reader;
+	return result ? 0 : 1;
+}
@@ -0,0 +1,379 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "detectionMulticast.h"
+#include "commandLine.h"
+#include "logging.h"
+#include "timespec.h"
+#include "Thread.h"
+#include "IPv4.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <signal.h>
+#include <string.h>
+#include <vector>
+
+
+bool signal_recieved = false;
+
+void sig_handler(int signo)
+{
+	if( signo == SIGINT )
+	{
+		LogVerbose("received SIGINT\n");
+		signal_recieved = true;
+	}
+}
+
+int usage()
+{
+	printf("usage: detection-multicast [--help] [--benchmark] [--multicast-interface=IP] [GROUP[:PORT]]\n\n");
+	printf("Receive the detections multicast with `yolonet --multicast` and print them along\n");
+	printf("with the loss statistics, or benchmark the UDP throughput over the loopback interface.\n\n");
+	printf("positional arguments:\n");
+	printf("    GROUP[:PORT]          the multicast group and port to subscribe to\n");
+	printf("                          (default: %s:%i)\n\n", DETECTION_MULTICAST_DEFAULT_GROUP, DETECTION_MULTICAST_DEFAULT_PORT);
+	printf("optional arguments:\n");
+	printf("  --help                  show this help message and exit\n");
+	printf("  --multicast-interface   address of the network interface to join the group on\n");
+	printf("  --benchmark             measure the packets/sec sent and received on the loopback\n");
+	printf("                          interface, one datagram per syscall versus batched\n");
+	printf("  --packets=N             number of packets to send in each benchmark (default: 200000)\n");
+	printf("  --size=BYTES            size of the benchmark packets (default: 256)\n");
+	printf("  --batch=N               number of packets per batch (default: 32)\n");
+	printf("  --detections=N          detections per frame in the publisher benchmark (default: 100)\n\n");
+	printf("%s", Log::Usage());
+
+	return 0;
+}
+
+
+/*
+ * loopback benchmark
+ */
+struct BenchmarkReceiver
+{
+	Socket* socket;
+	bool batched;
+	volatile bool stop;
+	volatile uint64_t packets;
+	uint64_t bytes;
+};
+
+static void* benchmarkReceiveThread( void* user_param )
+{
+	BenchmarkReceiver* rx = (BenchmarkReceiver*)user_param;
+
+	std::vector<uint8_t> buffers(32 * 65536);
+	std::vector<SocketMessage> messages(32);
+
+	for( size_t n=0; n < messages.size(); n++ )
+	{
+		messages[n].buffer = buffers.data() + n * 65536;
+		messages[n].size = 65536;
+	}
+
+	while( !rx->stop )
+	{
+		if( rx->batched )
+		{
+			const int count = rx->socket->RecieveBatch(messages.data(), messages.size());
+
+			if( count < 0 )
+				break;
+
+			for( int n=0; n < count; n++ )
+				rx->bytes += messages[n].received;
+
+			rx->packets += count;
+		}
+		else
+		{
+			const size_t size = rx->socket->Recieve(buffers.data(), 65536);
+
+			if( size > 0 )
+			{
+				rx->packets++;
+				rx->bytes += size;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static bool benchmarkSockets( bool batched, uint32_t numPackets, uint32_t packetSize, uint32_t batchSize )
+{
+	Socket* rxSocket = Socket::Create(SOCKET_UDP);
+	Socket* txSocket = Socket::Create(SOCKET_UDP);
+
+	if( !rxSocket || !txSocket || !rxSocket->Bind("127.0.0.1", 0) || !txSocket->Bind() )
+	{
+		LogError("detection-multicast:  failed to create loopback sockets\n");
+		return false;
+	}
+
+	rxSocket->SetBufferSize(16 * 1024 * 1024);
+	rxSocket->SetRecieveTimeout(100 * 1000);
+
+	// Bind() with port 0 picks a free port
+	struct sockaddr_in addr;
+	socklen_t addrLen = sizeof(addr);
+	getsockname(rxSocket->GetFD(), (struct sockaddr*)&addr, &addrLen);
+
+	uint32_t loopbackIP = 0;
+	IPv4AddressFromStr("127.0.0.1", &loopbackIP);
+	const uint16_t port = ntohs(addr.sin_port);
+
+	// start receiving
+	BenchmarkReceiver rx;
+	memset(&rx, 0, sizeof(rx));
+
+	rx.socket = rxSocket;
+	rx.batched = batched;
+
+	Thread thread;
+
+	if( !thread.Start(benchmarkReceiveThread, &rx) )
+		return false;
+
+	// send the packets
+	std::vector<uint8_t> packet(packetSize, 0xAB);
+	std::vector<SocketMessage> messages(batchSize);
+
+	for( uint32_t n=0; n < batchSize; n++ )
+	{
+		messages[n].buffer = packet.data();
+		messages[n].size = packetSize;
+		messages[n].remoteIP = loopbackIP;
+		messages[n].remotePort = port;
+	}
+
+	const double startTime = timeDouble();
+	uint32_t sent = 0;
+
+	while( sent < numPackets && !signal_recieved )
+	{
+		if( batched )
+		{
+			const uint32_t count = (numPackets - sent < batchSize) ? (numPackets - sent) : batchSize;
+			const size_t res = txSocket->SendBatch(messages.data(), count);
+
+			if( res == 0 )
+				break;
+
+			sent += res;
+		}
+		else
+		{
+			if( !txSocket->Send(packet.data(), packetSize, loopbackIP, port) )
+				break;
+
+			sent++;
+		}
+	}
+
+	const double sendTime = timeDouble() - startTime;
+
+	// wait for the receiver to drain the socket
+	uint64_t lastCount = 0;
+
+	do
+	{
+		lastCount = rx.packets;
+		usleep(200 * 1000);
+	} while( rx.packets != lastCount && rx.packets < sent );
+
+	const double recvTime = timeDouble() - startTime;
+
+	rx.stop = true;
+	thread.Stop(true);
+
+	LogInfo("detection-multicast:  %s (%u bytes)\n", batched ? "SendBatch/RecieveBatch" : "Send/Recieve", packetSize);
+	LogInfo("   -- sent        %u packets in %.1f ms  (%.0f packets/sec)\n", sent, sendTime, sent / (sendTime * 0.001));
+	LogInfo("   -- received    %llu packets  (%.0f packets/sec, %.2f%% lost)\n", (unsigned long long)rx.packets, 
+		   rx.packets / (recvTime * 0.001), (sent > 0) ? (double)(sent - rx.packets) / sent * 100.0 : 0.0);
+
+	delete rxSocket;
+	delete txSocket;
+
+	return true;
+}
+
+static bool benchmarkPublisher( uint32_t numFrames, uint32_t numDetections )
+{
+	detectionMulticastSubscriber* sub = detectionMulticastSubscriber::Create("127.0.0.1", 0);
+
+	if( !sub )
+		return false;
+
+	struct sockaddr_in addr;
+	socklen_t addrLen = sizeof(addr);
+	getsockname(sub->GetSocket()->GetFD(), (struct sockaddr*)&addr, &addrLen);
+
+	detectionMulticastPublisher* pub = detectionMulticastPublisher::Create("127.0.0.1", ntohs(addr.sin_port));
+
+	if( !pub )
+		return false;
+
+	std::vector<yoloNet::Detection> detections(numDetections);
+
+	for( uint32_t n=0; n < numDetections; n++ )
+	{
+		memset(&detections[n], 0, sizeof(yoloNet::Detection));
+
+		detections[n].ClassID = n % 80;
+		detections[n].Confidence = 0.5f;
+		detections[n].Left = n;
+		detections[n].Top = n;
+		detections[n].Right = n + 10;
+		detections[n].Bottom = n + 10;
+		detections[n].TrackID = -1;
+	}
+
+	// interleave publishing and receiving so the socket buffer doesn't overflow
+	const double startTime = timeDouble();
+	detectionStreamReader::Record record;
+
+	for( uint32_t n=0; n < numFrames && !signal_recieved; n++ )
+	{
+		pub->Publish(n, n, detections.data(), numDetections);
+
+		if( (n % 16) == 15 || n == numFrames - 1 )
+		{
+			while( sub->GetStats().framesReceived + sub->GetStats().framesLost + sub->GetStats().framesIncomplete < pub->GetFramesSent() )
+			{
+				if( !sub->Receive(&record, 100) )
+					break;
+			}
+		}
+	}
+
+	const double elapsed = timeDouble() - startTime;
+	const detectionMulticastSubscriber::Stats& stats = sub->GetStats();
+
+	LogInfo("detection-multicast:  publisher -> subscriber (%u detections per frame)\n", numDetections);
+	LogInfo("   -- sent        %llu frames in %llu packets  (%.0f frames/sec, %.0f packets/sec)\n",
+		   (unsigned long long)pub->GetFramesSent(), (unsigned long long)pub->GetPacketsSent(),
+		   pub->GetFramesSent() / (elapsed * 0.001), pub->GetPacketsSent() / (elapsed * 0.001));
+	LogInfo("   -- received    %llu frames  (%llu lost, %llu incomplete)\n", (unsigned long long)stats.framesReceived,
+		   (unsigned long long)stats.framesLost, (unsigned long long)stats.framesIncomplete);
+
+	delete pub;
+	delete sub;
+
+	return true;
+}
+
+
+int main( int argc, char** argv )
+{
+	/*
+	 * parse command line
+	 */
+	commandLine cmdLine(argc, argv);
+
+	if( cmdLine.GetFlag("help") )
+		return usage();
+
+	/*
+	 * attach signal handler
+	 */
+	if( signal(SIGINT, sig_handler) == SIG_ERR )
+		LogError("can't catch SIGINT\n");
+
+	/*
+	 * loopback benchmark
+	 */
+	if( cmdLine.GetFlag("benchmark") )
+	{
+		const uint32_t numPackets = cmdLine.GetUnsignedInt("packets", 200000);
+		const uint32_t packetSize = cmdLine.GetUnsignedInt("size", 256);
+		const uint32_t batchSize = cmdLine.GetUnsignedInt("batch", 32);
+
+		if( packetSize == 0 || packetSize > 65507 || batchSize == 0 )
+			return usage();
+
+		if( !benchmarkSockets(false, numPackets, packetSize, batchSize) ||
+		    !benchmarkSockets(true, numPackets, packetSize, batchSize) ||
+		    !benchmarkPublisher(numPackets / 10, cmdLine.GetUnsignedInt("detections", 100)) )
+			return 1;
+
+		return 0;
+	}
+
+	/*
+	 * subscribe to the detections
+	 */
+	uint32_t groupIP = 0;
+	uint16_t port = 0;
+
+	if( !detectionMulticast::ParseAddress(cmdLine.GetPosition(0), &groupIP, &port) )
+		return usage();
+
+	detectionMulticastSubscriber* sub = detectionMulticastSubscriber::Create(IPv4AddressToStr(groupIP).c_str(), port,
+															   cmdLine.GetString("multicast-interface"));
+
+	if( !sub )
+	{
+		LogError("detection-multicast:  failed to subscribe to %s:%hu\n", IPv4AddressToStr(groupIP).c_str(), port);
+		return 1;
+	}
+
+	double statsTime = timeDouble();
+
+	while( !signal_recieved )
+	{
+		detectionStreamReader::Record record;
+
+		if( sub->Receive(&record, 1000) )
+		{
+			LogVerbose("frame %llu  timestamp %llu  %u detections\n", (unsigned long long)record.frame,
+					 (unsigned long long)record.timestamp, record.numDetections);
+
+			for( uint32_t n=0; n < record.numDetections; n++ )
+				LogVerbose("   class %u  confidence %.3f  (%.1f, %.1f, %.1f, %.1f)  track %i\n", record.classID[n], record.confidence[n],
+						 record.left[n], record.top[n], record.right[n], record.bottom[n], record.trackID[n]);
+		}
+
+		// print the loss statistics every few seconds
+		if( timeDouble() - statsTime >= 5000.0 )
+		{
+			const detectionMulticastSubscriber::Stats& stats = sub->GetStats();
+			const uint64_t missing = stats.framesLost + stats.framesIncomplete;
+			const uint64_t expected = stats.framesReceived + missing;
+
+			LogInfo("detection-multicast:  received %llu frames, %llu lost (%.2f%%), %llu incomplete, %llu packets dropped\n",
+				   (unsigned long long)stats.framesReceived, (unsigned long long)missing,
+				   (expected > 0) ? (double)missing / expected * 100.0 : 0.0,
+				   (unsigned long long)stats.framesIncomplete, (unsigned long long)stats.packetsDropped);
+
+			statsTime = timeDouble();
+		}
+	}
+
+	delete sub;
+	return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "modelDownloader.h"
+#include "commandLine.h"
+#include "logging.h"
+
+#include <strings.h>
+
+
+int usage()
+{
+	printf("usage: download-models [--help] [--all] [--type=TYPE] [--jobs=N] [--retries=N]\n");
+	printf("                       [--mirror=URL] [--cache=DIR] [model ...]\n\n");
+	printf("Download and install pre-trained models from networks/models.json.\n");
+	printf("The archives are downloaded concurrently, verified, and kept in a cache\n");
+	printf("so that reinstalling them doesn't need to download them again.\n\n");
+	printf("positional arguments:\n");
+	printf("    model           names (or aliases) of the models to download\n\n");
+	printf("optional arguments:\n");
+	printf("  --help            show this help message and exit\n");
+	printf("  --all             download all of the models (of --type if it's specified)\n");
+	printf("  --type=TYPE       only look for models of this type (e.g. detection, classification)\n");
+	printf("  --jobs=N          number of models to download at the same time (default: %i)\n", MODEL_DOWNLOADER_DEFAULT_JOBS);
+	printf("  --retries=N       number of times to try downloading each model (default: 2)\n");
+	printf("  --mirror=URL      base URL of a mirror to download the archives from (default: $%s)\n", MODEL_DOWNLOADER_MIRROR_ENV);
+	printf("  --cache=DIR       directory to cache the archives in (default: $%s or networks/.cache)\n\n", MODEL_DOWNLOADER_CACHE_ENV);
+	printf("%s", Log::Usage());
+
+	return 0;
+}
+
+
+int main( int argc, char** argv )
+{
+	/*
+	 * parse command line
+	 */
+	commandLine cmdLine(argc, argv);
+
+	if( cmdLine.GetFlag("help") )
+		return usage();
+
+	const bool all = cmdLine.GetFlag("all");
+	const char* type = cmdLine.GetString("type");
+
+	if( !all && cmdLine.GetPositionArgs() == 0 )
+		return usage();
+
+	if( cmdLine.GetString("mirror") != NULL )
+		SetModelMirror(cmdLine.GetString("mirror"));
+
+	if( cmdLine.GetString("cache") != NULL )
+		SetModelCache(cmdLine.GetString("cache"));
+
+	const uint32_t jobs = cmdLine.GetUnsignedInt("jobs", MODEL_DOWNLOADER_DEFAULT_JOBS);
+	const uint32_t retries = cmdLine.GetUnsignedInt("retries", 2);
+
+
+	/*
+	 * find the models in the manifest
+	 */
+	nlohmann::json manifest;
+
+	if( !LoadModelManifest(manifest) )
+		return 1;
+
+	std::vector<nlohmann::json> models;
+	bool result = true;
+
+	for( auto it=manifest.begin(); it != manifest.end(); it++ )
+	{
+		if( !it.value().is_object() || (type != NULL && strcasecmp(type, it.key().c_str()) != 0) )
+			continue;
+
+		if( all )
+		{
+			for( auto model=it.value().begin(); model != it.value().end(); model++ )
+				models.push_back(model.value());
+		}
+	}
+
+	for( unsigned int n=0; !all && n < cmdLine.GetPositionArgs(); n++ )
+	{
+		const char* name = cmdLine.GetPosition(n);
+		bool found = false;
+
+		for( auto it=manifest.begin(); it != manifest.end() && !found; it++ )
+		{
+			if( !it.value().is_object() || (type != NULL && strcasecmp(type, it.key().c_str()) != 0) )
+				continue;
+
+			nlohmann::json model;
+
+			if( FindModel(it.key().c_str(), name, manifest, model) )
+			{
+				models.push_back(model);
+				found = true;
+			}
+		}
+
+		if( !found )
+		{
+			LogError("download-models:  couldn't find model '%s' in the manifest\n", name);
+			result = false;
+		}
+	}
+
+	if( models.size() == 0 )
+	{
+		LogError("download-models:  no models to download\n");
+		return 1;
+	}
+
+
+	/*
+	 * download the models
+	 */
+	LogInfo("download-models:  installing %zu models\n", models.size());
+
+	if( !DownloadModels(models, retries, jobs) )
+		result = false;
+
+	return result ? 0 : 1;
+}
@@ -1,6 +1,9 @@
 #include "customNetwork.h"
 #include <jetson-utils/logging.h>
 
+#include <algorithm>
+#include <cstdio>
+
 // static 변수 정의
 std::atomic<int> MqttHeartbeatSender::totalFrames(0);
 std::atomic<int> MqttHeartbeatSender::totalDetections(0);
@@ -153,61 +156,19 @@ float MqttHeartbeatSender::getInferenceSuccessRate() {
 }
 
 float MqttHeartbeatSender::getCpuUsage() {
-    static long prevTotal = 0, prevIdle = 0;
-
-    std::ifstream file("/proc/stat");
-    if (!file.is_open()) return 0.0f;
-
-    std::string line;
-    std::getline(file, line);
-    std::istringstream iss(line);
-
-    std::string cpu;
-    long user, nice, system, idle, iowait, irq, softirq, steal;
-    iss >> cpu >> user >> nice >> system >> idle >> iowait >> irq >> softirq >> steal;
-
-    long total = user + nice + system + idle + iowait + irq + softirq + steal;
-    long totalIdle = idle + iowait;
-
-    long totalDiff = total - prevTotal;
-    long idleDiff = totalIdle - prevIdle;
-
-    float cpuPercent = 0.0f;
-    if (totalDiff > 0) {
-        cpuPercent = 100.0f * (totalDiff - idleDiff) / totalDiff;
-    }
-
-    prevTotal = total;
-    prevIdle = totalIdle;
-
-    return cpuPercent;
+    return stats.cpuUsage();
 }
 
 float MqttHeartbeatSender::getGpuUsage() {
-    std::ifstream file("/sys/devices/platform/bus@0/17000000.gpu/load");
-    if (!file.is_open()) return 0.0f;
-
-    int load;
-    file >> load;
-    return (float)load;
+    return stats.gpuUsage();
 }
 
 float MqttHeartbeatSender::getMemoryUsage() {
-    struct sysinfo info;
-    if (sysinfo(&info) != 0) return 0.0f;
-
-    float total = info.totalram;
-    float free = info.freeram + info.bufferram;
-    return ((total - free) / total) * 100.0f;
+    return stats.memoryUsage();
 }
 
 float MqttHeartbeatSender::getCpuTemperature() {
-    std::ifstream file("/sys/devices/virtual/thermal/thermal_zone0/temp");
-    if (!file.is_open()) return 0.0f;
-
-    int temp;
-    file >> temp;
-    return temp / 1000.0f; // 밀리도를 도로 변환
+    return stats.temperature();
 }
 
 std::string MqttHeartbeatSender::createHeartbeatJson() {
@@ -219,16 +180,13 @@ std::string MqttHeartbeatSender::createHeartbeatJson() {
     float inferenceFps = getInferenceFps();
     float inferenceSuccessRate = getInferenceSuccessRate();
 
-    std::ostringstream json;
-    json << "{";
-    json << "\"cpuUsage\":" << cpuUsage << ",";
-    json << "\"gpuUsage\":" << gpuUsage << ",";
-    json << "\"memoryUsage\":" << memoryUsage << ",";
-    json << "\"temperature\":" << temperature << ",";
-    json << "\"inferenceFps\":" << inferenceFps << ",";
-    json << "\"inferenceSuccessRate\":" << inferenceSuccessRate;
-    json << "}";
-    return json.str();
+    char json[256];
+    const int len = snprintf(json, sizeof(json),
+        "{\"cpuUsage\":%g,\"gpuUsage\":%g,\"memoryUsage\":%g,\"temperature\":%g,"
+        "\"inferenceFps\":%g,\"inferenceSuccessRate\":%g}",
+        cpuUsage, gpuUsage, memoryUsage, temperature, inferenceFps, inferenceSuccessRate);
+
+    return std::string(json, std::max(0, std::min(len, (int)sizeof(json) - 1)));
 }
 
 
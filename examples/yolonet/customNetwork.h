@@ -17,6 +17,8 @@
 #include <chrono>
 #include <sys/sysinfo.h>
 
+#include "telemetry.h"
+
 
 class AlertSender {
 private:
@@ -57,6 +59,8 @@ private:
     float getCpuTemperature();
     std::string createHeartbeatJson();
 
+    SystemStatsReader stats;    // /proc, sysfs 파일을 열어둔 채로 재사용
+
     MQTTClient client;
     std::string broker_address;
     std::string topic;
@@ -0,0 +1,605 @@
+#include "telemetry.h"
+
+#include <jetson-utils/logging.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/sysinfo.h>
+
+
+const char* telemetryStageToStr(TelemetryStage stage) {
+    switch (stage) {
+        case TELEMETRY_CAPTURE: return "capture";
+        case TELEMETRY_DETECT:  return "detect";
+        case TELEMETRY_RENDER:  return "render";
+        default:                return "unknown";
+    }
+}
+
+
+// RollingCounter
+RollingCounter::RollingCounter(int windowSeconds)
+    : mWindow(std::max(1, std::min(windowSeconds, NUM_BUCKETS - 1))) {
+    for (int n = 0; n < NUM_BUCKETS; n++)
+        mBuckets[n].value = EMPTY_BUCKET;
+}
+
+int64_t RollingCounter::nowSeconds() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void RollingCounter::add(uint32_t count) {
+    const int64_t sec = nowSeconds();
+    Bucket& bucket = mBuckets[sec % NUM_BUCKETS];
+
+    const uint64_t stamp = (uint64_t)(uint32_t)sec << 32;
+    uint64_t value = bucket.value.load(std::memory_order_relaxed);
+    uint64_t next;
+
+    // 버킷이 이전 주기의 것이면 카운트를 새로 시작한다 (초와 카운트를 한 번에 바꾸므로 다른 스레드의 add가 사라지지 않음)
+    do {
+        if ((value >> 32) == (uint32_t)sec)
+            next = value + std::min<uint64_t>(count, 0xFFFFFFFFu - (uint32_t)value);
+        else
+            next = stamp | count;
+    } while (!bucket.value.compare_exchange_weak(value, next, std::memory_order_relaxed));
+}
+
+float RollingCounter::rate() const {
+    const int64_t sec = nowSeconds();
+    uint64_t total = 0;
+
+    for (int n = 1; n <= mWindow; n++) {
+        const uint64_t value = mBuckets[(sec - n) % NUM_BUCKETS].value.load(std::memory_order_relaxed);
+
+        if ((value >> 32) == (uint32_t)(sec - n))
+            total += (uint32_t)value;
+    }
+
+    return (float)total / mWindow;
+}
+
+
+// LatencyWindow
+LatencyWindow::LatencyWindow() : mHead(0) {
+    for (uint32_t n = 0; n < NUM_SAMPLES; n++)
+        mSamples[n] = 0.0f;
+}
+
+void LatencyWindow::add(float ms) {
+    const uint32_t idx = mHead.fetch_add(1, std::memory_order_relaxed);
+    mSamples[idx % NUM_SAMPLES].store(ms, std::memory_order_relaxed);
+}
+
+LatencyWindow::Percentiles LatencyWindow::percentiles() const {
+    Percentiles result;
+    memset(&result, 0, sizeof(result));
+
+    const uint32_t count = std::min(mHead.load(std::memory_order_relaxed), NUM_SAMPLES);
+
+    if (count == 0)
+        return result;
+
+    float samples[NUM_SAMPLES];
+
+    for (uint32_t n = 0; n < count; n++)
+        samples[n] = mSamples[n].load(std::memory_order_relaxed);
+
+    // nth_element는 순서대로 호출하면 앞 구간을 다시 정렬하지 않아도 된다
+    const uint32_t i50 = (count - 1) * 50 / 100;
+    const uint32_t i90 = (count - 1) * 90 / 100;
+    const uint32_t i99 = (count - 1) * 99 / 100;
+
+    std::nth_element(samples, samples + i50, samples + count);
+    std::nth_element(samples + i50, samples + i90, samples + count);
+    std::nth_element(samples + i90, samples + i99, samples + count);
+
+    result.p50 = samples[i50];
+    result.p90 = samples[i90];
+    result.p99 = samples[i99];
+    result.max = *std::max_element(samples + i99, samples + count);
+    result.count = count;
+
+    return result;
+}
+
+
+// SystemStatsReader
+static const char* cpuStatPaths[] = { "/proc/stat", NULL };
+
+static const char* gpuLoadPaths[] = {
+    "/sys/devices/platform/bus@0/17000000.gpu/load",   // Orin
+    "/sys/devices/gpu.0/load",                         // Xavier / Nano
+    NULL
+};
+
+static const char* thermalPaths[] = { "/sys/devices/virtual/thermal/thermal_zone0/temp", NULL };
+
+SystemStatsReader::SystemStatsReader() : mPrevTotal(0), mPrevIdle(0) {
+    mCpuFd = openFirst(cpuStatPaths);
+    mGpuFd = openFirst(gpuLoadPaths);
+    mThermalFd = openFirst(thermalPaths);
+}
+
+SystemStatsReader::~SystemStatsReader() {
+    if (mCpuFd >= 0) close(mCpuFd);
+    if (mGpuFd >= 0) close(mGpuFd);
+    if (mThermalFd >= 0) close(mThermalFd);
+}
+
+int SystemStatsReader::openFirst(const char** paths) {
+    for (int n = 0; paths[n] != NULL; n++) {
+        const int fd = open(paths[n], O_RDONLY | O_CLOEXEC);
+
+        if (fd >= 0)
+            return fd;
+    }
+
+    return -1;
+}
+
+bool SystemStatsReader::readFile(int fd, char* buffer, size_t size) {
+    if (fd < 0)
+        return false;
+
+    // procfs/sysfs는 offset 0에서 다시 읽으면 최신 값을 돌려준다
+    const ssize_t bytes = pread(fd, buffer, size - 1, 0);
+
+    if (bytes <= 0)
+        return false;
+
+    buffer[bytes] = '\0';
+    return true;
+}
+
+float SystemStatsReader::cpuUsage() {
+    char buffer[256];   // 첫 줄(cpu 합계)만 필요
+
+    if (!readFile(mCpuFd, buffer, sizeof(buffer)) || strncmp(buffer, "cpu ", 4) != 0)
+        return 0.0f;
+
+    // user nice system idle iowait irq softirq steal
+    unsigned long long values[8] = {0};
+    char* ptr = buffer + 4;
+
+    for (int n = 0; n < 8; n++)
+        values[n] = strtoull(ptr, &ptr, 10);
+
+    unsigned long long total = 0;
+
+    for (int n = 0; n < 8; n++)
+        total += values[n];
+
+    const unsigned long long idle = values[3] + values[4];
+
+    const unsigned long long totalDiff = total - mPrevTotal;
+    const unsigned long long idleDiff = idle - mPrevIdle;
+
+    mPrevTotal = total;
+    mPrevIdle = idle;
+
+    if (totalDiff == 0)
+        return 0.0f;
+
+    return 100.0f * (float)(totalDiff - idleDiff) / (float)totalDiff;
+}
+
+float SystemStatsReader::gpuUsage() {
+    char buffer[32];
+
+    if (!readFile(mGpuFd, buffer, sizeof(buffer)))
+        return 0.0f;
+
+    return (float)strtol(buffer, NULL, 10);
+}
+
+float SystemStatsReader::memoryUsage() {
+    struct sysinfo info;
+
+    if (sysinfo(&info) != 0 || info.totalram == 0)
+        return 0.0f;
+
+    const float total = info.totalram;
+    const float free = info.freeram + info.bufferram;
+    return ((total - free) / total) * 100.0f;
+}
+
+float SystemStatsReader::temperature() {
+    char buffer[32];
+
+    if (!readFile(mThermalFd, buffer, sizeof(buffer)))
+        return 0.0f;
+
+    return strtol(buffer, NULL, 10) / 1000.0f;  // 밀리도를 도로 변환
+}
+
+
+// TelemetryPublisher
+TelemetryPublisher::Options::Options()
+    : clientId("jetson_telemetry"), topic("telemetry/data"),
+      sampleIntervalMs(1000), batchSize(10), maxQueuedSamples(600),
+      maxInflight(4), reconnectMaxMs(60000), shutdownTimeoutMs(5000), qos(1) {}
+
+TelemetryPublisher::TelemetryPublisher(const Options& options)
+    : mOptions(options), mClient(NULL), mEventLoop(NULL), mSampleTimer(0), mRunning(false), mConnected(false), mConnecting(false),
+      mInflight(0), mDropped(0), mPublished(0), mReconnectDelayMs(1000) {
+    if (mOptions.batchSize == 0) mOptions.batchSize = 1;
+    if (mOptions.maxInflight == 0) mOptions.maxInflight = 1;
+    if (mOptions.maxQueuedSamples < mOptions.batchSize) mOptions.maxQueuedSamples = mOptions.batchSize;
+    if (mOptions.sampleIntervalMs == 0) mOptions.sampleIntervalMs = 1000;
+}
+
+TelemetryPublisher::~TelemetryPublisher() {
+    stop();
+
+    if (mClient != NULL)
+        MQTTAsync_destroy(&mClient);
+
+    if (mEventLoop != NULL)
+        mEventLoop->Release();
+}
+
+TelemetryPublisher* TelemetryPublisher::Create(const Options& options) {
+    TelemetryPublisher* publisher = new TelemetryPublisher(options);
+
+    if (!publisher->init()) {
+        delete publisher;
+        return NULL;
+    }
+
+    return publisher;
+}
+
+bool TelemetryPublisher::init() {
+    int rc = MQTTAsync_create(&mClient, mOptions.address.c_str(), mOptions.clientId.c_str(), MQTTCLIENT_PERSISTENCE_NONE, NULL);
+
+    if (rc != MQTTASYNC_SUCCESS) {
+        LogError("telemetry:  failed to create MQTT client for %s (%d)\n", mOptions.address.c_str(), rc);
+        mClient = NULL;
+        return false;
+    }
+
+    MQTTAsync_setCallbacks(mClient, this, onConnectionLost, onMessageArrived, NULL);
+    MQTTAsync_setConnected(mClient, this, onReconnected);
+
+    mEventLoop = EventLoop::Acquire();
+
+    if (!mEventLoop) {
+        LogError("telemetry:  failed to acquire an event loop\n");
+        return false;
+    }
+
+    mNextConnect = std::chrono::steady_clock::now();
+    mRunning = true;
+
+    // 첫 연결은 바로 시도하고, 이후로는 샘플링 타이머가 깨운다
+    mSampleTimer = mEventLoop->AddTimeout(mOptions.sampleIntervalMs, onSampleTimer, this);
+    wake();
+
+    LogVerbose("telemetry:  publishing to %s (topic '%s', every %ums, batch %u)\n",
+               mOptions.address.c_str(), mOptions.topic.c_str(), mOptions.sampleIntervalMs, mOptions.batchSize);
+    return true;
+}
+
+void TelemetryPublisher::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        if (!mRunning.exchange(false))
+            return;
+    }
+
+    if (mSampleTimer != 0) {
+        mEventLoop->RemoveSource(mSampleTimer);
+        mSampleTimer = 0;
+    }
+
+    // 이미 예약된 콜백이 모두 끝날 때까지 대기 (mRunning이 false이므로 onService는 바로 반환)
+    mEventLoop->Invoke(onService, this, true);
+
+    // 남은 샘플을 모두 내보내고 연결 해제 (inflight 한도에 걸리면 응답이 올 때까지 shutdownTimeoutMs까지 대기)
+    if (mConnected) {
+        const std::chrono::steady_clock::time_point deadline =
+            std::chrono::steady_clock::now() + std::chrono::milliseconds(mOptions.shutdownTimeoutMs);
+
+        while (true) {
+            while (mConnected && publishBatch()) {}
+
+            std::unique_lock<std::mutex> lock(mMutex);
+
+            if (!mConnected || (mQueue.empty() && mInflight == 0))
+                break;
+
+            if (mInflightCond.wait_until(lock, deadline) == std::cv_status::timeout)
+                break;
+        }
+
+        MQTTAsync_disconnectOptions opts = MQTTAsync_disconnectOptions_initializer;
+        opts.timeout = 2000;
+        MQTTAsync_disconnect(mClient, &opts);
+        mConnected = false;
+    }
+
+    if (!mQueue.empty())
+        LogWarning("telemetry:  %zu samples were not published before shutdown\n", mQueue.size());
+}
+
+// MQTT 콜백 스레드에서 호출: 이벤트 루프에 service()를 예약
+void TelemetryPublisher::wake() {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (mRunning)
+        mEventLoop->Invoke(onService, this);
+}
+
+// 이벤트 루프에서 호출: 재연결과 밀린 배치 전송
+void TelemetryPublisher::service() {
+    if (!mConnected && !mConnecting) {
+        bool retry;
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            retry = (std::chrono::steady_clock::now() >= mNextConnect);
+        }
+
+        if (retry)
+            connectAsync();
+    }
+
+    // 배치가 찼거나 연결이 복구되어 밀린 샘플이 있으면 inflight 한도까지 전송
+    while (mConnected && publishBatch()) {}
+}
+
+gboolean TelemetryPublisher::onSampleTimer(void* user_data) {
+    TelemetryPublisher* publisher = (TelemetryPublisher*)user_data;
+
+    if (!publisher->mRunning)
+        return G_SOURCE_REMOVE;
+
+    // GLib 타이머는 밀린 호출을 몰아서 실행하지 않는다
+    publisher->takeSample();
+    publisher->service();
+
+    return G_SOURCE_CONTINUE;
+}
+
+gboolean TelemetryPublisher::onService(void* user_data) {
+    TelemetryPublisher* publisher = (TelemetryPublisher*)user_data;
+
+    if (publisher->mRunning)
+        publisher->service();
+
+    return G_SOURCE_REMOVE;
+}
+
+void TelemetryPublisher::takeSample() {
+    TelemetrySample sample;
+
+    sample.timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    sample.cpuUsage = mStats.cpuUsage();
+    sample.gpuUsage = mStats.gpuUsage();
+    sample.memoryUsage = mStats.memoryUsage();
+    sample.temperature = mStats.temperature();
+    sample.fps = mFrames.rate();
+    sample.detectionsPerSec = mDetections.rate();
+
+    for (int n = 0; n < TELEMETRY_NUM_STAGES; n++)
+        sample.latency[n] = mLatency[n].percentiles();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    // 브로커가 응답하지 않는 동안에는 가장 오래된 샘플부터 버린다
+    if (mQueue.size() >= mOptions.maxQueuedSamples) {
+        mQueue.pop_front();
+        mDropped++;
+    }
+
+    mQueue.push_back(sample);
+}
+
+void TelemetryPublisher::connectAsync() {
+    MQTTAsync_connectOptions opts = MQTTAsync_connectOptions_initializer;
+
+    opts.keepAliveInterval = 20;
+    opts.cleansession = 1;
+    opts.connectTimeout = 5;
+    opts.automaticReconnect = 1;
+    opts.minRetryInterval = 1;
+    opts.maxRetryInterval = std::max(1u, mOptions.reconnectMaxMs / 1000);
+    opts.onSuccess = onConnect;
+    opts.onFailure = onConnectFailure;
+    opts.context = this;
+
+    mConnecting = true;
+
+    const int rc = MQTTAsync_connect(mClient, &opts);
+
+    if (rc != MQTTASYNC_SUCCESS) {
+        LogError("telemetry:  failed to start MQTT connect (%d)\n", rc);
+        onConnectFailure(this, NULL);
+    }
+}
+
+bool TelemetryPublisher::publishBatch() {
+    if (mInflight >= mOptions.maxInflight)
+        return false;
+
+    std::string json;
+    uint32_t count = 0;
+    uint32_t appended = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        if (mQueue.empty())
+            return false;
+
+        // 실행 중에는 배치가 찰 때까지 기다리고, 종료 시에는 남은 것을 모두 보낸다
+        if (mRunning && mQueue.size() < mOptions.batchSize)
+            return false;
+
+        count = std::min<uint32_t>(mQueue.size(), mOptions.batchSize);
+        json.reserve(count * 512 + 64);
+        json += "{\"samples\":[";
+
+        // 구분자는 샘플이 포맷된 뒤에만 붙인다 (포맷에 실패한 샘플은 빠진다)
+        for (uint32_t n = 0; n < count; n++) {
+            if (appendSampleJson(json, mQueue[n], appended > 0))
+                appended++;
+        }
+
+        json += "]}";
+    }
+
+    MQTTAsync_message msg = MQTTAsync_message_initializer;
+    msg.payload = (void*)json.c_str();
+    msg.payloadlen = (int)json.length();
+    msg.qos = mOptions.qos;
+    msg.retained = 0;
+
+    MQTTAsync_responseOptions opts = MQTTAsync_responseOptions_initializer;
+    opts.onSuccess = onSend;
+    opts.onFailure = onSendFailure;
+    opts.context = this;
+
+    // sendMessage는 payload를 복사하므로 json은 여기서 해제되어도 된다
+    mInflight++;
+
+    const int rc = MQTTAsync_sendMessage(mClient, mOptions.topic.c_str(), &msg, &opts);
+
+    if (rc != MQTTASYNC_SUCCESS) {
+        releaseInflight();
+        LogVerbose("telemetry:  publish failed (%d), keeping %u samples queued\n", rc, count);
+        return false;
+    }
+
+    // 전송이 시작된 샘플만 큐에서 제거 (실패 시 QoS 재전송은 클라이언트가 담당)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQueue.erase(mQueue.begin(), mQueue.begin() + std::min<size_t>(count, mQueue.size()));
+    }
+
+    mPublished += appended;
+    mDropped += count - appended;
+    return true;
+}
+
+bool TelemetryPublisher::appendSampleJson(std::string& json, const TelemetrySample& sample, bool separator) const {
+    char buffer[512];
+
+    int len = snprintf(buffer, sizeof(buffer),
+        "{\"timestamp\":%llu,\"cpuUsage\":%.1f,\"gpuUsage\":%.1f,\"memoryUsage\":%.1f,"
+        "\"temperature\":%.1f,\"inferenceFps\":%.2f,\"detectionsPerSec\":%.2f,\"latency\":{",
+        (unsigned long long)sample.timestamp, sample.cpuUsage, sample.gpuUsage, sample.memoryUsage,
+        sample.temperature, sample.fps, sample.detectionsPerSec);
+
+    for (int n = 0; n < TELEMETRY_NUM_STAGES && len > 0 && len < (int)sizeof(buffer); n++) {
+        const LatencyWindow::Percentiles& p = sample.latency[n];
+
+        len += snprintf(buffer + len, sizeof(buffer) - len,
+            "%s\"%s\":{\"p50\":%.2f,\"p90\":%.2f,\"p99\":%.2f,\"max\":%.2f}",
+            (n > 0) ? "," : "", telemetryStageToStr((TelemetryStage)n), p.p50, p.p90, p.p99, p.max);
+    }
+
+    if (len <= 0 || len >= (int)sizeof(buffer))
+        return false;
+
+    if (separator)
+        json += ',';
+
+    json.append(buffer, len);
+    json += "}}";
+    return true;
+}
+
+void TelemetryPublisher::onConnect(void* context, MQTTAsync_successData* response) {
+    TelemetryPublisher* publisher = (TelemetryPublisher*)context;
+
+    publisher->mConnected = true;
+    publisher->mConnecting = false;
+    publisher->mReconnectDelayMs = 1000;
+    publisher->wake();
+
+    LogVerbose("telemetry:  connected to %s\n", publisher->mOptions.address.c_str());
+}
+
+void TelemetryPublisher::onConnectFailure(void* context, MQTTAsync_failureData* response) {
+    TelemetryPublisher* publisher = (TelemetryPublisher*)context;
+
+    // 지수 backoff 후 재시도, 그동안 샘플은 큐에 쌓인다
+    std::lock_guard<std::mutex> lock(publisher->mMutex);
+
+    publisher->mNextConnect = std::chrono::steady_clock::now() + std::chrono::milliseconds(publisher->mReconnectDelayMs);
+    publisher->mReconnectDelayMs = std::min(publisher->mReconnectDelayMs * 2, std::max(1000u, publisher->mOptions.reconnectMaxMs));
+    publisher->mConnecting = false;
+
+    LogVerbose("telemetry:  connection to %s failed (%d), retrying later\n",
+               publisher->mOptions.address.c_str(), response ? response->code : -1);
+}
+
+void TelemetryPublisher::onConnectionLost(void* context, char* cause) {
+    TelemetryPublisher* publisher = (TelemetryPublisher*)context;
+
+    // automaticReconnect가 켜져 있으므로 클라이언트가 직접 재연결한다
+    publisher->mConnected = false;
+    publisher->mConnecting = true;
+    publisher->mInflight.store(0);
+    publisher->notifyInflight();
+
+    LogWarning("telemetry:  connection lost (%s)\n", cause ? cause : "unknown");
+}
+
+void TelemetryPublisher::onReconnected(void* context, char* cause) {
+    TelemetryPublisher* publisher = (TelemetryPublisher*)context;
+
+    publisher->mConnected = true;
+    publisher->mConnecting = false;
+    publisher->wake();
+
+    LogVerbose("telemetry:  reconnected to %s\n", publisher->mOptions.address.c_str());
+}
+
+int TelemetryPublisher::onMessageArrived(void* context, char* topic, int topicLen, MQTTAsync_message* message) {
+    // 구독하지 않으므로 받은 메시지는 바로 해제
+    MQTTAsync_freeMessage(&message);
+    MQTTAsync_free(topic);
+    return 1;
+}
+
+// onConnectionLost가 0으로 되돌린 뒤에 응답이 와도 음수(wrap)가 되지 않도록 CAS로 감소
+void TelemetryPublisher::releaseInflight() {
+    uint32_t inflight = mInflight.load();
+
+    while (inflight > 0 && !mInflight.compare_exchange_weak(inflight, inflight - 1)) {}
+
+    notifyInflight();
+}
+
+// stop()이 조건을 확인한 뒤 대기하기 전에 알림이 사라지지 않도록 mMutex를 한 번 거친다
+void TelemetryPublisher::notifyInflight() {
+    { std::lock_guard<std::mutex> lock(mMutex); }
+    mInflightCond.notify_all();
+}
+
+void TelemetryPublisher::onSend(void* context, MQTTAsync_successData* response) {
+    TelemetryPublisher* publisher = (TelemetryPublisher*)context;
+
+    publisher->releaseInflight();
+    publisher->wake();
+}
+
+void TelemetryPublisher::onSendFailure(void* context, MQTTAsync_failureData* response) {
+    TelemetryPublisher* publisher = (TelemetryPublisher*)context;
+
+    publisher->releaseInflight();
+
+    LogVerbose("telemetry:  publish was not acknowledged (%d)\n", response ? response->code : -1);
+}
@@ -0,0 +1,229 @@
+#ifndef __TELEMETRY_H__
+#define __TELEMETRY_H__
+
+#include <MQTTAsync.h>
+#include <jetson-utils/EventLoop.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+
+// 지연 시간을 측정하는 파이프라인 단계
+enum TelemetryStage {
+    TELEMETRY_CAPTURE = 0,
+    TELEMETRY_DETECT,
+    TELEMETRY_RENDER,
+    TELEMETRY_NUM_STAGES
+};
+
+const char* telemetryStageToStr(TelemetryStage stage);
+
+
+// 초 단위 버킷으로 최근 N초 동안의 이벤트 수를 유지 (lock-free, 여러 스레드에서 Add 가능)
+class RollingCounter {
+public:
+    static const int NUM_BUCKETS = 16;
+
+    RollingCounter(int windowSeconds = 5);
+
+    void add(uint32_t count = 1);
+
+    // 현재 진행 중인 초를 제외한 최근 windowSeconds 동안의 초당 평균
+    float rate() const;
+
+private:
+    // 상위 32비트는 버킷의 초, 하위 32비트는 카운트 (초가 바뀔 때 한 번의 CAS로 함께 초기화)
+    struct Bucket {
+        std::atomic<uint64_t> value;
+    };
+
+    static const uint64_t EMPTY_BUCKET = 0xFFFFFFFFull << 32;
+
+    static int64_t nowSeconds();
+
+    Bucket mBuckets[NUM_BUCKETS];
+    int mWindow;
+};
+
+
+// 최근 N개의 지연 시간 샘플을 링 버퍼로 유지하고 백분위수를 계산
+class LatencyWindow {
+public:
+    static const uint32_t NUM_SAMPLES = 512;
+
+    struct Percentiles {
+        float p50;
+        float p90;
+        float p99;
+        float max;
+        uint32_t count;
+    };
+
+    LatencyWindow();
+
+    void add(float ms);
+
+    Percentiles percentiles() const;
+
+private:
+    std::atomic<float>    mSamples[NUM_SAMPLES];
+    std::atomic<uint32_t> mHead;
+};
+
+
+// /proc/stat, GPU load, thermal zone 파일을 한 번만 열어두고 pread로 다시 읽음
+class SystemStatsReader {
+public:
+    SystemStatsReader();
+    ~SystemStatsReader();
+
+    float cpuUsage();
+    float gpuUsage();
+    float memoryUsage();
+    float temperature();
+
+private:
+    static int  openFirst(const char** paths);
+    static bool readFile(int fd, char* buffer, size_t size);
+
+    int mCpuFd;
+    int mGpuFd;
+    int mThermalFd;
+
+    unsigned long long mPrevTotal;
+    unsigned long long mPrevIdle;
+};
+
+
+// 한 번의 샘플링 결과
+struct TelemetrySample {
+    uint64_t timestamp;    // epoch 기준 ms
+    float cpuUsage;
+    float gpuUsage;
+    float memoryUsage;
+    float temperature;
+    float fps;
+    float detectionsPerSec;
+    LatencyWindow::Percentiles latency[TELEMETRY_NUM_STAGES];
+};
+
+
+// 시스템 상태를 자체 주기로 샘플링하고, 여러 샘플을 묶어 MQTTAsync로 비동기 전송.
+// 브로커에 연결할 수 없으면 샘플을 제한된 큐에 보관하고 가장 오래된 것부터 버린다.
+class TelemetryPublisher {
+public:
+    struct Options {
+        std::string address;             // 예: tcp://localhost:1883
+        std::string clientId;
+        std::string topic;
+        uint32_t sampleIntervalMs;       // 샘플링 주기
+        uint32_t batchSize;              // 한 번의 publish에 묶을 샘플 수
+        uint32_t maxQueuedSamples;       // 연결이 끊겼을 때 보관할 최대 샘플 수
+        uint32_t maxInflight;            // 응답을 기다리는 최대 publish 수
+        uint32_t reconnectMaxMs;         // 재연결 backoff 상한
+        uint32_t shutdownTimeoutMs;      // stop()에서 남은 샘플이 전송되기를 기다리는 최대 시간
+        int qos;
+
+        Options();
+    };
+
+    static TelemetryPublisher* Create(const Options& options);
+
+    ~TelemetryPublisher();
+
+    // 추론 루프에서 호출 (hot path, lock-free)
+    inline void recordFrame()                                  { mFrames.add(1); }
+    inline void recordDetections(uint32_t count)               { if (count > 0) mDetections.add(count); }
+    inline void recordLatency(TelemetryStage stage, float ms)  { mLatency[stage].add(ms); }
+
+    inline bool isConnected() const                            { return mConnected.load(); }
+    inline uint64_t getDroppedSamples() const                  { return mDropped.load(); }
+    inline uint64_t getPublishedSamples() const                { return mPublished.load(); }
+
+    // 큐에 남은 샘플을 전송하고 (응답을 최대 shutdownTimeoutMs까지 기다림) 타이머를 해제
+    void stop();
+
+private:
+    TelemetryPublisher(const Options& options);
+
+    bool init();
+    void wake();
+    void service();
+
+    void takeSample();
+    void connectAsync();
+    bool publishBatch();
+
+    void releaseInflight();
+    void notifyInflight();
+
+    // 포맷에 성공하면 (separator이면 ','와 함께) json에 붙이고 true를 반환
+    bool appendSampleJson(std::string& json, const TelemetrySample& sample, bool separator) const;
+
+    // MQTTAsync 콜백
+    static void onConnect(void* context, MQTTAsync_successData* response);
+    static void onConnectFailure(void* context, MQTTAsync_failureData* response);
+    static void onConnectionLost(void* context, char* cause);
+    static void onReconnected(void* context, char* cause);
+    static int  onMessageArrived(void* context, char* topic, int topicLen, MQTTAsync_message* message);
+    static void onSend(void* context, MQTTAsync_successData* response);
+    static void onSendFailure(void* context, MQTTAsync_failureData* response);
+
+    // EventLoop 콜백
+    static gboolean onSampleTimer(void* user_data);
+    static gboolean onService(void* user_data);
+
+    Options mOptions;
+    MQTTAsync mClient;
+
+    SystemStatsReader mStats;
+    RollingCounter mFrames;
+    RollingCounter mDetections;
+    LatencyWindow  mLatency[TELEMETRY_NUM_STAGES];
+
+    std::deque<TelemetrySample> mQueue;
+    std::mutex mMutex;
+    std::condition_variable mInflightCond;  // mInflight가 줄어들면 알림 (stop()에서 대기)
+
+    // 샘플링과 전송은 공유 이벤트 루프에서 실행 (전용 스레드 없음)
+    EventLoop* mEventLoop;
+    uint32_t mSampleTimer;
+
+    std::atomic<bool> mRunning;
+    std::atomic<bool> mConnected;
+    std::atomic<bool> mConnecting;
+    std::atomic<uint32_t> mInflight;
+    std::atomic<uint64_t> mDropped;
+    std::atomic<uint64_t> mPublished;
+
+    uint32_t mReconnectDelayMs;
+    std::chrono::steady_clock::time_point mNextConnect;
+};
+
+
+// 블록이 끝날 때 단계별 지연 시간을 기록 (publisher가 NULL이면 아무 것도 하지 않음)
+class TelemetryTimer {
+public:
+    TelemetryTimer(TelemetryPublisher* publisher, TelemetryStage stage)
+        : mPublisher(publisher), mStage(stage), mStart(std::chrono::steady_clock::now()) {}
+
+    ~TelemetryTimer() {
+        if (mPublisher) {
+            const std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - mStart;
+            mPublisher->recordLatency(mStage, elapsed.count());
+        }
+    }
+
+private:
+    TelemetryPublisher* mPublisher;
+    TelemetryStage mStage;
+    std::chrono::steady_clock::time_point mStart;
+};
+
+#endif
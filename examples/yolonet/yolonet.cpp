@@ -21,6 +21,7 @@
  */
 
 #include <signal.h>
+#include <time.h>
 
 #include <sys/syscall.h>
 #include <unistd.h>
@@ -46,6 +47,22 @@ void sig_handler(int signo)
 	}
 }
 
+// hot-reloadable settings from the --config file
+static void onThresholdChanged( configStore* config, const char* key, const char* value, void* user_data )
+{
+	if( !value )
+		return;
+
+	((yoloNet*)user_data)->SetConfidenceThreshold(config->GetFloat(key));
+	LogInfo("yolonet:  detection threshold changed to %s\n", value);
+}
+
+static void onOverlayChanged( configStore* config, const char* key, const char* value, void* user_data )
+{
+	*(uint32_t*)user_data = yoloNet::OverlayFlagsFromStr(value != NULL ? value : "box,labels,conf");
+	LogInfo("yolonet:  overlay changed to %s\n", value != NULL ? value : "box,labels,conf");
+}
+
 int usage()
 {
 	printf("usage: yolonet [--help] [--network=NETWORK] [--threshold=THRESHOLD] ...\n");
@@ -58,10 +75,26 @@ int usage()
 
 	printf("%s", yoloNet::Usage());
 	printf("%s", objectTracker::Usage());
+	printf("%s", detectionScheduler::Usage());
+	printf("%s", detectionCascade::Usage());
+	printf("%s", detectionPublisher::Usage());
+	printf("%s", detectionMulticastPublisher::Usage());
+	printf("%s", EventLoop::Usage());
+	printf("%s", configStore::Usage());
 	printf("%s", videoSource::Usage());
 	printf("%s", videoOutput::Usage());
 	printf("%s", Log::Usage());
 
+	printf("telemetry arguments: \n");
+	printf("  --telemetry=BROKER          MQTT broker to publish telemetry to (e.g. tcp://localhost:1883)\n");
+	printf("  --telemetry-topic=TOPIC     MQTT topic for telemetry batches (default: telemetry/data)\n");
+	printf("  --telemetry-interval=MS     system stats sampling interval in ms (default: 1000)\n");
+	printf("  --telemetry-batch=N         number of samples per publish (default: 10)\n\n");
+
+	printf("recording arguments: \n");
+	printf("  --record=FILE               record the detections to a binary detection stream file\n");
+	printf("  --record-chunk=BYTES        size of the chunks written to disk (default: 262144)\n\n");
+
 	return 0;
 }
 
@@ -77,6 +110,17 @@ int main( int argc, char** argv )
 		return usage();
 
 
+	/*
+	 * load the config file and YOLONET_* environment variables (the command line overrides them)
+	 */
+	configStore config("YOLONET");
+
+	if( !config.Load(cmdLine) )
+		return 1;
+
+	config.Apply(cmdLine);
+
+
 	/*
 	 * attach signal handler
 	 */
@@ -84,6 +128,13 @@ int main( int argc, char** argv )
 		LogError("can't catch SIGINT\n");
 
 
+	/*
+	 * configure the event loops that the network servers run on
+	 */
+	if( !EventLoop::Configure(cmdLine) )
+		return 1;
+
+
 	/*
 	 * create input stream
 	 */
@@ -116,8 +167,84 @@ int main( int argc, char** argv )
 		return 1;
 	}
 
+	if( cmdLine.GetFlag("threshold") )
+		net->SetConfidenceThreshold(cmdLine.GetFloat("threshold"));
+
 	// parse overlay flags
-	const uint32_t overlayFlags = yoloNet::OverlayFlagsFromStr(cmdLine.GetString("overlay", "box,labels,conf"));
+	uint32_t overlayFlags = yoloNet::OverlayFlagsFromStr(cmdLine.GetString("overlay", "box,labels,conf"));
+
+	config.Subscribe("threshold", onThresholdChanged, net);
+	config.Subscribe("overlay", onOverlayChanged, &overlayFlags);
+
+
+	/*
+	 * create adaptive detection-rate scheduler (optional)
+	 */
+	detectionScheduler* scheduler = detectionScheduler::Create(cmdLine);
+
+	if( cmdLine.GetFlag("adaptive-rate") && !scheduler )
+	{
+		LogError("yolonet:  failed to create detection scheduler\n");
+		return 1;
+	}
+
+
+	/*
+	 * create the classification cascade (optional)
+	 */
+	detectionCascade* cascade = detectionCascade::Create(cmdLine, net);
+
+	if( cmdLine.GetString("cascade-model") != NULL && !cascade )
+	{
+		LogError("yolonet:  failed to create detection cascade\n");
+		return 1;
+	}
+
+
+	/*
+	 * create telemetry publisher (optional)
+	 */
+	TelemetryPublisher* telemetry = NULL;
+
+	if( cmdLine.GetString("telemetry") != NULL )
+	{
+		TelemetryPublisher::Options opt;
+
+		opt.address = cmdLine.GetString("telemetry");
+		opt.topic = cmdLine.GetString("telemetry-topic", opt.topic.c_str());
+		opt.sampleIntervalMs = cmdLine.GetUnsignedInt("telemetry-interval", opt.sampleIntervalMs);
+		opt.batchSize = cmdLine.GetUnsignedInt("telemetry-batch", opt.batchSize);
+
+		telemetry = TelemetryPublisher::Create(opt);
+
+		if( !telemetry )
+			LogError("yolonet:  failed to create telemetry publisher, continuing without telemetry\n");
+	}
+
+
+	/*
+	 * create detection publisher (optional)
+	 */
+	const URI& outputURI = output->GetResource();
+	detectionPublisher* publisher = detectionPublisher::Create(cmdLine, net, (outputURI.protocol == "webrtc") ? outputURI.port : WEBRTC_DEFAULT_PORT);
+	detectionMulticastPublisher* multicast = detectionMulticastPublisher::Create(cmdLine);
+
+	if( cmdLine.GetFlag("multicast") && !multicast )
+		LogError("yolonet:  failed to create detection multicast, continuing without multicast\n");
+
+
+	/*
+	 * create detection recorder (optional)
+	 */
+	detectionStreamWriter* recorder = NULL;
+
+	if( cmdLine.GetString("record") != NULL )
+	{
+		recorder = detectionStreamWriter::Open(cmdLine.GetString("record"), cmdLine.GetUnsignedInt("record-chunk", DETECTION_STREAM_DEFAULT_CHUNK));
+
+		if( !recorder )
+			LogError("yolonet:  failed to open detection recording, continuing without recording\n");
+	}
 
 
 	// gstSpeaker gstSpeaker("/home/cook/ws/jetson-inference-yolo/data/voices/");
@@ -144,28 +271,87 @@ int main( int argc, char** argv )
 	// heartbeatThread.detach();
 
 
+	time_t lastReload = time(NULL);
+
     while( !signal_received )
 	{
+		// pick up changes to the config file (at most once per second)
+		const time_t now = time(NULL);
+
+		if( now != lastReload )
+		{
+			config.Reload();
+			lastReload = now;
+		}
+
 		// capture next image
 		uchar3* image = NULL;
 		int status = 0;
 		
 		nvtxRangePush("YOLONet::Capture");
-		if( !input->Capture(&image, &status) )
 		{
-			if( status == videoSource::TIMEOUT )
-				continue;
+			TelemetryTimer timer(telemetry, TELEMETRY_CAPTURE);
+
+			if( !input->Capture(&image, &status) )
+			{
+				nvtxRangePop();
+
+				if( status == videoSource::TIMEOUT )
+					continue;
 			
-			break; // EOS
+				break; // EOS
+			}
 		}
 		nvtxRangePop();
 
 		// detect objects in the frame
 		yoloNet::Detection* detections = NULL;
+		int numDetections = 0;
 	
-		nvtxRangePush("YOLONet::Detect");
-		const int numDetections = net->Detect(image, input->GetWidth(), input->GetHeight(), &detections, overlayFlags);
-		nvtxRangePop();
+		if( !scheduler || scheduler->Process(image, input->GetWidth(), input->GetHeight()) )
+		{
+			nvtxRangePush("YOLONet::Detect");
+			{
+				TelemetryTimer timer(telemetry, TELEMETRY_DETECT);
+				numDetections = net->Detect(image, input->GetWidth(), input->GetHeight(), &detections, cascade ? yoloNet::OVERLAY_NONE : overlayFlags);
+			}
+			nvtxRangePop();
+
+			if( scheduler != NULL )
+				scheduler->Update(detections, numDetections);
+		}
+		else
+		{
+			// the scene hasn't changed, so reuse the last detections
+			numDetections = scheduler->Predict(&detections);
+
+			if( !cascade && overlayFlags != 0 && numDetections > 0 )
+				net->Overlay(image, image, input->GetWidth(), input->GetHeight(), detections, numDetections, overlayFlags);
+		}
+
+		// classify the objects before the overlay is drawn, so it isn't in the crops
+		if( cascade != NULL && numDetections > 0 )
+		{
+			cascade->Process(image, input->GetWidth(), input->GetHeight(), detections, numDetections);
+
+			if( overlayFlags != 0 )
+				net->Overlay(image, image, input->GetWidth(), input->GetHeight(), detections, numDetections, overlayFlags);
+		}
+
+		if( publisher != NULL )
+			publisher->Publish(input->GetLastTimestamp(), input->GetFrameCount(), input->GetWidth(), input->GetHeight(), detections, numDetections > 0 ? numDetections : 0);
+
+		if( multicast != NULL )
+			multicast->Publish(input->GetLastTimestamp(), input->GetFrameCount(), detections, numDetections > 0 ? numDetections : 0);
+
+		if( recorder != NULL )
+			recorder->Write(input->GetLastTimestamp(), input->GetFrameCount(), detections, numDetections > 0 ? numDetections : 0);
+
+		if( telemetry != NULL )
+		{
+			telemetry->recordFrame();
+			telemetry->recordDetections(numDetections > 0 ? numDetections : 0);
+		}
 
 		
 		if( numDetections > 0 )
@@ -176,6 +362,9 @@ int main( int argc, char** argv )
 			{
 				LogVerbose("\ndetected obj %i  class #%u (%s)  confidence=%f\n", n, detections[n].ClassID, net->GetClassDesc(detections[n].ClassID), detections[n].Confidence);
 				LogVerbose("bounding box %i  (%.2f, %.2f)  (%.2f, %.2f)  w=%.2f  h=%.2f\n", n, detections[n].Left, detections[n].Top, detections[n].Right, detections[n].Bottom, detections[n].Width(), detections[n].Height()); 
+
+				if( cascade != NULL && cascade->GetResult(n).ClassID >= 0 )
+					LogVerbose("cascade %i  class #%i (%s)  confidence=%f  age=%i\n", n, cascade->GetResult(n).ClassID, cascade->GetClassDesc(n), cascade->GetResult(n).Confidence, cascade->GetResult(n).Age);
 			
 
 				// gstSpeaker.play_warning_sequence_async(0);
@@ -197,11 +386,18 @@ int main( int argc, char** argv )
 
 		if( output != NULL )
 		{
-			output->Render(image, input->GetWidth(), input->GetHeight());
+			{
+				TelemetryTimer timer(telemetry, TELEMETRY_RENDER);
+				output->Render(image, input->GetWidth(), input->GetHeight());
+			}
 
 			// update the status bar
 			char str[256];
-			sprintf(str, "TensorRT %i.%i.%i | %s | Network %.0f FPS", NV_TENSORRT_MAJOR, NV_TENSORRT_MINOR, NV_TENSORRT_PATCH, precisionTypeToStr(net->GetPrecision()), net->GetNetworkFPS());
+			int length = sprintf(str, "TensorRT %i.%i.%i | %s | Network %.0f FPS", NV_TENSORRT_MAJOR, NV_TENSORRT_MINOR, NV_TENSORRT_PATCH, precisionTypeToStr(net->GetPrecision()), net->GetNetworkFPS());
+
+			if( scheduler != NULL )
+				sprintf(str + length, " | Detecting %.0f%% of frames", scheduler->GetDetectRatio() * 100.0f);
+
 			output->SetStatus(str);
 
 			// check if the user quit
@@ -218,6 +414,12 @@ int main( int argc, char** argv )
 	 */
 	LogVerbose("yolonet:  shutting down...\n");
 	
+	SAFE_DELETE(telemetry);
+	SAFE_DELETE(scheduler);
+	SAFE_DELETE(cascade);
+	SAFE_DELETE(recorder);
+	SAFE_DELETE(publisher);
+	SAFE_DELETE(multicast);
 	SAFE_DELETE(input);
 	SAFE_DELETE(output);
 	SAFE_DELETE(net);
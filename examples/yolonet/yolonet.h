@@ -9,6 +9,13 @@
 
 #include "yoloNet.h"
 #include "objectTracker.h"
+#include "detectionStream.h"
+#include "detectionPublisher.h"
+#include "detectionMulticast.h"
+#include "detectionScheduler.h"
+#include "detectionCascade.h"
+#include "EventLoop.h"
+#include "configStore.h"
 #include "gstSpeaker.h"
 #include "customNetwork.h"
 
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "PyInference.h"
+#include "PyYoloNet.h"
+
+#include "logging.h"
+
+
+const uint32_t pyInferenceMaxFunctions = 128;
+      uint32_t pyInferenceNumFunctions = 0;
+
+static PyMethodDef pyInferenceFunctions[pyInferenceMaxFunctions];
+
+
+// add functions
+void PyInference_AddFunctions( PyMethodDef* functions )
+{
+	uint32_t count = 0;
+		
+	if( !functions )
+		return;
+	
+	while(true)
+	{
+		if( !functions[count].ml_name || !functions[count].ml_meth )
+			break;
+		
+		if( pyInferenceNumFunctions >= pyInferenceMaxFunctions - 1 )
+		{
+			LogError(LOG_PY_INFERENCE "exceeded max number of functions to register (%u)\n", pyInferenceMaxFunctions);
+			return;
+		}
+		
+		memcpy(pyInferenceFunctions + pyInferenceNumFunctions, functions + count, sizeof(PyMethodDef));
+		
+		pyInferenceNumFunctions++;
+		count++;
+	}
+}
+
+
+// register functions
+bool PyInference_RegisterFunctions()
+{
+	LogDebug(LOG_PY_INFERENCE "registering module functions...\n");
+	
+	// zero the master list of functions, so it end with NULL sentinel
+	memset(pyInferenceFunctions, 0, sizeof(PyMethodDef) * pyInferenceMaxFunctions);
+	
+	// add functions to the master list
+	PyInference_AddFunctions(PyYoloNet_RegisterFunctions());
+	
+	LogDebug(LOG_PY_INFERENCE "done registering module functions\n");
+	return true;
+}
+
+
+// register object types
+bool PyInference_RegisterTypes( PyObject* module )
+{
+	LogDebug(LOG_PY_INFERENCE "registering module types...\n");
+	
+	// the images are passed in as jetson_utils cudaImage objects,
+	// so make sure that their types have been registered first
+	PyObject* utils = PyImport_ImportModule("jetson_utils_python");
+	
+	if( !utils )
+	{
+		PyErr_Print();
+		LogError(LOG_PY_INFERENCE "failed to import jetson_utils_python module\n");
+	}
+	
+	Py_XDECREF(utils);
+	
+	if( !PyYoloNet_RegisterTypes(module) )
+		LogError(LOG_PY_INFERENCE "failed to register yoloNet types\n");
+	
+	LogDebug(LOG_PY_INFERENCE "done registering module types\n");
+	return true;
+}
+
+#ifdef PYTHON_3
+static struct PyModuleDef pyInferenceModuleDef = {
+        PyModuleDef_HEAD_INIT,
+        "jetson_inference_yolo_python",
+        NULL,
+        -1,
+        pyInferenceFunctions
+};
+
+PyMODINIT_FUNC
+PyInit_jetson_inference_yolo_python(void)
+{
+	LogDebug(LOG_PY_INFERENCE "initializing Python %i.%i bindings...\n", PY_MAJOR_VERSION, PY_MINOR_VERSION);
+	
+	// register functions
+	if( !PyInference_RegisterFunctions() )
+		LogError(LOG_PY_INFERENCE "failed to register module functions\n");
+	
+	// create the module
+	PyObject* module = PyModule_Create(&pyInferenceModuleDef);
+	
+	if( !module )
+	{
+		LogError(LOG_PY_INFERENCE "PyModule_Create() failed\n");
+		return NULL;
+	}
+	
+	// register types
+	if( !PyInference_RegisterTypes(module) )
+		LogError(LOG_PY_INFERENCE "failed to register module types\n");
+	
+	LogDebug(LOG_PY_INFERENCE "done Python %i.%i binding initialization\n", PY_MAJOR_VERSION, PY_MINOR_VERSION);
+	return module;
+}
+
+#else
+PyMODINIT_FUNC
+initjetson_inference_yolo_python(void)
+{
+	LogDebug(LOG_PY_INFERENCE "initializing Python %i.%i bindings...\n", PY_MAJOR_VERSION, PY_MINOR_VERSION);
+	
+	// register functions
+	if( !PyInference_RegisterFunctions() )
+		LogError(LOG_PY_INFERENCE "failed to register module functions\n");
+	
+	// create the module
+	PyObject* module = Py_InitModule("jetson_inference_yolo_python", pyInferenceFunctions);
+	
+	if( !module )
+	{
+		LogError(LOG_PY_INFERENCE "Py_InitModule() failed\n");
+		return;
+	}
+	
+	// register types
+	if( !PyInference_RegisterTypes(module) )
+		LogError(LOG_PY_INFERENCE "failed to register module types\n");
+	
+	LogDebug(LOG_PY_INFERENCE "done Python %i.%i binding initialization\n", PY_MAJOR_VERSION, PY_MINOR_VERSION);
+}
+#endif
@@ -0,0 +1,734 @@
+/*
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "PyYoloNet.h"
+#include "PyCUDA.h"
+
+#include "yoloNet.h"
+#include "Mutex.h"
+#include "logging.h"
+
+#include <vector>
+#include <stddef.h>
+
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/arrayobject.h>
+
+
+// PyYoloNet container
+typedef struct {
+	PyObject_HEAD
+	yoloNet* net;
+	Mutex* mutex;	// serializes inference from threads that released the GIL
+} PyYoloNet_Object;
+
+
+// numpy structured dtype that matches the layout of yoloNet::Detection
+static PyArray_Descr* pyDetection_Descr = NULL;
+
+#define DOC_DETECTION  "Structured numpy dtype of the detection results, with the fields:\n\n" \
+				   "  ClassID     (uint32)  class index of the detected object\n" \
+				   "  Confidence  (float32) confidence value of the detected object\n" \
+				   "  TrackID     (int32)   unique tracking ID (or -1 if untracked)\n" \
+				   "  TrackStatus (int32)   -1 for dropped, 0 for initializing, 1 for active/valid\n" \
+				   "  TrackFrames (int32)   number of frames the object has been re-identified for\n" \
+				   "  TrackLost   (int32)   number of consecutive frames tracking has been lost for\n" \
+				   "  Left, Right, Top, Bottom (float32) bounding box coordinates (in pixels)\n"
+
+#define DETECTION_FIELD(name, type)  { #name, type, offsetof(yoloNet::Detection, name) }
+
+// PyDetection_CreateDescr
+static PyArray_Descr* PyDetection_CreateDescr()
+{
+	static const struct { const char* name; const char* type; size_t offset; } fields[] = {
+		DETECTION_FIELD(ClassID, "u4"),
+		DETECTION_FIELD(Confidence, "f4"),
+		DETECTION_FIELD(TrackID, "i4"),
+		DETECTION_FIELD(TrackStatus, "i4"),
+		DETECTION_FIELD(TrackFrames, "i4"),
+		DETECTION_FIELD(TrackLost, "i4"),
+		DETECTION_FIELD(Left, "f4"),
+		DETECTION_FIELD(Right, "f4"),
+		DETECTION_FIELD(Top, "f4"),
+		DETECTION_FIELD(Bottom, "f4")
+	};
+	
+	const size_t numFields = sizeof(fields) / sizeof(fields[0]);
+	
+	PyObject* names   = PyList_New(numFields);
+	PyObject* formats = PyList_New(numFields);
+	PyObject* offsets = PyList_New(numFields);
+	PyObject* dict    = PyDict_New();
+	
+	PyArray_Descr* descr = NULL;
+	
+	if( names != NULL && formats != NULL && offsets != NULL && dict != NULL )
+	{
+		for( size_t n=0; n < numFields; n++ )
+		{
+			PyList_SET_ITEM(names, n, PYSTRING_FROM_STRING(fields[n].name));
+			PyList_SET_ITEM(formats, n, PYSTRING_FROM_STRING(fields[n].type));
+			PyList_SET_ITEM(offsets, n, PYLONG_FROM_UNSIGNED_LONG(fields[n].offset));
+		}
+		
+		PyDict_SetItemString(dict, "names", names);
+		PyDict_SetItemString(dict, "formats", formats);
+		PyDict_SetItemString(dict, "offsets", offsets);
+		PYDICT_SET_ITEM(dict, "itemsize", PYLONG_FROM_UNSIGNED_LONG(sizeof(yoloNet::Detection)));
+		
+		if( !PyArray_DescrConverter(dict, &descr) )
+			descr = NULL;
+	}
+	
+	Py_XDECREF(names);
+	Py_XDECREF(formats);
+	Py_XDECREF(offsets);
+	Py_XDECREF(dict);
+	
+	return descr;
+}
+
+
+// PyDetection_ToArray
+static PyObject* PyDetection_ToArray( PyYoloNet_Object* self, yoloNet::Detection* detections, int numDetections )
+{
+	// wrap the results in the detection ringbuffer without copying them,
+	// and keep the network alive for as long as the array references it
+	npy_intp dims[] = { numDetections };
+	
+	Py_INCREF(pyDetection_Descr);	// PyArray_NewFromDescr() steals a reference
+	
+	PyObject* array = PyArray_NewFromDescr(&PyArray_Type, pyDetection_Descr, 1, dims, NULL, detections, 
+								    NPY_ARRAY_C_CONTIGUOUS|NPY_ARRAY_ALIGNED, NULL);
+	
+	if( !array )
+		return NULL;
+	
+	Py_INCREF(self);	// PyArray_SetBaseObject() steals a reference
+	
+	if( PyArray_SetBaseObject((PyArrayObject*)array, (PyObject*)self) != 0 )
+	{
+		Py_DECREF(array);
+		return NULL;
+	}
+	
+	return array;
+}
+
+
+// PyDetection_FromArray
+static PyArrayObject* PyDetection_FromArray( PyObject* object )
+{
+	Py_INCREF(pyDetection_Descr);	// PyArray_FromAny() steals a reference
+	
+	PyArrayObject* array = (PyArrayObject*)PyArray_FromAny(object, pyDetection_Descr, 1, 1, 
+											    NPY_ARRAY_C_CONTIGUOUS|NPY_ARRAY_ALIGNED, NULL);
+	
+	if( !array )
+	{
+		PyErr_SetString(PyExc_TypeError, LOG_PY_INFERENCE "yoloNet expected a 1D array of detections with the yoloNet.Detection dtype");
+		return NULL;
+	}
+	
+	return array;
+}
+
+
+//-----------------------------------------------------------------------------------------
+// PyYoloNet_New
+static PyObject* PyYoloNet_New( PyTypeObject *type, PyObject *args, PyObject *kwds )
+{
+	LogDebug(LOG_PY_INFERENCE "PyYoloNet_New()\n");
+	
+	// allocate a new container
+	PyYoloNet_Object* self = (PyYoloNet_Object*)type->tp_alloc(type, 0);
+	
+	if( !self )
+	{
+		PyErr_SetString(PyExc_MemoryError, LOG_PY_INFERENCE "yoloNet tp_alloc() failed to allocate a new object");
+		return NULL;
+	}
+	
+	self->net = NULL;
+	self->mutex = new Mutex();
+	
+	return (PyObject*)self;
+}
+
+
+// PyYoloNet_Init
+static int PyYoloNet_Init( PyYoloNet_Object* self, PyObject *args, PyObject *kwds )
+{
+	LogDebug(LOG_PY_INFERENCE "PyYoloNet_Init()\n");
+	
+	// parse arguments
+	const char* model      = NULL;
+	const char* labels     = NULL;
+	const char* colors     = NULL;
+	const char* input      = YOLONET_DEFAULT_INPUT;
+	const char* output     = YOLONET_DEFAULT_OUTPUT;
+	const char* precision  = NULL;
+	
+	float threshold = YOLONET_DEFAULT_CONFIDENCE_THRESHOLD;
+	float meanPixel = 0.0f;
+	
+	static char* kwlist[] = {"model", "labels", "colors", "threshold", "input_blob", "output_blob", "mean_pixel", "precision", NULL};
+
+	if( !PyArg_ParseTupleAndKeywords(args, kwds, "s|zzfssfz", kwlist, &model, &labels, &colors, &threshold, &input, &output, &meanPixel, &precision))
+		return -1;
+  
+	precisionType precisionMode = TYPE_FASTEST;
+	
+	if( precision != NULL )
+	{
+		precisionMode = precisionTypeFromStr(precision);
+		
+		if( precisionMode == TYPE_DISABLED )
+		{
+			PyErr_Format(PyExc_ValueError, LOG_PY_INFERENCE "yoloNet.__init__() invalid precision '%s'", precision);
+			return -1;
+		}
+	}
+	
+	if( self->net != NULL )
+	{
+		PyErr_SetString(PyExc_Exception, LOG_PY_INFERENCE "yoloNet.__init__() was called on a network that was already loaded");
+		return -1;
+	}
+	
+	// load the network (building the TensorRT engine can take a while)
+	yoloNet* net = NULL;
+	
+	Py_BEGIN_ALLOW_THREADS
+	net = yoloNet::Create("", model, meanPixel, labels != NULL ? labels : "", colors != NULL ? colors : "", 
+					  threshold, input, output, DEFAULT_MAX_BATCH_SIZE, precisionMode);
+	Py_END_ALLOW_THREADS
+	
+	if( !net )
+	{
+		PyErr_SetString(PyExc_Exception, LOG_PY_INFERENCE "yoloNet failed to load network");
+		return -1;
+	}
+
+	self->net = net;
+	return 0;
+}
+
+
+// PyYoloNet_Dealloc
+static void PyYoloNet_Dealloc( PyYoloNet_Object* self )
+{
+	LogDebug(LOG_PY_INFERENCE "PyYoloNet_Dealloc()\n");
+
+	// free the network
+	Py_BEGIN_ALLOW_THREADS
+	
+	if( self->net != NULL )
+	{
+		delete self->net;
+		self->net = NULL;
+	}
+	
+	Py_END_ALLOW_THREADS
+	
+	if( self->mutex != NULL )
+	{
+		delete self->mutex;
+		self->mutex = NULL;
+	}
+	
+	// free the container
+	Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+
+static PyTypeObject pyYoloNet_Type = 
+{
+    PyVarObject_HEAD_INIT(NULL, 0)
+};
+
+
+#define DOC_CREATE "Load a YOLO model (same arguments as the yoloNet constructor).\n\n" \
+				   "Parameters:\n" \
+				   "  model       (string) -- path to the ONNX model or serialized TensorRT engine\n" \
+				   "  labels      (string) -- path to the class labels file (optional)\n" \
+				   "  colors      (string) -- path to the class colors file (optional)\n" \
+				   "  threshold   (float)  -- minimum confidence threshold (default is 0.5)\n" \
+				   "  input_blob  (string) -- name of the input layer\n" \
+				   "  output_blob (string) -- name of the output layer\n" \
+				   "  mean_pixel  (float)  -- mean pixel value to subtract from the input (default is 0.0)\n" \
+				   "  precision   (string) -- 'fp32', 'fp16', or 'int8' (default is the fastest available)\n\n" \
+				   "Returns:\n" \
+				   "  (yoloNet) -- the loaded network"
+
+// PyYoloNet_Create
+static PyObject* PyYoloNet_Create( PyObject* cls, PyObject* args, PyObject* kwds )
+{
+	return PyObject_Call((PyObject*)&pyYoloNet_Type, args, kwds);
+}
+
+
+#define DOC_DETECT "Detect objects in an image, and optionally overlay the results on it.\n\n" \
+				   "Parameters:\n" \
+				   "  image   (cudaImage) -- input image in CUDA memory\n" \
+				   "  overlay (string)    -- combination of 'box', 'lines', 'labels', 'conf', 'track' or 'none'\n" \
+				   "                         (the default is 'box,labels,conf')\n\n" \
+				   "Returns:\n" \
+				   "  (numpy.ndarray) -- read-only array of yoloNet.Detection results.  It's a view of the network's\n" \
+				   "                     detection ringbuffer, so it remains valid until GetNumDetectionSets()\n" \
+				   "                     more calls to Detect() have been made -- copy() it to keep it longer."
+
+// PyYoloNet_Detect
+static PyObject* PyYoloNet_Detect( PyYoloNet_Object* self, PyObject* args, PyObject* kwds )
+{
+	if( !self || !self->net )
+	{
+		PyErr_SetString(PyExc_Exception, LOG_PY_INFERENCE "yoloNet invalid object instance");
+		return NULL;
+	}
+	
+	// parse arguments
+	PyObject* capsule = NULL;
+	const char* overlay = "box,labels,conf";
+
+	static char* kwlist[] = {"image", "overlay", NULL};
+
+	if( !PyArg_ParseTupleAndKeywords(args, kwds, "O|s", kwlist, &capsule, &overlay))
+		return NULL;
+
+	// get pointer to image data
+	int width = 0;
+	int height = 0;
+	
+	imageFormat format = IMAGE_UNKNOWN;
+	void* ptr = PyCUDA_GetImage(capsule, &width, &height, &format);
+
+	if( !ptr )
+		return NULL;
+
+	const uint32_t flags = yoloNet::OverlayFlagsFromStr(overlay);
+	
+	// run preprocessing, inference and NMS without holding the GIL
+	yoloNet::Detection* detections = NULL;
+	int numDetections = 0;
+	
+	Py_BEGIN_ALLOW_THREADS
+	self->mutex->Lock();
+	numDetections = self->net->Detect(ptr, width, height, format, &detections, flags);
+	self->mutex->Unlock();
+	Py_END_ALLOW_THREADS
+	
+	if( numDetections < 0 )
+	{
+		PyErr_SetString(PyExc_Exception, LOG_PY_INFERENCE "yoloNet.Detect() encountered an error processing the image");
+		return NULL;
+	}
+
+	return PyDetection_ToArray(self, detections, numDetections);
+}
+
+
+#define DOC_DETECT_BATCH "Detect objects in a sequence of images, and optionally overlay the results on them.\n" \
+				   "The GIL is released once for the whole batch.\n\n" \
+				   "Parameters:\n" \
+				   "  images  (list of cudaImage) -- input images in CUDA memory (up to GetNumDetectionSets() of them)\n" \
+				   "  overlay (string)            -- combination of 'box', 'lines', 'labels', 'conf', 'track' or 'none'\n" \
+				   "                                 (the default is 'box,labels,conf')\n\n" \
+				   "Returns:\n" \
+				   "  (list of numpy.ndarray) -- the yoloNet.Detection results of each image (@see Detect() for their lifetime)"
+
+// PyYoloNet_DetectBatch
+static PyObject* PyYoloNet_DetectBatch( PyYoloNet_Object* self, PyObject* args, PyObject* kwds )
+{
+	if( !self || !self->net )
+	{
+		PyErr_SetString(PyExc_Exception, LOG_PY_INFERENCE "yoloNet invalid object instance");
+		return NULL;
+	}
+	
+	// parse arguments
+	PyObject* images = NULL;
+	const char* overlay = "box,labels,conf";
+
+	static char* kwlist[] = {"images", "overlay", NULL};
+
+	if( !PyArg_ParseTupleAndKeywords(args, kwds, "O|s", kwlist, &images, &overlay))
+		return NULL;
+
+	PyObject* sequence = PySequence_Fast(images, LOG_PY_INFERENCE "yoloNet.DetectBatch() expected a sequence of images");
+	
+	if( !sequence )
+		return NULL;
+	
+	const Py_ssize_t batchSize = PySequence_Fast_GET_SIZE(sequence);
+	
+	// the results of each image share the detection ringbuffer,
+	// so a batch can't be larger than the ringbuffer or they would overwrite each other
+	if( batchSize > (Py_ssize_t)yoloNet::GetNumDetectionSets() )
+	{
+		PyErr_Format(PyExc_ValueError, LOG_PY_INFERENCE "yoloNet.DetectBatch() batch of %zd images exceeds the maximum of %u", 
+				   batchSize, yoloNet::GetNumDetectionSets());
+		
+		Py_DECREF(sequence);
+		return NULL;
+	}
+	
+	// get pointers to the image data
+	struct batchImage
+	{
+		void* ptr;
+		int width;
+		int height;
+		imageFormat format;
+		
+		yoloNet::Detection* detections;
+		int numDetections;
+	};
+	
+	std::vector<batchImage> batch(batchSize);
+	
+	for( Py_ssize_t n=0; n < batchSize; n++ )
+	{
+		batch[n].ptr = PyCUDA_GetImage(PySequence_Fast_GET_ITEM(sequence, n), &batch[n].width, &batch[n].height, &batch[n].format);
+		
+		if( !batch[n].ptr )
+		{
+			Py_DECREF(sequence);
+			return NULL;
+		}
+	}
+	
+	const uint32_t flags = yoloNet::OverlayFlagsFromStr(overlay);
+	
+	// process the batch without holding the GIL
+	Py_ssize_t numProcessed = 0;
+	
+	Py_BEGIN_ALLOW_THREADS
+	self->mutex->Lock();
+	
+	for( ; numProcessed < batchSize; numProcessed++ )
+	{
+		batchImage& img = batch[numProcessed];
+		img.numDetections = self->net->Detect(img.ptr, img.width, img.height, img.format, &img.detections, flags);
+		
+		if( img.numDetections < 0 )
+			break;
+	}
+
+	self->mutex->Unlock();
+	Py_END_ALLOW_THREADS
+	
+	Py_DECREF(sequence);
+	
+	if( numProcessed < batchSize )
+	{
+		PyErr_Format(PyExc_Exception, LOG_PY_INFERENCE "yoloNet.DetectBatch() encountered an error processing image %zd", numProcessed);
+		return NULL;
+	}
+	
+	// wrap the results
+	PyObject* list = PyList_New(batchSize);
+	
+	if( !list )
+		return NULL;
+	
+	for( Py_ssize_t n=0; n < batchSize; n++ )
+	{
+		PyObject* array = PyDetection_ToArray(self, batch[n].detections, batch[n].numDetections);
+		
+		if( !array )
+		{
+			Py_DECREF(list);
+			return NULL;
+		}
+		
+		PyList_SET_ITEM(list, n, array);
+	}
+	
+	return list;
+}
+
+
+#define DOC_OVERLAY "Overlay detection results on an image.\n\n" \
+				   "Parameters:\n" \
+				   "  image      (cudaImage)     -- input image in CUDA memory\n" \
+				   "  detections (numpy.ndarray) -- array of yoloNet.Detection results (i.e. from Detect())\n" \
+				   "  output     (cudaImage)     -- output image (by default, the input image is drawn over)\n" \
+				   "  overlay    (string)        -- combination of 'box', 'lines', 'labels', 'conf', 'track'\n" \
+				   "                                (the default is 'box,labels,conf')\n\n" \
+				   "Returns:\n" \
+				   "  None"
+
+// PyYoloNet_Overlay
+static PyObject* PyYoloNet_Overlay( PyYoloNet_Object* self, PyObject* args, PyObject* kwds )
+{
+	if( !self || !self->net )
+	{
+		PyErr_SetString(PyExc_Exception, LOG_PY_INFERENCE "yoloNet invalid object instance");
+		return NULL;
+	}
+	
+	// parse arguments
+	PyObject* input_capsule = NULL;
+	PyObject* output_capsule = NULL;
+	PyObject* detections_obj = NULL;
+	
+	const char* overlay = "box,labels,conf";
+
+	static char* kwlist[] = {"image", "detections", "output", "overlay", NULL};
+
+	if( !PyArg_ParseTupleAndKeywords(args, kwds, "OO|Os", kwlist, &input_capsule, &detections_obj, &output_capsule, &overlay))
+		return NULL;
+
+	// get pointers to the image data
+	int width = 0;
+	int height = 0;
+	
+	imageFormat format = IMAGE_UNKNOWN;
+	void* input_ptr = PyCUDA_GetImage(input_capsule, &width, &height, &format);
+
+	if( !input_ptr )
+		return NULL;
+
+	void* output_ptr = input_ptr;
+	
+	if( output_capsule != NULL && output_capsule != Py_None )
+	{
+		int output_width = 0;
+		int output_height = 0;
+		
+		imageFormat output_format = IMAGE_UNKNOWN;
+		output_ptr = PyCUDA_GetImage(output_capsule, &output_width, &output_height, &output_format);
+		
+		if( !output_ptr )
+			return NULL;
+		
+		if( output_width != width || output_height != height || output_format != format )
+		{
+			PyErr_SetString(PyExc_ValueError, LOG_PY_INFERENCE "yoloNet.Overlay() input and output images need to have the same dimensions and format");
+			return NULL;
+		}
+	}
+	
+	// get the detections (this doesn't copy arrays that already have the Detection dtype)
+	PyArrayObject* detections = PyDetection_FromArray(detections_obj);
+	
+	if( !detections )
+		return NULL;
+	
+	const uint32_t flags = yoloNet::OverlayFlagsFromStr(overlay);
+	bool result = false;
+	
+	Py_BEGIN_ALLOW_THREADS
+	self->mutex->Lock();
+	result = self->net->Overlay(input_ptr, output_ptr, width, height, format, 
+						   (yoloNet::Detection*)PyArray_DATA(detections), PyArray_DIM(detections, 0), flags);
+	self->mutex->Unlock();
+	Py_END_ALLOW_THREADS
+	
+	Py_DECREF(detections);
+	
+	if( !result )
+	{
+		PyErr_SetString(PyExc_Exception, LOG_PY_INFERENCE "yoloNet.Overlay() encountered an error");
+		return NULL;
+	}
+
+	Py_RETURN_NONE;
+}
+
+
+// PyYoloNet_GetMaxDetections
+static PyObject* PyYoloNet_GetMaxDetections( PyYoloNet_Object* self )
+{
+	if( !self || !self->net )
+	{
+		PyErr_SetString(PyExc_Exception, LOG_PY_INFERENCE "yoloNet invalid object instance");
+		return NULL;
+	}
+
+	return PYLONG_FROM_UNSIGNED_LONG(self->net->GetMaxDetections());
+}
+
+
+// PyYoloNet_GetNumDetectionSets
+static PyObject* PyYoloNet_GetNumDetectionSets( PyObject* cls )
+{
+	return PYLONG_FROM_UNSIGNED_LONG(yoloNet::GetNumDetectionSets());
+}
+
+
+// PyYoloNet_GetNumClasses
+static PyObject* PyYoloNet_GetNumClasses( PyYoloNet_Object* self )
+{
+	if( !self || !self->net )
+	{
+		PyErr_SetString(PyExc_Exception, LOG_PY_INFERENCE "yoloNet invalid object instance");
+		return NULL;
+	}
+
+	return PYLONG_FROM_UNSIGNED_LONG(self->net->GetNumClasses());
+}
+
+
+// PyYoloNet_GetClassDesc
+static PyObject* PyYoloNet_GetClassDesc( PyYoloNet_Object* self, PyObject* args )
+{
+	if( !self || !self->net )
+	{
+		PyErr_SetString(PyExc_Exception, LOG_PY_INFERENCE "yoloNet invalid object instance");
+		return NULL;
+	}
+	
+	int classIdx = 0;
+
+	if( !PyArg_ParseTuple(args, "i", &classIdx) )
+		return NULL;
+
+	if( classIdx < 0 || classIdx >= (int)self->net->GetNumClasses() )
+	{
+		PyErr_SetString(PyExc_IndexError, LOG_PY_INFERENCE "yoloNet requested class index is out of bounds");
+		return NULL;
+	}
+
+	return PYSTRING_FROM_STRING(self->net->GetClassDesc(classIdx));
+}
+
+
+// PyYoloNet_SetConfidenceThreshold
+static PyObject* PyYoloNet_SetConfidenceThreshold( PyYoloNet_Object* self, PyObject* args )
+{
+	if( !self || !self->net )
+	{
+		PyErr_SetString(PyExc_Exception, LOG_PY_INFERENCE "yoloNet invalid object instance");
+		return NULL;
+	}
+	
+	float threshold = 0.0f;
+
+	if( !PyArg_ParseTuple(args, "f", &threshold) )
+		return NULL;
+
+	self->net->SetConfidenceThreshold(threshold);
+	Py_RETURN_NONE;
+}
+
+
+// PyYoloNet_Usage
+static PyObject* PyYoloNet_Usage( PyObject* cls )
+{
+	return PYSTRING_FROM_STRING(yoloNet::Usage());
+}
+
+
+static PyMethodDef pyYoloNet_Methods[] = 
+{
+	{ "Create", (PyCFunction)PyYoloNet_Create, METH_VARARGS|METH_KEYWORDS|METH_STATIC, DOC_CREATE},
+	{ "Detect", (PyCFunction)PyYoloNet_Detect, METH_VARARGS|METH_KEYWORDS, DOC_DETECT},
+	{ "DetectBatch", (PyCFunction)PyYoloNet_DetectBatch, METH_VARARGS|METH_KEYWORDS, DOC_DETECT_BATCH},
+	{ "Overlay", (PyCFunction)PyYoloNet_Overlay, METH_VARARGS|METH_KEYWORDS, DOC_OVERLAY},
+	{ "GetMaxDetections", (PyCFunction)PyYoloNet_GetMaxDetections, METH_NOARGS, "Return the maximum number of detections per image"},
+	{ "GetNumDetectionSets", (PyCFunction)PyYoloNet_GetNumDetectionSets, METH_NOARGS|METH_STATIC, "Return the number of Detect() calls that the returned detection arrays stay valid for"},
+	{ "GetNumClasses", (PyCFunction)PyYoloNet_GetNumClasses, METH_NOARGS, "Return the number of object classes that the network detects"},
+	{ "GetClassDesc", (PyCFunction)PyYoloNet_GetClassDesc, METH_VARARGS, "Return the class description for the given class index"},
+	{ "SetConfidenceThreshold", (PyCFunction)PyYoloNet_SetConfidenceThreshold, METH_VARARGS, "Set the minimum confidence threshold for detection"},
+	{ "Usage", (PyCFunction)PyYoloNet_Usage, METH_NOARGS|METH_STATIC, "Return help text describing the command line options"},
+	{NULL}  /* Sentinel */
+};
+
+
+// PyYoloNet_RegisterType
+static bool PyYoloNet_RegisterType( PyObject* module )
+{
+	pyYoloNet_Type.tp_name 	  = PY_INFERENCE_MODULE_NAME ".yoloNet";
+	pyYoloNet_Type.tp_basicsize = sizeof(PyYoloNet_Object);
+	pyYoloNet_Type.tp_flags 	  = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE;
+	pyYoloNet_Type.tp_methods   = pyYoloNet_Methods;
+	pyYoloNet_Type.tp_new 	  = PyYoloNet_New;
+	pyYoloNet_Type.tp_init	  = (initproc)PyYoloNet_Init;
+	pyYoloNet_Type.tp_dealloc   = (destructor)PyYoloNet_Dealloc;
+	pyYoloNet_Type.tp_doc  	  = "YOLO object detection network.\n\n" DOC_CREATE;
+	 
+	if( PyType_Ready(&pyYoloNet_Type) < 0 )
+	{
+		LogError(LOG_PY_INFERENCE "yoloNet PyType_Ready() failed\n");
+		return false;
+	}
+	
+	// expose the dtype of the results as yoloNet.Detection
+	if( PyDict_SetItemString(pyYoloNet_Type.tp_dict, "Detection", (PyObject*)pyDetection_Descr) < 0 )
+	{
+		LogError(LOG_PY_INFERENCE "yoloNet failed to register the yoloNet.Detection dtype\n");
+		return false;
+	}
+	
+	PyType_Modified(&pyYoloNet_Type);
+	Py_INCREF(&pyYoloNet_Type);
+    
+	if( PyModule_AddObject(module, "yoloNet", (PyObject*)&pyYoloNet_Type) < 0 )
+	{
+		LogError(LOG_PY_INFERENCE "yoloNet PyModule_AddObject('yoloNet') failed\n");
+		return false;
+	}
+
+	return true;
+}
+
+
+static PyMethodDef pyYoloNet_Functions[] = 
+{
+	{NULL}  /* Sentinel */
+};
+
+// Register functions
+PyMethodDef* PyYoloNet_RegisterFunctions()
+{
+	return pyYoloNet_Functions;
+}
+
+// Register types
+bool PyYoloNet_RegisterTypes( PyObject* module )
+{
+	if( !module )
+		return false;
+	
+	if( _import_array() < 0 )
+	{
+		PyErr_Print();
+		LogError(LOG_PY_INFERENCE "failed to import numpy C API\n");
+		return false;
+	}
+	
+	pyDetection_Descr = PyDetection_CreateDescr();
+	
+	if( !pyDetection_Descr )
+	{
+		PyErr_Print();
+		LogError(LOG_PY_INFERENCE "failed to create the yoloNet.Detection dtype\n");
+		return false;
+	}
+	
+	if( !PyYoloNet_RegisterType(module) )
+		return false;
+	
+	return true;
+}
@@ -0,0 +1,3 @@
+from jetson_inference_yolo_python import *
+
+VERSION = '1.0.0'
@@ -0,0 +1,392 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "gstBufferManager.h"
+#include "gstUtility.h"
+
+#include "commandLine.h"
+#include "logging.h"
+
+#include <gst/app/gstappsink.h>
+#include <gst/app/gstappsrc.h>
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <set>
+
+
+int usage()
+{
+	printf("usage: buffer-pool-test [--help] [--frames=N] [--capacity=N] [--timeout=MS]\n\n");
+	printf("Check that gstBufferRefPool holds exactly one reference to the buffers from an\n");
+	printf("appsink, returns them when they're dropped, acquired and released, and that the\n");
+	printf("pipeline keeps flowing:  with buffers from an appsrc (which are checked to be\n");
+	printf("freed) and from the buffer pool of videotestsrc (which should get reused).\n\n");
+	printf("optional arguments:\n");
+	printf("  --help            show this help message and exit\n");
+	printf("  --frames=N        number of frames to run through each pipeline (default: 100)\n");
+	printf("  --capacity=N      capacity of the gstBufferRefPool (default: 3)\n");
+	printf("  --timeout=MS      time to wait for each frame (default: 5000)\n\n");
+	printf("%s", Log::Usage());
+
+	return 0;
+}
+
+
+// monotonic time in milliseconds
+static uint64_t currentTime()
+{
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return uint64_t(t.tv_sec) * 1000 + t.tv_nsec / 1000000;
+}
+
+
+// wait for a condition, or until the timeout (the streaming thread can still hold a reference briefly)
+template<typename T> static bool waitFor( T condition, uint64_t timeout )
+{
+	const uint64_t start = currentTime();
+
+	while( !condition() )
+	{
+		if( currentTime() - start > timeout )
+			return false;
+
+		usleep(1000);
+	}
+
+	return true;
+}
+
+
+// count the buffers that are freed
+static void onBufferFreed( gpointer user_data, GstMiniObject* object )
+{
+	g_atomic_int_inc((gint*)user_data);
+}
+
+
+// create a pipeline that ends in an appsink named 'sink'
+static GstElement* createPipeline( const char* launch, GstAppSink** sink )
+{
+	GError* error = NULL;
+	GstElement* pipeline = gst_parse_launch(launch, &error);
+
+	if( error != NULL )
+	{
+		printf("buffer-pool-test -- failed to create pipeline '%s' (%s)\n", launch, error->message);
+		g_error_free(error);
+
+		if( pipeline != NULL )
+			gst_object_unref(pipeline);
+
+		return NULL;
+	}
+
+	*sink = GST_APP_SINK(gst_bin_get_by_name(GST_BIN(pipeline), "sink"));
+
+	if( gst_element_set_state(pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE )
+	{
+		printf("buffer-pool-test -- failed to start pipeline '%s'\n", launch);
+		gst_object_unref(*sink);
+		gst_object_unref(pipeline);
+		return NULL;
+	}
+
+	return pipeline;
+}
+
+
+// stop and free a pipeline
+static void destroyPipeline( GstElement* pipeline, GstAppSink* sink )
+{
+	gst_element_set_state(pipeline, GST_STATE_NULL);
+	gst_object_unref(sink);
+	gst_object_unref(pipeline);
+}
+
+
+// pull the next buffer from the appsink into the pool, and wait for the pool to hold the only reference
+static GstBuffer* pullBuffer( GstAppSink* sink, gstBufferRefPool& pool, uint64_t timeout )
+{
+	GstSample* sample = gst_app_sink_try_pull_sample(sink, timeout * GST_MSECOND);
+
+	if( !sample )
+		return NULL;
+
+	GstBuffer* buffer = gst_sample_get_buffer(sample);
+
+	if( !buffer || !pool.Push(buffer) )
+	{
+		gst_sample_unref(sample);
+		return NULL;
+	}
+
+	gst_sample_unref(sample);
+
+	if( !waitFor([&]{ return GST_MINI_OBJECT_REFCOUNT_VALUE(buffer) == 1; }, timeout) )
+	{
+		printf("buffer-pool-test -- the buffer has %i references while held by the pool (expected 1)\n", GST_MINI_OBJECT_REFCOUNT_VALUE(buffer));
+		return NULL;
+	}
+
+	return buffer;
+}
+
+
+// buffers pushed into an appsrc are freed once the pool lets go of them
+static bool testAppSrc( uint32_t numFrames, uint32_t capacity, uint64_t timeout )
+{
+	const uint32_t width = 64;
+	const uint32_t height = 32;
+	const uint32_t size = width * height;
+
+	GstAppSink* sink = NULL;
+	GstElement* pipeline = createPipeline("appsrc name=src format=time caps=\"video/x-raw,format=GRAY8,width=64,height=32,framerate=30/1\" ! "
+								   "appsink name=sink sync=false enable-last-sample=false", &sink);
+
+	if( !pipeline )
+		return false;
+
+	GstAppSrc* src = GST_APP_SRC(gst_bin_get_by_name(GST_BIN(pipeline), "src"));
+
+	gstBufferRefPool pool(capacity);
+
+	gint freed = 0;
+	uint32_t acquired = 0;
+	bool holding = false;
+	bool result = true;
+
+	for( uint32_t n=0; n < numFrames && result; n++ )
+	{
+		// each frame is filled with its index, and counted when it's freed
+		GstBuffer* buffer = gst_buffer_new_allocate(NULL, size, NULL);
+
+		gst_buffer_memset(buffer, 0, n & 0xFF, size);
+		gst_mini_object_weak_ref(GST_MINI_OBJECT(buffer), onBufferFreed, &freed);
+
+		GST_BUFFER_PTS(buffer) = gst_util_uint64_scale(n, GST_SECOND, 30);
+
+		if( gst_app_src_push_buffer(src, buffer) != GST_FLOW_OK )
+		{
+			printf("buffer-pool-test -- appsrc:  failed to push frame %u\n", n);
+			result = false;
+			break;
+		}
+
+		if( !pullBuffer(sink, pool, timeout) )
+		{
+			printf("buffer-pool-test -- appsrc:  failed to receive frame %u\n", n);
+			result = false;
+			break;
+		}
+
+		// every buffer that isn't held by the pool should have been freed
+		const uint32_t held = pool.GetCount();
+
+		if( held > capacity || !waitFor([&]{ return (uint32_t)g_atomic_int_get(&freed) == n + 1 - held; }, timeout) )
+		{
+			printf("buffer-pool-test -- appsrc:  frame %u, the pool holds %u buffers (capacity %u) and %i of %u were freed\n",
+				  n, held, capacity, g_atomic_int_get(&freed), n + 1);
+			result = false;
+			break;
+		}
+
+		// acquire some of the frames, and release some of those
+		if( n % 3 == 2 )
+		{
+			size_t acquiredSize = 0;
+			const uint8_t* data = (const uint8_t*)pool.Acquire(&acquiredSize);
+
+			if( !data || acquiredSize != size || data[0] != (n & 0xFF) || data[size-1] != (n & 0xFF) )
+			{
+				printf("buffer-pool-test -- appsrc:  acquired the wrong frame (expected frame %u)\n", n);
+				result = false;
+				break;
+			}
+
+			acquired++;
+			holding = true;
+
+			if( n % 2 == 0 )
+			{
+				pool.Release();
+				holding = false;
+			}
+
+			if( pool.GetCount() != (holding ? 1 : 0) )
+			{
+				printf("buffer-pool-test -- appsrc:  the pool holds %u buffers after acquiring the latest one\n", pool.GetCount());
+				result = false;
+				break;
+			}
+		}
+	}
+
+	// every frame was either acquired, dropped or still pending
+	const uint32_t pending = pool.GetCount() - (holding ? 1 : 0);
+
+	if( result && acquired + pool.GetDropped() + pending != numFrames )
+	{
+		printf("buffer-pool-test -- appsrc:  %u acquired + %llu dropped + %u pending != %u frames\n",
+			  acquired, (unsigned long long)pool.GetDropped(), pending, numFrames);
+		result = false;
+	}
+
+	pool.Clear();
+
+	if( result && !waitFor([&]{ return (uint32_t)g_atomic_int_get(&freed) == numFrames; }, timeout) )
+	{
+		printf("buffer-pool-test -- appsrc:  %i of %u buffers were freed after Clear()\n", g_atomic_int_get(&freed), numFrames);
+		result = false;
+	}
+
+	gst_app_src_end_of_stream(src);
+	gst_object_unref(src);
+	destroyPipeline(pipeline, sink);
+
+	if( result )
+		printf("buffer-pool-test -- appsrc:  %u frames, %u acquired, %llu dropped, all freed\n", numFrames, acquired, (unsigned long long)pool.GetDropped());
+
+	return result;
+}
+
+
+// buffers from the pool of videotestsrc are returned to it and reused, so the pipeline doesn't stall
+static bool testVideoTestSrc( uint32_t numFrames, uint32_t capacity, uint64_t timeout )
+{
+	char launch[256];
+
+	snprintf(launch, sizeof(launch), "videotestsrc num-buffers=%u ! video/x-raw,format=I420,width=320,height=240 ! "
+		    "appsink name=sink sync=false enable-last-sample=false", numFrames);
+
+	GstAppSink* sink = NULL;
+	GstElement* pipeline = createPipeline(launch, &sink);
+
+	if( !pipeline )
+		return false;
+
+	gstBufferRefPool pool(capacity);
+
+	std::set<GstBuffer*> buffers;  // only compared, the buffers aren't accessed after they're released
+	uint32_t received = 0;
+	bool result = true;
+
+	while( received < numFrames )
+	{
+		GstBuffer* buffer = pullBuffer(sink, pool, timeout);
+
+		if( !buffer )
+		{
+			printf("buffer-pool-test -- videotestsrc:  failed to receive frame %u\n", received);
+			result = false;
+			break;
+		}
+
+		buffers.insert(buffer);
+		received++;
+
+		if( pool.GetCount() > capacity )
+		{
+			printf("buffer-pool-test -- videotestsrc:  the pool holds %u buffers (capacity %u)\n", pool.GetCount(), capacity);
+			result = false;
+			break;
+		}
+
+		if( received % 4 == 0 )
+		{
+			size_t size = 0;
+
+			if( !pool.Acquire(&size) || size != 320 * 240 * 3 / 2 )
+			{
+				printf("buffer-pool-test -- videotestsrc:  failed to acquire frame %u\n", received);
+				result = false;
+				break;
+			}
+		}
+	}
+
+	pool.Clear();
+
+	// if the references weren't returned, videotestsrc would allocate a new buffer for every frame
+	const size_t maxBuffers = capacity + 4;
+
+	if( result && buffers.size() > maxBuffers )
+	{
+		printf("buffer-pool-test -- videotestsrc:  %zu different buffers were used for %u frames (expected <= %zu)\n",
+			  buffers.size(), numFrames, maxBuffers);
+		result = false;
+	}
+
+	GstSample* extra = result ? gst_app_sink_try_pull_sample(sink, timeout * GST_MSECOND) : NULL;
+
+	if( extra != NULL )
+	{
+		printf("buffer-pool-test -- videotestsrc:  received more than %u frames\n", numFrames);
+		gst_sample_unref(extra);
+		result = false;
+	}
+
+	destroyPipeline(pipeline, sink);
+
+	if( result )
+		printf("buffer-pool-test -- videotestsrc:  %u frames in %zu buffers, %llu dropped\n", received, buffers.size(), (unsigned long long)pool.GetDropped());
+
+	return result;
+}
+
+
+int main( int argc, char** argv )
+{
+	commandLine cmdLine(argc, argv);
+
+	if( cmdLine.GetFlag("help") )
+		return usage();
+
+	Log::ParseCmdLine(cmdLine);
+
+	if( !gstreamerInit() )
+	{
+		printf("buffer-pool-test -- failed to initialize GStreamer\n");
+		return 1;
+	}
+
+	const uint32_t numFrames = cmdLine.GetUnsignedInt("frames", 100);
+	const uint32_t capacity = cmdLine.GetUnsignedInt("capacity", 3);
+	const uint64_t timeout = cmdLine.GetUnsignedInt("timeout", 5000);
+
+	const bool appsrc = testAppSrc(numFrames, capacity, timeout);
+	const bool videotestsrc = testVideoTestSrc(numFrames, capacity, timeout);
+
+	if( !appsrc || !videotestsrc )
+	{
+		printf("buffer-pool-test -- FAILED\n");
+		return 1;
+	}
+
+	printf("buffer-pool-test -- passed\n");
+	return 0;
+}
+
@@ -0,0 +1,355 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "detectNet.h"
+#include "detectionGrid.h"
+#include "commandLine.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+
+typedef detectNet::Detection Detection;
+
+
+int usage()
+{
+	printf("usage: cluster-bench [--help] [--iterations=N] [--seed=N] [--trials=N]\n\n");
+	printf("Check that the grid-accelerated clustering of detectNet gives the same\n");
+	printf("results as comparing every detection, and benchmark both of them with\n");
+	printf("1000 to 20000 raw bounding boxes.\n\n");
+	printf("optional arguments:\n");
+	printf("  --help            show this help message and exit\n");
+	printf("  --iterations=N    number of times each benchmark is run (default: 5)\n");
+	printf("  --trials=N        number of randomized equivalence tests (default: 500)\n");
+	printf("  --seed=N          random seed (default: 1)\n\n");
+
+	return 0;
+}
+
+
+// monotonic time in milliseconds
+static double currentTime()
+{
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000.0 + t.tv_nsec * 0.000001;
+}
+
+
+static float uniform( float min, float max )
+{
+	return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+
+
+// the original clustering of detectNet::clusterDetections(), that tests every detection before it
+static int referenceCluster( Detection* detections, int n, float threshold )
+{
+	if( n == 0 )
+		return 1;
+
+	for( int m=0; m < n; m++ )
+	{
+		if( detections[n].Intersects(detections[m], threshold) )
+		{
+		#ifdef CLUSTER_INTERCLASS
+			if( detections[n].ClassID != detections[m].ClassID )
+			{
+				if( detections[n].Confidence > detections[m].Confidence )
+				{
+					detections[m] = detections[n];
+					detections[m].TrackID = -1;
+				}
+
+				return 0;
+			}
+			else
+		#else
+			if( detections[n].ClassID == detections[m].ClassID )
+		#endif
+			{
+				detections[m].Expand(detections[n]);
+				detections[m].Confidence = fmaxf(detections[n].Confidence, detections[m].Confidence);
+				return 0;
+			}
+		}
+	}
+
+	return 1;
+}
+
+
+// the original bubble sort of detectNet::sortDetections()
+static void referenceSort( Detection* detections, int numDetections )
+{
+	for( int i=0; i < numDetections-1; i++ )
+	{
+		for( int j=0; j < numDetections-i-1; j++ )
+		{
+			if( detections[j].Area() < detections[j+1].Area() )
+			{
+				const Detection det = detections[j];
+				detections[j] = detections[j+1];
+				detections[j+1] = det;
+			}
+		}
+	}
+}
+
+
+// raw boxes like those of a dense grid - a cloud of jittered boxes around each object
+static void generateBoxes( std::vector<Detection>& boxes, int numBoxes, int numObjects, int numClasses,
+					  float width, float height, float size, float jitter, bool special )
+{
+	std::vector<Detection> objects(numObjects);
+
+	for( int n=0; n < numObjects; n++ )
+	{
+		const float w = uniform(8.0f, width * size);
+		const float h = uniform(8.0f, height * size);
+		const float x = uniform(-w * 0.5f, width - w * 0.5f);
+		const float y = uniform(-h * 0.5f, height - h * 0.5f);
+
+		objects[n].ClassID = rand() % numClasses;
+		objects[n].Left    = x;
+		objects[n].Top     = y;
+		objects[n].Right   = x + w;
+		objects[n].Bottom  = y + h;
+	}
+
+	boxes.resize(numBoxes);
+
+	for( int n=0; n < numBoxes; n++ )
+	{
+		const Detection& obj = objects[rand() % numObjects];
+
+		boxes[n].ClassID    = (rand() % 10 == 0) ? rand() % numClasses : obj.ClassID;
+		boxes[n].Confidence = uniform(0.5f, 1.0f);
+		boxes[n].Left       = obj.Left + uniform(-jitter, jitter) * obj.Width();
+		boxes[n].Top        = obj.Top + uniform(-jitter, jitter) * obj.Height();
+		boxes[n].Right      = obj.Right + uniform(-jitter, jitter) * obj.Width();
+		boxes[n].Bottom     = obj.Bottom + uniform(-jitter, jitter) * obj.Height();
+
+		if( !special )
+			continue;
+
+		// degenerate, inverted, offscreen, infinite and NaN boxes
+		switch( rand() % 40 )
+		{
+			case 0:	boxes[n].Right = boxes[n].Left; break;
+			case 1:	std::swap(boxes[n].Left, boxes[n].Right); break;
+			case 2:	boxes[n].Left -= width * 2; boxes[n].Right += width * 2; break;
+			case 3:	boxes[n].Bottom = INFINITY; break;
+			case 4:	boxes[n].Top = NAN; break;
+			case 5:	boxes[n].Left = boxes[n].Right = width + 10.0f; break;
+		}
+	}
+}
+
+
+// cluster the raw boxes into detections, like detectNet::postProcess() does
+template<typename Cluster>
+static int clusterBoxes( const std::vector<Detection>& boxes, Detection* detections, Cluster cluster )
+{
+	int numDetections = 0;
+
+	for( size_t n=0; n < boxes.size(); n++ )
+	{
+		detections[numDetections] = boxes[n];
+		numDetections += cluster(detections, numDetections);
+	}
+
+	return numDetections;
+}
+
+
+static bool sameDetections( const Detection* a, const Detection* b, int numDetections )
+{
+	return memcmp(a, b, sizeof(Detection) * numDetections) == 0;
+}
+
+
+// compare the grid against the reference on random boxes
+static bool testEquivalence( int trials )
+{
+	const float thresholds[] = { 0.0f, 0.25f, 0.75f, 1.0f, -0.5f };
+
+	detectionGrid grid;
+
+	for( int t=0; t < trials; t++ )
+	{
+		const float width  = uniform(64.0f, 1920.0f);
+		const float height = uniform(64.0f, 1080.0f);
+
+		const float threshold = thresholds[t % (sizeof(thresholds) / sizeof(float))];
+		const bool special = (t % 3 == 0);
+
+		std::vector<Detection> boxes;
+		generateBoxes(boxes, 1 + rand() % 2000, 1 + rand() % 200, 1 + rand() % 4, width, height, uniform(0.02f, 0.5f), uniform(0.0f, 0.3f), special);
+
+		std::vector<Detection> expected(boxes.size());
+		std::vector<Detection> results(boxes.size());
+
+		// detectNet::clusterDetections()
+		const int numExpected = clusterBoxes(boxes, expected.data(), [threshold](Detection* d, int n) { return referenceCluster(d, n, threshold); });
+
+		grid.Reset(width, height);
+		const int numResults = clusterBoxes(boxes, results.data(), [&grid, threshold](Detection* d, int n) { return grid.Cluster(d, n, threshold); });
+
+		if( numResults != numExpected || !sameDetections(results.data(), expected.data(), numExpected) )
+		{
+			printf("cluster-bench -- clustering of trial %i is different (%i vs %i detections, threshold %g)\n", t, numResults, numExpected, threshold);
+			return false;
+		}
+
+		// detectNet::postProcessDetectNet()
+		int numMerged = 0;
+		int numMergedExpected = 0;
+
+		grid.Reset(width, height);
+
+		for( size_t n=0; n < boxes.size(); n++ )
+		{
+			const Detection& box = boxes[n];
+
+			bool merged = false;
+
+			for( int m=0; m < numMergedExpected; m++ )
+			{
+				if( expected[m].ClassID == box.ClassID && expected[m].Expand(box.Left, box.Top, box.Right, box.Bottom) )
+				{
+					merged = true;
+					break;
+				}
+			}
+
+			if( !merged )
+				expected[numMergedExpected++] = box;
+
+			if( !grid.Expand(results.data(), numMerged, box.ClassID, box.Left, box.Top, box.Right, box.Bottom) )
+			{
+				results[numMerged] = box;
+				grid.Insert(numMerged, box.Left, box.Top, box.Right, box.Bottom);
+				numMerged++;
+			}
+		}
+
+		if( numMerged != numMergedExpected || !sameDetections(results.data(), expected.data(), numMerged) )
+		{
+			printf("cluster-bench -- merging of trial %i is different (%i vs %i detections)\n", t, numMerged, numMergedExpected);
+			return false;
+		}
+
+		// detectNet::sortDetections()
+		referenceSort(expected.data(), numMerged);
+		detectionGrid::SortByArea(results.data(), numMerged);
+
+		if( !sameDetections(results.data(), expected.data(), numMerged) )
+		{
+			printf("cluster-bench -- sorting of trial %i is different\n", t);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+// time the reference and the grid on increasing numbers of boxes
+static void benchmark( int iterations )
+{
+	const int   numBoxes[] = { 1000, 2000, 5000, 10000, 20000 };
+	const float width  = 1920.0f;
+	const float height = 1080.0f;
+	const float threshold = DETECTNET_DEFAULT_CLUSTERING_THRESHOLD;
+
+	printf("\n%-8s %-10s %-12s %-12s %-12s %-12s %-8s\n", "boxes", "clusters", "linear", "grid", "bubble sort", "stable sort", "speedup");
+
+	detectionGrid grid;
+
+	for( size_t b=0; b < sizeof(numBoxes) / sizeof(int); b++ )
+	{
+		std::vector<Detection> boxes;
+		generateBoxes(boxes, numBoxes[b], numBoxes[b] / 20, 4, width, height, 0.1f, 0.05f, false);
+
+		std::vector<Detection> detections(boxes.size());
+		std::vector<Detection> sorted(boxes.size());
+
+		double linearTime = 0, gridTime = 0, bubbleTime = 0, sortTime = 0;
+		int numDetections = 0;
+
+		for( int i=0; i < iterations; i++ )
+		{
+			double t = currentTime();
+			numDetections = clusterBoxes(boxes, detections.data(), [threshold](Detection* d, int n) { return referenceCluster(d, n, threshold); });
+			linearTime += currentTime() - t;
+
+			t = currentTime();
+			grid.Reset(width, height);
+			clusterBoxes(boxes, detections.data(), [&grid, threshold](Detection* d, int n) { return grid.Cluster(d, n, threshold); });
+			gridTime += currentTime() - t;
+
+			std::copy(detections.begin(), detections.begin() + numDetections, sorted.begin());
+			t = currentTime();
+			referenceSort(sorted.data(), numDetections);
+			bubbleTime += currentTime() - t;
+
+			std::copy(detections.begin(), detections.begin() + numDetections, sorted.begin());
+			t = currentTime();
+			detectionGrid::SortByArea(sorted.data(), numDetections);
+			sortTime += currentTime() - t;
+		}
+
+		printf("%-8i %-10i %8.3f ms  %8.3f ms  %8.3f ms  %8.3f ms  %6.1fx\n", numBoxes[b], numDetections,
+			  linearTime / iterations, gridTime / iterations, bubbleTime / iterations, sortTime / iterations,
+			  (linearTime + bubbleTime) / (gridTime + sortTime));
+	}
+}
+
+
+int main( int argc, char** argv )
+{
+	commandLine cmdLine(argc, argv);
+
+	if( cmdLine.GetFlag("help") )
+		return usage();
+
+	srand(cmdLine.GetUnsignedInt("seed", 1));
+
+	const int trials = cmdLine.GetUnsignedInt("trials", 500);
+
+	if( !testEquivalence(trials) )
+	{
+		printf("cluster-bench -- FAILED, the results of the grid don't match\n");
+		return 1;
+	}
+
+	printf("cluster-bench -- the results of the grid matched in %i randomized trials\n", trials);
+
+	benchmark(cmdLine.GetUnsignedInt("iterations", 5));
+	return 0;
+}
@@ -0,0 +1,418 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "cpuColorspace.h"
+#include "cudaColorspace.h"
+#include "cudaMappedMemory.h"
+#include "commandLine.h"
+#include "logging.h"
+#include "Thread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+
+int usage()
+{
+	printf("usage: colorspace-test [--help] [--iterations=N] [--seed=N]\n\n");
+	printf("Check that the SIMD and multi-threaded paths of cpuConvertColor() give the same\n");
+	printf("results as the scalar path, for every supported pair of formats with odd and even\n");
+	printf("image sizes (and that the sizes YUV formats don't support are rejected).  If\n");
+	printf("there's a GPU, also check the results against cudaConvertColor().  Then benchmark\n");
+	printf("the conversion of a 1080p frame.\n\n");
+	printf("optional arguments:\n");
+	printf("  --help            show this help message and exit\n");
+	printf("  --iterations=N    number of times each benchmark is run (default: 20)\n");
+	printf("  --seed=N          random seed (default: 1)\n\n");
+
+	return 0;
+}
+
+
+static const imageFormat inputFormats[] = { IMAGE_RGB8, IMAGE_BGR8, IMAGE_RGBA8, IMAGE_BGRA8, IMAGE_GRAY8,
+									IMAGE_NV12, IMAGE_I420, IMAGE_YV12, IMAGE_YUYV, IMAGE_YVYU, IMAGE_UYVY };
+
+static const imageFormat outputFormats[] = { IMAGE_RGB8, IMAGE_BGR8, IMAGE_RGBA8, IMAGE_BGRA8, IMAGE_GRAY8,
+									 IMAGE_I420, IMAGE_YV12 };
+
+static const uint32_t numInputFormats = sizeof(inputFormats) / sizeof(imageFormat);
+static const uint32_t numOutputFormats = sizeof(outputFormats) / sizeof(imageFormat);
+
+
+// monotonic time in milliseconds
+static double currentTime()
+{
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000.0 + t.tv_nsec * 0.000001;
+}
+
+
+// if cpuConvertColor() should accept the image size for the formats
+static bool sizeSupported( imageFormat input, imageFormat output, uint32_t width, uint32_t height )
+{
+	if( input == output )
+		return true;  // the image is just copied
+
+	const bool yuv420 = (input == IMAGE_NV12 || input == IMAGE_I420 || input == IMAGE_YV12 ||
+					 output == IMAGE_I420 || output == IMAGE_YV12);
+
+	if( (imageFormatIsYUV(input) || imageFormatIsYUV(output)) && (width % 2) != 0 )
+		return false;
+
+	if( yuv420 && (height % 2) != 0 )
+		return false;
+
+	return true;
+}
+
+
+// convert with the given path (the output is pre-filled, so any bytes that aren't written compare equal)
+static bool convert( const std::vector<uint8_t>& input, imageFormat inputFormat, std::vector<uint8_t>& output, imageFormat outputFormat,
+				 uint32_t width, uint32_t height, bool simd, uint32_t numThreads )
+{
+	cpuColorspaceEnableSIMD(simd);
+	output.assign(imageFormatSize(outputFormat, width, height), 0xCD);
+	return cpuConvertColor(input.data(), inputFormat, output.data(), outputFormat, width, height, numThreads);
+}
+
+
+// an image of random pixels (the vector is sized exactly, so overruns are caught by ASan)
+static void randomImage( std::vector<uint8_t>& image, imageFormat format, uint32_t width, uint32_t height )
+{
+	image.resize(imageFormatSize(format, width, height));
+
+	for( size_t n=0; n < image.size(); n++ )
+		image[n] = rand() & 0xFF;
+}
+
+
+// compare each path against the scalar path on one thread
+static bool testEquivalence()
+{
+	const uint32_t sizes[][2] = { {1, 1}, {2, 2}, {2, 1}, {3, 5}, {4, 3}, {17, 9}, {32, 7}, {64, 33},
+							{66, 34}, {130, 66}, {131, 67}, {641, 479}, {640, 480}, {1280, 721} };
+
+	const uint32_t threads[] = { 2, 3, 7, 0 };
+
+	std::vector<uint8_t> input;
+	std::vector<uint8_t> expected;
+	std::vector<uint8_t> output;
+
+	uint32_t numTests = 0;
+
+	// the sizes that are rejected would log errors
+	const Log::Level logLevel = Log::GetLevel();
+	Log::SetLevel(Log::SILENT);
+
+	for( size_t s=0; s < sizeof(sizes) / sizeof(sizes[0]); s++ )
+	{
+		const uint32_t width = sizes[s][0];
+		const uint32_t height = sizes[s][1];
+
+		for( uint32_t i=0; i < numInputFormats; i++ )
+		{
+			randomImage(input, inputFormats[i], width, height);
+
+			for( uint32_t o=0; o < numOutputFormats; o++ )
+			{
+				const imageFormat inputFormat = inputFormats[i];
+				const imageFormat outputFormat = outputFormats[o];
+
+				if( !cpuConvertColorSupported(inputFormat, outputFormat) )
+					continue;
+
+				const bool supported = sizeSupported(inputFormat, outputFormat, width, height);
+
+				if( convert(input, inputFormat, expected, outputFormat, width, height, false, 1) != supported )
+				{
+					printf("colorspace-test -- %s -> %s %ux%u should have %s\n", imageFormatToStr(inputFormat), imageFormatToStr(outputFormat),
+						  width, height, supported ? "succeeded" : "failed");
+					Log::SetLevel(logLevel);
+					return false;
+				}
+
+				if( !supported )
+					continue;
+
+				for( int path=0; path < 1 + 2 * (int)(sizeof(threads) / sizeof(uint32_t)); path++ )
+				{
+					const bool simd = (path == 0) || (path % 2 == 1);
+					const uint32_t numThreads = (path == 0) ? 1 : threads[(path - 1) / 2];
+
+					if( !convert(input, inputFormat, output, outputFormat, width, height, simd, numThreads) || output != expected )
+					{
+						printf("colorspace-test -- %s -> %s %ux%u is different with simd=%i threads=%u\n", imageFormatToStr(inputFormat),
+							  imageFormatToStr(outputFormat), width, height, (int)simd, numThreads);
+						Log::SetLevel(logLevel);
+						return false;
+					}
+
+					numTests++;
+				}
+			}
+		}
+	}
+
+	Log::SetLevel(logLevel);
+	cpuColorspaceEnableSIMD(true);
+
+	printf("colorspace-test -- %u conversions matched the scalar path (SIMD: %s)\n", numTests, cpuColorspaceSIMD());
+	return true;
+}
+
+
+// compare the scalar path against the CUDA kernels (within 1 LSB, where the GPU contracts to FMA)
+static bool testCUDA()
+{
+	int numDevices = 0;
+
+	if( cudaGetDeviceCount(&numDevices) != cudaSuccess || numDevices == 0 )
+	{
+		cudaGetLastError();
+		printf("colorspace-test -- no GPU found, skipping the comparison with cudaConvertColor()\n");
+		return true;
+	}
+
+	const uint32_t sizes[][2] = { {2, 2}, {4, 3}, {64, 32}, {66, 34}, {130, 66}, {640, 480} };
+
+	const size_t maxSize = imageFormatSize(IMAGE_RGBA8, 640, 480);
+
+	uint8_t* cudaInput = NULL;
+	uint8_t* cudaOutput = NULL;
+
+	if( !cudaAllocMapped(&cudaInput, maxSize) || !cudaAllocMapped(&cudaOutput, maxSize) )
+	{
+		CUDA_FREE_HOST(cudaInput);
+		return false;
+	}
+
+	std::vector<uint8_t> input;
+	std::vector<uint8_t> expected;
+
+	uint32_t numTests = 0;
+	uint32_t numSkipped = 0;
+	bool result = true;
+
+	// the pairs that cudaConvertColor() doesn't support would log errors
+	const Log::Level logLevel = Log::GetLevel();
+	Log::SetLevel(Log::SILENT);
+
+	for( size_t s=0; s < sizeof(sizes) / sizeof(sizes[0]) && result; s++ )
+	{
+		const uint32_t width = sizes[s][0];
+		const uint32_t height = sizes[s][1];
+
+		for( uint32_t i=0; i < numInputFormats && result; i++ )
+		{
+			const imageFormat inputFormat = inputFormats[i];
+
+			randomImage(input, inputFormat, width, height);
+
+			for( uint32_t o=0; o < numOutputFormats && result; o++ )
+			{
+				const imageFormat outputFormat = outputFormats[o];
+
+				if( inputFormat == outputFormat || !cpuConvertColorSupported(inputFormat, outputFormat) || !sizeSupported(inputFormat, outputFormat, width, height) )
+					continue;
+
+				if( !convert(input, inputFormat, expected, outputFormat, width, height, false, 1) )
+				{
+					result = false;
+					break;
+				}
+
+				// the output is pre-filled the same way, so the bytes that neither writes compare equal
+				memcpy(cudaInput, input.data(), input.size());
+				memset(cudaOutput, 0xCD, expected.size());
+
+				if( cudaConvertColor(cudaInput, inputFormat, cudaOutput, outputFormat, width, height) != cudaSuccess || cudaDeviceSynchronize() != cudaSuccess )
+				{
+					cudaGetLastError();
+					numSkipped++;	// not supported by cudaConvertColor()
+					continue;
+				}
+
+				for( size_t n=0; n < expected.size(); n++ )
+				{
+					if( abs((int)cudaOutput[n] - (int)expected[n]) > 1 )
+					{
+						Log::SetLevel(logLevel);
+						printf("colorspace-test -- %s -> %s %ux%u is different from cudaConvertColor() at byte %zu (%u vs %u)\n",
+							  imageFormatToStr(inputFormat), imageFormatToStr(outputFormat), width, height, n,
+							  (uint32_t)expected[n], (uint32_t)cudaOutput[n]);
+						result = false;
+						break;
+					}
+				}
+
+				numTests++;
+			}
+		}
+	}
+
+	Log::SetLevel(logLevel);
+
+	CUDA_FREE_HOST(cudaInput);
+	CUDA_FREE_HOST(cudaOutput);
+
+	if( result )
+		printf("colorspace-test -- %u conversions matched cudaConvertColor() (%u pairs it doesn't support were skipped)\n", numTests, numSkipped);
+
+	return result;
+}
+
+
+// several threads converting at once, so they contend for the worker threads
+struct concurrentTest
+{
+	const std::vector<uint8_t>* input;
+	const std::vector<uint8_t>* expected;
+
+	bool result;
+};
+
+static void* concurrentThread( void* param )
+{
+	concurrentTest* test = (concurrentTest*)param;
+	std::vector<uint8_t> output(test->expected->size());
+
+	test->result = true;
+
+	for( int n=0; n < 50; n++ )
+	{
+		if( !cpuConvertColor(test->input->data(), IMAGE_NV12, output.data(), IMAGE_RGB8, 640, 480, 4) || output != *test->expected )
+			test->result = false;
+	}
+
+	return NULL;
+}
+
+static bool testConcurrent()
+{
+	std::vector<uint8_t> input;
+	std::vector<uint8_t> expected;
+
+	randomImage(input, IMAGE_NV12, 640, 480);
+
+	if( !convert(input, IMAGE_NV12, expected, IMAGE_RGB8, 640, 480, true, 1) )
+		return false;
+
+	const uint32_t numThreads = 4;
+
+	std::vector<concurrentTest> tests(numThreads);
+	std::vector<Thread*> threads(numThreads);
+
+	for( uint32_t n=0; n < numThreads; n++ )
+	{
+		tests[n].input = &input;
+		tests[n].expected = &expected;
+		tests[n].result = false;
+
+		threads[n] = new Thread();
+
+		if( !threads[n]->Start(concurrentThread, &tests[n]) )
+			concurrentThread(&tests[n]);
+	}
+
+	bool result = true;
+
+	for( uint32_t n=0; n < numThreads; n++ )
+	{
+		threads[n]->Stop(true);
+		delete threads[n];
+
+		if( !tests[n].result )
+			result = false;
+	}
+
+	if( !result )
+	{
+		printf("colorspace-test -- concurrent conversions gave different results\n");
+		return false;
+	}
+
+	printf("colorspace-test -- concurrent conversions from %u threads matched\n", numThreads);
+	return true;
+}
+
+
+// time the scalar, SIMD and threaded paths
+static void benchmark( imageFormat inputFormat, imageFormat outputFormat, int iterations )
+{
+	const uint32_t width = 1920;
+	const uint32_t height = 1080;
+
+	std::vector<uint8_t> input;
+	std::vector<uint8_t> output;
+
+	randomImage(input, inputFormat, width, height);
+
+	double times[3] = { 0, 0, 0 };
+
+	for( int i=0; i < iterations; i++ )
+	{
+		for( int path=0; path < 3; path++ )
+		{
+			const double t = currentTime();
+			convert(input, inputFormat, output, outputFormat, width, height, path > 0, path > 1 ? 0 : 1);
+			times[path] += currentTime() - t;
+		}
+	}
+
+	printf("%-6s -> %-6s  %8.3f ms  %8.3f ms  %8.3f ms  %6.1fx\n", imageFormatToStr(inputFormat), imageFormatToStr(outputFormat),
+		  times[0] / iterations, times[1] / iterations, times[2] / iterations, times[0] / times[2]);
+}
+
+
+int main( int argc, char** argv )
+{
+	commandLine cmdLine(argc, argv);
+
+	if( cmdLine.GetFlag("help") )
+		return usage();
+
+	srand(cmdLine.GetUnsignedInt("seed", 1));
+
+	if( !testEquivalence() || !testCUDA() || !testConcurrent() )
+	{
+		printf("colorspace-test -- FAILED\n");
+		return 1;
+	}
+
+	const int iterations = cmdLine.GetUnsignedInt("iterations", 20);
+
+	printf("\n%-16s  %-11s  %-11s  %-11s  %-8s\n", "1920x1080", "scalar", "SIMD", "threads", "speedup");
+
+	benchmark(IMAGE_NV12, IMAGE_RGB8, iterations);
+	benchmark(IMAGE_YUYV, IMAGE_RGBA8, iterations);
+	benchmark(IMAGE_RGB8, IMAGE_I420, iterations);
+	benchmark(IMAGE_BGRA8, IMAGE_GRAY8, iterations);
+
+	cpuColorspaceEnableSIMD(true);
+	return 0;
+}
+
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "configStore.h"
+#include "commandLine.h"
+#include "logging.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+
+
+int usage()
+{
+	printf("usage: config-test [--help]\n\n");
+	printf("Check how configStore layers the values from a JSON config file, environment\n");
+	printf("variables and the command line, and how they're applied to a commandLine\n");
+	printf("(in particular that boolean flags set to false don't enable the flag).\n\n");
+	printf("optional arguments:\n");
+	printf("  --help            show this help message and exit\n\n");
+
+	return 0;
+}
+
+
+static int numFailed = 0;
+
+// report a failed check
+static void check( bool condition, const char* description )
+{
+	if( condition )
+		return;
+
+	printf("config-test -- FAILED:  %s\n", description);
+	numFailed++;
+}
+
+
+// write the config file
+static bool writeConfig( const char* path )
+{
+	FILE* file = fopen(path, "w");
+
+	if( !file )
+		return false;
+
+	fprintf(file, "{\n"
+			    "  \"headless\": false,\n"
+			    "  \"input-zero-copy\": true,\n"
+			    "  \"adaptive_rate\": \"off\",\n"
+			    "  \"multicast\": \"yes\",\n"
+			    "  \"detect-max-rate\": 0,\n"
+			    "  \"threshold\": 0.25,\n"
+			    "  \"overlay\": \"box,labels\",\n"
+			    "  \"telemetry\": { \"topic\": \"test\" }\n"
+			    "}\n");
+
+	fclose(file);
+	return true;
+}
+
+
+int main( int argc, char** argv )
+{
+	commandLine args(argc, argv);
+
+	if( args.GetFlag("help") )
+		return usage();
+
+	char path[] = "/tmp/config-test-XXXXXX";
+	const int fd = mkstemp(path);
+
+	if( fd < 0 || !writeConfig(path) )
+	{
+		printf("config-test -- failed to write the config file\n");
+		return 1;
+	}
+
+	close(fd);
+
+	// the environment overrides the file, and the command line overrides both
+	setenv("CONFIGTEST_MULTICAST", "no", 1);
+	setenv("CONFIGTEST_INPUT_CODEC", "h264", 1);
+
+	const std::string configArg = std::string("--config=") + path;
+	const char* cmdArgs[] = { "config-test", configArg.c_str(), "--threshold=0.5", "--verbose=false", NULL };
+
+	commandLine loadCmdLine(4, (char**)cmdArgs);
+	configStore config("CONFIGTEST");
+
+	check(config.Load(loadCmdLine), "loading the config");
+
+	check(!config.GetBool("headless", true), "headless should be false in the config");
+	check(config.GetBool("input-zero-copy"), "input-zero-copy should be true in the config");
+	check(!config.GetBool("multicast", true), "the environment should override multicast to false");
+	check(config.GetString("input-codec") == "h264", "input-codec should be loaded from the environment");
+	check(config.GetFloat("threshold") == 0.5f, "the command line should override the threshold");
+	check(config.GetLayer("threshold") == configStore::LAYER_CMDLINE, "the threshold should come from the command line");
+	check(config.GetString("telemetry.topic") == "test", "nested keys should be flattened");
+
+	// apply the config to a command line without any of the options
+	const char* appArgs[] = { "config-test", "--headless-test", NULL };
+	commandLine cmdLine(2, (char**)appArgs);
+
+	config.Apply(cmdLine);
+
+	check(!cmdLine.GetFlag("headless"), "\"headless\": false shouldn't enable the --headless flag");
+	check(!cmdLine.GetFlag("adaptive-rate"), "\"adaptive_rate\": \"off\" shouldn't enable the --adaptive-rate flag");
+	check(!cmdLine.GetFlag("multicast"), "MULTICAST=no shouldn't enable the --multicast flag");
+	check(!cmdLine.GetFlag("verbose"), "--verbose=false shouldn't enable the --verbose flag");
+	check(cmdLine.GetFlag("input-zero-copy"), "\"input-zero-copy\": true should enable the --input-zero-copy flag");
+	check(cmdLine.GetFlag("headless-test"), "the existing arguments should be kept");
+	check(cmdLine.GetFloat("detect-max-rate", 5.0f) == 0.0f, "numeric zero values should still be applied");
+	check(fabsf(cmdLine.GetFloat("threshold") - 0.5f) < 1e-6f, "the threshold should be applied from the command line layer");
+	check(strcmp(cmdLine.GetString("overlay", ""), "box,labels") == 0, "string values should be applied");
+	check(strcmp(cmdLine.GetString("input-codec", ""), "h264") == 0, "environment values should be applied");
+
+	// values that are set to true at runtime do enable the flag
+	config.Set("headless", "true");
+
+	commandLine runtimeCmdLine(1, (char**)appArgs);
+	config.Apply(runtimeCmdLine);
+
+	check(runtimeCmdLine.GetFlag("headless"), "headless set to true at runtime should enable the --headless flag");
+
+	// flags that are already on the command line stay enabled
+	config.Set("headless", "false");
+
+	const char* flagArgs[] = { "config-test", "--headless", NULL };
+	commandLine flagCmdLine(2, (char**)flagArgs);
+	config.Apply(flagCmdLine);
+
+	check(flagCmdLine.GetFlag("headless"), "--headless on the command line should stay enabled");
+
+	unlink(path);
+
+	if( numFailed > 0 )
+	{
+		printf("config-test -- %i checks FAILED\n", numFailed);
+		return 1;
+	}
+
+	printf("config-test -- passed\n");
+	return 0;
+}
+
@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "csvReader.h"
+#include "csvWriter.h"
+#include "commandLine.h"
+#include "logging.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+
+int usage()
+{
+	printf("usage: csv-test [--help] [--rows=N] [--seed=N]\n\n");
+	printf("Check that rows written by csvWriter are read back the same by csvReader::Next(),\n");
+	printf("with random fields containing whitespace, delimiters, quotes and newlines,\n");
+	printf("for writer/reader delimiters that do and don't trim the fields.\n\n");
+	printf("optional arguments:\n");
+	printf("  --help            show this help message and exit\n");
+	printf("  --rows=N          number of random rows for each delimiter (default: 20000)\n");
+	printf("  --seed=N          random seed (default: 1)\n\n");
+
+	return 0;
+}
+
+
+typedef std::vector<std::string> Row;
+
+
+// a random field (mostly made of the characters that need quoting or trimming)
+static std::string randomField()
+{
+	static const char chars[] = "ab1 \t,;\"#\n\r";
+
+	const int length = rand() % 8;
+	std::string field;
+
+	for( int n=0; n < length; n++ )
+		field += (rand() % 3 == 0) ? 'x' : chars[rand() % (sizeof(chars) - 1)];
+
+	return field;
+}
+
+
+// a random row (a row of one empty field would be an empty line, which is skipped)
+static void randomRow( Row& row )
+{
+	row.resize(1 + rand() % 6);
+
+	for( size_t n=0; n < row.size(); n++ )
+		row[n] = randomField();
+
+	if( row.size() == 1 && row[0].empty() )
+		row[0] = "x";
+}
+
+
+// print a row for a failure message
+static std::string rowToStr( const Row& row )
+{
+	std::string str;
+
+	for( size_t n=0; n < row.size(); n++ )
+	{
+		str += "[";
+
+		for( size_t c=0; c < row[n].size(); c++ )
+		{
+			if( row[n][c] == '\n' )
+				str += "\\n";
+			else if( row[n][c] == '\r' )
+				str += "\\r";
+			else if( row[n][c] == '\t' )
+				str += "\\t";
+			else
+				str += row[n][c];
+		}
+
+		str += "]";
+	}
+
+	return str;
+}
+
+
+// write the rows and read them back
+static bool testRoundTrip( const std::vector<Row>& rows, const char* writeDelimiter, const char* readDelimiters )
+{
+	char path[] = "/tmp/csv-test-XXXXXX";
+	const int fd = mkstemp(path);
+
+	if( fd < 0 )
+	{
+		printf("csv-test -- failed to create a temporary file\n");
+		return false;
+	}
+
+	close(fd);
+
+	csvWriter writer(path, writeDelimiter);
+
+	for( size_t r=0; r < rows.size(); r++ )
+	{
+		for( size_t n=0; n < rows[r].size(); n++ )
+			writer.Write(rows[r][n]);
+
+		writer.EndLine();
+	}
+
+	writer.Close();
+
+	csvReader reader(path, readDelimiters);
+	csvRow row;
+
+	size_t numRows = 0;
+	size_t mismatched = 0;
+
+	while( reader.Next(row) )
+	{
+		if( numRows >= rows.size() )
+		{
+			numRows++;
+			continue;
+		}
+
+		Row fields(row.size());
+
+		for( size_t n=0; n < row.size(); n++ )
+			fields[n] = row[n].str();
+
+		if( fields != rows[numRows] )
+		{
+			if( mismatched < 5 )
+				printf("csv-test -- line %llu:  wrote %s  read %s\n", (unsigned long long)row.line(), rowToStr(rows[numRows]).c_str(), rowToStr(fields).c_str());
+
+			mismatched++;
+		}
+
+		numRows++;
+	}
+
+	unlink(path);
+
+	printf("csv-test -- writer '%s', reader '%s':  %zu rows, %zu mismatched\n", writeDelimiter, readDelimiters, numRows, mismatched);
+
+	if( numRows != rows.size() )
+	{
+		printf("csv-test -- expected %zu rows\n", rows.size());
+		return false;
+	}
+
+	return mismatched == 0;
+}
+
+
+// parse a line and compare the fields
+static bool testLine( const char* line, const char* delimiters, const Row& expected )
+{
+	char path[] = "/tmp/csv-test-XXXXXX";
+	const int fd = mkstemp(path);
+
+	if( fd < 0 || write(fd, line, strlen(line)) != (ssize_t)strlen(line) )
+	{
+		printf("csv-test -- failed to write a temporary file\n");
+		return false;
+	}
+
+	close(fd);
+
+	csvReader reader(path, delimiters);
+	csvRow row;
+	Row fields;
+
+	if( reader.Next(row) )
+	{
+		for( size_t n=0; n < row.size(); n++ )
+			fields.push_back(row[n].str());
+	}
+
+	reader.Close();
+	unlink(path);
+
+	if( fields != expected )
+	{
+		printf("csv-test -- '%s' with delimiters '%s' was read as %s instead of %s\n", line, delimiters,
+			  rowToStr(fields).c_str(), rowToStr(expected).c_str());
+		return false;
+	}
+
+	return true;
+}
+
+
+int main( int argc, char** argv )
+{
+	commandLine cmdLine(argc, argv);
+
+	if( cmdLine.GetFlag("help") )
+		return usage();
+
+	srand(cmdLine.GetUnsignedInt("seed", 1));
+
+	const size_t numRows = cmdLine.GetUnsignedInt("rows", 20000);
+	bool result = true;
+
+	// unquoted fields are only trimmed if the delimiters include a space, whether or
+	// not there's a quoted field on the same line (whitespace before a quote is skipped)
+	result &= testLine(" a, b, c\n", ",", { " a", " b", " c" });
+	result &= testLine(" a, b, \"c\"\n", ",", { " a", " b", "c" });
+	result &= testLine(" a, b, c\n", ", ", { "a", "b", "c" });
+	result &= testLine(" a, b, \"c\"\n", ", ", { "a", "b", "c" });
+	result &= testLine("\"a\", b ,\t\"c\"\n", ",", { "a", " b ", "c" });
+
+	// random rows written and read back
+	std::vector<Row> rows(numRows);
+
+	for( size_t n=0; n < numRows; n++ )
+		randomRow(rows[n]);
+
+	result &= testRoundTrip(rows, ",", ",");
+	result &= testRoundTrip(rows, ",", ",;\t ");
+	result &= testRoundTrip(rows, ", ", ",;\t ");
+	result &= testRoundTrip(rows, ";", ";");
+
+	if( !result )
+	{
+		printf("csv-test -- FAILED\n");
+		return 1;
+	}
+
+	printf("csv-test -- passed\n");
+	return 0;
+}
+
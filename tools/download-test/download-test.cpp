@@ -0,0 +1,743 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "modelDownloader.h"
+
+#include "commandLine.h"
+#include "filesystem.h"
+#include "logging.h"
+#include "Mutex.h"
+#include "Process.h"
+#include "Thread.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <ftw.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+
+int usage()
+{
+	printf("usage: download-test [--help]\n\n");
+	printf("Test the model downloader against a local HTTP server:  downloading and installing\n");
+	printf("from the cache, resuming interrupted downloads, restarting when the server doesn't\n");
+	printf("support ranges, finishing on 416 when the partial download was already complete,\n");
+	printf("rejecting archives that fail checksum verification, and skipping the entries of\n");
+	printf("archives with paths outside of the networks directory.\n\n");
+	printf("optional arguments:\n");
+	printf("  --help            show this help message and exit\n\n");
+	printf("%s", Log::Usage());
+
+	return 0;
+}
+
+
+/*
+ * Local HTTP server that serves one file, with support for Range requests.
+ * Each request can be made to misbehave by queueing the responses.
+ */
+class httpServer
+{
+public:
+	enum Response
+	{
+		SERVE,			// serve the file (or the requested range)
+		TRUNCATE,		// close the connection halfway through the file
+		OVERSTATE,		// send a Content-Length longer than the file, then close after the file
+		CORRUPT,		// serve the file with a byte changed
+	};
+
+	struct Request
+	{
+		std::string path;
+		int64_t rangeStart;	// -1 if there wasn't a Range header
+	};
+
+	httpServer() : mListenFD(-1), mPort(0), mRunning(false), mRanges(true) {}
+	~httpServer()	{ Close(); }
+
+	// listen on a free port of localhost
+	bool Open()
+	{
+		mListenFD = socket(AF_INET, SOCK_STREAM, 0);
+
+		if( mListenFD < 0 )
+			return false;
+
+		sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+
+		addr.sin_family      = AF_INET;
+		addr.sin_port        = 0;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		socklen_t length = sizeof(addr);
+
+		if( bind(mListenFD, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(mListenFD, 8) != 0 ||
+		    getsockname(mListenFD, (sockaddr*)&addr, &length) != 0 )
+		{
+			printf("download-test -- failed to open the server socket (%s)\n", strerror(errno));
+			return false;
+		}
+
+		mPort = ntohs(addr.sin_port);
+		mRunning = true;
+
+		if( !mThread.Start(serverThread, this) )
+		{
+			mRunning = false;
+			return false;
+		}
+
+		return true;
+	}
+
+	// stop the server
+	void Close()
+	{
+		if( mRunning )
+		{
+			mRunning = false;
+			mThread.Stop(true);
+		}
+
+		if( mListenFD >= 0 )
+		{
+			close(mListenFD);
+			mListenFD = -1;
+		}
+	}
+
+	// set the file that's served, how the next requests are responded to, and if ranges are supported
+	void Reset( const std::string& file, const std::vector<Response>& responses=std::vector<Response>(), bool ranges=true )
+	{
+		mMutex.Lock();
+		mFile = file;
+		mResponses.assign(responses.begin(), responses.end());
+		mRequests.clear();
+		mRanges = ranges;
+		mMutex.Unlock();
+	}
+
+	// get the requests that were made since the last Reset()
+	std::vector<Request> GetRequests()	{ mMutex.Lock(); std::vector<Request> requests = mRequests; mMutex.Unlock(); return requests; }
+
+	// get the URL of a file on the server
+	std::string GetURL( const char* filename ) const
+	{
+		char url[256];
+		snprintf(url, sizeof(url), "http://127.0.0.1:%hu/%s", mPort, filename);
+		return url;
+	}
+
+private:
+	static void* serverThread( void* param )
+	{
+		httpServer* server = (httpServer*)param;
+
+		while( server->mRunning )
+		{
+			pollfd fds;
+
+			fds.fd      = server->mListenFD;
+			fds.events  = POLLIN;
+			fds.revents = 0;
+
+			if( poll(&fds, 1, 10) <= 0 )
+				continue;
+
+			const int fd = accept(server->mListenFD, NULL, NULL);
+
+			if( fd < 0 )
+				continue;
+
+			server->respond(fd);
+			close(fd);
+		}
+
+		return NULL;
+	}
+
+	// read the request and send the response (one request per connection)
+	void respond( int fd )
+	{
+		std::string header;
+		char buffer[1024];
+
+		while( header.find("\r\n\r\n") == std::string::npos )
+		{
+			const ssize_t bytes = recv(fd, buffer, sizeof(buffer), 0);
+
+			if( bytes <= 0 )
+				return;
+
+			header.append(buffer, bytes);
+		}
+
+		Request request;
+
+		request.path = header.substr(4, header.find(' ', 4) - 4);
+		request.rangeStart = -1;
+
+		const size_t range = header.find("Range: bytes=");
+
+		if( range != std::string::npos )
+			request.rangeStart = strtoll(header.c_str() + range + 13, NULL, 10);
+
+		mMutex.Lock();
+
+		mRequests.push_back(request);
+
+		const Response response = mResponses.empty() ? SERVE : mResponses.front();
+		std::string file = mFile;
+		const bool ranges = mRanges;
+
+		if( !mResponses.empty() )
+			mResponses.pop_front();
+
+		mMutex.Unlock();
+
+		if( response == CORRUPT && file.size() > 0 )
+			file[file.size() / 2] ^= 0xFF;
+
+		const int64_t size = file.size();
+		int64_t start = 0;
+
+		char reply[256];
+
+		if( request.rangeStart >= 0 && ranges )
+		{
+			if( request.rangeStart >= size )
+			{
+				snprintf(reply, sizeof(reply), "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */%lli\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", (long long)size);
+				sendAll(fd, reply, strlen(reply));
+				return;
+			}
+
+			start = request.rangeStart;
+
+			snprintf(reply, sizeof(reply), "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes %lli-%lli/%lli\r\nContent-Length: %lli\r\nConnection: close\r\n\r\n",
+				    (long long)start, (long long)size - 1, (long long)size, (long long)(size - start));
+		}
+		else
+		{
+			snprintf(reply, sizeof(reply), "HTTP/1.1 200 OK\r\nContent-Length: %lli\r\nConnection: close\r\n\r\n",
+				    (long long)(response == OVERSTATE ? size + 16 : size));
+		}
+
+		int64_t end = size;
+
+		if( response == TRUNCATE )
+			end = start + (size - start) / 2;
+
+		if( sendAll(fd, reply, strlen(reply)) )
+			sendAll(fd, file.data() + start, end - start);
+	}
+
+	static bool sendAll( int fd, const char* data, size_t size )
+	{
+		while( size > 0 )
+		{
+			const ssize_t bytes = send(fd, data, size, MSG_NOSIGNAL);
+
+			if( bytes <= 0 )
+				return false;
+
+			data += bytes;
+			size -= bytes;
+		}
+
+		return true;
+	}
+
+	int mListenFD;
+	uint16_t mPort;
+
+	Thread mThread;
+	Mutex  mMutex;
+
+	volatile bool mRunning;
+	bool mRanges;
+
+	std::string mFile;
+	std::deque<Response> mResponses;
+	std::vector<Request> mRequests;
+};
+
+
+/*
+ * tar.gz archives of the test model
+ */
+static void tarEntry( std::string& tar, const std::string& name, char type, const std::string& data, const char* link="" )
+{
+	char header[512];
+	memset(header, 0, sizeof(header));
+
+	strncpy(header, name.c_str(), 100);
+	strncpy(header + 157, link, 100);
+
+	snprintf(header + 100, 8, "%07o", 0644);
+	snprintf(header + 108, 8, "%07o", 0);
+	snprintf(header + 116, 8, "%07o", 0);
+	snprintf(header + 124, 12, "%011llo", (unsigned long long)data.size());
+	snprintf(header + 136, 12, "%011o", 0);
+
+	header[156] = type;
+
+	memcpy(header + 257, "ustar", 6);
+	memcpy(header + 263, "00", 2);
+
+	// the checksum is computed with the checksum field as spaces
+	memset(header + 148, ' ', 8);
+
+	unsigned int checksum = 0;
+
+	for( size_t n=0; n < sizeof(header); n++ )
+		checksum += (uint8_t)header[n];
+
+	snprintf(header + 148, 8, "%06o", checksum);
+
+	tar.append(header, sizeof(header));
+	tar.append(data);
+	tar.append((512 - data.size() % 512) % 512, '\0');
+}
+
+
+static std::string gzipArchive( std::string tar )
+{
+	tar.append(1024, '\0');	// end of archive
+
+	uLongf size = compressBound(tar.size()) + 32;
+	std::vector<Bytef> buffer(size);
+
+	z_stream stream;
+	memset(&stream, 0, sizeof(stream));
+
+	// windowBits 15 + 16 writes a gzip header
+	if( deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK )
+		return "";
+
+	stream.next_in   = (Bytef*)tar.data();
+	stream.avail_in  = tar.size();
+	stream.next_out  = buffer.data();
+	stream.avail_out = buffer.size();
+
+	const int result = deflate(&stream, Z_FINISH);
+	size = stream.total_out;
+	deflateEnd(&stream);
+
+	if( result != Z_STREAM_END )
+		return "";
+
+	return std::string((const char*)buffer.data(), size);
+}
+
+
+// an archive of the model (large enough for the transfers to be split up)
+static std::string modelArchive( std::string& contents )
+{
+	contents.clear();
+
+	for( int n=0; n < 100000; n++ )
+		contents += std::to_string(n * 7919) + "\n";
+
+	std::string tar;
+
+	tarEntry(tar, "test-model/", '5', "");
+	tarEntry(tar, "test-model/model.txt", '0', contents);
+
+	return gzipArchive(tar);
+}
+
+
+/*
+ * test environment (a networks directory and cache under a temporary directory)
+ */
+static int removeEntry( const char* path, const struct stat*, int, struct FTW* )
+{
+	return remove(path);
+}
+
+
+struct testEnvironment
+{
+	std::string root;
+	std::string cache;
+	std::string cwd;
+
+	bool Create()
+	{
+		char path[] = "/tmp/download-test-XXXXXX";
+
+		if( !mkdtemp(path) )
+			return false;
+
+		root  = path;
+		cache = pathJoin(root, "cache");
+		cwd   = Process::GetWorkingDir();
+
+		// the downloader finds networks/ relative to the working directory
+		if( mkdir(pathJoin(root, "networks").c_str(), 0755) != 0 || chdir(root.c_str()) != 0 )
+			return false;
+
+		SetModelMirror(NULL);
+		SetModelCache(cache.c_str());
+		return true;
+	}
+
+	~testEnvironment()
+	{
+		if( cwd.length() > 0 && chdir(cwd.c_str()) != 0 )
+			printf("download-test -- failed to change back to %s\n", cwd.c_str());
+
+		if( root.length() > 0 )
+			nftw(root.c_str(), removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+
+		SetModelCache(NULL);
+	}
+
+	// the number of files in a directory of the cache
+	size_t CountCache( const char* dir ) const
+	{
+		DIR* d = opendir(pathJoin(cache, dir).c_str());
+
+		if( !d )
+			return 0;
+
+		size_t count = 0;
+		struct dirent* entry = NULL;
+
+		while( (entry = readdir(d)) != NULL )
+		{
+			if( entry->d_name[0] != '.' )
+				count++;
+		}
+
+		closedir(d);
+		return count;
+	}
+
+	// the hash of the archive in the cache
+	std::string CachedHash() const
+	{
+		DIR* d = opendir(pathJoin(cache, "sha256").c_str());
+		std::string hash;
+
+		if( !d )
+			return hash;
+
+		struct dirent* entry = NULL;
+
+		while( (entry = readdir(d)) != NULL )
+		{
+			if( strlen(entry->d_name) == 64 )
+				hash = entry->d_name;
+		}
+
+		closedir(d);
+		return hash;
+	}
+};
+
+
+static int numFailed = 0;
+
+// report a failed check
+static bool check( bool condition, const char* test, const char* description )
+{
+	if( condition )
+		return true;
+
+	printf("download-test -- %s:  FAILED %s\n", test, description);
+	numFailed++;
+	return false;
+}
+
+
+// the config of the test model
+static nlohmann::json modelConfig( const std::string& url, const std::string& sha256="" )
+{
+	nlohmann::json model;
+
+	model["dir"] = "test-model";
+	model["url"] = url;
+
+	if( sha256.length() > 0 )
+		model["sha256"] = sha256;
+
+	return model;
+}
+
+
+// download the model, with the errors silenced if it's expected to fail
+static bool download( const nlohmann::json& config, uint32_t retries, bool expectFailure=false )
+{
+	std::vector<nlohmann::json> models(1, config);
+
+	const Log::Level level = Log::GetLevel();
+
+	if( expectFailure )
+		Log::SetLevel(Log::SILENT);
+
+	const bool result = DownloadModels(models, retries, 1);
+
+	Log::SetLevel(level);
+	return result;
+}
+
+
+static bool isInstalled( const std::string& contents )
+{
+	return readFile("networks/test-model/model.txt") == contents;
+}
+
+
+// download and install the model, and then install it again from the cache
+static void testDownload( httpServer& server, std::string& hash )
+{
+	testEnvironment env;
+
+	if( !check(env.Create(), "download", "to create the test environment") )
+		return;
+
+	std::string contents;
+	server.Reset(modelArchive(contents));
+
+	const nlohmann::json config = modelConfig(server.GetURL("test-model.tar.gz"));
+
+	check(download(config, 2), "download", "to download the model");
+	check(isInstalled(contents), "download", "to install the model");
+	check(server.GetRequests().size() == 1 && server.GetRequests()[0].rangeStart < 0, "download", "one request without a range");
+	check(env.CountCache("sha256") == 1 && env.CountCache("urls") == 1 && env.CountCache("partial") == 0, "download", "the archive should be moved into the cache");
+
+	hash = env.CachedHash();
+
+	// reinstall from the cache, without any requests
+	nftw("networks/test-model", removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+	server.Reset(modelArchive(contents));
+
+	check(download(config, 2), "download", "to reinstall the model");
+	check(isInstalled(contents), "download", "to reinstall the model from the cache");
+	check(server.GetRequests().size() == 0, "download", "the cached archive should be used");
+}
+
+
+// an interrupted download is resumed where it left off
+static void testResume( httpServer& server )
+{
+	testEnvironment env;
+
+	if( !check(env.Create(), "resume", "to create the test environment") )
+		return;
+
+	std::string contents;
+	const std::string archive = modelArchive(contents);
+
+	server.Reset(archive, { httpServer::TRUNCATE });
+
+	check(download(modelConfig(server.GetURL("test-model.tar.gz")), 2), "resume", "to download the model");
+	check(isInstalled(contents), "resume", "to install the model");
+
+	const std::vector<httpServer::Request> requests = server.GetRequests();
+
+	check(requests.size() == 2 && requests[0].rangeStart < 0 && requests[1].rangeStart == (int64_t)archive.size() / 2,
+		 "resume", "the second request should resume from the middle of the archive");
+}
+
+
+// a server that ignores the Range header makes the download start over (without using up an attempt)
+static void testRangeError( httpServer& server )
+{
+	testEnvironment env;
+
+	if( !check(env.Create(), "range-error", "to create the test environment") )
+		return;
+
+	std::string contents;
+	server.Reset(modelArchive(contents), { httpServer::TRUNCATE }, false);
+
+	check(download(modelConfig(server.GetURL("test-model.tar.gz")), 2), "range-error", "to download the model");
+	check(isInstalled(contents), "range-error", "to install the model");
+
+	const std::vector<httpServer::Request> requests = server.GetRequests();
+
+	check(requests.size() == 3 && requests[1].rangeStart > 0 && requests[2].rangeStart < 0,
+		 "range-error", "the download should restart without a range after the server ignored it");
+}
+
+
+// a partial download that was already complete gets a 416 reply, which finishes it
+static void testRangeNotSatisfiable( httpServer& server )
+{
+	testEnvironment env;
+
+	if( !check(env.Create(), "416", "to create the test environment") )
+		return;
+
+	std::string contents;
+	const std::string archive = modelArchive(contents);
+
+	server.Reset(archive, { httpServer::OVERSTATE });
+
+	check(download(modelConfig(server.GetURL("test-model.tar.gz")), 2), "416", "to download the model");
+	check(isInstalled(contents), "416", "to install the model");
+
+	const std::vector<httpServer::Request> requests = server.GetRequests();
+
+	check(requests.size() == 2 && requests[1].rangeStart == (int64_t)archive.size(),
+		 "416", "the complete partial download should be requested from its end, and not downloaded again");
+}
+
+
+// archives that don't match the sha256 of the model aren't installed or cached
+static void testChecksum( httpServer& server, const std::string& hash )
+{
+	if( !check(hash.length() == 64, "checksum", "the hash of the archive from the download test") )
+		return;
+
+	std::string wrong = hash;
+	wrong[0] = (wrong[0] == '0') ? '1' : '0';
+
+	{
+		testEnvironment env;
+
+		if( !check(env.Create(), "checksum", "to create the test environment") )
+			return;
+
+		std::string contents;
+		server.Reset(modelArchive(contents));
+
+		check(!download(modelConfig(server.GetURL("test-model.tar.gz"), wrong), 2, true), "checksum", "the download should fail with the wrong sha256");
+		check(!fileExists("networks/test-model"), "checksum", "the model shouldn't be installed");
+		check(server.GetRequests().size() == 2, "checksum", "each attempt should download the archive");
+		check(env.CountCache("sha256") == 0 && env.CountCache("partial") == 0, "checksum", "the archive shouldn't be cached or resumed");
+	}
+
+	// a corrupted transfer is downloaded again from the start
+	{
+		testEnvironment env;
+
+		if( !check(env.Create(), "checksum", "to create the test environment") )
+			return;
+
+		std::string contents;
+		server.Reset(modelArchive(contents), { httpServer::CORRUPT });
+
+		check(download(modelConfig(server.GetURL("test-model.tar.gz"), hash), 2), "checksum", "to download the model after a corrupted transfer");
+		check(isInstalled(contents), "checksum", "to install the model");
+
+		const std::vector<httpServer::Request> requests = server.GetRequests();
+		check(requests.size() == 2 && requests[1].rangeStart < 0, "checksum", "the corrupted archive shouldn't be resumed");
+	}
+}
+
+
+// entries with absolute paths or parent references aren't extracted
+static void testSanitize( httpServer& server )
+{
+	testEnvironment env;
+
+	if( !check(env.Create(), "sanitize", "to create the test environment") )
+		return;
+
+	const std::string absolute = pathJoin(env.root, "absolute.txt");
+
+	std::string tar;
+
+	tarEntry(tar, "test-model/model.txt", '0', "model");
+	tarEntry(tar, "./test-model/dot.txt", '0', "dot");
+	tarEntry(tar, "../parent.txt", '0', "parent");
+	tarEntry(tar, "test-model/../../nested.txt", '0', "nested");
+	tarEntry(tar, absolute, '0', "absolute");
+	tarEntry(tar, "test-model/symlink", '2', "", "../../../etc/passwd");
+	tarEntry(tar, "test-model/hardlink", '1', "", "../parent.txt");
+	tarEntry(tar, "test-model/after.txt", '0', "after");
+
+	server.Reset(gzipArchive(tar));
+
+	check(download(modelConfig(server.GetURL("test-model.tar.gz")), 2), "sanitize", "to install the model");
+
+	check(readFile("networks/test-model/model.txt") == "model", "sanitize", "to extract test-model/model.txt");
+	check(readFile("networks/test-model/dot.txt") == "dot", "sanitize", "to extract ./test-model/dot.txt");
+	check(readFile("networks/test-model/after.txt") == "after", "sanitize", "to extract the entries after the rejected ones");
+
+	check(!fileExists("networks/parent.txt") && !fileExists("parent.txt"), "sanitize", "../parent.txt shouldn't be extracted");
+	check(!fileExists("nested.txt") && !fileExists("networks/nested.txt"), "sanitize", "test-model/../../nested.txt shouldn't be extracted");
+	check(!fileExists(absolute), "sanitize", "absolute paths shouldn't be extracted");
+	check(!fileExists("networks/test-model/symlink", FILE_LINK), "sanitize", "symlinks outside of the archive shouldn't be created");
+	check(!fileExists("networks/test-model/hardlink"), "sanitize", "hardlinks to paths outside of the archive shouldn't be created");
+}
+
+
+int main( int argc, char** argv )
+{
+	commandLine cmdLine(argc, argv);
+
+	if( cmdLine.GetFlag("help") )
+		return usage();
+
+	Log::ParseCmdLine(cmdLine);
+
+	httpServer server;
+
+	if( !server.Open() )
+	{
+		printf("download-test -- failed to start the HTTP server\n");
+		return 1;
+	}
+
+	std::string hash;
+
+	testDownload(server, hash);
+	testResume(server);
+	testRangeError(server);
+	testRangeNotSatisfiable(server);
+	testChecksum(server, hash);
+	testSanitize(server);
+
+	server.Close();
+
+	if( numFailed > 0 )
+	{
+		printf("download-test -- %i checks FAILED\n", numFailed);
+		return 1;
+	}
+
+	printf("download-test -- passed\n");
+	return 0;
+}
+
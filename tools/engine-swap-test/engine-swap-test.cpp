@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "engineSwapper.h"
+#include "commandLine.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+
+
+int usage()
+{
+	printf("usage: engine-swap-test [--help] [--build-time=MS] [--frame-time=MS]\n\n");
+	printf("Test the orchestration of background engine builds in tensorNet with a stub\n");
+	printf("builder, that stands in for TensorRT:  frames keep being processed with the\n");
+	printf("fallback engine while the engine is built, the new engine is swapped in once\n");
+	printf("between frames, and failed builds or swaps keep the fallback engine.\n\n");
+	printf("optional arguments:\n");
+	printf("  --help            show this help message and exit\n");
+	printf("  --build-time=MS   how long the stub builder takes (default: 200ms)\n");
+	printf("  --frame-time=MS   how long each frame takes to process (default: 5ms)\n\n");
+
+	return 0;
+}
+
+
+#define CHECK(x)  if( !(x) ) { printf("engine-swap-test -- FAILED:  %s  (line %i)\n", #x, __LINE__); return false; }
+
+
+// an engine made by the stub builder
+struct stubEngine
+{
+	int id;
+};
+
+static std::atomic<int> gEnginesAlive(0);	// engines that were built and not released yet
+
+
+// stub builder that takes a while, and optionally fails
+static engineSwapper::BuildFunction stubBuilder( int id, uint32_t buildTime, bool fail=false )
+{
+	return [id, buildTime, fail]() -> void*
+	{
+		usleep(buildTime * 1000);
+
+		if( fail )
+			return NULL;
+
+		gEnginesAlive++;
+		return new stubEngine{id};
+	};
+}
+
+
+static void stubRelease( void* engine )
+{
+	gEnginesAlive--;
+	delete (stubEngine*)engine;
+}
+
+
+// the network that runs the engine, like tensorNet::ProcessNetwork()
+struct stubNetwork
+{
+	stubEngine* engine;
+	bool inFrame;
+	int frames;
+	int swaps;
+	int swapFrame;
+
+	stubNetwork( int id ) : engine(new stubEngine{id}), inFrame(false), frames(0), swaps(0), swapFrame(-1)	{ gEnginesAlive++; }
+	~stubNetwork()	{ stubRelease(engine); }
+
+	bool Process( engineSwapper& swapper, uint32_t frameTime, bool accept=true )
+	{
+		swapper.Swap([this, accept](void* newEngine)
+		{
+			if( inFrame || !accept )
+				return false;
+
+			stubRelease(engine);
+			engine = (stubEngine*)newEngine;
+			swaps++;
+			swapFrame = frames;
+			return true;
+		});
+
+		inFrame = true;
+		usleep(frameTime * 1000);
+		inFrame = false;
+
+		frames++;
+		return true;
+	}
+};
+
+
+// the engine is swapped in once, between frames, after the fallback ran while it was built
+static bool testSwap( uint32_t buildTime, uint32_t frameTime )
+{
+	engineSwapper swapper;
+	stubNetwork network(0);
+
+	CHECK(swapper.GetStatus() == engineSwapper::IDLE);
+	CHECK(!swapper.Wait(0));
+
+	CHECK(swapper.Start(stubBuilder(1, buildTime), stubRelease));
+	CHECK(swapper.IsBuilding());
+	CHECK(!swapper.Start(stubBuilder(2, buildTime), stubRelease));
+
+	while( network.engine->id == 0 )
+	{
+		network.Process(swapper, frameTime);
+		CHECK(network.frames < int(buildTime / frameTime) * 10 + 100);
+	}
+
+	CHECK(swapper.GetStatus() == engineSwapper::SWAPPED);
+	CHECK(network.swaps == 1);
+	CHECK(network.swapFrame > 0);
+
+	for( int n=0; n < 10; n++ )
+		network.Process(swapper, 0);
+
+	CHECK(network.swaps == 1);
+	CHECK(network.engine->id == 1);
+	CHECK(swapper.Wait(0));
+
+	printf("engine-swap-test -- swapped in the engine after %i frames with the fallback engine\n", network.swapFrame);
+	return true;
+}
+
+
+// a failed build keeps the fallback engine
+static bool testBuildFailed( uint32_t buildTime )
+{
+	engineSwapper swapper;
+	stubNetwork network(0);
+
+	CHECK(swapper.Start(stubBuilder(1, buildTime, true), stubRelease));
+	CHECK(swapper.Wait());
+	CHECK(swapper.GetStatus() == engineSwapper::FAILED);
+
+	network.Process(swapper, 0);
+
+	CHECK(network.swaps == 0);
+	CHECK(network.engine->id == 0);
+	return true;
+}
+
+
+// an engine that can't be swapped in is released, and keeps the fallback engine
+static bool testSwapRejected( uint32_t buildTime )
+{
+	engineSwapper swapper;
+	stubNetwork network(0);
+
+	CHECK(swapper.Start(stubBuilder(1, buildTime), stubRelease));
+	CHECK(swapper.Wait(buildTime * 100));
+	CHECK(swapper.GetStatus() == engineSwapper::READY);
+	CHECK(gEnginesAlive == 2);
+
+	network.Process(swapper, 0, false);
+
+	CHECK(swapper.GetStatus() == engineSwapper::FAILED);
+	CHECK(network.engine->id == 0);
+	CHECK(gEnginesAlive == 1);
+	return true;
+}
+
+
+// destroying the swapper waits for the build, and releases the engine that wasn't swapped in
+static bool testDestroyWhileBuilding( uint32_t buildTime )
+{
+	{
+		engineSwapper swapper;
+
+		CHECK(swapper.Start(stubBuilder(1, buildTime), stubRelease));
+		CHECK(!swapper.Wait(0));
+	}
+
+	CHECK(gEnginesAlive == 0);
+	return true;
+}
+
+
+int main( int argc, char** argv )
+{
+	commandLine cmdLine(argc, argv);
+
+	if( cmdLine.GetFlag("help") )
+		return usage();
+
+	const uint32_t buildTime = cmdLine.GetUnsignedInt("build-time", 200);
+	const uint32_t frameTime = cmdLine.GetUnsignedInt("frame-time", 5);
+
+	if( !testSwap(buildTime, frameTime) || !testBuildFailed(buildTime) || 
+	    !testSwapRejected(buildTime) || !testDestroyWhileBuilding(buildTime) )
+		return 1;
+
+	if( gEnginesAlive != 0 )
+	{
+		printf("engine-swap-test -- FAILED:  %i engines were leaked\n", gEnginesAlive.load());
+		return 1;
+	}
+
+	printf("engine-swap-test -- passed\n");
+	return 0;
+}
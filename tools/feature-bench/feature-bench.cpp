@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "featureMatcher.h"
+#include "commandLine.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+
+typedef featureMatcher::Match Match;
+
+
+int usage()
+{
+	printf("usage: feature-bench [--help] [--input=FILE --rows=N --cols=N] [--threshold=T]\n");
+	printf("                     [--iterations=N] [--seed=N] [--trials=N]\n\n");
+	printf("Check that the CPU feature matcher used by featureNet gives the same results\n");
+	printf("as the scalar matching it replaced, and benchmark both of them on confidence\n");
+	printf("matrices with 1200 to 4800 features (or on one recorded from the network).\n\n");
+	printf("optional arguments:\n");
+	printf("  --help            show this help message and exit\n");
+	printf("  --input=FILE      confidence matrix saved from the network (raw 32-bit floats)\n");
+	printf("  --rows=N          number of rows of the input matrix (features of the first image)\n");
+	printf("  --cols=N          number of columns of the input matrix (default: the rows)\n");
+	printf("  --threshold=T     confidence threshold of the matches (default: 0.01)\n");
+	printf("  --iterations=N    number of times each benchmark is run (default: 5)\n");
+	printf("  --trials=N        number of randomized equivalence tests (default: 500)\n");
+	printf("  --seed=N          random seed (default: 1)\n\n");
+
+	return 0;
+}
+
+
+// monotonic time in milliseconds
+static double currentTime()
+{
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000.0 + t.tv_nsec * 0.000001;
+}
+
+
+static float uniform( float min, float max )
+{
+	return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+
+
+// the original matching of featureNet::Match(), that inserts each match into the sorted list
+// (without a limit on the number of matches, and optionally with mutual nearest neighbors)
+static void referenceMatch( const float* confidence, uint32_t rows, uint32_t cols, float threshold,
+					   bool sorted, bool mutual, std::vector<Match>& matches )
+{
+	std::vector<float> rowMax(rows, -INFINITY);
+	std::vector<float> colMax(cols, -INFINITY);
+
+	if( mutual )
+	{
+		for( uint32_t cx=0; cx < rows; cx++ )
+		{
+			for( uint32_t cy=0; cy < cols; cy++ )
+			{
+				const float conf = confidence[cx * cols + cy];
+
+				if( conf > rowMax[cx] )
+					rowMax[cx] = conf;
+
+				if( conf > colMax[cy] )
+					colMax[cy] = conf;
+			}
+		}
+	}
+
+	matches.clear();
+
+	for( uint32_t cx=0; cx < rows; cx++ )
+	{
+		for( uint32_t cy=0; cy < cols; cy++ )
+		{
+			const float conf = confidence[cx * cols + cy];
+
+			if( conf < threshold )
+				continue;
+
+			if( mutual && (conf != rowMax[cx] || conf != colMax[cy]) )
+				continue;
+
+			const Match match = { cx, cy, conf };
+			const uint32_t numMatches = matches.size();
+
+			if( !sorted || numMatches == 0 )
+			{
+				matches.push_back(match);
+				continue;
+			}
+
+			for( uint32_t n=0; n < numMatches; n++ )
+			{
+				if( conf > matches[n].Confidence )
+				{
+					matches.insert(matches.begin() + n, match);
+					break;
+				}
+				else if( n == (numMatches - 1) )
+				{
+					matches.push_back(match);
+				}
+			}
+		}
+	}
+}
+
+
+// a confidence matrix with a strong match for some of the features, a few weaker ones, and noise
+// (special matrices also have ties, negative zeros, infinities and NaN's)
+static void generateMatrix( std::vector<float>& confidence, uint32_t rows, uint32_t cols, float noise, bool special )
+{
+	confidence.resize(size_t(rows) * cols);
+
+	for( size_t n=0; n < confidence.size(); n++ )
+		confidence[n] = uniform(0.0f, noise);
+
+	const uint32_t numMatches = std::min(rows, cols) / 4 + 1;
+
+	for( uint32_t n=0; n < numMatches; n++ )
+	{
+		const uint32_t a = rand() % rows;
+		const uint32_t b = rand() % cols;
+
+		confidence[size_t(a) * cols + b] = uniform(0.2f, 1.0f);
+
+		// a weaker match in the same row
+		confidence[size_t(a) * cols + rand() % cols] = uniform(0.0f, 0.2f);
+	}
+
+	if( !special )
+		return;
+
+	const float values[] = { 0.5f, 0.5f, 1.0f, 0.0f, -0.0f, INFINITY, -INFINITY, NAN };
+	const uint32_t numSpecial = rand() % (rows * cols / 8 + 2);
+
+	for( uint32_t n=0; n < numSpecial; n++ )
+		confidence[rand() % confidence.size()] = values[rand() % (sizeof(values) / sizeof(float))];
+}
+
+
+// compare the matcher against the reference on random matrices
+static bool testEquivalence( int trials )
+{
+	const float thresholds[] = { 0.01f, 0.0f, 0.2f, 0.5f, -1.0f, INFINITY };
+	const uint32_t threads[] = { 1, 2, 3, 0 };
+
+	featureMatcher matcher;
+
+	std::vector<float> confidence;
+	std::vector<Match> expected;
+	std::vector<Match> results;
+
+	for( int t=0; t < trials; t++ )
+	{
+		const uint32_t rows = 1 + rand() % 300;
+		const uint32_t cols = 1 + rand() % 300;
+
+		const float threshold = thresholds[t % (sizeof(thresholds) / sizeof(float))];
+		const bool sorted = (t % 2 == 0);
+		const bool mutual = (t % 4 >= 2);
+
+		generateMatrix(confidence, rows, cols, uniform(0.0f, 0.05f), t % 3 == 0);
+		referenceMatch(confidence.data(), rows, cols, threshold, sorted, mutual, expected);
+
+		// sometimes there are more matches than the limit
+		const uint32_t maxMatches = (t % 5 == 0) ? 1 + rand() % (expected.size() + 1) : rows * cols;
+		const uint32_t numExpected = std::min<size_t>(expected.size(), maxMatches);
+
+		matcher.SetThreads(threads[(t / 4) % (sizeof(threads) / sizeof(uint32_t))]);
+		matcher.SetMutualNearest(mutual);
+
+		results.resize(maxMatches);
+
+		const int numResults = matcher.Process(confidence.data(), rows, cols, results.data(), maxMatches, threshold, sorted);
+
+		if( numResults != (int)numExpected || memcmp(results.data(), expected.data(), sizeof(Match) * numExpected) != 0 )
+		{
+			printf("feature-bench -- matches of trial %i are different (%i vs %u matches, %ux%u, threshold %g, sorted %i, mutual %i)\n",
+				  t, numResults, numExpected, rows, cols, threshold, (int)sorted, (int)mutual);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+// time the reference and the matcher on a confidence matrix
+static void benchmark( const std::vector<float>& confidence, uint32_t rows, uint32_t cols, float threshold, int iterations )
+{
+	std::vector<Match> expected;
+	std::vector<Match> results(rows);
+
+	featureMatcher matcher;
+
+	for( int mutual=0; mutual < 2; mutual++ )
+	{
+		double referenceTime = 0, serialTime = 0, threadedTime = 0;
+		int numMatches = 0;
+
+		matcher.SetMutualNearest(mutual);
+
+		for( int i=0; i < iterations; i++ )
+		{
+			double t = currentTime();
+			referenceMatch(confidence.data(), rows, cols, threshold, true, mutual, expected);
+			referenceTime += currentTime() - t;
+
+			t = currentTime();
+			matcher.SetThreads(1);
+			numMatches = matcher.Process(confidence.data(), rows, cols, results.data(), rows, threshold, true);
+			serialTime += currentTime() - t;
+
+			t = currentTime();
+			matcher.SetThreads(0);
+			matcher.Process(confidence.data(), rows, cols, results.data(), rows, threshold, true);
+			threadedTime += currentTime() - t;
+		}
+
+		printf("%4ux%-6u %-8s %-10i %8.3f ms  %8.3f ms  %8.3f ms  %6.1fx\n", rows, cols, mutual ? "yes" : "no", numMatches,
+			  referenceTime / iterations, serialTime / iterations, threadedTime / iterations,
+			  referenceTime / threadedTime);
+	}
+}
+
+
+int main( int argc, char** argv )
+{
+	commandLine cmdLine(argc, argv);
+
+	if( cmdLine.GetFlag("help") )
+		return usage();
+
+	srand(cmdLine.GetUnsignedInt("seed", 1));
+
+	const int trials = cmdLine.GetUnsignedInt("trials", 500);
+
+	if( !testEquivalence(trials) )
+	{
+		printf("feature-bench -- FAILED, the results of the matcher don't match\n");
+		return 1;
+	}
+
+	printf("feature-bench -- the results of the matcher matched in %i randomized trials\n", trials);
+
+	const int iterations = cmdLine.GetUnsignedInt("iterations", 5);
+	const float threshold = cmdLine.GetFloat("threshold", 0.01f);
+
+	printf("\n%-11s %-8s %-10s %-12s %-12s %-12s %-8s\n", "matrix", "mutual", "matches", "reference", "1 thread", "threads", "speedup");
+
+	// a confidence matrix that was recorded from the network
+	const char* input = cmdLine.GetString("input");
+
+	if( input != NULL )
+	{
+		const uint32_t rows = cmdLine.GetUnsignedInt("rows");
+		const uint32_t cols = cmdLine.GetUnsignedInt("cols", rows);
+
+		FILE* file = fopen(input, "rb");
+
+		if( !file || rows == 0 || cols == 0 )
+		{
+			printf("feature-bench -- failed to open %s (with --rows=%u --cols=%u)\n", input, rows, cols);
+			return 1;
+		}
+
+		std::vector<float> confidence(size_t(rows) * cols);
+		const size_t numRead = fread(confidence.data(), sizeof(float), confidence.size(), file);
+		fclose(file);
+
+		if( numRead != confidence.size() )
+		{
+			printf("feature-bench -- %s has %zu values, expected %zu (%ux%u)\n", input, numRead, confidence.size(), rows, cols);
+			return 1;
+		}
+
+		benchmark(confidence, rows, cols, threshold, iterations);
+		return 0;
+	}
+
+	const uint32_t numFeatures[] = { 1200, 2400, 4800 };
+
+	for( size_t n=0; n < sizeof(numFeatures) / sizeof(uint32_t); n++ )
+	{
+		std::vector<float> confidence;
+		generateMatrix(confidence, numFeatures[n], numFeatures[n], threshold * 0.5f, false);
+		benchmark(confidence, numFeatures[n], numFeatures[n], threshold, iterations);
+	}
+
+	return 0;
+}
+
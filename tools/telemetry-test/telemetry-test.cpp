@@ -0,0 +1,695 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "telemetry.h"
+
+#include "commandLine.h"
+#include "logging.h"
+#include "Mutex.h"
+#include "Thread.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+
+int usage()
+{
+	printf("usage: telemetry-test [--help] [--timeout=MS]\n\n");
+	printf("Test TelemetryPublisher against a local stand-in for an MQTT broker:  that the\n");
+	printf("samples are published in batches of valid JSON, that publishing stops at the\n");
+	printf("inflight limit while the broker doesn't acknowledge them (and the oldest samples\n");
+	printf("are dropped), that stop() waits for the acks to publish the rest of the queue,\n");
+	printf("and that an unreachable broker doesn't block or grow the queue.\n\n");
+	printf("optional arguments:\n");
+	printf("  --help            show this help message and exit\n");
+	printf("  --timeout=MS      time to wait for each step (default: 5000)\n\n");
+	printf("%s", EventLoop::Usage());
+	printf("%s", Log::Usage());
+
+	return 0;
+}
+
+
+// monotonic time in milliseconds
+static uint64_t currentTime()
+{
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return uint64_t(t.tv_sec) * 1000 + t.tv_nsec / 1000000;
+}
+
+
+/*
+ * Stand-in for an MQTT 3.1.1 broker that accepts one client at a time.
+ * It records the payloads that are published, and acknowledges them
+ * (QoS 1) only while acks are enabled.
+ */
+class mqttBroker
+{
+public:
+	mqttBroker() : mListenFD(-1), mClientFD(-1), mPort(0), mRunning(false), mAck(true) {}
+	~mqttBroker()	{ Close(); }
+
+	// listen on a free port of localhost
+	bool Open()
+	{
+		mListenFD = socket(AF_INET, SOCK_STREAM, 0);
+
+		if( mListenFD < 0 )
+			return false;
+
+		sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+
+		addr.sin_family      = AF_INET;
+		addr.sin_port        = 0;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		socklen_t length = sizeof(addr);
+
+		if( bind(mListenFD, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(mListenFD, 4) != 0 ||
+		    getsockname(mListenFD, (sockaddr*)&addr, &length) != 0 )
+		{
+			printf("telemetry-test -- failed to open the broker socket (%s)\n", strerror(errno));
+			return false;
+		}
+
+		mPort = ntohs(addr.sin_port);
+		mRunning = true;
+
+		if( !mThread.Start(brokerThread, this) )
+		{
+			mRunning = false;
+			return false;
+		}
+
+		return true;
+	}
+
+	// stop the thread and close the sockets
+	void Close()
+	{
+		if( mRunning )
+		{
+			mRunning = false;
+			mThread.Stop(true);
+		}
+
+		closeClient();
+
+		if( mListenFD >= 0 )
+		{
+			close(mListenFD);
+			mListenFD = -1;
+		}
+	}
+
+	// enable or disable acknowledging the publishes (the withheld ones are sent when enabled)
+	void SetAck( bool ack )				{ mMutex.Lock(); mAck = ack; mMutex.Unlock(); }
+
+	// get the payloads that were published (without retransmissions)
+	std::vector<std::string> GetPayloads()	{ mMutex.Lock(); std::vector<std::string> payloads = mPayloads; mMutex.Unlock(); return payloads; }
+
+	// number of payloads that were published
+	size_t GetNumPayloads()				{ mMutex.Lock(); const size_t count = mPayloads.size(); mMutex.Unlock(); return count; }
+
+	// the URI of the broker
+	std::string GetAddress() const
+	{
+		char address[64];
+		snprintf(address, sizeof(address), "tcp://127.0.0.1:%hu", mPort);
+		return address;
+	}
+
+private:
+	static void* brokerThread( void* param )
+	{
+		mqttBroker* broker = (mqttBroker*)param;
+
+		while( broker->mRunning )
+			broker->process();
+
+		return NULL;
+	}
+
+	// wait for a connection or packet, and send the acks that were withheld once they're enabled
+	void process()
+	{
+		pollfd fds[2];
+
+		fds[0].fd      = mListenFD;
+		fds[0].events  = POLLIN;
+		fds[0].revents = 0;
+
+		fds[1].fd      = mClientFD;
+		fds[1].events  = POLLIN;
+		fds[1].revents = 0;
+
+		if( poll(fds, mClientFD >= 0 ? 2 : 1, 10) < 0 )
+			return;
+
+		if( fds[0].revents & POLLIN )
+		{
+			const int fd = accept(mListenFD, NULL, NULL);
+
+			if( fd >= 0 )
+			{
+				closeClient();
+				mClientFD = fd;
+			}
+		}
+		else if( mClientFD >= 0 && (fds[1].revents & (POLLIN|POLLHUP|POLLERR)) )
+		{
+			if( !readPacket() )
+				closeClient();
+		}
+
+		mMutex.Lock();
+		std::vector<uint16_t> acks;
+
+		if( mAck )
+			acks.swap(mWithheld);
+
+		mMutex.Unlock();
+
+		for( size_t n=0; n < acks.size(); n++ )
+			sendAck(acks[n]);
+	}
+
+	// read a packet from the client and reply to it
+	bool readPacket()
+	{
+		uint8_t type = 0;
+
+		if( !readBytes(&type, 1) )
+			return false;
+
+		// the remaining length is a varint of up to 4 bytes
+		uint32_t length = 0;
+
+		for( int n=0; n < 4; n++ )
+		{
+			uint8_t byte = 0;
+
+			if( !readBytes(&byte, 1) )
+				return false;
+
+			length |= uint32_t(byte & 0x7F) << (7 * n);
+
+			if( !(byte & 0x80) )
+				break;
+		}
+
+		std::vector<uint8_t> body(length);
+
+		if( length > 0 && !readBytes(body.data(), length) )
+			return false;
+
+		switch( type >> 4 )
+		{
+			case 1:		// CONNECT -> CONNACK (accepted)
+			{
+				const uint8_t connack[] = { 0x20, 0x02, 0x00, 0x00 };
+				return writeBytes(connack, sizeof(connack));
+			}
+			case 3:		// PUBLISH
+				return receivePublish(type, body);
+			case 12:	// PINGREQ -> PINGRESP
+			{
+				const uint8_t pingresp[] = { 0xD0, 0x00 };
+				return writeBytes(pingresp, sizeof(pingresp));
+			}
+			case 14:	// DISCONNECT
+				return false;
+		}
+
+		return true;
+	}
+
+	// record the payload of a publish, and ack it (or hold the ack back)
+	bool receivePublish( uint8_t type, const std::vector<uint8_t>& body )
+	{
+		const int qos = (type >> 1) & 0x03;
+
+		if( body.size() < 2 )
+			return false;
+
+		size_t offset = 2 + ((body[0] << 8) | body[1]);
+		uint16_t packetID = 0;
+
+		if( qos > 0 )
+		{
+			if( body.size() < offset + 2 )
+				return false;
+
+			packetID = (body[offset] << 8) | body[offset+1];
+			offset += 2;
+		}
+
+		if( offset > body.size() )
+			return false;
+
+		mMutex.Lock();
+
+		// retransmissions (DUP) of a packet that was already received aren't counted again
+		if( qos == 0 || mReceived.insert(packetID).second || !(type & 0x08) )
+			mPayloads.push_back(std::string(body.begin() + offset, body.end()));
+
+		const bool ack = (qos > 0) && mAck;
+
+		if( qos > 0 && !mAck )
+			mWithheld.push_back(packetID);
+
+		mMutex.Unlock();
+
+		return ack ? sendAck(packetID) : true;
+	}
+
+	// send a PUBACK
+	bool sendAck( uint16_t packetID )
+	{
+		const uint8_t puback[] = { 0x40, 0x02, uint8_t(packetID >> 8), uint8_t(packetID & 0xFF) };
+		return writeBytes(puback, sizeof(puback));
+	}
+
+	bool readBytes( uint8_t* buffer, size_t size )
+	{
+		while( size > 0 )
+		{
+			const ssize_t bytes = recv(mClientFD, buffer, size, 0);
+
+			if( bytes <= 0 )
+				return false;
+
+			buffer += bytes;
+			size -= bytes;
+		}
+
+		return true;
+	}
+
+	bool writeBytes( const uint8_t* buffer, size_t size )
+	{
+		return mClientFD >= 0 && send(mClientFD, buffer, size, MSG_NOSIGNAL) == (ssize_t)size;
+	}
+
+	void closeClient()
+	{
+		if( mClientFD < 0 )
+			return;
+
+		close(mClientFD);
+		mClientFD = -1;
+
+		// packet IDs are reused by the next session
+		mMutex.Lock();
+		mReceived.clear();
+		mWithheld.clear();
+		mMutex.Unlock();
+	}
+
+	int mListenFD;
+	int mClientFD;
+	uint16_t mPort;
+
+	Thread mThread;
+	Mutex  mMutex;
+
+	volatile bool mRunning;
+	bool mAck;
+
+	std::vector<std::string> mPayloads;
+	std::vector<uint16_t> mWithheld;
+	std::set<uint16_t> mReceived;
+};
+
+
+// wait for a condition, or until the timeout
+template<typename T> static bool waitFor( T condition, uint64_t timeout )
+{
+	const uint64_t start = currentTime();
+
+	while( !condition() )
+	{
+		if( currentTime() - start > timeout )
+			return false;
+
+		usleep(5000);
+	}
+
+	return true;
+}
+
+
+// count the occurrences of a string
+static size_t countString( const std::string& str, const char* substr )
+{
+	size_t count = 0;
+
+	for( size_t pos = str.find(substr); pos != std::string::npos; pos = str.find(substr, pos + 1) )
+		count++;
+
+	return count;
+}
+
+
+// publisher options for the tests
+static TelemetryPublisher::Options createOptions( const std::string& address, uint32_t batchSize, uint32_t maxQueued, uint32_t maxInflight )
+{
+	TelemetryPublisher::Options options;
+
+	options.address          = address;
+	options.clientId         = "telemetry-test";
+	options.topic            = "telemetry/test";
+	options.sampleIntervalMs = 10;
+	options.batchSize        = batchSize;
+	options.maxQueuedSamples = maxQueued;
+	options.maxInflight      = maxInflight;
+	options.reconnectMaxMs   = 1000;
+	options.qos              = 1;
+
+	return options;
+}
+
+
+// the samples are published in batches of valid JSON
+static bool testBatching( uint64_t timeout )
+{
+	mqttBroker broker;
+
+	if( !broker.Open() )
+		return false;
+
+	const uint32_t batchSize = 5;
+	TelemetryPublisher* publisher = TelemetryPublisher::Create(createOptions(broker.GetAddress(), batchSize, 100, 2));
+
+	if( !publisher )
+	{
+		printf("telemetry-test -- failed to create the publisher\n");
+		return false;
+	}
+
+	for( int n=0; n < 100; n++ )
+	{
+		publisher->recordFrame();
+		publisher->recordDetections(3);
+		publisher->recordLatency(TELEMETRY_DETECT, n * 0.1f);
+	}
+
+	const bool received = waitFor([&]{ return broker.GetNumPayloads() >= 4; }, timeout);
+
+	// stop() publishes the rest of the queue, which can be a partial batch
+	publisher->stop();
+
+	const std::vector<std::string> payloads = broker.GetPayloads();
+	const uint64_t published = publisher->getPublishedSamples();
+
+	delete publisher;
+
+	if( !received )
+	{
+		printf("telemetry-test -- batching:  timed out waiting for the broker to receive the samples (%zu payloads)\n", payloads.size());
+		return false;
+	}
+
+	uint64_t numSamples = 0;
+
+	for( size_t n=0; n < payloads.size(); n++ )
+	{
+		const std::string& json = payloads[n];
+		const size_t samples = countString(json, "\"timestamp\":");
+
+		const bool valid = json.compare(0, 12, "{\"samples\":[") == 0 && json.compare(json.size() - 2, 2, "]}") == 0 &&
+					    countString(json, "[,") == 0 && countString(json, ",,") == 0 && countString(json, ",]") == 0 &&
+					    countString(json, "\"detect\":{\"p50\":") == samples;
+
+		if( !valid || samples == 0 || samples > batchSize || (samples != batchSize && n != payloads.size() - 1) )
+		{
+			printf("telemetry-test -- batching:  payload %zu has %zu samples (batch size %u):\n%s\n", n, samples, batchSize, json.c_str());
+			return false;
+		}
+
+		numSamples += samples;
+	}
+
+	if( numSamples != published )
+	{
+		printf("telemetry-test -- batching:  the broker received %llu samples, but %llu were published\n",
+			  (unsigned long long)numSamples, (unsigned long long)published);
+		return false;
+	}
+
+	printf("telemetry-test -- batching:  %zu payloads with %llu samples\n", payloads.size(), (unsigned long long)numSamples);
+	return true;
+}
+
+
+// publishing stops at the inflight limit while the broker doesn't ack, and resumes once it does
+static bool testBackpressure( uint64_t timeout )
+{
+	mqttBroker broker;
+
+	if( !broker.Open() )
+		return false;
+
+	broker.SetAck(false);
+
+	const uint32_t maxInflight = 2;
+	const uint32_t maxQueued = 10;
+
+	TelemetryPublisher* publisher = TelemetryPublisher::Create(createOptions(broker.GetAddress(), 2, maxQueued, maxInflight));
+
+	if( !publisher )
+	{
+		printf("telemetry-test -- failed to create the publisher\n");
+		return false;
+	}
+
+	bool result = true;
+
+	// wait until the queue overflows (at 10ms per sample)
+	if( !waitFor([&]{ return publisher->getDroppedSamples() >= 20; }, timeout) )
+	{
+		printf("telemetry-test -- backpressure:  no samples were dropped while the broker wasn't acking (connected %i, published %llu)\n",
+			  (int)publisher->isConnected(), (unsigned long long)publisher->getPublishedSamples());
+		result = false;
+	}
+
+	const size_t blocked = broker.GetNumPayloads();
+
+	if( result && blocked != maxInflight )
+	{
+		printf("telemetry-test -- backpressure:  %zu publishes were sent without acks (the limit is %u)\n", blocked, maxInflight);
+		result = false;
+	}
+
+	// the publishes resume once they're acked
+	broker.SetAck(true);
+
+	if( result && !waitFor([&]{ return broker.GetNumPayloads() >= blocked + 4; }, timeout) )
+	{
+		printf("telemetry-test -- backpressure:  publishing didn't resume after the acks were sent\n");
+		result = false;
+	}
+
+	const uint64_t dropped = publisher->getDroppedSamples();
+	delete publisher;
+
+	if( result )
+		printf("telemetry-test -- backpressure:  %zu publishes inflight, %llu samples dropped, then resumed\n", blocked, (unsigned long long)dropped);
+
+	return result;
+}
+
+
+// stop() waits for the inflight publishes to be acked, so that the rest of the queue is published
+struct delayedAck
+{
+	mqttBroker* broker;
+	uint32_t delay;
+};
+
+static void* delayedAckThread( void* param )
+{
+	delayedAck* ack = (delayedAck*)param;
+
+	usleep(ack->delay * 1000);
+	ack->broker->SetAck(true);
+
+	return NULL;
+}
+
+static bool testShutdown( uint64_t timeout )
+{
+	mqttBroker broker;
+
+	if( !broker.Open() )
+		return false;
+
+	broker.SetAck(false);
+
+	const uint32_t maxQueued = 10;
+	TelemetryPublisher* publisher = TelemetryPublisher::Create(createOptions(broker.GetAddress(), 2, maxQueued, 1));
+
+	if( !publisher )
+	{
+		printf("telemetry-test -- shutdown:  failed to create the publisher\n");
+		return false;
+	}
+
+	bool result = true;
+
+	// fill the queue while the only inflight publish isn't acked
+	if( !waitFor([&]{ return publisher->getDroppedSamples() >= 5; }, timeout) )
+	{
+		printf("telemetry-test -- shutdown:  the queue didn't fill up while the broker wasn't acking\n");
+		result = false;
+	}
+
+	// the acks are sent while stop() is waiting for them
+	delayedAck ack = { &broker, 200 };
+	Thread thread;
+
+	if( !thread.Start(delayedAckThread, &ack) )
+		broker.SetAck(true);
+
+	publisher->stop();
+	thread.Stop(true);
+
+	const std::vector<std::string> payloads = broker.GetPayloads();
+	const uint64_t published = publisher->getPublishedSamples();
+
+	delete publisher;
+
+	uint64_t numSamples = 0;
+
+	for( size_t n=0; n < payloads.size(); n++ )
+		numSamples += countString(payloads[n], "\"timestamp\":");
+
+	if( result && (published < maxQueued || numSamples != published) )
+	{
+		printf("telemetry-test -- shutdown:  %llu samples were published and %llu received, but %u were queued\n",
+			  (unsigned long long)published, (unsigned long long)numSamples, maxQueued);
+		result = false;
+	}
+
+	if( result )
+		printf("telemetry-test -- shutdown:  stop() published the %u queued samples (%llu in total)\n", maxQueued, (unsigned long long)numSamples);
+
+	return result;
+}
+
+
+// an unreachable broker doesn't block the publisher, and the queue stays bounded
+static bool testUnreachable( uint64_t timeout )
+{
+	// a port that nothing is listening on
+	mqttBroker closed;
+
+	if( !closed.Open() )
+		return false;
+
+	const std::string address = closed.GetAddress();
+	closed.Close();
+
+	const uint32_t maxQueued = 10;
+	TelemetryPublisher* publisher = TelemetryPublisher::Create(createOptions(address, 5, maxQueued, 2));
+
+	if( !publisher )
+	{
+		printf("telemetry-test -- unreachable:  failed to create the publisher\n");
+		return false;
+	}
+
+	bool result = true;
+
+	if( !waitFor([&]{ return publisher->getDroppedSamples() >= 20; }, timeout) )
+	{
+		printf("telemetry-test -- unreachable:  the oldest samples weren't dropped\n");
+		result = false;
+	}
+
+	if( publisher->isConnected() || publisher->getPublishedSamples() != 0 )
+	{
+		printf("telemetry-test -- unreachable:  the publisher shouldn't be connected\n");
+		result = false;
+	}
+
+	const uint64_t start = currentTime();
+	delete publisher;
+	const uint64_t elapsed = currentTime() - start;
+
+	if( elapsed > 1000 )
+	{
+		printf("telemetry-test -- unreachable:  stopping the publisher took %llu ms\n", (unsigned long long)elapsed);
+		result = false;
+	}
+
+	if( result )
+		printf("telemetry-test -- unreachable:  samples dropped while disconnected, stopped in %llu ms\n", (unsigned long long)elapsed);
+
+	return result;
+}
+
+
+int main( int argc, char** argv )
+{
+	commandLine cmdLine(argc, argv);
+
+	if( cmdLine.GetFlag("help") )
+		return usage();
+
+	Log::ParseCmdLine(cmdLine);
+
+	if( !EventLoop::Configure(cmdLine) )
+		return 1;
+
+	const uint64_t timeout = cmdLine.GetUnsignedInt("timeout", 5000);
+
+	const bool batching = testBatching(timeout);
+	const bool backpressure = testBackpressure(timeout);
+	const bool shutdown = testShutdown(timeout);
+	const bool unreachable = testUnreachable(timeout);
+
+	if( !batching || !backpressure || !shutdown || !unreachable )
+	{
+		printf("telemetry-test -- FAILED\n");
+		return 1;
+	}
+
+	printf("telemetry-test -- passed\n");
+	return 0;
+}
+
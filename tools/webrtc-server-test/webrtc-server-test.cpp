@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "WebRTCServer.h"
+#include "EventLoop.h"
+
+#include "commandLine.h"
+#include "logging.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+
+
+int usage()
+{
+	printf("usage: webrtc-server-test [--help] [--port=PORT] [--timeout=MS]\n\n");
+	printf("Smoke test of WebRTCServer, which starts servers on the shared event loops\n");
+	printf("(and one that isn't threaded), connects to their ports and checks that they\n");
+	printf("reply to HTTP requests.\n\n");
+	printf("optional arguments:\n");
+	printf("  --help            show this help message and exit\n");
+	printf("  --port=PORT       first port to start the servers on (default: 18554)\n");
+	printf("  --timeout=MS      time to wait for each reply (default: 5000)\n\n");
+	printf("%s", EventLoop::Usage());
+	printf("%s", Log::Usage());
+
+	return 0;
+}
+
+
+// monotonic time in milliseconds
+static uint64_t currentTime()
+{
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return uint64_t(t.tv_sec) * 1000 + t.tv_nsec / 1000000;
+}
+
+
+// connect to the server on localhost and send a request for the REST API
+static int sendRequest( uint16_t port )
+{
+	const int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	if( fd < 0 )
+		return -1;
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+
+	addr.sin_family      = AF_INET;
+	addr.sin_port        = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if( connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0 )
+	{
+		printf("webrtc-server-test -- failed to connect to port %hu (%s)\n", port, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	const char* request = "GET /api/streams HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+
+	if( send(fd, request, strlen(request), MSG_NOSIGNAL) != (ssize_t)strlen(request) )
+	{
+		printf("webrtc-server-test -- failed to send the request to port %hu\n", port);
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+
+// wait for the status line of the reply (the server is polled if it isn't threaded)
+static bool recieveReply( int fd, uint16_t port, uint64_t timeout, WebRTCServer* poll=NULL )
+{
+	const uint64_t start = currentTime();
+	std::string reply;
+
+	while( reply.find("\r\n") == std::string::npos )
+	{
+		if( currentTime() - start > timeout )
+		{
+			printf("webrtc-server-test -- timed out waiting for a reply from port %hu\n", port);
+			return false;
+		}
+
+		if( poll != NULL )
+			poll->ProcessRequests(false);
+
+		char buffer[512];
+		const ssize_t size = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+
+		if( size > 0 )
+			reply.append(buffer, size);
+		else if( size == 0 )
+			break;
+		else if( errno != EAGAIN && errno != EWOULDBLOCK )
+			break;
+		else
+			usleep(1000);
+	}
+
+	const std::string status = reply.substr(0, reply.find("\r\n"));
+
+	if( status.compare(0, 12, "HTTP/1.1 200") != 0 )
+	{
+		printf("webrtc-server-test -- unexpected reply from port %hu:  '%s'\n", port, status.c_str());
+		return false;
+	}
+
+	printf("webrtc-server-test -- port %hu replied '%s'\n", port, status.c_str());
+	return true;
+}
+
+
+// send a request to a server and check the reply
+static bool testRequest( uint16_t port, uint64_t timeout, WebRTCServer* poll=NULL )
+{
+	const int fd = sendRequest(port);
+
+	if( fd < 0 )
+		return false;
+
+	const bool result = recieveReply(fd, port, timeout, poll);
+	close(fd);
+
+	return result;
+}
+
+
+// create a server
+static WebRTCServer* createServer( uint16_t port, bool threaded )
+{
+	WebRTCServer* server = WebRTCServer::Create(port, NULL, NULL, NULL, threaded);
+
+	if( !server )
+		printf("webrtc-server-test -- failed to create the server on port %hu\n", port);
+
+	return server;
+}
+
+
+int main( int argc, char** argv )
+{
+	commandLine cmdLine(argc, argv);
+
+	if( cmdLine.GetFlag("help") )
+		return usage();
+
+	Log::ParseCmdLine(cmdLine);
+
+	if( !EventLoop::Configure(cmdLine) )
+		return 1;
+
+	const uint16_t port = cmdLine.GetUnsignedInt("port", 18554);
+	const uint64_t timeout = cmdLine.GetUnsignedInt("timeout", 5000);
+
+	// servers on the event loops (two at once, so they share the loops)
+	WebRTCServer* servers[] = { createServer(port, true), createServer(port + 1, true) };
+
+	bool threaded = true;
+
+	for( int n=0; n < 2; n++ )
+	{
+		if( !servers[n] || !testRequest(port + n, timeout) )
+			threaded = false;
+	}
+
+	for( int n=0; n < 2; n++ )
+	{
+		if( servers[n] != NULL )
+			servers[n]->Release();
+	}
+
+	// a server that's polled with ProcessRequests()
+	WebRTCServer* server = createServer(port + 2, false);
+	const bool polled = (server != NULL) && testRequest(port + 2, timeout, server);
+
+	if( server != NULL )
+		server->Release();
+
+	if( !threaded || !polled )
+	{
+		printf("webrtc-server-test -- FAILED (threaded %s, polled %s)\n", threaded ? "passed" : "failed", polled ? "passed" : "failed");
+		return 1;
+	}
+
+	printf("webrtc-server-test -- passed\n");
+	return 0;
+}
+
@@ -22,9 +22,12 @@
 
 #include "gstBufferManager.h"
 #include "cudaColorspace.h"
+#include "cpuColorspace.h"
 #include "timespec.h"
 #include "logging.h"
 
+#include <vector>
+
 
 #ifdef ENABLE_NVMM
 #include <nvbuf_utils.h>
@@ -37,6 +40,164 @@
 #endif
 
 
+#if GST_CHECK_VERSION(1,0,0)
+
+// constructor
+gstBufferRefPool::gstBufferRefPool( uint32_t capacity )
+{
+	mCapacity    = (capacity < 2) ? 2 : capacity;
+	mHasAcquired = false;
+	mDropped     = 0;
+}
+
+
+// destructor
+gstBufferRefPool::~gstBufferRefPool()
+{
+	Clear();
+}
+
+
+// release
+void gstBufferRefPool::release( Entry& entry )
+{
+	gst_buffer_unmap(entry.buffer, &entry.map);
+	gst_buffer_unref(entry.buffer);
+}
+
+
+// Push
+bool gstBufferRefPool::Push( GstBuffer* buffer )
+{
+	if( !buffer )
+		return false;
+
+	Entry entry;
+	entry.buffer = gst_buffer_ref(buffer);
+
+	if( !gst_buffer_map(entry.buffer, &entry.map, GST_MAP_READ) )
+	{
+		LogError(LOG_GSTREAMER "gstBufferRefPool -- failed to map gstreamer buffer memory\n");
+		gst_buffer_unref(entry.buffer);
+		return false;
+	}
+
+	std::vector<Entry> dropped;
+
+	mMutex.Lock();
+
+	mPending.push_back(entry);
+
+	while( mPending.size() + (mHasAcquired ? 1 : 0) > mCapacity )
+	{
+		dropped.push_back(mPending.front());
+		mPending.pop_front();
+		mDropped++;
+	}
+
+	mMutex.Unlock();
+
+	// returning buffers to GStreamer can wake upstream, so do it outside the lock
+	for( size_t n=0; n < dropped.size(); n++ )
+		release(dropped[n]);
+
+	return true;
+}
+
+
+// Acquire
+const void* gstBufferRefPool::Acquire( size_t* size )
+{
+	std::vector<Entry> released;
+
+	mMutex.Lock();
+
+	if( mPending.empty() )
+	{
+		mMutex.Unlock();
+		return NULL;
+	}
+
+	if( mHasAcquired )
+		released.push_back(mAcquired);
+
+	while( mPending.size() > 1 )
+	{
+		released.push_back(mPending.front());
+		mPending.pop_front();
+		mDropped++;
+	}
+
+	mAcquired = mPending.front();
+	mHasAcquired = true;
+	mPending.pop_front();
+
+	const void* data = mAcquired.map.data;
+
+	if( size != NULL )
+		*size = mAcquired.map.size;
+
+	mMutex.Unlock();
+
+	for( size_t n=0; n < released.size(); n++ )
+		release(released[n]);
+
+	return data;
+}
+
+
+// Release
+void gstBufferRefPool::Release()
+{
+	mMutex.Lock();
+
+	if( !mHasAcquired )
+	{
+		mMutex.Unlock();
+		return;
+	}
+
+	Entry entry = mAcquired;
+	mHasAcquired = false;
+
+	mMutex.Unlock();
+
+	release(entry);
+}
+
+
+// Clear
+void gstBufferRefPool::Clear()
+{
+	mMutex.Lock();
+
+	std::vector<Entry> released(mPending.begin(), mPending.end());
+	mPending.clear();
+
+	if( mHasAcquired )
+		released.push_back(mAcquired);
+
+	mHasAcquired = false;
+
+	mMutex.Unlock();
+
+	for( size_t n=0; n < released.size(); n++ )
+		release(released[n]);
+}
+
+
+// GetCount
+uint32_t gstBufferRefPool::GetCount()
+{
+	mMutex.Lock();
+	const uint32_t count = mPending.size() + (mHasAcquired ? 1 : 0);
+	mMutex.Unlock();
+	return count;
+}
+
+#endif
+
+
 // constructor
 gstBufferManager::gstBufferManager( videoOptions* options )
 {	
@@ -45,6 +206,10 @@ gstBufferManager::gstBufferManager( videoOptions* options )
 	mFrameCount = 0;
 	mLastTimestamp = 0;
 	mNvmmUsed   = false;
+
+#if GST_CHECK_VERSION(1,0,0)
+	mBufferRefs = NULL;
+#endif
 	
 #ifdef ENABLE_NVMM
 	mNvmmFD        = -1;
@@ -61,7 +226,9 @@ gstBufferManager::gstBufferManager( videoOptions* options )
 // destructor
 gstBufferManager::~gstBufferManager()
 {
-	
+#if GST_CHECK_VERSION(1,0,0)
+	SAFE_DELETE(mBufferRefs);
+#endif
 }
 
 
@@ -234,6 +401,24 @@ bool gstBufferManager::Enqueue( GstBuffer* gstBuffer, GstCaps* gstCaps )
 	}
 #endif
 
+#if GST_CHECK_VERSION(1,0,0)
+	// handle CPU path (non-NVMM) by holding a reference to the buffer
+	if( !mNvmmUsed && mOptions->zeroCopyInput )
+	{
+		if( !mBufferRefs )
+		{
+			mBufferRefs = new gstBufferRefPool();
+			LogVerbose(LOG_GSTREAMER "gstBufferManager -- holding up to %u CPU buffers for zero-copy access\n", mBufferRefs->GetCapacity());
+		}
+
+		if( !mBufferRefs->Push(gstBuffer) )
+		{
+			gst_buffer_unmap(gstBuffer, &map);
+			return false;
+		}
+	}
+	else
+#endif
 	// handle CPU path (non-NVMM)
 	if( !mNvmmUsed )
 	{
@@ -403,8 +588,18 @@ int gstBufferManager::Dequeue( void** output, imageFormat format, uint64_t timeo
 #endif
 
 	// handle the CPU path (non-NVMM)
+	const void* heldYUV = NULL;
+	size_t heldSize = 0;
+
 	if( !mNvmmUsed )
+	{
+	#if GST_CHECK_VERSION(1,0,0)
+		if( mBufferRefs != NULL )
+			heldYUV = latestYUV = (void*)mBufferRefs->Acquire(&heldSize);
+		else
+	#endif
 		latestYUV = mBufferYUV.Next(RingBuffer::ReadLatestOnce);
+	}
 
 	if( !latestYUV )
 		return -1;
@@ -423,6 +618,51 @@ int gstBufferManager::Dequeue( void** output, imageFormat format, uint64_t timeo
 		mLastTimestamp = *((uint64_t*)pLastTimestamp);
 	}
 
+#if GST_CHECK_VERSION(1,0,0)
+	// frames held from appsink are only CPU-accessible, so either convert them on the CPU
+	// directly into the mapped output buffers, or copy them to a ringbuffer for the GPU
+	if( heldYUV != NULL )
+	{
+		const bool cpuConvert = (format != IMAGE_UNKNOWN && mOptions->zeroCopy && cpuConvertColorSupported(mFormatYUV, format) &&
+						   heldSize >= imageFormatSize(mFormatYUV, mOptions->width, mOptions->height));
+
+		if( cpuConvert )
+		{
+			const size_t rgbBufferSize = imageFormatSize(format, mOptions->width, mOptions->height);
+
+			if( !mBufferRGB.Alloc(mOptions->numBuffers, rgbBufferSize, RingBuffer::ZeroCopy) )
+			{
+				LogError(LOG_GSTREAMER "gstBufferManager -- failed to allocate %u buffers (%zu bytes each)\n", mOptions->numBuffers, rgbBufferSize);
+				mBufferRefs->Release();
+				return -1;
+			}
+
+			void* nextRGB = mBufferRGB.Next(RingBuffer::Write);
+			const bool converted = cpuConvertColor(heldYUV, mFormatYUV, nextRGB, format, mOptions->width, mOptions->height);
+
+			mBufferRefs->Release();
+
+			if( !converted )
+				return -1;
+
+			*output = nextRGB;
+			return 1;
+		}
+
+		if( !mBufferYUV.Alloc(mOptions->numBuffers, heldSize, RingBuffer::ZeroCopy) )
+		{
+			LogError(LOG_GSTREAMER "gstBufferManager -- failed to allocate %u image buffers (%zu bytes each)\n", mOptions->numBuffers, heldSize);
+			mBufferRefs->Release();
+			return -1;
+		}
+
+		latestYUV = mBufferYUV.Next(RingBuffer::Write);
+
+		memcpy(latestYUV, heldYUV, heldSize);
+		mBufferRefs->Release();
+	}
+#endif
+
 	// output raw image if conversion format is unknown
 	if ( format == IMAGE_UNKNOWN )
 	{
@@ -30,6 +30,8 @@
 #include "Mutex.h"
 #include "RingBuffer.h"
 
+#include <deque>
+
 
 #ifdef ENABLE_NVMM
 #if !GST_CHECK_VERSION(1,0,0)
@@ -45,6 +47,92 @@
 #define GST_CAPS_FEATURE_MEMORY_NVMM "memory:NVMM"
 
 
+#if GST_CHECK_VERSION(1,0,0)
+/**
+ * Bounded pool of mapped GstBuffer references, used by gstBufferManager to read
+ * CPU (non-NVMM) frames straight from appsink memory instead of copying them.
+ *
+ * Each pushed buffer stays referenced and mapped until the consumer acquires a
+ * newer frame, or until the pool is full, in which case the oldest frame that
+ * hasn't been acquired is released back to GStreamer.  At most one frame is
+ * acquired by the consumer at a time, and it remains valid until the next call
+ * to Acquire() or Release().  The pool is thread-safe, with Push() typically
+ * called from the GStreamer streaming thread and Acquire() from the consumer.
+ *
+ * @ingroup codec
+ */
+class gstBufferRefPool
+{
+public:
+	/**
+	 * Constructor
+	 * @param capacity the maximum number of buffers held at once (including
+	 *                 the acquired buffer), which must be at least 2.
+	 */
+	gstBufferRefPool( uint32_t capacity=2 );
+
+	/**
+	 * Destructor (releases all of the held buffers)
+	 */
+	~gstBufferRefPool();
+
+	/**
+	 * Take a reference to the buffer and map it for reading.
+	 * If the pool is full, the oldest pending buffer gets released.
+	 */
+	bool Push( GstBuffer* buffer );
+
+	/**
+	 * Acquire the latest pending buffer for reading.  This releases the
+	 * previously acquired buffer along with any older pending buffers.
+	 * @returns pointer to the mapped memory, or NULL if no buffers are pending.
+	 */
+	const void* Acquire( size_t* size=NULL );
+
+	/**
+	 * Release the acquired buffer back to GStreamer.
+	 */
+	void Release();
+
+	/**
+	 * Release all of the held buffers.
+	 */
+	void Clear();
+
+	/**
+	 * Get the maximum number of buffers held at once.
+	 */
+	inline uint32_t GetCapacity() const	{ return mCapacity; }
+
+	/**
+	 * Get the number of buffers currently held (pending and acquired).
+	 */
+	uint32_t GetCount();
+
+	/**
+	 * Get the number of buffers released without ever being acquired.
+	 */
+	inline uint64_t GetDropped() const		{ return mDropped; }
+
+protected:
+	struct Entry
+	{
+		GstBuffer* buffer;
+		GstMapInfo map;
+	};
+
+	static void release( Entry& entry );
+
+	std::deque<Entry> mPending;
+	Entry    mAcquired;
+	bool     mHasAcquired;
+	uint32_t mCapacity;
+	uint64_t mDropped;
+	Mutex    mMutex;
+};
+#endif
+
+
 /**
  * gstBufferManager recieves GStreamer buffers from appsink elements and unpacks/maps 
  * them into CUDA address space, and handles colorspace conversion into RGB format.
@@ -56,6 +144,10 @@
  *
  *     cmake -DENABLE_NVMM=OFF ../
  *
+ * For CPU-based buffers, setting videoOptions::zeroCopyInput holds references to the
+ * GstBuffers (see gstBufferRefPool) instead of copying each frame into a ringbuffer.
+ * Dequeue() then converts directly from the GstBuffer's mapped memory on the CPU.
+ *
  * @ingroup codec
  */
 class gstBufferManager
@@ -108,6 +200,10 @@ protected:
 	videoOptions* mOptions;    /**< Options of the gstDecoder / gstCamera object */			
 	uint64_t	  mFrameCount; /**< Total number of frames that have been recieved */
 	bool 	      mNvmmUsed;   /**< Is NVMM memory actually used by the stream? */
+
+#if GST_CHECK_VERSION(1,0,0)
+	gstBufferRefPool* mBufferRefs; /**< Pool of GstBuffers held for zero-copy access (non-NVMM, if videoOptions::zeroCopyInput is set) */
+#endif
 	
 #ifdef ENABLE_NVMM
 	Mutex  mNvmmMutex;
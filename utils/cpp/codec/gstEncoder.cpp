@@ -31,6 +31,8 @@
 #include "logging.h"
 
 #include "cudaColorspace.h"
+#include "cudaMappedMemory.h"
+#include "Mutex.h"
 
 #define GST_USE_UNSTABLE_API
 #include <gst/webrtc/webrtc.h>
@@ -42,6 +44,10 @@
 #include <unistd.h>
 
 
+// maximum number of encoded frames queued for each output (or WebRTC peer) before the oldest are dropped
+#define GST_ENCODER_FANOUT_QUEUE 30
+
+
 // supported video file extensions
 const char* gstEncoder::SupportedExtensions[] = { "mkv", "mp4", "qt", 
 										"flv", "avi", "h264", 
@@ -69,9 +75,111 @@ bool gstEncoder::IsSupportedExtension( const char* ext )
 }
 
 
+//---------------------------------------------------------------------------------------------
+// gstEncoderBufferPool
+//
+// Pool of mapped CPU/GPU buffers that the colorspace conversion writes into directly,
+// and which get wrapped into GstBuffers without copying.  A buffer becomes available
+// again when GStreamer releases the GstBuffer wrapping it.  Because buffers can still
+// be in-flight in the pipeline after the encoder is done with the pool, the pool is
+// reference-counted by the encoder and by each outstanding buffer.
+//---------------------------------------------------------------------------------------------
+class gstEncoderBufferPool
+{
+public:
+	static const uint32_t MaxBuffers = 16;
+
+	struct Slot
+	{
+		gstEncoderBufferPool* pool;
+		void* ptr;
+		bool  inUse;
+	};
+
+	gstEncoderBufferPool( size_t size ) : mSize(size), mCount(0), mRefCount(1)	{}
+
+	inline size_t GetSize() const	{ return mSize; }
+
+	// get a free buffer, allocating a new one if needed (returns NULL if all are in use)
+	Slot* Acquire()
+	{
+		mMutex.Lock();
+
+		Slot* slot = NULL;
+
+		for( uint32_t n=0; n < mCount; n++ )
+		{
+			if( !mSlots[n].inUse )
+			{
+				slot = &mSlots[n];
+				break;
+			}
+		}
+
+		if( !slot && mCount < MaxBuffers )
+		{
+			void* ptr = NULL;
+
+			if( cudaAllocMapped(&ptr, mSize, false) )
+			{
+				slot = &mSlots[mCount++];
+				slot->pool = this;
+				slot->ptr  = ptr;
+			}
+		}
+
+		if( slot != NULL )
+		{
+			slot->inUse = true;
+			mRefCount++;
+		}
+
+		mMutex.Unlock();
+		return slot;
+	}
+
+	// return a buffer to the pool (this can be called from any GStreamer thread)
+	static void Release( void* user_data )
+	{
+		Slot* slot = (Slot*)user_data;
+		gstEncoderBufferPool* pool = slot->pool;
+
+		pool->mMutex.Lock();
+		slot->inUse = false;
+		pool->mMutex.Unlock();
+
+		pool->Unref();
+	}
+
+	// drop a reference, and free the pool once no buffers are in-flight
+	void Unref()
+	{
+		mMutex.Lock();
+		const uint32_t refCount = --mRefCount;
+		mMutex.Unlock();
+
+		if( refCount > 0 )
+			return;
+
+		for( uint32_t n=0; n < mCount; n++ )
+			CUDA(cudaFreeHost(mSlots[n].ptr));
+
+		delete this;
+	}
+
+private:
+	Slot     mSlots[MaxBuffers];
+	size_t   mSize;
+	uint32_t mCount;
+	uint32_t mRefCount;
+	Mutex    mMutex;
+};
+
+
 // constructor
 gstEncoder::gstEncoder( const videoOptions& options ) : videoOutput(options)
 {	
+	mBufferPool   = NULL;
 	mAppSrc       = NULL;
 	mBus          = NULL;
 	mBufferCaps   = NULL;
@@ -102,6 +210,13 @@ gstEncoder::~gstEncoder()
 	}
 	
 	destroyPipeline();
+
+	// buffers still held by GStreamer keep the pool alive until they're released
+	if( mBufferPool != NULL )
+	{
+		mBufferPool->Unref();
+		mBufferPool = NULL;
+	}
 }
 
 
@@ -253,26 +368,34 @@ bool gstEncoder::init()
 		return false;
 	}
 
-	// create servers for RTSP/WebRTC streams
-	if( mOptions.resource.protocol == "rtsp" )
+	// create servers for RTSP/WebRTC streams (which all share the same encoder)
+	std::vector<URI> outputs(1, mOptions.resource);
+	outputs.insert(outputs.end(), mOptions.fanout.begin(), mOptions.fanout.end());
+
+	for( size_t n=0; n < outputs.size(); n++ )
 	{
-		mRTSPServer = RTSPServer::Create(mOptions.resource.port);
-		
-		if( !mRTSPServer )
-			return false;
-		
-		mRTSPServer->AddRoute(mOptions.resource.path.c_str(), mPipeline);
+		const URI& uri = outputs[n];
+
+		if( uri.protocol == "rtsp" )
+		{
+			mRTSPServer = RTSPServer::Create(uri.port);
+			
+			if( !mRTSPServer )
+				return false;
+			
+			mRTSPServer->AddRoute(uri.path.c_str(), mPipeline);
+		}
+		else if( uri.protocol == "webrtc" )
+		{
+			mWebRTCServer = WebRTCServer::Create(uri.port, mOptions.stunServer.c_str(),
+										  mOptions.sslCert.c_str(), mOptions.sslKey.c_str());
+			
+			if( !mWebRTCServer )
+				return false;
+			
+			mWebRTCServer->AddRoute(uri.path.c_str(), onWebsocketMessage, this, WEBRTC_VIDEO|WEBRTC_SEND|WEBRTC_PUBLIC|WEBRTC_MULTI_CLIENT);
+		}
 	}
-	else if( mOptions.resource.protocol == "webrtc" )
-	{
-		mWebRTCServer = WebRTCServer::Create(mOptions.resource.port, mOptions.stunServer.c_str(),
-									  mOptions.sslCert.c_str(), mOptions.sslKey.c_str());
-		
-		if( !mWebRTCServer )
-			return false;
-		
-		mWebRTCServer->AddRoute(mOptions.resource.path.c_str(), onWebsocketMessage, this, WEBRTC_VIDEO|WEBRTC_SEND|WEBRTC_PUBLIC|WEBRTC_MULTI_CLIENT);
-	}		
 
 	return true;
 }
@@ -313,6 +436,34 @@ bool gstEncoder::buildLaunchStr()
 	const URI& uri = GetResource();
 	std::string encoderOptions = "";
 
+	// gather the outputs that share the encoder (the primary resource, --output-fanout, and --output-save)
+	std::vector<URI> outputs(1, uri);
+	outputs.insert(outputs.end(), mOptions.fanout.begin(), mOptions.fanout.end());
+
+	if( mOptions.save.path.length() > 0 )
+		outputs.push_back(mOptions.save);
+
+	uint32_t numRTSP = 0;
+	uint32_t numWebRTC = 0;
+	bool networkStream = false;
+
+	for( size_t n=0; n < outputs.size(); n++ )
+	{
+		if( outputs[n].protocol == "rtsp" )
+			numRTSP++;
+		else if( outputs[n].protocol == "webrtc" )
+			numWebRTC++;
+
+		if( videoOptions::DeviceTypeFromStr(outputs[n].protocol.c_str()) == videoOptions::DEVICE_IP )
+			networkStream = true;
+	}
+
+	if( numRTSP > 1 || numWebRTC > 1 )
+	{
+		LogError(LOG_GSTREAMER "gstEncoder -- only one RTSP and one WebRTC output are supported per stream\n");
+		return false;
+	}
+
 	// select the encoder
 	const char* encoder = gst_select_encoder(mOptions.codec, mOptions.codecType);
 	
@@ -343,14 +494,14 @@ bool gstEncoder::buildLaunchStr()
 			ss << "bitrate=" << mOptions.bitRate / 1000 << " ";	// x264enc/x265enc bitrates are in kbits
 			ss << "speed-preset=ultrafast tune=zerolatency ";
 			
-			if( mOptions.deviceType == videoOptions::DEVICE_IP )
+			if( networkStream )
 				ss << "key-int-max=30 insert-vui=1 ";			// send keyframes/I-frames more frequently for network streams
 		}
 		else if( mOptions.codec == videoOptions::CODEC_VP8 || mOptions.codec == videoOptions::CODEC_VP9 )
 		{
 			ss << "target-bitrate=" << mOptions.bitRate << " ";
 			
-			if( mOptions.deviceType == videoOptions::DEVICE_IP )
+			if( networkStream )
 				ss << "keyframe-max-dist=30 ";
 		}
 	}
@@ -358,7 +509,7 @@ bool gstEncoder::buildLaunchStr()
 	{
 		ss << "bitrate=" << mOptions.bitRate << " ";
 		
-		if( mOptions.deviceType == videoOptions::DEVICE_IP )
+		if( networkStream )
 		{
 			if( mOptions.codecType == videoOptions::CODEC_V4L2 )
 				ss << "insert-sps-pps=1 insert-vui=1 idrinterval=30 ";
@@ -381,16 +532,40 @@ bool gstEncoder::buildLaunchStr()
 	else if( mOptions.codec == videoOptions::CODEC_MJPEG )
 		ss << "! image/jpeg ! ";
 	
-	if( mOptions.save.path.length() > 0 )
+	// with multiple outputs, the encoded stream is split by a tee with a leaky queue for each
+	if( outputs.size() > 1 )
 	{
-		ss << "tee name=savetee savetee. ! queue ! ";
-		
-		if( !gst_build_filesink(mOptions.save, mOptions.codec, ss) )
-			return false;
+		ss << "tee name=encodertee ";
 
-		ss << "savetee. ! queue ! ";
+		for( size_t n=0; n < outputs.size(); n++ )
+		{
+			ss << "encodertee. ! queue leaky=downstream max-size-buffers=" << GST_ENCODER_FANOUT_QUEUE;
+			ss << " max-size-bytes=0 max-size-time=0 ! ";
+
+			if( !buildSinkStr(outputs[n], ss) )
+				return false;
+
+			ss << " ";
+		}
 	}
-	
+	else
+	{
+		if( !buildSinkStr(uri, ss) )
+			return false;
+	}
+
+	mLaunchStr = ss.str();
+
+	LogInfo(LOG_GSTREAMER "gstEncoder -- pipeline launch string:\n");
+	LogInfo(LOG_GSTREAMER "%s\n", mLaunchStr.c_str());
+
+	return true;
+}
+
+
+// buildSinkStr
+bool gstEncoder::buildSinkStr( const URI& uri, std::ostringstream& ss )
+{
 	if( uri.protocol == "file" )
 	{
 		if( !gst_build_filesink(uri, mOptions.codec, ss) )
@@ -463,11 +638,6 @@ bool gstEncoder::buildLaunchStr()
 		return false;
 	}
 
-	mLaunchStr = ss.str();
-
-	LogInfo(LOG_GSTREAMER "gstEncoder -- pipeline launch string:\n");
-	LogInfo(LOG_GSTREAMER "%s\n", mLaunchStr.c_str());
-
 	return true;
 }
 
@@ -498,12 +668,9 @@ void gstEncoder::onEnoughData( GstElement* pipeline, gpointer user_data )
 }
 
 
-// encodeYUV
-bool gstEncoder::encodeYUV( void* buffer, size_t size )
+// prepareStream
+bool gstEncoder::prepareStream()
 {
-	if( !buffer || size == 0 )
-		return false;
-	
 	// confirm the stream is open
 	if( !mStreaming )
 	{
@@ -544,6 +711,19 @@ bool gstEncoder::encodeYUV( void* buffer, size_t size )
 	#endif
 	}
 
+	return true;
+}
+
+
+// encodeYUV
+bool gstEncoder::encodeYUV( void* buffer, size_t size )
+{
+	if( !buffer || size == 0 )
+		return false;
+	
+	if( !prepareStream() )
+		return false;
+
 #if GST_CHECK_VERSION(1,0,0)
 	// allocate gstreamer buffer memory
 	GstBuffer* gstBuffer = gst_buffer_new_allocate(NULL, size, NULL);
@@ -587,6 +767,29 @@ bool gstEncoder::encodeYUV( void* buffer, size_t size )
 	memcpy(GST_BUFFER_DATA(gstBuffer), buffer, size);
 #endif
 
+	return pushBuffer(gstBuffer);
+}
+
+
+// encodeYUV
+bool gstEncoder::encodeYUV( GstBuffer* gstBuffer )
+{
+	if( !gstBuffer )
+		return false;
+
+	if( !prepareStream() )
+	{
+		gst_buffer_unref(gstBuffer);
+		return false;
+	}
+
+	return pushBuffer(gstBuffer);
+}
+
+
+// pushBuffer (the stream has already been prepared by encodeYUV)
+bool gstEncoder::pushBuffer( GstBuffer* gstBuffer )
+{
 	// queue buffer to gstreamer
 	while( true )
 	{
@@ -690,19 +893,46 @@ bool gstEncoder::Render( void* image, uint32_t width, uint32_t height, imageForm
 
 	// allocate color conversion buffer
 	const size_t i420Size = imageFormatSize(IMAGE_I420, width, height);
+	void* nextYUV = NULL;
 
-	if( !mBufferYUV.Alloc(2, i420Size, RingBuffer::ZeroCopy) )
+#if GST_CHECK_VERSION(1,0,0)
+	// convert directly into a pooled buffer that gets wrapped without copying
+	if( mBufferPool != NULL && mBufferPool->GetSize() != i420Size )
 	{
-		LogError(LOG_GSTREAMER "gstEncoder -- failed to allocate buffers (%zu bytes each)\n", i420Size);
-		enc_success = false;
-		render_end();
+		mBufferPool->Unref();
+		mBufferPool = NULL;
 	}
 
-	// perform colorspace conversion
-	void* nextYUV = mBufferYUV.Next(RingBuffer::Write);
+	if( !mBufferPool )
+		mBufferPool = new gstEncoderBufferPool(i420Size);
+
+	gstEncoderBufferPool::Slot* pooledYUV = mBufferPool->Acquire();
+
+	if( pooledYUV != NULL )
+		nextYUV = pooledYUV->ptr;
+#endif
 
+	// fall back to copying from the ringbuffer if all the pooled buffers are in-flight
+	if( !nextYUV )
+	{
+		if( !mBufferYUV.Alloc(2, i420Size, RingBuffer::ZeroCopy) )
+		{
+			LogError(LOG_GSTREAMER "gstEncoder -- failed to allocate buffers (%zu bytes each)\n", i420Size);
+			enc_success = false;
+			render_end();
+		}
+
+		nextYUV = mBufferYUV.Next(RingBuffer::Write);
+	}
+
+	// perform colorspace conversion
 	if( CUDA_FAILED(cudaConvertColor(image, format, nextYUV, IMAGE_I420, width, height, stream)) )
 	{
+	#if GST_CHECK_VERSION(1,0,0)
+		if( pooledYUV != NULL )
+			gstEncoderBufferPool::Release(pooledYUV);
+	#endif
+	
 		LogError(LOG_GSTREAMER "gstEncoder::Render() -- unsupported image format (%s)\n", imageFormatToStr(format));
 		LogError(LOG_GSTREAMER "                        supported formats are:\n");
 		LogError(LOG_GSTREAMER "                            * rgb8\n");		
@@ -720,6 +950,11 @@ bool gstEncoder::Render( void* image, uint32_t width, uint32_t height, imageForm
 	    CUDA(cudaDeviceSynchronize());
 	
 	// encode YUV buffer
+#if GST_CHECK_VERSION(1,0,0)
+	if( pooledYUV != NULL )
+		enc_success = encodeYUV(gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY, nextYUV, i420Size, 0, i420Size, pooledYUV, gstEncoderBufferPool::Release));
+	else
+#endif
 	enc_success = encodeYUV(nextYUV, i420Size);
 
 	// render sub-streams
@@ -842,6 +1077,10 @@ void gstEncoder::onWebsocketMessage( WebRTCPeer* peer, const char* message, size
 		gst_object_ref(peer_context->queue);
 		g_free(tmp);
 		
+		// drop the oldest frames for this peer if it falls behind, instead of blocking the other outputs
+		g_object_set(peer_context->queue, "leaky", 2 /*downstream*/, "max-size-buffers", GST_ENCODER_FANOUT_QUEUE,
+				   "max-size-bytes", 0, "max-size-time", (guint64)0, NULL);
+		
 		// create a new webrtcbin element
 		tmp = g_strdup_printf("webrtcbin-%u", peer->ID);
 		peer_context->webrtcbin = gst_element_factory_make("webrtcbin", tmp);
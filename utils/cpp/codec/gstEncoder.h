@@ -32,6 +32,7 @@
 class RTSPServer;
 class WebRTCServer;
 struct WebRTCPeer;
+class gstEncoderBufferPool;
 
 
 /**
@@ -41,6 +42,10 @@ struct WebRTCPeer;
  * or stream over the network to a remote host via RTP/RTSP using UDP/IP.
  * The supported encoder codecs are H.264, H.265, VP8, VP9, and MJPEG.
  *
+ * The video is encoded once and can fan out to multiple outputs (for example RTSP,
+ * WebRTC, and a file) from a tee, with a leaky queue in front of each so that a slow
+ * output drops frames instead of stalling the others (see videoOptions::fanout).
+ *
  * @note gstEncoder implements the videoOutput interface and is intended to
  * be used through that as opposed to directly.  videoOutput implements
  * additional command-line parsing of videoOptions to construct instances.
@@ -100,6 +105,11 @@ public:
 	 */
 	inline WebRTCServer* GetWebRTCServer() const 	{ return mWebRTCServer; }
 	
+	/**
+	 * Return the RTSP server (only used when the protocol is "rtsp://")
+	 */
+	inline RTSPServer* GetRTSPServer() const 		{ return mRTSPServer; }
+	
 	/**
 	 * Return the interface type (gstEncoder::Type)
 	 */
@@ -140,7 +150,11 @@ protected:
 	void checkMsgBus();
 	bool buildCapsStr();
 	bool buildLaunchStr();
+	bool buildSinkStr( const URI& uri, std::ostringstream& ss );
+	bool prepareStream();
 	bool encodeYUV( void* buffer, size_t size );
+	bool encodeYUV( GstBuffer* buffer );
+	bool pushBuffer( GstBuffer* buffer );
 	
 	// appsrc callbacks
 	static void onNeedData( GstElement* pipeline, uint32_t size, void* user_data );
@@ -160,6 +174,8 @@ protected:
 
 	RingBuffer mBufferYUV;
 	
+	gstEncoderBufferPool* mBufferPool;
+	
 	RTSPServer*   mRTSPServer;
 	WebRTCServer* mWebRTCServer;
 };
@@ -0,0 +1,1259 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "cpuColorspace.h"
+#include "imageIO.h"
+#include "Thread.h"
+#include "Event.h"
+#include "Mutex.h"
+#include "logging.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CPU_COLORSPACE_AVX2
+#define AVX2_TARGET __attribute__((target("avx2")))
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#define CPU_COLORSPACE_NEON
+#endif
+
+
+//-----------------------------------------------------------------------------------
+// Each conversion is done one row at a time in two stages:  the input row is
+// decoded to planar R/G/B/A rows, and then the planar rows are encoded to the
+// output format.  The planar rows are small enough to stay in L1 cache.
+//-----------------------------------------------------------------------------------
+enum { PLANE_R = 0, PLANE_G, PLANE_B, PLANE_A, NUM_PLANES };
+
+// decodes row y of the input image to planar RGBA
+typedef void (*cpuDecodeRow)( const uint8_t* input, size_t width, size_t height, size_t y, uint8_t** planes, bool simd );
+
+// encodes planar RGBA to row y of the output image
+typedef void (*cpuEncodeRow)( uint8_t** planes, uint8_t* output, size_t width, size_t height, size_t y, bool simd );
+
+// encodes two rows of planar RGBA to rows y and y+1 of a 4:2:0 output image
+typedef void (*cpuEncodeRowPair)( uint8_t** planes0, uint8_t** planes1, uint8_t* output, size_t width, size_t height, size_t y, bool simd );
+
+
+// the order of the R/G/B/A channels in the packed formats (-1 if missing)
+struct cpuPackedLayout
+{
+	int channels;
+	int index[NUM_PLANES];
+};
+
+enum { PACKED_RGB = 0, PACKED_BGR, PACKED_RGBA, PACKED_BGRA };
+
+static const cpuPackedLayout packedLayouts[] =
+{
+	{ 3, { 0, 1, 2, -1 } },	// RGB
+	{ 3, { 2, 1, 0, -1 } },	// BGR
+	{ 4, { 0, 1, 2,  3 } },	// RGBA
+	{ 4, { 2, 1, 0,  3 } },	// BGRA
+};
+
+// the byte offsets of Y0/Y1/U/V in the YUYV-style macropixels
+struct cpuMacropixelLayout
+{
+	int y0, y1, u, v;
+};
+
+enum { MACROPIXEL_YUYV = 0, MACROPIXEL_YVYU, MACROPIXEL_UYVY };
+
+static const cpuMacropixelLayout macropixelLayouts[] =
+{
+	{ 0, 2, 1, 3 },	// YUYV [ Y0 | U0 | Y1 | V0 ]
+	{ 0, 2, 3, 1 },	// YVYU [ Y0 | V0 | Y1 | U0 ]
+	{ 1, 3, 0, 2 },	// UYVY [ U0 | Y0 | V0 | Y1 ]
+};
+
+
+//-----------------------------------------------------------------------------------
+// SIMD dispatch
+//-----------------------------------------------------------------------------------
+static bool detectSIMD()
+{
+#if defined(CPU_COLORSPACE_AVX2)
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#elif defined(CPU_COLORSPACE_NEON)
+	return true;
+#else
+	return false;
+#endif
+}
+
+static const bool gSimdSupported = detectSIMD();
+static bool gSimdEnabled = true;
+
+
+// cpuColorspaceSIMD
+const char* cpuColorspaceSIMD()
+{
+	if( !gSimdSupported || !gSimdEnabled )
+		return "none";
+
+#if defined(CPU_COLORSPACE_AVX2)
+	return "AVX2";
+#elif defined(CPU_COLORSPACE_NEON)
+	return "NEON";
+#else
+	return "none";
+#endif
+}
+
+
+// cpuColorspaceEnableSIMD
+void cpuColorspaceEnableSIMD( bool enable )
+{
+	gSimdEnabled = enable;
+}
+
+
+//-----------------------------------------------------------------------------------
+// Scalar reference math (see cudaYUV-NV12.cu, cudaYUV-YV12.cu, cudaGrayscale.cu)
+//-----------------------------------------------------------------------------------
+static inline float clampf( float x )
+{
+	return (x < 0.0f) ? 0.0f : ((x > 255.0f) ? 255.0f : x);
+}
+
+// NV12 uses 10-bit components (see YUV2RGB() from cudaYUV-NV12.cu)
+static inline void yuv10ToRGB( uint32_t y, uint32_t cb, uint32_t cr, uint8_t* r, uint8_t* g, uint8_t* b )
+{
+	const float luma = float(y << 2);
+	const float u    = float(cb << 2) - 512.0f;
+	const float v    = float(cr << 2) - 512.0f;
+	const float s    = 1.0f / 1024.0f * 255.0f;
+
+	*r = clampf((luma + 1.402f * v) * s);
+	*g = clampf((luma - 0.344f * u - 0.714f * v) * s);
+	*b = clampf((luma + 1.772f * u) * s);
+}
+
+// I420/YV12/YUYV use 8-bit components (see YUV2RGB() from cudaYUV-YV12.cu)
+static inline void yuv8ToRGB( float y, float u, float v, uint8_t* r, uint8_t* g, uint8_t* b )
+{
+	u -= 128.0f;
+	v -= 128.0f;
+
+	*r = clampf(y + 1.4065f * v);
+	*g = clampf(y - 0.3455f * u - 0.7169f * v);
+	*b = clampf(y + 1.7790f * u);
+}
+
+// see RGB2Gray() from cudaGrayscale.cu
+static inline uint8_t rgbToGray( uint8_t r, uint8_t g, uint8_t b )
+{
+	return float(r) * 0.2989f + float(g) * 0.5870f + float(b) * 0.1140f;
+}
+
+// see rgb_to_y() and rgb_to_yuv() from cudaYUV-YV12.cu
+static inline uint8_t rgbToY( uint8_t r, uint8_t g, uint8_t b )
+{
+	return ((int)(30 * r) + (int)(59 * g) + (int)(11 * b)) / 100;
+}
+
+static inline void rgbToUV( uint8_t r, uint8_t g, uint8_t b, uint8_t* u, uint8_t* v )
+{
+	*u = ((int)(-17 * r) - (int)(33 * g) + (int)(50 * b) + 12800) / 100;
+	*v = ((int)(50 * r) - (int)(42 * g) - (int)(8 * b) + 12800) / 100;
+}
+
+
+#if defined(CPU_COLORSPACE_AVX2)
+//-----------------------------------------------------------------------------------
+// AVX2 kernels
+//
+// The byte shuffles for (de)interleaving are done 16 pixels at a time with
+// pshufb tables that gather each output register from several input registers,
+// while the float math is done 8 pixels at a time in 256-bit registers.
+//-----------------------------------------------------------------------------------
+struct cpuShuffleTables
+{
+	// [channels][chunk][channel][byte]
+	uint8_t deinterleave[5][4][4][16] __attribute__((aligned(16)));
+	uint8_t interleave[5][4][4][16] __attribute__((aligned(16)));
+
+	// [layout][Y/U/V][chunk][byte]
+	uint8_t macropixel[3][3][2][16] __attribute__((aligned(16)));
+
+	cpuShuffleTables()
+	{
+		memset(this, 0x80, sizeof(cpuShuffleTables));
+
+		for( int n=3; n <= 4; n++ )
+		{
+			for( int i=0; i < 16 * n; i++ )
+			{
+				// byte i of the packed pixels belongs to pixel i/n, channel i%n
+				deinterleave[n][i / 16][i % n][i / n] = i % 16;
+				interleave[n][i / 16][i % n][i % 16] = i / n;
+			}
+		}
+
+		for( int l=0; l < 3; l++ )
+		{
+			const cpuMacropixelLayout& layout = macropixelLayouts[l];
+
+			for( int i=0; i < 16; i++ )
+			{
+				const int base = (i / 2) * 4;
+				const int offsets[] = { base + ((i & 1) ? layout.y1 : layout.y0),
+								    base + layout.u,
+								    base + layout.v };
+
+				for( int c=0; c < 3; c++ )
+					macropixel[l][c][offsets[c] / 16][i] = offsets[c] % 16;
+			}
+		}
+	}
+};
+
+static const cpuShuffleTables& shuffleTables()
+{
+	static const cpuShuffleTables tables;
+	return tables;
+}
+
+// convert the low 8 bytes to floats
+AVX2_TARGET static inline __m256 u8ToFloat( __m128i v )
+{
+	return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v));
+}
+
+// convert 16 floats in [0,255] to bytes (truncating, like a C cast)
+AVX2_TARGET static inline __m128i floatToU8( __m256 lo, __m256 hi )
+{
+	const __m256i words = _mm256_permute4x64_epi64(_mm256_packus_epi32(_mm256_cvttps_epi32(lo), _mm256_cvttps_epi32(hi)), 0xD8);
+	return _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+}
+
+AVX2_TARGET static inline __m256 clampAVX2( __m256 x )
+{
+	return _mm256_min_ps(_mm256_max_ps(x, _mm256_setzero_ps()), _mm256_set1_ps(255.0f));
+}
+
+AVX2_TARGET static inline void yuv10ToRGB_AVX2( __m256 luma, __m256 u, __m256 v, __m256* r, __m256* g, __m256* b )
+{
+	const __m256 s = _mm256_set1_ps(1.0f / 1024.0f * 255.0f);
+
+	*r = clampAVX2(_mm256_mul_ps(_mm256_add_ps(luma, _mm256_mul_ps(_mm256_set1_ps(1.402f), v)), s));
+	*g = clampAVX2(_mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(luma, _mm256_mul_ps(_mm256_set1_ps(0.344f), u)), _mm256_mul_ps(_mm256_set1_ps(0.714f), v)), s));
+	*b = clampAVX2(_mm256_mul_ps(_mm256_add_ps(luma, _mm256_mul_ps(_mm256_set1_ps(1.772f), u)), s));
+}
+
+AVX2_TARGET static inline void yuv8ToRGB_AVX2( __m256 y, __m256 u, __m256 v, __m256* r, __m256* g, __m256* b )
+{
+	u = _mm256_sub_ps(u, _mm256_set1_ps(128.0f));
+	v = _mm256_sub_ps(v, _mm256_set1_ps(128.0f));
+
+	*r = clampAVX2(_mm256_add_ps(y, _mm256_mul_ps(_mm256_set1_ps(1.4065f), v)));
+	*g = clampAVX2(_mm256_sub_ps(_mm256_sub_ps(y, _mm256_mul_ps(_mm256_set1_ps(0.3455f), u)), _mm256_mul_ps(_mm256_set1_ps(0.7169f), v)));
+	*b = clampAVX2(_mm256_add_ps(y, _mm256_mul_ps(_mm256_set1_ps(1.7790f), u)));
+}
+
+// convert 16 pixels of 8-bit YUV to planar RGB
+AVX2_TARGET static inline void storeYUV8_AVX2( __m128i y, __m128i u, __m128i v, uint8_t** planes, size_t x )
+{
+	__m256 r[2], g[2], b[2];
+
+	yuv8ToRGB_AVX2(u8ToFloat(y), u8ToFloat(u), u8ToFloat(v), &r[0], &g[0], &b[0]);
+	yuv8ToRGB_AVX2(u8ToFloat(_mm_srli_si128(y, 8)), u8ToFloat(_mm_srli_si128(u, 8)), u8ToFloat(_mm_srli_si128(v, 8)), &r[1], &g[1], &b[1]);
+
+	_mm_storeu_si128((__m128i*)(planes[PLANE_R] + x), floatToU8(r[0], r[1]));
+	_mm_storeu_si128((__m128i*)(planes[PLANE_G] + x), floatToU8(g[0], g[1]));
+	_mm_storeu_si128((__m128i*)(planes[PLANE_B] + x), floatToU8(b[0], b[1]));
+}
+
+template<int N> AVX2_TARGET
+static size_t deinterleaveSIMD( const uint8_t* input, uint8_t** channels, size_t width )
+{
+	const cpuShuffleTables& tables = shuffleTables();
+
+	__m128i masks[N][N];
+
+	for( int k=0; k < N; k++ )
+		for( int c=0; c < N; c++ )
+			masks[k][c] = _mm_load_si128((const __m128i*)tables.deinterleave[N][k][c]);
+
+	size_t x = 0;
+
+	for( ; x + 16 <= width; x += 16 )
+	{
+		__m128i chunks[N];
+
+		for( int k=0; k < N; k++ )
+			chunks[k] = _mm_loadu_si128((const __m128i*)(input + x * N + k * 16));
+
+		for( int c=0; c < N; c++ )
+		{
+			__m128i v = _mm_shuffle_epi8(chunks[0], masks[0][c]);
+
+			for( int k=1; k < N; k++ )
+				v = _mm_or_si128(v, _mm_shuffle_epi8(chunks[k], masks[k][c]));
+
+			_mm_storeu_si128((__m128i*)(channels[c] + x), v);
+		}
+	}
+
+	return x;
+}
+
+template<int N> AVX2_TARGET
+static size_t interleaveSIMD( uint8_t** channels, uint8_t* output, size_t width )
+{
+	const cpuShuffleTables& tables = shuffleTables();
+
+	__m128i masks[N][N];
+
+	for( int k=0; k < N; k++ )
+		for( int c=0; c < N; c++ )
+			masks[k][c] = _mm_load_si128((const __m128i*)tables.interleave[N][k][c]);
+
+	size_t x = 0;
+
+	for( ; x + 16 <= width; x += 16 )
+	{
+		__m128i planes[N];
+
+		for( int c=0; c < N; c++ )
+			planes[c] = _mm_loadu_si128((const __m128i*)(channels[c] + x));
+
+		for( int k=0; k < N; k++ )
+		{
+			__m128i v = _mm_shuffle_epi8(planes[0], masks[k][0]);
+
+			for( int c=1; c < N; c++ )
+				v = _mm_or_si128(v, _mm_shuffle_epi8(planes[c], masks[k][c]));
+
+			_mm_storeu_si128((__m128i*)(output + x * N + k * 16), v);
+		}
+	}
+
+	return x;
+}
+
+AVX2_TARGET static size_t decodeNV12_SIMD( const uint8_t* luma, const uint8_t* chroma, const uint8_t* chromaNext, uint8_t** planes, size_t width )
+{
+	// duplicate each Cb/Cr sample for the two pixels that share it
+	const __m128i cbMask = _mm_setr_epi8(0, 0, 2, 2, 4, 4, 6, 6, 8, 8, 10, 10, 12, 12, 14, 14);
+	const __m128i crMask = _mm_setr_epi8(1, 1, 3, 3, 5, 5, 7, 7, 9, 9, 11, 11, 13, 13, 15, 15);
+
+	const __m256 four = _mm256_set1_ps(4.0f);
+	const __m256 bias = _mm256_set1_ps(512.0f);
+
+	size_t x = 0;
+
+	for( ; x + 16 <= width; x += 16 )
+	{
+		const __m128i y = _mm_loadu_si128((const __m128i*)(luma + x));
+		__m128i c = _mm_loadu_si128((const __m128i*)(chroma + x));
+
+		if( chromaNext != NULL )
+			c = _mm_avg_epu8(c, _mm_loadu_si128((const __m128i*)(chromaNext + x)));	// (a + b + 1) >> 1
+
+		const __m128i cb = _mm_shuffle_epi8(c, cbMask);
+		const __m128i cr = _mm_shuffle_epi8(c, crMask);
+
+		__m256 r[2], g[2], b[2];
+
+		const __m128i yHi  = _mm_srli_si128(y, 8);
+		const __m128i cbHi = _mm_srli_si128(cb, 8);
+		const __m128i crHi = _mm_srli_si128(cr, 8);
+
+		yuv10ToRGB_AVX2(_mm256_mul_ps(u8ToFloat(y), four),
+					 _mm256_sub_ps(_mm256_mul_ps(u8ToFloat(cb), four), bias),
+					 _mm256_sub_ps(_mm256_mul_ps(u8ToFloat(cr), four), bias),
+					 &r[0], &g[0], &b[0]);
+
+		yuv10ToRGB_AVX2(_mm256_mul_ps(u8ToFloat(yHi), four),
+					 _mm256_sub_ps(_mm256_mul_ps(u8ToFloat(cbHi), four), bias),
+					 _mm256_sub_ps(_mm256_mul_ps(u8ToFloat(crHi), four), bias),
+					 &r[1], &g[1], &b[1]);
+
+		_mm_storeu_si128((__m128i*)(planes[PLANE_R] + x), floatToU8(r[0], r[1]));
+		_mm_storeu_si128((__m128i*)(planes[PLANE_G] + x), floatToU8(g[0], g[1]));
+		_mm_storeu_si128((__m128i*)(planes[PLANE_B] + x), floatToU8(b[0], b[1]));
+	}
+
+	return x;
+}
+
+AVX2_TARGET static size_t decodeI420_SIMD( const uint8_t* yRow, const uint8_t* uRow, const uint8_t* vRow, uint8_t** planes, size_t width )
+{
+	size_t x = 0;
+
+	for( ; x + 16 <= width; x += 16 )
+	{
+		const __m128i y = _mm_loadu_si128((const __m128i*)(yRow + x));
+		const __m128i u = _mm_loadl_epi64((const __m128i*)(uRow + x / 2));
+		const __m128i v = _mm_loadl_epi64((const __m128i*)(vRow + x / 2));
+
+		storeYUV8_AVX2(y, _mm_unpacklo_epi8(u, u), _mm_unpacklo_epi8(v, v), planes, x);
+	}
+
+	return x;
+}
+
+AVX2_TARGET static size_t decodeMacropixel_SIMD( const uint8_t* input, int l, uint8_t** planes, size_t width )
+{
+	const cpuShuffleTables& tables = shuffleTables();
+
+	__m128i masks[3][2];
+
+	for( int c=0; c < 3; c++ )
+		for( int k=0; k < 2; k++ )
+			masks[c][k] = _mm_load_si128((const __m128i*)tables.macropixel[l][c][k]);
+
+	size_t x = 0;
+
+	for( ; x + 16 <= width; x += 16 )
+	{
+		const __m128i c0 = _mm_loadu_si128((const __m128i*)(input + x * 2));
+		const __m128i c1 = _mm_loadu_si128((const __m128i*)(input + x * 2 + 16));
+
+		__m128i yuv[3];
+
+		for( int c=0; c < 3; c++ )
+			yuv[c] = _mm_or_si128(_mm_shuffle_epi8(c0, masks[c][0]), _mm_shuffle_epi8(c1, masks[c][1]));
+
+		storeYUV8_AVX2(yuv[0], yuv[1], yuv[2], planes, x);
+	}
+
+	return x;
+}
+
+AVX2_TARGET static size_t encodeGray_SIMD( uint8_t** planes, uint8_t* output, size_t width )
+{
+	const __m256 kr = _mm256_set1_ps(0.2989f);
+	const __m256 kg = _mm256_set1_ps(0.5870f);
+	const __m256 kb = _mm256_set1_ps(0.1140f);
+
+	size_t x = 0;
+
+	for( ; x + 16 <= width; x += 16 )
+	{
+		const __m128i r = _mm_loadu_si128((const __m128i*)(planes[PLANE_R] + x));
+		const __m128i g = _mm_loadu_si128((const __m128i*)(planes[PLANE_G] + x));
+		const __m128i b = _mm_loadu_si128((const __m128i*)(planes[PLANE_B] + x));
+
+		const __m256 lo = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(u8ToFloat(r), kr), _mm256_mul_ps(u8ToFloat(g), kg)), _mm256_mul_ps(u8ToFloat(b), kb));
+
+		const __m256 hi = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(u8ToFloat(_mm_srli_si128(r, 8)), kr),
+										  _mm256_mul_ps(u8ToFloat(_mm_srli_si128(g, 8)), kg)),
+								  _mm256_mul_ps(u8ToFloat(_mm_srli_si128(b, 8)), kb));
+
+		_mm_storeu_si128((__m128i*)(output + x), floatToU8(lo, hi));
+	}
+
+	return x;
+}
+
+AVX2_TARGET static size_t encodeLuma_SIMD( uint8_t** planes, uint8_t* output, size_t width )
+{
+	const __m256i kr = _mm256_set1_epi16(30);
+	const __m256i kg = _mm256_set1_epi16(59);
+	const __m256i kb = _mm256_set1_epi16(11);
+
+	// the weighted sum is at most 25500, and (sum * 5243) >> 19 == sum / 100 over that range
+	const __m256i div = _mm256_set1_epi16(5243);
+
+	size_t x = 0;
+
+	for( ; x + 16 <= width; x += 16 )
+	{
+		const __m256i r = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(planes[PLANE_R] + x)));
+		const __m256i g = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(planes[PLANE_G] + x)));
+		const __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(planes[PLANE_B] + x)));
+
+		const __m256i sum = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(r, kr), _mm256_mullo_epi16(g, kg)), _mm256_mullo_epi16(b, kb));
+		const __m256i y = _mm256_srli_epi16(_mm256_mulhi_epu16(sum, div), 3);
+
+		_mm_storeu_si128((__m128i*)(output + x), _mm_packus_epi16(_mm256_castsi256_si128(y), _mm256_extracti128_si256(y, 1)));
+	}
+
+	return x;
+}
+
+#elif defined(CPU_COLORSPACE_NEON)
+//-----------------------------------------------------------------------------------
+// NEON kernels (16 pixels at a time, with the float math in four 128-bit registers)
+//-----------------------------------------------------------------------------------
+static inline void u8ToFloat( uint8x16_t v, float32x4_t* f )
+{
+	const uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+	const uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+
+	f[0] = vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo)));
+	f[1] = vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo)));
+	f[2] = vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi)));
+	f[3] = vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi)));
+}
+
+// convert 16 floats in [0,255] to bytes (truncating, like a C cast)
+static inline uint8x16_t floatToU8( const float32x4_t* f )
+{
+	const uint16x8_t lo = vcombine_u16(vmovn_u32(vcvtq_u32_f32(f[0])), vmovn_u32(vcvtq_u32_f32(f[1])));
+	const uint16x8_t hi = vcombine_u16(vmovn_u32(vcvtq_u32_f32(f[2])), vmovn_u32(vcvtq_u32_f32(f[3])));
+
+	return vcombine_u8(vmovn_u16(lo), vmovn_u16(hi));
+}
+
+static inline float32x4_t clampNEON( float32x4_t x )
+{
+	return vminq_f32(vmaxq_f32(x, vdupq_n_f32(0.0f)), vdupq_n_f32(255.0f));
+}
+
+// convert 16 pixels of 8-bit YUV to planar RGB
+static inline void storeYUV8_NEON( uint8x16_t y, uint8x16_t u, uint8x16_t v, uint8_t** planes, size_t x )
+{
+	float32x4_t fy[4], fu[4], fv[4];
+	float32x4_t r[4], g[4], b[4];
+
+	u8ToFloat(y, fy);
+	u8ToFloat(u, fu);
+	u8ToFloat(v, fv);
+
+	for( int n=0; n < 4; n++ )
+	{
+		fu[n] = vsubq_f32(fu[n], vdupq_n_f32(128.0f));
+		fv[n] = vsubq_f32(fv[n], vdupq_n_f32(128.0f));
+
+		r[n] = clampNEON(vaddq_f32(fy[n], vmulq_n_f32(fv[n], 1.4065f)));
+		g[n] = clampNEON(vsubq_f32(vsubq_f32(fy[n], vmulq_n_f32(fu[n], 0.3455f)), vmulq_n_f32(fv[n], 0.7169f)));
+		b[n] = clampNEON(vaddq_f32(fy[n], vmulq_n_f32(fu[n], 1.7790f)));
+	}
+
+	vst1q_u8(planes[PLANE_R] + x, floatToU8(r));
+	vst1q_u8(planes[PLANE_G] + x, floatToU8(g));
+	vst1q_u8(planes[PLANE_B] + x, floatToU8(b));
+}
+
+template<int N>
+static size_t deinterleaveSIMD( const uint8_t* input, uint8_t** channels, size_t width )
+{
+	size_t x = 0;
+
+	for( ; x + 16 <= width; x += 16 )
+	{
+		if( N == 3 )
+		{
+			const uint8x16x3_t v = vld3q_u8(input + x * 3);
+
+			for( int c=0; c < 3; c++ )
+				vst1q_u8(channels[c] + x, v.val[c]);
+		}
+		else
+		{
+			const uint8x16x4_t v = vld4q_u8(input + x * 4);
+
+			for( int c=0; c < 4; c++ )
+				vst1q_u8(channels[c] + x, v.val[c]);
+		}
+	}
+
+	return x;
+}
+
+template<int N>
+static size_t interleaveSIMD( uint8_t** channels, uint8_t* output, size_t width )
+{
+	size_t x = 0;
+
+	for( ; x + 16 <= width; x += 16 )
+	{
+		if( N == 3 )
+		{
+			uint8x16x3_t v;
+
+			for( int c=0; c < 3; c++ )
+				v.val[c] = vld1q_u8(channels[c] + x);
+
+			vst3q_u8(output + x * 3, v);
+		}
+		else
+		{
+			uint8x16x4_t v;
+
+			for( int c=0; c < 4; c++ )
+				v.val[c] = vld1q_u8(channels[c] + x);
+
+			vst4q_u8(output + x * 4, v);
+		}
+	}
+
+	return x;
+}
+
+static size_t decodeNV12_SIMD( const uint8_t* luma, const uint8_t* chroma, const uint8_t* chromaNext, uint8_t** planes, size_t width )
+{
+	const float s = 1.0f / 1024.0f * 255.0f;
+
+	size_t x = 0;
+
+	for( ; x + 16 <= width; x += 16 )
+	{
+		uint8x8x2_t c = vld2_u8(chroma + x);
+
+		if( chromaNext != NULL )
+		{
+			const uint8x8x2_t n = vld2_u8(chromaNext + x);
+
+			c.val[0] = vrhadd_u8(c.val[0], n.val[0]);	// (a + b + 1) >> 1
+			c.val[1] = vrhadd_u8(c.val[1], n.val[1]);
+		}
+
+		// duplicate each Cb/Cr sample for the two pixels that share it
+		const uint8x8x2_t cb = vzip_u8(c.val[0], c.val[0]);
+		const uint8x8x2_t cr = vzip_u8(c.val[1], c.val[1]);
+
+		float32x4_t l[4], u[4], v[4];
+		float32x4_t r[4], g[4], b[4];
+
+		u8ToFloat(vld1q_u8(luma + x), l);
+		u8ToFloat(vcombine_u8(cb.val[0], cb.val[1]), u);
+		u8ToFloat(vcombine_u8(cr.val[0], cr.val[1]), v);
+
+		for( int n=0; n < 4; n++ )
+		{
+			l[n] = vmulq_n_f32(l[n], 4.0f);
+			u[n] = vsubq_f32(vmulq_n_f32(u[n], 4.0f), vdupq_n_f32(512.0f));
+			v[n] = vsubq_f32(vmulq_n_f32(v[n], 4.0f), vdupq_n_f32(512.0f));
+
+			r[n] = clampNEON(vmulq_n_f32(vaddq_f32(l[n], vmulq_n_f32(v[n], 1.402f)), s));
+			g[n] = clampNEON(vmulq_n_f32(vsubq_f32(vsubq_f32(l[n], vmulq_n_f32(u[n], 0.344f)), vmulq_n_f32(v[n], 0.714f)), s));
+			b[n] = clampNEON(vmulq_n_f32(vaddq_f32(l[n], vmulq_n_f32(u[n], 1.772f)), s));
+		}
+
+		vst1q_u8(planes[PLANE_R] + x, floatToU8(r));
+		vst1q_u8(planes[PLANE_G] + x, floatToU8(g));
+		vst1q_u8(planes[PLANE_B] + x, floatToU8(b));
+	}
+
+	return x;
+}
+
+static size_t decodeI420_SIMD( const uint8_t* yRow, const uint8_t* uRow, const uint8_t* vRow, uint8_t** planes, size_t width )
+{
+	size_t x = 0;
+
+	for( ; x + 16 <= width; x += 16 )
+	{
+		const uint8x8_t u = vld1_u8(uRow + x / 2);
+		const uint8x8_t v = vld1_u8(vRow + x / 2);
+
+		const uint8x8x2_t u2 = vzip_u8(u, u);
+		const uint8x8x2_t v2 = vzip_u8(v, v);
+
+		storeYUV8_NEON(vld1q_u8(yRow + x), vcombine_u8(u2.val[0], u2.val[1]), vcombine_u8(v2.val[0], v2.val[1]), planes, x);
+	}
+
+	return x;
+}
+
+static size_t decodeMacropixel_SIMD( const uint8_t* input, int l, uint8_t** planes, size_t width )
+{
+	const cpuMacropixelLayout& layout = macropixelLayouts[l];
+
+	size_t x = 0;
+
+	for( ; x + 16 <= width; x += 16 )
+	{
+		// 8 macropixels -> 4 rows of 8 bytes, one per macropixel byte
+		const uint8x8x4_t m = vld4_u8(input + x * 2);
+
+		const uint8x8x2_t y = vzip_u8(m.val[layout.y0], m.val[layout.y1]);
+		const uint8x8x2_t u = vzip_u8(m.val[layout.u], m.val[layout.u]);
+		const uint8x8x2_t v = vzip_u8(m.val[layout.v], m.val[layout.v]);
+
+		storeYUV8_NEON(vcombine_u8(y.val[0], y.val[1]), vcombine_u8(u.val[0], u.val[1]), vcombine_u8(v.val[0], v.val[1]), planes, x);
+	}
+
+	return x;
+}
+
+static size_t encodeGray_SIMD( uint8_t** planes, uint8_t* output, size_t width )
+{
+	size_t x = 0;
+
+	for( ; x + 16 <= width; x += 16 )
+	{
+		float32x4_t r[4], g[4], b[4], gray[4];
+
+		u8ToFloat(vld1q_u8(planes[PLANE_R] + x), r);
+		u8ToFloat(vld1q_u8(planes[PLANE_G] + x), g);
+		u8ToFloat(vld1q_u8(planes[PLANE_B] + x), b);
+
+		for( int n=0; n < 4; n++ )
+			gray[n] = vaddq_f32(vaddq_f32(vmulq_n_f32(r[n], 0.2989f), vmulq_n_f32(g[n], 0.5870f)), vmulq_n_f32(b[n], 0.1140f));
+
+		vst1q_u8(output + x, floatToU8(gray));
+	}
+
+	return x;
+}
+
+static size_t encodeLuma_SIMD( uint8_t** planes, uint8_t* output, size_t width )
+{
+	size_t x = 0;
+
+	for( ; x + 16 <= width; x += 16 )
+	{
+		const uint8x16_t r = vld1q_u8(planes[PLANE_R] + x);
+		const uint8x16_t g = vld1q_u8(planes[PLANE_G] + x);
+		const uint8x16_t b = vld1q_u8(planes[PLANE_B] + x);
+
+		// the weighted sum is at most 25500, and (sum * 5243) >> 19 == sum / 100 over that range
+		uint16x8_t sum[2];
+
+		sum[0] = vmlal_u8(vmlal_u8(vmull_u8(vget_low_u8(r), vdup_n_u8(30)), vget_low_u8(g), vdup_n_u8(59)), vget_low_u8(b), vdup_n_u8(11));
+		sum[1] = vmlal_u8(vmlal_u8(vmull_u8(vget_high_u8(r), vdup_n_u8(30)), vget_high_u8(g), vdup_n_u8(59)), vget_high_u8(b), vdup_n_u8(11));
+
+		uint8x8_t y[2];
+
+		for( int h=0; h < 2; h++ )
+		{
+			const uint32x4_t lo = vshrq_n_u32(vmull_n_u16(vget_low_u16(sum[h]), 5243), 19);
+			const uint32x4_t hi = vshrq_n_u32(vmull_n_u16(vget_high_u16(sum[h]), 5243), 19);
+
+			y[h] = vmovn_u16(vcombine_u16(vmovn_u32(lo), vmovn_u32(hi)));
+		}
+
+		vst1q_u8(output + x, vcombine_u8(y[0], y[1]));
+	}
+
+	return x;
+}
+
+#else
+//-----------------------------------------------------------------------------------
+// no SIMD available, the scalar path converts every pixel
+//-----------------------------------------------------------------------------------
+template<int N> static size_t deinterleaveSIMD( const uint8_t*, uint8_t**, size_t )	{ return 0; }
+template<int N> static size_t interleaveSIMD( uint8_t**, uint8_t*, size_t )			{ return 0; }
+
+static size_t decodeNV12_SIMD( const uint8_t*, const uint8_t*, const uint8_t*, uint8_t**, size_t )	{ return 0; }
+static size_t decodeI420_SIMD( const uint8_t*, const uint8_t*, const uint8_t*, uint8_t**, size_t )	{ return 0; }
+static size_t decodeMacropixel_SIMD( const uint8_t*, int, uint8_t**, size_t )	{ return 0; }
+static size_t encodeGray_SIMD( uint8_t**, uint8_t*, size_t )									{ return 0; }
+static size_t encodeLuma_SIMD( uint8_t**, uint8_t*, size_t )									{ return 0; }
+#endif
+
+
+//-----------------------------------------------------------------------------------
+// Decoders
+//-----------------------------------------------------------------------------------
+template<int l>
+static void decodePacked( const uint8_t* input, size_t width, size_t height, size_t y, uint8_t** planes, bool simd )
+{
+	const cpuPackedLayout& layout = packedLayouts[l];
+	const uint8_t* row = input + y * width * layout.channels;
+
+	// map the packed channel order onto the planes
+	uint8_t* channels[4];
+
+	for( int p=0; p < layout.channels; p++ )
+		channels[layout.index[p]] = planes[p];
+
+	size_t x = 0;
+
+	if( simd )
+		x = (layout.channels == 3) ? deinterleaveSIMD<3>(row, channels, width) : deinterleaveSIMD<4>(row, channels, width);
+
+	for( ; x < width; x++ )
+		for( int c=0; c < layout.channels; c++ )
+			channels[c][x] = row[x * layout.channels + c];
+
+	if( layout.channels == 3 )
+		memset(planes[PLANE_A], 255, width);
+}
+
+static void decodeGray( const uint8_t* input, size_t width, size_t height, size_t y, uint8_t** planes, bool simd )
+{
+	const uint8_t* row = input + y * width;
+
+	memcpy(planes[PLANE_R], row, width);
+	memcpy(planes[PLANE_G], row, width);
+	memcpy(planes[PLANE_B], row, width);
+	memset(planes[PLANE_A], 255, width);
+}
+
+static void decodeNV12( const uint8_t* input, size_t width, size_t height, size_t y, uint8_t** planes, bool simd )
+{
+	const uint8_t* luma = input + y * width;
+	const uint8_t* chroma = input + width * height + (y >> 1) * width;
+	const uint8_t* chromaNext = NULL;
+
+	// odd scanlines interpolate the chroma vertically (see NV12ToRGB() from cudaYUV-NV12.cu)
+	if( (y & 1) && (y >> 1) < ((height >> 1) - 1) )
+		chromaNext = chroma + width;
+
+	size_t x = 0;
+
+	if( simd )
+		x = decodeNV12_SIMD(luma, chroma, chromaNext, planes, width);
+
+	for( ; x < width; x++ )
+	{
+		const size_t cx = x & ~size_t(1);
+
+		uint32_t cb = chroma[cx];
+		uint32_t cr = chroma[cx + 1];
+
+		if( chromaNext != NULL )
+		{
+			cb = (cb + chromaNext[cx] + 1) >> 1;
+			cr = (cr + chromaNext[cx + 1] + 1) >> 1;
+		}
+
+		yuv10ToRGB(luma[x], cb, cr, planes[PLANE_R] + x, planes[PLANE_G] + x, planes[PLANE_B] + x);
+	}
+
+	memset(planes[PLANE_A], 255, width);
+}
+
+template<bool formatYV12>
+static void decodeI420( const uint8_t* input, size_t width, size_t height, size_t y, uint8_t** planes, bool simd )
+{
+	const size_t planeSize = width * height;
+
+	const uint8_t* yRow = input + y * width;
+	const uint8_t* uRow = input + planeSize + (formatYV12 ? planeSize / 4 : 0) + (y / 2) * (width / 2);
+	const uint8_t* vRow = input + planeSize + (formatYV12 ? 0 : planeSize / 4) + (y / 2) * (width / 2);
+
+	size_t x = 0;
+
+	if( simd )
+		x = decodeI420_SIMD(yRow, uRow, vRow, planes, width);
+
+	for( ; x < width; x++ )
+		yuv8ToRGB(yRow[x], uRow[x / 2], vRow[x / 2], planes[PLANE_R] + x, planes[PLANE_G] + x, planes[PLANE_B] + x);
+
+	memset(planes[PLANE_A], 255, width);
+}
+
+template<int l>
+static void decodeMacropixel( const uint8_t* input, size_t width, size_t height, size_t y, uint8_t** planes, bool simd )
+{
+	const cpuMacropixelLayout& layout = macropixelLayouts[l];
+	const uint8_t* row = input + y * width * 2;
+
+	size_t x = 0;
+
+	if( simd )
+		x = decodeMacropixel_SIMD(row, l, planes, width);
+
+	for( ; x < width; x++ )
+	{
+		const uint8_t* px = row + (x / 2) * 4;
+		yuv8ToRGB(px[(x & 1) ? layout.y1 : layout.y0], px[layout.u], px[layout.v], planes[PLANE_R] + x, planes[PLANE_G] + x, planes[PLANE_B] + x);
+	}
+
+	memset(planes[PLANE_A], 255, width);
+}
+
+
+//-----------------------------------------------------------------------------------
+// Encoders
+//-----------------------------------------------------------------------------------
+template<int l>
+static void encodePacked( uint8_t** planes, uint8_t* output, size_t width, size_t height, size_t y, bool simd )
+{
+	const cpuPackedLayout& layout = packedLayouts[l];
+	uint8_t* row = output + y * width * layout.channels;
+
+	uint8_t* channels[4];
+
+	for( int p=0; p < layout.channels; p++ )
+		channels[layout.index[p]] = planes[p];
+
+	size_t x = 0;
+
+	if( simd )
+		x = (layout.channels == 3) ? interleaveSIMD<3>(channels, row, width) : interleaveSIMD<4>(channels, row, width);
+
+	for( ; x < width; x++ )
+		for( int c=0; c < layout.channels; c++ )
+			row[x * layout.channels + c] = channels[c][x];
+}
+
+static void encodeGray( uint8_t** planes, uint8_t* output, size_t width, size_t height, size_t y, bool simd )
+{
+	uint8_t* row = output + y * width;
+
+	size_t x = 0;
+
+	if( simd )
+		x = encodeGray_SIMD(planes, row, width);
+
+	for( ; x < width; x++ )
+		row[x] = rgbToGray(planes[PLANE_R][x], planes[PLANE_G][x], planes[PLANE_B][x]);
+}
+
+// see RGBToYV12() from cudaYUV-YV12.cu -- the chroma is sampled from the bottom-right
+// pixel of each 2x2 block (the width and height of 4:2:0 images are always even).
+template<bool formatYV12>
+static void encodeI420( uint8_t** planes0, uint8_t** planes1, uint8_t* output, size_t width, size_t height, size_t y, bool simd )
+{
+	if( y + 1 >= height )
+		return;
+
+	const size_t planeSize = width * height;
+	const size_t evenWidth = width & ~size_t(1);
+
+	uint8_t* yRow0 = output + y * width;
+	uint8_t* yRow1 = yRow0 + width;
+	uint8_t* uRow  = output + planeSize + (formatYV12 ? planeSize / 4 : 0) + (y / 2) * (width / 2);
+	uint8_t* vRow  = output + planeSize + (formatYV12 ? 0 : planeSize / 4) + (y / 2) * (width / 2);
+
+	size_t x0 = 0;
+	size_t x1 = 0;
+
+	if( simd )
+	{
+		x0 = encodeLuma_SIMD(planes0, yRow0, evenWidth);
+		x1 = encodeLuma_SIMD(planes1, yRow1, evenWidth);
+	}
+
+	for( ; x0 < evenWidth; x0++ )
+		yRow0[x0] = rgbToY(planes0[PLANE_R][x0], planes0[PLANE_G][x0], planes0[PLANE_B][x0]);
+
+	for( ; x1 < evenWidth; x1++ )
+		yRow1[x1] = rgbToY(planes1[PLANE_R][x1], planes1[PLANE_G][x1], planes1[PLANE_B][x1]);
+
+	for( size_t x=1; x < evenWidth; x += 2 )
+		rgbToUV(planes1[PLANE_R][x], planes1[PLANE_G][x], planes1[PLANE_B][x], uRow + x / 2, vRow + x / 2);
+}
+
+
+//-----------------------------------------------------------------------------------
+// Conversion lookup
+//-----------------------------------------------------------------------------------
+static inline bool isYUV420( imageFormat format )
+{
+	return (format == IMAGE_NV12 || format == IMAGE_I420 || format == IMAGE_YV12);
+}
+
+static cpuDecodeRow findDecoder( imageFormat format )
+{
+	switch(format)
+	{
+		case IMAGE_RGB8:	return decodePacked<PACKED_RGB>;
+		case IMAGE_BGR8:	return decodePacked<PACKED_BGR>;
+		case IMAGE_RGBA8:	return decodePacked<PACKED_RGBA>;
+		case IMAGE_BGRA8:	return decodePacked<PACKED_BGRA>;
+		case IMAGE_GRAY8:	return decodeGray;
+		case IMAGE_NV12:	return decodeNV12;
+		case IMAGE_I420:	return decodeI420<false>;
+		case IMAGE_YV12:	return decodeI420<true>;
+		case IMAGE_YUYV:	return decodeMacropixel<MACROPIXEL_YUYV>;
+		case IMAGE_YVYU:	return decodeMacropixel<MACROPIXEL_YVYU>;
+		case IMAGE_UYVY:	return decodeMacropixel<MACROPIXEL_UYVY>;
+		default:			return NULL;
+	}
+}
+
+static cpuEncodeRow findEncoder( imageFormat format )
+{
+	switch(format)
+	{
+		case IMAGE_RGB8:	return encodePacked<PACKED_RGB>;
+		case IMAGE_BGR8:	return encodePacked<PACKED_BGR>;
+		case IMAGE_RGBA8:	return encodePacked<PACKED_RGBA>;
+		case IMAGE_BGRA8:	return encodePacked<PACKED_BGRA>;
+		case IMAGE_GRAY8:	return encodeGray;
+		default:			return NULL;
+	}
+}
+
+static cpuEncodeRowPair findEncoderPair( imageFormat format )
+{
+	switch(format)
+	{
+		case IMAGE_I420:	return encodeI420<false>;
+		case IMAGE_YV12:	return encodeI420<true>;
+		default:			return NULL;
+	}
+}
+
+
+// cpuConvertColorSupported
+bool cpuConvertColorSupported( imageFormat inputFormat, imageFormat outputFormat )
+{
+	if( !findDecoder(inputFormat) )
+		return false;
+
+	return (findEncoder(outputFormat) != NULL || findEncoderPair(outputFormat) != NULL);
+}
+
+
+//-----------------------------------------------------------------------------------
+// Row-parallel conversion
+//-----------------------------------------------------------------------------------
+struct cpuConvertJob
+{
+	const uint8_t* input;
+	uint8_t* output;
+
+	cpuDecodeRow decode;
+	cpuEncodeRow encode;
+	cpuEncodeRowPair encodePair;
+
+	size_t width;
+	size_t height;
+	size_t rowBegin;
+	size_t rowEnd;
+
+	bool simd;
+	bool result;
+};
+
+static void* convertRows( void* param )
+{
+	cpuConvertJob* job = (cpuConvertJob*)param;
+
+	// planar scratch rows, padded so each plane starts 64-byte aligned
+	const size_t pitch = (job->width + 63) & ~size_t(63);
+	uint8_t* scratch = NULL;
+
+	if( posix_memalign((void**)&scratch, 64, pitch * NUM_PLANES * 2) != 0 )
+	{
+		job->result = false;
+		return NULL;
+	}
+
+	uint8_t* planes0[NUM_PLANES];
+	uint8_t* planes1[NUM_PLANES];
+
+	for( int p=0; p < NUM_PLANES; p++ )
+	{
+		planes0[p] = scratch + pitch * p;
+		planes1[p] = scratch + pitch * (p + NUM_PLANES);
+	}
+
+	if( job->encodePair != NULL )
+	{
+		for( size_t y=job->rowBegin; y < job->rowEnd; y += 2 )
+		{
+			job->decode(job->input, job->width, job->height, y, planes0, job->simd);
+
+			if( y + 1 < job->rowEnd )
+				job->decode(job->input, job->width, job->height, y + 1, planes1, job->simd);
+
+			job->encodePair(planes0, planes1, job->output, job->width, job->height, y, job->simd);
+		}
+	}
+	else
+	{
+		for( size_t y=job->rowBegin; y < job->rowEnd; y++ )
+		{
+			job->decode(job->input, job->width, job->height, y, planes0, job->simd);
+			job->encode(planes0, job->output, job->width, job->height, y, job->simd);
+		}
+	}
+
+	free(scratch);
+	job->result = true;
+	return NULL;
+}
+
+
+//-----------------------------------------------------------------------------------
+// Worker threads
+//-----------------------------------------------------------------------------------
+struct cpuConvertWorker
+{
+	Thread thread;
+	Event  start;
+	Event  done;
+
+	cpuConvertJob* job;
+};
+
+static void* workerThread( void* param )
+{
+	cpuConvertWorker* worker = (cpuConvertWorker*)param;
+
+	while( true )
+	{
+		worker->start.Wait();
+		convertRows(worker->job);
+		worker->done.Wake();
+	}
+
+	return NULL;
+}
+
+// the workers are started the first time they're needed and then kept for the life of
+// the process (like the EventLoop threads), so a conversion only has to wake them up
+static Mutex gWorkerMutex;
+static std::vector<cpuConvertWorker*> gWorkers;
+
+// start up to numWorkers workers on the jobs (the caller must hold gWorkerMutex)
+static uint32_t startWorkers( cpuConvertJob* jobs, uint32_t numWorkers )
+{
+	while( gWorkers.size() < numWorkers )
+	{
+		cpuConvertWorker* worker = new cpuConvertWorker();
+
+		if( !worker->thread.Start(workerThread, worker) )
+		{
+			LogWarning(LOG_IMAGE "cpuConvertColor() -- failed to start worker thread, converting on the calling thread\n");
+			delete worker;
+			break;
+		}
+
+		gWorkers.push_back(worker);
+	}
+
+	if( numWorkers > gWorkers.size() )
+		numWorkers = gWorkers.size();
+
+	for( uint32_t n=0; n < numWorkers; n++ )
+	{
+		gWorkers[n]->job = &jobs[n];
+		gWorkers[n]->start.Wake();
+	}
+
+	return numWorkers;
+}
+
+
+// cpuConvertColor
+bool cpuConvertColor( const void* input, imageFormat inputFormat,
+				  void* output, imageFormat outputFormat,
+				  size_t width, size_t height, uint32_t numThreads )
+{
+	if( !input || !output || width == 0 || height == 0 )
+	{
+		LogError(LOG_IMAGE "cpuConvertColor() -- invalid parameters\n");
+		return false;
+	}
+
+	if( inputFormat == outputFormat && findDecoder(inputFormat) != NULL )
+	{
+		memcpy(output, input, imageFormatSize(inputFormat, width, height));
+		return true;
+	}
+
+	cpuConvertJob job;
+
+	job.input      = (const uint8_t*)input;
+	job.output     = (uint8_t*)output;
+	job.decode     = findDecoder(inputFormat);
+	job.encode     = findEncoder(outputFormat);
+	job.encodePair = findEncoderPair(outputFormat);
+	job.width      = width;
+	job.height     = height;
+	job.simd       = gSimdSupported && gSimdEnabled;
+	job.result     = false;
+
+	if( !job.decode || (!job.encode && !job.encodePair) )
+	{
+		LogError(LOG_IMAGE "cpuConvertColor() -- invalid input/output format combination (%s -> %s)\n", imageFormatToStr(inputFormat), imageFormatToStr(outputFormat));
+		return false;
+	}
+
+	if( (imageFormatIsYUV(inputFormat) || imageFormatIsYUV(outputFormat)) && (width % 2) != 0 )
+	{
+		LogError(LOG_IMAGE "cpuConvertColor() -- YUV formats require an even width (%zu)\n", width);
+		return false;
+	}
+
+	if( (isYUV420(inputFormat) || isYUV420(outputFormat)) && (height % 2) != 0 )
+	{
+		LogError(LOG_IMAGE "cpuConvertColor() -- 4:2:0 YUV formats require an even height (%zu)\n", height);
+		return false;
+	}
+
+	// pick the number of threads so that each gets a reasonable amount of work
+	if( numThreads == 0 )
+	{
+		const size_t minPixelsPerThread = 128 * 1024;
+		const long numCPU = sysconf(_SC_NPROCESSORS_ONLN);
+
+		numThreads = (width * height) / minPixelsPerThread;
+
+		if( numCPU > 0 && numThreads > (uint32_t)numCPU )
+			numThreads = numCPU;
+
+		if( numThreads > 8 )
+			numThreads = 8;
+	}
+
+	if( numThreads > height / 2 )
+		numThreads = height / 2;
+
+	if( numThreads < 1 )
+		numThreads = 1;
+
+	// split the rows on even boundaries, so 4:2:0 row pairs aren't divided between threads
+	const size_t rowsPerThread = ((height / numThreads) + 1) & ~size_t(1);
+
+	std::vector<cpuConvertJob> jobs(numThreads, job);
+
+	for( uint32_t n=0; n < numThreads; n++ )
+	{
+		jobs[n].rowBegin = n * rowsPerThread;
+		jobs[n].rowEnd   = (n + 1 == numThreads) ? height : (n + 1) * rowsPerThread;
+
+		if( jobs[n].rowBegin > height )
+			jobs[n].rowBegin = height;
+
+		if( jobs[n].rowEnd > height )
+			jobs[n].rowEnd = height;
+	}
+
+	// the calling thread converts the first block of rows, and the workers the rest.  If another
+	// thread is already using the workers, this one converts all of its rows instead of waiting.
+	const bool locked = (numThreads > 1) && gWorkerMutex.AttemptLock();
+	const uint32_t numWorkers = locked ? startWorkers(&jobs[1], numThreads - 1) : 0;
+
+	convertRows(&jobs[0]);
+
+	for( uint32_t n=numWorkers+1; n < numThreads; n++ )
+		convertRows(&jobs[n]);
+
+	for( uint32_t n=0; n < numWorkers; n++ )
+		gWorkers[n]->done.Wait();
+
+	if( locked )
+		gWorkerMutex.Unlock();
+
+	for( uint32_t n=0; n < numThreads; n++ )
+	{
+		if( !jobs[n].result )
+		{
+			LogError(LOG_IMAGE "cpuConvertColor() -- failed to allocate scratch memory\n");
+			return false;
+		}
+	}
+
+	return true;
+}
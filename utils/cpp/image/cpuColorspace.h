@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __CPU_COLORSPACE_H__
+#define __CPU_COLORSPACE_H__
+
+#include "imageFormat.h"
+
+
+/**
+ * Convert between two 8-bit image formats using the CPU.
+ *
+ * This is the host-side counterpart to cudaConvertColor(), for use on systems
+ * or in code paths where the image lives in regular CPU memory.  The math follows
+ * the CUDA kernels from cudaRGB.cu, cudaGrayscale.cu and cudaYUV-*.cu, so results
+ * match the GPU conversion (within 1 LSB where the GPU contracts to FMA).
+ *
+ * Supported input formats are RGB8, BGR8, RGBA8, BGRA8, GRAY8, NV12, I420, YV12,
+ * YUYV, YVYU and UYVY.  Supported output formats are RGB8, BGR8, RGBA8, BGRA8,
+ * GRAY8, I420 and YV12.  Floating-point formats are not supported.
+ *
+ * YUV formats require an even width, and the 4:2:0 formats (NV12, I420 and YV12)
+ * also require an even height.
+ *
+ * The rows of the image are split between worker threads, and each row is
+ * processed with AVX2 (x86_64) or NEON (aarch64) kernels when the CPU supports them.
+ * The SIMD instruction set is detected at runtime, see cpuColorspaceSIMD().
+ * The worker threads are started the first time they're needed and reused for
+ * later conversions.  If another thread is already converting with them, the rows
+ * are converted on the calling thread instead.
+ *
+ * @param input pointer to the input image in CPU memory
+ * @param inputFormat format enum of the input image
+ * @param output pointer to the output image in CPU memory
+ * @param outputFormat format enum of the output image
+ * @param width width of the input and output images (in pixels)
+ * @param height height of the input and output images (in pixels)
+ * @param numThreads the number of threads to split the rows between.  The default
+ *                   of 0 picks the number of threads based on the image size and
+ *                   the number of CPU cores.  Use 1 to convert on the calling thread.
+ * @returns true on success, false if the conversion is unsupported or the arguments are invalid.
+ * @ingroup colorspace
+ */
+bool cpuConvertColor( const void* input, imageFormat inputFormat,
+				  void* output, imageFormat outputFormat,
+				  size_t width, size_t height, uint32_t numThreads=0 );
+
+/**
+ * Check if cpuConvertColor() supports converting between two formats.
+ * @ingroup colorspace
+ */
+bool cpuConvertColorSupported( imageFormat inputFormat, imageFormat outputFormat );
+
+/**
+ * Return the SIMD instruction set used by cpuConvertColor() on this CPU.
+ * @returns `"AVX2"`, `"NEON"`, or `"none"` if the scalar path is being used.
+ * @ingroup colorspace
+ */
+const char* cpuColorspaceSIMD();
+
+/**
+ * Enable or disable the SIMD kernels used by cpuConvertColor().
+ * Disabling them forces the scalar reference path, which is useful for
+ * validating the SIMD kernels against it.  SIMD is enabled by default.
+ * @ingroup colorspace
+ */
+void cpuColorspaceEnableSIMD( bool enable );
+
+#endif
@@ -136,6 +136,66 @@ static StbBuffer loadImageIO( const char* filename, int* width, int* height, int
 }
 
 
+// convertImageIO (internal)
+// if staging is NULL, a temporary uint8 buffer is allocated for float conversions,
+// otherwise the staging buffer is reused (and grown if the image doesn't fit)
+static bool convertImageIO( const char* filename, unsigned char* img, int imgWidth, int imgHeight, int imgChannels, void* output, imageFormat format,
+					   void** staging, size_t* stagingSize, cudaStream_t stream )
+{
+	// convert from uint8 to float
+	if( format == IMAGE_RGB32F || format == IMAGE_RGBA32F )
+	{
+		const imageFormat inputFormat = (imgChannels == 3) ? IMAGE_RGB8 : IMAGE_RGBA8;
+		const size_t inputImageSize = imageFormatSize(inputFormat, imgWidth, imgHeight);
+
+		void* inputImgGPU = (staging != NULL) ? *staging : NULL;
+
+		if( staging == NULL || *staging == NULL || *stagingSize < inputImageSize )
+		{
+			if( staging != NULL )
+			{
+				CUDA_FREE_HOST(*staging);
+				*stagingSize = 0;
+			}
+
+			if( !cudaAllocMapped(&inputImgGPU, inputImageSize) )
+			{
+				LogError(LOG_IMAGE "loadImage() -- failed to allocate %zu bytes for image '%s'\n", inputImageSize, filename);
+				return false;
+			}
+
+			if( staging != NULL )
+			{
+				*staging = inputImgGPU;
+				*stagingSize = inputImageSize;
+			}
+		}
+
+		memcpy(inputImgGPU, img, inputImageSize);
+
+		const bool result = CUDA_SUCCESS(cudaConvertColor(inputImgGPU, inputFormat, output, format, imgWidth, imgHeight, stream));
+
+		if( !result )
+			printf(LOG_IMAGE "loadImage() -- failed to convert image from %s to %s ('%s')\n", imageFormatToStr(inputFormat), imageFormatToStr(format), filename);
+
+		if( staging != NULL )
+			CUDA(cudaStreamSynchronize(stream));	// the staging buffer gets overwritten by the next image
+		else
+			CUDA(cudaFreeHost(inputImgGPU));
+
+		if( !result )
+			return false;
+	}
+	else
+	{
+		// uint8 output can be straight copied to GPU memory
+		memcpy(output, img, imageFormatSize(format, imgWidth, imgHeight));
+	}
+
+	return true;
+}
+
+
 // loadImage
 bool loadImage( const char* filename, void** output, int* width, int* height, imageFormat format, cudaStream_t stream )
 {
@@ -189,39 +249,98 @@ bool loadImage( const char* filename, void** output, int* width, int* height, im
 	// 	VALGRIND_MALLOCLIKE_BLOCK(*output, imgSize, 0, 1);
 	// }
 
-	// convert from uint8 to float
-	if( format == IMAGE_RGB32F || format == IMAGE_RGBA32F )
+	if( !convertImageIO(filename, img.get(), imgWidth, imgHeight, imgChannels, *output, format, NULL, NULL, stream) )
+		return false;
+
+	*width  = imgWidth;
+	*height = imgHeight;
+	
+	return true;
+}
+
+
+// loadImageBuffer
+bool loadImageBuffer( const char* filename, void** output, size_t* outputSize, int* width, int* height, imageFormat format, cudaStream_t stream )
+{
+	return loadImageBuffer(filename, output, outputSize, NULL, NULL, width, height, format, stream);
+}
+
+
+// loadImageBuffer
+bool loadImageBuffer( const char* filename, void** output, size_t* outputSize, void** staging, size_t* stagingSize, int* width, int* height, imageFormat format, cudaStream_t stream )
+{
+	// validate parameters
+	if( !filename || !output || !outputSize || !width || !height || (staging != NULL && !stagingSize) )
 	{
-		const imageFormat inputFormat = (imgChannels == 3) ? IMAGE_RGB8 : IMAGE_RGBA8;
-		const size_t inputImageSize = imageFormatSize(inputFormat, imgWidth, imgHeight);
+		LogError(LOG_IMAGE "loadImageBuffer() - invalid parameter(s)\n");
+		return false;
+	}
 
-		void* inputImgGPU = NULL;
+	if( !imageFormatIsRGB(format) )
+	{
+		LogError(LOG_IMAGE "loadImageBuffer() -- unsupported output image format requested (%s)\n", imageFormatToStr(format));
+		return false;
+	}
 
-		if( !cudaAllocMapped(&inputImgGPU, inputImageSize) )
-		{
-			LogError(LOG_IMAGE "loadImage() -- failed to allocate %zu bytes for image '%s'\n", inputImageSize, filename);
-			return false;
-		}
+	// attempt to load the data from disk
+	int imgWidth = *width;
+	int imgHeight = *height;
+	int imgChannels = imageFormatChannels(format);
 
-		memcpy(inputImgGPU, img.get(), imageFormatSize(inputFormat, imgWidth, imgHeight));
+	auto img = loadImageIO(filename, &imgWidth, &imgHeight, &imgChannels);
+	
+	if( !img )
+		return false;
+
+	// only (re)allocate the buffer if the image doesn't fit in it already
+	const size_t imgSize = imageFormatSize(format, imgWidth, imgHeight);
 
-		if( CUDA_FAILED(cudaConvertColor(inputImgGPU, inputFormat, *output, format, imgWidth, imgHeight, stream)) )
+	if( *output == NULL || *outputSize < imgSize )
+	{
+		LogVerbose(LOG_IMAGE "loadImageBuffer() -- growing buffer from %zu to %zu bytes for '%s'\n", *outputSize, imgSize, filename);
+
+		CUDA_FREE(*output);
+		*outputSize = 0;
+
+		if( CUDA_FAILED(cudaMallocManaged(output, imgSize)) )
 		{
-			printf(LOG_IMAGE "loadImage() -- failed to convert image from %s to %s ('%s')\n", imageFormatToStr(inputFormat), imageFormatToStr(format), filename);
+			LogError(LOG_IMAGE "loadImageBuffer() -- failed to allocate %zu bytes for image '%s'\n", imgSize, filename);
+			*output = NULL;
 			return false;
 		}
 
-		CUDA(cudaFreeHost(inputImgGPU));
-	}
-	else
-	{
-		// uint8 output can be straight copied to GPU memory
-		memcpy(*output, img.get(), imgSize);
+		*outputSize = imgSize;
 	}
 
+	if( !convertImageIO(filename, img.get(), imgWidth, imgHeight, imgChannels, *output, format, staging, stagingSize, stream) )
+		return false;
+
 	*width  = imgWidth;
 	*height = imgHeight;
-	
+
+	return true;
+}
+
+
+// loadImageInfo
+bool loadImageInfo( const char* filename, int* width, int* height, int* channels )
+{
+	if( !filename || !width || !height )
+		return false;
+
+	const std::string path = locateFile(filename);
+
+	if( path.length() == 0 )
+		return false;
+
+	int imgChannels = 0;
+
+	if( !stbi_info(path.c_str(), width, height, &imgChannels) )
+		return false;
+
+	if( channels != NULL )
+		*channels = imgChannels;
+
 	return true;
 }
 
@@ -92,6 +92,53 @@ template<typename T> bool loadImage( const char* filename, T** ptr, int* width,
  */
 bool loadImage( const char* filename, void** output, int* width, int* height, imageFormat format, cudaStream_t stream=0 );
 
+/**
+ * Load a color image from disk into a buffer that is reused between calls,
+ * instead of allocating a new buffer for every image like loadImage() does.
+ *
+ * If `*output` is NULL or smaller than the decoded image, it is freed and
+ * re-allocated in shared CPU/GPU memory and `*outputSize` is updated.
+ * The buffer should later be released with cudaFree().
+ *
+ * @param[in] filename Path to the image file to load from disk.
+ * @param[in,out] output Reference to the pointer of the reusable shared CPU/GPU buffer.
+ * @param[in,out] outputSize Reference to the size of the buffer (in bytes).
+ * @param[in,out] width @see loadImage()
+ * @param[in,out] height @see loadImage()
+ * @param stream[in] Optional CUDA stream to queue operations on.
+ * @ingroup image
+ */
+bool loadImageBuffer( const char* filename, void** output, size_t* outputSize, int* width, int* height, imageFormat format, cudaStream_t stream=0 );
+
+/**
+ * Load a color image from disk into a buffer that is reused between calls,
+ * with a reusable staging buffer for the conversion to float formats.
+ *
+ * For IMAGE_RGB32F and IMAGE_RGBA32F, the image is decoded as uint8 into the
+ * staging buffer before it's converted on the GPU.  If `*staging` is NULL or
+ * too small, it is freed and re-allocated with cudaAllocMapped() and
+ * `*stagingSize` is updated (otherwise it's left alone).  Since the staging
+ * buffer is reused, this waits for the conversion to finish on the stream.
+ * The staging buffer should later be released with cudaFreeHost().
+ *
+ * @param[in,out] staging Reference to the pointer of the reusable staging buffer.
+ * @param[in,out] stagingSize Reference to the size of the staging buffer (in bytes).
+ * @see loadImageBuffer() for the other parameters.
+ * @ingroup image
+ */
+bool loadImageBuffer( const char* filename, void** output, size_t* outputSize, void** staging, size_t* stagingSize, int* width, int* height, imageFormat format, cudaStream_t stream=0 );
+
+/**
+ * Read the dimensions of an image from its file header, without decoding the image.
+ * @param[in] filename Path to the image file on disk.
+ * @param[out] width Set to the width of the image in pixels.
+ * @param[out] height Set to the height of the image in pixels.
+ * @param[out] channels Optional pointer that is set to the number of color channels in the file.
+ * @returns true if the header was parsed successfully, otherwise false.
+ * @ingroup image
+ */
+bool loadImageInfo( const char* filename, int* width, int* height, int* channels=NULL );
+
 /**
  * Load a color image from disk into CUDA memory with alpha, in float4 RGBA format with pixel values 0-255.
  * @see loadImage() for more details about parameters and supported image formats.
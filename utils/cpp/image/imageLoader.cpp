@@ -30,6 +30,9 @@
 #include <valgrind/memcheck.h>
 
 #include <strings.h>
+#include <unistd.h>
+
+#include <algorithm>
 
 
 // supported image file extensions
@@ -62,12 +65,20 @@ bool imageLoader::IsSupportedExtension( const char* ext )
 
 
 // constructor
-imageLoader::imageLoader( const videoOptions& options ) : videoSource(options)
+imageLoader::imageLoader( const videoOptions& options ) : videoSource(options), mDecodedEvent(true), mFreedEvent(true)
 {
 	mEOS = false;
+	mLoopCount = 0;
 	mNextFile = 0;
 
-	mBuffers.reserve(options.numBuffers);
+	mReadSeq = 0;
+	mDecodeSeq = 0;
+	mEndSeq = 0;
+
+	mFormat = IMAGE_UNKNOWN;
+	mMaxWidth = 0;
+	mMaxHeight = 0;
+	mStopWorkers = false;
 
 	// list files to use
 	std::vector<std::string> files;
@@ -95,24 +106,39 @@ imageLoader::imageLoader( const videoOptions& options ) : videoSource(options)
 		LogError(LOG_IMAGE "imageLoader -- failed to find any image files under '%s'\n", options.resource.location.c_str());
 		return;
 	}
-}
 
+	// the last frame is the end of the final loop
+	if( mOptions.loop < 0 )
+		mEndSeq = UINT64_MAX;
+	else
+		mEndSeq = mFiles.size() * (uint64_t)(mOptions.loop + 1);
 
-// destructor
-imageLoader::~imageLoader()
-{
-	const size_t numBuffers = mBuffers.size();
+	// when prefetching, size the frame pool for the largest image up-front
+	// (this only parses the file headers, the images aren't decoded here)
+	if( mOptions.prefetch > 0 )
+	{
+		for( size_t n=0; n < mFiles.size(); n++ )
+		{
+			int width = 0;
+			int height = 0;
 
-	for( size_t n=0; n < numBuffers; n++ ) {
-		CUDA_FREE(mBuffers[n]);
-		// if (RUNNING_ON_VALGRIND) {
-		// 	VALGRIND_FREELIKE_BLOCK(mBuffers[n], 0);
-		// }
+			if( !loadImageInfo(mFiles[n].c_str(), &width, &height) )
+				continue;
 
-		// CUDA(cudaFree(mBuffers[n]));
+			mMaxWidth = std::max(mMaxWidth, width);
+			mMaxHeight = std::max(mMaxHeight, height);
+		}
+
+		LogVerbose(LOG_IMAGE "imageLoader -- prefetching %u images ahead (max size %ix%i)\n", mOptions.prefetch, mMaxWidth, mMaxHeight);
 	}
+}
+
 
-	mBuffers.clear();
+// destructor
+imageLoader::~imageLoader()
+{
+	stopWorkers();
+	freeSlots();
 }
 
 
@@ -140,6 +166,194 @@ imageLoader* imageLoader::Create( const char* resource, const videoOptions& opti
 }
 
 
+// allocSlots
+bool imageLoader::allocSlots( imageFormat format )
+{
+	// numBuffers frames stay valid for the user, the rest are decoded ahead
+	const size_t numSlots = std::max<uint32_t>(mOptions.numBuffers, 1) + mOptions.prefetch;
+	const size_t slotSize = imageFormatSize(format, mMaxWidth, mMaxHeight);
+
+	if( mSlots.size() != numSlots )
+	{
+		freeSlots();
+		mSlots.resize(numSlots);
+
+		for( size_t n=0; n < numSlots; n++ )
+		{
+			mSlots[n].buffer = NULL;
+			mSlots[n].size = 0;
+			mSlots[n].staging = NULL;
+			mSlots[n].stagingSize = 0;
+		}
+	}
+
+	for( size_t n=0; n < numSlots; n++ )
+	{
+		Slot& slot = mSlots[n];
+
+		slot.sequence = UINT64_MAX;
+		slot.width = 0;
+		slot.height = 0;
+		slot.state = SLOT_EMPTY;
+
+		// if the max size is unknown, loadImageBuffer() will allocate on first use
+		if( slotSize == 0 || slot.size >= slotSize )
+			continue;
+
+		CUDA_FREE(slot.buffer);
+		slot.size = 0;
+
+		if( CUDA_FAILED(cudaMallocManaged(&slot.buffer, slotSize)) )
+		{
+			LogError(LOG_IMAGE "imageLoader -- failed to allocate %zu bytes for frame buffer\n", slotSize);
+			slot.buffer = NULL;
+			return false;
+		}
+
+		slot.size = slotSize;
+	}
+
+	return true;
+}
+
+
+// freeSlots
+void imageLoader::freeSlots()
+{
+	const size_t numSlots = mSlots.size();
+
+	for( size_t n=0; n < numSlots; n++ )
+	{
+		CUDA_FREE(mSlots[n].buffer);
+		CUDA_FREE_HOST(mSlots[n].staging);
+	}
+
+	mSlots.clear();
+}
+
+
+// decodeSlot
+bool imageLoader::decodeSlot( Slot* slot, uint64_t sequence )
+{
+	const std::string& file = mFiles[sequence % mFiles.size()];
+
+	slot->width = 0;
+	slot->height = 0;
+
+	if( !loadImageBuffer(file.c_str(), &slot->buffer, &slot->size, &slot->staging, &slot->stagingSize, &slot->width, &slot->height, mFormat) )
+	{
+		LogError(LOG_IMAGE "imageLoader -- failed to load '%s'\n", file.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+
+// workerThread
+void* imageLoader::workerThread( void* user_param )
+{
+	imageLoader* loader = (imageLoader*)user_param;
+	
+	const uint64_t numSlots = loader->mSlots.size();
+	const uint64_t prefetch = loader->mOptions.prefetch;
+
+	loader->mMutex.Lock();
+
+	while( !loader->mStopWorkers )
+	{
+		const uint64_t seq = loader->mDecodeSeq;
+
+		// the slot for this frame is free once the frame numSlots before it
+		// has dropped out of the user's numBuffers window
+		if( seq >= loader->mEndSeq || seq >= loader->mReadSeq + prefetch )
+		{
+			loader->mMutex.Unlock();
+			loader->mFreedEvent.Wait(100);
+			loader->mMutex.Lock();
+			continue;
+		}
+
+		Slot* slot = &loader->mSlots[seq % numSlots];
+
+		slot->sequence = seq;
+		slot->state = SLOT_DECODING;
+
+		loader->mDecodeSeq++;
+
+		// events only wake one thread, so pass it on if there's more work
+		if( loader->mDecodeSeq < loader->mEndSeq && loader->mDecodeSeq < loader->mReadSeq + prefetch )
+			loader->mFreedEvent.Wake();
+
+		loader->mMutex.Unlock();
+		const bool result = loader->decodeSlot(slot, seq);
+		loader->mMutex.Lock();
+
+		slot->state = result ? SLOT_READY : SLOT_FAILED;
+		loader->mDecodedEvent.Wake();
+	}
+
+	loader->mMutex.Unlock();
+	loader->mFreedEvent.Wake();	// let the other workers see the stop flag
+
+	return NULL;
+}
+
+
+// startWorkers
+bool imageLoader::startWorkers()
+{
+	if( mOptions.prefetch == 0 || mWorkers.size() > 0 )
+		return true;
+
+	// I/O and decoding are split over a few threads, but no more than the prefetch depth
+	const uint32_t numCPU = sysconf(_SC_NPROCESSORS_ONLN);
+	const uint32_t numWorkers = std::max(1u, std::min(mOptions.prefetch, std::min(numCPU / 2, 4u)));
+
+	mStopWorkers = false;
+
+	for( uint32_t n=0; n < numWorkers; n++ )
+	{
+		Thread* thread = new Thread();
+
+		if( !thread->Start(workerThread, this) )
+		{
+			LogError(LOG_IMAGE "imageLoader -- failed to start prefetch worker thread\n");
+			delete thread;
+			stopWorkers();
+			return false;
+		}
+
+		mWorkers.push_back(thread);
+	}
+
+	LogVerbose(LOG_IMAGE "imageLoader -- started %u prefetch worker threads\n", numWorkers);
+	return true;
+}
+
+
+// stopWorkers
+void imageLoader::stopWorkers()
+{
+	if( mWorkers.size() == 0 )
+		return;
+
+	mMutex.Lock();
+	mStopWorkers = true;
+	mMutex.Unlock();
+
+	mFreedEvent.Wake();
+
+	for( size_t n=0; n < mWorkers.size(); n++ )
+	{
+		mWorkers[n]->Stop(true);
+		delete mWorkers[n];
+	}
+
+	mWorkers.clear();
+}
+
+
 #define RETURN_STATUS(code)  { if( status != NULL ) { *status=(code); } return ((code) == videoSource::OK ? true : false); }
 
 
@@ -157,55 +371,92 @@ bool imageLoader::Capture( void** output, imageFormat format, uint64_t timeout,
 			RETURN_STATUS(EOS);
 	}
 
-	// reclaim old buffers
-	if( mBuffers.size() >= mOptions.numBuffers )
-	{	
-		// if (RUNNING_ON_VALGRIND) {
-		// 	VALGRIND_FREELIKE_BLOCK(mBuffers[0], 0);
-		// }
+	// (re)start decoding if this is the first frame or the format has changed
+	if( format != mFormat )
+	{
+		stopWorkers();
+
+		mFormat = format;
+		mDecodeSeq = mReadSeq;
 
-		CUDA(cudaFree(mBuffers[0]));
-		mBuffers.erase(mBuffers.begin());
+		if( !allocSlots(format) || !startWorkers() )
+			RETURN_STATUS(ERROR);
 	}
 
-	// get the next file to load
-	const size_t currFile = mNextFile;
-	mNextFile++;
-	
-	if( mNextFile >= mFiles.size() )
+	const double deadline = timeDouble() + timeout;
+	size_t numFailures = 0;
+
+	// skip over images that fail to load, until one succeeds
+	while( mReadSeq < mEndSeq )
 	{
-		if( isLooping() )
+		Slot* slot = &mSlots[mReadSeq % mSlots.size()];
+
+		if( mWorkers.size() == 0 )
 		{
-			mNextFile = 0;
-			mLoopCount++;
+			slot->sequence = mReadSeq;
+			slot->state = decodeSlot(slot, mReadSeq) ? SLOT_READY : SLOT_FAILED;
 		}
 		else
+		{
+			mMutex.Lock();
+
+			while( slot->sequence != mReadSeq || (slot->state != SLOT_READY && slot->state != SLOT_FAILED) )
+			{
+				mMutex.Unlock();
+
+				const double remaining = deadline - timeDouble();
+
+				if( timeout != UINT64_MAX && remaining <= 0.0 )
+					RETURN_STATUS(TIMEOUT);
+
+				mDecodedEvent.Wait((timeout == UINT64_MAX) ? 100 : std::min<uint64_t>(remaining + 1, 100));
+				mMutex.Lock();
+			}
+
+			mMutex.Unlock();
+		}
+
+		// advancing the read position frees the oldest slot for the workers
+		mMutex.Lock();
+		const uint64_t currSeq = mReadSeq++;
+		mMutex.Unlock();
+
+		mFreedEvent.Wake();
+
+		mNextFile = mReadSeq % mFiles.size();
+		mLoopCount = mReadSeq / mFiles.size();
+
+		if( mReadSeq >= mEndSeq )
 		{
 			mEOS = true;
 			mStreaming = false;
 		}
-	}
 
-	// load the next image
-	void* imgPtr  = NULL;
-	int imgWidth  = 0;
-	int imgHeight = 0;
+		if( slot->state == SLOT_FAILED )
+		{
+			if( ++numFailures >= mFiles.size() )
+			{
+				LogError(LOG_IMAGE "imageLoader -- failed to load any of the images\n");
+				RETURN_STATUS(ERROR);
+			}
+
+			continue;
+		}
 
-	if( !loadImage(mFiles[currFile].c_str(), &imgPtr, &imgWidth, &imgHeight, format) )
-	{
-		LogError(LOG_IMAGE "imageLoader -- failed to load '%s'\n", mFiles[currFile].c_str());
-		return Capture(output, format, timeout, status, stream);
-	}
+		LogDebug(LOG_IMAGE "imageLoader -- frame %lu from '%s'\n", currSeq, mFiles[currSeq % mFiles.size()].c_str());
 
-	// set outputs
-	mOptions.width = imgWidth;
-	mOptions.height = imgHeight;
+		// set outputs
+		mOptions.width = slot->width;
+		mOptions.height = slot->height;
 
-	*output = imgPtr;
+		*output = slot->buffer;
+		RETURN_STATUS(OK);
+	}
 
-	mBuffers.push_back(imgPtr);
+	mEOS = true;
+	mStreaming = false;
 
-	RETURN_STATUS(OK);
+	RETURN_STATUS(EOS);
 }
 
 
@@ -228,5 +479,3 @@ void imageLoader::Close()
 {
 	mStreaming = false;
 }
-
-
@@ -26,6 +26,10 @@
 
 #include "videoSource.h"
 
+#include "Thread.h"
+#include "Mutex.h"
+#include "Event.h"
+
 #include <string>
 #include <vector>
 
@@ -42,6 +46,11 @@
  * When given just the path to a directory, it will load all valid images from
  * that directory.
  *
+ * Decoded frames are kept in a fixed pool of recycled buffers.  If prefetching
+ * is enabled with `--input-prefetch=N` (see videoOptions::prefetch), a pool of
+ * worker threads decodes the next N files ahead of Capture(), and the buffers
+ * are pre-allocated to the size of the largest image in the sequence.
+ *
  * @note imageLoader implements the videoSource interface and is intended to
  * be used through that as opposed to directly.  videoSource implements
  * additional command-line parsing of videoOptions to construct instances.
@@ -133,12 +142,61 @@ protected:
 
 	inline bool isLooping() const { return (mOptions.loop < 0) || ((mOptions.loop > 0) && (mLoopCount < mOptions.loop)); }
 
+	/**
+	 * Decoding state of a buffer in the frame pool.
+	 */
+	enum SlotState
+	{
+		SLOT_EMPTY = 0,
+		SLOT_DECODING,
+		SLOT_READY,
+		SLOT_FAILED
+	};
+
+	/**
+	 * A recycled frame buffer.  The frame with sequence number N is decoded into
+	 * slot N % mSlots.size(), and stays valid until numBuffers more frames are captured.
+	 */
+	struct Slot
+	{
+		void*     buffer;
+		size_t    size;
+		void*     staging;		// uint8 image for float formats (see loadImageBuffer())
+		size_t    stagingSize;
+		uint64_t  sequence;
+		int       width;
+		int       height;
+		SlotState state;
+	};
+
+	bool allocSlots( imageFormat format );
+	void freeSlots();
+	bool decodeSlot( Slot* slot, uint64_t sequence );
+	bool startWorkers();
+	void stopWorkers();
+
+	static void* workerThread( void* user_param );
+
 	bool mEOS;
 	size_t mLoopCount;
 	size_t mNextFile;
 	
 	std::vector<std::string> mFiles;
-	std::vector<void*> mBuffers;
+	std::vector<Slot> mSlots;
+	std::vector<Thread*> mWorkers;
+
+	uint64_t mReadSeq;		// sequence number of the next frame returned by Capture()
+	uint64_t mDecodeSeq;	// sequence number of the next frame to be decoded by the workers
+	uint64_t mEndSeq;		// one past the last frame in the sequence (UINT64_MAX if looping forever)
+
+	imageFormat mFormat;
+	int  mMaxWidth;
+	int  mMaxHeight;
+	bool mStopWorkers;
+
+	Mutex mMutex;
+	Event mDecodedEvent;
+	Event mFreedEvent;
 };
 
 #endif
@@ -0,0 +1,408 @@
+/*
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "EventLoop.h"
+
+#include "Thread.h"
+#include "Mutex.h"
+#include "Event.h"
+#include "commandLine.h"
+#include "logging.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+// the event loops (started on the first Acquire, and kept for the lifetime of the process)
+static std::vector<EventLoop*> gEventLoops;
+static Mutex gEventLoopMutex;
+
+// configuration applied when the loops are started
+static uint32_t gEventLoopThreads = 1;
+static std::vector<int> gEventLoopCPUs;
+
+
+// parseCPUs
+static bool parseCPUs( const char* str, std::vector<int>& cpus )
+{
+	cpus.clear();
+
+	if( !str || strlen(str) == 0 )
+		return true;
+
+	const int numCPUs = sysconf(_SC_NPROCESSORS_CONF);
+	const char* ptr = str;
+
+	while( *ptr != '\0' )
+	{
+		char* end = NULL;
+		const long first = strtol(ptr, &end, 10);
+
+		if( end == ptr )
+			return false;
+
+		long last = first;
+		ptr = end;
+
+		if( *ptr == '-' )
+		{
+			last = strtol(ptr + 1, &end, 10);
+
+			if( end == ptr + 1 )
+				return false;
+
+			ptr = end;
+		}
+
+		if( first < 0 || last < first || last >= numCPUs || last >= CPU_SETSIZE )
+			return false;
+
+		for( long n=first; n <= last; n++ )
+			cpus.push_back(n);
+
+		if( *ptr == ',' )
+			ptr++;
+		else if( *ptr != '\0' )
+			return false;
+	}
+
+	return true;
+}
+
+
+// Configure
+bool EventLoop::Configure( uint32_t numThreads, const char* cpus )
+{
+	std::vector<int> cpuList;
+
+	if( !parseCPUs(cpus, cpuList) )
+	{
+		LogError(LOG_EVENT_LOOP "invalid list of CPU cores '%s'\n", cpus);
+		return false;
+	}
+
+	gEventLoopMutex.Lock();
+
+	if( gEventLoops.size() > 0 )
+	{
+		gEventLoopMutex.Unlock();
+		LogWarning(LOG_EVENT_LOOP "the event loops are already running, the new configuration will be ignored\n");
+		return false;
+	}
+
+	gEventLoopThreads = (numThreads > 0) ? numThreads : 1;
+	gEventLoopCPUs = cpuList;
+
+	gEventLoopMutex.Unlock();
+	return true;
+}
+
+
+// Configure
+bool EventLoop::Configure( const commandLine& cmdLine )
+{
+	return Configure(cmdLine.GetUnsignedInt("event-threads", gEventLoopThreads), cmdLine.GetString("event-cpus"));
+}
+
+
+// GetNumThreads
+uint32_t EventLoop::GetNumThreads()
+{
+	gEventLoopMutex.Lock();
+	const uint32_t numThreads = (gEventLoops.size() > 0) ? gEventLoops.size() : gEventLoopThreads;
+	gEventLoopMutex.Unlock();
+	return numThreads;
+}
+
+
+// constructor
+EventLoop::EventLoop( uint32_t index )
+{
+	mContext  = NULL;
+	mMainLoop = NULL;
+	mThread   = new Thread();
+	mIndex    = index;
+	mRefCount = 0;
+	mRunning  = false;
+}
+
+
+// destructor
+EventLoop::~EventLoop()
+{
+	if( mRunning )
+	{
+		g_main_loop_quit(mMainLoop);
+		mThread->Stop(true);
+	}
+
+	if( mMainLoop != NULL )
+	{
+		g_main_loop_unref(mMainLoop);
+		mMainLoop = NULL;
+	}
+
+	if( mContext != NULL )
+	{
+		g_main_context_unref(mContext);
+		mContext = NULL;
+	}
+
+	delete mThread;
+}
+
+
+// Acquire
+EventLoop* EventLoop::Acquire()
+{
+	gEventLoopMutex.Lock();
+
+	// start the loops the first time
+	if( gEventLoops.size() == 0 )
+	{
+		for( uint32_t n=0; n < gEventLoopThreads; n++ )
+		{
+			EventLoop* loop = new EventLoop(n);
+
+			if( !loop->init() )
+			{
+				LogError(LOG_EVENT_LOOP "failed to start event loop thread %u\n", n);
+				delete loop;
+				break;
+			}
+
+			gEventLoops.push_back(loop);
+		}
+
+		if( gEventLoops.size() == 0 )
+		{
+			gEventLoopMutex.Unlock();
+			return NULL;
+		}
+
+		LogVerbose(LOG_EVENT_LOOP "started %zu event loop thread(s)\n", gEventLoops.size());
+	}
+
+	// pick the loop with the fewest users
+	EventLoop* loop = gEventLoops[0];
+
+	for( size_t n=1; n < gEventLoops.size(); n++ )
+	{
+		if( gEventLoops[n]->mRefCount < loop->mRefCount )
+			loop = gEventLoops[n];
+	}
+
+	loop->mRefCount++;
+
+	gEventLoopMutex.Unlock();
+	return loop;
+}
+
+
+// Release
+void EventLoop::Release()
+{
+	gEventLoopMutex.Lock();
+
+	if( mRefCount > 0 )
+		mRefCount--;
+
+	gEventLoopMutex.Unlock();
+}
+
+
+// init
+bool EventLoop::init()
+{
+	mContext = g_main_context_new();
+
+	if( !mContext )
+	{
+		LogError(LOG_EVENT_LOOP "failed to create GMainContext\n");
+		return false;
+	}
+
+	mMainLoop = g_main_loop_new(mContext, false);
+
+	if( !mMainLoop )
+	{
+		LogError(LOG_EVENT_LOOP "failed to create GMainLoop\n");
+		return false;
+	}
+
+	if( !mThread->Start(runThread, this) )
+	{
+		LogError(LOG_EVENT_LOOP "failed to start event loop thread\n");
+		return false;
+	}
+
+	// wait for the loop to start running
+	for( uint32_t n=0; n < 100 && !g_main_loop_is_running(mMainLoop); n++ )
+		usleep(1000);
+
+	return true;
+}
+
+
+// runThread
+void* EventLoop::runThread( void* user_data )
+{
+	EventLoop* loop = (EventLoop*)user_data;
+
+	if( !loop )
+		return 0;
+
+	// restrict the thread to the requested CPU cores
+	if( gEventLoopCPUs.size() > 0 )
+	{
+		cpu_set_t cpu_set;
+		CPU_ZERO(&cpu_set);
+
+		for( size_t n=0; n < gEventLoopCPUs.size(); n++ )
+			CPU_SET(gEventLoopCPUs[n], &cpu_set);
+
+		const int result = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set);
+
+		if( result != 0 )
+			LogWarning(LOG_EVENT_LOOP "failed to set the CPU affinity of event loop thread %u (error=%i)\n", loop->mIndex, result);
+	}
+
+	// sources created from this thread (for example by libsoup) attach to the loop's context
+	g_main_context_push_thread_default(loop->mContext);
+
+	loop->mRunning = true;
+	g_main_loop_run(loop->mMainLoop);
+	loop->mRunning = false;
+
+	g_main_context_pop_thread_default(loop->mContext);
+
+	LogVerbose(LOG_EVENT_LOOP "event loop thread %u stopped\n", loop->mIndex);
+	return 0;
+}
+
+
+// IsCurrentThread
+bool EventLoop::IsCurrentThread() const
+{
+	return g_main_context_is_owner(mContext);
+}
+
+
+// InvokeContext
+struct InvokeContext
+{
+	GSourceFunc callback;
+	void* user_data;
+	Event event;
+};
+
+
+// invokeWait
+static gboolean invokeWait( void* user_data )
+{
+	InvokeContext* ctx = (InvokeContext*)user_data;
+
+	ctx->callback(ctx->user_data);
+	ctx->event.Wake();
+
+	return G_SOURCE_REMOVE;
+}
+
+
+// Invoke
+void EventLoop::Invoke( GSourceFunc callback, void* user_data, bool wait )
+{
+	if( !callback )
+		return;
+
+	if( !wait || IsCurrentThread() )
+	{
+		g_main_context_invoke(mContext, callback, user_data);
+		return;
+	}
+
+	InvokeContext ctx;
+
+	ctx.callback  = callback;
+	ctx.user_data = user_data;
+
+	g_main_context_invoke(mContext, invokeWait, &ctx);
+	ctx.event.Wait();
+}
+
+
+// attach
+uint32_t EventLoop::attach( GSource* source, GSourceFunc callback, void* user_data )
+{
+	if( !source )
+		return 0;
+
+	g_source_set_callback(source, callback, user_data, NULL);
+
+	const uint32_t id = g_source_attach(source, mContext);
+	g_source_unref(source);
+
+	return id;
+}
+
+
+// AddIdle
+uint32_t EventLoop::AddIdle( GSourceFunc callback, void* user_data )
+{
+	return attach(g_idle_source_new(), callback, user_data);
+}
+
+
+// AddTimeout
+uint32_t EventLoop::AddTimeout( uint32_t interval, GSourceFunc callback, void* user_data )
+{
+	return attach(g_timeout_source_new(interval), callback, user_data);
+}
+
+
+// AddWatch
+uint32_t EventLoop::AddWatch( int fd, GIOCondition condition, GUnixFDSourceFunc callback, void* user_data )
+{
+	if( fd < 0 )
+		return 0;
+
+	return attach(g_unix_fd_source_new(fd, condition), (GSourceFunc)callback, user_data);
+}
+
+
+// RemoveSource
+bool EventLoop::RemoveSource( uint32_t id )
+{
+	if( id == 0 )
+		return false;
+
+	GSource* source = g_main_context_find_source_by_id(mContext, id);
+
+	if( !source )
+		return false;
+
+	g_source_destroy(source);
+	return true;
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __EVENT_LOOP_H__
+#define __EVENT_LOOP_H__
+
+#include <glib.h>
+#include <glib-unix.h>
+
+#include <stdint.h>
+#include <vector>
+
+
+// forward declarations
+class Thread;
+class commandLine;
+
+
+/**
+ * Event loop logging prefix
+ * @ingroup network
+ */
+#define LOG_EVENT_LOOP "[events] "
+
+/**
+ * Standard command-line options able to be passed to EventLoop::Configure()
+ * @ingroup network
+ */
+#define EVENT_LOOP_USAGE_STRING  "eventLoop arguments: \n" 								\
+		  "  --event-threads=N      number of threads that run the network servers and\n"	\
+		  "                         clients (RTSP, WebRTC, MQTT) event loops (default: 1)\n"	\
+		  "  --event-cpus=LIST      CPU cores the event loop threads can run on, for example\n"	\
+		  "                         --event-cpus=0 or --event-cpus=0,2-3 (default: any)\n\n"
+
+
+/**
+ * Shared GLib event loops that the network servers and clients attach to,
+ * instead of each one running (or polling) its own thread.
+ *
+ * The loops are started the first time one is acquired, and each runs its own
+ * GMainContext in a dedicated thread.  By default there is one loop, so all of the
+ * RTSP/WebRTC servers and the telemetry client are serviced from the same thread.
+ * The number of threads and the CPU cores they run on can be set with Configure()
+ * before the loops are started - for example to keep the networking off the cores
+ * used by inference on 4-6 core Jetsons.
+ *
+ * Sources can be attached to a loop's GMainContext directly with GetContext(), or
+ * with the helpers below which are safe to call from any thread.  The loops keep
+ * running until the process exits.
+ *
+ * @ingroup network
+ */
+class EventLoop
+{
+public:
+	/**
+	 * Set the number of event loop threads and their CPU affinity.
+	 * This needs to be called before the first loop is acquired, otherwise it has no effect.
+	 * @param numThreads the number of event loops (and threads) to create
+	 * @param cpus list of CPU cores the threads can run on (like "0,2-3"), or NULL for any core.
+	 */
+	static bool Configure( uint32_t numThreads, const char* cpus=NULL );
+
+	/**
+	 * Set the number of event loop threads and their CPU affinity from the command line.
+	 * @see EVENT_LOOP_USAGE_STRING
+	 */
+	static bool Configure( const commandLine& cmdLine );
+
+	/**
+	 * Get a reference to the event loop that has the fewest users, starting the loops if needed.
+	 * Call Release() when it's no longer needed.
+	 */
+	static EventLoop* Acquire();
+
+	/**
+	 * Release a reference to the event loop (the loop keeps running).
+	 */
+	void Release();
+
+	/**
+	 * Get the loop's GMainContext.
+	 */
+	inline GMainContext* GetContext() const			{ return mContext; }
+
+	/**
+	 * Return true if this is being called from the loop's thread.
+	 */
+	bool IsCurrentThread() const;
+
+	/**
+	 * Run a function in the loop's thread.  If called from the loop's thread, the function
+	 * runs immediately.  Otherwise it's queued, and if wait is true, this blocks until it has run.
+	 * The function is only called once, regardless of its return value.
+	 */
+	void Invoke( GSourceFunc callback, void* user_data, bool wait=false );
+
+	/**
+	 * Call a function the next time the loop is idle, until it returns false.
+	 * @returns the source ID, which can be passed to RemoveSource()
+	 */
+	uint32_t AddIdle( GSourceFunc callback, void* user_data );
+
+	/**
+	 * Call a function periodically, until it returns false.
+	 * @param interval the period (in milliseconds)
+	 * @returns the source ID, which can be passed to RemoveSource()
+	 */
+	uint32_t AddTimeout( uint32_t interval, GSourceFunc callback, void* user_data );
+
+	/**
+	 * Call a function when a file descriptor (like Socket::GetFD()) is ready, until it returns false.
+	 * @param condition the events to wait for (G_IO_IN, G_IO_OUT, ect)
+	 * @returns the source ID, which can be passed to RemoveSource()
+	 */
+	uint32_t AddWatch( int fd, GIOCondition condition, GUnixFDSourceFunc callback, void* user_data );
+
+	/**
+	 * Remove a source that was added to this loop.
+	 */
+	bool RemoveSource( uint32_t id );
+
+	/**
+	 * Get the number of event loop threads.
+	 */
+	static uint32_t GetNumThreads();
+
+	/**
+	 * Usage string for command line arguments to Configure()
+	 */
+	static inline const char* Usage() 				{ return EVENT_LOOP_USAGE_STRING; }
+
+protected:
+	EventLoop( uint32_t index );
+	~EventLoop();
+
+	bool init();
+	uint32_t attach( GSource* source, GSourceFunc callback, void* user_data );
+
+	static void* runThread( void* user_data );
+
+	GMainContext* mContext;
+	GMainLoop*    mMainLoop;
+
+	Thread*  mThread;
+	uint32_t mIndex;
+	uint32_t mRefCount;
+	bool     mRunning;
+};
+
+#endif
@@ -24,7 +24,7 @@
 #include "Networking.h"
 #include "gstUtility.h"
 
-#include "Thread.h"
+#include "EventLoop.h"
 #include "logging.h"
 
 #include <gst/rtsp-server/rtsp-server.h>
@@ -33,8 +33,8 @@
 // list of existing server instances
 std::vector<RTSPServer*> gRTSPServers;
 
-// map of media factories to pipeline elements
-std::vector<std::pair<GstRTSPMediaFactory*, GstElement*>> gMediaFactoryMap;
+// key used to attach the Route to its media factory and to the clients playing it
+#define RTSP_ROUTE_KEY "rtsp-server-route"
 
 
 // constructor
@@ -42,9 +42,8 @@ RTSPServer::RTSPServer( uint16_t port )
 {	
 	mPort = port;
 	mRefCount = 1;
-	mThread = new Thread();
-	mRunning = false;
-	mMainLoop = NULL;
+	mSource = 0;
+	mEventLoop = NULL;
 	mServer = NULL;
 }
 
@@ -52,18 +51,10 @@ RTSPServer::RTSPServer( uint16_t port )
 // destructor
 RTSPServer::~RTSPServer()
 {
-	if( mRunning )
+	if( mSource != 0 )
 	{
-		g_main_loop_quit(mMainLoop);
-		
-		while(mRunning)
-		{
-			LogVerbose(LOG_RTSP "waiting for RTSP server to stop...\n");
-			usleep(500 * 1000);
-		}
-		
-		g_main_loop_unref(mMainLoop);
-		mMainLoop = NULL;
+		mEventLoop->RemoveSource(mSource);
+		mSource = 0;
 	}
 	
 	if( mServer != NULL )
@@ -71,12 +62,17 @@ RTSPServer::~RTSPServer()
 		g_object_unref(mServer);
 		mServer = NULL;
 	}
-			
-	if( mThread != NULL )
+	
+	if( mEventLoop != NULL )
 	{
-		delete mThread;
-		mThread = NULL;
+		mEventLoop->Release();
+		mEventLoop = NULL;
 	}
+	
+	for( size_t n=0; n < mRoutes.size(); n++ )
+		delete mRoutes[n];
+	
+	mRoutes.clear();
 }
 
 
@@ -121,32 +117,10 @@ RTSPServer* RTSPServer::Create( uint16_t port )
 	// create a new server
 	RTSPServer* server = new RTSPServer(port);
 
-	if( !server )
+	if( !server || !server->init() )
 	{
 		LogError(LOG_RTSP "failed to create RTSP server on port %hu\n", port);
-		return NULL;
-	}
-	
-	// start the thread
-	if( !server->mThread->Start(runThread, server) )
-	{
-		LogError(LOG_RTSP "failed to create thread for running RTSP server\n");
-		return NULL;
-	}
-
-	// wait for initialization to complete
-	for( uint32_t n=0; n < 15; n++ )
-	{
-		if( server->mRunning )
-			break;
-		
-		LogVerbose(LOG_RTSP "waiting for RTSP server to start...\n");
-		usleep(100 * 1000);
-	}
-	
-	if( !server->mRunning )
-	{
-		LogError(LOG_RTSP "failed to start RTSP server on port %hu\n", server->mPort);
+		delete server;
 		return NULL;
 	}
 		
@@ -165,12 +139,12 @@ bool RTSPServer::init()
 		return false;
 	}
 	
-	// make a main loop for the default context
-	mMainLoop = g_main_loop_new(NULL, false);
+	// run the server on one of the shared event loops
+	mEventLoop = EventLoop::Acquire();
 	
-	if( !mMainLoop )
+	if( !mEventLoop )
 	{
-		LogError(LOG_RTSP "failed to create GMainLoop instance\n");
+		LogError(LOG_RTSP "failed to acquire an event loop for running RTSP server\n");
 		return false;
 	}
 	
@@ -188,8 +162,13 @@ bool RTSPServer::init()
 	sprintf(port_str, "%hu", mPort);
 	gst_rtsp_server_set_service(mServer, port_str);
 	
-	// attach the server to the default maincontext
-     if( gst_rtsp_server_attach(mServer, NULL) == 0 )
+	// keep track of the clients playing each route
+	g_signal_connect(mServer, "client-connected", G_CALLBACK(onClientConnected), this);
+	
+	// attach the server to the event loop's context (the clients it accepts get attached there too)
+	mSource = gst_rtsp_server_attach(mServer, mEventLoop->GetContext());
+	
+	if( mSource == 0 )
 	{
 		LogError(LOG_RTSP "failed to attach server to port %hu\n", mPort);
 		return false;
@@ -200,44 +179,36 @@ bool RTSPServer::init()
 }
 
 
-// runThread
-void* RTSPServer::runThread( void* user_data )
+// custom implementation of GstRTSPMediaFactory::create_element()
+GstElement* RTSPServer::onCreateElement( GstRTSPMediaFactory* factory, const GstRTSPUrl* url )
 {
-	RTSPServer* server = (RTSPServer*)user_data;
+	Route* route = (Route*)g_object_get_data(G_OBJECT(factory), RTSP_ROUTE_KEY);
 	
-	if( !server )
-		return 0;
-	
-	// initialize server resources
-	if( !server->init() )
+	if( !route || !route->pipeline )
 	{
-		LogError(LOG_RTSP "failed to create RTSP server on port %hu\n", server->mPort);
-		return 0;
+		LogError(LOG_RTSP "failed to lookup media factory pipeline element\n");
+		return NULL;
 	}
 	
-	// run the server's main loop
-	server->mRunning = true;
-	g_main_loop_run(server->mMainLoop);
-	server->mRunning = false;
+	GstElement* pipeline = route->pipeline;
+	
+	// the pipeline contains the encoder, so it can't be instanced again for another media
+	if( GST_OBJECT_PARENT(pipeline) != NULL )
+	{
+		LogError(LOG_RTSP "pipeline for %s is already in use by another media (it can only be shared)\n", (url != NULL) ? url->abspath : "route");
+		return NULL;
+	}
 	
-	LogVerbose(LOG_RTSP "RTSP server thread stopped\n");
-	return 0;
+	return pipeline;
 }
 
 
-// custom implementation of GstRTSPMediaFactory::create_element()
-static GstElement* gst_rtsp_media_factory_custom_element( GstRTSPMediaFactory* factory, const GstRTSPUrl* url )
+// custom implementation of GstRTSPMediaFactory::gen_key()
+static gchar* gst_rtsp_media_factory_custom_key( GstRTSPMediaFactory* factory, const GstRTSPUrl* url )
 {
-	const uint32_t numFactories = gMediaFactoryMap.size();
-	
-	for( uint32_t n=0; n < numFactories; n++ )
-	{
-		if( factory == gMediaFactoryMap[n].first )
-			return gMediaFactoryMap[n].second;
-	}
-	
-	LogError(LOG_RTSP "failed to lookup media factory pipeline element\n");
-	return NULL;
+	// key shared media by the factory instead of by the full URL (which includes the query
+	// string and client-specific parts), so every client of a route plays the same media
+	return g_strdup_printf("%p", factory);
 }
     
     
@@ -266,8 +237,21 @@ bool RTSPServer::AddRoute( const char* path, GstElement* pipeline )
 	GstRTSPMediaFactory* factory = gst_rtsp_media_factory_new();
 	GstRTSPMediaFactoryClass* factoryFunctions = GST_RTSP_MEDIA_FACTORY_GET_CLASS(factory);
 	
-	factoryFunctions->create_element = gst_rtsp_media_factory_custom_element;
-	gMediaFactoryMap.push_back( std::pair<GstRTSPMediaFactory*, GstElement*>(factory, pipeline) );
+	factoryFunctions->create_element = onCreateElement;
+	factoryFunctions->gen_key = gst_rtsp_media_factory_custom_key;
+	
+	// attach the route (and its pipeline) to the factory, so it can be looked up directly
+	Route* route = new Route();
+	
+	route->path       = path;
+	route->numClients = 0;
+	route->pipeline   = pipeline;
+	
+	g_object_set_data(G_OBJECT(factory), RTSP_ROUTE_KEY, route);
+	
+	mRoutesMutex.Lock();
+	mRoutes.push_back(route);
+	mRoutesMutex.Unlock();
 	
 	// setup media streaming options
 	gst_rtsp_media_factory_set_latency(factory, 0);
@@ -309,4 +293,117 @@ bool RTSPServer::AddRoute( const char* path, const char* pipeline_str )
 	}
 	
 	return AddRoute(path, pipeline);
+}
+
+
+// GetClientCount
+uint32_t RTSPServer::GetClientCount( const char* path ) const
+{
+	if( !path )
+		return 0;
+
+	uint32_t count = 0;
+	
+	mRoutesMutex.Lock();
+	
+	for( size_t n=0; n < mRoutes.size(); n++ )
+	{
+		if( mRoutes[n]->path == path )
+			count += mRoutes[n]->numClients;
+	}
+	
+	mRoutesMutex.Unlock();
+	return count;
+}
+
+
+// GetClientCount
+uint32_t RTSPServer::GetClientCount() const
+{
+	uint32_t count = 0;
+	
+	mRoutesMutex.Lock();
+	
+	for( size_t n=0; n < mRoutes.size(); n++ )
+		count += mRoutes[n]->numClients;
+	
+	mRoutesMutex.Unlock();
+	return count;
+}
+
+
+// onClientConnected
+void RTSPServer::onClientConnected( GstRTSPServer* server, GstRTSPClient* client, void* user_data )
+{
+	g_signal_connect(client, "play-request", G_CALLBACK(onClientPlay), user_data);
+	g_signal_connect(client, "closed", G_CALLBACK(onClientClosed), user_data);
+}
+
+
+// onClientPlay
+void RTSPServer::onClientPlay( GstRTSPClient* client, GstRTSPContext* context, void* user_data )
+{
+	RTSPServer* server = (RTSPServer*)user_data;
+	
+	if( !server || !context || !context->media )
+		return;
+	
+	// a client counts once per route, even if it sends PLAY again after pausing
+	if( g_object_get_data(G_OBJECT(client), RTSP_ROUTE_KEY) != NULL )
+		return;
+	
+	GstElement* pipeline = gst_rtsp_media_get_element(context->media);
+	
+	if( !pipeline )
+		return;
+	
+	Route* route = NULL;
+	
+	server->mRoutesMutex.Lock();
+	
+	for( size_t n=0; n < server->mRoutes.size(); n++ )
+	{
+		if( server->mRoutes[n]->pipeline == pipeline )
+		{
+			route = server->mRoutes[n];
+			route->numClients++;
+			break;
+		}
+	}
+	
+	server->mRoutesMutex.Unlock();
+	gst_object_unref(pipeline);
+	
+	if( !route )
+		return;
+	
+	g_object_set_data(G_OBJECT(client), RTSP_ROUTE_KEY, route);
+	
+	GstRTSPConnection* connection = gst_rtsp_client_get_connection(client);
+	
+	LogVerbose(LOG_RTSP "client %s playing %s (%u clients sharing the stream)\n", 
+			 connection != NULL ? gst_rtsp_connection_get_ip(connection) : "unknown", 
+			 route->path.c_str(), route->numClients);
+}
+
+
+// onClientClosed
+void RTSPServer::onClientClosed( GstRTSPClient* client, void* user_data )
+{
+	RTSPServer* server = (RTSPServer*)user_data;
+	Route* route = (Route*)g_object_get_data(G_OBJECT(client), RTSP_ROUTE_KEY);
+	
+	if( !server || !route )
+		return;
+	
+	server->mRoutesMutex.Lock();
+	
+	if( route->numClients > 0 )
+		route->numClients--;
+	
+	const uint32_t numClients = route->numClients;
+	server->mRoutesMutex.Unlock();
+	
+	g_object_set_data(G_OBJECT(client), RTSP_ROUTE_KEY, NULL);
+	LogVerbose(LOG_RTSP "client disconnected from %s (%u clients remaining)\n", route->path.c_str(), numClients);
 }
\ No newline at end of file
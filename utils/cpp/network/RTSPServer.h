@@ -23,14 +23,21 @@
 #ifndef __RTSP_SERVER_H__
 #define __RTSP_SERVER_H__
 
+#include "Mutex.h"
+
 #include <stdint.h>
+#include <string>
+#include <vector>
 
 
 // forward declarations
-class Thread;
+class EventLoop;
 
-struct _GMainLoop;
 struct _GstRTSPServer;
+struct _GstRTSPClient;
+struct _GstRTSPContext;
+struct _GstRTSPMediaFactory;
+struct _GstRTSPUrl;
 struct _GstElement;
 
 
@@ -50,6 +57,10 @@ struct _GstElement;
 /**
  * RTSP server for transmitting encoded GStreamer pipelines to client devices.
  * This is integrated into videoOutput/gstEncoder, but can be used standalone (@see rtsp-server example)
+ *
+ * Each route serves one pipeline that is shared by all of its clients, so the stream
+ * is only encoded once regardless of the number of viewers.  The pipeline can also feed
+ * other outputs (like WebRTC or a file) from a tee, see videoOptions::fanout.
  * @ingroup network
  */
 class RTSPServer
@@ -79,21 +90,44 @@ public:
 	 */
 	bool AddRoute( const char* path, const char* pipeline );
 	
+	/**
+	 * Get the number of clients currently playing the stream at this path.
+	 */
+	uint32_t GetClientCount( const char* path ) const;
+
+	/**
+	 * Get the total number of clients currently playing streams from this server.
+	 */
+	uint32_t GetClientCount() const;
+
 protected:
 	RTSPServer( uint16_t port );
 	~RTSPServer();
 	
 	bool init();
 	
-	static void* runThread( void* user_data );
+	struct Route
+	{
+		std::string path;
+		uint32_t numClients;
+		_GstElement* pipeline;
+	};
+
+	static _GstElement* onCreateElement( _GstRTSPMediaFactory* factory, const _GstRTSPUrl* url );
+
+	static void onClientConnected( _GstRTSPServer* server, _GstRTSPClient* client, void* user_data );
+	static void onClientPlay( _GstRTSPClient* client, _GstRTSPContext* context, void* user_data );
+	static void onClientClosed( _GstRTSPClient* client, void* user_data );
+
+	std::vector<Route*> mRoutes;
+	mutable Mutex mRoutesMutex;
 	
 	uint16_t mPort;
 	uint32_t mRefCount;
 	
-	Thread* mThread;
-	bool    mRunning;
+	uint32_t mSource;	// GSource ID of the server's listening socket
 	
-	_GMainLoop* mMainLoop;
+	EventLoop* mEventLoop;
 	_GstRTSPServer* mServer;
 };
 
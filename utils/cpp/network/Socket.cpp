@@ -26,6 +26,7 @@
 
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <arpa/inet.h>
 #include <cstring>
 #include <unistd.h>
 #include <errno.h>
@@ -101,6 +102,104 @@ bool Socket::EnableJumboBuffer()
 }
 
 
+// EnableBroadcast
+bool Socket::EnableBroadcast()
+{
+	if( mBroadcastEnabled )
+		return true;
+
+	int opt = 1;
+	
+	if( setsockopt(mSock, SOL_SOCKET, SO_BROADCAST, (const char*)&opt, sizeof(int)) != 0 )
+	{
+		LogError(LOG_NETWORK "Socket::EnableBroadcast() failed to enable broadcasting\n");
+		printErrno();
+		return false;
+	}
+	
+	mBroadcastEnabled = true;
+	return true;
+}
+
+
+// EnableReuseAddress
+bool Socket::EnableReuseAddress()
+{
+	int opt = 1;
+	
+	if( setsockopt(mSock, SOL_SOCKET, SO_REUSEADDR, (const char*)&opt, sizeof(int)) != 0 )
+	{
+		LogError(LOG_NETWORK "Socket::EnableReuseAddress() failed to set SO_REUSEADDR\n");
+		printErrno();
+		return false;
+	}
+	
+	return true;
+}
+
+
+// JoinMulticastGroup
+bool Socket::JoinMulticastGroup( uint32_t groupIP, uint32_t interfaceIP )
+{
+	if( mType != SOCKET_UDP )
+		return false;
+
+	struct ip_mreq mreq;
+	
+	mreq.imr_multiaddr.s_addr = groupIP;
+	mreq.imr_interface.s_addr = interfaceIP;
+	
+	if( setsockopt(mSock, IPPROTO_IP, IP_ADD_MEMBERSHIP, (const char*)&mreq, sizeof(mreq)) != 0 )
+	{
+		LogError(LOG_NETWORK "Socket::JoinMulticastGroup() failed to join multicast group %s\n", IPv4AddressToStr(groupIP).c_str());
+		printErrno();
+		return false;
+	}
+	
+	return true;
+}
+
+
+// SetMulticastOptions
+bool Socket::SetMulticastOptions( uint8_t ttl, bool loopback, uint32_t interfaceIP )
+{
+	if( mType != SOCKET_UDP )
+		return false;
+
+	const unsigned char ttlOpt = ttl;
+	const unsigned char loopOpt = loopback ? 1 : 0;
+	
+	if( setsockopt(mSock, IPPROTO_IP, IP_MULTICAST_TTL, (const char*)&ttlOpt, sizeof(ttlOpt)) != 0 )
+	{
+		LogError(LOG_NETWORK "Socket::SetMulticastOptions() failed to set IP_MULTICAST_TTL to %u\n", (uint32_t)ttl);
+		printErrno();
+		return false;
+	}
+	
+	if( setsockopt(mSock, IPPROTO_IP, IP_MULTICAST_LOOP, (const char*)&loopOpt, sizeof(loopOpt)) != 0 )
+	{
+		LogError(LOG_NETWORK "Socket::SetMulticastOptions() failed to set IP_MULTICAST_LOOP\n");
+		printErrno();
+		return false;
+	}
+	
+	if( interfaceIP != IP_ANY )
+	{
+		struct in_addr addr;
+		addr.s_addr = interfaceIP;
+		
+		if( setsockopt(mSock, IPPROTO_IP, IP_MULTICAST_IF, (const char*)&addr, sizeof(addr)) != 0 )
+		{
+			LogError(LOG_NETWORK "Socket::SetMulticastOptions() failed to set IP_MULTICAST_IF to %s\n", IPv4AddressToStr(interfaceIP).c_str());
+			printErrno();
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+
 // Create
 Socket* Socket::Create( SocketType type )
 {
@@ -437,19 +536,8 @@ bool Socket::Send( void* buffer, size_t size, uint32_t remoteIP, uint16_t remote
 	
 
 	// if sending broadcast, enable broadcasting if not already done so
-	if( remoteIP == netswap32(IP_BROADCAST) && !mBroadcastEnabled )
-	{
-		int opt = 1;
-		
-		if( setsockopt(mSock, SOL_SOCKET, SO_BROADCAST, (const char*)&opt, sizeof(int)) != 0 )
-		{
-			LogError(LOG_NETWORK "Socket::Send() failed to enabled broadcasting...\n");
-			printErrno();
-			return false;
-		}
-		
-		mBroadcastEnabled = true;
-	}
+	if( remoteIP == netswap32(IP_BROADCAST) && !EnableBroadcast() )
+		return false;
 
 
 	// send the message
@@ -473,6 +561,122 @@ bool Socket::Send( void* buffer, size_t size, uint32_t remoteIP, uint16_t remote
 }
 
 
+// maximum number of messages passed to each sendmmsg/recvmmsg call
+#define SOCKET_MAX_BATCH 64
+
+
+// SendBatch
+size_t Socket::SendBatch( const SocketMessage* messages, size_t count )
+{
+	if( !messages || count == 0 )
+		return 0;
+
+	struct mmsghdr msgs[SOCKET_MAX_BATCH];
+	struct iovec iov[SOCKET_MAX_BATCH];
+	struct sockaddr_in addr[SOCKET_MAX_BATCH];
+	
+	size_t numSent = 0;
+	
+	while( numSent < count )
+	{
+		const size_t batchSize = (count - numSent < SOCKET_MAX_BATCH) ? (count - numSent) : SOCKET_MAX_BATCH;
+		
+		memset(msgs, 0, sizeof(struct mmsghdr) * batchSize);
+		
+		for( size_t n=0; n < batchSize; n++ )
+		{
+			const SocketMessage& msg = messages[numSent + n];
+			
+			memset(&addr[n], 0, sizeof(struct sockaddr_in));
+			
+			addr[n].sin_family      = AF_INET;
+			addr[n].sin_addr.s_addr = msg.remoteIP;
+			addr[n].sin_port        = htons(msg.remotePort);
+			
+			iov[n].iov_base = msg.buffer;
+			iov[n].iov_len  = msg.size;
+			
+			// TCP sockets are already connected, so the address is ignored
+			if( mType == SOCKET_UDP )
+			{
+				msgs[n].msg_hdr.msg_name    = &addr[n];
+				msgs[n].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+			}
+			
+			msgs[n].msg_hdr.msg_iov    = &iov[n];
+			msgs[n].msg_hdr.msg_iovlen = 1;
+		}
+		
+		// sendmmsg() can return early if the socket buffer fills up, so keep going
+		const int res = sendmmsg(mSock, msgs, batchSize, 0);
+		
+		if( res <= 0 )
+		{
+			if( res < 0 && errno == EINTR )
+				continue;
+
+			LogError(LOG_NETWORK "Socket::SendBatch() failed to send %zu messages (%zu of %zu sent)\n", batchSize, numSent, count);
+			printErrno();
+			break;
+		}
+		
+		numSent += res;
+	}
+	
+	return numSent;
+}
+
+
+// RecieveBatch
+int Socket::RecieveBatch( SocketMessage* messages, size_t count )
+{
+	if( !messages || count == 0 )
+		return 0;
+
+	if( count > SOCKET_MAX_BATCH )
+		count = SOCKET_MAX_BATCH;
+	
+	struct mmsghdr msgs[SOCKET_MAX_BATCH];
+	struct iovec iov[SOCKET_MAX_BATCH];
+	struct sockaddr_in addr[SOCKET_MAX_BATCH];
+	
+	memset(msgs, 0, sizeof(struct mmsghdr) * count);
+	
+	for( size_t n=0; n < count; n++ )
+	{
+		iov[n].iov_base = messages[n].buffer;
+		iov[n].iov_len  = messages[n].size;
+		
+		msgs[n].msg_hdr.msg_name    = &addr[n];
+		msgs[n].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+		msgs[n].msg_hdr.msg_iov     = &iov[n];
+		msgs[n].msg_hdr.msg_iovlen  = 1;
+	}
+	
+	// block for the first packet (up to the SO_RCVTIMEO timeout), then take whatever else is queued
+	const int res = recvmmsg(mSock, msgs, count, MSG_WAITFORONE, NULL);
+	
+	if( res < 0 )
+	{
+		if( errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR )
+			return 0;	// timeout (or interrupted by a signal)
+
+		LogError(LOG_NETWORK "Socket::RecieveBatch() -- recvmmsg() failed\n");
+		printErrno();
+		return -1;
+	}
+	
+	for( int n=0; n < res; n++ )
+	{
+		messages[n].received   = msgs[n].msg_len;
+		messages[n].remoteIP   = addr[n].sin_addr.s_addr;
+		messages[n].remotePort = ntohs(addr[n].sin_port);
+	}
+	
+	return res;
+}
+
+
 // PrintIP
 void Socket::PrintIP() const
 {
@@ -50,6 +50,39 @@ enum SocketType
 #define IP_LOOPBACK     0x7F000001
 
 
+/**
+ * Datagram used by Socket::SendBatch() and Socket::RecieveBatch().
+ * @ingroup network
+ */
+struct SocketMessage
+{
+	/**
+	 * Pointer to the packet data to send, or the buffer to recieve into.
+	 */
+	void* buffer;
+
+	/**
+	 * Size of the packet to send, or the size of the buffer to recieve into (in bytes).
+	 */
+	size_t size;
+
+	/**
+	 * Number of bytes recieved (set by RecieveBatch)
+	 */
+	size_t received;
+
+	/**
+	 * IPv4 address of the destination (for sending) or where the packet originated (when recieving), in network byte order.
+	 */
+	uint32_t remoteIP;
+
+	/**
+	 * Port of the destination (for sending) or where the packet originated (when recieving), in host byte order.
+	 */
+	uint16_t remotePort;
+};
+
+
 /**
  * The Socket class provides TCP or UDP ethernet networking.   
  * To exchange data with a remote IP on the network using UDP, follow these steps:
@@ -139,6 +172,25 @@ public:
 	 */
 	bool Send( void* buffer, size_t size, uint32_t remoteIP, uint16_t remotePort );
 	
+	/**
+	 * Send multiple messages with as few system calls as possible (using sendmmsg).
+	 * Each message can have a different destination.  Broadcasting must be enabled 
+	 * beforehand with EnableBroadcast() to send to the broadcast address.
+	 * @returns the number of messages that were sent (which is less than count on error)
+	 */
+	size_t SendBatch( const SocketMessage* messages, size_t count );
+
+	/**
+	 * Recieve up to count packets with one system call (using recvmmsg).
+	 * This waits for at least one packet to arrive (or the timeout set with
+	 * SetRecieveTimeout() to expire), and then returns the packets that are
+	 * already queued without waiting for more.
+	 * @param messages the buffer and size of each message should be set by the caller,
+	 *                 and the received size and remote address are filled out.
+	 * @returns the number of packets that were recieved, 0 on timeout, or -1 on error
+	 */
+	int RecieveBatch( SocketMessage* messages, size_t count );
+
 	/**
 	 * Set Receive() timeout (in microseconds).
 	 */
@@ -154,6 +206,36 @@ public:
 	 */
 	bool EnableJumboBuffer();
 
+	/**
+	 * Allow sending to the broadcast address (SO_BROADCAST).
+	 * Send() enables this automatically, but it should be set before using SendBatch().
+	 */
+	bool EnableBroadcast();
+
+	/**
+	 * Allow multiple sockets to bind to the same port (SO_REUSEADDR).
+	 * This should be called before Bind(), and is typically used so that multiple 
+	 * local processes can subscribe to the same multicast group.
+	 */
+	bool EnableReuseAddress();
+
+	/**
+	 * Join a multicast group, so that packets sent to it are recieved (UDP only).
+	 * @param groupIP the multicast group address (in network byte order)
+	 * @param interfaceIP the address of the local interface to join on (in network byte order),
+	 *                    or INADDR_ANY to let the system choose.
+	 */
+	bool JoinMulticastGroup( uint32_t groupIP, uint32_t interfaceIP=IP_ANY );
+
+	/**
+	 * Set the options for sending multicast packets (UDP only).
+	 * @param ttl the number of hops the packets can take (1 keeps them on the local subnet)
+	 * @param loopback if true, the packets are also delivered to sockets on this host.
+	 * @param interfaceIP the address of the local interface to send from (in network byte order),
+	 *                    or INADDR_ANY to let the system choose.
+	 */
+	bool SetMulticastOptions( uint8_t ttl=1, bool loopback=true, uint32_t interfaceIP=IP_ANY );
+
 	/**
 	 * Retrieve the socket's file descriptor.
 	 */
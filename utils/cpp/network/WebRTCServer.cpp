@@ -23,7 +23,6 @@
 #include "WebRTCServer.h"
 #include "Networking.h"
 #include "Process.h"
-#include "Thread.h"
 
 #include "json.hpp"
 #include "logging.h"
@@ -348,6 +347,7 @@ WebRTCServer::WebRTCServer( uint16_t port, const char* stun_server, const char*
 	mPeerCount = 0;
 	mHasHTTPS = false;
 	mSoupServer = NULL;
+	mEventLoop = NULL;
 	
 	if( stun_server != NULL )
 		mStunServer = stun_server;
@@ -359,7 +359,7 @@ WebRTCServer::WebRTCServer( uint16_t port, const char* stun_server, const char*
 		mSSLKeyFile = ssl_key_file;
 	
 	if( threaded )
-		mThread = new Thread();
+		mEventLoop = EventLoop::Acquire();
 }
 
 
@@ -373,18 +373,17 @@ WebRTCServer::~WebRTCServer()
 		mWebsocketConnection = NULL;
 	}*/
 	
-	if( mThread != NULL )
-	{
-		//mThread->Stop(true);
-		delete mThread;
-		mThread = NULL;
-	}
-
 	if( mSoupServer != NULL )
 	{
 		g_object_unref(mSoupServer);
 		mSoupServer = NULL;
 	}
+	
+	if( mEventLoop != NULL )
+	{
+		mEventLoop->Release();
+		mEventLoop = NULL;
+	}
 }
 
 
@@ -436,14 +435,10 @@ WebRTCServer* WebRTCServer::Create( uint16_t port, const char* stun_server, cons
 		return NULL;
 	}
 	
-	// start the thread if needed
-	if( server->mThread != NULL )
+	if( threaded && !server->mEventLoop )
 	{
-		if( !server->mThread->Start(runThread, server) )
-		{
-			LogError(LOG_WEBRTC "failed to start thread for running WebRTC server\n");
-			return NULL;
-		}
+		LogError(LOG_WEBRTC "failed to acquire an event loop for running WebRTC server\n");
+		return NULL;
 	}
 	
 	gWebRTCServers.push_back(server);
@@ -491,7 +486,21 @@ bool WebRTCServer::init()
 	
 	AddRoute("/", onHttpDefault, this);  // serve the server-default HTML pages
 	
-	// start the server listening
+	// start the server listening (the listening sockets and the connections they accept get
+	// attached to the thread-default context, which is only the event loop's in its own thread)
+	if( mEventLoop != NULL )
+		mEventLoop->Invoke(onListen, this, true);
+	else
+		listen();
+	
+	LogSuccess(LOG_WEBRTC "WebRTC server started @ %s://%s:%hu\n", mHasHTTPS ? "https" : "http", getHostname().c_str(), mPort);
+	return true;
+}
+
+
+// listen
+bool WebRTCServer::listen()
+{
 	GError* err = NULL;
 
 	if( !soup_server_listen_all(mSoupServer, mPort, mHasHTTPS ? SOUP_SERVER_LISTEN_HTTPS : (SoupServerListenOptions)0, &err) )
@@ -499,13 +508,21 @@ bool WebRTCServer::init()
 		LogError(LOG_WEBRTC "SOUP server failed to listen on port %hu\n", mPort);
 		LogError(LOG_WEBRTC "   (%s)\n", err->message);
 		g_error_free(err);
+		return false;
 	}
-	
-	LogSuccess(LOG_WEBRTC "WebRTC server started @ %s://%s:%hu\n", mHasHTTPS ? "https" : "http", getHostname().c_str(), mPort);
+
 	return true;
 }
 
 
+// onListen
+gboolean WebRTCServer::onListen( void* user_data )
+{
+	((WebRTCServer*)user_data)->listen();
+	return G_SOURCE_REMOVE;
+}
+
+
 // Add http route
 void WebRTCServer::AddRoute( const char* path, WebRTCServer::HttpListener callback, void* user_data, uint32_t flags )
 {
@@ -571,7 +588,18 @@ void WebRTCServer::AddRoute( const char* path, WebRTCServer::WebsocketListener c
 	}
 	
 	if( !callback )
+	{
+		// remove the existing route (and disconnect it's peers)
+		WebsocketRoute* existing = findWebsocketRoute(path);
+		
+		if( existing != NULL )
+		{
+			vector_remove_element(mWebsocketRoutes, existing);
+			freeRoute(existing);
+		}
+		
 		return;
+	}
 	
 	// create a new route
 	WebsocketRoute* route = new WebsocketRoute();
@@ -651,7 +679,18 @@ void WebRTCServer::freeRoute( WebRTCServer::WebsocketRoute* route )
 	const size_t numPeers = route->peers.size();
 	
 	for( size_t n=0; n < numPeers; n++ )
-		delete route->peers[n];
+	{
+		WebRTCPeer* peer = route->peers[n];
+		
+		g_signal_handlers_disconnect_by_data(peer->connection, peer);
+		
+		if( soup_websocket_connection_get_state(peer->connection) == SOUP_WEBSOCKET_STATE_OPEN )
+			soup_websocket_connection_close(peer->connection, SOUP_WEBSOCKET_CLOSE_GOING_AWAY, NULL);
+		
+		g_object_unref(G_OBJECT(peer->connection));
+		
+		delete peer;
+	}
 	
 	delete route;
 }
@@ -1003,29 +1042,11 @@ bool WebRTCServer::ProcessRequests( bool blocking )
 	// https://stackoverflow.com/questions/23737750/glib-usage-without-mainloop
 	// https://www.freedesktop.org/software/gstreamer-sdk/data/docs/2012.5/glib/glib-The-Main-Event-Loop.html#g-main-context-iteration
 	// https://developer-old.gnome.org/programming-guidelines/stable/main-contexts.html.en
+	if( mEventLoop != NULL )
+		return true;  // the event loop dispatches the requests
+	
 	g_main_context_iteration(NULL, blocking);
 	return true;
 }
 
-
-// runThread
-void* WebRTCServer::runThread( void* user_data )
-{
-	WebRTCServer* server = (WebRTCServer*)user_data;
-	
-	if( !server )
-		return 0;
-	
-	LogVerbose(LOG_WEBRTC "WebRTC server thread running...\n");
-	
-	while( server->mRefCount > 0 )
-	{
-		//LogDebug(LOG_WEBRTC "WebRTC processing requests\n");
-		server->ProcessRequests(true);
-	}
-	
-	LogVerbose(LOG_WEBRTC "WebRTC server thread stopped\n");
-	return 0;
-}
-
 	
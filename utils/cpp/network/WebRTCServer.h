@@ -25,6 +25,8 @@
 
 #include <libsoup/soup.h>
 
+#include "EventLoop.h"
+
 #include <stdint.h>
 #include <string>
 #include <vector>
@@ -32,7 +34,6 @@
 
 // forward declarations
 class WebRTCServer;
-class Thread;
 
 
 /**
@@ -183,10 +184,16 @@ public:
 	inline bool HasHTTPS() const					{ return mHasHTTPS; }
 	
 	/**
-	 * Return true if the server is running in it's own thread.
+	 * Return true if the server is running on one of the shared event loops.
 	 * Otherwise, ProcessRequests() must be called periodically.
 	 */
-	inline bool IsThreaded() const				{ return (mThread != NULL); }
+	inline bool IsThreaded() const				{ return (mEventLoop != NULL); }
+	
+	/**
+	 * Get the event loop that the server is running on (or NULL if it isn't threaded).
+	 * Sources that interact with the server's sockets should be attached to this loop.
+	 */
+	inline EventLoop* GetEventLoop() const			{ return mEventLoop; }
 	
 	/**
 	 * Process incoming requests on the server.
@@ -201,8 +208,9 @@ protected:
 	~WebRTCServer();
 	
 	bool init();
+	bool listen();
 
-	static void* runThread( void* user_data );
+	static gboolean onListen( void* user_data );
 	
 	static void onHttpRequest( SoupServer* soup_server, SoupMessage* message, const char* path, GHashTable* query, SoupClientContext* client_context, void* user_data );
 	static void onHttpDefault( SoupServer* soup_server, SoupMessage* message, const char* path, GHashTable* query, SoupClientContext* client_context, void* user_data );
@@ -252,7 +260,7 @@ protected:
 	uint32_t mRefCount;
 	uint32_t mPeerCount;
 	
-	Thread* mThread;
+	EventLoop* mEventLoop;
 };
 
 #endif
@@ -21,6 +21,7 @@
  */
 
 #include "RTSPServer.h"
+#include "EventLoop.h"
 
 #include "logging.h"
 #include "commandLine.h"
@@ -49,6 +50,7 @@ int usage()
 {
 	printf("usage: rtsp-server [--help] --port PORT\n\n");
 	printf("See below for additional arguments that may not be shown above.\n\n");
+	printf("%s", EventLoop::Usage());
 	printf("%s", Log::Usage());
 
 	return 0;
@@ -67,6 +69,9 @@ int main( int argc, char** argv )
 
 	Log::ParseCmdLine(cmdLine);
 	
+	if( !EventLoop::Configure(cmdLine) )
+		return 1;
+	
 	
 	/*
 	 * attach signal handler
@@ -94,7 +99,7 @@ int main( int argc, char** argv )
 	 */
 	while( !signal_recieved )
 	{
-		// the server runs in it's own thread, so just poll for exit conditions
+		// the server runs on the shared event loop thread, so just poll for exit conditions
 		// normally RTSPServer runs in applications that have their own main processing loop
 		usleep(500 * 1000);
 	}
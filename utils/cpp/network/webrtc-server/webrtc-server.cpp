@@ -21,11 +21,13 @@
  */
 
 #include "WebRTCServer.h"
+#include "EventLoop.h"
 
 #include "logging.h"
 #include "commandLine.h"
 
 #include <signal.h>
+#include <unistd.h>
 
 
 
@@ -45,6 +47,7 @@ int usage()
 {
 	printf("usage: webrtc-server [--help] --port PORT\n\n");
 	printf("See below for additional arguments that may not be shown above.\n\n");
+	printf("%s", EventLoop::Usage());
 	printf("%s", Log::Usage());
 
 	return 0;
@@ -64,6 +67,9 @@ int main( int argc, char** argv )
 
 	Log::ParseCmdLine(cmdLine);
 	
+	if( !EventLoop::Configure(cmdLine) )
+		return 1;
+	
 	
 	/*
 	 * attach signal handler
@@ -87,7 +93,8 @@ int main( int argc, char** argv )
 	 */
 	while( !signal_recieved )
 	{
-		server->ProcessRequests();
+		// the server runs on the shared event loop thread, so just poll for exit conditions
+		usleep(500 * 1000);
 	}
 	
 	
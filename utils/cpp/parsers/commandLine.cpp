@@ -46,46 +46,34 @@ static inline int strFindDelimiter( char delimiter, const char* string )
 }
 
 
-// replace hyphens for underscores and vice-versa (returns NULL if no changes)
-static inline char* strSwapDelimiter( const char* string )
+// normalize an argument name for the index (lowercase, with underscores replaced by hyphens)
+static inline void strNormalizeArg( const char* name, size_t length, std::string& out )
 {
-	if( !string )
-		return NULL;
-	
-	// determine if the original char is in the string
-	bool found = false;
-	const int str_length = strlen(string);
+	out.resize(length);
 
-	for( int n=0; n < str_length; n++ )
+	for( size_t n=0; n < length; n++ )
 	{
-		if( string[n] == '-' || string[n] == '_' )
-		{
-			found = true;
-			break;
-		}
+		const char c = name[n];
+
+		if( c == '_' )
+			out[n] = '-';
+		else if( c >= 'A' && c <= 'Z' )
+			out[n] = c + ('a' - 'A');
+		else
+			out[n] = c;
 	}
+}
 
-	if( !found )
-		return NULL;
-	
-	// allocate a new string to modify
-	char* new_str = (char*)malloc(str_length + 1);
-
-	if( !new_str )
-		return NULL;
 
-	strcpy(new_str, string);
+// return the value string of an argument (or NULL if it doesn't have one)
+static inline const char* strArgValue( const char* arg )
+{
+	const char* equal_pos = strchr(arg, '=');
 
-	// replace instances of the old char
-	for( int n=0; n < str_length; n++ )
-	{
-		if( new_str[n] == '-' )
-			new_str[n] = '_';
-		else if( new_str[n] == '_' )
-			new_str[n] = '-';
-	}
+	if( !equal_pos )
+		return NULL;
 
-	return new_str;
+	return equal_pos + 1;
 }
 	
 
@@ -95,6 +83,7 @@ commandLine::commandLine( const int pArgc, char** pArgv, const char* extraFlag )
 	argc = pArgc;
 	argv = pArgv;
 
+	Reindex();
 	AddFlag(extraFlag);
 
 	Log::ParseCmdLine(*this);
@@ -107,64 +96,98 @@ commandLine::commandLine( const int pArgc, char** pArgv, const char** extraArgs
 	argc = pArgc;
 	argv = pArgv;
 
+	Reindex();
 	AddArgs(extraArgs);
 
 	Log::ParseCmdLine(*this);
 }
 
 
-// GetInt
-int commandLine::GetInt( const char* string_ref, int default_value, bool allowOtherDelimiters ) const
+// Reindex
+void commandLine::Reindex()
 {
-	if( argc < 1 )
-		return default_value;
-
-	bool bFound = false;
-	int value = -1;
+	mArgs.clear();
+	mPositions.clear();
 
 	for( int i=ARGC_START; i < argc; i++ )
+		indexArg(i);
+}
+
+
+// indexArg
+void commandLine::indexArg( int index )
+{
+	if( !argv[index] )
+		return;
+
+	const int string_start = strFindDelimiter('-', argv[index]);
+
+	// positional arguments don't start with dashes (and argv[0] is the program)
+	if( string_start == 0 )
 	{
-		const int string_start = strFindDelimiter('-', argv[i]);
-		
-		if( string_start == 0 )
-			continue;
-		
-		const char* string_argv = &argv[i][string_start];
-		const int length = (int)strlen(string_ref);
-
-		if (!strncasecmp(string_argv, string_ref, length))
-		{
-			if (length+1 <= (int)strlen(string_argv))
-			{
-				int auto_inc = (string_argv[length] == '=') ? 1 : 0;
-				value = atoi(&string_argv[length + auto_inc]);
-			}
-			else
-			{
-				value = 0;
-			}
-
-			bFound = true;
-			continue;
-		}
+		if( index >= 1 )
+			mPositions.push_back(index);
+
+		return;
 	}
- 
 
-	if( bFound )
-		return value;
- 
-	if( !allowOtherDelimiters )
-		return default_value;
+	const char* string_argv = &argv[index][string_start];
+	const char* equal_pos = strchr(string_argv, '=');
 
-	// try looking for the argument with delimiters swapped
-	char* swapped_ref = strSwapDelimiter(string_ref);
+	std::string name;
+	strNormalizeArg(string_argv, (equal_pos != NULL) ? equal_pos - string_argv : strlen(string_argv), name);
 
-	if( !swapped_ref )
-		return default_value;
+	mArgs[name].push_back(index);
+}
 
-	value = GetInt(swapped_ref, default_value, false);
-	free(swapped_ref);
-	return value;
+
+// findArg
+const char* commandLine::findArg( const char* argName, bool allowOtherDelimiters, bool last ) const
+{
+	if( !argName )
+		return NULL;
+
+	const size_t length = strlen(argName);
+
+	std::string name;
+	strNormalizeArg(argName, length, name);
+
+	const std::unordered_map<std::string, std::vector<int>>::const_iterator iter = mArgs.find(name);
+
+	if( iter == mArgs.end() )
+		return NULL;
+
+	const std::vector<int>& indices = iter->second;
+	const size_t count = indices.size();
+
+	for( size_t n=0; n < count; n++ )
+	{
+		const char* arg = argv[indices[last ? count - n - 1 : n]];
+		arg += strFindDelimiter('-', arg);
+
+		// without other delimiters, the name has to match as it was typed
+		if( allowOtherDelimiters || strncasecmp(arg, argName, length) == 0 )
+			return arg;
+	}
+
+	return NULL;
+}
+
+
+// GetInt
+int commandLine::GetInt( const char* argName, int defaultValue, bool allowOtherDelimiters ) const
+{
+	const char* arg = findArg(argName, allowOtherDelimiters, true);
+
+	if( !arg )
+		return defaultValue;
+
+	const char* value = strArgValue(arg);
+
+	if( !value )
+		return 0;
+
+	return atoi(value);
 }
 
 
@@ -181,174 +204,96 @@ uint32_t commandLine::GetUnsignedInt( const char* argName, uint32_t defaultValue
 
 
 // GetFloat
-float commandLine::GetFloat( const char* string_ref, float default_value, bool allowOtherDelimiters ) const
+float commandLine::GetFloat( const char* argName, float defaultValue, bool allowOtherDelimiters ) const
 {
-	if( argc < 1 )
-		return default_value;
-
-	bool bFound = false;
-	float value = -1;
+	const char* arg = findArg(argName, allowOtherDelimiters, true);
 
-	for (int i=ARGC_START; i < argc; i++)
-	{
-		const int string_start = strFindDelimiter('-', argv[i]);
-		
-		if( string_start == 0 )
-			continue;
-		
-		const char* string_argv = &argv[i][string_start];
-		const int length = (int)strlen(string_ref);
-
-		if (!strncasecmp(string_argv, string_ref, length))
-		{
-			if (length+1 <= (int)strlen(string_argv))
-			{
-				int auto_inc = (string_argv[length] == '=') ? 1 : 0;
-				value = (float)atof(&string_argv[length + auto_inc]);
-			}
-			else
-			{
-				value = 0.f;
-			}
-
-			bFound = true;
-			continue;
-		}
-	}
-
-	if( bFound )
-		return value;
-
-	if( !allowOtherDelimiters )
-		return default_value;
+	if( !arg )
+		return defaultValue;
 
-	// try looking for the argument with delimiters swapped
-	char* swapped_ref = strSwapDelimiter(string_ref);
+	const char* value = strArgValue(arg);
 
-	if( !swapped_ref )
-		return default_value;
+	if( !value )
+		return 0.0f;
 
-	value = GetFloat(swapped_ref, default_value, false);
-	free(swapped_ref);
-	return value;
+	return (float)atof(value);
 }
 
 
-// GetFlag
-bool commandLine::GetFlag( const char* string_ref, bool allowOtherDelimiters ) const
+// GetBool
+bool commandLine::GetBool( const char* argName, bool defaultValue, bool allowOtherDelimiters ) const
 {
-	if( argc < 1 )
-		return false;
+	const char* arg = findArg(argName, allowOtherDelimiters, true);
 
-	for (int i=ARGC_START; i < argc; i++)
-	{
-		const int string_start = strFindDelimiter('-', argv[i]);
-		
-		if( string_start == 0 )
-			continue;
-		
-		const char* string_argv = &argv[i][string_start];
-		const char* equal_pos = strchr(string_argv, '=');
-		
-		const int argv_length = (int)(equal_pos == 0 ? strlen(string_argv) : equal_pos - string_argv);
-		const int length = (int)strlen(string_ref);
+	if( !arg )
+		return defaultValue;
 
-		if( length == argv_length && !strncasecmp(string_argv, string_ref, length) )
-			return true;
-	}
-    
-	if( !allowOtherDelimiters )
-		return false;
+	const char* value = strArgValue(arg);
+
+	if( !value )
+		return true;
 
-	// try looking for the argument with delimiters swapped
-	char* swapped_ref = strSwapDelimiter(string_ref);
+	if( strcasecmp(value, "true") == 0 || strcasecmp(value, "yes") == 0 || strcasecmp(value, "on") == 0 || strcmp(value, "1") == 0 )
+		return true;
 
-	if( !swapped_ref )
+	if( strcasecmp(value, "false") == 0 || strcasecmp(value, "no") == 0 || strcasecmp(value, "off") == 0 || strcmp(value, "0") == 0 )
 		return false;
 
-	const bool value = GetFlag(swapped_ref, false);
-	free(swapped_ref);
-	return value;
+	return defaultValue;
 }
 
 
-// GetString
-const char* commandLine::GetString( const char* string_ref, const char* default_value, bool allowOtherDelimiters ) const
+// GetFlag
+bool commandLine::GetFlag( const char* argName, bool allowOtherDelimiters ) const
 {
-	if( argc < 1 )
-		return default_value;
+	return (findArg(argName, allowOtherDelimiters, false) != NULL);
+}
 
-	for (int i=ARGC_START; i < argc; i++)
-	{
-		const int string_start  = strFindDelimiter('-', argv[i]);
-		
-		if( string_start == 0 )
-			continue;
-		
-		char* string_argv = (char*)&argv[i][string_start];
-		const int length = (int)strlen(string_ref);
 
-		if (!strncasecmp(string_argv, string_ref, length))
-			return (string_argv + length + 1);
-			//*string_retval = &string_argv[length+1];
-	}
+// GetString
+const char* commandLine::GetString( const char* argName, const char* defaultValue, bool allowOtherDelimiters ) const
+{
+	const char* arg = findArg(argName, allowOtherDelimiters, false);
 
-	if( !allowOtherDelimiters )
-		return default_value;
+	if( !arg )
+		return defaultValue;
 
-	// try looking for the argument with delimiters swapped
-	char* swapped_ref = strSwapDelimiter(string_ref);
+	const char* value = strArgValue(arg);
 
-	if( !swapped_ref )
-		return default_value;
+	if( !value )
+		return defaultValue;
 
-	const char* value = GetString(swapped_ref, default_value, false);
-	free(swapped_ref);
 	return value;
 }
 
 
 // GetPosition
-const char* commandLine::GetPosition( unsigned int position, const char* default_value ) const
+const char* commandLine::GetPosition( unsigned int position, const char* defaultValue ) const
 {
-	if( argc < 1 || position >= GetPositionArgs() )
-		return default_value;
-
-	unsigned int position_count = 0;
-	
-	for (int i=1/*ARGC_START*/; i < argc; i++)
-	{
-		const int string_start = strFindDelimiter('-', argv[i]);
-		
-		if( string_start != 0 )
-			continue;
-		
-		if( position == position_count )
-			return argv[i];
-		
-		position_count++;
-	}
+	if( position >= mPositions.size() )
+		return defaultValue;
 
-	return default_value;
+	return argv[mPositions[position]];
 }
 
 
 // GetPositionArgs
 unsigned int commandLine::GetPositionArgs() const
 {
-	unsigned int position_count = 0;
-	
-	for (int i=1/*ARGC_START*/; i < argc; i++)
-	{
-		const int string_start = strFindDelimiter('-', argv[i]);
-		
-		if( string_start != 0 )
-			continue;
-		
-		position_count++;
-	}
+	return mPositions.size();
+}
+
+
+// GetArgNames
+std::vector<std::string> commandLine::GetArgNames() const
+{
+	std::vector<std::string> names;
+	names.reserve(mArgs.size());
+
+	for( std::unordered_map<std::string, std::vector<int>>::const_iterator iter = mArgs.begin(); iter != mArgs.end(); iter++ )
+		names.push_back(iter->first);
 
-	return position_count;
+	return names;
 }
 
 
@@ -381,6 +326,8 @@ void commandLine::AddArg( const char* arg )
 
 	argc = new_argc;
 	argv = new_argv;
+
+	indexArg(argc - 1);
 }
 
 
@@ -27,9 +27,22 @@
 #include <stdlib.h>	
 #include <stdint.h>
 
+#include <string>
+#include <vector>
+#include <unordered_map>
+
 
 /**
  * Command line parser for extracting flags, values, and strings.
+ *
+ * The arguments are indexed once when the commandLine is created (and when
+ * arguments are added), so looking up an argument by name is a hash lookup
+ * instead of a scan of `argv`.  Argument names are matched case-insensitively,
+ * and must match in full (`--foo` doesn't match `--foobar`).
+ *
+ * If `argc` or `argv` are modified directly instead of with AddArg(),
+ * Reindex() should be called afterwards.
+ *
  * @ingroup commandLine
  */
 class commandLine
@@ -98,6 +111,20 @@ public:
 	 */
 	uint32_t GetUnsignedInt( const char* argName, uint32_t defaultValue=0, bool allowOtherDelimiters=true ) const; 
 
+	/**
+	 * Get boolean argument.  For example if argv contained `--foo=false`,
+	 * then `GetBool("foo")` would return `false`.  The values `true/false`,
+	 * `yes/no`, `on/off` and `1/0` are accepted, and `--foo` on its own is `true`.
+	 *
+	 * @param allowOtherDelimiters if true (default), the argName will be 
+	 *          matched against occurances containing either `-` or `_`.  
+	 *          For example, `--foo-bar` and `--foo_bar` would be the same.
+	 *
+	 * @returns `defaultValue` if the argument couldn't be found or wasn't a
+	 *          valid boolean (`false` by default).  Otherwise, returns the value.
+	 */
+	bool GetBool( const char* argName, bool defaultValue=false, bool allowOtherDelimiters=true ) const;
+
 	/**
 	 * Get string argument.  For example if argv contained `--foo=bar`,
 	 * then `GetString("foo")` would return `"bar"`
@@ -106,9 +133,9 @@ public:
 	 *          matched against occurances containing either `-` or `_`.  
 	 *          For example, `--foo-bar` and `--foo_bar` would be the same.
 	 *
-	 * @returns `defaultValue` if the argument couldn't be found (`NULL` by default).
-	 *          Otherwise, returns a pointer to the argument value string
-	 *          from the `argv` array.
+	 * @returns `defaultValue` if the argument couldn't be found, or it was a flag
+	 *          without a value (`NULL` by default).  Otherwise, returns a pointer 
+	 *          to the argument value string from the `argv` array.
 	 */
 	const char* GetString( const char* argName, const char* defaultValue=NULL, bool allowOtherDelimiters=true ) const;
 
@@ -130,6 +157,12 @@ public:
 	 */
 	unsigned int GetPositionArgs() const;
 	
+	/**
+	 * Get the names of the named arguments in the command line (without the
+	 * leading dashes, in lowercase and with `_` replaced by `-`).
+	 */
+	std::vector<std::string> GetArgNames() const;
+	
 	/**
 	 * Add an argument to the command line.
 	 */
@@ -145,6 +178,11 @@ public:
 	 */
 	void AddFlag( const char* flag );
 
+	/**
+	 * Rebuild the argument index after `argc` or `argv` were modified directly.
+	 */
+	void Reindex();
+
 	/**
 	 * Print out the command line for reference.
 	 */
@@ -159,6 +197,21 @@ public:
 	 * The argument strings that the object was created with from main()
 	 */
 	char** argv;
+
+protected:
+	/**
+	 * Find an argument by name, and return the text after its leading dashes.
+	 * If last is true, the last occurance is returned (otherwise the first).
+	 */
+	const char* findArg( const char* argName, bool allowOtherDelimiters, bool last ) const;
+
+	/**
+	 * Add argv[index] to the index.
+	 */
+	void indexArg( int index );
+
+	std::unordered_map<std::string, std::vector<int>> mArgs;	// normalized name -> argv indices
+	std::vector<int> mPositions;						// argv indices of the positional args
 };
 
 
@@ -0,0 +1,675 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+
+#include "configStore.h"
+#include "logging.h"
+#include "json.hpp"
+
+#include <fstream>
+#include <sstream>
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+
+
+extern char** environ;
+
+
+// normalize a key (lowercase, with underscores replaced by hyphens, the same as commandLine)
+static std::string normalizeKey( const char* key )
+{
+	std::string str = key;
+	const size_t length = str.length();
+
+	for( size_t n=0; n < length; n++ )
+	{
+		if( str[n] == '_' )
+			str[n] = '-';
+		else if( str[n] >= 'A' && str[n] <= 'Z' )
+			str[n] += 'a' - 'A';
+	}
+
+	return str;
+}
+
+
+// check if a value is one of the strings that mean false
+static bool isFalseValue( const char* str )
+{
+	return (strcasecmp(str, "false") == 0 || strcasecmp(str, "no") == 0 || strcasecmp(str, "off") == 0);
+}
+
+
+// get the modification time of a file (in nanoseconds, or -1 if it doesn't exist)
+static int64_t fileModifiedTime( const char* path )
+{
+	struct stat fileStat;
+
+	if( stat(path, &fileStat) != 0 )
+		return -1;
+
+	return int64_t(fileStat.st_mtim.tv_sec) * 1000000000LL + fileStat.st_mtim.tv_nsec;
+}
+
+
+// convert a JSON value to the string form used on the command line
+static bool jsonToStr( const nlohmann::json& value, std::string& str )
+{
+	if( value.is_string() )
+	{
+		str = value.get<std::string>();
+		return true;
+	}
+	else if( value.is_boolean() )
+	{
+		str = value.get<bool>() ? "true" : "false";
+		return true;
+	}
+	else if( value.is_number() )
+	{
+		str = value.dump();
+		return true;
+	}
+	else if( value.is_array() )
+	{
+		// arrays become comma-separated lists (like --output-fanout=URI,URI)
+		str.clear();
+
+		for( size_t n=0; n < value.size(); n++ )
+		{
+			std::string element;
+
+			if( !jsonToStr(value[n], element) )
+				return false;
+
+			if( n > 0 )
+				str += ",";
+
+			str += element;
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+
+// flatten a JSON object into key/value pairs (nested objects are joined with '.')
+static void jsonFlatten( const nlohmann::json& object, const std::string& prefix, std::vector<std::pair<std::string, std::string>>& values )
+{
+	for( nlohmann::json::const_iterator iter = object.begin(); iter != object.end(); iter++ )
+	{
+		const std::string key = prefix + normalizeKey(iter.key().c_str());
+
+		if( iter.value().is_object() )
+		{
+			jsonFlatten(iter.value(), key + ".", values);
+			continue;
+		}
+
+		std::string value;
+
+		if( !jsonToStr(iter.value(), value) )
+		{
+			LogWarning(LOG_CONFIG "ignoring '%s' (expected a string, number, bool, or array)\n", key.c_str());
+			continue;
+		}
+
+		values.push_back(std::make_pair(key, value));
+	}
+}
+
+
+// constructor
+configStore::configStore( const char* envPrefix )
+{
+	mNextSubscriber = 1;
+	mFileTime = -1;
+
+	if( envPrefix != NULL )
+		mEnvPrefix = envPrefix;
+}
+
+
+// Load
+bool configStore::Load( const commandLine& cmdLine )
+{
+	bool result = true;
+	const char* file = cmdLine.GetString("config");
+
+	if( file != NULL )
+		result = LoadFile(file);
+
+	if( mEnvPrefix.length() > 0 )
+		LoadEnv(mEnvPrefix.c_str());
+
+	LoadCmdLine(cmdLine);
+	return result;
+}
+
+
+// LoadFile
+bool configStore::LoadFile( const char* path )
+{
+	if( !path )
+		return false;
+
+	const int64_t fileTime = fileModifiedTime(path);
+	std::ifstream file(path);
+
+	if( fileTime < 0 || !file.is_open() )
+	{
+		LogError(LOG_CONFIG "failed to open '%s'\n", path);
+		return false;
+	}
+
+	std::stringstream text;
+	text << file.rdbuf();
+
+	const nlohmann::json json = nlohmann::json::parse(text.str(), nullptr, false);
+
+	if( json.is_discarded() || !json.is_object() )
+	{
+		LogError(LOG_CONFIG "failed to parse '%s' (expected a JSON object)\n", path);
+		return false;
+	}
+
+	std::vector<std::pair<std::string, std::string>> values;
+	jsonFlatten(json, "", values);
+
+	// remove the previous file's values that are no longer in it
+	std::unordered_map<std::string, std::string> fileValues(values.begin(), values.end());
+	std::vector<std::string> removed;
+	std::vector<Change> changes;
+
+	mMutex.Lock();
+
+	for( std::unordered_map<std::string, Entry>::const_iterator iter = mEntries.begin(); iter != mEntries.end(); iter++ )
+	{
+		if( (iter->second.layers & (1 << LAYER_FILE)) && fileValues.count(iter->first) == 0 )
+			removed.push_back(iter->first);
+	}
+
+	for( size_t n=0; n < removed.size(); n++ )
+		set(removed[n], NULL, LAYER_FILE, changes);
+
+	for( size_t n=0; n < values.size(); n++ )
+		set(values[n].first, values[n].second.c_str(), LAYER_FILE, changes);
+
+	mFile = path;
+	mFileTime = fileTime;
+
+	mMutex.Unlock();
+
+	LogVerbose(LOG_CONFIG "loaded %zu values from '%s' (%zu changed)\n", values.size(), path, changes.size());
+
+	notify(changes);
+	return true;
+}
+
+
+// Reload
+bool configStore::Reload( bool force )
+{
+	mMutex.Lock();
+	const std::string path = mFile;
+	const int64_t loadedTime = mFileTime;
+	mMutex.Unlock();
+
+	if( path.length() == 0 )
+		return false;
+
+	if( !force && fileModifiedTime(path.c_str()) == loadedTime )
+		return false;
+
+	return LoadFile(path.c_str());
+}
+
+
+// LoadEnv
+void configStore::LoadEnv( const char* prefix )
+{
+	if( !prefix || !environ )
+		return;
+
+	const std::string envPrefix = std::string(prefix) + "_";
+	std::vector<Change> changes;
+
+	mMutex.Lock();
+
+	for( char** env = environ; *env != NULL; env++ )
+	{
+		if( strncasecmp(*env, envPrefix.c_str(), envPrefix.length()) != 0 )
+			continue;
+
+		const char* name = *env + envPrefix.length();
+		const char* equal_pos = strchr(name, '=');
+
+		if( !equal_pos || equal_pos == name )
+			continue;
+
+		set(normalizeKey(std::string(name, equal_pos - name).c_str()), equal_pos + 1, LAYER_ENV, changes);
+	}
+
+	mMutex.Unlock();
+	notify(changes);
+}
+
+
+// LoadCmdLine
+void configStore::LoadCmdLine( const commandLine& cmdLine )
+{
+	const std::vector<std::string> names = cmdLine.GetArgNames();
+	std::vector<Change> changes;
+
+	mMutex.Lock();
+
+	for( size_t n=0; n < names.size(); n++ )
+		set(names[n], cmdLine.GetString(names[n].c_str(), "true"), LAYER_CMDLINE, changes);
+
+	mMutex.Unlock();
+	notify(changes);
+}
+
+
+// Apply
+void configStore::Apply( commandLine& cmdLine ) const
+{
+	mMutex.Lock();
+
+	for( std::unordered_map<std::string, Entry>::const_iterator iter = mEntries.begin(); iter != mEntries.end(); iter++ )
+	{
+		if( cmdLine.GetFlag(iter->first.c_str()) )
+			continue;
+
+		// flags are checked with commandLine::GetFlag(), which is true if the argument is present
+		// regardless of its value, so false values are left off instead of adding --key=false
+		if( !iter->second.isNumber && isFalseValue(iter->second.value.c_str()) )
+			continue;
+
+		const std::string arg = "--" + iter->first + "=" + iter->second.value;
+		cmdLine.AddArg(arg.c_str());
+	}
+
+	mMutex.Unlock();
+}
+
+
+// Set
+void configStore::Set( const char* key, const char* value, Layer layer )
+{
+	if( !key || layer >= LAYER_COUNT )
+		return;
+
+	std::vector<Change> changes;
+
+	mMutex.Lock();
+	set(normalizeKey(key), value, layer, changes);
+	mMutex.Unlock();
+
+	notify(changes);
+}
+
+
+// Unset
+void configStore::Unset( const char* key, Layer layer )
+{
+	Set(key, NULL, layer);
+}
+
+
+// set
+bool configStore::set( const std::string& key, const char* value, Layer layer, std::vector<Change>& changes )
+{
+	std::unordered_map<std::string, Entry>::iterator iter = mEntries.find(key);
+
+	if( iter == mEntries.end() )
+	{
+		if( !value )
+			return false;
+
+		Entry entry;
+
+		entry.layers = 0;
+		entry.number = 0.0;
+		entry.isNumber = false;
+
+		iter = mEntries.insert(std::make_pair(key, entry)).first;
+	}
+
+	Entry& entry = iter->second;
+
+	if( value != NULL )
+	{
+		entry.values[layer] = value;
+		entry.layers |= (1 << layer);
+	}
+	else
+	{
+		entry.values[layer].clear();
+		entry.layers &= ~(1 << layer);
+	}
+
+	return resolve(key, entry, changes);
+}
+
+
+// resolve
+bool configStore::resolve( const std::string& key, Entry& entry, std::vector<Change>& changes )
+{
+	Change change;
+
+	change.key = key;
+	change.removed = (entry.layers == 0);
+
+	if( change.removed )
+	{
+		mEntries.erase(key);	// entry is no longer valid after this
+		changes.push_back(change);
+		return true;
+	}
+
+	// the highest layer with a value wins
+	int layer = LAYER_COUNT - 1;
+
+	while( !(entry.layers & (1 << layer)) )
+		layer--;
+
+	if( entry.values[layer] == entry.value )
+		return false;
+
+	entry.value = entry.values[layer];
+
+	// parse the number once here, instead of in every call to the getters
+	const char* str = entry.value.c_str();
+	char* end = NULL;
+
+	entry.number = strtod(str, &end);
+	entry.isNumber = (end != str && *end == '\0');
+
+	change.value = entry.value;
+	changes.push_back(change);
+
+	return true;
+}
+
+
+// notify
+void configStore::notify( const std::vector<Change>& changes )
+{
+	if( changes.size() == 0 )
+		return;
+
+	// copy the subscribers, so they can subscribe/unsubscribe from their callbacks
+	mMutex.Lock();
+	const std::vector<Subscriber> subscribers = mSubscribers;
+	mMutex.Unlock();
+
+	for( size_t n=0; n < changes.size(); n++ )
+	{
+		for( size_t s=0; s < subscribers.size(); s++ )
+		{
+			if( subscribers[s].key.length() > 0 && subscribers[s].key != changes[n].key )
+				continue;
+
+			subscribers[s].callback(this, changes[n].key.c_str(), changes[n].removed ? NULL : changes[n].value.c_str(), subscribers[s].user_data);
+		}
+	}
+}
+
+
+// find (the mutex should be locked)
+const configStore::Entry* configStore::find( const char* key ) const
+{
+	if( !key )
+		return NULL;
+
+	std::unordered_map<std::string, Entry>::const_iterator iter = mEntries.find(normalizeKey(key));
+
+	if( iter == mEntries.end() )
+		return NULL;
+
+	return &iter->second;
+}
+
+
+// Has
+bool configStore::Has( const char* key ) const
+{
+	mMutex.Lock();
+	const bool found = (find(key) != NULL);
+	mMutex.Unlock();
+
+	return found;
+}
+
+
+// GetLayer
+configStore::Layer configStore::GetLayer( const char* key ) const
+{
+	Layer layer = LAYER_COUNT;
+
+	mMutex.Lock();
+
+	const Entry* entry = find(key);
+
+	if( entry != NULL )
+	{
+		int n = LAYER_COUNT - 1;
+
+		while( n > 0 && !(entry->layers & (1 << n)) )
+			n--;
+
+		layer = (Layer)n;
+	}
+
+	mMutex.Unlock();
+	return layer;
+}
+
+
+// GetString
+std::string configStore::GetString( const char* key, const char* defaultValue ) const
+{
+	std::string value;
+
+	mMutex.Lock();
+
+	const Entry* entry = find(key);
+
+	if( entry != NULL )
+		value = entry->value;
+	else if( defaultValue != NULL )
+		value = defaultValue;
+
+	mMutex.Unlock();
+	return value;
+}
+
+
+// GetInt
+int configStore::GetInt( const char* key, int defaultValue ) const
+{
+	int value = defaultValue;
+
+	mMutex.Lock();
+
+	const Entry* entry = find(key);
+
+	if( entry != NULL && entry->isNumber )
+		value = (int)entry->number;
+
+	mMutex.Unlock();
+	return value;
+}
+
+
+// GetUnsignedInt
+uint32_t configStore::GetUnsignedInt( const char* key, uint32_t defaultValue ) const
+{
+	uint32_t value = defaultValue;
+
+	mMutex.Lock();
+
+	const Entry* entry = find(key);
+
+	if( entry != NULL && entry->isNumber && entry->number >= 0.0 )
+		value = (uint32_t)entry->number;
+
+	mMutex.Unlock();
+	return value;
+}
+
+
+// GetFloat
+float configStore::GetFloat( const char* key, float defaultValue ) const
+{
+	float value = defaultValue;
+
+	mMutex.Lock();
+
+	const Entry* entry = find(key);
+
+	if( entry != NULL && entry->isNumber )
+		value = (float)entry->number;
+
+	mMutex.Unlock();
+	return value;
+}
+
+
+// GetBool
+bool configStore::GetBool( const char* key, bool defaultValue ) const
+{
+	bool value = defaultValue;
+
+	mMutex.Lock();
+
+	const Entry* entry = find(key);
+
+	if( entry != NULL )
+	{
+		const char* str = entry->value.c_str();
+
+		if( entry->isNumber )
+			value = (entry->number != 0.0);
+		else if( strcasecmp(str, "true") == 0 || strcasecmp(str, "yes") == 0 || strcasecmp(str, "on") == 0 )
+			value = true;
+		else if( isFalseValue(str) )
+			value = false;
+	}
+
+	mMutex.Unlock();
+	return value;
+}
+
+
+// Subscribe
+uint32_t configStore::Subscribe( const char* key, ChangeCallback callback, void* user_data )
+{
+	if( !callback )
+		return 0;
+
+	Subscriber subscriber;
+
+	subscriber.callback = callback;
+	subscriber.user_data = user_data;
+
+	if( key != NULL )
+		subscriber.key = normalizeKey(key);
+
+	mMutex.Lock();
+	subscriber.id = mNextSubscriber++;
+	mSubscribers.push_back(subscriber);
+	mMutex.Unlock();
+
+	return subscriber.id;
+}
+
+
+// Unsubscribe
+void configStore::Unsubscribe( uint32_t id )
+{
+	mMutex.Lock();
+
+	for( size_t n=0; n < mSubscribers.size(); n++ )
+	{
+		if( mSubscribers[n].id == id )
+		{
+			mSubscribers.erase(mSubscribers.begin() + n);
+			break;
+		}
+	}
+
+	mMutex.Unlock();
+}
+
+
+// GetFile
+std::string configStore::GetFile() const
+{
+	mMutex.Lock();
+	const std::string file = mFile;
+	mMutex.Unlock();
+
+	return file;
+}
+
+
+// Print
+void configStore::Print() const
+{
+	mMutex.Lock();
+
+	LogInfo(LOG_CONFIG "%zu values%s%s\n", mEntries.size(), mFile.length() > 0 ? " (file " : "", mFile.length() > 0 ? (mFile + ")").c_str() : "");
+
+	for( std::unordered_map<std::string, Entry>::const_iterator iter = mEntries.begin(); iter != mEntries.end(); iter++ )
+	{
+		int layer = LAYER_COUNT - 1;
+
+		while( layer > 0 && !(iter->second.layers & (1 << layer)) )
+			layer--;
+
+		LogInfo("   -- %-24s %-10s %s\n", iter->first.c_str(), LayerToStr((Layer)layer), iter->second.value.c_str());
+	}
+
+	mMutex.Unlock();
+}
+
+
+// LayerToStr
+const char* configStore::LayerToStr( Layer layer )
+{
+	switch(layer)
+	{
+		case LAYER_DEFAULT: return "default";
+		case LAYER_FILE:    return "file";
+		case LAYER_ENV:     return "env";
+		case LAYER_CMDLINE: return "cmdline";
+		case LAYER_RUNTIME: return "runtime";
+		default:		    return "none";
+	}
+}
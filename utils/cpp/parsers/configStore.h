@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+ 
+#ifndef __CONFIG_STORE_H_
+#define __CONFIG_STORE_H_
+
+#include "commandLine.h"
+#include "Mutex.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+
+/**
+ * Config logging prefix
+ * @ingroup commandLine
+ */
+#define LOG_CONFIG "[config] "
+
+/**
+ * Standard command-line options able to be passed to configStore::Load()
+ * @ingroup commandLine
+ */
+#define CONFIG_STORE_USAGE_STRING  "config arguments: \n"								\
+		  "  --config=FILE          JSON file with values for any of the command-line options,\n"	\
+		  "                         for example {\"threshold\": 0.5, \"overlay\": \"box,labels\"}\n"	\
+		  "                         Options are taken from (in increasing priority) the file,\n"	\
+		  "                         environment variables like PREFIX_OPTION_NAME, then the\n"		\
+		  "                         command line.  The file is reloaded when it changes.\n\n"
+
+
+/**
+ * Layered configuration, where each value is resolved from (in increasing priority)
+ * the defaults, a JSON config file, environment variables, the command line, and
+ * values that were set at runtime.
+ *
+ * Keys are normalized the same way as commandLine argument names (lowercase, with
+ * `_` replaced by `-`), and nested objects in the JSON file are flattened with `.`
+ * (for example `{"telemetry": {"topic": "x"}}` becomes the key `telemetry.topic`).
+ *
+ * The values are stored in a hash table and their numeric value is parsed once
+ * when they change, so the typed getters are cheap enough to call every frame.
+ * Callbacks can be subscribed to keys to be notified when their value changes,
+ * for example when the config file is reloaded.  configStore is thread-safe,
+ * and the callbacks are run from the thread that made the change.
+ *
+ * @ingroup commandLine
+ */
+class configStore
+{
+public:
+	/**
+	 * Configuration layers, in increasing priority.
+	 */
+	enum Layer
+	{
+		LAYER_DEFAULT = 0,	/**< defaults set by the application */
+		LAYER_FILE,		/**< loaded from the JSON config file */
+		LAYER_ENV,		/**< loaded from environment variables */
+		LAYER_CMDLINE,		/**< loaded from the command line */
+		LAYER_RUNTIME,		/**< set at runtime with Set() */
+		LAYER_COUNT
+	};
+
+	/**
+	 * Function called when the value of a key changes.
+	 * @param value the new value, or NULL if the key was removed from all layers.
+	 */
+	typedef void (*ChangeCallback)( configStore* config, const char* key, const char* value, void* user_data );
+
+	/**
+	 * Create an empty config.
+	 * @param envPrefix the prefix of the environment variables to load (e.g. `"YOLONET"` for `YOLONET_THRESHOLD`)
+	 */
+	configStore( const char* envPrefix=NULL );
+
+	/**
+	 * Load the JSON file from `--config=FILE` (if specified), the environment variables
+	 * with the prefix passed to the constructor, and then the command line.
+	 * @returns false if the config file couldn't be loaded.
+	 */
+	bool Load( const commandLine& cmdLine );
+
+	/**
+	 * Load a JSON config file into LAYER_FILE, replacing the values from the previous file.
+	 */
+	bool LoadFile( const char* path );
+
+	/**
+	 * Reload the config file if it was modified since it was last loaded (or if force is true).
+	 * This is cheap to call periodically, as it only checks the file's modification time.
+	 * @returns true if the file was reloaded.
+	 */
+	bool Reload( bool force=false );
+
+	/**
+	 * Load the environment variables that begin with `prefix_` into LAYER_ENV.
+	 */
+	void LoadEnv( const char* prefix );
+
+	/**
+	 * Load the named arguments from the command line into LAYER_CMDLINE.
+	 * Flags without a value are stored as `"true"`.
+	 */
+	void LoadCmdLine( const commandLine& cmdLine );
+
+	/**
+	 * Add the values that aren't already on the command line to it, so that they're
+	 * seen by components that are configured from a commandLine (like videoSource).
+	 * Keys set to `false`, `no` or `off` aren't added, so they don't enable flags.
+	 */
+	void Apply( commandLine& cmdLine ) const;
+
+	/**
+	 * Set the value of a key in one of the layers.
+	 */
+	void Set( const char* key, const char* value, Layer layer=LAYER_RUNTIME );
+
+	/**
+	 * Set the default value of a key.
+	 */
+	inline void SetDefault( const char* key, const char* value )			{ Set(key, value, LAYER_DEFAULT); }
+
+	/**
+	 * Remove the value of a key from one of the layers.
+	 */
+	void Unset( const char* key, Layer layer=LAYER_RUNTIME );
+
+	/**
+	 * Return true if the key has a value in any layer.
+	 */
+	bool Has( const char* key ) const;
+
+	/**
+	 * Get the layer that the value of the key came from (or LAYER_COUNT if it isn't set).
+	 */
+	Layer GetLayer( const char* key ) const;
+
+	/**
+	 * Get the value of a key as a string.
+	 */
+	std::string GetString( const char* key, const char* defaultValue="" ) const;
+
+	/**
+	 * Get the value of a key as an integer (or defaultValue if it isn't set or isn't a number).
+	 */
+	int GetInt( const char* key, int defaultValue=0 ) const;
+
+	/**
+	 * Get the value of a key as an unsigned integer (or defaultValue if it isn't set, isn't a number, or is negative).
+	 */
+	uint32_t GetUnsignedInt( const char* key, uint32_t defaultValue=0 ) const;
+
+	/**
+	 * Get the value of a key as a float (or defaultValue if it isn't set or isn't a number).
+	 */
+	float GetFloat( const char* key, float defaultValue=0.0f ) const;
+
+	/**
+	 * Get the value of a key as a bool.  The values `true/false`, `yes/no`, `on/off`
+	 * and numbers are accepted, otherwise defaultValue is returned.
+	 */
+	bool GetBool( const char* key, bool defaultValue=false ) const;
+
+	/**
+	 * Subscribe to changes of a key's value (or of any key, if key is NULL).
+	 * @returns the ID of the subscription, for Unsubscribe().
+	 */
+	uint32_t Subscribe( const char* key, ChangeCallback callback, void* user_data=NULL );
+
+	/**
+	 * Remove a subscription that was returned by Subscribe().
+	 */
+	void Unsubscribe( uint32_t id );
+
+	/**
+	 * Get the path of the config file (or an empty string if none was loaded).
+	 */
+	std::string GetFile() const;
+
+	/**
+	 * Print the values and the layers they came from.
+	 */
+	void Print() const;
+
+	/**
+	 * Usage string for command line arguments to Load()
+	 */
+	static inline const char* Usage() 							{ return CONFIG_STORE_USAGE_STRING; }
+
+	/**
+	 * Get the name of a layer.
+	 */
+	static const char* LayerToStr( Layer layer );
+
+protected:
+	struct Entry
+	{
+		std::string values[LAYER_COUNT];
+		uint32_t    layers;		// bitmask of the layers that have a value
+
+		std::string value;		// the resolved value
+		double      number;		// the resolved value parsed as a number
+		bool        isNumber;
+	};
+
+	struct Subscriber
+	{
+		uint32_t id;
+		std::string key;		// empty for all keys
+		ChangeCallback callback;
+		void* user_data;
+	};
+
+	struct Change
+	{
+		std::string key;
+		std::string value;
+		bool removed;
+	};
+
+	bool set( const std::string& key, const char* value, Layer layer, std::vector<Change>& changes );
+	bool resolve( const std::string& key, Entry& entry, std::vector<Change>& changes );
+	void notify( const std::vector<Change>& changes );
+	
+	const Entry* find( const char* key ) const;
+	
+	std::unordered_map<std::string, Entry> mEntries;
+	std::vector<Subscriber> mSubscribers;
+	uint32_t mNextSubscriber;
+
+	std::string mFile;
+	int64_t mFileTime;		// modification time of the file when it was loaded (in nanoseconds)
+
+	std::string mEnvPrefix;
+	mutable Mutex mMutex;
+};
+
+#endif
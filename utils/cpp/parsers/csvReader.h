@@ -25,6 +25,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <errno.h>
 
 #include <string>
@@ -78,13 +80,102 @@ public:
 	// fill list of tokens with string split by delimiters
 	inline static bool Parse( std::vector<csvData>& data, const char* str, const char* delimiters=",;\t " );
 
+	// fill list of tokens with the string between begin and end split by delimiters
+	inline static bool Parse( std::vector<csvData>& data, const char* begin, const char* end, const char* delimiters );
+
 	// data storage
 	std::string string;
 };
 
 
 /**
- * csvReader
+ * csvField is a view of a field in a row returned by csvReader::Next().
+ * It points into the memory-mapped file, so it's only valid until the next row is read.
+ * The number conversions parse the characters in place (without copying them to a string).
+ * @ingroup csv
+ */
+class csvField
+{
+public:
+	// constructors
+	csvField() : data(NULL), length(0)					{}
+	csvField( const char* str, size_t len ) : data(str), length(len)	{}
+
+	// access the characters (these aren't NULL-terminated)
+	inline const char* begin() const					{ return data; }
+	inline const char* end() const					{ return data + length; }
+	inline size_t size() const						{ return length; }
+	inline bool empty() const						{ return length == 0; }
+
+	// copy to string
+	inline std::string str() const					{ return std::string(data, length); }
+	inline operator std::string() const				{ return str(); }
+
+	// compare to string
+	inline bool operator == ( const char* str ) const		{ return str != NULL && strlen(str) == length && memcmp(data, str, length) == 0; }
+	inline bool operator != ( const char* str ) const		{ return !(*this == str); }
+
+	// convert to number (return true if valid)
+	inline bool toInt( int* value ) const;
+	inline bool toInt64( int64_t* value ) const;
+	inline bool toUInt64( uint64_t* value ) const;
+	inline bool toFloat( float* value ) const;
+	inline bool toDouble( double* value ) const;
+
+	// convert to number (valid->false on error)
+	inline int toInt( bool* valid=NULL ) const;
+	inline int64_t toInt64( bool* valid=NULL ) const;
+	inline uint64_t toUInt64( bool* valid=NULL ) const;
+	inline float toFloat( bool* valid=NULL ) const;
+	inline double toDouble( bool* valid=NULL ) const;
+
+	// field storage
+	const char* data;
+	size_t length;
+};
+
+
+/**
+ * csvRow is the list of fields returned by csvReader::Next().
+ * Re-using the same csvRow for each row avoids allocations once it has grown to fit the rows.
+ * @ingroup csv
+ */
+class csvRow
+{
+public:
+	// number of fields
+	inline size_t size() const						{ return fields.size(); }
+	inline bool empty() const						{ return fields.empty(); }
+
+	// access a field
+	inline const csvField& operator[]( size_t index ) const	{ return fields[index]; }
+
+	// line number in the file that the row started on (starting at 1)
+	inline uint64_t line() const						{ return lineNumber; }
+
+	// fields of the row
+	std::vector<csvField> fields;
+
+	// unescaped quoted fields that contain "" are stored here
+	std::string buffer;
+	std::vector<std::pair<size_t, size_t>> buffered;	// (field index, offset in buffer)
+
+	// line number in the file
+	uint64_t lineNumber;
+};
+
+
+/**
+ * csvReader memory-maps the file and splits it into rows.
+ *
+ * Next() is the fast streaming interface - it returns views of the fields without
+ * copying them, splits on the first delimiter character only (keeping empty fields),
+ * and handles quoted fields (which can contain delimiters, newlines, and "" escapes).
+ * If the delimiters include a space, then spaces around unquoted fields are trimmed.
+ *
+ * Read() returns copies of the fields as csvData, splitting on any of the delimiters.
+ * Empty lines and lines starting with '#' are skipped by both.
+ *
  * @ingroup csv
  */
 class csvReader
@@ -104,6 +195,9 @@ public:
 	inline bool IsOpen() const;
 	inline bool IsClosed() const;
 
+	// read the next row as views of the fields (no allocations once the row has grown)
+	inline bool Next( csvRow& row );
+
 	// read line, return list of tokens
 	inline std::vector<csvData> Read();
 	inline std::vector<csvData> Read( const char* delimiters );
@@ -112,6 +206,9 @@ public:
 	inline bool Read( std::vector<csvData>& data );
 	inline bool Read( std::vector<csvData>& data, const char* delimiters );
 
+	// go back to the start of the file
+	inline void Rewind();
+
 	// set default delimiters
 	inline void SetDelimiters( const char* delimiters );
 
@@ -121,11 +218,25 @@ public:
 	// retrieve the filename
 	inline const char* GetFilename() const;
 
-	// maximum line length
+	// retrieve the size of the file (in bytes)
+	inline size_t GetSize() const;
+
+	// retrieve the current position in the file (in bytes)
+	inline size_t GetPosition() const;
+
+	// maximum line length (unused, lines can be any length)
 	const size_t MaxLineLength=2048;
 
 private:
-	FILE* mFile;
+	inline bool nextLine( const char** begin, const char** end );
+	inline bool parseQuoted( csvRow& row, const char* line );
+	inline void addField( csvRow& row, const char* begin, const char* end );
+
+	const char* mData;
+	size_t mSize;
+	size_t mPos;
+	uint64_t mLine;
+	bool mOpen;
 
 	std::string mFilename;
 	std::string mDelimiters;
@@ -136,4 +247,3 @@ private:
 #include "csvReader.hpp"
 
 #endif
-
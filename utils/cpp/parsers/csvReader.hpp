@@ -27,6 +27,11 @@
 #include "csvReader.h"
 #include "logging.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 
 // toInt()
 inline bool csvData::toInt( int* value ) const
@@ -68,7 +73,7 @@ inline bool csvData::toDouble( double* value ) const
 	char* e;
 	errno = 0;
 
-	const float x = strtof(string.c_str(), &e);
+	const double x = strtod(string.c_str(), &e);
 
 	if( *e != '\0' || errno != 0 )
 		return false;
@@ -143,56 +148,387 @@ inline bool csvData::Parse( std::vector<csvData>& tokens, const char* str, const
 	if( !str || !delimiters )
 		return false;
 
+	size_t str_length = strlen(str);
+
+	while( str_length > 0 && (str[str_length-1] == '\n' || str[str_length-1] == '\r') )
+		str_length--;
+
+	return Parse(tokens, str, str + str_length, delimiters);
+}
+
+// Parse
+inline bool csvData::Parse( std::vector<csvData>& tokens, const char* begin, const char* end, const char* delimiters )
+{
+	if( !begin || !end || !delimiters )
+		return false;
+
 	tokens.clear();
 
-	const size_t str_length = strlen(str);
-	char* str_tokens = (char*)malloc(str_length + 1);
+	// split on any of the delimiters, skipping empty tokens (the same as strtok)
+	const char* token = NULL;
+
+	for( const char* p=begin; p <= end; p++ )
+	{
+		const bool delimiter = (p == end) || (strchr(delimiters, *p) != NULL && *p != '\0');
 
-	if( !str_tokens )
+		if( delimiter && token != NULL )
+		{
+			std::string str(token, p - token);
+			tokens.push_back(csvData(str));
+			token = NULL;
+		}
+		else if( !delimiter && token == NULL )
+		{
+			token = p;
+		}
+	}
+
+	return tokens.size() > 0;
+}
+
+//-------------------------------------------------------------------------------------
+// skip the spaces at the start and end of a field
+static inline void csvTrim( const char** begin, const char** end )
+{
+	while( *begin < *end && (**begin == ' ' || **begin == '\t') )
+		(*begin)++;
+
+	while( *end > *begin && ((*end)[-1] == ' ' || (*end)[-1] == '\t') )
+		(*end)--;
+}
+
+// parse a decimal integer from the characters between begin and end
+static inline bool csvParseInt( const char* begin, const char* end, int64_t* value, bool allowNegative=true )
+{
+	csvTrim(&begin, &end);
+
+	bool negative = false;
+
+	if( begin < end && (*begin == '-' || *begin == '+') )
+	{
+		negative = (*begin == '-');
+		begin++;
+	}
+
+	if( begin == end || (negative && !allowNegative) )
 		return false;
 
-	strcpy(str_tokens, str);
+	uint64_t x = 0;
 
-	if( str_tokens[str_length] == '\n' )
-		str_tokens[str_length] = '\0';
+	for( const char* p=begin; p < end; p++ )
+	{
+		const uint32_t digit = uint32_t(*p - '0');
 
-	if( str_tokens[str_length-1] == '\n' )
-		str_tokens[str_length-1] = '\0';
+		if( digit > 9 )
+			return false;
 
-	char* token = strtok(str_tokens, delimiters);
+		if( x > (UINT64_MAX - digit) / 10 )
+			return false;	// overflow
 
-	while( token != NULL )
+		x = x * 10 + digit;
+	}
+
+	if( !allowNegative )
 	{
-		tokens.push_back(token);
-		token = strtok(NULL, delimiters);
+		*value = (int64_t)x;	// reinterpreted by csvField::toUInt64()
+		return true;
 	}
 
-	free(str_tokens);
-	return tokens.size() > 0;
+	if( x > (uint64_t)INT64_MAX + (negative ? 1 : 0) )
+		return false;
+
+	*value = negative ? (int64_t)(0 - x) : (int64_t)x;
+	return true;
+}
+
+// parse a floating-point number from the characters between begin and end
+static inline bool csvParseDouble( const char* begin, const char* end, double* value )
+{
+	csvTrim(&begin, &end);
+
+	if( begin == end )
+		return false;
+
+	// fast path for plain decimals that can be converted exactly:
+	// a mantissa up to 2^53 scaled by a power of 10 up to 10^22
+	static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+							  1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
+							  1e20, 1e21, 1e22 };
+
+	const char* p = begin;
+	const bool negative = (*p == '-');
+
+	if( *p == '-' || *p == '+' )
+		p++;
+
+	uint64_t mantissa = 0;
+	int exponent = 0;
+	int digits = 0;
+	bool valid = false;
+
+	while( p < end && uint32_t(*p - '0') <= 9 && digits < 19 )
+	{
+		mantissa = mantissa * 10 + (*p - '0');
+		digits += (mantissa != 0);
+		valid = true;
+		p++;
+	}
+
+	if( p < end && *p == '.' )
+	{
+		p++;
+
+		while( p < end && uint32_t(*p - '0') <= 9 && digits < 19 )
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			digits += (mantissa != 0);
+			exponent--;
+			valid = true;
+			p++;
+		}
+	}
+
+	if( valid && p < end && (*p == 'e' || *p == 'E') )
+	{
+		const char* e = p + 1;
+		bool negativeExp = false;
+
+		if( e < end && (*e == '-' || *e == '+') )
+		{
+			negativeExp = (*e == '-');
+			e++;
+		}
+
+		int exp = 0;
+
+		while( e < end && uint32_t(*e - '0') <= 9 && exp < 10000 )
+			exp = exp * 10 + (*(e++) - '0');
+
+		if( e > p + 1 && uint32_t(e[-1] - '0') <= 9 )
+		{
+			exponent += negativeExp ? -exp : exp;
+			p = e;
+		}
+	}
+
+	if( valid && p == end && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22 )
+	{
+		double x = (double)mantissa;
+
+		if( exponent < 0 )
+			x /= pow10[-exponent];
+		else
+			x *= pow10[exponent];
+
+		*value = negative ? -x : x;
+		return true;
+	}
+
+	// otherwise (long mantissas, large exponents, inf/nan) use strtod() on a copy
+	char str[128];
+	const size_t length = end - begin;
+
+	if( length >= sizeof(str) )
+		return false;
+
+	memcpy(str, begin, length);
+	str[length] = '\0';
+
+	char* e = NULL;
+	errno = 0;
+
+	const double x = strtod(str, &e);
+
+	if( e != str + length || errno != 0 )
+		return false;
+
+	*value = x;
+	return true;
+}
+
+// toInt()
+inline bool csvField::toInt( int* value ) const
+{
+	int64_t x = 0;
+
+	if( !csvParseInt(begin(), end(), &x) || x < INT32_MIN || x > INT32_MAX )
+		return false;
+
+	if( value != NULL )
+		*value = (int)x;
+
+	return true;
+}
+
+// toInt64()
+inline bool csvField::toInt64( int64_t* value ) const
+{
+	int64_t x = 0;
+
+	if( !csvParseInt(begin(), end(), &x) )
+		return false;
+
+	if( value != NULL )
+		*value = x;
+
+	return true;
+}
+
+// toUInt64()
+inline bool csvField::toUInt64( uint64_t* value ) const
+{
+	int64_t x = 0;
+
+	if( !csvParseInt(begin(), end(), &x, false) )
+		return false;
+
+	if( value != NULL )
+		*value = (uint64_t)x;
+
+	return true;
+}
+
+// toFloat()
+inline bool csvField::toFloat( float* value ) const
+{
+	double x = 0.0;
+
+	if( !csvParseDouble(begin(), end(), &x) )
+		return false;
+
+	if( value != NULL )
+		*value = (float)x;
+
+	return true;
+}
+
+// toDouble()
+inline bool csvField::toDouble( double* value ) const
+{
+	double x = 0.0;
+
+	if( !csvParseDouble(begin(), end(), &x) )
+		return false;
+
+	if( value != NULL )
+		*value = x;
+
+	return true;
+}
+
+// toInt()
+inline int csvField::toInt( bool* valid ) const
+{
+	int x=0;
+	const bool v=toInt(&x);
+
+	if( valid != NULL )
+		*valid=v;
+
+	return x;
+}
+
+// toInt64()
+inline int64_t csvField::toInt64( bool* valid ) const
+{
+	int64_t x=0;
+	const bool v=toInt64(&x);
+
+	if( valid != NULL )
+		*valid=v;
+
+	return x;
+}
+
+// toUInt64()
+inline uint64_t csvField::toUInt64( bool* valid ) const
+{
+	uint64_t x=0;
+	const bool v=toUInt64(&x);
+
+	if( valid != NULL )
+		*valid=v;
+
+	return x;
+}
+
+// toFloat()
+inline float csvField::toFloat( bool* valid ) const
+{
+	float x=0.0f;
+	const bool v=toFloat(&x);
+
+	if( valid != NULL )
+		*valid=v;
+
+	return x;
+}
+
+// toDouble()
+inline double csvField::toDouble( bool* valid ) const
+{
+	double x=0.0;
+	const bool v=toDouble(&x);
+
+	if( valid != NULL )
+		*valid=v;
+
+	return x;
 }
 
 //-------------------------------------------------------------------------------------
 // constructor
-csvReader::csvReader( const char* filename, const char* delimiters ) : mFile(NULL)
+inline csvReader::csvReader( const char* filename, const char* delimiters ) : mData(NULL), mSize(0), mPos(0), mLine(0), mOpen(false)
 {
 	if( !filename || !delimiters )
 		return;
 
-	mFile = fopen(filename, "r");
+	const int fd = open(filename, O_RDONLY);
 
-	if( !mFile )
+	if( fd < 0 )
 	{
 		LogError("csvReader -- failed to open file %s\n", filename);
 		perror("csvReader -- error");
 		return;
 	}
 
+	struct stat fileStat;
+
+	if( fstat(fd, &fileStat) != 0 )
+	{
+		LogError("csvReader -- failed to get the size of file %s\n", filename);
+		close(fd);
+		return;
+	}
+
+	mSize = fileStat.st_size;
+
+	// map the whole file, and let the kernel read ahead since it's parsed sequentially
+	if( mSize > 0 )
+	{
+		void* data = mmap(NULL, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if( data == MAP_FAILED )
+		{
+			LogError("csvReader -- failed to map file %s\n", filename);
+			perror("csvReader -- error");
+			close(fd);
+			return;
+		}
+
+		madvise(data, mSize, MADV_SEQUENTIAL);
+		mData = (const char*)data;
+	}
+
+	close(fd);	// the mapping stays valid
+
 	mFilename = filename;
 	mDelimiters = delimiters;
+	mOpen = true;
 }
 
 // destructor
-csvReader::~csvReader()
+inline csvReader::~csvReader()
 {
 	Close();
 }
@@ -206,7 +542,7 @@ inline csvReader* csvReader::Open( const char* filename, const char* delimiters
 
 	csvReader* csv = new csvReader(filename, delimiters);
 
-	if( !csv->IsOpen() )
+	if( !csv->mOpen )
 	{
 		delete csv;
 		return NULL;
@@ -218,17 +554,19 @@ inline csvReader* csvReader::Open( const char* filename, const char* delimiters
 // close
 inline void csvReader::Close()
 {
-	if( IsClosed() )
-		return;
+	if( mData != NULL )
+		munmap((void*)mData, mSize);
 
-	fclose(mFile);
-	mFile = NULL;
+	mData = NULL;
+	mSize = 0;
+	mPos = 0;
+	mOpen = false;
 }
 
 // isOpen
 inline bool csvReader::IsOpen() const
 {
-	return mFile != NULL;
+	return mOpen && mPos < mSize;
 }
 
 // isClosed
@@ -237,6 +575,195 @@ inline bool csvReader::IsClosed() const
 	return !IsOpen();
 }
 
+// nextLine
+inline bool csvReader::nextLine( const char** begin, const char** end )
+{
+	while( mPos < mSize )
+	{
+		const char* line = mData + mPos;
+		const char* lineEnd = (const char*)memchr(line, '\n', mSize - mPos);
+
+		if( !lineEnd )
+			lineEnd = mData + mSize;
+
+		mPos = (lineEnd - mData) + 1;
+		mLine++;
+
+		if( lineEnd > line && lineEnd[-1] == '\r' )
+			lineEnd--;
+
+		// disregard empty lines and comments
+		if( lineEnd == line || line[0] == '#' )
+			continue;
+
+		*begin = line;
+		*end = lineEnd;
+		return true;
+	}
+
+	return false;
+}
+
+// addField
+inline void csvReader::addField( csvRow& row, const char* begin, const char* end )
+{
+	if( end > begin && end[-1] == '\r' )
+		end--;
+
+	if( mDelimiters.find(' ') != std::string::npos )
+		csvTrim(&begin, &end);
+
+	row.fields.push_back(csvField(begin, end - begin));
+}
+
+// Next
+inline bool csvReader::Next( csvRow& row )
+{
+	row.fields.clear();
+	row.buffer.clear();
+	row.buffered.clear();
+
+	const char* begin = NULL;
+	const char* end = NULL;
+
+	if( !mOpen || !nextLine(&begin, &end) )
+		return false;
+
+	row.lineNumber = mLine;
+
+	// quoted fields are parsed character-by-character
+	if( memchr(begin, '"', end - begin) != NULL )
+		return parseQuoted(row, begin);
+
+	// otherwise split the line on the delimiter
+	const char delimiter = (mDelimiters.length() > 0) ? mDelimiters[0] : ',';
+	const char* field = begin;
+
+	while( true )
+	{
+		const char* next = (const char*)memchr(field, delimiter, end - field);
+
+		if( !next )
+		{
+			addField(row, field, end);
+			break;
+		}
+
+		addField(row, field, next);
+		field = next + 1;
+	}
+
+	return true;
+}
+
+// parseQuoted
+inline bool csvReader::parseQuoted( csvRow& row, const char* line )
+{
+	const char delimiter = (mDelimiters.length() > 0) ? mDelimiters[0] : ',';
+	const char* limit = mData + mSize;
+	const char* p = line;
+
+	while( true )
+	{
+		// whitespace is only skipped to look for an opening quote (unquoted fields
+		// are trimmed by addField() the same as in Next(), if space is a delimiter)
+		const char* field = p;
+
+		while( field < limit && (*field == ' ' || *field == '\t') && *field != delimiter )
+			field++;
+
+		if( field < limit && *field == '"' )
+		{
+			// find the closing quote, skipping "" escapes
+			const char* begin = field + 1;
+			const char* end = limit;
+			bool escaped = false;
+
+			p = begin;
+
+			while( p < limit )
+			{
+				const char* quote = (const char*)memchr(p, '"', limit - p);
+
+				if( !quote )
+				{
+					LogWarning("csvReader -- unterminated quote on line %llu of %s\n", (unsigned long long)row.lineNumber, mFilename.c_str());
+					p = limit;
+					break;
+				}
+
+				if( quote + 1 < limit && quote[1] == '"' )
+				{
+					escaped = true;
+					p = quote + 2;
+					continue;
+				}
+
+				end = quote;
+				p = quote + 1;
+				break;
+			}
+
+			if( escaped )
+			{
+				const size_t offset = row.buffer.size();
+
+				for( const char* c=begin; c < end; c++ )
+				{
+					row.buffer.push_back(*c);
+
+					if( *c == '"' )
+						c++;
+				}
+
+				row.buffered.push_back(std::make_pair(row.fields.size(), offset));
+				row.fields.push_back(csvField(NULL, row.buffer.size() - offset));
+			}
+			else
+			{
+				row.fields.push_back(csvField(begin, end - begin));
+			}
+
+			// ignore anything between the closing quote and the delimiter
+			while( p < limit && *p != delimiter && *p != '\n' )
+				p++;
+		}
+		else
+		{
+			const char* begin = p;
+
+			while( p < limit && *p != delimiter && *p != '\n' )
+				p++;
+
+			addField(row, begin, p);
+		}
+
+		if( p >= limit )
+			break;
+
+		if( *(p++) == '\n' )
+			break;
+	}
+
+	// quoted fields can span lines
+	for( const char* c=line; c < p; c++ )
+	{
+		if( *c == '\n' )
+			mLine++;
+	}
+
+	if( p > line && p[-1] == '\n' )
+		mLine--;	// already counted by nextLine()
+
+	mPos = p - mData;
+
+	// point the unescaped fields into the row's buffer (now that it's done growing)
+	for( size_t n=0; n < row.buffered.size(); n++ )
+		row.fields[row.buffered[n].first].data = row.buffer.data() + row.buffered[n].second;
+
+	return true;
+}
+
 // readLine
 inline std::vector<csvData> csvReader::Read()
 {
@@ -248,6 +775,7 @@ inline std::vector<csvData> csvReader::Read( const char* delimiters )
 {
 	std::vector<csvData> tokens;
 	Read(tokens, delimiters);
+	return tokens;
 }
 
 // readLine
@@ -259,33 +787,23 @@ inline bool csvReader::Read( std::vector<csvData>& data )
 // readLine
 inline bool csvReader::Read( std::vector<csvData>& data, const char* delimiters )
 {
-	if( IsClosed() )
-		return false;
-
-	// read the next line
-	char str[MaxLineLength];
+	const char* begin = NULL;
+	const char* end = NULL;
 
-	if( fgets(str, sizeof(str), mFile) == NULL )
+	if( !mOpen || !nextLine(&begin, &end) )
 	{
-		if( ferror(mFile) )
-		{
-			LogError("csvReader -- error reading file %s\n", mFilename.c_str());
-			perror("csvReader -- error");
-		}
-
-		Close();
+		data.clear();
 		return false;
 	}
 
-	// check if EOF was reached
-	if( feof(mFile) == EOF )
-		Close();
-
-	// disregard comments
-	if( str[0] == '#' )
-		return Read(data, delimiters);
+	return csvData::Parse(data, begin, end, delimiters);
+}
 
-	return csvData::Parse(data, str, delimiters);
+// Rewind
+inline void csvReader::Rewind()
+{
+	mPos = 0;
+	mLine = 0;
 }
 
 // SetDelimiters
@@ -306,5 +824,16 @@ inline const char* csvReader::GetFilename() const
 	return mFilename.c_str();
 }
 
-#endif
+// GetSize
+inline size_t csvReader::GetSize() const
+{
+	return mSize;
+}
 
+// GetPosition
+inline size_t csvReader::GetPosition() const
+{
+	return (mPos < mSize) ? mPos : mSize;
+}
+
+#endif
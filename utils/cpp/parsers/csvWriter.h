@@ -23,20 +23,27 @@
 #ifndef __CSV_WRITER_H_
 #define __CSV_WRITER_H_
 
-#include <iostream>
-#include <fstream>
-
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <errno.h>
 
 #include <string>
 #include <vector>
-#include <iostream>
+#include <sstream>
+#include <type_traits>
 
 
 /**
- * csvWriter
+ * csvWriter buffers the output and formats numbers itself (instead of going
+ * through iostreams), only writing to the file when the buffer fills up,
+ * Flush() is called, or the file is closed.
+ *
+ * Floating-point values are written with up to `precision` digits after the
+ * decimal point (6 by default) with the trailing zeros removed.  Strings that
+ * contain the delimiter, quotes, or newlines are quoted, as are strings with
+ * leading or trailing whitespace (or a leading #) so that they're read back as-is.
+ *
  * @ingroup csv
  */
 class csvWriter
@@ -85,13 +92,52 @@ public:
 	// retrieve default delimiter
 	inline const char* GetDelimiter() const;
 
+	// set the number of digits written after the decimal point
+	inline void SetPrecision( uint32_t precision );
+
+	// retrieve the number of digits written after the decimal point
+	inline uint32_t GetPrecision() const;
+
 	// retrieve the filename
 	inline const char* GetFilename() const;
 
+	// size of the output buffer (in bytes)
+	static const size_t BufferSize = 256 * 1024;
+
 private:
-	std::ofstream mFile;
+	// formatters for the different types of values
+	inline void append( const char* str, size_t length );
+	inline void append( const char* str );
+	inline void append( char* str )			{ append((const char*)str); }
+	inline void append( const std::string& str );
+	inline void append( char value );
+	inline void append( bool value );
+	inline void appendInt( int64_t value );
+	inline void appendUInt( uint64_t value );
+	inline void appendFloat( double value );
+
+	template<typename T>
+	inline typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type append( const T& value )	{ appendInt(value); }
+
+	template<typename T>
+	inline typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type append( const T& value )	{ appendUInt(value); }
+
+	template<typename T>
+	inline typename std::enable_if<std::is_floating_point<T>::value>::type append( const T& value )				{ appendFloat(value); }
+
+	template<typename T>
+	inline typename std::enable_if<!std::is_arithmetic<T>::value>::type append( const T& value )					{ std::ostringstream ss; ss << value; append(ss.str()); }
+
+	inline void reserve( size_t length );
+
+	FILE* mFile;
+	char* mBuffer;
+	size_t mBufferUsed;
+
 	std::string   mFilename;
 	std::string   mDelimiter;
+	std::string   mQuoteChars;	// characters that strings need to be quoted for
+	uint32_t	    mPrecision;
 	bool		    mNewLine;
 };
 
@@ -111,4 +157,3 @@ namespace csv
 #include "csvWriter.hpp"
 
 #endif
-
@@ -27,31 +27,44 @@
 #include "csvWriter.h"
 #include "logging.h"
 
+#include <math.h>
+#include <string.h>
+
 
 // constructor
-csvWriter::csvWriter( const char* filename, const char* delimiter )
+inline csvWriter::csvWriter( const char* filename, const char* delimiter ) : mFile(NULL), mBuffer(NULL), mBufferUsed(0), mPrecision(6), mNewLine(true)
 {
 	if( !filename || !delimiter )
 		return;
 
-	mFile.open(filename);
+	mFile = fopen(filename, "w");
 
-	if( !IsOpen() )
+	if( !mFile )
 	{
 		LogError("csvWriter -- failed to open file %s\n", filename);
 		return;
 	}
 
-	mFilename  = filename;
-	mDelimiter = delimiter;
-	mNewLine   = true;
+	mBuffer = (char*)malloc(BufferSize);
+
+	if( !mBuffer )
+	{
+		LogError("csvWriter -- failed to allocate %zu bytes for the output buffer\n", BufferSize);
+		fclose(mFile);
+		mFile = NULL;
+		return;
+	}
+
+	mFilename = filename;
+	SetDelimiter(delimiter);
 }
 
 
 // destructor
-csvWriter::~csvWriter()
+inline csvWriter::~csvWriter()
 {
 	Close();
+	free(mBuffer);
 }
 
 	
@@ -79,19 +92,27 @@ inline void csvWriter::Close()
 		return;
 
 	Flush();
-	mFile.close();
+	fclose(mFile);
+	mFile = NULL;
 }
 
 // flush
 inline void csvWriter::Flush()
 {
-	mFile.flush();
+	if( IsClosed() )
+		return;
+
+	if( mBufferUsed > 0 && fwrite(mBuffer, 1, mBufferUsed, mFile) != mBufferUsed )
+		LogError("csvWriter -- failed to write to file %s\n", mFilename.c_str());
+
+	mBufferUsed = 0;
+	fflush(mFile);
 }
 
 // isOpen
 inline bool csvWriter::IsOpen() const
 {
-	return mFile.is_open();
+	return mFile != NULL;
 }
 
 // isClosed
@@ -103,7 +124,7 @@ inline bool csvWriter::IsClosed() const
 // EndLine
 inline void csvWriter::EndLine()
 {
-	mFile << std::endl;
+	append("\n", 1);
 	mNewLine = true;
 }
 
@@ -112,11 +133,11 @@ template<typename T>
 inline csvWriter& csvWriter::Write( const T& value )
 {
 	if( !mNewLine )
-		mFile << mDelimiter;
+		append(mDelimiter.c_str(), mDelimiter.length());
 	else
 		mNewLine = false;
 
-	mFile << value;
+	append(value);
 	return *this;
 }
 
@@ -152,10 +173,191 @@ inline csvWriter& csvWriter::operator << ( csvWriter& (*value)(csvWriter&) )
 	return value(*this);
 }
 
+// reserve space in the buffer (writing it out if needed)
+inline void csvWriter::reserve( size_t length )
+{
+	if( mBufferUsed + length <= BufferSize )
+		return;
+
+	const size_t used = mBufferUsed;
+
+	if( used > 0 && fwrite(mBuffer, 1, used, mFile) != used )
+		LogError("csvWriter -- failed to write to file %s\n", mFilename.c_str());
+
+	mBufferUsed = 0;
+}
+
+// append characters
+inline void csvWriter::append( const char* str, size_t length )
+{
+	if( IsClosed() || length == 0 )
+		return;
+
+	// strings bigger than the buffer are written directly
+	if( length > BufferSize )
+	{
+		reserve(BufferSize);
+		fwrite(str, 1, length, mFile);
+		return;
+	}
+
+	reserve(length);
+	memcpy(mBuffer + mBufferUsed, str, length);
+	mBufferUsed += length;
+}
+
+// append string (quoted if needed)
+inline void csvWriter::append( const char* str )
+{
+	if( !str )
+		return;
+
+	const size_t length = strlen(str);
+
+	// leading/trailing whitespace gets trimmed by readers that split on spaces,
+	// and a leading # would make the line a comment, unless they're quoted
+	const bool pad = (length > 0) && (str[0] == ' ' || str[0] == '\t' || str[0] == '#' ||
+	                                 str[length-1] == ' ' || str[length-1] == '\t');
+
+	if( !pad && strpbrk(str, mQuoteChars.c_str()) == NULL )
+	{
+		append(str, length);
+		return;
+	}
+
+	// quote the string, and escape quotes as ""
+	append("\"", 1);
+
+	while( true )
+	{
+		const char* quote = strchr(str, '"');
+
+		if( !quote )
+		{
+			append(str, strlen(str));
+			break;
+		}
+
+		append(str, quote - str + 1);
+		append("\"", 1);
+		str = quote + 1;
+	}
+
+	append("\"", 1);
+}
+
+// append string
+inline void csvWriter::append( const std::string& str )
+{
+	append(str.c_str());
+}
+
+// append char
+inline void csvWriter::append( char value )
+{
+	const char str[2] = { value, '\0' };
+	append(str);
+}
+
+// append bool
+inline void csvWriter::append( bool value )
+{
+	append(value ? "1" : "0", 1);
+}
+
+// append unsigned integer
+inline void csvWriter::appendUInt( uint64_t value )
+{
+	char str[24];
+	char* p = str + sizeof(str);
+
+	do
+	{
+		*(--p) = '0' + (value % 10);
+		value /= 10;
+	} while( value != 0 );
+
+	append(p, str + sizeof(str) - p);
+}
+
+// append signed integer
+inline void csvWriter::appendInt( int64_t value )
+{
+	if( value < 0 )
+	{
+		append("-", 1);
+		appendUInt(0 - (uint64_t)value);
+	}
+	else
+	{
+		appendUInt(value);
+	}
+}
+
+// append floating-point
+inline void csvWriter::appendFloat( double value )
+{
+	static const uint64_t pow10[] = { 1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 
+							    1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL };
+
+	const uint64_t scale = pow10[mPrecision];
+	const double magnitude = fabs(value);
+
+	// values that don't fit in fixed-point (or would round to zero) use printf
+	if( !(magnitude < 9.0e18 / scale) || (magnitude != 0.0 && magnitude * scale < 0.5) )
+	{
+		char str[32];
+		const int length = snprintf(str, sizeof(str), "%.*g", mPrecision + 1, value);
+
+		if( length > 0 )
+			append(str, length);
+
+		return;
+	}
+
+	const uint64_t scaled = (uint64_t)(magnitude * scale + 0.5);
+	uint64_t fraction = scaled % scale;
+
+	if( value < 0.0 && scaled != 0 )
+		append("-", 1);
+
+	appendUInt(scaled / scale);
+
+	if( fraction == 0 )
+		return;
+
+	// write the fraction with leading zeros, and without trailing zeros
+	char str[16];
+	uint32_t digits = mPrecision;
+
+	while( fraction % 10 == 0 )
+	{
+		fraction /= 10;
+		digits--;
+	}
+
+	str[0] = '.';
+
+	for( uint32_t n=digits; n > 0; n-- )
+	{
+		str[n] = '0' + (fraction % 10);
+		fraction /= 10;
+	}
+
+	append(str, digits + 1);
+}
+
 // SetDelimiter
 inline void csvWriter::SetDelimiter( const char* delimiter )
 {
 	mDelimiter = delimiter;
+	mQuoteChars = "\"\r\n";
+
+	for( size_t n=0; n < mDelimiter.length(); n++ )
+	{
+		if( mDelimiter[n] != ' ' )
+			mQuoteChars += mDelimiter[n];
+	}
 }
 
 // GetDelimiter
@@ -164,6 +366,18 @@ inline const char* csvWriter::GetDelimiter() const
 	return mDelimiter.c_str();
 }
 
+// SetPrecision
+inline void csvWriter::SetPrecision( uint32_t precision )
+{
+	mPrecision = (precision > 9) ? 9 : precision;
+}
+
+// GetPrecision
+inline uint32_t csvWriter::GetPrecision() const
+{
+	return mPrecision;
+}
+
 // GetFilename
 inline const char* csvWriter::GetFilename() const
 {
@@ -191,4 +405,3 @@ inline static csvWriter& flush( csvWriter& file )
 }
 
 #endif
-
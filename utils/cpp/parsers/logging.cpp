@@ -21,13 +21,450 @@
  */
  
 #include "logging.h"
+
+#include "Thread.h"
+#include "Event.h"
+#include "Mutex.h"
+
 #include <strings.h>
+#include <stdlib.h>
+#include <signal.h>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
 
 
 // set default logging options
 Log::Level Log::mLevel = Log::DEFAULT;
 FILE* Log::mFile = stdout;
 std::string Log::mFilename = "stdout";
+bool Log::mAsync = false;
+
+
+//-----------------------------------------------------------------------------------
+// Asynchronous logging
+//
+// Each thread that logs gets its own single-producer/single-consumer ringbuffer,
+// so the hot path is a couple of memcpy's and an atomic store (no locks).
+// Records are variable-sized and stored contiguously - if a record doesn't fit
+// before the end of the buffer, a padding record fills the rest and it wraps.
+// The writer thread collects the records from all the rings, orders them by a
+// global sequence number, and formats/writes them in batches.
+//-----------------------------------------------------------------------------------
+struct LogRecord
+{
+	uint32_t size;		// size of the record in bytes (including this header and the args)
+	uint32_t level;	// the Log::Level, or LOG_RECORD_PADDING
+	uint64_t sequence;
+	const char* format;
+	int (*formatter)( char* output, size_t size, const char* format, const uint8_t* args );
+};
+
+#define LOG_RECORD_PADDING  0xFFFFFFFF
+#define LOG_RECORD_ALIGN(x) (((x) + 7) & ~size_t(7))
+#define LOG_BATCH_SIZE      65536
+#define LOG_WRITER_SLEEP    20		// milliseconds between writes when nothing urgent is logged
+
+struct LogRing
+{
+	uint8_t* buffer;
+	size_t   capacity;		// power-of-two
+
+	std::atomic<uint64_t> head;	// written by the producer
+	std::atomic<uint64_t> tail;	// written by the writer
+	std::atomic<bool> orphaned;	// the producer thread exited
+
+	uint64_t pending;			// producer-only, the head after the record being written
+};
+
+struct LogRingOwner
+{
+	LogRing* ring;
+
+	LogRingOwner() : ring(NULL)	{}
+	~LogRingOwner()			{ if( ring != NULL ) ring->orphaned.store(true, std::memory_order_release); }
+};
+
+struct LogAsyncState
+{
+	Mutex registryMutex;
+	Mutex drainMutex;
+	Event wake;
+
+	std::vector<LogRing*> rings;
+	size_t ringSize;
+
+	Thread* writer;
+	std::atomic<bool> running;
+
+	std::atomic<uint64_t> sequence;
+	std::atomic<uint64_t> dropped;
+	uint64_t droppedReported;
+
+	char batch[LOG_BATCH_SIZE];
+
+	// the state is never freed, so it outlives static destructors and atexit()
+	LogAsyncState() : ringSize(65536), writer(NULL), running(false), sequence(0), dropped(0), droppedReported(0) {}
+};
+
+static LogAsyncState* gLogAsync = NULL;
+static thread_local LogRingOwner gLogRing;
+
+static const int gLogCrashSignals[] = { SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL };
+static struct sigaction gLogCrashPrevious[sizeof(gLogCrashSignals)/sizeof(int)];
+
+
+// logWrite
+static void logWrite( const char* str, size_t size )
+{
+	if( size > 0 )
+		fwrite(str, 1, size, Log::GetFile());
+}
+
+
+// logDrain
+static bool logDrain( bool wait=true )
+{
+	LogAsyncState* state = gLogAsync;
+
+	if( !state )
+		return false;
+
+	if( wait )
+		state->drainMutex.Lock();
+	else if( !state->drainMutex.AttemptLock() )
+		return false;
+
+	// snapshot the rings
+	std::vector<LogRing*> rings;
+
+	state->registryMutex.Lock();
+	rings = state->rings;
+	state->registryMutex.Unlock();
+
+	// collect the committed records from each ring
+	std::vector<uint64_t> heads(rings.size());
+	std::vector<std::pair<uint64_t, const LogRecord*>> records;
+
+	for( size_t n=0; n < rings.size(); n++ )
+	{
+		LogRing* ring = rings[n];
+
+		const uint64_t head = ring->head.load(std::memory_order_acquire);
+		uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+
+		while( tail < head )
+		{
+			const LogRecord* record = (const LogRecord*)(ring->buffer + (tail & (ring->capacity - 1)));
+
+			if( record->level != LOG_RECORD_PADDING )
+				records.push_back(std::make_pair(record->sequence, record));
+
+			tail += record->size;
+		}
+
+		heads[n] = head;
+	}
+
+	std::sort(records.begin(), records.end());
+
+	// format the messages into batches
+	size_t batchUsed = 0;
+
+	for( size_t n=0; n < records.size(); n++ )
+	{
+		const LogRecord* record = records[n].second;
+		const uint8_t* args = (const uint8_t*)record + sizeof(LogRecord);
+
+		int length = record->formatter(state->batch + batchUsed, LOG_BATCH_SIZE - batchUsed, record->format, args);
+
+		if( length < 0 )
+			continue;
+
+		if( (size_t)length >= LOG_BATCH_SIZE - batchUsed )
+		{
+			logWrite(state->batch, batchUsed);
+			batchUsed = 0;
+
+			if( length < LOG_BATCH_SIZE )
+			{
+				length = record->formatter(state->batch, LOG_BATCH_SIZE, record->format, args);
+			}
+			else
+			{
+				// larger than the batch buffer, so format it on its own
+				std::vector<char> large(length + 1);
+				record->formatter(large.data(), large.size(), record->format, args);
+				logWrite(large.data(), length);
+				length = 0;
+			}
+		}
+
+		batchUsed += length;
+	}
+
+	logWrite(state->batch, batchUsed);
+
+	// report any messages that were dropped since last time
+	const uint64_t dropped = state->dropped.load(std::memory_order_relaxed);
+
+	if( dropped > state->droppedReported )
+	{
+		fprintf(Log::GetFile(), LOG_COLOR_YELLOW "[log] dropped %llu messages (ringbuffer full)\n" LOG_COLOR_RESET, 
+			   (unsigned long long)(dropped - state->droppedReported));
+
+		state->droppedReported = dropped;
+	}
+
+	fflush(Log::GetFile());
+
+	// release the space back to the producers
+	for( size_t n=0; n < rings.size(); n++ )
+		rings[n]->tail.store(heads[n], std::memory_order_release);
+
+	// free the rings of threads that have exited
+	state->registryMutex.Lock();
+
+	for( size_t n=0; n < state->rings.size(); )
+	{
+		LogRing* ring = state->rings[n];
+
+		if( ring->orphaned.load(std::memory_order_acquire) && ring->tail.load() == ring->head.load() )
+		{
+			state->rings.erase(state->rings.begin() + n);
+			free(ring->buffer);
+			delete ring;
+		}
+		else
+		{
+			n++;
+		}
+	}
+
+	state->registryMutex.Unlock();
+	state->drainMutex.Unlock();
+
+	return true;
+}
+
+
+// logWriterThread
+static void* logWriterThread( void* param )
+{
+	LogAsyncState* state = (LogAsyncState*)param;
+
+	while( state->running.load() )
+	{
+		state->wake.Wait((uint64_t)LOG_WRITER_SLEEP);
+		logDrain();
+	}
+
+	return NULL;
+}
+
+
+// logFlushAtExit
+static void logFlushAtExit()
+{
+	logDrain();
+}
+
+
+// logCrashHandler
+static void logCrashHandler( int signum )
+{
+	// best-effort:  this isn't async-signal-safe, but the alternative is losing the messages
+	logDrain(false);
+
+	// restore the previous handler and re-raise the signal
+	for( size_t n=0; n < sizeof(gLogCrashSignals)/sizeof(int); n++ )
+	{
+		if( gLogCrashSignals[n] == signum )
+			sigaction(signum, &gLogCrashPrevious[n], NULL);
+	}
+
+	raise(signum);
+}
+
+
+// SetAsync
+void Log::SetAsync( bool async, size_t ringSize )
+{
+	if( !async )
+	{
+		if( !gLogAsync || !mAsync )
+			return;
+
+		mAsync = false;
+
+		gLogAsync->running.store(false);
+		gLogAsync->wake.Wake();
+
+		if( gLogAsync->writer != NULL )
+		{
+			gLogAsync->writer->Stop(true);
+			delete gLogAsync->writer;
+			gLogAsync->writer = NULL;
+		}
+
+		logDrain();
+		return;
+	}
+
+	if( !gLogAsync )
+	{
+		gLogAsync = new LogAsyncState();
+
+		atexit(logFlushAtExit);
+
+		struct sigaction action;
+		memset(&action, 0, sizeof(action));
+		
+		action.sa_handler = logCrashHandler;
+		sigemptyset(&action.sa_mask);
+
+		for( size_t n=0; n < sizeof(gLogCrashSignals)/sizeof(int); n++ )
+			sigaction(gLogCrashSignals[n], &action, &gLogCrashPrevious[n]);
+	}
+
+	// round up to a power-of-two (this applies to threads that haven't logged yet)
+	size_t capacity = 4096;
+
+	while( capacity < ringSize )
+		capacity *= 2;
+
+	gLogAsync->ringSize = capacity;
+
+	if( !gLogAsync->writer )
+	{
+		gLogAsync->running.store(true);
+		gLogAsync->writer = new Thread();
+
+		if( !gLogAsync->writer->Start(logWriterThread, gLogAsync) )
+		{
+			delete gLogAsync->writer;
+			gLogAsync->writer = NULL;
+			gLogAsync->running.store(false);
+
+			LogError("failed to start asynchronous logging thread\n");
+			return;
+		}
+	}
+
+	mAsync = true;
+}
+
+
+// Flush
+void Log::Flush()
+{
+	if( !logDrain() )
+		fflush(mFile);
+}
+
+
+// GetDropped
+uint64_t Log::GetDropped()
+{
+	return (gLogAsync != NULL) ? gLogAsync->dropped.load() : 0;
+}
+
+
+// reserve
+uint8_t* Log::reserve( Level level, size_t argsSize, const char* format, Formatter formatter )
+{
+	LogAsyncState* state = gLogAsync;
+
+	if( !state )
+		return NULL;
+
+	LogRing* ring = gLogRing.ring;
+
+	if( !ring )
+	{
+		// first message from this thread, allocate it's ringbuffer
+		ring = new LogRing();
+
+		ring->capacity = state->ringSize;
+		ring->buffer   = (uint8_t*)malloc(ring->capacity);
+		ring->pending  = 0;
+
+		ring->head.store(0);
+		ring->tail.store(0);
+		ring->orphaned.store(false);
+
+		if( !ring->buffer )
+		{
+			delete ring;
+			state->dropped++;
+			return NULL;
+		}
+
+		state->registryMutex.Lock();
+		state->rings.push_back(ring);
+		state->registryMutex.Unlock();
+
+		gLogRing.ring = ring;
+	}
+
+	const size_t size = LOG_RECORD_ALIGN(sizeof(LogRecord) + argsSize);
+
+	if( size > ring->capacity / 2 )
+	{
+		state->dropped++;
+		return NULL;
+	}
+
+	uint64_t head = ring->head.load(std::memory_order_relaxed);
+	const uint64_t tail = ring->tail.load(std::memory_order_acquire);
+
+	const size_t offset = head & (ring->capacity - 1);
+	const size_t contiguous = ring->capacity - offset;
+	const size_t padding = (contiguous < size) ? contiguous : 0;
+
+	if( (head - tail) + padding + size > ring->capacity )
+	{
+		state->dropped++;
+		return NULL;
+	}
+
+	// fill the rest of the buffer with padding, so the record is contiguous
+	if( padding > 0 )
+	{
+		LogRecord* pad = (LogRecord*)(ring->buffer + offset);
+
+		pad->size  = padding;
+		pad->level = LOG_RECORD_PADDING;
+
+		head += padding;
+	}
+
+	LogRecord* record = (LogRecord*)(ring->buffer + (head & (ring->capacity - 1)));
+
+	record->size      = size;
+	record->level     = level;
+	record->sequence  = state->sequence.fetch_add(1, std::memory_order_relaxed);
+	record->format    = format;
+	record->formatter = formatter;
+
+	ring->pending = head + size;
+	return (uint8_t*)record + sizeof(LogRecord);
+}
+
+
+// commit
+void Log::commit( Level level )
+{
+	LogRing* ring = gLogRing.ring;
+
+	const uint64_t head = ring->pending;
+	ring->head.store(head, std::memory_order_release);
+
+	// errors and warnings are written out right away, everything else is batched
+	if( level <= WARNING || (head - ring->tail.load(std::memory_order_relaxed)) > ring->capacity / 2 )
+		gLogAsync->wake.Wake();
+}
 
 
 // ParseCmdLine
@@ -56,6 +493,9 @@ void Log::ParseCmdLine( const commandLine& cmdLine )
 	}
 
 	SetFile(cmdLine.GetString("log-file"));
+
+	if( cmdLine.GetFlag("log-async") )
+		SetAsync(true);
 	
 	// disable buffering so that the post-newline color resets are used (https://stackoverflow.com/a/1716621)
 	if( mFile == stdout )
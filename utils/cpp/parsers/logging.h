@@ -26,6 +26,8 @@
 #include "commandLine.h"
 
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
 #include <string>
 
 
@@ -44,7 +46,8 @@
 		  "                             * verbose (default)\n"							\
 		  "                             * debug\n"									\
 		  "  --verbose              enable verbose logging (same as --log-level=verbose)\n"  \
-		  "  --debug                enable debug logging   (same as --log-level=debug)\n\n"
+		  "  --debug                enable debug logging   (same as --log-level=debug)\n"    \
+		  "  --log-async            format and write messages on a background thread\n\n"
 
 
 /**
@@ -104,6 +107,38 @@ public:
 	 */
 	static void SetFile( const char* filename );
 
+	/**
+	 * Enable or disable asynchronous logging.
+	 *
+	 * When enabled, the logging macros copy the format string pointer and the
+	 * arguments into a lock-free ringbuffer owned by the calling thread, and a
+	 * background thread formats and writes the messages in batches (ordered by
+	 * when they were logged).  Messages are dropped if a thread's ringbuffer is full,
+	 * see GetDropped().  Pending messages are flushed at exit, when asynchronous
+	 * logging is disabled, and on a best-effort basis when the process crashes.
+	 *
+	 * This can be enabled from the command line with `--log-async`.
+	 * @param ringSize the size (in bytes) of each thread's ringbuffer.
+	 */
+	static void SetAsync( bool async, size_t ringSize=65536 );
+
+	/**
+	 * Check if asynchronous logging is enabled.
+	 */
+	static inline bool IsAsync()				{ return mAsync; }
+
+	/**
+	 * Write out all pending messages (when asynchronous logging is enabled).
+	 * This blocks until the messages have been written to the log file.
+	 */
+	static void Flush();
+
+	/**
+	 * Get the number of messages that were dropped because a thread's
+	 * ringbuffer was full (when asynchronous logging is enabled).
+	 */
+	static uint64_t GetDropped();
+
 	/**
 	 * Usage string for command line arguments to Create()
 	 */
@@ -129,10 +164,24 @@ public:
 	 */
 	static Level LevelFromStr( const char* str );
 
+	/**
+	 * Queue a message for asynchronous logging.
+	 * This is used by the logging macros when IsAsync() is enabled.
+	 * @internal
+	 */
+	template<typename... Args> 
+	static inline void Enqueue( Level level, const char* format, Args... args );
+
 protected:
+	typedef int (*Formatter)( char* output, size_t size, const char* format, const uint8_t* args );
+
+	static uint8_t* reserve( Level level, size_t argsSize, const char* format, Formatter formatter );
+	static void commit( Level level );
+
 	static Level 	    mLevel;
 	static FILE* 	    mFile;
 	static std::string mFilename;
+	static bool        mAsync;
 };
 
 
@@ -141,7 +190,7 @@ protected:
  * @ingroup log
  * @internal
  */
-#define GenericLogMessage(level, format, args...) if( level <= Log::GetLevel() ) fprintf(Log::GetFile(), format, ## args)
+#define GenericLogMessage(level, format, args...) if( level <= Log::GetLevel() ) (Log::IsAsync() ? Log::Enqueue(level, format, ## args) : (void)fprintf(Log::GetFile(), format, ## args))
 
 /**
  * Log a printf-style error message (Log::ERROR)
@@ -227,6 +276,105 @@ protected:
 	#define LOG_LEVEL_PREFIX_DEBUG	""
 #endif
 
+/**
+ * Serializes printf arguments for asynchronous logging.  Strings are copied
+ * into the record (because they may not outlive the call), and everything else
+ * is copied by value the same way it would be passed through varargs.
+ */
+template<typename T> struct LogArg
+{
+	typedef T Stored;
+
+	static inline size_t size( const T& value )					{ return sizeof(T); }
+	static inline uint8_t* store( uint8_t* ptr, const T& value )	{ memcpy(ptr, &value, sizeof(T)); return ptr + sizeof(T); }
+	static inline T load( const uint8_t*& ptr )					{ T value; memcpy(&value, ptr, sizeof(T)); ptr += sizeof(T); return value; }
+};
+
+template<> struct LogArg<const char*>
+{
+	typedef const char* Stored;
+
+	static inline size_t size( const char* str )		{ return sizeof(uint32_t) + (str != NULL ? strlen(str) + 1 : 0); }
+
+	static inline uint8_t* store( uint8_t* ptr, const char* str )
+	{
+		const uint32_t length = (str != NULL) ? strlen(str) + 1 : 0;
+		memcpy(ptr, &length, sizeof(uint32_t));
+		memcpy(ptr + sizeof(uint32_t), str, length);
+		return ptr + sizeof(uint32_t) + length;
+	}
+
+	static inline const char* load( const uint8_t*& ptr )
+	{
+		uint32_t length = 0;
+		memcpy(&length, ptr, sizeof(uint32_t));
+		const char* str = (length > 0) ? (const char*)ptr + sizeof(uint32_t) : NULL;
+		ptr += sizeof(uint32_t) + length;
+		return str;
+	}
+};
+
+template<> struct LogArg<char*> : LogArg<const char*> {};
+
+/**
+ * Deserializes the arguments one at a time (so they're read in order)
+ * and then formats the message with snprintf().
+ */
+template<typename... Remaining> struct LogFormatter;
+
+template<> struct LogFormatter<>
+{
+	template<typename... Values>
+	static inline int format( char* output, size_t size, const char* format, const uint8_t* args, Values... values )
+	{
+	#pragma GCC diagnostic push
+	#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+	#pragma GCC diagnostic ignored "-Wformat-security"
+		return snprintf(output, size, format, values...);
+	#pragma GCC diagnostic pop
+	}
+};
+
+template<typename First, typename... Rest> struct LogFormatter<First, Rest...>
+{
+	template<typename... Values>
+	static inline int format( char* output, size_t size, const char* format, const uint8_t* args, Values... values )
+	{
+		const typename LogArg<First>::Stored value = LogArg<First>::load(args);
+		return LogFormatter<Rest...>::format(output, size, format, args, values..., value);
+	}
+};
+
+template<typename... Args> struct LogRecordFormatter
+{
+	static int format( char* output, size_t size, const char* format, const uint8_t* args )
+	{
+		return LogFormatter<Args...>::format(output, size, format, args);
+	}
+};
+
+// Enqueue
+template<typename... Args> 
+inline void Log::Enqueue( Level level, const char* format, Args... args )
+{
+	const size_t sizes[] = { 0, LogArg<Args>::size(args)... };
+	size_t argsSize = 0;
+
+	for( size_t n=0; n < sizeof(sizes) / sizeof(size_t); n++ )
+		argsSize += sizes[n];
+
+	uint8_t* ptr = reserve(level, argsSize, format, &LogRecordFormatter<Args...>::format);
+
+	if( !ptr )
+		return;
+
+	// braced initializers are evaluated in order, so the arguments are stored in order
+	const int stored[] = { 0, (ptr = LogArg<Args>::store(ptr, args), 0)... };
+	(void)stored;
+
+	commit(level);
+}
+
 ///@}
 
 #endif
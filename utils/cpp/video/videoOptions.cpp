@@ -37,8 +37,10 @@ videoOptions::videoOptions()
 	bitRate     = 0;
 	numBuffers  = 4;
 	loop        = 0;
+	prefetch    = 0;
 	latency     = 10;
 	zeroCopy    = true;
+	zeroCopyInput = false;
 	ioType      = INPUT;
 	deviceType  = DEVICE_DEFAULT;
 	flipMethod  = FLIP_DEFAULT;
@@ -68,6 +70,9 @@ void videoOptions::Print( const char* prefix ) const
 	if( save.path.length() > 0 )
 		LogInfo("  -- save:       %s\n", save.path.c_str());
 
+	for( size_t n=0; n < fanout.size(); n++ )
+		LogInfo("  -- fanout:     %s\n", fanout[n].string.c_str());
+
 	if( deviceType != DEVICE_CSI && deviceType != DEVICE_DISPLAY )
 	{
 		LogInfo("  -- codec:      %s\n", CodecToStr(codec));
@@ -94,6 +99,12 @@ void videoOptions::Print( const char* prefix ) const
 	
 		if( deviceType != DEVICE_CSI && deviceType != DEVICE_V4L2 )
 			LogInfo("  -- loop:       %i\n", loop);
+
+		if( deviceType == DEVICE_FILE && prefetch > 0 )
+			LogInfo("  -- prefetch:   %u\n", prefetch);
+
+		if( zeroCopyInput )
+			LogInfo("  -- zeroCopyInput: true\n");
 	}
 	
 	if( deviceType == DEVICE_IP )
@@ -170,6 +181,37 @@ bool videoOptions::Parse( const char* URI, const commandLine& cmdLine, videoOpti
 		}
 	}
 	
+	// parse the fanout URIs that share the encoded stream
+	const char* fanout_str = (type == OUTPUT) ? cmdLine.GetString("output-fanout") : NULL;
+
+	if( fanout_str != NULL )
+	{
+		fanout.clear();
+
+		std::string remaining = fanout_str;
+
+		while( remaining.length() > 0 )
+		{
+			const size_t delim = remaining.find(',');
+			const std::string str = remaining.substr(0, delim);
+
+			remaining = (delim != std::string::npos) ? remaining.substr(delim + 1) : "";
+
+			if( str.length() == 0 )
+				continue;
+
+			URI uri;
+
+			if( !uri.Parse(str.c_str()) )
+			{
+				LogError(LOG_VIDEO "videoOptions -- failed to parse --output-fanout URI (%s)\n", str.c_str());
+				return false;
+			}
+
+			fanout.push_back(uri);
+		}
+	}
+
 	// parse stream settings
 	numBuffers = cmdLine.GetUnsignedInt("num-buffers", numBuffers);
 	//zeroCopy = cmdLine.GetFlag("zero-copy");	// no default returned, so disable this for now
@@ -236,6 +278,14 @@ bool videoOptions::Parse( const char* URI, const commandLine& cmdLine, videoOpti
 	if( type == INPUT )
 		loop = cmdLine.GetInt("input-loop", cmdLine.GetInt("loop", loop));
 
+	// prefetch
+	if( type == INPUT )
+		prefetch = cmdLine.GetUnsignedInt("input-prefetch", prefetch);
+
+	// zero-copy input
+	if( type == INPUT && cmdLine.GetFlag("input-zero-copy") )
+		zeroCopyInput = true;
+
 	// latency
 	latency = (type == INPUT) ? cmdLine.GetUnsignedInt("input-latency", cmdLine.GetUnsignedInt("input-rtsp-latency", latency))
 						 : cmdLine.GetUnsignedInt("output-latency", latency);
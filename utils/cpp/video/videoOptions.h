@@ -28,6 +28,8 @@
 
 #include "URI.h"	
 
+#include <vector>
+
 
 /**
  * The videoOptions struct contains common settings that are used
@@ -55,6 +57,16 @@ public:
 	 * for videoSource streams, or `--output-save` for videoOutput streams.
 	 */
 	URI save;
+
+	/**
+	 * Additional network/file outputs that share the compressed stream of the primary
+	 * output resource above, so the video is only encoded once no matter how many
+	 * outputs (or clients) are attached.  For example, the primary resource could be
+	 * `rtsp://@:8554/my_stream` with fanout to `webrtc://@:8554/my_stream` and `file://my_video.mp4`.
+	 * Only one RTSP and one WebRTC output are supported per stream.
+	 * This option can be set from the command-line using `--output-fanout=URI,URI`
+	 */
+	std::vector<URI> fanout;
 	
 	/**
 	 * The width of the stream (in pixels).
@@ -102,6 +114,17 @@ public:
 	 * @note the default is true (zeroCopy CPU/GPU access enabled).
 	 */
 	bool zeroCopy;
+
+	/**
+	 * For GStreamer inputs that deliver frames in CPU memory (non-NVMM), hold a
+	 * reference to each GstBuffer from appsink instead of copying it into a ringbuffer.
+	 * Frames are then converted on the CPU straight from the GStreamer memory into
+	 * the zeroCopy output buffers (or copied only when they're actually captured, if
+	 * the output format requires conversion on the GPU).  Other types of streams will ignore it.
+	 * This option can be set from the command line using `--input-zero-copy`.
+	 * @note the default is false (frames are copied when they're recieved).
+	 */
+	bool zeroCopyInput;
 	
 	/**
 	 * Control the number of loops for videoSource disk-based inputs (for example,
@@ -118,6 +141,14 @@ public:
 	 */
 	int loop;
 
+	/**
+	 * For image sequence inputs, the number of files that are decoded ahead of time
+	 * by a pool of background worker threads.  The default of `0` disables prefetching,
+	 * and the images are decoded synchronously by Capture().  Other types of streams will ignore it.
+	 * This option can be set from the command line using `--input-prefetch=N`.
+	 */
+	uint32_t prefetch;
+
 	/**
 	 * Number of milliseconds of video to buffer for network RTSP or WebRTC streams.
 	 * The default setting is 10ms (which is lower than GStreamer's default settings).
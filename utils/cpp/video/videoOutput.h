@@ -55,6 +55,8 @@
 		  "                            * v4l2 (aarch64/JetPack5 only)\n"                     \
 		  "  --output-save=FILE     path to a video file for saving the compressed stream\n" \
 		  "                         to disk, in addition to the primary output above\n"      \
+		  "  --output-fanout=URI,.. additional file/rtp/rtsp/webrtc outputs that share the\n"  \
+		  "                         primary output's encoder (the video is only encoded once)\n" \
 		  "  --bitrate=BITRATE      desired target VBR bitrate for compressed streams,\n"    \
 		  "                         in bits per second. The default is 4000000 (4 Mbps)\n"	\
 		  "  --stun-server=URL      WebRTC connection STUN server (set to 'disabled' for LAN)\n" \
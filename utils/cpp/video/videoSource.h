@@ -68,7 +68,11 @@
 		  "  --input-loop=LOOP      for file-based inputs, the number of loops to run:\n"		\
 		  "                             * -1 = loop forever\n"								\
 		  "                             *  0 = don't loop (default)\n"						\
-		  "                             * >0 = set number of loops\n\n"
+		  "                             * >0 = set number of loops\n"						\
+		  "  --input-prefetch=N     for image sequences, decode N files ahead of time\n"		\
+		  "                         on background threads (default is 0, disabled)\n"		\
+		  "  --input-zero-copy      for GStreamer inputs in CPU memory, convert frames\n"		\
+		  "                         straight from the decoded buffers without copying\n\n"
 
 
 /**
@@ -29,6 +29,16 @@
 
 #include "mat33.h"
 #include "logging.h"
+#include "filesystem.h"
+
+#include <string.h>
+#include <strings.h>
+
+#include <algorithm>
+
+
+// number of points that are converted at a time before being written to disk
+#define POINT_CLOUD_BLOCK_SIZE 65536
 
 
 // constructor
@@ -47,12 +57,26 @@ cudaPointCloud::cudaPointCloud()
 	mHasRGB         = false;
 	mHasNewPoints	 = false;
 	mHasCalibration = false;
+
+	mRecordFormat   = PCD_BINARY;
+	mRecordMaxFiles = 0;
+	mRecordMaxQueue = 0;
+	mRecordCount    = 0;
+	mRecordStop     = false;
+	mRecordThread   = NULL;
 }
 
 
 // destructor
 cudaPointCloud::~cudaPointCloud()
 {
+	StopRecording();
+
+	for( size_t n=0; n < mRecordFree.size(); n++ )
+		delete mRecordFree[n];
+
+	mRecordFree.clear();
+
 	if( mDepthResize != NULL )
 	{
 		CUDA(cudaFree(mDepthResize));
@@ -314,74 +338,524 @@ bool cudaPointCloud::SetCalibration( const char* filename )
 }
 
 
-// Save
-bool cudaPointCloud::Save( const char* filename )
+// FileFormatToStr
+const char* cudaPointCloud::FileFormatToStr( FileFormat format )
 {
-	if( !filename || mNumPoints == 0 || !mPointsCPU )
-		return false;
+	switch(format)
+	{
+		case PCD_ASCII:             return "pcd_ascii";
+		case PCD_BINARY:            return "pcd_binary";
+		case PCD_BINARY_COMPRESSED: return "pcd_binary_compressed";
+		case PLY_BINARY:            return "ply_binary";
+	}
+
+	return "unknown";
+}
 
-	// open the PCD file
-	FILE* file = fopen(filename, "w");
 
-	if( !file )
+// FileFormatFromStr
+cudaPointCloud::FileFormat cudaPointCloud::FileFormatFromStr( const char* str, FileFormat defaultFormat )
+{
+	if( !str )
+		return defaultFormat;
+
+	for( int n=PCD_ASCII; n <= PLY_BINARY; n++ )
 	{
-		LogError(LOG_CUDA "cudaPointCloud::Save() -- failed to create %s\n", filename);
-		return false;
+		if( strcasecmp(str, FileFormatToStr((FileFormat)n)) == 0 )
+			return (FileFormat)n;
+	}
+
+	// the DATA types of PCD files
+	if( strcasecmp(str, "ascii") == 0 )
+		return PCD_ASCII;
+	else if( strcasecmp(str, "binary") == 0 )
+		return PCD_BINARY;
+	else if( strcasecmp(str, "binary_compressed") == 0 )
+		return PCD_BINARY_COMPRESSED;
+
+	return defaultFormat;
+}
+
+
+// pack the color into 24 bits
+static inline uint32_t packRGB( const uchar3& color )
+{
+	return (uint32_t(color.x) << 16 | uint32_t(color.y) << 8 | uint32_t(color.z));
+}
+
+
+// convert blocks of points into records, and write them to the file
+template<typename Convert>
+static bool writeBlocks( FILE* file, uint32_t numPoints, size_t recordSize, Convert convert )
+{
+	std::vector<uint8_t> block(std::min<uint32_t>(numPoints, POINT_CLOUD_BLOCK_SIZE) * recordSize);
+
+	for( uint32_t n=0; n < numPoints; n += POINT_CLOUD_BLOCK_SIZE )
+	{
+		const uint32_t count = std::min<uint32_t>(numPoints - n, POINT_CLOUD_BLOCK_SIZE);
+
+		for( uint32_t i=0; i < count; i++ )
+			convert(block.data() + i * recordSize, n + i);
+
+		if( fwrite(block.data(), recordSize, count, file) != count )
+			return false;
+	}
+
+	return true;
+}
+
+
+// LZF compression (the same format as liblzf, which PCL uses to decompress binary_compressed PCD files).
+// The output is a sequence of literal runs (a byte of length-1 < 32, followed by up to 32 bytes)
+// and back-references (3 bits of length-2 and 13 bits of offset-1, with an extra byte for longer lengths).
+// Returns the compressed size, or 0 if it didn't fit in the output.
+static uint32_t compressLZF( const uint8_t* in, uint32_t inSize, uint8_t* out, uint32_t outSize )
+{
+	const uint32_t HASH_LOG  = 14;
+	const uint32_t MAX_LIT   = 32;
+	const uint32_t MAX_OFF   = 8192;
+	const uint32_t MAX_REF   = 264;
+
+	std::vector<uint32_t> table(1 << HASH_LOG, 0);	// position + 1 of the last occurrence of each hash
+
+	uint32_t ip = 0;
+	uint32_t op = 0;
+	uint32_t literals = 0;	// start of the pending literals
+
+	// write the pending literals, in runs of up to 32 bytes
+	auto writeLiterals = [&]( uint32_t end )
+	{
+		while( literals < end )
+		{
+			const uint32_t count = std::min(end - literals, MAX_LIT);
+
+			if( op + 1 + count > outSize )
+				return false;
+
+			out[op++] = count - 1;
+			memcpy(out + op, in + literals, count);
+
+			op += count;
+			literals += count;
+		}
+
+		return true;
+	};
+
+	while( ip + 2 < inSize )
+	{
+		const uint32_t value = (uint32_t(in[ip]) << 16) | (uint32_t(in[ip+1]) << 8) | in[ip+2];
+		const uint32_t hash  = ((value >> (24 - HASH_LOG)) - value * 5) & ((1 << HASH_LOG) - 1);
+		const uint32_t ref   = table[hash];
+
+		table[hash] = ip + 1;
+
+		if( ref == 0 || ip - ref >= MAX_OFF || memcmp(in + ref - 1, in + ip, 3) != 0 )
+		{
+			ip++;
+			continue;
+		}
+
+		// extend the match as far as possible
+		const uint32_t match = ref - 1;
+		const uint32_t maxLength = std::min(inSize - ip, MAX_REF);
+		const uint32_t offset = ip - match - 1;
+
+		uint32_t length = 3;
+
+		while( length < maxLength && in[match + length] == in[ip + length] )
+			length++;
+
+		if( !writeLiterals(ip) || op + 3 > outSize )
+			return 0;
+
+		if( length - 2 < 7 )
+		{
+			out[op++] = (offset >> 8) + ((length - 2) << 5);
+		}
+		else
+		{
+			out[op++] = (offset >> 8) + (7 << 5);
+			out[op++] = length - 2 - 7;
+		}
+
+		out[op++] = offset & 0xFF;
+
+		ip += length;
+		literals = ip;
 	}
 
-	// write the PCD header
+	if( !writeLiterals(inSize) )
+		return 0;
+
+	return op;
+}
+
+
+// write the PCD header
+static void writePCDHeader( FILE* file, uint32_t numPoints, bool hasRGB, const char* dataType )
+{
 	fprintf(file, "# .PCD v0.7 - Point Cloud Data file format\n");
 	fprintf(file, "VERSION 0.7\n");
 
-	if( mHasRGB )
+	if( hasRGB )
 	{
 		fprintf(file, "FIELDS x y z rgb\n");
 		fprintf(file, "SIZE 4 4 4 4\n");
 		fprintf(file, "TYPE F F F U\n");
+		fprintf(file, "COUNT 1 1 1 1\n");
 	}
 	else
 	{
 		fprintf(file, "FIELDS x y z\n");
 		fprintf(file, "SIZE 4 4 4\n");
 		fprintf(file, "TYPE F F F\n");
+		fprintf(file, "COUNT 1 1 1\n");
 	}
 
-	fprintf(file, "COUNT 1 1 1 1\n");
-	fprintf(file, "WIDTH %u\n", mNumPoints);
+	fprintf(file, "WIDTH %u\n", numPoints);
 	fprintf(file, "HEIGHT 1\n");
 	fprintf(file, "VIEWPOINT 0 0 0 1 0 0 0\n");
-	fprintf(file, "POINTS %u\n", mNumPoints);
-	fprintf(file, "DATA ascii\n");
+	fprintf(file, "POINTS %u\n", numPoints);
+	fprintf(file, "DATA %s\n", dataType);
+}
 
-	// wait for the GPU to finish any processing
-	CUDA(cudaDeviceSynchronize());
 
-	// write out points to the PCD file
-	for( size_t n=0; n < mNumPoints; n++ )
+// write an ASCII PCD file
+static bool writePCDASCII( FILE* file, const cudaPointCloud::Vertex* points, uint32_t numPoints, bool hasRGB )
+{
+	writePCDHeader(file, numPoints, hasRGB, "ascii");
+
+	for( size_t n=0; n < numPoints; n++ )
 	{
-		Vertex* point = GetData(n);
+		const cudaPointCloud::Vertex* point = points + n;
 
 		// output XYZ coordinates
 		fprintf(file, "%f %f %f", point->pos.x, point->pos.y, point->pos.z);
 
 		// output RGB color
-		if( mHasRGB )
-		{
-			// pack the color into 24 bits
-			const uint32_t rgb_packed = (uint32_t(point->color.x) << 16 |
-	      					         uint32_t(point->color.y) << 8 | 
-							         uint32_t(point->color.z));
-		
-			fprintf(file, " %u", rgb_packed);
-		}
+		if( hasRGB )
+			fprintf(file, " %u", packRGB(point->color));
 
 		fprintf(file, "\n");
 	}
-		
-	fclose(file);
+
+	return !ferror(file);
+}
+
+
+// write a binary PCD file (the fields of each point are interleaved)
+static bool writePCDBinary( FILE* file, const cudaPointCloud::Vertex* points, uint32_t numPoints, bool hasRGB )
+{
+	writePCDHeader(file, numPoints, hasRGB, "binary");
+
+	if( !hasRGB )
+	{
+		return writeBlocks(file, numPoints, sizeof(float3), [points]( uint8_t* record, uint32_t n )
+		{
+			memcpy(record, &points[n].pos, sizeof(float3));
+		});
+	}
+
+	return writeBlocks(file, numPoints, sizeof(float3) + sizeof(uint32_t), [points]( uint8_t* record, uint32_t n )
+	{
+		const uint32_t rgb = packRGB(points[n].color);
+
+		memcpy(record, &points[n].pos, sizeof(float3));
+		memcpy(record + sizeof(float3), &rgb, sizeof(uint32_t));
+	});
+}
+
+
+// write a binary_compressed PCD file (an array of each field, compressed together with LZF)
+static bool writePCDCompressed( FILE* file, const cudaPointCloud::Vertex* points, uint32_t numPoints, bool hasRGB )
+{
+	const uint32_t numFields = hasRGB ? 4 : 3;
+	const uint64_t uncompressedSize = uint64_t(numPoints) * numFields * sizeof(float);
+
+	// the sizes are stored as 32-bit
+	if( uncompressedSize + uncompressedSize / 32 + 16 > UINT32_MAX )
+	{
+		LogError(LOG_CUDA "cudaPointCloud::Save() -- %u points are too many for a binary_compressed PCD file\n", numPoints);
+		return false;
+	}
+
+	std::vector<uint8_t> fields(uncompressedSize);
+	std::vector<uint8_t> compressed(uncompressedSize + uncompressedSize / 32 + 16);
+
+	float* x = (float*)fields.data();
+	float* y = x + numPoints;
+	float* z = y + numPoints;
+
+	uint32_t* rgb = (uint32_t*)(z + numPoints);
+
+	for( uint32_t n=0; n < numPoints; n++ )
+	{
+		x[n] = points[n].pos.x;
+		y[n] = points[n].pos.y;
+		z[n] = points[n].pos.z;
+
+		if( hasRGB )
+			rgb[n] = packRGB(points[n].color);
+	}
+
+	const uint32_t sizes[] = { compressLZF(fields.data(), uncompressedSize, compressed.data(), compressed.size()), (uint32_t)uncompressedSize };
+
+	if( sizes[0] == 0 && uncompressedSize > 0 )
+		return false;
+
+	writePCDHeader(file, numPoints, hasRGB, "binary_compressed");
+
+	if( fwrite(sizes, sizeof(uint32_t), 2, file) != 2 )
+		return false;
+
+	return fwrite(compressed.data(), 1, sizes[0], file) == sizes[0];
+}
+
+
+// write a little-endian binary PLY file
+static bool writePLY( FILE* file, const cudaPointCloud::Vertex* points, uint32_t numPoints, bool hasRGB )
+{
+	fprintf(file, "ply\n");
+	fprintf(file, "format binary_little_endian 1.0\n");
+	fprintf(file, "element vertex %u\n", numPoints);
+	fprintf(file, "property float x\n");
+	fprintf(file, "property float y\n");
+	fprintf(file, "property float z\n");
+
+	if( hasRGB )
+	{
+		fprintf(file, "property uchar red\n");
+		fprintf(file, "property uchar green\n");
+		fprintf(file, "property uchar blue\n");
+	}
+
+	fprintf(file, "end_header\n");
+
+	// the position and color are the start of each vertex
+	const size_t recordSize = hasRGB ? sizeof(float3) + sizeof(uchar3) : sizeof(float3);
+
+	return writeBlocks(file, numPoints, recordSize, [points, recordSize]( uint8_t* record, uint32_t n )
+	{
+		memcpy(record, points + n, recordSize);
+	});
+}
+
+
+// savePoints
+bool cudaPointCloud::savePoints( const char* filename, FileFormat format, const Vertex* points, uint32_t numPoints, bool hasRGB )
+{
+	FILE* file = fopen(filename, "wb");
+
+	if( !file )
+	{
+		LogError(LOG_CUDA "cudaPointCloud::Save() -- failed to create %s\n", filename);
+		return false;
+	}
+
+	bool result = false;
+
+	if( format == PCD_ASCII )
+		result = writePCDASCII(file, points, numPoints, hasRGB);
+	else if( format == PCD_BINARY )
+		result = writePCDBinary(file, points, numPoints, hasRGB);
+	else if( format == PCD_BINARY_COMPRESSED )
+		result = writePCDCompressed(file, points, numPoints, hasRGB);
+	else if( format == PLY_BINARY )
+		result = writePLY(file, points, numPoints, hasRGB);
+
+	if( fclose(file) != 0 )
+		result = false;
+
+	if( !result )
+	{
+		LogError(LOG_CUDA "cudaPointCloud::Save() -- failed to write %s (%s)\n", filename, FileFormatToStr(format));
+		return false;
+	}
+
+	return true;
+}
+
+
+// Save
+bool cudaPointCloud::Save( const char* filename )
+{
+	if( !filename )
+		return false;
+
+	return Save(filename, fileHasExtension(filename, "ply") ? PLY_BINARY : PCD_ASCII);
+}
+
+
+// Save
+bool cudaPointCloud::Save( const char* filename, FileFormat format )
+{
+	if( !filename || mNumPoints == 0 || !mPointsCPU )
+		return false;
+
+	// wait for the GPU to finish any processing
+	CUDA(cudaDeviceSynchronize());
+
+	return savePoints(filename, format, mPointsCPU, mNumPoints, mHasRGB);
+}
+
+
+// StartRecording
+bool cudaPointCloud::StartRecording( const char* path, FileFormat format, uint32_t maxFiles, uint32_t maxQueue )
+{
+	if( !path || maxQueue == 0 )
+		return false;
+
+	StopRecording();
+
+	// replace wildcards with %i
+	std::string pattern = path;
+
+	const size_t wildcard = pattern.find("*");
+
+	if( wildcard != std::string::npos )
+		pattern.replace(wildcard, 1, "%i");
+
+	// the path of a directory gets the default numbering
+	if( pattern.find("%") == std::string::npos && fileExtension(pattern).size() == 0 )
+		pattern = pathJoin(pattern, (format == PLY_BINARY) ? "%i.ply" : "%i.pcd");
+
+	// the frame number is the only thing that can be formatted into the path
+	const size_t percent = pattern.find("%");
+	const size_t conversion = pattern.find_first_not_of("0123456789", percent + 1);
+
+	if( percent == std::string::npos || conversion == std::string::npos || strchr("iud", pattern[conversion]) == NULL || pattern.find("%", percent + 1) != std::string::npos )
+	{
+		LogError(LOG_CUDA "cudaPointCloud::StartRecording() -- path should contain %%i where the frame number goes (%s)\n", path);
+		return false;
+	}
+
+	mRecordPath     = pattern;
+	mRecordFormat   = format;
+	mRecordMaxFiles = maxFiles;
+	mRecordMaxQueue = maxQueue;
+	mRecordCount    = 0;
+	mRecordStop     = false;
+	mRecordThread   = new Thread();
+
+	if( !mRecordThread->Start(recordThread, this) )
+	{
+		LogError(LOG_CUDA "cudaPointCloud::StartRecording() -- failed to start the recording thread\n");
+		delete mRecordThread;
+		mRecordThread = NULL;
+		return false;
+	}
+
+	LogVerbose(LOG_CUDA "cudaPointCloud -- recording point clouds to %s (%s)\n", mRecordPath.c_str(), FileFormatToStr(mRecordFormat));
 	return true;
 }
 
 
+// Record
+bool cudaPointCloud::Record()
+{
+	if( !IsRecording() || mNumPoints == 0 || !mPointsCPU )
+		return false;
+
+	// get a frame to copy the points into
+	RecordFrame* frame = NULL;
+
+	mRecordMutex.Lock();
+
+	if( mRecordQueue.size() >= mRecordMaxQueue )
+	{
+		const size_t queued = mRecordQueue.size();
+		mRecordMutex.Unlock();
+		LogWarning(LOG_CUDA "cudaPointCloud::Record() -- dropped point cloud, the recording thread is %zu behind\n", queued);
+		return false;
+	}
+
+	if( mRecordFree.size() > 0 )
+	{
+		frame = mRecordFree.back();
+		mRecordFree.pop_back();
+	}
+
+	mRecordMutex.Unlock();
+
+	if( !frame )
+		frame = new RecordFrame();
+
+	// wait for the GPU to finish any processing
+	CUDA(cudaDeviceSynchronize());
 
+	frame->points.assign(mPointsCPU, mPointsCPU + mNumPoints);
+	frame->hasRGB = mHasRGB;
 
+	// the oldest file gets overwritten when the frame number wraps around
+	const uint64_t number = (mRecordMaxFiles > 0) ? mRecordCount % mRecordMaxFiles : mRecordCount;
+
+	char filename[1024];
+	snprintf(filename, sizeof(filename), mRecordPath.c_str(), (int)number);
+
+	frame->filename = filename;
+	mRecordCount++;
+
+	mRecordMutex.Lock();
+	mRecordQueue.push_back(frame);
+	mRecordMutex.Unlock();
+
+	mRecordEvent.Wake();
+	return true;
+}
+
+
+// StopRecording
+void cudaPointCloud::StopRecording()
+{
+	if( !mRecordThread )
+		return;
+
+	mRecordMutex.Lock();
+	mRecordStop = true;
+	mRecordMutex.Unlock();
+
+	mRecordEvent.Wake();
+
+	mRecordThread->Stop(true);
+	delete mRecordThread;
+	mRecordThread = NULL;
+
+	LogVerbose(LOG_CUDA "cudaPointCloud -- recorded %llu point clouds to %s\n", (unsigned long long)mRecordCount, mRecordPath.c_str());
+}
+
+
+// recordThread
+void* cudaPointCloud::recordThread( void* user_param )
+{
+	cudaPointCloud* cloud = (cudaPointCloud*)user_param;
+
+	cloud->mRecordMutex.Lock();
+
+	while( true )
+	{
+		// the frames that were queued before stopping still get saved
+		if( cloud->mRecordQueue.size() == 0 )
+		{
+			if( cloud->mRecordStop )
+				break;
+
+			cloud->mRecordMutex.Unlock();
+			cloud->mRecordEvent.Wait(100);
+			cloud->mRecordMutex.Lock();
+			continue;
+		}
+
+		RecordFrame* frame = cloud->mRecordQueue.front();
+
+		cloud->mRecordMutex.Unlock();
+		savePoints(frame->filename.c_str(), cloud->mRecordFormat, frame->points.data(), frame->points.size(), frame->hasRGB);
+		cloud->mRecordMutex.Lock();
+
+		cloud->mRecordQueue.erase(cloud->mRecordQueue.begin());
+		cloud->mRecordFree.push_back(frame);
+	}
+
+	cloud->mRecordMutex.Unlock();
+	return NULL;
+}
@@ -26,6 +26,13 @@
 
 #include "cudaUtility.h"
 
+#include "Thread.h"
+#include "Mutex.h"
+#include "Event.h"
+
+#include <string>
+#include <vector>
+
 
 // forward declarations
 class glBuffer;
@@ -63,6 +70,29 @@ public:
 
 	} __attribute__((packed));
 
+	/**
+	 * File formats that point clouds can be saved in.
+	 */
+	enum FileFormat
+	{
+		PCD_ASCII,			/**< PCD with the points written as text (the default for .pcd files) */
+		PCD_BINARY,			/**< PCD with the points written as binary */
+		PCD_BINARY_COMPRESSED,	/**< PCD with each field of the points written as a binary array, compressed with LZF */
+		PLY_BINARY			/**< little-endian binary PLY (the default for .ply files) */
+	};
+
+	/**
+	 * Convert a FileFormat enum to a string (e.g. "pcd_binary")
+	 */
+	static const char* FileFormatToStr( FileFormat format );
+
+	/**
+	 * Parse a FileFormat enum from a string ("pcd_ascii", "pcd_binary", "pcd_binary_compressed" or "ply_binary"),
+	 * or from the name of the PCD data type ("ascii", "binary" or "binary_compressed").
+	 * @returns the format, or `defaultFormat` if the string wasn't recognized.
+	 */
+	static FileFormat FileFormatFromStr( const char* str, FileFormat defaultFormat=PCD_ASCII );
+
 	/**
 	 * Create
 	 */
@@ -144,10 +174,46 @@ public:
 	bool Render();
 
 	/**
-	 * Save point cloud to PCD file.
+	 * Save point cloud to a PCD or PLY file, picking the format from the extension
+	 * (ASCII for .pcd files, and binary for .ply files).
 	 */
 	bool Save( const char* filename );
 
+	/**
+	 * Save point cloud to a file in the given format.
+	 * The binary formats are much faster to write and smaller than ASCII.
+	 */
+	bool Save( const char* filename, FileFormat format );
+
+	/**
+	 * Start saving the point clouds from Record() to a sequence of files, from a background thread.
+	 *
+	 * @param path the path of the files, with `%i` (or `*`) where the frame number goes, for example
+	 *             `clouds/%i.pcd`.  If it's a directory, the files are saved in it as `%i.pcd` or `%i.ply`.
+	 * @param format the format of the files (PCD_BINARY is a good choice for capturing in realtime)
+	 * @param maxFiles if non-zero, the frame numbers wrap around after this many files, so that only
+	 *                 the most recent point clouds are kept (the oldest file gets overwritten).
+	 * @param maxQueue the number of point clouds that can be waiting to be saved, after which
+	 *                 Record() drops them instead of waiting for the disk.
+	 */
+	bool StartRecording( const char* path, FileFormat format=PCD_BINARY, uint32_t maxFiles=0, uint32_t maxQueue=4 );
+
+	/**
+	 * Queue a copy of the current point cloud to be saved by the recording thread.
+	 * @returns false if not recording, or if the queue was full and the point cloud was dropped.
+	 */
+	bool Record();
+
+	/**
+	 * Stop recording, after the point clouds that were already queued are saved.
+	 */
+	void StopRecording();
+
+	/**
+	 * Return true if StartRecording() was called and the recording is still running.
+	 */
+	inline bool IsRecording() const			{ return mRecordThread != NULL; }
+
 	/**
 	 * Set the intrinsic camera calibration.
 	 */
@@ -168,6 +234,19 @@ protected:
 
 	bool allocBufferGL();
 	bool allocDepthResize( size_t size );
+
+	/**
+	 * A copy of the points that's waiting to be saved by the recording thread.
+	 */
+	struct RecordFrame
+	{
+		std::vector<Vertex> points;
+		std::string filename;
+		bool hasRGB;
+	};
+
+	static bool savePoints( const char* filename, FileFormat format, const Vertex* points, uint32_t numPoints, bool hasRGB );
+	static void* recordThread( void* user_param );
 	
 	Vertex* mPointsCPU;
 	Vertex* mPointsGPU;
@@ -187,6 +266,19 @@ protected:
 	bool mHasRGB;
 	bool mHasNewPoints;
 	bool mHasCalibration;
+
+	std::string mRecordPath;
+	FileFormat  mRecordFormat;
+	uint32_t    mRecordMaxFiles;
+	uint32_t    mRecordMaxQueue;
+	uint64_t    mRecordCount;
+	bool        mRecordStop;
+	Thread*     mRecordThread;
+	Mutex       mRecordMutex;
+	Event       mRecordEvent;
+
+	std::vector<RecordFrame*> mRecordQueue;	// frames waiting to be saved (oldest first)
+	std::vector<RecordFrame*> mRecordFree;	// frames that were saved, to be reused
 };
 
 #endif
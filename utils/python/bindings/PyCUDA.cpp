@@ -55,6 +55,7 @@ static PyObject* PyCudaMemory_New( PyTypeObject *type, PyObject *args, PyObject
 	self->freeOnDelete = true;
     self->stream = NULL;
     self->event = NULL;
+    self->owner = NULL;
     
 	return (PyObject*)self;
 }
@@ -86,6 +87,13 @@ static void PyCudaMemory_Dealloc( PyCudaMemory* self )
 	
 	Py_END_ALLOW_THREADS
 
+	// release the owner of the memory (like the numpy array that it wraps)
+	if( self->owner != NULL )
+	{
+		Py_DECREF(self->owner);
+		self->owner = NULL;
+	}
+	
 	// free the container
 	Py_TYPE(self)->tp_free((PyObject*)self);
 }
@@ -321,6 +329,7 @@ static PyObject* PyCudaImage_New( PyTypeObject *type, PyObject *args, PyObject *
 	self->base.freeOnDelete = true;
 	self->base.stream = NULL;
     self->base.event = NULL;
+    self->base.owner = NULL;
     
 	self->width = 0;
 	self->height = 0;
@@ -1006,6 +1015,7 @@ PyObject* PyCUDA_RegisterMemory( void* gpuPtr, size_t size, bool mapped, bool fr
 	mem->freeOnDelete = freeOnDelete;
     mem->stream = NULL;
     mem->event = NULL;
+    mem->owner = NULL;
     
 	return (PyObject*)mem;
 }
@@ -1027,6 +1037,7 @@ PyObject* PyCUDA_RegisterImage( void* gpuPtr, uint32_t width, uint32_t height, i
 		return NULL;
 	}
 
+	mem->base.owner = NULL;
 	PyCudaImage_Config(mem, gpuPtr, width, height, format, timestamp, mapped, freeOnDelete);
 	return (PyObject*)mem;
 }
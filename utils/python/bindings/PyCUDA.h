@@ -35,6 +35,7 @@ typedef struct {
 	bool freeOnDelete;
 	cudaStream_t stream;
 	cudaEvent_t event;
+	PyObject* owner;	// object that owns externally-managed memory (released on delete)
 } PyCudaMemory;
 
 // PyCudaImage object
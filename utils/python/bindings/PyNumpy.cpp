@@ -33,6 +33,9 @@
 
 #include "loadImage.h"
 
+#include <map>
+#include <vector>
+
 
 
 // imageFormat to numpy dtype
@@ -141,16 +144,258 @@ PyObject* PyNumpy_FromCUDA( PyObject* self, PyObject* args, PyObject* kwds )
 }
 
 
+// pool of mapped buffers that cudaFromNumpy() copies the arrays into, so that
+// converting frames of the same size over and over reuses the same memory
+#define PY_NUMPY_POOL_SIZE 8
+
+struct PyNumpy_Buffer
+{
+	void*  cpuPtr;
+	void*  gpuPtr;
+	size_t size;
+};
+
+static std::vector<PyNumpy_Buffer> gNumpyBufferPool;	// idle buffers (accessed with the GIL held)
+
+
+// PyNumpy_AllocBuffer
+static bool PyNumpy_AllocBuffer( PyNumpy_Buffer& buffer, size_t size )
+{
+	for( size_t n=0; n < gNumpyBufferPool.size(); n++ )
+	{
+		if( gNumpyBufferPool[n].size == size )
+		{
+			buffer = gNumpyBufferPool[n];
+			gNumpyBufferPool.erase(gNumpyBufferPool.begin() + n);
+			return true;
+		}
+	}
+	
+	if( !cudaAllocMapped(&buffer.cpuPtr, &buffer.gpuPtr, size) )
+		return false;
+	
+	buffer.size = size;
+	return true;
+}
+
+
+// PyNumpy_FreeBuffer (returns it to the pool)
+static void PyNumpy_FreeBuffer( PyNumpy_Buffer* buffer )
+{
+	// evict the oldest idle buffer if the pool is full
+	if( gNumpyBufferPool.size() >= PY_NUMPY_POOL_SIZE )
+	{
+		CUDA(cudaFreeHost(gNumpyBufferPool[0].cpuPtr));
+		gNumpyBufferPool.erase(gNumpyBufferPool.begin());
+	}
+	
+	gNumpyBufferPool.push_back(*buffer);
+	delete buffer;
+}
+
+
+// PyNumpy_ReleaseBuffer (destructor of the capsule that owns pooled buffers)
+static void PyNumpy_ReleaseBuffer( PyObject* capsule )
+{
+	PyNumpy_Buffer* buffer = (PyNumpy_Buffer*)PyCapsule_GetPointer(capsule, "jetson.utils.numpyBuffer");
+	
+	if( buffer != NULL )
+		PyNumpy_FreeBuffer(buffer);
+}
+
+
+// host memory ranges that cudaFromNumpy(copy=False) registered with CUDA,
+// reference-counted because different arrays can view the same memory
+struct PyNumpy_Registration
+{
+	size_t   size;
+	uint32_t refCount;
+};
+
+static std::map<uint8_t*, PyNumpy_Registration> gNumpyRegistrations;	// accessed with the GIL held
+
+struct PyNumpy_Mapping
+{
+	PyObject* array;		// the numpy array whose memory is mapped
+	uint8_t*  registration;	// key of the registration it uses (or NULL if the memory was already mapped)
+};
+
+
+// PyNumpy_FindRegistration
+static uint8_t* PyNumpy_FindRegistration( uint8_t* ptr, size_t size )
+{
+	std::map<uint8_t*, PyNumpy_Registration>::iterator iter = gNumpyRegistrations.upper_bound(ptr);
+	
+	if( iter == gNumpyRegistrations.begin() )
+		return NULL;
+	
+	iter--;
+	
+	if( ptr + size > iter->first + iter->second.size )
+		return NULL;
+	
+	return iter->first;
+}
+
+
+// PyNumpy_FreeMapping
+static void PyNumpy_FreeMapping( PyNumpy_Mapping* mapping )
+{
+	if( mapping->registration != NULL )
+	{
+		std::map<uint8_t*, PyNumpy_Registration>::iterator iter = gNumpyRegistrations.find(mapping->registration);
+		
+		if( iter != gNumpyRegistrations.end() && --iter->second.refCount == 0 )
+		{
+			CUDA(cudaHostUnregister(iter->first));
+			gNumpyRegistrations.erase(iter);
+		}
+	}
+	
+	Py_DECREF(mapping->array);
+	delete mapping;
+}
+
+
+// PyNumpy_ReleaseMapping (destructor of the capsule that owns zero-copy arrays)
+static void PyNumpy_ReleaseMapping( PyObject* capsule )
+{
+	PyNumpy_Mapping* mapping = (PyNumpy_Mapping*)PyCapsule_GetPointer(capsule, "jetson.utils.numpyMapping");
+	
+	if( mapping != NULL )
+		PyNumpy_FreeMapping(mapping);
+}
+
+
+// PyNumpy_MapArray
+static PyObject* PyNumpy_MapArray( PyObject* array, void* cpuPtr, size_t size, void** gpuPtr )
+{
+	uint8_t* ptr = (uint8_t*)cpuPtr;
+	uint8_t* registration = PyNumpy_FindRegistration(ptr, size);
+	
+	if( registration != NULL )
+	{
+		// this memory was already registered by another call to cudaFromNumpy()
+		if( CUDA_FAILED(cudaHostGetDevicePointer(gpuPtr, ptr, 0)) )
+		{
+			PyErr_SetString(PyExc_Exception, LOG_PY_UTILS "cudaFromNumpy() failed to get the device pointer of registered memory");
+			return NULL;
+		}
+	}
+	else if( cudaHostGetDevicePointer(gpuPtr, ptr, 0) == cudaSuccess )
+	{
+		// the array is already in mapped memory (e.g. it came from cudaToNumpy()),
+		// but make sure that it doesn't extend past the end of the mapped range
+		void* gpuEnd = NULL;
+		
+		if( cudaHostGetDevicePointer(&gpuEnd, ptr + size - 1, 0) != cudaSuccess || (uint8_t*)gpuEnd != (uint8_t*)*gpuPtr + size - 1 )
+		{
+			cudaGetLastError();
+			PyErr_SetString(PyExc_Exception, LOG_PY_UTILS "cudaFromNumpy() ndarray only partially overlaps mapped memory, use copy=True instead");
+			return NULL;
+		}
+		
+		LogDebug(LOG_PY_UTILS "cudaFromNumpy() ndarray is already in mapped memory\n");
+	}
+	else
+	{
+		cudaGetLastError();	// clear the error from checking the pointer
+		
+		// pin and map the pages of the array
+		cudaError_t result = cudaSuccess;
+		
+		Py_BEGIN_ALLOW_THREADS
+		result = cudaHostRegister(ptr, size, cudaHostRegisterMapped);
+		Py_END_ALLOW_THREADS
+		
+		if( result != cudaSuccess )
+		{
+			cudaGetLastError();
+			PyErr_Format(PyExc_Exception, LOG_PY_UTILS "cudaFromNumpy() failed to map the ndarray with cudaHostRegister() (error %u - %s), use copy=True instead", 
+					   result, cudaGetErrorString(result));
+			return NULL;
+		}
+		
+		if( CUDA_FAILED(cudaHostGetDevicePointer(gpuPtr, ptr, 0)) )
+		{
+			CUDA(cudaHostUnregister(ptr));
+			PyErr_SetString(PyExc_Exception, LOG_PY_UTILS "cudaFromNumpy() failed to get the device pointer of registered memory");
+			return NULL;
+		}
+		
+		PyNumpy_Registration reg;
+		
+		reg.size = size;
+		reg.refCount = 0;
+		
+		gNumpyRegistrations[ptr] = reg;
+		registration = ptr;
+	}
+	
+	// the capsule keeps the array (and its registration) alive for as long as the cudaImage
+	PyNumpy_Mapping* mapping = new PyNumpy_Mapping();
+	
+	mapping->array = array;
+	mapping->registration = registration;
+	
+	if( registration != NULL )
+		gNumpyRegistrations[registration].refCount++;
+	
+	Py_INCREF(array);
+	
+	PyObject* owner = PyCapsule_New(mapping, "jetson.utils.numpyMapping", PyNumpy_ReleaseMapping);
+	
+	if( !owner )
+	{
+		PyNumpy_FreeMapping(mapping);
+		return NULL;
+	}
+	
+	return owner;
+}
+
+
+// PyNumpy_CopyArray
+static PyObject* PyNumpy_CopyArray( void* cpuPtr, size_t size, void** gpuPtr )
+{
+	PyNumpy_Buffer* buffer = new PyNumpy_Buffer();
+	
+	if( !PyNumpy_AllocBuffer(*buffer, size) )
+	{
+		delete buffer;
+		PyErr_SetString(PyExc_Exception, LOG_PY_UTILS "cudaAllocMapped() failed");
+		return NULL;
+	}
+	
+	PyObject* owner = PyCapsule_New(buffer, "jetson.utils.numpyBuffer", PyNumpy_ReleaseBuffer);
+	
+	if( !owner )
+	{
+		PyNumpy_FreeBuffer(buffer);
+		return NULL;
+	}
+	
+	// copy array into CUDA memory
+	Py_BEGIN_ALLOW_THREADS
+	memcpy(buffer->cpuPtr, cpuPtr, size);
+	Py_END_ALLOW_THREADS
+	
+	*gpuPtr = buffer->gpuPtr;
+	return owner;
+}
+
+
 // cudaFromNumpy()
 PyObject* PyNumpy_ToCUDA( PyObject* self, PyObject* args, PyObject* kwds )
 {
 	PyObject* object = NULL;
 
 	int pyBGR=0;
-	static char* kwlist[] = {"array", "isBGR", "timestamp", NULL};
+	int pyCopy=1;
+	static char* kwlist[] = {"array", "isBGR", "timestamp", "copy", NULL};
 	long long timestamp = 0;
 
-	if( !PyArg_ParseTupleAndKeywords(args, kwds, "O|iL", kwlist, &object, &pyBGR, &timestamp) )
+	if( !PyArg_ParseTupleAndKeywords(args, kwds, "O|iLi", kwlist, &object, &pyBGR, &timestamp, &pyCopy) )
 		return NULL;
 
 	if( !PyArray_Check(object) )
@@ -166,6 +411,7 @@ PyObject* PyNumpy_ToCUDA( PyObject* self, PyObject* args, PyObject* kwds )
 	}
 
 	const bool isBGR = (pyBGR > 0);
+	const bool copy = (pyCopy > 0);
 
 	// detect uint8 array - otherwise cast to float
 	const int inputType = PyArray_TYPE((PyArrayObject*)object);
@@ -178,6 +424,18 @@ PyObject* PyNumpy_ToCUDA( PyObject* self, PyObject* args, PyObject* kwds )
 		typeSize = sizeof(uint8_t);
 	}
 	
+	// without copying, the array needs to be usable by CUDA as-is
+	if( !copy )
+	{
+		PyArrayObject* input = (PyArrayObject*)object;
+		
+		if( inputType != outputType || !PyArray_IS_C_CONTIGUOUS(input) || !PyArray_ISALIGNED(input) || !PyArray_ISWRITEABLE(input) )
+		{
+			PyErr_SetString(PyExc_Exception, LOG_PY_UTILS "cudaFromNumpy(copy=False) needs a writeable, aligned, C-contiguous ndarray of uint8 or float32");
+			return NULL;
+		}
+	}
+	
 	// cast to numpy array
 	PyArrayObject* array = (PyArrayObject*)PyArray_FROM_OTF(object, outputType, NPY_ARRAY_IN_ARRAY|NPY_ARRAY_FORCECAST);
 
@@ -219,16 +477,20 @@ PyObject* PyNumpy_ToCUDA( PyObject* self, PyObject* args, PyObject* kwds )
 		return NULL;
 	}
 
-	// allocate CUDA memory for the array
-	void* cpuPtr = NULL;
+	// map the array's memory, or copy it into a pooled CUDA buffer
 	void* gpuPtr = NULL;
-
-	if( !cudaAllocMapped(&cpuPtr, &gpuPtr, size) )
+	PyObject* owner = NULL;
+	
+	if( copy )
+		owner = PyNumpy_CopyArray(arrayPtr, size, &gpuPtr);
+	else
+		owner = PyNumpy_MapArray((PyObject*)array, arrayPtr, size, &gpuPtr);
+	
+	if( !owner )
 	{
-		PyErr_SetString(PyExc_Exception, LOG_PY_UTILS "cudaAllocMapped() failed");
 		Py_DECREF(array);
 		return NULL;
-	}	
+	}
 
 	// detect the image format
 	imageFormat format = IMAGE_UNKNOWN;
@@ -270,21 +532,23 @@ PyObject* PyNumpy_ToCUDA( PyObject* self, PyObject* args, PyObject* kwds )
 	PyObject* capsule = NULL;
 
 	if( format != IMAGE_UNKNOWN )	
-		capsule = PyCUDA_RegisterImage(gpuPtr, dims[1], dims[0], format, timestamp, true);
+		capsule = PyCUDA_RegisterImage(gpuPtr, dims[1], dims[0], format, timestamp, true, false);
 	else
-		capsule = PyCUDA_RegisterMemory(gpuPtr, size, true);
+		capsule = PyCUDA_RegisterMemory(gpuPtr, size, true, false);
+
+	// dims points into the array (which can be a temporary from the cast), so it's released after the last use
+	Py_DECREF(array);
 
 	if( !capsule )
 	{
-		Py_DECREF(array);
+		Py_DECREF(owner);
 		return NULL;
 	}
 
-	// copy array into CUDA memory
-	memcpy(cpuPtr, arrayPtr, size);
-
+	// the owner releases the memory (or the array) when the capsule is deleted
+	PyCUDA_GetMemory(capsule)->owner = owner;
+	
 	// return capsule container
-	Py_DECREF(array);
 	return capsule;
 }
 
@@ -294,7 +558,7 @@ PyObject* PyNumpy_ToCUDA( PyObject* self, PyObject* args, PyObject* kwds )
 
 static PyMethodDef pyImageIO_Functions[] = 
 {
-	{ "cudaFromNumpy", (PyCFunction)PyNumpy_ToCUDA, METH_VARARGS|METH_KEYWORDS, "Copy a numpy ndarray to CUDA memory" },
+	{ "cudaFromNumpy", (PyCFunction)PyNumpy_ToCUDA, METH_VARARGS|METH_KEYWORDS, "Copy a numpy ndarray to CUDA memory (or with copy=False, map the ndarray's memory into CUDA without copying it)" },
 	{ "cudaToNumpy", (PyCFunction)PyNumpy_FromCUDA, METH_VARARGS|METH_KEYWORDS, "Create a numpy ndarray wrapping the CUDA memory, without copying it" },	
 	{NULL}  /* Sentinel */
 };
@@ -34,6 +34,7 @@ parser.add_argument("--height", type=int, default=256, help="height of the array
 parser.add_argument("--depth", type=int, default=4, help="number of color channels in the array (1, 3, or 4)")
 parser.add_argument("--dtype", type=str, default="float32", help="numpy data type: " + " | ".join(sorted({str(key) for key in np.sctypeDict.keys()})))
 parser.add_argument("--filename", type=str, default="images/test/cuda-from-numpy.jpg", help="filename of the output test image")
+parser.add_argument("--zero-copy", action="store_true", help="map the array into CUDA instead of copying it (needs uint8 or float32)")
 
 opt = parser.parse_args()
 
@@ -56,8 +57,8 @@ for y in range(opt.height):
 
 		array[y, x] = px
 
-# copy to CUDA memory
-cuda_mem = cudaFromNumpy(array)
+# copy to CUDA memory (or map it without copying)
+cuda_mem = cudaFromNumpy(array, copy=not opt.zero_copy)
 print(cuda_mem)
 
 # save as image